@@ -540,33 +540,51 @@ void DetourUser32ForCursor(HMODULE base)
   auto& helper = GetHelperInterface();
   if (helper.CommonDetourModule(process, L"user32", base, module))
   {
-    DetourFunc(
-      process, base, "SetCursor", GetSetCursorDetour(), SetCursorDetour);
+    hadesmem::detail::ExportCache export_cache{process};
     DetourFunc(process,
+               export_cache,
+               base,
+               "SetCursor",
+               GetSetCursorDetour(),
+               SetCursorDetour);
+    DetourFunc(process,
+               export_cache,
                base,
                "GetCursorPos",
                GetGetCursorPosDetour(),
                GetCursorPosDetour);
     DetourFunc(process,
+               export_cache,
                base,
                "SetCursorPos",
                GetSetCursorPosDetour(),
                SetCursorPosDetour);
     DetourFunc(process,
+               export_cache,
                base,
                "GetPhysicalCursorPos",
                GetGetPhysicalCursorPosDetour(),
                GetPhysicalCursorPosDetour);
     DetourFunc(process,
+               export_cache,
                base,
                "SetPhysicalCursorPos",
                GetSetPhysicalCursorPosDetour(),
                SetPhysicalCursorPosDetour);
-    DetourFunc(
-      process, base, "ShowCursor", GetShowCursorDetour(), ShowCursorDetour);
-    DetourFunc(
-      process, base, "ClipCursor", GetClipCursorDetour(), ClipCursorDetour);
     DetourFunc(process,
+               export_cache,
+               base,
+               "ShowCursor",
+               GetShowCursorDetour(),
+               ShowCursorDetour);
+    DetourFunc(process,
+               export_cache,
+               base,
+               "ClipCursor",
+               GetClipCursorDetour(),
+               ClipCursorDetour);
+    DetourFunc(process,
+               export_cache,
                base,
                "GetClipCursor",
                GetGetClipCursorDetour(),
@@ -75,18 +75,32 @@ void DetourFunc(hadesmem::Process const& process,
   }
 }
 
+// Use this overload when detouring more than one export of a module, so its
+// export tables are only read once.
 template <typename T, typename U>
 void DetourFunc(hadesmem::Process const& process,
+                hadesmem::detail::ExportCache& export_cache,
                 HMODULE base,
                 std::string const& name,
                 std::unique_ptr<T>& detour,
                 U const& detour_fn)
 {
   auto const orig_fn = hadesmem::detail::AliasCast<typename T::TargetFuncRawT>(
-    hadesmem::detail::GetProcAddressInternal(process, base, name));
+    hadesmem::detail::GetProcAddressInternal(export_cache, base, name));
   DetourFunc(process, name, detour, orig_fn, detour_fn);
 }
 
+template <typename T, typename U>
+void DetourFunc(hadesmem::Process const& process,
+                HMODULE base,
+                std::string const& name,
+                std::unique_ptr<T>& detour,
+                U const& detour_fn)
+{
+  hadesmem::detail::ExportCache export_cache{process};
+  DetourFunc(process, export_cache, base, name, detour, detour_fn);
+}
+
 template <typename T>
 void UndetourFunc(std::wstring const& name,
                   std::unique_ptr<T>& detour,
@@ -464,19 +464,27 @@ void DetourNtdllForModule(HMODULE base)
   auto& helper = GetHelperInterface();
   if (helper.CommonDetourModule(process, L"ntdll", base, module))
   {
+    hadesmem::detail::ExportCache export_cache{process};
     DetourFunc(process,
+               export_cache,
                base,
                "NtMapViewOfSection",
                GetNtMapViewOfSectionDetour(),
                NtMapViewOfSectionDetour);
     DetourFunc(process,
+               export_cache,
                base,
                "NtUnmapViewOfSection",
                GetNtUnmapViewOfSectionDetour(),
                NtUnmapViewOfSectionDetour);
-    DetourFunc(
-      process, base, "LdrLoadDll", GetLdrLoadDllDetour(), LdrLoadDllDetour);
     DetourFunc(process,
+               export_cache,
+               base,
+               "LdrLoadDll",
+               GetLdrLoadDllDetour(),
+               LdrLoadDllDetour);
+    DetourFunc(process,
+               export_cache,
                base,
                "LdrUnloadDll",
                GetLdrUnloadDllDetour(),
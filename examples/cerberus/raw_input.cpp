@@ -246,17 +246,21 @@ void DetourUser32ForRawInput(HMODULE base)
   auto& helper = GetHelperInterface();
   if (helper.CommonDetourModule(process, L"user32", base, module))
   {
+    hadesmem::detail::ExportCache export_cache{process};
     DetourFunc(process,
+               export_cache,
                base,
                "GetRawInputBuffer",
                GetGetRawInputBufferDetour(),
                GetRawInputBufferDetour);
     DetourFunc(process,
+               export_cache,
                base,
                "GetRawInputData",
                GetGetRawInputDataDetour(),
                GetRawInputDataDetour);
     DetourFunc(process,
+               export_cache,
                base,
                "RegisterRawInputDevices",
                GetRegisterRawInputDevicesDetour(),
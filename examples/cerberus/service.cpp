@@ -405,22 +405,27 @@ void DetourSechostForService(HMODULE base)
   auto& helper = GetHelperInterface();
   if (helper.CommonDetourModule(process, L"sechost", base, module))
   {
+    hadesmem::detail::ExportCache export_cache{process};
     DetourFunc(process,
+               export_cache,
                base,
                "CreateServiceA",
                GetCreateServiceADetour(),
                CreateServiceADetour);
     DetourFunc(process,
+               export_cache,
                base,
                "CreateServiceW",
                GetCreateServiceWDetour(),
                CreateServiceWDetour);
     DetourFunc(process,
+               export_cache,
                base,
                "OpenServiceA",
                GetOpenServiceADetour(),
                OpenServiceADetour);
     DetourFunc(process,
+               export_cache,
                base,
                "OpenServiceW",
                GetOpenServiceWDetour(),
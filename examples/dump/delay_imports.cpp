@@ -0,0 +1,135 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include "delay_imports.hpp"
+
+#include <iostream>
+
+#include <hadesmem/pelib/delay_import_dir.hpp>
+#include <hadesmem/pelib/delay_import_dir_list.hpp>
+#include <hadesmem/pelib/delay_import_thunk_list.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+
+#include "main.hpp"
+#include "print.hpp"
+#include "warning.hpp"
+
+namespace
+{
+void DumpDelayImportThunk(hadesmem::DelayImportThunk const& thunk)
+{
+  std::wostream& out = GetOutputStreamW();
+
+  WriteNewline(out);
+  WriteNamedHex(out, L"IatRva", thunk.GetIatRva(), 3);
+  WriteNamedHex(out, L"Function", thunk.GetFunction(), 3);
+  if (thunk.ByOrdinal())
+  {
+    WriteNamedHex(out, L"OrdinalRaw", thunk.GetNameTableEntry(), 3);
+    WriteNamedHex(out, L"Ordinal", thunk.GetOrdinal(), 3);
+  }
+  else if (thunk.IsNameValid())
+  {
+    WriteNamedHex(out, L"AddressOfData", thunk.GetNameTableEntry(), 3);
+    WriteNamedHex(out, L"Hint", thunk.GetHint(), 3);
+    HandleLongOrUnprintableString(L"Name",
+                                  L"delay import thunk name data",
+                                  3,
+                                  WarningType::kSuspicious,
+                                  thunk.GetName());
+  }
+  else
+  {
+    WriteNamedHex(out, L"AddressOfData", thunk.GetNameTableEntry(), 3);
+    WriteNormal(out, L"WARNING! Invalid delay import thunk name data.", 3);
+    WarnForCurrentFile(WarningType::kUnsupported);
+  }
+}
+}
+
+void DumpDelayImports(hadesmem::Process const& process,
+                      hadesmem::PeFile const& pe_file)
+{
+  std::wostream& out = GetOutputStreamW();
+
+  hadesmem::DelayImportDirList const delay_import_dirs(process, pe_file);
+  if (delay_import_dirs.empty())
+  {
+    hadesmem::NtHeaders const nt_headers{process, pe_file};
+    // Don't check size because the loader ignores it.
+    if (nt_headers.GetNumberOfRvaAndSizesClamped() >
+          static_cast<DWORD>(hadesmem::PeDataDir::DelayImport) &&
+        nt_headers.GetDataDirectoryVirtualAddress(
+          hadesmem::PeDataDir::DelayImport))
+    {
+      WriteNewline(out);
+      WriteNormal(out, L"WARNING! Empty or invalid delay import directory.", 1);
+      WarnForCurrentFile(WarningType::kUnsupported);
+    }
+
+    return;
+  }
+
+  WriteNewline(out);
+  WriteNormal(out, L"Delay Import Dirs:", 1);
+
+  for (auto const& dir : delay_import_dirs)
+  {
+    WriteNewline(out);
+
+    WriteNamedHex(out, L"Attributes", dir.GetAttributes(), 2);
+    if (!dir.IsRvaBased())
+    {
+      // Only emitted by very old linkers.
+      WriteNormal(out, L"WARNING! Legacy VA based delay import descriptor.", 2);
+      WarnForCurrentFile(WarningType::kUnsupported);
+    }
+
+    WriteNamedHex(out, L"DllNameRVA", dir.GetDllNameRva(), 2);
+    try
+    {
+      HandleLongOrUnprintableString(L"Name",
+                                    L"delay import module name",
+                                    2,
+                                    WarningType::kSuspicious,
+                                    dir.GetName());
+    }
+    catch (std::exception const& /*e*/)
+    {
+      WriteNormal(out, L"WARNING! Invalid delay import module name.", 2);
+      WarnForCurrentFile(WarningType::kSuspicious);
+    }
+
+    WriteNamedHex(out, L"ModuleHandleRVA", dir.GetModuleHandleRva(), 2);
+    WriteNamedHex(
+      out, L"ImportAddressTableRVA", dir.GetImportAddressTableRva(), 2);
+    WriteNamedHex(out, L"ImportNameTableRVA", dir.GetImportNameTableRva(), 2);
+    WriteNamedHex(out,
+                  L"BoundImportAddressTableRVA",
+                  dir.GetBoundImportAddressTableRva(),
+                  2);
+    WriteNamedHex(out,
+                  L"UnloadInformationTableRVA",
+                  dir.GetUnloadInformationTableRva(),
+                  2);
+    WriteNamedHex(out, L"TimeDateStamp", dir.GetTimeDateStamp(), 2);
+
+    hadesmem::DelayImportThunkList const thunks(process, pe_file, dir);
+    if (thunks.empty())
+    {
+      WriteNormal(out, L"WARNING! Empty or invalid delay import thunks.", 2);
+      WarnForCurrentFile(WarningType::kSuspicious);
+      continue;
+    }
+
+    WriteNewline(out);
+    WriteNormal(out, L"Delay Import Thunks:", 2);
+
+    for (auto const& thunk : thunks)
+    {
+      DumpDelayImportThunk(thunk);
+    }
+  }
+}
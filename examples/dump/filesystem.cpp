@@ -3,6 +3,7 @@
 
 #include "filesystem.hpp"
 
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <iterator>
@@ -13,6 +14,9 @@
 #include <hadesmem/error.hpp>
 #include <hadesmem/pelib/nt_headers.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/mapped_file.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
 #include <hadesmem/process.hpp>
 
 #include "main.hpp"
@@ -26,11 +30,13 @@ void DumpFile(std::wstring const& path)
 
     SetCurrentFilePath(path);
 
-    std::vector<char> buf;
+    // Map the file rather than reading all of it, as most of the time only a
+    // small part of it (the headers, tables, etc.) is actually touched.
+    hadesmem::pelib::BufferSource source;
 
     try
     {
-      buf = hadesmem::detail::PeFileToBuffer(path);
+      source = hadesmem::pelib::MapFileSource(path);
     }
     catch (std::bad_alloc const&)
     {
@@ -39,29 +45,52 @@ void DumpFile(std::wstring const& path)
       WarnForCurrentFile(WarningType::kUnsupported);
       return;
     }
+    catch (hadesmem::Error const& e)
+    {
+      // The file doesn't fit in the address space.
+      auto const last_error_ptr =
+        boost::get_error_info<hadesmem::ErrorCodeWinLast>(e);
+      if (last_error_ptr && (*last_error_ptr == ERROR_FILE_TOO_LARGE ||
+                             *last_error_ptr == ERROR_NOT_ENOUGH_MEMORY))
+      {
+        WriteNewline(out);
+        WriteNormal(out, L"WARNING! File too large.", 0);
+        WarnForCurrentFile(WarningType::kUnsupported);
+      }
+
+      return;
+    }
     catch (...)
     {
       return;
     }
 
-    hadesmem::Process const process(GetCurrentProcessId());
-
-    hadesmem::PeFile const pe_file(process,
-                                   buf.data(),
-                                   hadesmem::PeFileType::kData,
-                                   static_cast<DWORD>(buf.size()));
-
-    try
+    // Check for the MZ signature before doing anything else (most files in a
+    // corpus scan aren't PE files).
+    if (source.GetSize() < 2 || source.GetData()[0] != 'M' ||
+        source.GetData()[1] != 'Z')
     {
-      hadesmem::NtHeaders const nt_hdr(process, pe_file);
+      return;
     }
-    catch (std::exception const& /*e*/)
+
+    // Same validation as NtHeaders, but without throwing, as files which
+    // fail it are common in a corpus scan.
+    if (!hadesmem::pelib::PeView::TryParse(source,
+                                           hadesmem::PeFileType::kData))
     {
       WriteNewline(out);
       WriteNormal(out, L"Not a PE file or wrong architecture (Pass 2).", 0);
       return;
     }
 
+    hadesmem::PeFile const pe_file(source, hadesmem::PeFileType::kData);
+
+    // TODO: Remove this once the directory types (exports, imports, etc.) can
+    // be used without a Process too. Reading the mapping through our own
+    // process in the meantime is fine, as it's the same memory the PeFile
+    // parses.
+    hadesmem::Process const process(GetCurrentProcessId());
+
     DumpPeFile(process, pe_file, path);
   }
   catch (...)
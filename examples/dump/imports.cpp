@@ -11,6 +11,7 @@
 #include <hadesmem/pelib/import_dir_list.hpp>
 #include <hadesmem/pelib/import_thunk.hpp>
 #include <hadesmem/pelib/import_thunk_list.hpp>
+#include <hadesmem/pelib/import_thunk_pair_list.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/process.hpp>
 
@@ -33,10 +34,6 @@
 // TODO: Check whether a new style forwarder chain with no bound imports is
 // actually allowed/loaded.
 
-// TODO: Parse the IAT and ILT in parallel, in order to easily detect when
-// imports are bound in-memory. This will also mean we no longer need to count
-// the length of the ILT in order to terminate the IAT pass early.
-
 // TODO: Should probably revert to using 'is_ilt_bound' instead of hardcoding
 // false for the initial DumpImportThunk loop, but is it even legal to have a
 // module that uses old style bindings with no ILT? Need to investigate, because
@@ -50,7 +47,7 @@
 // (I believe that they do, so our code is wrong!)
 
 // TODO: Check that the logic for the second DumpImportThunk loop is correct.
-// ("(is_iat_bound && ilt_valid) || !ilt_empty")
+// ("is_iat_bound && ilt_valid")
 
 namespace
 {
@@ -349,10 +346,56 @@ void DumpImports(hadesmem::Process const& process,
       DumpImportThunk(thunk, is_image_iat);
     }
 
+    // The loader walks the ILT and IAT in parallel and stops at the end of the
+    // ILT, so the IAT is dumped the same way rather than up to its own
+    // terminator.
+    if (use_ilt && iat && !ilt_empty)
+    {
+      hadesmem::ImportThunkPairList const thunk_pairs(
+        process, pe_file, ilt, iat);
+      if (!thunk_pairs.empty())
+      {
+        WriteNewline(out);
+        WriteNormal(out, L"Import Thunks (IAT)", 2);
+      }
+      std::size_t iat_count = 0U;
+      for (auto const& thunk_pair : thunk_pairs)
+      {
+        // Already warned about in the ILT pass.
+        if (iat_count++ == 10000)
+        {
+          break;
+        }
+
+        // If the ILT is not empty (empty includes invalid) we simply treat the
+        // IAT as bound, regardless of whether it actually is. This is because
+        // apparently as long as you have a valid ILT you can put whatever the
+        // hell you want in the IAT, because it's going to be overwitten anyway.
+        // See tinynet.exe from the Corkami PE corpus for an example.
+        DumpImportThunk(thunk_pair.GetIat(), true);
+      }
+
+      if (!thunk_pairs.IsIatTerminated())
+      {
+        WriteNewline(out);
+        WriteNormal(out, L"WARNING! IAT size does not match ILT size.", 2);
+        // Apparently some legitimate (but strange) files do this. Probably in
+        // order to save some space because you seemingly don't need the null
+        // padding in practice as the Windows loader enumerates both
+        // directories in parallel and will stop when it reaches the end of
+        // the ILT, it doesn't actually care if the IAT is terminated or not.
+        // Sample: pdfinfo.exe (from Git)
+        // TODO: Investigate further and double-check the above assumption,
+        // and also figure out whether there's some way we can narrow the
+        // scope of the warning to let through legitimate files while still
+        // warning on suspicious ones.
+        WarnForCurrentFile(WarningType::kSuspicious);
+      }
+    }
     // Windows will load PE files that have an invalid RVA for the ILT (lies
     // outside of the virtual space), and will fall back to the IAT in this
     // case.
-    if (use_ilt && iat)
+    else if (use_ilt && iat)
     {
       hadesmem::ImportThunkList const iat_thunks(
         process, pe_file, dir.GetFirstThunk());
@@ -370,32 +413,17 @@ void DumpImports(hadesmem::Process const& process,
                       L"WARNING! IAT size does not match ILT size. Stopping "
                       L"IAT enumeration early.",
                       2);
-          // Apparently some legitimate (but strange) files do this. Probably in
-          // order to save some space because you seemingly don't need the null
-          // padding in practice as the Windows loader enumerates both
-          // directories in parallel and will stop when it reaches the end of
-          // the ILT, it doesn't actually care if the IAT is terminated or not.
-          // Sample: pdfinfo.exe (from Git)
-          // TODO: Investigate further and double-check the above assumption,
-          // and also figure out whether there's some way we can narrow the
-          // scope of the warning to let through legitimate files while still
-          // warning on suspicious ones.
           WarnForCurrentFile(WarningType::kSuspicious);
           break;
         }
 
-        // If the ILT is not empty (empty includes invalid) we simply treat the
-        // IAT as bound, regardless of whether it actually is. This is because
-        // apparently as long as you have a valid ILT you can put whatever the
-        // hell you want in the IAT, because it's going to be overwitten anyway.
-        // See tinynet.exe from the Corkami PE corpus for an example.
-        // Furthermore, we only treat the IAT as bound if the ILT is also valid.
+        // We only treat the IAT as bound if the ILT is valid.
         // Not sure if this is correct, but apparently it's possible to have a
         // module with the TimeDateStamp set, indicating that the module is
         // bound, even though it actually isn't (and XP will apparently load
         // such a module). See tinygui.exe from the Corkami PE corpus for an
         // example.
-        DumpImportThunk(thunk, (is_iat_bound && ilt_valid) || !ilt_empty);
+        DumpImportThunk(thunk, is_iat_bound && ilt_valid);
       }
     }
   }
@@ -48,6 +48,7 @@
 #include <hadesmem/thread_entry.hpp>
 
 #include "bound_imports.hpp"
+#include "delay_imports.hpp"
 #include "exports.hpp"
 #include "filesystem.hpp"
 #include "headers.hpp"
@@ -55,6 +56,7 @@
 #include "overlay.hpp"
 #include "print.hpp"
 #include "relocations.hpp"
+#include "resources.hpp"
 #include "sections.hpp"
 #include "strings.hpp"
 #include "tls.hpp"
@@ -71,10 +73,6 @@
 
 // TODO: Add PEID DB support.
 
-// TODO: Implement resources dumping support.
-// 	http://www.brokenthorn.com/Resources/OSDevPE.html
-// 	http://blogs.msdn.com/b/oldnewthing/archive/2012/07/20/10331787.aspx
-
 // TODO: Implement debug dumping support.
 
 // TODO: Implement .NET dumping support.
@@ -463,6 +461,8 @@ void DumpPeFile(hadesmem::Process const& process,
 
   DumpTls(process, pe_file);
 
+  DumpResources(process, pe_file);
+
   DumpExports(process, pe_file);
 
   bool has_new_bound_imports_any = false;
@@ -470,6 +470,8 @@ void DumpPeFile(hadesmem::Process const& process,
 
   DumpBoundImports(process, pe_file, has_new_bound_imports_any);
 
+  DumpDelayImports(process, pe_file);
+
   DumpRelocations(process, pe_file);
 
   if (!g_quiet && g_strings)
@@ -610,6 +612,10 @@ int main(int argc, char* argv[])
       "Add new section to contain reconstructed imports (as opposed to being "
       "appended to the existing last section)",
       cmd);
+    TCLAP::SwitchArg fix_checksum_arg(
+      "", "fix-checksum", "Recalculate the PE checksum of memory dumps", cmd);
+    TCLAP::SwitchArg strip_dos_stub_arg(
+      "", "strip-dos-stub", "Strip the DOS stub from memory dumps", cmd);
     TCLAP::ValueArg<std::string> module_name_arg(
       "", "module-name", "Module to dump", false, "", "string", cmd);
     TCLAP::ValueArg<std::uintptr_t> module_base_arg(
@@ -648,6 +654,12 @@ int main(int argc, char* argv[])
     g_flags |= add_new_section_arg.isSet()
                  ? hadesmem::detail::DumpFlags::kAddNewSection
                  : 0;
+    g_flags |= fix_checksum_arg.isSet()
+                 ? hadesmem::detail::DumpFlags::kFixChecksum
+                 : 0;
+    g_flags |= strip_dos_stub_arg.isSet()
+                 ? hadesmem::detail::DumpFlags::kStripDosStub
+                 : 0;
     g_oep = oep_arg.getValue();
     g_module_name =
       hadesmem::detail::MultiByteToWideChar(module_name_arg.getValue());
@@ -0,0 +1,64 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include "resources.hpp"
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/resource_dir.hpp>
+#include <hadesmem/process.hpp>
+
+#include "main.hpp"
+#include "print.hpp"
+#include "warning.hpp"
+
+void DumpResources(hadesmem::Process const& process,
+                   hadesmem::PeFile const& pe_file)
+{
+  std::unique_ptr<hadesmem::ResourceDir const> resource_dir;
+  try
+  {
+    resource_dir = std::make_unique<hadesmem::ResourceDir>(process, pe_file);
+  }
+  catch (std::exception const& /*e*/)
+  {
+    return;
+  }
+
+  std::wostream& out = GetOutputStreamW();
+
+  WriteNewline(out);
+  WriteNormal(out, L"Resources:", 1);
+
+  std::vector<hadesmem::Resource> resources;
+  try
+  {
+    resources = resource_dir->GetResources();
+  }
+  catch (std::exception const& /*e*/)
+  {
+    WriteNewline(out);
+    WriteNormal(out, L"WARNING! Resource directory is invalid.", 2);
+    WarnForCurrentFile(WarningType::kSuspicious);
+    return;
+  }
+
+  for (auto const& r : resources)
+  {
+    WriteNewline(out);
+    WriteNamedNormal(out, L"Type", r.type, 2);
+    WriteNamedNormal(out, L"Name", r.name, 2);
+    WriteNamedNormal(out, L"Language", r.language, 2);
+    WriteNamedHex(out, L"OffsetToData", r.data.GetOffsetToData(), 2);
+    WriteNamedHex(out, L"Size", r.data.GetSize(), 2);
+    WriteNamedHex(out, L"CodePage", r.data.GetCodePage(), 2);
+    if (!hadesmem::RvaToVa(process, pe_file, r.data.GetOffsetToData()))
+    {
+      WriteNormal(out, L"WARNING! Resource data is invalid.", 2);
+      WarnForCurrentFile(WarningType::kSuspicious);
+    }
+  }
+}
@@ -0,0 +1,445 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/read_cache.hpp>
+#include <hadesmem/detail/read_impl.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+
+// TODO: Support larger/variable page sizes (e.g. caching entire small regions
+// in one go, or using large pages where the target does).
+
+// TODO: Add a prefetch API so callers which know what they are about to walk
+// (e.g. PeFile headers) can fill a run of pages with a single read.
+
+namespace hadesmem
+{
+namespace detail
+{
+struct CachedPage
+{
+  static std::uintptr_t const kSize = 0x1000;
+
+  std::uintptr_t base;
+  std::array<std::uint8_t, kSize> data;
+};
+
+// LRU cache of whole pages. Pages are held by shared_ptr so callers can keep
+// a page alive (and unchanged) after it has been evicted or invalidated.
+class PageCache : public ReadCache
+{
+public:
+  explicit PageCache(std::size_t capacity) : capacity_{capacity}
+  {
+    HADESMEM_DETAIL_ASSERT(capacity_ != 0);
+  }
+
+  virtual bool Read(Process const& process,
+                    void* address,
+                    void* data,
+                    std::size_t len,
+                    std::uint32_t flags) override
+  {
+    // Zero filled pages are not real data, so don't let them poison the cache
+    // for later reads which don't ask for zero filling.
+    if (!!(flags & ReadFlags::kZeroFillReserved))
+    {
+      return false;
+    }
+
+    auto cur = reinterpret_cast<std::uintptr_t>(address);
+    auto out = static_cast<std::uint8_t*>(data);
+
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    while (len)
+    {
+      std::uintptr_t const base = PageDown(cur);
+      auto const offset = static_cast<std::size_t>(cur - base);
+      std::size_t const cur_len = (std::min)(len, CachedPage::kSize - offset);
+
+      auto const page = GetPageUnlocked(process, base);
+      std::memcpy(out, page->data.data() + offset, cur_len);
+
+      cur += cur_len;
+      out += cur_len;
+      len -= cur_len;
+    }
+
+    return true;
+  }
+
+  // Cached pages are never modified in place (invalidation drops them and a
+  // later miss allocates a new page), so a pinned page is a stable snapshot.
+  // Ranges which cross a page boundary aren't contiguous in the cache.
+  virtual std::shared_ptr<void const> Pin(Process const& process,
+                                          void* address,
+                                          std::size_t len,
+                                          void const*& data) override
+  {
+    auto const address_raw = reinterpret_cast<std::uintptr_t>(address);
+    std::uintptr_t const base = PageDown(address_raw);
+    auto const offset = static_cast<std::size_t>(address_raw - base);
+    if (!len || len > CachedPage::kSize - offset)
+    {
+      return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    auto const page = GetPageUnlocked(process, base);
+    data = page->data.data() + offset;
+    return page;
+  }
+
+  virtual void OnWrite(void const* address, std::size_t len) override
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    if (!frozen_)
+    {
+      InvalidateUnlocked(address, len);
+    }
+  }
+
+  virtual void InvalidateAll() noexcept override
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    pages_.clear();
+    lru_.clear();
+  }
+
+  std::shared_ptr<CachedPage const> GetPage(Process const& process,
+                                            void const* address)
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    return GetPageUnlocked(process,
+                           PageDown(reinterpret_cast<std::uintptr_t>(address)));
+  }
+
+  void Invalidate(void const* address, std::size_t len)
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    InvalidateUnlocked(address, len);
+  }
+
+  void Freeze()
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    frozen_ = true;
+  }
+
+  void Thaw()
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    frozen_ = false;
+    EvictUnlocked();
+  }
+
+  bool IsFrozen() const
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    return frozen_;
+  }
+
+  std::size_t GetCapacity() const
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    return capacity_;
+  }
+
+  std::size_t GetSize() const
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    return pages_.size();
+  }
+
+  std::uint64_t GetHits() const
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    return hits_;
+  }
+
+  std::uint64_t GetMisses() const
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    return misses_;
+  }
+
+  void ResetCounters()
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    hits_ = 0;
+    misses_ = 0;
+  }
+
+private:
+  using PageList = std::list<std::shared_ptr<CachedPage>>;
+
+  static std::uintptr_t PageDown(std::uintptr_t address) noexcept
+  {
+    return address & ~(CachedPage::kSize - 1);
+  }
+
+  std::shared_ptr<CachedPage const> GetPageUnlocked(Process const& process,
+                                                    std::uintptr_t base)
+  {
+    auto const iter = pages_.find(base);
+    if (iter != std::end(pages_))
+    {
+      ++hits_;
+      lru_.splice(std::begin(lru_), lru_, iter->second);
+      return *iter->second;
+    }
+
+    ++misses_;
+
+    // Pages never straddle a region, so a whole page fill can only fail if
+    // the requested bytes themselves are unreadable.
+    auto page = std::make_shared<CachedPage>();
+    page->base = base;
+    ReadImplUncached(process,
+                     reinterpret_cast<void*>(base),
+                     page->data.data(),
+                     page->data.size());
+
+    lru_.push_front(page);
+    try
+    {
+      pages_[base] = std::begin(lru_);
+    }
+    catch (...)
+    {
+      lru_.pop_front();
+      throw;
+    }
+
+    EvictUnlocked();
+
+    return page;
+  }
+
+  void InvalidateUnlocked(void const* address, std::size_t len)
+  {
+    if (!len)
+    {
+      return;
+    }
+
+    auto const beg = reinterpret_cast<std::uintptr_t>(address);
+    std::uintptr_t const last = PageDown(beg + (len - 1));
+
+    // Walk whichever is smaller, the range or the cache, so invalidating a
+    // huge range (e.g. an entire module) doesn't touch every page in it.
+    if ((last - PageDown(beg)) / CachedPage::kSize < pages_.size())
+    {
+      for (std::uintptr_t base = PageDown(beg);; base += CachedPage::kSize)
+      {
+        auto const iter = pages_.find(base);
+        if (iter != std::end(pages_))
+        {
+          lru_.erase(iter->second);
+          pages_.erase(iter);
+        }
+
+        if (base == last)
+        {
+          break;
+        }
+      }
+    }
+    else
+    {
+      for (auto iter = std::begin(lru_); iter != std::end(lru_);)
+      {
+        std::uintptr_t const base = (*iter)->base;
+        if (base >= PageDown(beg) && base <= last)
+        {
+          pages_.erase(base);
+          iter = lru_.erase(iter);
+        }
+        else
+        {
+          ++iter;
+        }
+      }
+    }
+  }
+
+  void EvictUnlocked() noexcept
+  {
+    // A frozen cache is a snapshot, so it must hold on to everything it has
+    // seen regardless of capacity.
+    if (frozen_)
+    {
+      return;
+    }
+
+    while (pages_.size() > capacity_)
+    {
+      pages_.erase(lru_.back()->base);
+      lru_.pop_back();
+    }
+  }
+
+  mutable std::mutex mutex_;
+  std::size_t capacity_;
+  bool frozen_{};
+  std::uint64_t hits_{};
+  std::uint64_t misses_{};
+  PageList lru_;
+  std::unordered_map<std::uintptr_t, PageList::iterator> pages_;
+};
+}
+
+// Process which serves reads from an LRU cache of whole pages. Usable anywhere
+// a Process const& is accepted, and primarily intended for repeated structure
+// walks (e.g. PeLib) against remote processes. Hits and misses are counted per
+// page touched.
+//
+// Writes made through this object invalidate the affected pages. When frozen
+// the cache behaves as a lazily populated snapshot: pages are never evicted or
+// invalidated by writes (only by an explicit call to Invalidate or
+// InvalidateAll), and pages which have not yet been seen are fetched from the
+// live process on first use.
+class CachedProcess : public Process
+{
+public:
+  static std::size_t const kDefaultCapacity = 256;
+
+  explicit CachedProcess(DWORD id, std::size_t capacity = kDefaultCapacity)
+    : Process{id}, cache_{std::make_unique<detail::PageCache>(capacity)}
+  {
+    SetReadCache(cache_.get());
+  }
+
+  explicit CachedProcess(Process const& process,
+                         std::size_t capacity = kDefaultCapacity)
+    : Process{process}, cache_{std::make_unique<detail::PageCache>(capacity)}
+  {
+    SetReadCache(cache_.get());
+  }
+
+  CachedProcess(CachedProcess const& other) = delete;
+
+  CachedProcess& operator=(CachedProcess const& other) = delete;
+
+  CachedProcess(CachedProcess&& other) noexcept
+    : Process{std::move(other)},
+      cache_{std::move(other.cache_)}
+  {
+    SetReadCache(cache_.get());
+    other.SetReadCache(nullptr);
+  }
+
+  CachedProcess& operator=(CachedProcess&& other) noexcept
+  {
+    SetReadCache(nullptr);
+
+    Process::operator=(std::move(other));
+    cache_ = std::move(other.cache_);
+
+    SetReadCache(cache_.get());
+    other.SetReadCache(nullptr);
+
+    return *this;
+  }
+
+  ~CachedProcess()
+  {
+    // The base destructor runs after cache_ has been destroyed.
+    SetReadCache(nullptr);
+  }
+
+  void Invalidate(PVOID address, std::size_t len)
+  {
+    HADESMEM_DETAIL_ASSERT(cache_);
+    cache_->Invalidate(address, len);
+  }
+
+  void InvalidateAll() noexcept
+  {
+    HADESMEM_DETAIL_ASSERT(cache_);
+    cache_->InvalidateAll();
+  }
+
+  void Freeze()
+  {
+    HADESMEM_DETAIL_ASSERT(cache_);
+    cache_->Freeze();
+  }
+
+  void Thaw()
+  {
+    HADESMEM_DETAIL_ASSERT(cache_);
+    cache_->Thaw();
+  }
+
+  bool IsFrozen() const
+  {
+    HADESMEM_DETAIL_ASSERT(cache_);
+    return cache_->IsFrozen();
+  }
+
+  std::size_t GetCapacity() const
+  {
+    HADESMEM_DETAIL_ASSERT(cache_);
+    return cache_->GetCapacity();
+  }
+
+  std::size_t GetCachedPageCount() const
+  {
+    HADESMEM_DETAIL_ASSERT(cache_);
+    return cache_->GetSize();
+  }
+
+  std::uint64_t GetHits() const
+  {
+    HADESMEM_DETAIL_ASSERT(cache_);
+    return cache_->GetHits();
+  }
+
+  std::uint64_t GetMisses() const
+  {
+    HADESMEM_DETAIL_ASSERT(cache_);
+    return cache_->GetMisses();
+  }
+
+  void ResetCounters()
+  {
+    HADESMEM_DETAIL_ASSERT(cache_);
+    cache_->ResetCounters();
+  }
+
+private:
+  std::unique_ptr<detail::PageCache> cache_;
+};
+}
@@ -818,14 +818,15 @@ inline Allocator GenerateCallCode(Process const& process,
   HADESMEM_DETAIL_TRACE_A("GenerateCallCode called.");
 
   Module const kernel32{process, L"kernel32.dll"};
+  detail::ExportCache export_cache{process};
   auto const get_last_error = reinterpret_cast<DWORD_PTR>(
-    FindProcedure(process, kernel32, "GetLastError"));
+    FindProcedure(export_cache, kernel32, "GetLastError"));
   auto const set_last_error = reinterpret_cast<DWORD_PTR>(
-    FindProcedure(process, kernel32, "SetLastError"));
+    FindProcedure(export_cache, kernel32, "SetLastError"));
   auto const is_debugger_present = reinterpret_cast<DWORD_PTR>(
-    FindProcedure(process, kernel32, "IsDebuggerPresent"));
-  auto const debug_break =
-    reinterpret_cast<DWORD_PTR>(FindProcedure(process, kernel32, "DebugBreak"));
+    FindProcedure(export_cache, kernel32, "IsDebuggerPresent"));
+  auto const debug_break = reinterpret_cast<DWORD_PTR>(
+    FindProcedure(export_cache, kernel32, "DebugBreak"));
 
   asmjit::JitRuntime runtime;
   asmjit::X86Assembler assembler{&runtime};
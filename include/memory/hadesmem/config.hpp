@@ -5,7 +5,9 @@
 
 #include <memory>
 
+#if defined(_WIN32)
 #include <windows.h>
+#endif // #if defined(_WIN32)
 
 #include <hadesmem/detail/static_assert.hpp>
 
@@ -25,15 +27,17 @@
   HADESMEM_DETAIL_VERSION_STRING_GEN(                                          \
     HADESMEM_VERSION_MAJOR, HADESMEM_VERSION_MINOR, HADESMEM_VERSION_PATCH)
 
-#if defined(_M_IX86)
+// The non-MSVC checks are only for the OS-independent parts of the library
+// (e.g. the PeLib views), which are also built on other platforms.
+#if defined(_M_IX86) || defined(__i386__)
 #define HADESMEM_DETAIL_ARCH_X86
-#elif defined(_M_AMD64)
+#elif defined(_M_AMD64) || defined(__x86_64__)
 #define HADESMEM_DETAIL_ARCH_X64
-#else // #if defined(_M_IX86)
-// #elif defined(_M_AMD64)
+#else // #if defined(_M_IX86) || defined(__i386__)
+// #elif defined(_M_AMD64) || defined(__x86_64__)
 #error "[HadesMem] Unsupported architecture."
-#endif // #if defined(_M_IX86)
-// #elif defined(_M_AMD64)
+#endif // #if defined(_M_IX86) || defined(__i386__)
+// #elif defined(_M_AMD64) || defined(__x86_64__)
 
 #if !(defined(HADESMEM_DETAIL_ARCH_X64) ||                                     \
       (defined(HADESMEM_DETAIL_ARCH_X86) && _M_IX86_FP >= 2))
@@ -41,10 +45,33 @@
 #endif // !(defined(HADESMEM_DETAIL_ARCH_X64) ||
        // (defined(HADESMEM_DETAIL_ARCH_X86) && _M_IX86_FP >= 2))
 
+// SSE2 is always available on x64, but on x86 only if the compiler has been
+// told it can use it.
+#if defined(HADESMEM_DETAIL_ARCH_X64) || (_M_IX86_FP >= 2) || defined(__SSE2__)
+#define HADESMEM_DETAIL_SSE2
+#endif // #if defined(HADESMEM_DETAIL_ARCH_X64) || (_M_IX86_FP >= 2) ||
+       // defined(__SSE2__)
+
+// SHA-NI is only used after a runtime CPUID check, so just needs compiler
+// support. MSVC allows the intrinsics to be used anywhere, whereas GCC and
+// Clang need them enabled per function (via HADESMEM_DETAIL_TARGET_SHA_NI).
+#if defined(HADESMEM_DETAIL_SSE2) &&                                           \
+  ((defined(_MSC_VER) && _MSC_VER >= 1900) || defined(__GNUC__))
+#define HADESMEM_DETAIL_SHA_NI
+#if defined(_MSC_VER)
+#define HADESMEM_DETAIL_TARGET_SHA_NI
+#else // #if defined(_MSC_VER)
+#define HADESMEM_DETAIL_TARGET_SHA_NI __attribute__((target("sha,sse4.1")))
+#endif // #if defined(_MSC_VER)
+#endif // #if defined(HADESMEM_DETAIL_SSE2) &&
+       // ((defined(_MSC_VER) && _MSC_VER >= 1900) || defined(__GNUC__))
+
 // Approximate equivalent of MAX_PATH for Unicode APIs.
 // See: http://bit.ly/17CCZFX
 #define HADESMEM_DETAIL_MAX_PATH_UNICODE (1 << 15)
 
+#if defined(_WIN32)
+
 // Every effort is made to NOT assume the below is true across the entire
 // codebase, but for the Call module it is unavoidable. If adding support for
 // another architecture, this may need adjusting. However, if anywhere other
@@ -62,3 +89,5 @@ HADESMEM_DETAIL_STATIC_ASSERT(sizeof(double) == sizeof(DWORD64));
 // when manually implementing functions such as GetProcAddress, which is
 // required by the Injector.
 HADESMEM_DETAIL_STATIC_ASSERT(sizeof(FARPROC) == sizeof(void*));
+
+#endif // #if defined(_WIN32)
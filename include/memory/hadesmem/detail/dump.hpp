@@ -4,9 +4,9 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <limits>
 #include <map>
 #include <tuple>
 
@@ -30,6 +30,11 @@
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/pelib/section.hpp>
 #include <hadesmem/pelib/section_list.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/mapped_file.hpp>
+#include <hadesmem/pelib/view/pe_builder.hpp>
+#include <hadesmem/pelib/view/pe_hash.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
 #include <hadesmem/process.hpp>
 #include <hadesmem/process_helpers.hpp>
 #include <hadesmem/region.hpp>
@@ -55,7 +60,9 @@ struct DumpFlags
     kUseOriginalImagePath = 1 << 1,
     kReconstructImports = 1 << 2,
     kAddNewSection = 1 << 3,
-    kInvalidFlagMaxValue = 1 << 4,
+    kFixChecksum = 1 << 4,
+    kStripDosStub = 1 << 5,
+    kInvalidFlagMaxValue = 1 << 6,
   };
 };
 
@@ -280,7 +287,7 @@ struct ModuleLight
               void* imagebase,
               bool use_original_image_path)
     : process_{process},
-      pe_file_{process_, base, PeFileType::kImage, static_cast<DWORD>(size)},
+      pe_file_{process_, base, PeFileType::kImage, size},
       path_{GetRegionPath(process, base, imagebase, use_original_image_path)},
       name_{MakeNameFromPath(path_)},
       priority_{GetModulePriority(name_, path_)}
@@ -318,12 +325,15 @@ struct ModuleLight
   {
     try
     {
-      auto buffer = PeFileToBuffer(path_);
+      // Only the headers are touched, so map the file rather than reading
+      // all of it.
+      auto const source =
+        pelib::MapFileSource(path_, pelib::MappedFileAccess::kRandom);
       Process local_process{::GetCurrentProcessId()};
       PeFile pe_file{local_process,
-                     buffer.data(),
+                     const_cast<std::uint8_t*>(source.GetData()),
                      PeFileType::kData,
-                     static_cast<DWORD>(buffer.size())};
+                     source.GetSize()};
       NtHeaders nt_headers{local_process, pe_file};
       return true;
     }
@@ -508,6 +518,10 @@ private:
 
     HADESMEM_DETAIL_TRACE_A("Building export map.");
 
+    // Shared across all modules so each forwarder target's exports are only
+    // read and indexed once.
+    ExportCache export_cache{*process_};
+
     for (auto const& m : process_info.modules_)
     {
       HADESMEM_DETAIL_TRACE_FORMAT_W(L"Module: [%s].", m.name_.c_str());
@@ -567,7 +581,7 @@ private:
 
             // TODO: Detect and handle cases where imports have been shimmed?
 
-            va = GetProcAddressFromExport(*process_, e);
+            va = export_cache.GetProcAddressFromExport(e);
 
             auto forwarder_module_name = e.GetForwarderModule();
             forwarder_module_name =
@@ -684,184 +698,103 @@ private:
     return process_info;
   }
 
-  struct SectionData
-  {
-    DWORD raw_data_;
-    DWORD raw_size_;
-    DWORD virtual_size_;
-  };
-
-  std::vector<SectionData> CopySectionData(Process const& local_process,
-                                           PeFile const& pe_file_headers,
-                                           NtHeaders const& nt_headers,
-                                           std::vector<std::uint8_t>& raw_new,
-                                           std::vector<std::uint8_t> const& raw)
+  void FixSections(pelib::PeBuilder& builder,
+                   pelib::PeView const& pe_view_headers,
+                   std::vector<std::uint8_t> const& raw)
   {
-    HADESMEM_DETAIL_TRACE_A("Copying section data.");
+    HADESMEM_DETAIL_TRACE_A("Fixing sections.");
 
-    std::vector<SectionData> section_datas;
-
-    SectionList const sections(local_process, pe_file_headers);
-    for (auto const& section : sections)
+    for (std::size_t i = 0; i < builder.GetNumberOfSections(); ++i)
     {
+      auto const section = builder.GetSectionHeader(i);
       HADESMEM_DETAIL_TRACE_FORMAT_A(
         "VirtualAddress: [%08lX]. PointerToRawData: [%08lX].",
-        section.GetVirtualAddress(),
-        section.GetPointerToRawData());
+        section.VirtualAddress,
+        section.PointerToRawData);
 
       // TODO: Do some validation here based on memory layout?
       // TODO: Ensure all the crazy scenarios like overlapping virtual sections,
       // bogus header sizes and pointers, etc. all work.
-      // TODO: When rounding up from raw to virtual, we should check for
-      // zero-fill at the end and then drop as much data as possible in order to
-      // reduce file size.
       // TODO: Validate section virtual sizes against the VA region sizes?
       // TODO: Automatically align sections? (e.g. Bump section virtual size
       // from 0x400 to 0x1000).
       // TODO: It's not always correct to use VirtualSize here. It's great for
       // analysis reasons, but if you want runnable dumps some programs might
       // rely on that virtual space to be zero'd out at runtime.
-      auto const section_size = static_cast<DWORD>(RoundUp(
-        (std::max)(section.GetVirtualSize(), section.GetSizeOfRawData()),
-        nt_headers.GetSectionAlignment()));
-      auto const ptr_raw_data_new_tmp =
-        section.GetPointerToRawData() < raw_new.size()
-          ? static_cast<DWORD>(
-              RoundUp(raw_new.size(), nt_headers.GetFileAlignment()))
-          : section.GetPointerToRawData();
-      auto const ptr_raw_data_new = static_cast<DWORD>(
-        RoundUp(ptr_raw_data_new_tmp, nt_headers.GetFileAlignment()));
-
-      HADESMEM_DETAIL_TRACE_FORMAT_A(
-        "New PointerToRawData: [%08lX]. New SizeOfRawData: [%08lX].",
-        ptr_raw_data_new,
-        section_size);
+      auto const section_size = static_cast<DWORD>(
+        RoundUp((std::max)(section.VirtualSize, section.SizeOfRawData),
+                pe_view_headers.GetSectionAlignment()));
 
-      if (ptr_raw_data_new > raw_new.size())
-      {
-        raw_new.resize(ptr_raw_data_new);
-      }
-
-      section_datas.emplace_back(
-        SectionData{ptr_raw_data_new, section_size, section_size});
-
-      if (section.GetVirtualAddress() >= raw.size())
+      if (section.VirtualAddress >= raw.size())
       {
         HADESMEM_DETAIL_TRACE_A("WARNING! Not writing any data for current "
                                 "section due to out-of-bounds VA.");
+        builder.SetSectionData(i, nullptr, 0);
+        builder.ResizeSection(i, 0, section_size);
         continue;
       }
 
-      auto const raw_data = raw.data() + section.GetVirtualAddress();
-      auto const raw_data_end =
-        (std::min)(raw_data + section_size, raw.data() + raw.size());
-      if (raw_data_end != raw_data + section_size)
+      auto const raw_data = raw.data() + section.VirtualAddress;
+      auto const data_size = (std::min)(
+        static_cast<std::size_t>(section_size),
+        raw.size() - static_cast<std::size_t>(section.VirtualAddress));
+      if (data_size != section_size)
       {
         HADESMEM_DETAIL_TRACE_A("WARNING! Truncating read for current section "
                                 "due to out-of-bounds VA.");
       }
 
-      auto const new_size = raw_new.size() + section_size;
-      raw_new.reserve(new_size);
-      std::copy(raw_data, raw_data_end, std::back_inserter(raw_new));
-      raw_new.resize(new_size);
-
-      auto raw_section_size = section_size;
-      for (auto p = raw_new.data() + raw_new.size() - sizeof(std::uint32_t);
-           (p >
-            raw_new.data() + ptr_raw_data_new + section.GetSizeOfRawData()) &&
-           *reinterpret_cast<std::uint32_t*>(p);
-           p -= sizeof(std::uint32_t))
+      // Drop the zero fill at the end of the section (which the loader will
+      // restore anyway), but never any of the original raw data.
+      auto raw_size = data_size;
+      while (raw_size > section.SizeOfRawData && !raw_data[raw_size - 1])
       {
-        raw_section_size -= sizeof(std::uint32_t);
+        --raw_size;
       }
 
-      raw_section_size = static_cast<DWORD>(
-        RoundUp(raw_section_size, nt_headers.GetFileAlignment()));
-
-      section_datas.back().raw_size_ = raw_section_size;
-    }
-
-    return section_datas;
-  }
-
-  void FixSectionHeaders(SectionList& sections_new,
-                         std::vector<SectionData> const& section_datas)
-  {
-    HADESMEM_DETAIL_TRACE_A("Fixing section headers.");
+      HADESMEM_DETAIL_TRACE_FORMAT_A(
+        "New SizeOfRawData: [%08IX]. New VirtualSize: [%08lX].",
+        raw_size,
+        section_size);
 
-    std::size_t n = 0;
-    for (auto& section : sections_new)
-    {
-      HADESMEM_DETAIL_TRACE_FORMAT_A("PointerToRawData: [%08lX] -> [%08lX]. "
-                                     "SizeOfRawData: [%08lX] -> [%08lX]. "
-                                     "VirtualSize: [%08lX] -> [%08lX].",
-                                     section.GetPointerToRawData(),
-                                     section_datas[n].raw_data_,
-                                     section.GetSizeOfRawData(),
-                                     section_datas[n].raw_size_,
-                                     section.GetVirtualSize(),
-                                     section_datas[n].virtual_size_);
-
-      section.SetPointerToRawData(section_datas[n].raw_data_);
-      section.SetSizeOfRawData(section_datas[n].raw_size_);
-      section.SetVirtualSize(section_datas[n].virtual_size_);
-      section.UpdateWrite();
-      ++n;
+      builder.SetSectionData(i, raw_data, raw_size);
+      builder.ResizeSection(
+        i, static_cast<std::uint32_t>(raw_size), section_size);
     }
   }
 
-  NtHeaders FixNtHeaders(Process const& local_process,
-                         PeFile const& pe_file_new,
-                         void* base,
-                         bool has_disk_headers,
-                         std::unique_ptr<PeFile> const& pe_file_disk)
+  void FixNtHeaders(pelib::PeBuilder& builder,
+                    pelib::PeView const& pe_view_headers,
+                    void* base)
   {
     HADESMEM_DETAIL_TRACE_A("Fixing NT headers.");
 
-    NtHeaders nt_headers_new(local_process, pe_file_new);
-
     // TODO: Add flag.
     auto const image_base_new =
       static_cast<ULONGLONG>(reinterpret_cast<ULONG_PTR>(base));
     HADESMEM_DETAIL_TRACE_FORMAT_A("ImageBase: [%016llX] -> [%016llX].",
-                                   nt_headers_new.GetImageBase(),
+                                   pe_view_headers.GetImageBase(),
                                    image_base_new);
-    nt_headers_new.SetImageBase(image_base_new);
+    builder.SetImageBase(image_base_new);
 
+    // TODO: Fall back to the disk headers even in the case that the user
+    // hasn't requested use of them, because something is better than nothing.
+    // Just make sure if we can't load the file that we fail gracefully and
+    // continue.
     if (oep_)
     {
       HADESMEM_DETAIL_TRACE_FORMAT_A("AddressOfEntryPoint: [%08lX] -> [%08lX].",
-                                     nt_headers_new.GetAddressOfEntryPoint(),
+                                     pe_view_headers.GetAddressOfEntryPoint(),
                                      oep_);
-      nt_headers_new.SetAddressOfEntryPoint(oep_);
-    }
-
-    // TODO: Attempt this even in the case that the use hasn't requested use of
-    // disk headers, because something is better than nothing. Just make sure if
-    // we can't load the file that we fail gracefully and continue.
-    else if (has_disk_headers && !nt_headers_new.GetAddressOfEntryPoint())
-    {
-      NtHeaders nt_headers_disk(local_process, *pe_file_disk);
-      HADESMEM_DETAIL_TRACE_FORMAT_A("AddressOfEntryPoint: [%08lX] -> [%08lX].",
-                                     nt_headers_new.GetAddressOfEntryPoint(),
-                                     nt_headers_disk.GetAddressOfEntryPoint());
-      nt_headers_new.SetAddressOfEntryPoint(
-        nt_headers_disk.GetAddressOfEntryPoint());
+      builder.SetAddressOfEntryPoint(oep_);
     }
-
-    nt_headers_new.UpdateWrite();
-
-    return nt_headers_new;
   }
 
   std::map<DWORD, ExportLight const*>
-    DoMemoryScan(std::vector<std::uint8_t>& raw_new,
+    DoMemoryScan(std::vector<std::uint8_t> const& raw,
                  std::map<void*, std::vector<ExportLight>> const& export_map,
                  void* base,
-                 std::size_t pe_size,
-                 Process const& local_process,
-                 PeFile const& pe_file_new)
+                 std::size_t pe_size)
   {
     HADESMEM_DETAIL_TRACE_A("Performing memory scan.");
 
@@ -873,14 +806,14 @@ private:
     // TODO: Check section characteristics as an additional heuristic?
     std::map<DWORD, ExportLight const*> fixup_map;
     bool fixup_adjacent = false;
-    for (auto p = raw_new.data(); p < raw_new.data() + raw_new.size() - 3;
-         p += 4)
+    for (auto p = raw.data(); p < raw.data() + raw.size() - 3; p += 4)
     {
-      auto const offset =
+      // The image is laid out as in memory, so offsets are RVAs.
+      auto const rva =
         static_cast<DWORD>(reinterpret_cast<std::uintptr_t>(p) -
-                           reinterpret_cast<std::uintptr_t>(raw_new.data()));
+                           reinterpret_cast<std::uintptr_t>(raw.data()));
 
-      auto va = *reinterpret_cast<void**>(p);
+      auto va = *reinterpret_cast<void* const*>(p);
       auto i = export_map.find(va);
       if (i == std::end(export_map))
       {
@@ -912,8 +845,8 @@ private:
       if (va >= base && va <= static_cast<std::uint8_t*>(base) + pe_size)
       {
         HADESMEM_DETAIL_TRACE_FORMAT_A(
-          "WARNING! Skipping VA in current module. Offset: [%08X]. VA: [%p].",
-          offset,
+          "WARNING! Skipping VA in current module. RVA: [%08lX]. VA: [%p].",
+          rva,
           va);
         continue;
       }
@@ -921,9 +854,9 @@ private:
       {
         auto const e = i->second.back();
         HADESMEM_DETAIL_TRACE_FORMAT_W(
-          L"Found matching VA. Logging last entry only. Offset: [%08X]. VA: "
+          L"Found matching VA. Logging last entry only. RVA: [%08lX]. VA: "
           L"[%p]. Module: [%s]. Name: [%hs]. Ordinal: [%lu]. ByName: [%d].",
-          offset,
+          rva,
           va,
           e.module_->name_.c_str(),
           e.name_.c_str(),
@@ -931,18 +864,13 @@ private:
           e.by_name_);
       }
 
-      auto const rva =
-        FileOffsetToRva(local_process, pe_file_new, static_cast<DWORD>(offset));
-
-      HADESMEM_DETAIL_TRACE_FORMAT_A("RVA: [%08lX].", rva);
-
       // Only fixup page aligned VAs if they are adjacent to another fixup,
       // because it would be too risky to reconstruct them otherwise (high
       // chance of false positives when scanning for references).
       // TODO: Add a config flag to control this behavior.
       if (!(reinterpret_cast<std::uintptr_t>(va) % 0x1000) && !fixup_adjacent)
       {
-        auto const next_va = *reinterpret_cast<void**>(p + 8);
+        auto const next_va = *reinterpret_cast<void* const*>(p + 8);
         auto const next_e = export_map.find(next_va);
         if (next_e == std::end(export_map))
         {
@@ -1001,28 +929,6 @@ private:
     return fixup_map;
   }
 
-  void CopyHeaders(std::vector<std::uint8_t>& raw_new,
-                   NtHeaders const& nt_headers,
-                   std::size_t pe_size,
-                   bool has_disk_headers,
-                   std::vector<std::uint8_t> const& raw,
-                   std::vector<char> const& pe_file_disk_data)
-  {
-    HADESMEM_DETAIL_TRACE_A("Copying headers.");
-
-    // TODO: Fix this hack properly. We reserve plenty of size in the buffer so
-    // when we open the PE file object later pointing to the buffer, if we add
-    // more data to the buffer it won't be reallocated.
-    raw_new.reserve(pe_size * 5);
-    auto const headers_buf_beg =
-      has_disk_headers
-        ? reinterpret_cast<std::uint8_t const*>(pe_file_disk_data.data())
-        : raw.data();
-    std::copy(headers_buf_beg,
-              headers_buf_beg + nt_headers.GetSizeOfHeaders(),
-              raw_new.data());
-  }
-
   std::tuple<bool, std::vector<char>, std::unique_ptr<PeFile>>
     GetPeFileHeaders(bool has_disk_headers,
                      std::wstring const& region_path,
@@ -1090,7 +996,7 @@ private:
     auto const pe_size = m->pe_file_.GetSize();
 
     HADESMEM_DETAIL_TRACE_FORMAT_W(
-      L"Starting module dumping. Name: [%s]. Base: [%p]. Size: [%X].",
+      L"Starting module dumping. Name: [%s]. Base: [%p]. Size: [%IX].",
       m->name_.c_str(),
       base,
       pe_size);
@@ -1119,61 +1025,28 @@ private:
       GetPeFileHeaders(has_disk_headers, region_path, local_process, pe_file);
 
     PeFile const& pe_file_headers = *pe_file_headers_ptr;
-    NtHeaders nt_headers(local_process, pe_file_headers);
-
-    std::vector<std::uint8_t> raw_new(nt_headers.GetSizeOfHeaders());
-    CopyHeaders(
-      raw_new, nt_headers, pe_size, has_disk_headers, raw, pe_file_disk_data);
-
-    auto const section_datas =
-      CopySectionData(local_process, pe_file_headers, nt_headers, raw_new, raw);
-    raw_new.reserve(raw_new.size() * 2);
-
-    const auto dword_max = (std::numeric_limits<DWORD>::max)();
-    HADESMEM_DETAIL_ASSERT(raw_new.size() < dword_max);
-    HADESMEM_DETAIL_ASSERT(raw_new.capacity() < dword_max);
-    PeFile const pe_file_new(local_process,
-                             raw_new.data(),
-                             PeFileType::kData,
-                             static_cast<DWORD>(raw_new.size()));
-    auto const raw_new_capacity = raw_new.capacity();
-
-    std::unique_ptr<PeFile> pe_file_none;
-    auto nt_headers_new =
-      FixNtHeaders(local_process,
-                   pe_file_new,
-                   base,
-                   has_disk_headers,
-                   (has_disk_headers ? pe_file_headers_ptr : pe_file_none));
-
-    SectionList sections_new(local_process, pe_file_new);
-    FixSectionHeaders(sections_new, section_datas);
-
-    if (!!(flags_ & DumpFlags::kReconstructImports))
-    {
-      HADESMEM_DETAIL_TRACE_A("Reconstructing imports.");
-
-      auto const can_add_new_section =
-        TryAddNewSection(local_process, pe_file_new, nt_headers_new, raw_new);
 
-      std::vector<Section> sections_vec;
-      std::copy(std::begin(sections_new),
-                std::end(sections_new),
-                std::back_inserter(sections_vec));
+    // The builder only references the section data, so a dump costs a single
+    // copy of each section into an output buffer which is allocated once at
+    // its final size, however many edits are made.
+    pelib::PeView const pe_view_headers =
+      has_disk_headers
+        ? pelib::PeView{pelib::BufferSource{pe_file_disk_data.data(),
+                                            pe_file_disk_data.size()},
+                        PeFileType::kData}
+        : pelib::PeView{pelib::BufferSource{raw.data(), raw.size()},
+                        PeFileType::kImage};
+    pelib::PeBuilder builder{pe_view_headers};
 
-      HADESMEM_DETAIL_TRACE_A("Getting last section info.");
+    FixSections(builder, pe_view_headers, raw);
 
-      auto& last_section = sections_vec[sections_vec.size() - 1];
+    FixNtHeaders(builder, pe_view_headers, base);
 
-      auto const old_size = last_section.GetSizeOfRawData();
-      auto const old_section_end =
-        can_add_new_section
-          ? 0
-          : static_cast<DWORD>(RoundUp(last_section.GetVirtualSize(),
-                                       nt_headers_new.GetSectionAlignment()));
+    if (!!(flags_ & DumpFlags::kReconstructImports))
+    {
+      HADESMEM_DETAIL_TRACE_A("Reconstructing imports.");
 
-      auto const fixup_map = DoMemoryScan(
-        raw_new, export_map, base, pe_size, local_process, pe_file_new);
+      auto const fixup_map = DoMemoryScan(raw, export_map, base, pe_size);
 
       auto coalesced_fixup_map = CoalesceImportDescriptors(fixup_map);
 
@@ -1194,48 +1067,42 @@ private:
 
       // TODO: Try and sort our import directory the same way MSVC would.
 
-      std::vector<char> import_directories_buf;
-      DWORD descriptors_cur = 0;
-      BuildRawImportDirectoriesBuffer(local_process,
-                                      pe_file_headers,
-                                      coalesced_fixup_map,
-                                      last_section,
-                                      old_section_end,
-                                      import_directories_buf,
-                                      pe_size,
-                                      descriptors_cur);
-
-      AddExistingImportDirs(local_process,
-                            pe_file_headers,
-                            coalesced_fixup_map,
-                            import_directories_buf,
-                            descriptors_cur);
-
-      auto const new_size = UpdateLastSectionSize(
-        import_directories_buf, nt_headers_new, old_section_end, last_section);
-
-      WriteImportDirectories(raw_new,
-                             last_section,
-                             old_section_end,
-                             raw_new_capacity,
-                             new_size,
-                             old_size,
-                             import_directories_buf);
-
-      // TODO: Before we were fixing section sizes correctly above, the last
-      // section data was truncated and we didn't appear to detect it properly
-      // in the dump tool. Add support for this somewhere.
-
-      SetDataDirectories(
-        nt_headers_new, last_section, old_section_end, descriptors_cur);
-
-      FixHeadersFinal(last_section, nt_headers, nt_headers_new);
+      auto import_dirs = BuildImportDirs(coalesced_fixup_map);
+
+      AddExistingImportDirs(
+        local_process, pe_file_headers, coalesced_fixup_map, import_dirs);
+
+      SetImportDirs(builder, std::move(import_dirs));
     }
-    else
+
+    if (!!(flags_ & DumpFlags::kStripDosStub))
+    {
+      HADESMEM_DETAIL_TRACE_A("Stripping DOS stub.");
+
+      builder.StripDosStub();
+    }
+
+    HADESMEM_DETAIL_TRACE_A("Building file.");
+
+    auto raw_new = builder.Build();
+
+    if (!(flags_ & DumpFlags::kReconstructImports))
     {
+      PeFile const pe_file_new(local_process,
+                               raw_new.data(),
+                               PeFileType::kData,
+                               static_cast<DWORD>(raw_new.size()));
       FixImports(local_process, pe_file, pe_file_new);
     }
 
+    // Must be last, as the checksum covers the whole file.
+    if (!!(flags_ & DumpFlags::kFixChecksum))
+    {
+      HADESMEM_DETAIL_TRACE_A("Fixing checksum.");
+
+      pelib::UpdatePeChecksum(raw_new.data(), raw_new.size());
+    }
+
     // TODO: Write to a new sub-directory each time (e.g.
     // pe_dumps\foo.exe\1234\1).
     WriteDumpFile(*process_,
@@ -1245,48 +1112,6 @@ private:
                   L"pe_dumps");
   }
 
-  void WriteImportDirectories(std::vector<std::uint8_t>& raw_new,
-                              Section const& last_section,
-                              DWORD old_section_end,
-                              std::size_t raw_new_capacity,
-                              DWORD new_size,
-                              DWORD old_size,
-                              std::vector<char> const& import_directories_buf)
-  {
-    HADESMEM_DETAIL_TRACE_A("Adding new import directories to file.");
-
-    auto const prev_virt_end =
-      last_section.GetPointerToRawData() + old_section_end;
-    HADESMEM_DETAIL_TRACE_FORMAT_A("Expanding last section to its previous "
-                                   "virtual size. New End: [0x%lX].",
-                                   prev_virt_end);
-    raw_new.resize(prev_virt_end);
-
-    (void)raw_new_capacity;
-    HADESMEM_DETAIL_ASSERT(raw_new.capacity() == raw_new_capacity);
-
-    auto const new_end = raw_new.size() + (new_size - old_size);
-    HADESMEM_DETAIL_TRACE_FORMAT_A(
-      "Appending new data after old virtual end. New End: [0x%IX].", new_end);
-    raw_new.reserve(new_end);
-
-    HADESMEM_DETAIL_ASSERT(raw_new.capacity() == raw_new_capacity);
-
-    std::copy(std::begin(import_directories_buf),
-              std::end(import_directories_buf),
-              std::back_inserter(raw_new));
-
-    HADESMEM_DETAIL_ASSERT(raw_new.capacity() == raw_new_capacity);
-
-    auto const new_raw_size =
-      last_section.GetPointerToRawData() + last_section.GetSizeOfRawData();
-    HADESMEM_DETAIL_TRACE_FORMAT_A(
-      "Expanding to section aligned size. New End: [0x%lX].", new_raw_size);
-    raw_new.resize(new_raw_size);
-
-    HADESMEM_DETAIL_ASSERT(raw_new.capacity() == raw_new_capacity);
-  }
-
   std::map<DWORD, std::vector<ExportLight const*>> CoalesceImportDescriptors(
     std::map<DWORD, ExportLight const*> const& fixup_map)
   {
@@ -1393,37 +1218,15 @@ private:
     }
   }
 
-  void BuildRawImportDirectoriesBuffer(
-    Process const& local_process,
-    PeFile const& pe_file_headers,
-    std::map<DWORD, std::vector<ExportLight const*>> const& coalesced_fixup_map,
-    Section const& last_section,
-    DWORD old_section_end,
-    std::vector<char>& import_directories_buf,
-    std::size_t size,
-    DWORD& descriptors_cur)
+  std::vector<pelib::PeBuilderImportDir> BuildImportDirs(
+    std::map<DWORD, std::vector<ExportLight const*>> const& coalesced_fixup_map)
   {
-    HADESMEM_DETAIL_TRACE_A("Building raw import directories buffer.");
-
-    // Build raw import dirs.
-    ImportDirList const import_dirs(local_process, pe_file_headers);
-    auto const descriptors_size = static_cast<DWORD>(
-      sizeof(IMAGE_IMPORT_DESCRIPTOR) *
-      (std::distance(std::begin(import_dirs), std::end(import_dirs)) +
-       coalesced_fixup_map.size() + 1));
-    auto const descriptors_end_rva =
-      last_section.GetVirtualAddress() + old_section_end + descriptors_size;
-    import_directories_buf.resize(descriptors_size);
-    // TODO: Fix this hack (see above for the same thing being done to
-    // raw_new).
-    import_directories_buf.reserve(size * 2);
-
-    std::map<std::wstring, DWORD> module_name_rvas;
-    std::map<std::string, DWORD> import_by_name_rvas;
+    HADESMEM_DETAIL_TRACE_A("Building import directories.");
 
+    std::vector<pelib::PeBuilderImportDir> import_dirs;
     std::size_t num_imports = 0;
 
-    // TODO: Don't duplicate entries from existing IAT (above). Need to do
+    // TODO: Don't duplicate entries from existing IAT (below). Need to do
     // more than just check the first thunk though as the array size could
     // differ (packed could have an on-disk IAT size of 1, but it leaves
     // enough space to expand that in memory).
@@ -1431,210 +1234,80 @@ private:
     {
       auto const& module_name =
         ToUpperOrdinal(va_map.second.back()->module_->name_);
-      auto& module_name_rva = module_name_rvas[module_name];
-      if (!module_name_rva)
-      {
-        module_name_rva = descriptors_end_rva +
-                          static_cast<DWORD>(import_directories_buf.size()) -
-                          descriptors_size;
-
-        auto const module_name_narrow = WideCharToMultiByte(module_name);
-        std::copy(std::begin(module_name_narrow),
-                  std::end(module_name_narrow),
-                  std::back_inserter(import_directories_buf));
-        import_directories_buf.push_back('\0');
-      }
-
-      DWORD const thunks_rva =
-        descriptors_end_rva +
-        static_cast<DWORD>(import_directories_buf.size()) - descriptors_size;
-      auto const thunks_offset = import_directories_buf.size();
-      import_directories_buf.resize(
-        thunks_offset + sizeof(IMAGE_THUNK_DATA) * (va_map.second.size() + 1));
-      auto thunks = reinterpret_cast<PIMAGE_THUNK_DATA>(
-        &import_directories_buf[thunks_offset]);
 
-      IMAGE_IMPORT_DESCRIPTOR descriptor{};
       // TODO: Flag this.
-      descriptor.OriginalFirstThunk = thunks_rva;
-      descriptor.Name = module_name_rva;
-      descriptor.FirstThunk = va_map.first;
-      std::copy(reinterpret_cast<char const*>(&descriptor),
-                reinterpret_cast<char const*>(&descriptor) + sizeof(descriptor),
-                &import_directories_buf[descriptors_cur]);
+      pelib::PeBuilderImportDir import_dir;
+      import_dir.name = WideCharToMultiByte(module_name);
+      import_dir.first_thunk = va_map.first;
 
-      descriptors_cur += sizeof(IMAGE_IMPORT_DESCRIPTOR);
-
-      auto cur_rva = descriptor.FirstThunk;
+      auto cur_rva = va_map.first;
       for (auto const& e : va_map.second)
       {
-        ProcessImpRecEntry(cur_rva,
-                           module_name,
-                           e,
-                           import_by_name_rvas,
-                           descriptors_end_rva,
-                           import_directories_buf,
-                           descriptors_size,
-                           thunks,
-                           num_imports);
+        import_dir.imports.emplace_back(
+          ProcessImpRecEntry(cur_rva, module_name, e));
+        ++num_imports;
+        cur_rva += sizeof(void*);
       }
+
+      import_dirs.emplace_back(std::move(import_dir));
     }
 
     HADESMEM_DETAIL_TRACE_FORMAT_A("Number of Scanned Imports: [%Iu].",
                                    num_imports);
+
+    return import_dirs;
   }
 
-  void ProcessImpRecEntry(DWORD& cur_rva,
-                          std::wstring const& module_name,
-                          ExportLight const* e,
-                          std::map<std::string, DWORD>& import_by_name_rvas,
-                          DWORD descriptors_end_rva,
-                          std::vector<char>& import_directories_buf,
-                          DWORD descriptors_size,
-                          PIMAGE_THUNK_DATA& thunks,
-                          std::size_t& num_imports)
+  pelib::PeBuilderImport ProcessImpRecEntry(DWORD rva,
+                                            std::wstring const& module_name,
+                                            ExportLight const* e)
   {
+    (void)rva;
     (void)module_name;
     HADESMEM_DETAIL_TRACE_FORMAT_W(
       L"Processing import reconstruction entry. RVA: [%08lX]. Module: "
       L"[%s]. Name: [%hs]. Ordinal: [%lu]. ByName: [%d].",
-      cur_rva,
+      rva,
       module_name.c_str(),
       e->name_.c_str(),
       e->ordinal_,
       e->by_name_);
 
+    pelib::PeBuilderImport import;
     if (e->by_name_)
     {
-      auto& import_by_name_rva = import_by_name_rvas[e->name_];
-      if (!import_by_name_rva)
-      {
-        import_by_name_rva = descriptors_end_rva +
-                             static_cast<DWORD>(import_directories_buf.size()) -
-                             descriptors_size;
-
-        // TODO: Set Hint.
-        std::vector<char> import_by_name_buf(
-          sizeof(IMAGE_IMPORT_BY_NAME::Hint) + e->name_.size() + 1);
-        auto const import_by_name =
-          reinterpret_cast<PIMAGE_IMPORT_BY_NAME>(import_by_name_buf.data());
-        std::copy(
-          std::begin(e->name_), std::end(e->name_), &import_by_name->Name[0]);
-
-        std::copy(std::begin(import_by_name_buf),
-                  std::end(import_by_name_buf),
-                  std::back_inserter(import_directories_buf));
-      }
-
-      thunks->u1.AddressOfData = import_by_name_rva;
+      // TODO: Set Hint.
+      import.name = e->name_;
     }
     else
     {
-      thunks->u1.Ordinal =
-        IMAGE_ORDINAL_FLAG | (e->ordinal_ & static_cast<WORD>(-1));
+      import.ordinal = static_cast<std::uint16_t>(e->ordinal_);
     }
 
-    ++num_imports;
-    ++thunks;
-    cur_rva += sizeof(void*);
-  }
-
-  DWORD UpdateLastSectionSize(std::vector<char>& import_directories_buf,
-                              NtHeaders const& nt_headers_new,
-                              DWORD old_section_end,
-                              Section& last_section)
-  {
-    HADESMEM_DETAIL_TRACE_A("Updating last section size.");
-
-    // TODO: This probably doesn't need to be section aligned?
-    auto const import_dirs_aligned_size = static_cast<DWORD>(RoundUp(
-      import_directories_buf.size(), nt_headers_new.GetSectionAlignment()));
-    auto const new_size = old_section_end + import_dirs_aligned_size;
-    last_section.SetSizeOfRawData(new_size);
-    // TODO: Is increasing the virtual size here ever incorrect? (Will be
-    // solved by simply using a new section, but that may not always be
-    // desired, so we should probably keep this branch too.
-    last_section.SetVirtualSize(new_size);
-    last_section.UpdateWrite();
-
-    return new_size;
-  }
-
-  bool TryAddNewSection(Process const& local_process,
-                        PeFile const& pe_file_new,
-                        NtHeaders& nt_headers_new,
-                        std::vector<std::uint8_t> const& raw_new)
-  {
-    if (!(flags_ & DumpFlags::kAddNewSection))
-    {
-      return false;
-    }
-
-    hadesmem::Section last_section(
-      local_process, pe_file_new, nt_headers_new.GetNumberOfSections() - 1);
-    // TODO: Is this correct in all cases?
-    auto const new_section_header_beg =
-      static_cast<std::uint8_t*>(last_section.GetBase()) +
-      sizeof(IMAGE_SECTION_HEADER);
-    auto const new_section_header_end =
-      new_section_header_beg + sizeof(IMAGE_SECTION_HEADER);
-    if (new_section_header_end >
-        raw_new.data() + nt_headers_new.GetSizeOfHeaders())
-    {
-      // TODO: What can we do to handle this? Is it possible to expand the size
-      // of the headers safely?
-      HADESMEM_DETAIL_TRACE_A("WARNING! No space for new section header.");
-      return false;
-    }
-
-    HADESMEM_DETAIL_TRACE_A("Adding new section.");
-
-    IMAGE_SECTION_HEADER hadesmem_section{};
-    std::memcpy(hadesmem_section.Name, ".hmem", sizeof(".hmem"));
-    hadesmem_section.VirtualAddress =
-      last_section.GetVirtualAddress() + last_section.GetVirtualSize();
-    hadesmem_section.PointerToRawData =
-      last_section.GetPointerToRawData() + last_section.GetSizeOfRawData();
-    hadesmem_section.Characteristics =
-      IMAGE_SCN_CNT_CODE | IMAGE_SCN_CNT_INITIALIZED_DATA |
-      IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
-
-    std::copy(reinterpret_cast<std::uint8_t*>(&hadesmem_section),
-              reinterpret_cast<std::uint8_t*>(&hadesmem_section + 1),
-              new_section_header_beg);
-
-    nt_headers_new.SetNumberOfSections(nt_headers_new.GetNumberOfSections() +
-                                       1);
-    nt_headers_new.UpdateWrite();
-
-    return true;
+    return import;
   }
 
   void AddExistingImportDirs(
     Process const& local_process,
     PeFile const& pe_file_headers,
     std::map<DWORD, std::vector<ExportLight const*>> const& coalesced_fixup_map,
-    std::vector<char>& import_directories_buf,
-    DWORD descriptors_cur)
+    std::vector<pelib::PeBuilderImportDir>& import_dirs)
   {
     std::size_t num_existing_imports = 0;
     (void)num_existing_imports;
 
     HADESMEM_DETAIL_TRACE_A("Adding existing import directories.");
-    ImportDirList const import_dirs(local_process, pe_file_headers);
-    for (auto const& dir : import_dirs)
+    ImportDirList const import_dirs_existing(local_process, pe_file_headers);
+    for (auto const& dir : import_dirs_existing)
     {
       AddSingleExistingImportDir(local_process,
                                  pe_file_headers,
                                  dir,
                                  coalesced_fixup_map,
                                  num_existing_imports,
-                                 import_directories_buf,
-                                 descriptors_cur);
+                                 import_dirs);
     }
 
-    descriptors_cur += sizeof(IMAGE_IMPORT_DESCRIPTOR);
-
     HADESMEM_DETAIL_TRACE_FORMAT_A("Number of Existing Imports: [%Iu].",
                                    num_existing_imports);
   }
@@ -1645,9 +1318,16 @@ private:
     ImportDir const& dir,
     std::map<DWORD, std::vector<ExportLight const*>> const& coalesced_fixup_map,
     std::size_t& num_existing_imports,
-    std::vector<char>& import_directories_buf,
-    DWORD& descriptors_cur)
+    std::vector<pelib::PeBuilderImportDir>& import_dirs)
   {
+    // Skip if the directory has no FTs (there's nothing to point it at) or
+    // has unaligned FTs.
+    // TODO: Put this behind a config flag.
+    if (!dir.GetFirstThunk() || !!(dir.GetFirstThunk() & 3))
+    {
+      return;
+    }
+
     hadesmem::ImportThunkList const import_thunks_ft(
       local_process, pe_file_headers, dir.GetFirstThunk());
     auto const num_fts =
@@ -1658,8 +1338,7 @@ private:
     // fill it themselves).
     // TODO: Fix this for the case where the on-disk IAT is larger than the
     // scanned one. In this case we should probably expand the size of the
-    // scanned list, but we can't do that here as we've already written it.
-    // Need to move this to one phase earlier.
+    // scanned list.
     auto const iter = coalesced_fixup_map.find(dir.GetFirstThunk());
     if (iter != std::end(coalesced_fixup_map) &&
         iter->second.size() >= static_cast<std::size_t>(num_fts))
@@ -1667,13 +1346,6 @@ private:
       return;
     }
 
-    // Skip if the directory has unaligned FTs.
-    // TODO: Put this behind a config flag.
-    if (!!(dir.GetFirstThunk() & 3))
-    {
-      return;
-    }
-
     hadesmem::ImportThunkList import_thunks_oft(
       local_process, pe_file_headers, dir.GetOriginalFirstThunk());
     auto const num_ofts =
@@ -1684,49 +1356,47 @@ private:
                                    num_new_existing_imports);
     num_existing_imports += num_new_existing_imports;
 
-    auto const p = reinterpret_cast<PIMAGE_IMPORT_DESCRIPTOR>(dir.GetBase());
-    std::copy(reinterpret_cast<char const*>(p),
-              reinterpret_cast<char const*>(p) + sizeof(*p),
-              &import_directories_buf[descriptors_cur]);
-    descriptors_cur += sizeof(IMAGE_IMPORT_DESCRIPTOR);
+    // Kept as is, as its name and thunks are already in the image.
+    pelib::PeBuilderImportDir import_dir;
+    std::memcpy(
+      &import_dir.descriptor, dir.GetBase(), sizeof(import_dir.descriptor));
+    import_dirs.emplace_back(std::move(import_dir));
   }
 
-  void SetDataDirectories(NtHeaders& nt_headers_new,
-                          Section const& last_section,
-                          DWORD old_section_end,
-                          DWORD descriptors_cur)
+  void SetImportDirs(pelib::PeBuilder& builder,
+                     std::vector<pelib::PeBuilderImportDir>&& import_dirs)
   {
-    HADESMEM_DETAIL_TRACE_A("Setting import data directory info.");
+    auto section_index = builder.GetNumberOfSections() - 1;
+    if (!!(flags_ & DumpFlags::kAddNewSection))
+    {
+      if (builder.CanAddSection())
+      {
+        HADESMEM_DETAIL_TRACE_A("Adding new section.");
+
+        section_index = builder.AddSection(
+          ".hmem",
+          IMAGE_SCN_CNT_CODE | IMAGE_SCN_CNT_INITIALIZED_DATA |
+            IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE,
+          std::vector<std::uint8_t>{});
+      }
+      else
+      {
+        // TODO: What can we do to handle this? Is it possible to expand the
+        // size of the headers safely?
+        HADESMEM_DETAIL_TRACE_A("WARNING! No space for new section header.");
+      }
+    }
 
-    nt_headers_new.SetDataDirectoryVirtualAddress(
-      PeDataDir::Import, last_section.GetVirtualAddress() + old_section_end);
-    nt_headers_new.SetDataDirectorySize(PeDataDir::Import, descriptors_cur);
+    HADESMEM_DETAIL_TRACE_A("Setting import directories.");
 
+    // The IAT data directory is cleared, as every scanned directory uses the
+    // IAT it was found in.
     // TODO: Instead of searching for and placing individual
     // descriptors/thunks, we should search for the original IAT as a whole.
     // This won't always work vs all packers, but it should probably be the
     // default, and then the current behavior of doing everything from scratch
     // should be moved behind a config flag. (See also the 'aggressive' flag.)
-    nt_headers_new.SetDataDirectoryVirtualAddress(PeDataDir::IAT, 0);
-    nt_headers_new.SetDataDirectorySize(PeDataDir::IAT, 0);
-  }
-
-  void FixHeadersFinal(Section const& last_section,
-                       NtHeaders const& nt_headers,
-                       NtHeaders& nt_headers_new)
-  {
-    HADESMEM_DETAIL_TRACE_A("Setting image size.");
-
-    auto const new_image_size = static_cast<DWORD>(
-      RoundUp(last_section.GetVirtualAddress() + last_section.GetVirtualSize(),
-              nt_headers.GetSectionAlignment()));
-    nt_headers_new.SetSizeOfImage(new_image_size);
-
-    // TODO: Fix checksums (with flag).
-
-    // TODO: Strip DOS stub (with flag).
-
-    nt_headers_new.UpdateWrite();
+    builder.SetImportDirs(std::move(import_dirs), section_index);
   }
 
   void FixImports(Process const& local_process,
@@ -0,0 +1,189 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/export.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+
+// TODO: Support looking up a name using the ordinal hint from an import thunk
+// before falling back to the binary search, the same as the loader does.
+
+namespace hadesmem
+{
+namespace detail
+{
+// Name lookup for a module's export tables. The name table is lexically sorted
+// by the linker (the loader relies on this, as it binary searches it), so the
+// common case only has to read O(log N) name strings. Files with an unsorted
+// name table (hand crafted, packed, etc.) are handled by a hash table of all
+// names, built the first time a binary search misses. Building it also checks
+// whether the table was actually sorted, in which case misses go back to
+// being binary searches, as they're genuine.
+//
+// Unlike the original linear search over ExportList, any entry in the name
+// table is found, not just the first name of each export (the same as
+// GetProcAddress).
+class ExportNameIndex
+{
+public:
+  explicit ExportNameIndex(Process const& process,
+                           PeFile const& pe_file,
+                           std::shared_ptr<ExportTables const> tables)
+    : process_{&process}, pe_file_{&pe_file}, tables_{std::move(tables)}
+  {
+    HADESMEM_DETAIL_ASSERT(tables_);
+  }
+
+  explicit ExportNameIndex(Process const&& process,
+                           PeFile const& pe_file,
+                           std::shared_ptr<ExportTables const> tables) = delete;
+
+  explicit ExportNameIndex(Process const& process,
+                           PeFile&& pe_file,
+                           std::shared_ptr<ExportTables const> tables) = delete;
+
+  explicit ExportNameIndex(Process const&& process,
+                           PeFile&& pe_file,
+                           std::shared_ptr<ExportTables const> tables) = delete;
+
+  ExportTables const& GetTables() const noexcept
+  {
+    return *tables_;
+  }
+
+  // Returns the index of the name in the name tables, or
+  // ExportTables::kNoName.
+  DWORD Find(std::string const& name)
+  {
+    if (hashed_ && !sorted_)
+    {
+      return FindHashed(name);
+    }
+
+    DWORD const index = BinarySearch(name);
+    if (index != ExportTables::kNoName || hashed_)
+    {
+      return index;
+    }
+
+    BuildHash();
+    return sorted_ ? index : FindHashed(name);
+  }
+
+  // Returns the procedure number of the export with the given name. Only
+  // valid if Find succeeded.
+  WORD GetProcedureNumber(DWORD name_index) const noexcept
+  {
+    HADESMEM_DETAIL_ASSERT(name_index < tables_->GetNameOrdinals().size());
+    return static_cast<WORD>(tables_->GetNameOrdinals()[name_index] +
+                             tables_->GetOrdinalBase());
+  }
+
+private:
+  std::string ReadName(DWORD name_index) const
+  {
+    DWORD const name_rva = tables_->GetNames()[name_index];
+    return detail::CheckedReadString<char>(
+      *process_, *pe_file_, RvaToVa(*process_, *pe_file_, name_rva));
+  }
+
+  DWORD BinarySearch(std::string const& name) const
+  {
+    try
+    {
+      std::size_t beg = 0;
+      std::size_t end = tables_->GetNames().size();
+      while (beg < end)
+      {
+        std::size_t const mid = beg + (end - beg) / 2;
+        int const cmp = ReadName(static_cast<DWORD>(mid)).compare(name);
+        if (cmp == 0)
+        {
+          return static_cast<DWORD>(mid);
+        }
+        else if (cmp < 0)
+        {
+          beg = mid + 1;
+        }
+        else
+        {
+          end = mid;
+        }
+      }
+    }
+    catch (std::exception const& /*e*/)
+    {
+      // An unreadable name means the table is malformed, so let the hash
+      // table deal with it.
+    }
+
+    return ExportTables::kNoName;
+  }
+
+  DWORD FindHashed(std::string const& name) const
+  {
+    auto const iter = hash_.find(name);
+    return iter != std::end(hash_) ? iter->second : ExportTables::kNoName;
+  }
+
+  void BuildHash()
+  {
+    hashed_ = true;
+
+    bool sorted = true;
+    std::string prev_name;
+    std::size_t const num_names = tables_->GetNames().size();
+    hash_.reserve(num_names);
+    for (std::size_t i = 0; i < num_names; ++i)
+    {
+      std::string cur_name;
+      try
+      {
+        cur_name = ReadName(static_cast<DWORD>(i));
+      }
+      catch (std::exception const& /*e*/)
+      {
+        sorted = false;
+        continue;
+      }
+
+      if (i && cur_name < prev_name)
+      {
+        sorted = false;
+      }
+
+      // The first entry wins for duplicate names, the same as a linear
+      // search.
+      hash_.emplace(cur_name, static_cast<DWORD>(i));
+      prev_name = std::move(cur_name);
+    }
+
+    sorted_ = sorted;
+    if (sorted_)
+    {
+      hash_.clear();
+    }
+  }
+
+  Process const* process_;
+  PeFile const* pe_file_;
+  std::shared_ptr<ExportTables const> tables_;
+  bool hashed_{};
+  bool sorted_{};
+  std::unordered_map<std::string, DWORD> hash_;
+};
+}
+}
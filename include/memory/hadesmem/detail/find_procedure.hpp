@@ -4,14 +4,23 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <windows.h>
 
 #include <hadesmem/pelib/export_list.hpp>
 #include <hadesmem/detail/alias_cast.hpp>
+#include <hadesmem/detail/export_name_index.hpp>
+#include <hadesmem/detail/optional.hpp>
+#include <hadesmem/detail/scope_warden.hpp>
 #include <hadesmem/detail/static_assert.hpp>
 #include <hadesmem/detail/str_conv.hpp>
+#include <hadesmem/detail/to_upper_ordinal.hpp>
 #include <hadesmem/error.hpp>
 #include <hadesmem/module.hpp>
 #include <hadesmem/pelib/export.hpp>
@@ -22,8 +31,195 @@ namespace hadesmem
 {
 namespace detail
 {
-inline FARPROC GetProcAddressFromExport(Process const& process,
-                                        Export const& e);
+// Caches the export tables (and name index) of each module used to resolve a
+// procedure, and the handles of the modules named by forwarders, so resolving
+// many procedures (e.g. all the imports of a module) only reads and indexes
+// each module's exports once.
+//
+// Modules are cached by handle, so a cache must not be used across a module
+// being unloaded.
+class ExportCache
+{
+public:
+  explicit ExportCache(Process const& process) : process_{&process}
+  {
+  }
+
+  explicit ExportCache(Process const&& process) = delete;
+
+  FARPROC FindProcedure(HMODULE module, std::string const& name)
+  {
+    ExportNameIndex* const name_index = GetNameIndex(module);
+    if (!name_index)
+    {
+      return nullptr;
+    }
+
+    DWORD const index = name_index->Find(name);
+    if (index == ExportTables::kNoName)
+    {
+      return nullptr;
+    }
+
+    ExportTables const& tables = name_index->GetTables();
+    DWORD const procedure_number =
+      tables.GetNameOrdinals()[index] + tables.GetOrdinalBase();
+    return FindProcedureByNumber(module, procedure_number, true);
+  }
+
+  FARPROC FindProcedure(HMODULE module, WORD ordinal)
+  {
+    return FindProcedureByNumber(module, ordinal, false);
+  }
+
+  FARPROC GetProcAddressFromExport(Export const& e)
+  {
+    if (e.IsForwarded())
+    {
+      // Forwarder chains are normally one or two links long. Anything much
+      // longer than that is almost certainly a cycle.
+      if (forwarder_depth_ >= kMaxForwarderDepth)
+      {
+        HADESMEM_DETAIL_THROW_EXCEPTION(
+          Error{} << ErrorString{"Forwarder chain too long."});
+      }
+
+      HMODULE const forwarder_module = GetForwarderModule(e);
+
+      ++forwarder_depth_;
+      auto const restore_depth = [&]() { --forwarder_depth_; };
+      auto const ensure_restore_depth = MakeScopeWarden(restore_depth);
+
+      if (e.IsForwardedByOrdinal())
+      {
+        return FindProcedure(forwarder_module, e.GetForwarderOrdinal());
+      }
+      else
+      {
+        return FindProcedure(forwarder_module, e.GetForwarderFunction());
+      }
+    }
+
+    return AliasCast<FARPROC>(e.GetVa());
+  }
+
+private:
+  static std::size_t const kMaxForwarderDepth = 32;
+
+  struct ModuleExports
+  {
+    explicit ModuleExports(Process const& process, HMODULE module)
+      : pe_file{process, module, PeFileType::kImage, 0}
+    {
+    }
+
+    PeFile pe_file;
+    std::unique_ptr<ExportNameIndex> name_index;
+  };
+
+  ModuleExports& GetModuleExports(HMODULE module)
+  {
+    auto iter = modules_.find(module);
+    if (iter == std::end(modules_))
+    {
+      auto exports = std::make_unique<ModuleExports>(*process_, module);
+      try
+      {
+        exports->name_index = std::make_unique<ExportNameIndex>(
+          *process_,
+          exports->pe_file,
+          std::make_shared<ExportTables const>(*process_, exports->pe_file));
+      }
+      catch (std::exception const& /*e*/)
+      {
+        // No exports (or an invalid export directory). Cache that too.
+      }
+
+      iter = modules_.emplace(module, std::move(exports)).first;
+    }
+
+    return *iter->second;
+  }
+
+  ExportNameIndex* GetNameIndex(HMODULE module)
+  {
+    return GetModuleExports(module).name_index.get();
+  }
+
+  // Only unnamed exports are found by ordinal, matching the original linear
+  // search over ExportList.
+  FARPROC FindProcedureByNumber(HMODULE module,
+                                DWORD procedure_number,
+                                bool by_name)
+  {
+    ModuleExports& exports = GetModuleExports(module);
+    if (!exports.name_index)
+    {
+      return nullptr;
+    }
+
+    // ExportList never yields unused entries (zero RVA) or procedure numbers
+    // which would overflow a WORD, so neither can be found.
+    ExportTables const& tables = exports.name_index->GetTables();
+    DWORD const ordinal_base = tables.GetOrdinalBase();
+    std::vector<DWORD> const& functions = tables.GetFunctions();
+    if (procedure_number < ordinal_base ||
+        procedure_number > (std::numeric_limits<WORD>::max)() ||
+        procedure_number - ordinal_base >= functions.size() ||
+        !functions[procedure_number - ordinal_base])
+    {
+      return nullptr;
+    }
+
+    Optional<Export> e;
+    try
+    {
+      e = Export{*process_,
+                 exports.pe_file,
+                 tables,
+                 static_cast<WORD>(procedure_number)};
+    }
+    catch (std::exception const& /*e*/)
+    {
+      return nullptr;
+    }
+
+    if (!by_name && !e->ByOrdinal())
+    {
+      return nullptr;
+    }
+
+    return GetProcAddressFromExport(*e);
+  }
+
+  HMODULE GetForwarderModule(Export const& e)
+  {
+    auto forwarder_module_name = e.GetForwarderModule();
+    // TODO: What is the correct logic here? Remember we don't want to get
+    // fooled by seeing Foo.DLL.DLL instead of Foo.DLL or something stupid like
+    // that...
+    forwarder_module_name = forwarder_module_name.find('.') != std::string::npos
+                              ? forwarder_module_name
+                              : (forwarder_module_name + ".DLL");
+
+    std::string const key = ToUpperOrdinal(forwarder_module_name);
+    auto iter = forwarder_modules_.find(key);
+    if (iter == std::end(forwarder_modules_))
+    {
+      Module const forwarder_module{*process_,
+                                    MultiByteToWideChar(forwarder_module_name)};
+      iter =
+        forwarder_modules_.emplace(key, forwarder_module.GetHandle()).first;
+    }
+
+    return iter->second;
+  }
+
+  Process const* process_;
+  std::map<HMODULE, std::unique_ptr<ModuleExports>> modules_;
+  std::map<std::string, HMODULE> forwarder_modules_;
+  std::size_t forwarder_depth_{};
+};
 
 template <typename Pred>
 inline FARPROC GetProcAddressInternalFromPred(Process const& process,
@@ -38,57 +234,53 @@ inline FARPROC GetProcAddressInternalFromPred(Process const& process,
   auto const iter = std::find_if(std::begin(exports), std::end(exports), pred);
   if (iter != std::end(exports))
   {
-    return GetProcAddressFromExport(process, *iter);
+    ExportCache cache{process};
+    return cache.GetProcAddressFromExport(*iter);
   }
 
   return nullptr;
 }
 
+// Use the ExportCache overloads when resolving more than one procedure, to
+// avoid re-reading and re-indexing the exports of each module (and of the
+// modules named by its forwarders) for every lookup.
+inline FARPROC GetProcAddressInternal(ExportCache& cache,
+                                      HMODULE module,
+                                      std::string const& name)
+{
+  return cache.FindProcedure(module, name);
+}
+
+inline FARPROC
+  GetProcAddressInternal(ExportCache& cache, HMODULE module, WORD ordinal)
+{
+  return cache.FindProcedure(module, ordinal);
+}
+
+inline FARPROC GetProcAddressFromExport(ExportCache& cache, Export const& e)
+{
+  return cache.GetProcAddressFromExport(e);
+}
+
 inline FARPROC GetProcAddressInternal(Process const& process,
                                       HMODULE module,
                                       std::string const& name)
 {
-  auto const pred = [&](Export const& e) {
-    return e.ByName() && e.GetName() == name;
-  };
-  return GetProcAddressInternalFromPred(process, module, pred);
+  ExportCache cache{process};
+  return GetProcAddressInternal(cache, module, name);
 }
 
 inline FARPROC
   GetProcAddressInternal(Process const& process, HMODULE module, WORD ordinal)
 {
-  auto const pred = [&](Export const& e) {
-    return e.ByOrdinal() && e.GetProcedureNumber() == ordinal;
-  };
-  return GetProcAddressInternalFromPred(process, module, pred);
+  ExportCache cache{process};
+  return GetProcAddressInternal(cache, module, ordinal);
 }
 
 inline FARPROC GetProcAddressFromExport(Process const& process, Export const& e)
 {
-  if (e.IsForwarded())
-  {
-    auto forwarder_module_name = e.GetForwarderModule();
-    // TODO: What is the correct logic here? Remember we don't want to get
-    // fooled by seeing Foo.DLL.DLL instead of Foo.DLL or something stupid like
-    // that...
-    forwarder_module_name = forwarder_module_name.find('.') != std::string::npos
-                              ? forwarder_module_name
-                              : (forwarder_module_name + ".DLL");
-    Module const forwarder_module{process,
-                                  MultiByteToWideChar(forwarder_module_name)};
-    if (e.IsForwardedByOrdinal())
-    {
-      return GetProcAddressInternal(
-        process, forwarder_module.GetHandle(), e.GetForwarderOrdinal());
-    }
-    else
-    {
-      return GetProcAddressInternal(
-        process, forwarder_module.GetHandle(), e.GetForwarderFunction());
-    }
-  }
-
-  return AliasCast<FARPROC>(e.GetVa());
+  ExportCache cache{process};
+  return GetProcAddressFromExport(cache, e);
 }
 }
 }
@@ -0,0 +1,48 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace hadesmem
+{
+class Process;
+
+namespace detail
+{
+// Hook consulted by ReadImpl (and invalidated by WriteImpl) when attached to a
+// Process. See CachedProcess for the only implementation.
+class ReadCache
+{
+public:
+  virtual ~ReadCache()
+  {
+  }
+
+  // Returns false if the cache declines to service the read, in which case the
+  // caller must fall back to the uncached path.
+  virtual bool Read(Process const& process,
+                    void* address,
+                    void* data,
+                    std::size_t len,
+                    std::uint32_t flags) = 0;
+
+  // Returns an owning handle which keeps [address, address + len) alive and
+  // unchanged, and sets data to point at the cached copy of address. Returns
+  // nullptr if the range can't be served without copying.
+  virtual std::shared_ptr<void const> Pin(Process const& process,
+                                          void* address,
+                                          std::size_t len,
+                                          void const*& data) = 0;
+
+  // Called for every write performed via the process. Implementations may
+  // choose to ignore this (e.g. when frozen).
+  virtual void OnWrite(void const* address, std::size_t len) = 0;
+
+  virtual void InvalidateAll() noexcept = 0;
+};
+}
+}
@@ -12,6 +12,7 @@
 #include <hadesmem/detail/assert.hpp>
 #include <hadesmem/detail/protect_guard.hpp>
 #include <hadesmem/detail/query_region.hpp>
+#include <hadesmem/detail/read_cache.hpp>
 #include <hadesmem/detail/type_traits.hpp>
 #include <hadesmem/error.hpp>
 #include <hadesmem/process.hpp>
@@ -56,11 +57,11 @@ inline void ReadUnchecked(Process const& process,
   }
 }
 
-inline void ReadImpl(Process const& process,
-                     void* address,
-                     void* data,
-                     std::size_t len,
-                     std::uint32_t flags = ReadFlags::kNone)
+inline void ReadImplUncached(Process const& process,
+                             void* address,
+                             void* data,
+                             std::size_t len,
+                             std::uint32_t flags = ReadFlags::kNone)
 {
   HADESMEM_DETAIL_ASSERT(len ? address != nullptr : true);
   HADESMEM_DETAIL_ASSERT(data != nullptr);
@@ -124,6 +125,29 @@ inline void ReadImpl(Process const& process,
   }
 }
 
+inline void ReadImpl(Process const& process,
+                     void* address,
+                     void* data,
+                     std::size_t len,
+                     std::uint32_t flags = ReadFlags::kNone)
+{
+  HADESMEM_DETAIL_ASSERT(len ? address != nullptr : true);
+  HADESMEM_DETAIL_ASSERT(data != nullptr);
+
+  if (!len)
+  {
+    return;
+  }
+
+  ReadCache* const read_cache = process.GetReadCache();
+  if (read_cache && read_cache->Read(process, address, data, len, flags))
+  {
+    return;
+  }
+
+  ReadImplUncached(process, address, data, len, flags);
+}
+
 template <typename T>
 T ReadUnsafeImpl(Process const& process,
                  void* address,
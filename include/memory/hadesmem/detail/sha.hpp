@@ -0,0 +1,490 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <hadesmem/config.hpp>
+
+#if defined(HADESMEM_DETAIL_SHA_NI)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else // #if defined(_MSC_VER)
+#include <cpuid.h>
+#endif // #if defined(_MSC_VER)
+#endif // #if defined(HADESMEM_DETAIL_SHA_NI)
+
+// Portable, streaming implementations of SHA-1 and SHA-256 (FIPS 180-4).
+// They don't need the whole buffer at once, so large files can be hashed a
+// chunk at a time. The SHA extensions (SHA-NI) are used where the CPU supports
+// them.
+
+namespace hadesmem
+{
+namespace detail
+{
+inline std::uint32_t ShaRotl(std::uint32_t x, int r) noexcept
+{
+  return (x << r) | (x >> (32 - r));
+}
+
+inline std::uint32_t ShaRotr(std::uint32_t x, int r) noexcept
+{
+  return (x >> r) | (x << (32 - r));
+}
+
+inline std::uint32_t ShaReadBe32(std::uint8_t const* p) noexcept
+{
+  return (static_cast<std::uint32_t>(p[0]) << 24) |
+         (static_cast<std::uint32_t>(p[1]) << 16) |
+         (static_cast<std::uint32_t>(p[2]) << 8) |
+         static_cast<std::uint32_t>(p[3]);
+}
+
+inline void ShaWriteBe32(std::uint8_t* p, std::uint32_t v) noexcept
+{
+  p[0] = static_cast<std::uint8_t>(v >> 24);
+  p[1] = static_cast<std::uint8_t>(v >> 16);
+  p[2] = static_cast<std::uint8_t>(v >> 8);
+  p[3] = static_cast<std::uint8_t>(v);
+}
+
+// Checked once, as CPUID is slow (and serializing).
+inline bool IsShaNiSupported() noexcept
+{
+#if defined(HADESMEM_DETAIL_SHA_NI)
+  static bool const supported = []() {
+    // SHA is CPUID.(EAX=7,ECX=0):EBX[29]. The SHA-NI code paths also use
+    // SSSE3 (CPUID.1:ECX[9]) and SSE4.1 (CPUID.1:ECX[19]).
+    std::uint32_t max_leaf = 0;
+    std::uint32_t leaf_1_ecx = 0;
+    std::uint32_t leaf_7_ebx = 0;
+#if defined(_MSC_VER)
+    int regs[4] = {};
+    ::__cpuid(regs, 0);
+    max_leaf = static_cast<std::uint32_t>(regs[0]);
+    if (max_leaf >= 7)
+    {
+      ::__cpuid(regs, 1);
+      leaf_1_ecx = static_cast<std::uint32_t>(regs[2]);
+      ::__cpuidex(regs, 7, 0);
+      leaf_7_ebx = static_cast<std::uint32_t>(regs[1]);
+    }
+#else // #if defined(_MSC_VER)
+    max_leaf = __get_cpuid_max(0, nullptr);
+    if (max_leaf >= 7)
+    {
+      unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+      __cpuid(1, eax, ebx, ecx, edx);
+      leaf_1_ecx = ecx;
+      __cpuid_count(7, 0, eax, ebx, ecx, edx);
+      leaf_7_ebx = ebx;
+    }
+#endif // #if defined(_MSC_VER)
+    return (leaf_1_ecx & (1U << 9)) && (leaf_1_ecx & (1U << 19)) &&
+           (leaf_7_ebx & (1U << 29));
+  }();
+  return supported;
+#else  // #if defined(HADESMEM_DETAIL_SHA_NI)
+  return false;
+#endif // #if defined(HADESMEM_DETAIL_SHA_NI)
+}
+
+struct Sha1Traits
+{
+  static std::size_t const kDigestSize = 20;
+
+  using State = std::array<std::uint32_t, 5>;
+
+  static State GetInitialState() noexcept
+  {
+    return State{{0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0}};
+  }
+
+  static void CompressScalar(State& state,
+                             std::uint8_t const* blocks,
+                             std::size_t num_blocks) noexcept
+  {
+    for (; num_blocks; --num_blocks, blocks += 64)
+    {
+      std::uint32_t w[80];
+      for (std::size_t i = 0; i < 16; ++i)
+      {
+        w[i] = ShaReadBe32(blocks + i * 4);
+      }
+      for (std::size_t i = 16; i < 80; ++i)
+      {
+        w[i] = ShaRotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+      }
+
+      std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+                    e = state[4];
+      for (std::size_t i = 0; i < 80; ++i)
+      {
+        std::uint32_t f, k;
+        if (i < 20)
+        {
+          f = (b & c) | (~b & d);
+          k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+          f = b ^ c ^ d;
+          k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+          f = (b & c) | (b & d) | (c & d);
+          k = 0x8F1BBCDC;
+        }
+        else
+        {
+          f = b ^ c ^ d;
+          k = 0xCA62C1D6;
+        }
+
+        std::uint32_t const t = ShaRotl(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ShaRotl(b, 30);
+        b = a;
+        a = t;
+      }
+
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
+    }
+  }
+
+#if defined(HADESMEM_DETAIL_SHA_NI)
+  // Each of the 20 groups of four rounds uses the next four message words,
+  // and the round function and constant given by the group number / 5.
+  HADESMEM_DETAIL_TARGET_SHA_NI static void CompressShaNi(
+    State& state, std::uint8_t const* blocks, std::size_t num_blocks) noexcept
+  {
+    __m128i const byte_swap =
+      _mm_set_epi64x(0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL);
+    __m128i abcd = _mm_shuffle_epi32(
+      _mm_loadu_si128(reinterpret_cast<__m128i const*>(state.data())), 0x1B);
+    __m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+    for (; num_blocks; --num_blocks, blocks += 64)
+    {
+      __m128i const abcd_save = abcd;
+      __m128i const e0_save = e0;
+
+      __m128i w[20];
+      for (std::size_t i = 0; i < 4; ++i)
+      {
+        w[i] = _mm_shuffle_epi8(
+          _mm_loadu_si128(reinterpret_cast<__m128i const*>(blocks + i * 16)),
+          byte_swap);
+      }
+      for (std::size_t i = 4; i < 20; ++i)
+      {
+        w[i] = _mm_sha1msg2_epu32(
+          _mm_xor_si128(_mm_sha1msg1_epu32(w[i - 4], w[i - 3]), w[i - 2]),
+          w[i - 1]);
+      }
+
+      __m128i e = _mm_add_epi32(e0, w[0]);
+      __m128i abcd_prev = abcd;
+      for (std::size_t i = 0; i < 20; ++i)
+      {
+        abcd_prev = abcd;
+        switch (i / 5)
+        {
+        case 0:
+          abcd = _mm_sha1rnds4_epu32(abcd, e, 0);
+          break;
+        case 1:
+          abcd = _mm_sha1rnds4_epu32(abcd, e, 1);
+          break;
+        case 2:
+          abcd = _mm_sha1rnds4_epu32(abcd, e, 2);
+          break;
+        default:
+          abcd = _mm_sha1rnds4_epu32(abcd, e, 3);
+          break;
+        }
+
+        if (i + 1 < 20)
+        {
+          e = _mm_sha1nexte_epu32(abcd_prev, w[i + 1]);
+        }
+      }
+
+      e0 = _mm_sha1nexte_epu32(abcd_prev, e0_save);
+      abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state.data()),
+                     _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = static_cast<std::uint32_t>(_mm_extract_epi32(e0, 3));
+  }
+#endif // #if defined(HADESMEM_DETAIL_SHA_NI)
+};
+
+struct Sha256Traits
+{
+  static std::size_t const kDigestSize = 32;
+
+  using State = std::array<std::uint32_t, 8>;
+
+  static State GetInitialState() noexcept
+  {
+    return State{{0x6A09E667,
+                  0xBB67AE85,
+                  0x3C6EF372,
+                  0xA54FF53A,
+                  0x510E527F,
+                  0x9B05688C,
+                  0x1F83D9AB,
+                  0x5BE0CD19}};
+  }
+
+  static std::uint32_t const* GetRoundConstants() noexcept
+  {
+    static std::uint32_t const k[64] = {
+      0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1,
+      0x923F82A4, 0xAB1C5ED5, 0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+      0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174, 0xE49B69C1, 0xEFBE4786,
+      0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+      0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147,
+      0x06CA6351, 0x14292967, 0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+      0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85, 0xA2BFE8A1, 0xA81A664B,
+      0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+      0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A,
+      0x5B9CCA4F, 0x682E6FF3, 0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+      0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2};
+    return k;
+  }
+
+  static void CompressScalar(State& state,
+                             std::uint8_t const* blocks,
+                             std::size_t num_blocks) noexcept
+  {
+    std::uint32_t const* const k = GetRoundConstants();
+    for (; num_blocks; --num_blocks, blocks += 64)
+    {
+      std::uint32_t w[64];
+      for (std::size_t i = 0; i < 16; ++i)
+      {
+        w[i] = ShaReadBe32(blocks + i * 4);
+      }
+      for (std::size_t i = 16; i < 64; ++i)
+      {
+        std::uint32_t const s0 = ShaRotr(w[i - 15], 7) ^
+                                 ShaRotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        std::uint32_t const s1 = ShaRotr(w[i - 2], 17) ^
+                                 ShaRotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+      }
+
+      std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+                    e = state[4], f = state[5], g = state[6], h = state[7];
+      for (std::size_t i = 0; i < 64; ++i)
+      {
+        std::uint32_t const s1 =
+          ShaRotr(e, 6) ^ ShaRotr(e, 11) ^ ShaRotr(e, 25);
+        std::uint32_t const ch = (e & f) ^ (~e & g);
+        std::uint32_t const t1 = h + s1 + ch + k[i] + w[i];
+        std::uint32_t const s0 =
+          ShaRotr(a, 2) ^ ShaRotr(a, 13) ^ ShaRotr(a, 22);
+        std::uint32_t const maj = (a & b) ^ (a & c) ^ (b & c);
+        std::uint32_t const t2 = s0 + maj;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+      }
+
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
+      state[5] += f;
+      state[6] += g;
+      state[7] += h;
+    }
+  }
+
+#if defined(HADESMEM_DETAIL_SHA_NI)
+  // The SHA-256 instructions keep the state as ABEF and CDGH rather than
+  // ABCD and EFGH, so it is shuffled on the way in and out.
+  HADESMEM_DETAIL_TARGET_SHA_NI static void CompressShaNi(
+    State& state, std::uint8_t const* blocks, std::size_t num_blocks) noexcept
+  {
+    std::uint32_t const* const k = GetRoundConstants();
+    __m128i const byte_swap =
+      _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+
+    __m128i const dcba =
+      _mm_loadu_si128(reinterpret_cast<__m128i const*>(state.data()));
+    __m128i const hgfe =
+      _mm_loadu_si128(reinterpret_cast<__m128i const*>(state.data() + 4));
+    __m128i const cdab = _mm_shuffle_epi32(dcba, 0xB1);
+    __m128i const efgh = _mm_shuffle_epi32(hgfe, 0x1B);
+    __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+    for (; num_blocks; --num_blocks, blocks += 64)
+    {
+      __m128i const abef_save = abef;
+      __m128i const cdgh_save = cdgh;
+
+      __m128i w[16];
+      for (std::size_t i = 0; i < 4; ++i)
+      {
+        w[i] = _mm_shuffle_epi8(
+          _mm_loadu_si128(reinterpret_cast<__m128i const*>(blocks + i * 16)),
+          byte_swap);
+      }
+      for (std::size_t i = 4; i < 16; ++i)
+      {
+        w[i] = _mm_sha256msg2_epu32(
+          _mm_add_epi32(_mm_sha256msg1_epu32(w[i - 4], w[i - 3]),
+                        _mm_alignr_epi8(w[i - 1], w[i - 2], 4)),
+          w[i - 1]);
+      }
+
+      for (std::size_t i = 0; i < 16; ++i)
+      {
+        __m128i msg = _mm_add_epi32(
+          w[i], _mm_loadu_si128(reinterpret_cast<__m128i const*>(k + i * 4)));
+        cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        abef = _mm_sha256rnds2_epu32(abef, cdgh, msg);
+      }
+
+      abef = _mm_add_epi32(abef, abef_save);
+      cdgh = _mm_add_epi32(cdgh, cdgh_save);
+    }
+
+    __m128i const feba = _mm_shuffle_epi32(abef, 0x1B);
+    __m128i const dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state.data()),
+                     _mm_blend_epi16(feba, dchg, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state.data() + 4),
+                     _mm_alignr_epi8(dchg, feba, 8));
+  }
+#endif // #if defined(HADESMEM_DETAIL_SHA_NI)
+};
+
+// Merkle-Damgard construction shared by SHA-1 and SHA-256 (64 byte blocks,
+// big endian length padding). Update may be called any number of times with
+// any amount of data, then Finalize returns the digest and resets the hasher.
+template <typename Traits> class ShaHasher
+{
+public:
+  using Digest = std::array<std::uint8_t, Traits::kDigestSize>;
+
+  ShaHasher() noexcept : state_(Traits::GetInitialState())
+  {
+  }
+
+  void Update(void const* data, std::size_t len) noexcept
+  {
+    auto p = static_cast<std::uint8_t const*>(data);
+    total_len_ += len;
+
+    if (buf_len_)
+    {
+      std::size_t const n = (std::min)(len, kBlockSize - buf_len_);
+      std::memcpy(buf_.data() + buf_len_, p, n);
+      buf_len_ += n;
+      p += n;
+      len -= n;
+      if (buf_len_ < kBlockSize)
+      {
+        return;
+      }
+
+      Compress(buf_.data(), 1);
+      buf_len_ = 0;
+    }
+
+    std::size_t const num_blocks = len / kBlockSize;
+    if (num_blocks)
+    {
+      Compress(p, num_blocks);
+      p += num_blocks * kBlockSize;
+      len -= num_blocks * kBlockSize;
+    }
+
+    if (len)
+    {
+      std::memcpy(buf_.data(), p, len);
+      buf_len_ = len;
+    }
+  }
+
+  Digest Finalize() noexcept
+  {
+    std::uint64_t const bit_len = total_len_ * 8;
+
+    std::uint8_t pad[kBlockSize * 2] = {0x80};
+    std::size_t const pad_len =
+      (buf_len_ < kBlockSize - 8 ? kBlockSize : kBlockSize * 2) - buf_len_;
+    ShaWriteBe32(pad + pad_len - 8, static_cast<std::uint32_t>(bit_len >> 32));
+    ShaWriteBe32(pad + pad_len - 4, static_cast<std::uint32_t>(bit_len));
+    Update(pad, pad_len);
+
+    Digest digest;
+    for (std::size_t i = 0; i < state_.size(); ++i)
+    {
+      ShaWriteBe32(digest.data() + i * 4, state_[i]);
+    }
+
+    *this = ShaHasher();
+    return digest;
+  }
+
+  static Digest Hash(void const* data, std::size_t len) noexcept
+  {
+    ShaHasher hasher;
+    hasher.Update(data, len);
+    return hasher.Finalize();
+  }
+
+private:
+  static std::size_t const kBlockSize = 64;
+
+  void Compress(std::uint8_t const* blocks, std::size_t num_blocks) noexcept
+  {
+#if defined(HADESMEM_DETAIL_SHA_NI)
+    if (IsShaNiSupported())
+    {
+      Traits::CompressShaNi(state_, blocks, num_blocks);
+      return;
+    }
+#endif // #if defined(HADESMEM_DETAIL_SHA_NI)
+
+    Traits::CompressScalar(state_, blocks, num_blocks);
+  }
+
+  typename Traits::State state_;
+  std::array<std::uint8_t, kBlockSize> buf_{};
+  std::size_t buf_len_{};
+  std::uint64_t total_len_{};
+};
+
+using Sha1 = ShaHasher<Sha1Traits>;
+
+using Sha256 = ShaHasher<Sha256Traits>;
+}
+}
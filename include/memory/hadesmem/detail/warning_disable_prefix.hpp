@@ -1,8 +1,10 @@
 // Copyright (C) 2010-2015 Joshua Boyce
 // See the file COPYING for copying permission.
 
+#if defined(_MSC_VER)
 #pragma warning(push, 1)
 #pragma warning(disable : 4005 4297 4311 4505 4702 4996)
 #pragma warning(disable : 6011 6102 6201 6239 6244 6246 6295)
 #pragma warning(disable : 6305 6308 6326 6334 6340 6385 6386 6387)
 #pragma warning(disable : 28159 28197 28204 28251 28285)
+#endif // #if defined(_MSC_VER)
@@ -1,4 +1,6 @@
 // Copyright (C) 2010-2015 Joshua Boyce
 // See the file COPYING for copying permission.
 
+#if defined(_MSC_VER)
 #pragma warning(pop)
+#endif // #if defined(_MSC_VER)
@@ -10,6 +10,7 @@
 #include <hadesmem/detail/assert.hpp>
 #include <hadesmem/detail/protect_guard.hpp>
 #include <hadesmem/detail/query_region.hpp>
+#include <hadesmem/detail/read_cache.hpp>
 #include <hadesmem/detail/type_traits.hpp>
 #include <hadesmem/error.hpp>
 #include <hadesmem/process.hpp>
@@ -49,6 +50,11 @@ inline void WriteImpl(Process const& process,
   HADESMEM_DETAIL_ASSERT(data != nullptr);
   HADESMEM_DETAIL_ASSERT(len != 0);
 
+  if (ReadCache* const read_cache = process.GetReadCache())
+  {
+    read_cache->OnWrite(address, len);
+  }
+
   for (;;)
   {
     ProtectGuard protect_guard{process, address, ProtectGuardType::kWrite};
@@ -0,0 +1,138 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Implementation of XXH64 (https://github.com/Cyan4973/xxHash). Fast,
+// non-cryptographic, and good enough to detect changes in memory pages. Do
+// not use it for anything security related.
+
+namespace hadesmem
+{
+namespace detail
+{
+struct XxHash64Traits
+{
+  static std::uint64_t const kPrime1 = 0x9E3779B185EBCA87ULL;
+  static std::uint64_t const kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+  static std::uint64_t const kPrime3 = 0x165667B19E3779F9ULL;
+  static std::uint64_t const kPrime4 = 0x85EBCA77C2B2AE63ULL;
+  static std::uint64_t const kPrime5 = 0x27D4EB2F165667C5ULL;
+};
+
+inline std::uint64_t XxHash64Rotl(std::uint64_t x, int r) noexcept
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+inline std::uint64_t XxHash64Read64(std::uint8_t const* p) noexcept
+{
+  std::uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline std::uint32_t XxHash64Read32(std::uint8_t const* p) noexcept
+{
+  std::uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline std::uint64_t XxHash64Round(std::uint64_t acc,
+                                   std::uint64_t input) noexcept
+{
+  acc += input * XxHash64Traits::kPrime2;
+  acc = XxHash64Rotl(acc, 31);
+  acc *= XxHash64Traits::kPrime1;
+  return acc;
+}
+
+inline std::uint64_t XxHash64MergeRound(std::uint64_t acc,
+                                        std::uint64_t val) noexcept
+{
+  val = XxHash64Round(0, val);
+  acc ^= val;
+  acc = acc * XxHash64Traits::kPrime1 + XxHash64Traits::kPrime4;
+  return acc;
+}
+
+// Assumes a little endian target, which is all we support anyway.
+inline std::uint64_t
+  XxHash64(void const* data, std::size_t len, std::uint64_t seed = 0) noexcept
+{
+  auto p = static_cast<std::uint8_t const*>(data);
+  std::uint8_t const* const end = p + len;
+  std::uint64_t h64;
+
+  if (len >= 32)
+  {
+    std::uint8_t const* const limit = end - 32;
+    std::uint64_t v1 =
+      seed + XxHash64Traits::kPrime1 + XxHash64Traits::kPrime2;
+    std::uint64_t v2 = seed + XxHash64Traits::kPrime2;
+    std::uint64_t v3 = seed + 0;
+    std::uint64_t v4 = seed - XxHash64Traits::kPrime1;
+
+    do
+    {
+      v1 = XxHash64Round(v1, XxHash64Read64(p));
+      v2 = XxHash64Round(v2, XxHash64Read64(p + 8));
+      v3 = XxHash64Round(v3, XxHash64Read64(p + 16));
+      v4 = XxHash64Round(v4, XxHash64Read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+
+    h64 = XxHash64Rotl(v1, 1) + XxHash64Rotl(v2, 7) + XxHash64Rotl(v3, 12) +
+          XxHash64Rotl(v4, 18);
+    h64 = XxHash64MergeRound(h64, v1);
+    h64 = XxHash64MergeRound(h64, v2);
+    h64 = XxHash64MergeRound(h64, v3);
+    h64 = XxHash64MergeRound(h64, v4);
+  }
+  else
+  {
+    h64 = seed + XxHash64Traits::kPrime5;
+  }
+
+  h64 += static_cast<std::uint64_t>(len);
+
+  while (p + 8 <= end)
+  {
+    std::uint64_t const k1 = XxHash64Round(0, XxHash64Read64(p));
+    h64 ^= k1;
+    h64 = XxHash64Rotl(h64, 27) * XxHash64Traits::kPrime1 +
+          XxHash64Traits::kPrime4;
+    p += 8;
+  }
+
+  if (p + 4 <= end)
+  {
+    h64 ^= static_cast<std::uint64_t>(XxHash64Read32(p)) *
+           XxHash64Traits::kPrime1;
+    h64 = XxHash64Rotl(h64, 23) * XxHash64Traits::kPrime2 +
+          XxHash64Traits::kPrime3;
+    p += 4;
+  }
+
+  while (p < end)
+  {
+    h64 ^= (*p) * XxHash64Traits::kPrime5;
+    h64 = XxHash64Rotl(h64, 11) * XxHash64Traits::kPrime1;
+    ++p;
+  }
+
+  h64 ^= h64 >> 33;
+  h64 *= XxHash64Traits::kPrime2;
+  h64 ^= h64 >> 29;
+  h64 *= XxHash64Traits::kPrime3;
+  h64 ^= h64 >> 32;
+
+  return h64;
+}
+}
+}
@@ -4,10 +4,13 @@
 #pragma once
 
 #include <exception>
+#include <string>
 
+#if defined(_WIN32)
 #include <windows.h>
 #include <winnt.h>
 #include <winternl.h>
+#endif // #if defined(_WIN32)
 
 #include <hadesmem/detail/warning_disable_prefix.hpp>
 #include <boost/exception/all.hpp>
@@ -57,6 +60,12 @@ class Error : public virtual std::exception, public virtual boost::exception
 };
 
 using ErrorString = boost::error_info<struct TagErrorString, std::string>;
+using ErrorStringOther =
+  boost::error_info<struct TagErrorStringOther, std::string>;
+
+// Only the above are available on non-Windows platforms, for use by the
+// OS-independent parts of the library.
+#if defined(_WIN32)
 using ErrorCodeWinRet = boost::error_info<struct TagErrorCodeWinRet, DWORD_PTR>;
 using ErrorCodeWinLast = boost::error_info<struct TagErrorCodeWinLast, DWORD>;
 using ErrorCodeWinOther =
@@ -65,8 +74,7 @@ using ErrorCodeOther = boost::error_info<struct TagErrorCodeOther, DWORD_PTR>;
 using ErrorCodeWinHr = boost::error_info<struct TagErrorCodWinHr, HRESULT>;
 using ErrorCodeWinStatus =
   boost::error_info<struct TagErrorCodeWinStatus, NTSTATUS>;
-using ErrorStringOther =
-  boost::error_info<struct TagErrorStringOther, std::string>;
+#endif // #if defined(_WIN32)
 }
 
 #define HADESMEM_DETAIL_THROW_EXCEPTION(x) BOOST_THROW_EXCEPTION(x)
@@ -35,11 +35,16 @@
 #include <hadesmem/pelib/dos_header.hpp>
 #include <hadesmem/pelib/nt_headers.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
-#include <hadesmem/pelib/section.hpp>
-#include <hadesmem/pelib/section_list.hpp>
+#include <hadesmem/pelib/relocation_mask.hpp>
+#include <hadesmem/pelib/view/base_relocation_table.hpp>
+#include <hadesmem/pelib/view/section_index.hpp>
 #include <hadesmem/process.hpp>
 #include <hadesmem/read.hpp>
 
+#if defined(HADESMEM_DETAIL_SSE2)
+#include <emmintrin.h>
+#endif // #if defined(HADESMEM_DETAIL_SSE2)
+
 // TODO: Standalone app/example for FindPattern. For dumping results,
 // experimenting with patterns, automatically generating new patterns, etc.
 
@@ -63,7 +68,11 @@ struct PatternFlags
     kThrowOnUnmatch = 1 << 0,
     kRelativeAddress = 1 << 1,
     kScanData = 1 << 2,
-    kInvalidFlagMaxValue = 1 << 3
+    // Treat bytes covered by a base relocation of the module as wildcards, so
+    // patterns containing absolute addresses match regardless of where the
+    // module was loaded. Only applies to module scans.
+    kIgnoreRelocations = 1 << 3,
+    kInvalidFlagMaxValue = 1 << 4
   };
 };
 
@@ -232,6 +241,99 @@ void* FindRaw(Process const& process,
   return nullptr;
 }
 
+// Bit i is set if h[i] == n[i], for i in [0, 16).
+inline std::uint32_t PatternMatchChunk(std::uint8_t const* h,
+                                       std::uint8_t const* n) noexcept
+{
+#if defined(HADESMEM_DETAIL_SSE2)
+  __m128i const h_chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(h));
+  __m128i const n_chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(n));
+  return static_cast<std::uint32_t>(
+    _mm_movemask_epi8(_mm_cmpeq_epi8(h_chunk, n_chunk)));
+#else  // #if defined(HADESMEM_DETAIL_SSE2)
+  std::uint32_t bits = 0;
+  for (std::uint32_t i = 0; i < 16; ++i)
+  {
+    bits |= static_cast<std::uint32_t>(h[i] == n[i]) << i;
+  }
+  return bits;
+#endif // #if defined(HADESMEM_DETAIL_SSE2)
+}
+
+// Same as FindRaw, except bytes covered by a relocation in relocs match
+// anything. rva is the RVA of s_beg in the module the mask was built for.
+//
+// The needle is compared 16 bytes at a time, with the wildcards and
+// relocations folded into the result of the compare as bitmasks, so ignoring
+// relocations doesn't add a branch per byte.
+template <typename NeedleIterator>
+void* FindRawIgnoreRelocations(Process const& process,
+                               std::uint8_t* s_beg,
+                               std::uint8_t* s_end,
+                               NeedleIterator n_beg,
+                               NeedleIterator n_end,
+                               pelib::RelocationMask const& relocs,
+                               std::size_t rva)
+{
+  HADESMEM_DETAIL_ASSERT(s_beg < s_end);
+
+  auto const mem_size = static_cast<std::size_t>(s_end - s_beg);
+  auto const needle_size =
+    static_cast<std::size_t>(std::distance(n_beg, n_end));
+  if (needle_size > mem_size)
+  {
+    return nullptr;
+  }
+
+  // Wildcards (including the padding in the last chunk) as one bitmask per
+  // chunk.
+  std::size_t const num_chunks = (needle_size + 15) / 16;
+  std::vector<std::uint8_t> needle_data(num_chunks * 16);
+  std::vector<std::uint32_t> needle_wildcards(num_chunks);
+  std::size_t i = 0;
+  for (auto n_cur = n_beg; n_cur != n_end; ++n_cur, ++i)
+  {
+    needle_data[i] = n_cur->data;
+    needle_wildcards[i / 16] |= static_cast<std::uint32_t>(n_cur->wildcard)
+                                << (i % 16);
+  }
+  for (; i < num_chunks * 16; ++i)
+  {
+    needle_wildcards[i / 16] |= 1UL << (i % 16);
+  }
+
+  // Padded so the last chunk compared at the end of the haystack can always
+  // load a full 16 bytes.
+  std::vector<std::uint8_t> haystack{
+    ReadVector<std::uint8_t>(process, s_beg, mem_size)};
+  haystack.resize(mem_size + 16);
+
+  std::size_t const last = mem_size - needle_size;
+  for (std::size_t h = 0; h <= last; ++h)
+  {
+    std::size_t c = 0;
+    for (; c < num_chunks; ++c)
+    {
+      std::size_t const pos = h + c * 16;
+      std::uint32_t const match =
+        PatternMatchChunk(&haystack[pos], &needle_data[c * 16]) |
+        needle_wildcards[c] |
+        static_cast<std::uint32_t>(relocs.GetBits(rva + pos) & 0xFFFF);
+      if (match != 0xFFFF)
+      {
+        break;
+      }
+    }
+
+    if (c == num_chunks)
+    {
+      return s_beg + h;
+    }
+  }
+
+  return nullptr;
+}
+
 struct ModuleRegionInfo
 {
   std::shared_ptr<Module> module;
@@ -260,27 +362,27 @@ inline ModuleRegionInfo GetModuleInfo(Process const& process,
   PeFile const pe_file{process, base, hadesmem::PeFileType::kImage, 0};
   DosHeader const dos_header{process, pe_file};
   NtHeaders const nt_headers{process, pe_file};
-  SectionList const sections{process, pe_file};
-  for (auto const& s : sections)
+  // The section table was already read and indexed by PeFile, so this
+  // doesn't need a read per section.
+  for (auto const& s : GetSectionIndex(process, pe_file).GetEntries())
   {
-    bool const is_code_section =
-      !!(s.GetCharacteristics() & IMAGE_SCN_CNT_CODE);
+    bool const is_code_section = !!(s.characteristics & IMAGE_SCN_CNT_CODE);
     bool const is_data_section =
-      !!(s.GetCharacteristics() & IMAGE_SCN_CNT_INITIALIZED_DATA);
+      !!(s.characteristics & IMAGE_SCN_CNT_INITIALIZED_DATA);
     if (!is_code_section && !is_data_section)
     {
       continue;
     }
 
     auto const section_beg = static_cast<std::uint8_t*>(
-      RvaToVa(process, pe_file, s.GetVirtualAddress()));
+      RvaToVa(process, pe_file, s.virtual_address));
     if (section_beg == nullptr)
     {
       HADESMEM_DETAIL_THROW_EXCEPTION(
         Error() << ErrorString("Could not get section base address."));
     }
 
-    DWORD const section_size = s.GetVirtualSize();
+    DWORD const section_size = s.virtual_size;
     if (!section_size)
     {
       continue;
@@ -302,12 +404,16 @@ inline ModuleRegionInfo GetModuleInfo(Process const& process,
   return mod_info;
 }
 
+// If relocs is not null then bytes covered by a relocation are ignored, and
+// module_base is the base of the module the mask was built for.
 template <typename NeedleIterator>
 void* Find(Process const& process,
            ModuleRegionInfo::ScanRegion const& region,
            void* start,
            NeedleIterator n_beg,
-           NeedleIterator n_end)
+           NeedleIterator n_end,
+           pelib::RelocationMask const* relocs,
+           std::uint8_t const* module_base)
 {
   std::uint8_t* s_beg = region.first;
   std::uint8_t* const s_end = region.second;
@@ -334,6 +440,13 @@ void* Find(Process const& process,
     }
   }
 
+  if (relocs)
+  {
+    auto const rva = static_cast<std::size_t>(s_beg - module_base);
+    return FindRawIgnoreRelocations(
+      process, s_beg, s_end, n_beg, n_end, *relocs, rva);
+  }
+
   return FindRaw(process, s_beg, s_end, n_beg, n_end);
 }
 
@@ -344,16 +457,27 @@ void* Find(Process const& process,
            NeedleIterator n_end,
            std::uint32_t flags,
            void* start,
-           std::wstring const* name)
+           std::wstring const* name,
+           RelocationMaskCache* relocation_masks)
 {
   HADESMEM_DETAIL_ASSERT(n_beg != n_end);
 
+  auto const module_base =
+    reinterpret_cast<std::uint8_t const*>(mod_info.module->GetHandle());
+  std::shared_ptr<pelib::RelocationMask const> relocs;
+  if (!!(flags & PatternFlags::kIgnoreRelocations))
+  {
+    HADESMEM_DETAIL_ASSERT(relocation_masks);
+    relocs = relocation_masks->GetMask(mod_info.module->GetHandle());
+  }
+
   bool const scan_data_secs = !!(flags & PatternFlags::kScanData);
   auto const& scan_regions =
     scan_data_secs ? mod_info.data_regions : mod_info.code_regions;
   for (auto const& region : scan_regions)
   {
-    if (void* const address = Find(process, region, start, n_beg, n_end))
+    if (void* const address = Find(
+          process, region, start, n_beg, n_end, relocs.get(), module_base))
     {
       return !!(flags & PatternFlags::kRelativeAddress)
                ? static_cast<std::uint8_t*>(address) -
@@ -385,7 +509,8 @@ void* Find(Process const& process,
 {
   HADESMEM_DETAIL_ASSERT(n_beg != n_end);
 
-  if (void* const address = Find(process, region, start, n_beg, n_end))
+  if (void* const address =
+        Find(process, region, start, n_beg, n_end, nullptr, nullptr))
   {
     return !!(flags & PatternFlags::kRelativeAddress)
              ? static_cast<std::uint8_t*>(address) -
@@ -405,16 +530,21 @@ void* Find(Process const& process,
 }
 }
 
+// If relocation_masks is null and PatternFlags::kIgnoreRelocations is set then
+// the module's relocations are read for this call only. Pass a cache when
+// scanning the same module for many patterns.
 inline void* Find(Process const& process,
                   std::wstring const& module,
                   std::wstring const& data,
                   std::uint32_t flags,
                   std::uintptr_t start,
-                  std::wstring const* name = nullptr)
+                  std::wstring const* name = nullptr,
+                  RelocationMaskCache* relocation_masks = nullptr)
 {
   HADESMEM_DETAIL_ASSERT(
     !(flags & ~(PatternFlags::kInvalidFlagMaxValue - 1UL)));
 
+  RelocationMaskCache local_relocation_masks{process};
   auto const mod_info = detail::GetModuleInfo(process, module);
   auto const needle = detail::ConvertData(data);
   void* const start_abs =
@@ -427,7 +557,9 @@ inline void* Find(Process const& process,
                       std::end(needle),
                       flags,
                       start_abs,
-                      name);
+                      name,
+                      relocation_masks ? relocation_masks
+                                       : &local_relocation_masks);
 }
 
 inline void* Find(Process const& process,
@@ -715,7 +847,7 @@ public:
   explicit FindPattern(Process const& process,
                        std::wstring const& pattern_file,
                        bool in_memory_file)
-    : process_{&process}, find_pattern_datas_{}
+    : process_{&process}, find_pattern_datas_{}, relocation_masks_{process}
   {
     if (in_memory_file)
     {
@@ -873,6 +1005,10 @@ private:
       {
         flags |= PatternFlags::kScanData;
       }
+      else if (flag_name == L"IgnoreRelocations")
+      {
+        flags |= PatternFlags::kIgnoreRelocations;
+      }
       else
       {
         HADESMEM_DETAIL_THROW_EXCEPTION(
@@ -1087,7 +1223,8 @@ private:
     return start_rva;
   }
 
-  std::uintptr_t GetStartRvaFromExport(Module const& module,
+  std::uintptr_t GetStartRvaFromExport(detail::ExportCache& export_cache,
+                                       Module const& module,
                                        std::wstring const& start) const
   {
     std::uintptr_t start_rva = 0U;
@@ -1097,12 +1234,12 @@ private:
       {
         auto const ordinal_str = start.substr(1);
         start_rva = reinterpret_cast<std::uintptr_t>(FindProcedure(
-          *process_, module, detail::StrToNum<WORD>(ordinal_str)));
+          export_cache, module, detail::StrToNum<WORD>(ordinal_str)));
       }
       else
       {
-        start_rva = reinterpret_cast<std::uintptr_t>(
-          FindProcedure(*process_, module, detail::WideCharToMultiByte(start)));
+        start_rva = reinterpret_cast<std::uintptr_t>(FindProcedure(
+          export_cache, module, detail::WideCharToMultiByte(start)));
       }
 
       start_rva -= reinterpret_cast<std::uintptr_t>(module.GetHandle());
@@ -1114,6 +1251,7 @@ private:
   void LoadPatternFileImpl(pugi::xml_document const& doc)
   {
     auto const patterns_info_full_list = ReadPatternsFromXml(doc);
+    detail::ExportCache export_cache{*process_};
     for (auto const& patterns_info_full_pair : patterns_info_full_list)
     {
       HADESMEM_DETAIL_ASSERT(
@@ -1138,8 +1276,8 @@ private:
           }
           else if (!p.pattern.start_export.empty())
           {
-            return GetStartRvaFromExport(*mod_info.module,
-                                         p.pattern.start_export);
+            return GetStartRvaFromExport(
+              export_cache, *mod_info.module, p.pattern.start_export);
           }
           else
           {
@@ -1147,8 +1285,13 @@ private:
           }
         }();
 
-        address = ::hadesmem::Find(
-          *process_, module, p.pattern.data, flags, start_rva, &p.pattern.name);
+        address = ::hadesmem::Find(*process_,
+                                   module,
+                                   p.pattern.data,
+                                   flags,
+                                   start_rva,
+                                   &p.pattern.name,
+                                   &relocation_masks_);
 
         if (address)
         {
@@ -1163,5 +1306,6 @@ private:
 
   Process const* process_;
   ModuleMap find_pattern_datas_;
+  RelocationMaskCache relocation_masks_;
 };
 }
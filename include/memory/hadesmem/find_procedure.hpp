@@ -13,12 +13,15 @@
 
 namespace hadesmem
 {
-inline FARPROC FindProcedure(Process const& process,
+// Use this overload when finding more than one procedure (e.g. several from
+// the same module) to avoid re-reading the export tables for each one. The
+// cache must not be used across any of the modules involved being unloaded.
+inline FARPROC FindProcedure(detail::ExportCache& export_cache,
                              Module const& module,
                              std::string const& name)
 {
   FARPROC const remote_func =
-    detail::GetProcAddressInternal(process, module.GetHandle(), name);
+    detail::GetProcAddressInternal(export_cache, module.GetHandle(), name);
   if (!remote_func)
   {
     HADESMEM_DETAIL_THROW_EXCEPTION(
@@ -28,11 +31,12 @@ inline FARPROC FindProcedure(Process const& process,
   return remote_func;
 }
 
-inline FARPROC
-  FindProcedure(Process const& process, Module const& module, WORD ordinal)
+inline FARPROC FindProcedure(detail::ExportCache& export_cache,
+                             Module const& module,
+                             WORD ordinal)
 {
   FARPROC const remote_func =
-    detail::GetProcAddressInternal(process, module.GetHandle(), ordinal);
+    detail::GetProcAddressInternal(export_cache, module.GetHandle(), ordinal);
   if (!remote_func)
   {
     HADESMEM_DETAIL_THROW_EXCEPTION(
@@ -41,4 +45,19 @@ inline FARPROC
 
   return remote_func;
 }
+
+inline FARPROC FindProcedure(Process const& process,
+                             Module const& module,
+                             std::string const& name)
+{
+  detail::ExportCache export_cache{process};
+  return FindProcedure(export_cache, module, name);
+}
+
+inline FARPROC
+  FindProcedure(Process const& process, Module const& module, WORD ordinal)
+{
+  detail::ExportCache export_cache{process};
+  return FindProcedure(export_cache, module, ordinal);
+}
 }
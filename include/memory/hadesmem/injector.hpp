@@ -110,7 +110,11 @@ struct InjectFlags
   };
 };
 
+// The ExportCache overloads of InjectDll, FreeDll and CallExport are for
+// doing more than one of them in a row (e.g. CreateAndInject), so the export
+// tables of kernel32 etc. are only read once.
 inline HMODULE InjectDll(Process const& process,
+                         detail::ExportCache& export_cache,
                          std::wstring const& path,
                          std::uint32_t flags)
 {
@@ -167,7 +171,7 @@ inline HMODULE InjectDll(Process const& process,
 
   Module const kernel32_mod{process, L"kernel32.dll"};
   auto const load_library =
-    FindProcedure(process, kernel32_mod, "LoadLibraryExW");
+    FindProcedure(export_cache, kernel32_mod, "LoadLibraryExW");
 
   HADESMEM_DETAIL_TRACE_A("Calling LoadLibraryExW.");
 
@@ -188,10 +192,21 @@ inline HMODULE InjectDll(Process const& process,
   return load_library_ret.GetReturnValue();
 }
 
-inline void FreeDll(Process const& process, HMODULE module)
+inline HMODULE InjectDll(Process const& process,
+                         std::wstring const& path,
+                         std::uint32_t flags)
+{
+  detail::ExportCache export_cache{process};
+  return InjectDll(process, export_cache, path, flags);
+}
+
+inline void FreeDll(Process const& process,
+                    detail::ExportCache& export_cache,
+                    HMODULE module)
 {
   Module const kernel32_mod{process, L"kernel32.dll"};
-  auto const free_library = FindProcedure(process, kernel32_mod, "FreeLibrary");
+  auto const free_library =
+    FindProcedure(export_cache, kernel32_mod, "FreeLibrary");
 
   auto const free_library_ret =
     Call(process,
@@ -206,18 +221,34 @@ inline void FreeDll(Process const& process, HMODULE module)
   }
 }
 
+inline void FreeDll(Process const& process, HMODULE module)
+{
+  detail::ExportCache export_cache{process};
+  FreeDll(process, export_cache, module);
+}
+
 // TODO: Support passing an arg to the export (e.g. a string).
 inline CallResult<DWORD_PTR> CallExport(Process const& process,
+                                        detail::ExportCache& export_cache,
                                         HMODULE module,
                                         std::string const& export_name)
 {
   Module const module_remote{process, module};
-  auto const export_ptr = FindProcedure(process, module_remote, export_name);
+  auto const export_ptr =
+    FindProcedure(export_cache, module_remote, export_name);
 
   return Call(
     process, reinterpret_cast<DWORD_PTR (*)()>(export_ptr), CallConv::kDefault);
 }
 
+inline CallResult<DWORD_PTR> CallExport(Process const& process,
+                                        HMODULE module,
+                                        std::string const& export_name)
+{
+  detail::ExportCache export_cache{process};
+  return CallExport(process, export_cache, module, export_name);
+}
+
 class CreateAndInjectData
 {
 public:
@@ -364,14 +395,16 @@ inline CreateAndInjectData CreateAndInject(std::wstring const& path,
   try
   {
     Process const process{proc_info.dwProcessId};
+    detail::ExportCache export_cache{process};
 
-    HMODULE const remote_module = InjectDll(process, module, flags);
+    HMODULE const remote_module =
+      InjectDll(process, export_cache, module, flags);
 
     CallResult<DWORD_PTR> const export_ret = [&]()
     {
       if (!export_name.empty())
       {
-        return CallExport(process, remote_module, export_name);
+        return CallExport(process, export_cache, remote_module, export_name);
       }
 
       return CallResult<DWORD_PTR>(0, 0);
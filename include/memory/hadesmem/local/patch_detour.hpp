@@ -65,7 +65,8 @@
 
 // TODO: Detect cases where hooking may overflow past the end of a function, and
 // fail. (Provide policy or flag to allow overriding this behaviour.) Examples
-// may be instructions such as int 3, ret, jmp, etc.
+// may be instructions such as int 3, ret, jmp, etc. pelib::CodeIndex can
+// provide the bounds (see GetSafePatchSize).
 
 // TODO: Test references, pointers, const, volatile, perfect forwarding, etc.
 
@@ -0,0 +1,254 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <ostream>
+#include <string>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+// TODO: Add setters (and UpdateWrite) like ImportDir once there is a use for
+// them.
+
+namespace hadesmem
+{
+// A delay load descriptor (ImgDelayDescr). Read in bulk by
+// DelayImportDirList, so the descriptor data can be passed in rather than
+// read again.
+//
+// The address getters always return RVAs (or zero if the field is unset or
+// invalid), regardless of whether the descriptor is RVA based or a legacy VA
+// based descriptor.
+class DelayImportDir
+{
+public:
+  explicit DelayImportDir(Process const& process,
+                          PeFile const& pe_file,
+                          void* descriptor)
+    : process_{&process},
+      pe_file_{&pe_file},
+      base_{static_cast<std::uint8_t*>(descriptor)},
+      data_(Read<pelib::ImageDelayLoadDescriptor>(process, descriptor))
+  {
+    Initialize();
+  }
+
+  explicit DelayImportDir(Process const& process,
+                          PeFile const& pe_file,
+                          void* descriptor,
+                          pelib::ImageDelayLoadDescriptor const& data)
+    : process_{&process},
+      pe_file_{&pe_file},
+      base_{static_cast<std::uint8_t*>(descriptor)},
+      data_(data)
+  {
+    Initialize();
+  }
+
+  explicit DelayImportDir(Process const&& process,
+                          PeFile const& pe_file,
+                          void* descriptor) = delete;
+
+  explicit DelayImportDir(Process const& process,
+                          PeFile&& pe_file,
+                          void* descriptor) = delete;
+
+  explicit DelayImportDir(Process const&& process,
+                          PeFile&& pe_file,
+                          void* descriptor) = delete;
+
+  explicit DelayImportDir(Process const&& process,
+                          PeFile const& pe_file,
+                          void* descriptor,
+                          pelib::ImageDelayLoadDescriptor const& data) = delete;
+
+  explicit DelayImportDir(Process const& process,
+                          PeFile&& pe_file,
+                          void* descriptor,
+                          pelib::ImageDelayLoadDescriptor const& data) = delete;
+
+  explicit DelayImportDir(Process const&& process,
+                          PeFile&& pe_file,
+                          void* descriptor,
+                          pelib::ImageDelayLoadDescriptor const& data) = delete;
+
+  void* GetBase() const noexcept
+  {
+    return base_;
+  }
+
+  pelib::ImageDelayLoadDescriptor const& GetData() const noexcept
+  {
+    return data_;
+  }
+
+  DWORD GetAttributes() const noexcept
+  {
+    return data_.Attributes;
+  }
+
+  bool IsRvaBased() const noexcept
+  {
+    return (data_.Attributes & pelib::kDelayLoadRvaBased) != 0;
+  }
+
+  DWORD GetTimeDateStamp() const noexcept
+  {
+    return data_.TimeDateStamp;
+  }
+
+  DWORD GetDllNameRva() const noexcept
+  {
+    return ToRva(data_.DllNameRVA);
+  }
+
+  DWORD GetModuleHandleRva() const noexcept
+  {
+    return ToRva(data_.ModuleHandleRVA);
+  }
+
+  DWORD GetImportAddressTableRva() const noexcept
+  {
+    return ToRva(data_.ImportAddressTableRVA);
+  }
+
+  DWORD GetImportNameTableRva() const noexcept
+  {
+    return ToRva(data_.ImportNameTableRVA);
+  }
+
+  DWORD GetBoundImportAddressTableRva() const noexcept
+  {
+    return ToRva(data_.BoundImportAddressTableRVA);
+  }
+
+  DWORD GetUnloadInformationTableRva() const noexcept
+  {
+    return ToRva(data_.UnloadInformationTableRVA);
+  }
+
+  // Converts an address stored in the descriptor or its tables (e.g. the
+  // IMAGE_IMPORT_BY_NAME pointers in the name table) to an RVA. Returns zero
+  // if a VA is outside the image.
+  DWORD ToRva(ULONGLONG address) const noexcept
+  {
+    if (IsRvaBased())
+    {
+      return address > 0xFFFFFFFFULL ? 0 : static_cast<DWORD>(address);
+    }
+
+    if (address < image_base_ || address - image_base_ > 0xFFFFFFFFULL)
+    {
+      return 0;
+    }
+
+    return static_cast<DWORD>(address - image_base_);
+  }
+
+  std::string GetName() const
+  {
+    void* const name_va = RvaToVa(*process_, *pe_file_, GetDllNameRva());
+    if (!name_va)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Invalid delay import module name."});
+    }
+
+    return detail::CheckedReadString<char>(*process_, *pe_file_, name_va);
+  }
+
+  // The descriptor array is terminated by an entry with no name.
+  bool IsTerminator() const noexcept
+  {
+    return !data_.DllNameRVA;
+  }
+
+private:
+  void Initialize()
+  {
+    if (IsRvaBased())
+    {
+      return;
+    }
+
+    // Legacy descriptors hold VAs, which are covered by base relocations, so
+    // in a loaded image they are relative to the actual base rather than the
+    // preferred one.
+    image_base_ =
+      pe_file_->GetType() == PeFileType::kImage
+        ? reinterpret_cast<std::uintptr_t>(pe_file_->GetBase())
+        : NtHeaders{*process_, *pe_file_}.GetImageBase();
+  }
+
+  Process const* process_;
+  PeFile const* pe_file_;
+  std::uint8_t* base_;
+  pelib::ImageDelayLoadDescriptor data_;
+  ULONGLONG image_base_{};
+};
+
+inline bool operator==(DelayImportDir const& lhs,
+                       DelayImportDir const& rhs) noexcept
+{
+  return lhs.GetBase() == rhs.GetBase();
+}
+
+inline bool operator!=(DelayImportDir const& lhs,
+                       DelayImportDir const& rhs) noexcept
+{
+  return !(lhs == rhs);
+}
+
+inline bool operator<(DelayImportDir const& lhs,
+                      DelayImportDir const& rhs) noexcept
+{
+  return lhs.GetBase() < rhs.GetBase();
+}
+
+inline bool operator<=(DelayImportDir const& lhs,
+                       DelayImportDir const& rhs) noexcept
+{
+  return lhs.GetBase() <= rhs.GetBase();
+}
+
+inline bool operator>(DelayImportDir const& lhs,
+                      DelayImportDir const& rhs) noexcept
+{
+  return lhs.GetBase() > rhs.GetBase();
+}
+
+inline bool operator>=(DelayImportDir const& lhs,
+                       DelayImportDir const& rhs) noexcept
+{
+  return lhs.GetBase() >= rhs.GetBase();
+}
+
+inline std::ostream& operator<<(std::ostream& lhs, DelayImportDir const& rhs)
+{
+  std::locale const old = lhs.imbue(std::locale::classic());
+  lhs << rhs.GetBase();
+  lhs.imbue(old);
+  return lhs;
+}
+
+inline std::wostream& operator<<(std::wostream& lhs,
+                                 DelayImportDir const& rhs)
+{
+  std::locale const old = lhs.imbue(std::locale::classic());
+  lhs << rhs.GetBase();
+  lhs.imbue(old);
+  return lhs;
+}
+}
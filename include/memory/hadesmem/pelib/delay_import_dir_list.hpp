@@ -0,0 +1,109 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/pelib/delay_import_dir.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/process.hpp>
+
+namespace hadesmem
+{
+// All delay load descriptors of a file. The descriptor array is read up to
+// its terminator in a few bulk reads (the size in the data directory isn't
+// used by the loader, so it isn't trusted here either). A file without a
+// delay import directory, or with an invalid one, has an empty list.
+class DelayImportDirList
+{
+public:
+  using value_type = DelayImportDir;
+  using iterator = std::vector<DelayImportDir>::const_iterator;
+  using const_iterator = std::vector<DelayImportDir>::const_iterator;
+
+  explicit DelayImportDirList(Process const& process, PeFile const& pe_file)
+  {
+    NtHeaders const nt_headers{process, pe_file};
+    DWORD const rva =
+      nt_headers.GetDataDirectoryVirtualAddress(PeDataDir::DelayImport);
+    if (!rva)
+    {
+      return;
+    }
+
+    auto const descriptors =
+      detail::ReadTerminatedArray<pelib::ImageDelayLoadDescriptor>(
+        process,
+        pe_file,
+        rva,
+        [](pelib::ImageDelayLoadDescriptor const& d) { return !d.DllNameRVA; },
+        kMaxDescriptors);
+    if (descriptors.empty())
+    {
+      return;
+    }
+
+    auto const base = static_cast<pelib::ImageDelayLoadDescriptor*>(
+      RvaToVa(process, pe_file, rva));
+    dirs_.reserve(descriptors.size());
+    for (std::size_t i = 0; i < descriptors.size(); ++i)
+    {
+      dirs_.emplace_back(process, pe_file, base + i, descriptors[i]);
+    }
+  }
+
+  explicit DelayImportDirList(Process const&& process,
+                              PeFile const& pe_file) = delete;
+
+  explicit DelayImportDirList(Process const& process,
+                              PeFile&& pe_file) = delete;
+
+  explicit DelayImportDirList(Process const&& process,
+                              PeFile&& pe_file) = delete;
+
+  const_iterator begin() const noexcept
+  {
+    return std::begin(dirs_);
+  }
+
+  const_iterator cbegin() const noexcept
+  {
+    return std::begin(dirs_);
+  }
+
+  const_iterator end() const noexcept
+  {
+    return std::end(dirs_);
+  }
+
+  const_iterator cend() const noexcept
+  {
+    return std::end(dirs_);
+  }
+
+  std::size_t size() const noexcept
+  {
+    return dirs_.size();
+  }
+
+  bool empty() const noexcept
+  {
+    return dirs_.empty();
+  }
+
+private:
+  // Far more modules than any real file delay loads. Bounds the list for
+  // malformed files with no terminator.
+  static std::size_t const kMaxDescriptors = 0x1000;
+
+  std::vector<DelayImportDir> dirs_;
+};
+}
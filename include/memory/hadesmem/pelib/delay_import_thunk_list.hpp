@@ -0,0 +1,251 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/pelib/delay_import_dir.hpp>
+#include <hadesmem/pelib/import_thunk.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+namespace hadesmem
+{
+// A single delay loaded import. A value type, as the thunks are read in bulk
+// by DelayImportThunkList.
+class DelayImportThunk
+{
+public:
+  explicit DelayImportThunk(DWORD iat_rva,
+                            ULONGLONG name_table_entry,
+                            ULONGLONG function,
+                            bool by_ordinal) noexcept
+    : iat_rva_{iat_rva},
+      name_table_entry_{name_table_entry},
+      function_{function},
+      by_ordinal_{by_ordinal}
+  {
+  }
+
+  // RVA of the IAT slot the delay load helper writes the resolved address
+  // to.
+  DWORD GetIatRva() const noexcept
+  {
+    return iat_rva_;
+  }
+
+  // Raw import name table entry.
+  ULONGLONG GetNameTableEntry() const noexcept
+  {
+    return name_table_entry_;
+  }
+
+  // Current IAT value. Until the import is resolved this points to the delay
+  // load thunk in the importing module.
+  ULONGLONG GetFunction() const noexcept
+  {
+    return function_;
+  }
+
+  bool ByOrdinal() const noexcept
+  {
+    return by_ordinal_;
+  }
+
+  // Only valid if ByOrdinal().
+  WORD GetOrdinal() const noexcept
+  {
+    return static_cast<WORD>(name_table_entry_ & 0xFFFF);
+  }
+
+  // Only valid if !ByOrdinal(). False if the IMAGE_IMPORT_BY_NAME is outside
+  // the file or unreadable.
+  bool IsNameValid() const noexcept
+  {
+    return name_valid_;
+  }
+
+  // Only valid if IsNameValid().
+  WORD GetHint() const noexcept
+  {
+    return hint_;
+  }
+
+  // Only valid if IsNameValid().
+  std::string const& GetName() const noexcept
+  {
+    return name_;
+  }
+
+private:
+  friend class DelayImportThunkList;
+
+  void SetName(WORD hint, std::string const& name)
+  {
+    name_valid_ = true;
+    hint_ = hint;
+    name_ = name;
+  }
+
+  DWORD iat_rva_;
+  ULONGLONG name_table_entry_;
+  ULONGLONG function_;
+  bool by_ordinal_;
+  bool name_valid_{};
+  WORD hint_{};
+  std::string name_;
+};
+
+// All imports of a delay load descriptor. The import name table and IAT are
+// each read in bulk and walked in parallel, and the hints and names are then
+// fetched with a single batched read (see detail::ReadImportByNameBatch)
+// rather than one read per import. Names which don't fit in the batched read
+// fall back to a normal string read.
+//
+// The import name table determines the number of imports (the IAT has no
+// terminator of its own once it is resolved), so a descriptor without one has
+// an empty list.
+class DelayImportThunkList
+{
+public:
+  using value_type = DelayImportThunk;
+  using iterator = std::vector<DelayImportThunk>::const_iterator;
+  using const_iterator = std::vector<DelayImportThunk>::const_iterator;
+
+  explicit DelayImportThunkList(Process const& process,
+                                PeFile const& pe_file,
+                                DelayImportDir const& dir)
+  {
+    DWORD const int_rva = dir.GetImportNameTableRva();
+    DWORD const iat_rva = dir.GetImportAddressTableRva();
+    if (!int_rva || !iat_rva)
+    {
+      return;
+    }
+
+    std::vector<ULONGLONG> const name_table =
+      detail::ReadThunkArray(process, pe_file, int_rva, kMaxThunks);
+    std::vector<ULONGLONG> const iat = detail::ReadThunkArray(
+      process, pe_file, iat_rva, name_table.size(), false);
+
+    auto const thunk_size = static_cast<DWORD>(
+      pe_file.Is64() ? sizeof(ULONGLONG) : sizeof(DWORD));
+    ULONGLONG const ordinal_flag =
+      pe_file.Is64() ? IMAGE_ORDINAL_FLAG64 : IMAGE_ORDINAL_FLAG32;
+    thunks_.reserve(name_table.size());
+    for (std::size_t i = 0; i < name_table.size(); ++i)
+    {
+      thunks_.emplace_back(iat_rva + static_cast<DWORD>(i) * thunk_size,
+                           name_table[i],
+                           i < iat.size() ? iat[i] : 0,
+                           (name_table[i] & ordinal_flag) != 0);
+    }
+
+    ReadNames(process, pe_file, dir);
+  }
+
+  explicit DelayImportThunkList(Process const&& process,
+                                PeFile const& pe_file,
+                                DelayImportDir const& dir) = delete;
+
+  explicit DelayImportThunkList(Process const& process,
+                                PeFile&& pe_file,
+                                DelayImportDir const& dir) = delete;
+
+  explicit DelayImportThunkList(Process const&& process,
+                                PeFile&& pe_file,
+                                DelayImportDir const& dir) = delete;
+
+  const_iterator begin() const noexcept
+  {
+    return std::begin(thunks_);
+  }
+
+  const_iterator cbegin() const noexcept
+  {
+    return std::begin(thunks_);
+  }
+
+  const_iterator end() const noexcept
+  {
+    return std::end(thunks_);
+  }
+
+  const_iterator cend() const noexcept
+  {
+    return std::end(thunks_);
+  }
+
+  std::size_t size() const noexcept
+  {
+    return thunks_.size();
+  }
+
+  bool empty() const noexcept
+  {
+    return thunks_.empty();
+  }
+
+private:
+  // Bounds the list for malformed files with no terminator.
+  static std::size_t const kMaxThunks = 0x10000;
+
+  void ReadNames(Process const& process,
+                 PeFile const& pe_file,
+                 DelayImportDir const& dir)
+  {
+    std::vector<DWORD> name_rvas;
+    name_rvas.reserve(thunks_.size());
+    for (auto const& thunk : thunks_)
+    {
+      name_rvas.push_back(
+        thunk.ByOrdinal() ? 0 : dir.ToRva(thunk.GetNameTableEntry()));
+    }
+
+    auto const import_by_names =
+      detail::ReadImportByNameBatch(process, pe_file, name_rvas);
+    for (std::size_t i = 0; i < thunks_.size(); ++i)
+    {
+      detail::ImportByName const& import_by_name = import_by_names[i];
+      if (import_by_name.valid)
+      {
+        thunks_[i].SetName(import_by_name.hint, import_by_name.name);
+        continue;
+      }
+
+      // Names too long for the batched read. Invalid ones fail again here.
+      auto const name_import = static_cast<std::uint8_t*>(
+        name_rvas[i] ? detail::RvaToVaChecked(
+                         process, pe_file, name_rvas[i], sizeof(WORD) + 1)
+                     : nullptr);
+      if (!name_import)
+      {
+        continue;
+      }
+
+      try
+      {
+        WORD const hint = Read<WORD>(process, name_import);
+        thunks_[i].SetName(hint,
+                           detail::CheckedReadString<char>(
+                             process, pe_file, name_import + sizeof(WORD)));
+      }
+      catch (std::exception const& /*e*/)
+      {
+        continue;
+      }
+    }
+  }
+
+  std::vector<DelayImportThunk> thunks_;
+};
+}
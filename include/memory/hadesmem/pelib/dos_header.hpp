@@ -27,7 +27,9 @@ class DosHeader
 {
 public:
   explicit DosHeader(Process const& process, PeFile const& pe_file)
-    : process_{&process}, base_{static_cast<std::uint8_t*>(pe_file.GetBase())}
+    : process_{&process},
+      pe_file_{&pe_file},
+      base_{static_cast<std::uint8_t*>(pe_file.GetBase())}
   {
     UpdateRead();
 
@@ -40,6 +42,19 @@ public:
 
   explicit DosHeader(Process const&& process, PeFile&& pe_file) = delete;
 
+  // Reads from the PeFile's buffer (or the process it was constructed with).
+  explicit DosHeader(PeFile const& pe_file)
+    : process_{nullptr},
+      pe_file_{&pe_file},
+      base_{static_cast<std::uint8_t*>(pe_file.GetBase())}
+  {
+    UpdateRead();
+
+    EnsureValid();
+  }
+
+  explicit DosHeader(PeFile&& pe_file) = delete;
+
   PVOID GetBase() const noexcept
   {
     return base_;
@@ -61,12 +76,13 @@ public:
 
   void UpdateRead()
   {
-    data_ = Read<IMAGE_DOS_HEADER>(*process_, base_);
+    data_ = detail::ReadPe<IMAGE_DOS_HEADER>(process_, *pe_file_, base_);
   }
 
   void UpdateWrite()
   {
-    Write(*process_, base_, data_);
+    detail::WritePe(process_, *pe_file_, base_, data_);
+    pe_file_->RefreshHeaders();
   }
 
   WORD GetMagic() const
@@ -270,6 +286,7 @@ public:
 
 private:
   Process const* process_;
+  PeFile const* pe_file_;
   PBYTE base_;
   IMAGE_DOS_HEADER data_ = IMAGE_DOS_HEADER{};
 };
@@ -0,0 +1,152 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <ostream>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/process.hpp>
+
+namespace hadesmem
+{
+// Exception directory (.pdata) of an x64 file, i.e. a table of
+// RUNTIME_FUNCTION entries sorted by BeginAddress. x86 files have no exception
+// directory, and other architectures use different formats, so they're not
+// supported.
+class ExceptionDir
+{
+public:
+  explicit ExceptionDir(Process const& process, PeFile const& pe_file)
+  {
+    if (!pe_file.Is64())
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{}
+        << ErrorString{"Exception directory is only supported for x64."});
+    }
+
+    NtHeaders const nt_headers{process, pe_file};
+
+    rva_ = nt_headers.GetDataDirectoryVirtualAddress(PeDataDir::Exception);
+    size_ = nt_headers.GetDataDirectorySize(PeDataDir::Exception);
+    if (!rva_ || !size_)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"PE file has no exception directory."});
+    }
+
+    base_ = static_cast<std::uint8_t*>(RvaToVa(process, pe_file, rva_));
+    auto const file_base = static_cast<std::uint8_t*>(pe_file.GetBase());
+    auto const file_end = file_base + pe_file.GetSize();
+    if (!base_ || base_ < file_base || base_ >= file_end)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Exception directory is invalid."});
+    }
+
+    // Clamp the number of entries to what's actually in the file/image, as
+    // the size is frequently garbage in malformed files.
+    std::size_t const size_available = (std::min)(
+      static_cast<std::size_t>(size_),
+      static_cast<std::size_t>(file_end - base_));
+    num_entries_ = static_cast<DWORD>(
+      size_available / sizeof(pelib::ImageRuntimeFunctionEntry));
+  }
+
+  explicit ExceptionDir(Process const&& process,
+                        PeFile const& pe_file) = delete;
+
+  explicit ExceptionDir(Process const& process, PeFile&& pe_file) = delete;
+
+  explicit ExceptionDir(Process const&& process, PeFile&& pe_file) = delete;
+
+  void* GetBase() const noexcept
+  {
+    return base_;
+  }
+
+  DWORD GetRva() const noexcept
+  {
+    return rva_;
+  }
+
+  DWORD GetSize() const noexcept
+  {
+    return size_;
+  }
+
+  DWORD GetNumberOfEntries() const noexcept
+  {
+    return num_entries_;
+  }
+
+private:
+  std::uint8_t* base_{};
+  DWORD rva_{};
+  DWORD size_{};
+  DWORD num_entries_{};
+};
+
+inline bool operator==(ExceptionDir const& lhs,
+                       ExceptionDir const& rhs) noexcept
+{
+  return lhs.GetBase() == rhs.GetBase();
+}
+
+inline bool operator!=(ExceptionDir const& lhs,
+                       ExceptionDir const& rhs) noexcept
+{
+  return !(lhs == rhs);
+}
+
+inline bool operator<(ExceptionDir const& lhs,
+                      ExceptionDir const& rhs) noexcept
+{
+  return lhs.GetBase() < rhs.GetBase();
+}
+
+inline bool operator<=(ExceptionDir const& lhs,
+                       ExceptionDir const& rhs) noexcept
+{
+  return lhs.GetBase() <= rhs.GetBase();
+}
+
+inline bool operator>(ExceptionDir const& lhs,
+                      ExceptionDir const& rhs) noexcept
+{
+  return lhs.GetBase() > rhs.GetBase();
+}
+
+inline bool operator>=(ExceptionDir const& lhs,
+                       ExceptionDir const& rhs) noexcept
+{
+  return lhs.GetBase() >= rhs.GetBase();
+}
+
+inline std::ostream& operator<<(std::ostream& lhs, ExceptionDir const& rhs)
+{
+  std::locale const old = lhs.imbue(std::locale::classic());
+  lhs << rhs.GetBase();
+  lhs.imbue(old);
+  return lhs;
+}
+
+inline std::wostream& operator<<(std::wostream& lhs, ExceptionDir const& rhs)
+{
+  std::locale const old = lhs.imbue(std::locale::classic());
+  lhs << rhs.GetBase();
+  lhs.imbue(old);
+  return lhs;
+}
+}
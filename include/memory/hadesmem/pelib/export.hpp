@@ -3,7 +3,9 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <iosfwd>
 #include <limits>
 #include <memory>
@@ -11,6 +13,7 @@
 #include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <windows.h>
 #include <winnt.h>
@@ -27,77 +30,219 @@
 
 // TODO: Ensure we properly support data exports. http://bit.ly/1Lu548u
 
-// TODO: Add constructor to look up Export by name, optimized by using binary
-// search.
+// TODO: Add constructor to look up Export by name (using
+// detail::ExportNameIndex).
 
 // TODO: Is our naming of ordinal number vs procedure number correct/orthodox?
 // Look into what other people/tools/documents call things.
 
 namespace hadesmem
 {
-class Export
+namespace detail
+{
+// Number of whole Ts (up to count) between ptr and the end of the file/image.
+template <typename T>
+inline DWORD CountInFile(PeFile const& pe_file, T const* ptr, DWORD count)
+{
+  auto const cur = reinterpret_cast<std::uint8_t const*>(ptr);
+  auto const base = static_cast<std::uint8_t const*>(pe_file.GetBase());
+  auto const end = base + pe_file.GetSize();
+  if (!cur || cur < base || cur >= end)
+  {
+    return 0;
+  }
+
+  return static_cast<DWORD>(
+    (std::min)(static_cast<std::size_t>(count),
+               static_cast<std::size_t>(end - cur) / sizeof(T)));
+}
+
+// Bulk copy of the export directory and its function, name and name ordinal
+// tables, plus an index mapping each ordinal number to its (first) entry in
+// the name tables. Built once and shared by every Export created from it, so
+// enumerating N exports is O(N) rather than re-reading the directory and
+// linearly searching the name ordinal table for each one.
+class ExportTables
 {
 public:
-  explicit Export(Process const& process,
-                  PeFile const& pe_file,
-                  WORD procedure_number)
-    : process_{&process},
-      pe_file_{&pe_file},
-      procedure_number_{procedure_number}
+  static DWORD const kNoName = static_cast<DWORD>(-1);
+
+  explicit ExportTables(Process const& process, PeFile const& pe_file)
   {
     ExportDir const export_dir{process, pe_file};
 
-    auto const ordinal_base = static_cast<WORD>(export_dir.GetOrdinalBase());
-    HADESMEM_DETAIL_ASSERT(procedure_number_ >= ordinal_base);
-    ordinal_number_ = static_cast<WORD>(procedure_number_ - ordinal_base);
-    if (ordinal_number_ >= export_dir.GetNumberOfFunctions())
+    ordinal_base_ = export_dir.GetOrdinalBase();
+    num_funcs_ = export_dir.GetNumberOfFunctions();
+
+    NtHeaders const nt_headers{process, pe_file};
+    export_dir_start_ =
+      nt_headers.GetDataDirectoryVirtualAddress(PeDataDir::Export);
+    export_dir_end_ =
+      export_dir_start_ + nt_headers.GetDataDirectorySize(PeDataDir::Export);
+
+    ptr_functions_ = static_cast<DWORD*>(
+      RvaToVa(process, pe_file, export_dir.GetAddressOfFunctions()));
+    if (!ptr_functions_)
     {
-      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
-                                      << ErrorString{"Ordinal out of range."});
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"AddressOfFunctions invalid."});
     }
 
-    if (DWORD const num_names = export_dir.GetNumberOfNames())
+    // Ordinal numbers are WORDs, so nothing past the first 64K entries is
+    // reachable. NumberOfFunctions is frequently garbage in malformed files,
+    // so don't trust it any further than that, or past the end of the
+    // file/image (so a truncated table loses only the entries that are
+    // missing, rather than making the read fail).
+    DWORD const num_funcs_reachable = CountInFile(
+      pe_file, ptr_functions_, (std::min)(num_funcs_, 0x10000UL));
+    functions_ =
+      ReadVector<DWORD>(process, ptr_functions_, num_funcs_reachable);
+    name_index_.assign(functions_.size(), DWORD{kNoName});
+
+    if (DWORD num_names = export_dir.GetNumberOfNames())
     {
       WORD* const ptr_ordinals = static_cast<WORD*>(
         RvaToVa(process, pe_file, export_dir.GetAddressOfNameOrdinals()));
       DWORD* const ptr_names = static_cast<DWORD*>(
         RvaToVa(process, pe_file, export_dir.GetAddressOfNames()));
 
-      if (ptr_ordinals && ptr_names)
+      // Likewise, NumberOfNames is clamped to the shorter of the two tables.
+      num_names = (std::min)(CountInFile(pe_file, ptr_ordinals, num_names),
+                             CountInFile(pe_file, ptr_names, num_names));
+      if (num_names)
       {
-        std::vector<WORD> const name_ordinals =
-          ReadVector<WORD>(process, ptr_ordinals, num_names);
-        auto const name_ord_iter = std::find(
-          std::begin(name_ordinals), std::end(name_ordinals), ordinal_number_);
-        if (name_ord_iter != std::end(name_ordinals))
+        name_ordinals_ = ReadVector<WORD>(process, ptr_ordinals, num_names);
+        names_ = ReadVector<DWORD>(process, ptr_names, num_names);
+
+        // Walk backwards so the first name wins if an ordinal is named more
+        // than once, the same as a front-to-back linear search would find.
+        for (DWORD i = num_names; i--;)
         {
-          by_name_ = true;
-          DWORD const name_rva =
-            Read<DWORD>(process,
-                        ptr_names + std::distance(std::begin(name_ordinals),
-                                                  name_ord_iter));
-          name_ = detail::CheckedReadString<char>(
-            process, pe_file, RvaToVa(process, pe_file, name_rva));
+          WORD const ordinal = name_ordinals_[i];
+          if (ordinal < name_index_.size())
+          {
+            name_index_[ordinal] = i;
+          }
         }
       }
     }
+  }
 
-    DWORD* const ptr_functions = static_cast<DWORD*>(
-      RvaToVa(process, pe_file, export_dir.GetAddressOfFunctions()));
-    if (!ptr_functions)
+  explicit ExportTables(Process const&& process,
+                        PeFile const& pe_file) = delete;
+
+  explicit ExportTables(Process const& process, PeFile&& pe_file) = delete;
+
+  explicit ExportTables(Process const&& process, PeFile&& pe_file) = delete;
+
+  DWORD GetOrdinalBase() const noexcept
+  {
+    return ordinal_base_;
+  }
+
+  DWORD GetNumberOfFunctions() const noexcept
+  {
+    return num_funcs_;
+  }
+
+  DWORD GetExportDirStart() const noexcept
+  {
+    return export_dir_start_;
+  }
+
+  DWORD GetExportDirEnd() const noexcept
+  {
+    return export_dir_end_;
+  }
+
+  DWORD* GetFunctionsPtr() const noexcept
+  {
+    return ptr_functions_;
+  }
+
+  // Clamped to the reachable ordinal range. See the constructor.
+  std::vector<DWORD> const& GetFunctions() const noexcept
+  {
+    return functions_;
+  }
+
+  std::vector<DWORD> const& GetNames() const noexcept
+  {
+    return names_;
+  }
+
+  std::vector<WORD> const& GetNameOrdinals() const noexcept
+  {
+    return name_ordinals_;
+  }
+
+  // Returns kNoName if the ordinal is only exported by ordinal.
+  DWORD GetNameIndex(WORD ordinal_number) const noexcept
+  {
+    return ordinal_number < name_index_.size() ? name_index_[ordinal_number]
+                                               : kNoName;
+  }
+
+private:
+  DWORD ordinal_base_{};
+  DWORD num_funcs_{};
+  DWORD export_dir_start_{};
+  DWORD export_dir_end_{};
+  DWORD* ptr_functions_{};
+  std::vector<DWORD> functions_;
+  std::vector<DWORD> names_;
+  std::vector<WORD> name_ordinals_;
+  std::vector<DWORD> name_index_;
+};
+}
+
+class Export
+{
+public:
+  explicit Export(Process const& process,
+                  PeFile const& pe_file,
+                  WORD procedure_number)
+    : Export{process,
+             pe_file,
+             detail::ExportTables{process, pe_file},
+             procedure_number}
+  {
+  }
+
+  // Use this overload when creating more than one Export from the same module
+  // (e.g. ExportList) to avoid re-reading the export tables for each one.
+  explicit Export(Process const& process,
+                  PeFile const& pe_file,
+                  detail::ExportTables const& tables,
+                  WORD procedure_number)
+    : process_{&process},
+      pe_file_{&pe_file},
+      procedure_number_{procedure_number}
+  {
+    auto const ordinal_base = static_cast<WORD>(tables.GetOrdinalBase());
+    HADESMEM_DETAIL_ASSERT(procedure_number_ >= ordinal_base);
+    ordinal_number_ = static_cast<WORD>(procedure_number_ - ordinal_base);
+    if (ordinal_number_ >= tables.GetNumberOfFunctions() ||
+        ordinal_number_ >= tables.GetFunctions().size())
     {
-      HADESMEM_DETAIL_THROW_EXCEPTION(
-        Error{} << ErrorString{"AddressOfFunctions invalid."});
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Ordinal out of range."});
     }
-    rva_ptr_ = reinterpret_cast<DWORD*>(ptr_functions + ordinal_number_);
-    DWORD const func_rva = Read<DWORD>(process, rva_ptr_);
 
-    NtHeaders const nt_headers{process, pe_file};
+    DWORD const name_index = tables.GetNameIndex(ordinal_number_);
+    if (name_index != detail::ExportTables::kNoName)
+    {
+      by_name_ = true;
+      DWORD const name_rva = tables.GetNames()[name_index];
+      name_ = detail::CheckedReadString<char>(
+        process, pe_file, RvaToVa(process, pe_file, name_rva));
+    }
 
-    DWORD const export_dir_start =
-      nt_headers.GetDataDirectoryVirtualAddress(PeDataDir::Export);
-    DWORD const export_dir_end =
-      export_dir_start + nt_headers.GetDataDirectorySize(PeDataDir::Export);
+    rva_ptr_ = tables.GetFunctionsPtr() + ordinal_number_;
+    DWORD const func_rva = tables.GetFunctions()[ordinal_number_];
+
+    DWORD const export_dir_start = tables.GetExportDirStart();
+    DWORD const export_dir_end = tables.GetExportDirEnd();
 
     // Check function RVA. If it lies inside the export dir region
     // then it's a forwarded export. Otherwise it's a regular RVA.
@@ -138,6 +283,21 @@ public:
                   PeFile&& pe_file,
                   WORD procedure_number) = delete;
 
+  explicit Export(Process const&& process,
+                  PeFile const& pe_file,
+                  detail::ExportTables const& tables,
+                  WORD procedure_number) = delete;
+
+  explicit Export(Process const& process,
+                  PeFile&& pe_file,
+                  detail::ExportTables const& tables,
+                  WORD procedure_number) = delete;
+
+  explicit Export(Process const&& process,
+                  PeFile&& pe_file,
+                  detail::ExportTables const& tables,
+                  WORD procedure_number) = delete;
+
   DWORD GetRva() const noexcept
   {
     return rva_;
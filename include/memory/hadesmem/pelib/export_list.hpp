@@ -6,6 +6,7 @@
 #include <iterator>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include <windows.h>
 
@@ -44,10 +45,29 @@ public:
   {
     try
     {
-      ExportDir const export_dir{process, pe_file};
-      Export const exp{
-        process, pe_file, static_cast<WORD>(export_dir.GetOrdinalBase())};
-      impl_ = std::make_shared<Impl>(process, pe_file, exp);
+      Init(process,
+           pe_file,
+           std::make_shared<detail::ExportTables const>(process, pe_file));
+    }
+    catch (std::exception const& /*e*/)
+    {
+      // Nothing to do here.
+    }
+  }
+
+  // Null tables (e.g. the module has no export directory) results in the end
+  // iterator.
+  explicit ExportIterator(
+    Process const& process,
+    PeFile const& pe_file,
+    std::shared_ptr<detail::ExportTables const> const& tables)
+  {
+    try
+    {
+      if (tables)
+      {
+        Init(process, pe_file, tables);
+      }
     }
     catch (std::exception const& /*e*/)
     {
@@ -79,25 +99,19 @@ public:
     {
       HADESMEM_DETAIL_ASSERT(impl_.get());
 
-      ExportDir const export_dir{*impl_->process_, *impl_->pe_file_};
+      detail::ExportTables const& tables = *impl_->tables_;
 
-      DWORD* ptr_functions =
-        static_cast<DWORD*>(RvaToVa(*impl_->process_,
-                                    *impl_->pe_file_,
-                                    export_dir.GetAddressOfFunctions()));
+      DWORD const ordinal_base = tables.GetOrdinalBase();
 
-      DWORD const ordinal_base = export_dir.GetOrdinalBase();
-
-      WORD const procedure_number = impl_->export_->GetProcedureNumber();
-
-      WORD ordinal_number =
-        static_cast<WORD>((procedure_number - ordinal_base) + 1);
-
-      DWORD const num_funcs = export_dir.GetNumberOfFunctions();
+      DWORD const num_funcs = tables.GetNumberOfFunctions();
 
+      // Skip unused entries in the (already cached) function table. Ordinal
+      // numbers past the end of the cached table are unreachable anyway (see
+      // ExportTables), so they're treated the same as running off the end.
+      std::vector<DWORD> const& functions = tables.GetFunctions();
+      DWORD ordinal_number = impl_->export_->GetOrdinalNumber() + 1UL;
       for (; ((ordinal_number + ordinal_base) >= ordinal_base) &&
-             !Read<DWORD>(*impl_->process_, ptr_functions + ordinal_number) &&
-             ordinal_number < num_funcs;
+             ordinal_number < functions.size() && !functions[ordinal_number];
            ++ordinal_number)
       {
       }
@@ -116,14 +130,14 @@ public:
           Error{} << ErrorString{"Ordinal number overflow."});
       }
 
-      if (ordinal_number >= num_funcs)
+      if (ordinal_number >= num_funcs || ordinal_number >= functions.size())
       {
         HADESMEM_DETAIL_THROW_EXCEPTION(
           Error{} << ErrorString{"Invalid export number."});
       }
 
-      impl_->export_ =
-        Export{*impl_->process_, *impl_->pe_file_, new_procedure_number};
+      impl_->export_ = Export{
+        *impl_->process_, *impl_->pe_file_, tables, new_procedure_number};
     }
     catch (std::exception const& /*e*/)
     {
@@ -151,19 +165,33 @@ public:
   }
 
 private:
+  void Init(Process const& process,
+            PeFile const& pe_file,
+            std::shared_ptr<detail::ExportTables const> const& tables)
+  {
+    Export const exp{process,
+                     pe_file,
+                     *tables,
+                     static_cast<WORD>(tables->GetOrdinalBase())};
+    impl_ = std::make_shared<Impl>(process, pe_file, tables, exp);
+  }
+
   struct Impl
   {
     explicit Impl(Process const& process,
                   PeFile const& pe_file,
+                  std::shared_ptr<detail::ExportTables const> const& tables,
                   Export const& exp) noexcept
       : process_{&process},
         pe_file_{&pe_file},
+        tables_{tables},
         export_(exp)
     {
     }
 
     Process const* process_;
     PeFile const* pe_file_;
+    std::shared_ptr<detail::ExportTables const> tables_;
     hadesmem::detail::Optional<Export> export_;
   };
 
@@ -178,9 +206,20 @@ public:
   using iterator = ExportIterator<Export>;
   using const_iterator = ExportIterator<Export const>;
 
+  // The export tables are read once here and shared by all iterators (and the
+  // Export objects they create), so writes to the export directory or its
+  // tables after construction are not reflected by the list.
   explicit ExportList(Process const& process, PeFile const& pe_file)
     : process_{&process}, pe_file_{&pe_file}
   {
+    try
+    {
+      tables_ = std::make_shared<detail::ExportTables const>(process, pe_file);
+    }
+    catch (std::exception const& /*e*/)
+    {
+      // Nothing to do here. The list is empty.
+    }
   }
 
   explicit ExportList(Process const&& process, PeFile const& pe_file) = delete;
@@ -191,17 +230,17 @@ public:
 
   iterator begin()
   {
-    return iterator{*process_, *pe_file_};
+    return iterator{*process_, *pe_file_, tables_};
   }
 
   const_iterator begin() const
   {
-    return const_iterator{*process_, *pe_file_};
+    return const_iterator{*process_, *pe_file_, tables_};
   }
 
   const_iterator cbegin() const
   {
-    return const_iterator{*process_, *pe_file_};
+    return const_iterator{*process_, *pe_file_, tables_};
   }
 
   iterator end() noexcept
@@ -222,5 +261,6 @@ public:
 private:
   Process const* process_;
   PeFile const* pe_file_;
+  std::shared_ptr<detail::ExportTables const> tables_;
 };
 }
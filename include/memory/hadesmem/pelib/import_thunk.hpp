@@ -3,12 +3,17 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
+#include <cstring>
+#include <exception>
 #include <memory>
 #include <iosfwd>
 #include <ostream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <windows.h>
 #include <winnt.h>
@@ -20,10 +25,124 @@
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/process.hpp>
 #include <hadesmem/read.hpp>
+#include <hadesmem/read_batch.hpp>
 #include <hadesmem/write.hpp>
 
 namespace hadesmem
 {
+namespace detail
+{
+// Reads a thunk array in a few bulk reads, widening 32-bit thunks. Stops at a
+// zero thunk if terminated is set, otherwise reads max_count thunks (fewer if
+// the array runs off the end of the file).
+inline std::vector<ULONGLONG>
+  ReadThunkArray(Process const& process,
+                 PeFile const& pe_file,
+                 DWORD rva,
+                 std::size_t max_count = static_cast<std::size_t>(-1),
+                 bool terminated = true)
+{
+  if (pe_file.Is64())
+  {
+    return ReadTerminatedArray<ULONGLONG>(
+      process,
+      pe_file,
+      rva,
+      [&](ULONGLONG t) { return terminated && !t; },
+      max_count);
+  }
+
+  auto const thunks = ReadTerminatedArray<DWORD>(
+    process,
+    pe_file,
+    rva,
+    [&](DWORD t) { return terminated && !t; },
+    max_count);
+  return std::vector<ULONGLONG>(std::begin(thunks), std::end(thunks));
+}
+
+// The hint and name of an IMAGE_IMPORT_BY_NAME.
+struct ImportByName
+{
+  bool valid;
+  WORD hint;
+  std::string name;
+};
+
+// Reads the IMAGE_IMPORT_BY_NAME entries at the given RVAs (zero for none)
+// with a single batched read of a fixed size chunk each. Entries which are
+// outside the file, unreadable, or have a name too long for the chunk are
+// left invalid, and should be read individually if needed.
+inline std::vector<ImportByName>
+  ReadImportByNameBatch(Process const& process,
+                        PeFile const& pe_file,
+                        std::vector<DWORD> const& rvas)
+{
+  // Covers the hint and the vast majority of names (including most decorated
+  // C++ names).
+  std::size_t const kChunkSize = 0x80;
+
+  auto const base = static_cast<std::uint8_t*>(pe_file.GetBase());
+  auto const file_end = base + pe_file.GetSize();
+
+  std::vector<ImportByName> import_by_names(rvas.size(),
+                                            ImportByName{false, 0, {}});
+  std::vector<std::array<char, kChunkSize>> bufs;
+  std::vector<ReadBatchRequest> requests;
+  std::vector<std::size_t> indexes;
+  for (std::size_t i = 0; i < rvas.size(); ++i)
+  {
+    auto const va = static_cast<std::uint8_t*>(
+      rvas[i] ? RvaToVa(process, pe_file, rvas[i]) : nullptr);
+    if (!va || va < base || va >= file_end ||
+        static_cast<std::size_t>(file_end - va) <= sizeof(WORD))
+    {
+      continue;
+    }
+
+    auto const available = static_cast<std::size_t>(file_end - va);
+    std::size_t const len = (std::min)(available, kChunkSize);
+    requests.push_back(ReadBatchRequest{va, nullptr, len, false});
+    indexes.push_back(i);
+  }
+
+  bufs.resize(requests.size());
+  for (std::size_t i = 0; i < requests.size(); ++i)
+  {
+    requests[i].data = bufs[i].data();
+  }
+
+  ReadBatch(process, requests);
+
+  for (std::size_t i = 0; i < requests.size(); ++i)
+  {
+    ReadBatchRequest const& request = requests[i];
+    if (!request.succeeded)
+    {
+      continue;
+    }
+
+    char const* const buf = bufs[i].data();
+    char const* const name_beg = buf + sizeof(WORD);
+    char const* const name_end = buf + request.len;
+    char const* const terminator = std::find(name_beg, name_end, '\0');
+    // A name cut off by the end of the file is EOF terminated, the same as
+    // CheckedReadString.
+    if (terminator == name_end && request.len == kChunkSize)
+    {
+      continue;
+    }
+
+    ImportByName& import_by_name = import_by_names[indexes[i]];
+    import_by_name.valid = true;
+    std::memcpy(&import_by_name.hint, buf, sizeof(WORD));
+    import_by_name.name.assign(name_beg, terminator);
+  }
+
+  return import_by_names;
+}
+}
+
 class ImportThunk
 {
 public:
@@ -37,6 +156,29 @@ public:
     UpdateRead();
   }
 
+  // Constructs a thunk from data which has already been read in bulk (see
+  // ImportThunkList). The hint and name are taken from import_by_name if it is
+  // valid, rather than being read on demand.
+  explicit ImportThunk(Process const& process,
+                       PeFile const& pe_file,
+                       void* thunk,
+                       ULONGLONG data,
+                       detail::ImportByName const& import_by_name)
+    : process_{&process},
+      pe_file_{&pe_file},
+      base_{static_cast<std::uint8_t*>(thunk)},
+      import_by_name_(import_by_name)
+  {
+    if (pe_file.Is64())
+    {
+      data_64_.u1.AddressOfData = data;
+    }
+    else
+    {
+      data_32_.u1.AddressOfData = static_cast<DWORD>(data);
+    }
+  }
+
   explicit ImportThunk(Process const&& process,
                        PeFile const& pe_file,
                        void* thunk) = delete;
@@ -49,6 +191,24 @@ public:
                        PeFile&& pe_file,
                        void* thunk) = delete;
 
+  explicit ImportThunk(Process const&& process,
+                       PeFile const& pe_file,
+                       void* thunk,
+                       ULONGLONG data,
+                       detail::ImportByName const& import_by_name) = delete;
+
+  explicit ImportThunk(Process const& process,
+                       PeFile&& pe_file,
+                       void* thunk,
+                       ULONGLONG data,
+                       detail::ImportByName const& import_by_name) = delete;
+
+  explicit ImportThunk(Process const&& process,
+                       PeFile&& pe_file,
+                       void* thunk,
+                       ULONGLONG data,
+                       detail::ImportByName const& import_by_name) = delete;
+
   void* GetBase() const noexcept
   {
     return base_;
@@ -56,6 +216,8 @@ public:
 
   void UpdateRead()
   {
+    import_by_name_.valid = false;
+
     if (pe_file_->Is64())
     {
       data_64_ = Read<IMAGE_THUNK_DATA64>(*process_, base_);
@@ -154,6 +316,11 @@ public:
 
   WORD GetHint() const
   {
+    if (import_by_name_.valid)
+    {
+      return import_by_name_.hint;
+    }
+
     auto const name_import = static_cast<std::uint8_t*>(
       RvaToVa(*process_, *pe_file_, static_cast<DWORD>(GetAddressOfData())));
     if (!name_import)
@@ -167,6 +334,11 @@ public:
 
   std::string GetName() const
   {
+    if (import_by_name_.valid)
+    {
+      return import_by_name_.name;
+    }
+
     auto const name_import = static_cast<std::uint8_t*>(
       RvaToVa(*process_, *pe_file_, static_cast<DWORD>(GetAddressOfData())));
     if (!name_import)
@@ -180,6 +352,8 @@ public:
 
   void SetAddressOfData(ULONGLONG address_of_data)
   {
+    import_by_name_.valid = false;
+
     if (pe_file_->Is64())
     {
       data_64_.u1.AddressOfData = address_of_data;
@@ -192,6 +366,8 @@ public:
 
   void SetOrdinalRaw(ULONGLONG ordinal_raw)
   {
+    import_by_name_.valid = false;
+
     if (pe_file_->Is64())
     {
       data_64_.u1.Ordinal = ordinal_raw;
@@ -208,6 +384,8 @@ public:
 
   void SetFunction(ULONGLONG function)
   {
+    import_by_name_.valid = false;
+
     if (pe_file_->Is64())
     {
       data_64_.u1.Function = function;
@@ -222,8 +400,8 @@ public:
   {
     std::uint8_t* const name_import = static_cast<PBYTE>(
       RvaToVa(*process_, *pe_file_, static_cast<DWORD>(GetAddressOfData())));
-    return Write(
-      *process_, name_import + offsetof(IMAGE_IMPORT_BY_NAME, Hint), hint);
+    Write(*process_, name_import + offsetof(IMAGE_IMPORT_BY_NAME, Hint), hint);
+    import_by_name_.hint = hint;
   }
 
 private:
@@ -232,6 +410,7 @@ private:
   PBYTE base_;
   IMAGE_THUNK_DATA32 data_32_ = IMAGE_THUNK_DATA32{};
   IMAGE_THUNK_DATA64 data_64_ = IMAGE_THUNK_DATA64{};
+  detail::ImportByName import_by_name_ = detail::ImportByName{false, 0, {}};
 };
 
 inline bool operator==(ImportThunk const& lhs,
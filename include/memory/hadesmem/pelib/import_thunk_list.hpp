@@ -3,15 +3,17 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <iterator>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include <windows.h>
 
 #include <hadesmem/config.hpp>
 #include <hadesmem/detail/assert.hpp>
-#include <hadesmem/detail/optional.hpp>
 #include <hadesmem/error.hpp>
 #include <hadesmem/pelib/import_thunk.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
@@ -20,6 +22,52 @@
 
 namespace hadesmem
 {
+namespace detail
+{
+// Reads a thunk array in bulk (see ReadThunkArray), then fetches the hints
+// and names of the thunks imported by name with one batched read.
+inline std::vector<ImportThunk>
+  ReadImportThunks(Process const& process,
+                   PeFile const& pe_file,
+                   DWORD rva,
+                   std::size_t max_count = static_cast<std::size_t>(-1),
+                   bool terminated = true)
+{
+  std::vector<ULONGLONG> const raw =
+    ReadThunkArray(process, pe_file, rva, max_count, terminated);
+
+  std::vector<ImportThunk> thunks;
+  if (raw.empty())
+  {
+    return thunks;
+  }
+
+  ULONGLONG const ordinal_flag =
+    pe_file.Is64() ? IMAGE_ORDINAL_FLAG64 : IMAGE_ORDINAL_FLAG32;
+  std::vector<DWORD> name_rvas;
+  name_rvas.reserve(raw.size());
+  for (auto const t : raw)
+  {
+    name_rvas.push_back((t & ordinal_flag) ? 0 : static_cast<DWORD>(t));
+  }
+
+  auto const import_by_names =
+    ReadImportByNameBatch(process, pe_file, name_rvas);
+
+  auto const base = static_cast<std::uint8_t*>(RvaToVa(process, pe_file, rva));
+  std::size_t const thunk_size =
+    pe_file.Is64() ? sizeof(IMAGE_THUNK_DATA64) : sizeof(IMAGE_THUNK_DATA32);
+  thunks.reserve(raw.size());
+  for (std::size_t i = 0; i < raw.size(); ++i)
+  {
+    thunks.emplace_back(
+      process, pe_file, base + i * thunk_size, raw[i], import_by_names[i]);
+  }
+
+  return thunks;
+}
+}
+
 // ImportThunkIterator satisfies the requirements of an input iterator
 // (C++ Standard, 24.2.1, Input Iterators [input.iterators]).
 template <typename ImportThunkT>
@@ -44,19 +92,12 @@ public:
   {
     try
     {
-      auto const thunk_ptr = RvaToVa(process, pe_file, first_thunk);
-      if (!thunk_ptr)
+      auto const thunks = std::make_shared<std::vector<ImportThunk>>(
+        detail::ReadImportThunks(process, pe_file, first_thunk));
+      if (!thunks->empty())
       {
-        return;
+        impl_ = std::make_shared<Impl>(thunks);
       }
-
-      ImportThunk thunk{process, pe_file, thunk_ptr};
-      if (!thunk.GetAddressOfData())
-      {
-        return;
-      }
-
-      impl_ = std::make_shared<Impl>(process, pe_file, thunk);
     }
     catch (std::exception const& /*e*/)
     {
@@ -64,6 +105,15 @@ public:
     }
   }
 
+  explicit ImportThunkIterator(
+    std::shared_ptr<std::vector<ImportThunk>> const& thunks)
+  {
+    if (!thunks->empty())
+    {
+      impl_ = std::make_shared<Impl>(thunks);
+    }
+  }
+
   explicit ImportThunkIterator(Process const&& process,
                                PeFile const& pe_file,
                                DWORD first_thunk) = delete;
@@ -79,36 +129,20 @@ public:
   reference operator*() const noexcept
   {
     HADESMEM_DETAIL_ASSERT(impl_.get());
-    return *impl_->import_thunk_;
+    return (*impl_->thunks_)[impl_->index_];
   }
 
   pointer operator->() const noexcept
   {
     HADESMEM_DETAIL_ASSERT(impl_.get());
-    return &*impl_->import_thunk_;
+    return &(*impl_->thunks_)[impl_->index_];
   }
 
   ImportThunkIterator& operator++()
   {
-    try
-    {
-      HADESMEM_DETAIL_ASSERT(impl_.get());
-
-      auto const cur_base =
-        static_cast<std::uint8_t*>(impl_->import_thunk_->GetBase());
-      void* const next = impl_->pe_file_->Is64()
-                           ? cur_base + sizeof(IMAGE_THUNK_DATA64)
-                           : cur_base + sizeof(IMAGE_THUNK_DATA32);
-      impl_->import_thunk_ =
-        ImportThunk{*impl_->process_, *impl_->pe_file_, next};
+    HADESMEM_DETAIL_ASSERT(impl_.get());
 
-      if (!impl_->import_thunk_->GetAddressOfData())
-      {
-        impl_.reset();
-        return *this;
-      }
-    }
-    catch (std::exception const& /*e*/)
+    if (++impl_->index_ == impl_->thunks_->size())
     {
       impl_.reset();
     }
@@ -138,24 +172,24 @@ public:
 private:
   struct Impl
   {
-    explicit Impl(Process const& process,
-                  PeFile const& pe_file,
-                  ImportThunk const& thunk) noexcept
-      : process_{&process},
-        pe_file_{&pe_file},
-        import_thunk_{thunk}
+    explicit Impl(
+      std::shared_ptr<std::vector<ImportThunk>> const& thunks) noexcept
+      : thunks_{thunks}
     {
     }
 
-    Process const* process_;
-    PeFile const* pe_file_;
-    hadesmem::detail::Optional<ImportThunk> import_thunk_;
+    std::shared_ptr<std::vector<ImportThunk>> thunks_;
+    std::size_t index_{};
   };
 
   // Shallow copy semantics, as required by InputIterator.
   std::shared_ptr<Impl> impl_;
 };
 
+// The thunk array is read up to its terminator in a few bulk reads when the
+// list is constructed, and the hints and names of the thunks imported by name
+// are then fetched with a single batched read, so iterating the list doesn't
+// touch the target again.
 class ImportThunkList
 {
 public:
@@ -166,8 +200,16 @@ public:
   explicit ImportThunkList(Process const& process,
                            PeFile const& pe_file,
                            DWORD first_thunk)
-    : process_{&process}, pe_file_{&pe_file}, first_thunk_{first_thunk}
+    : thunks_{std::make_shared<std::vector<ImportThunk>>()}
   {
+    try
+    {
+      *thunks_ = detail::ReadImportThunks(process, pe_file, first_thunk);
+    }
+    catch (std::exception const& /*e*/)
+    {
+      // Nothing to do here.
+    }
   }
 
   explicit ImportThunkList(Process const&& process,
@@ -184,17 +226,17 @@ public:
 
   iterator begin()
   {
-    return iterator{*process_, *pe_file_, first_thunk_};
+    return iterator{thunks_};
   }
 
   const_iterator begin() const
   {
-    return const_iterator{*process_, *pe_file_, first_thunk_};
+    return const_iterator{thunks_};
   }
 
   const_iterator cbegin() const
   {
-    return const_iterator{*process_, *pe_file_, first_thunk_};
+    return const_iterator{thunks_};
   }
 
   iterator end() noexcept
@@ -212,9 +254,17 @@ public:
     return const_iterator{};
   }
 
+  std::size_t size() const noexcept
+  {
+    return thunks_->size();
+  }
+
+  bool empty() const noexcept
+  {
+    return thunks_->empty();
+  }
+
 private:
-  Process const* process_;
-  PeFile const* pe_file_;
-  DWORD first_thunk_;
+  std::shared_ptr<std::vector<ImportThunk>> thunks_;
 };
 }
@@ -0,0 +1,181 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/pelib/import_thunk.hpp>
+#include <hadesmem/pelib/import_thunk_list.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/process.hpp>
+
+namespace hadesmem
+{
+// An ILT entry and the IAT entry it is resolved into.
+class ImportThunkPair
+{
+public:
+  explicit ImportThunkPair(ImportThunk const& ilt, ImportThunk const& iat)
+    : ilt_(ilt), iat_(iat)
+  {
+  }
+
+  ImportThunk const& GetIlt() const noexcept
+  {
+    return ilt_;
+  }
+
+  ImportThunk const& GetIat() const noexcept
+  {
+    return iat_;
+  }
+
+  ImportThunk& GetIat() noexcept
+  {
+    return iat_;
+  }
+
+  // Whether the IAT entry has been overwritten (by the loader, or by binding)
+  // since the file was linked, at which point it no longer matches the ILT.
+  bool IsBound() const
+  {
+    return ilt_.GetAddressOfData() != iat_.GetAddressOfData();
+  }
+
+private:
+  ImportThunk ilt_;
+  ImportThunk iat_;
+};
+
+// Walks the ILT and IAT of an import descriptor in parallel, the same as the
+// loader. The ILT is read up to its terminator, then the same number of IAT
+// entries (plus one, to check the terminator) are read in one go, so the IAT
+// terminator is never needed to find the end of the list. Only the ILT names
+// are batch read, as the IAT entries are usually bound.
+//
+// If the IAT runs off the end of the file before the ILT ends then the list
+// is cut short.
+class ImportThunkPairList
+{
+public:
+  using value_type = ImportThunkPair;
+  using iterator = std::vector<ImportThunkPair>::iterator;
+  using const_iterator = std::vector<ImportThunkPair>::const_iterator;
+
+  explicit ImportThunkPairList(Process const& process,
+                               PeFile const& pe_file,
+                               DWORD original_first_thunk,
+                               DWORD first_thunk)
+  {
+    try
+    {
+      std::vector<ImportThunk> const ilt =
+        detail::ReadImportThunks(process, pe_file, original_first_thunk);
+      if (ilt.empty())
+      {
+        return;
+      }
+
+      std::vector<ULONGLONG> const iat = detail::ReadThunkArray(
+        process, pe_file, first_thunk, ilt.size() + 1, false);
+      iat_terminated_ = iat.size() > ilt.size() && !iat[ilt.size()];
+
+      auto const iat_base =
+        static_cast<std::uint8_t*>(RvaToVa(process, pe_file, first_thunk));
+      std::size_t const thunk_size = pe_file.Is64()
+                                       ? sizeof(IMAGE_THUNK_DATA64)
+                                       : sizeof(IMAGE_THUNK_DATA32);
+      std::size_t const count = (std::min)(ilt.size(), iat.size());
+      pairs_.reserve(count);
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        pairs_.emplace_back(ilt[i],
+                            ImportThunk{process,
+                                        pe_file,
+                                        iat_base + i * thunk_size,
+                                        iat[i],
+                                        detail::ImportByName{false, 0, {}}});
+      }
+    }
+    catch (std::exception const& /*e*/)
+    {
+      pairs_.clear();
+    }
+  }
+
+  explicit ImportThunkPairList(Process const&& process,
+                               PeFile const& pe_file,
+                               DWORD original_first_thunk,
+                               DWORD first_thunk) = delete;
+
+  explicit ImportThunkPairList(Process const& process,
+                               PeFile&& pe_file,
+                               DWORD original_first_thunk,
+                               DWORD first_thunk) = delete;
+
+  explicit ImportThunkPairList(Process const&& process,
+                               PeFile&& pe_file,
+                               DWORD original_first_thunk,
+                               DWORD first_thunk) = delete;
+
+  iterator begin() noexcept
+  {
+    return std::begin(pairs_);
+  }
+
+  const_iterator begin() const noexcept
+  {
+    return std::begin(pairs_);
+  }
+
+  const_iterator cbegin() const noexcept
+  {
+    return std::begin(pairs_);
+  }
+
+  iterator end() noexcept
+  {
+    return std::end(pairs_);
+  }
+
+  const_iterator end() const noexcept
+  {
+    return std::end(pairs_);
+  }
+
+  const_iterator cend() const noexcept
+  {
+    return std::end(pairs_);
+  }
+
+  std::size_t size() const noexcept
+  {
+    return pairs_.size();
+  }
+
+  bool empty() const noexcept
+  {
+    return pairs_.empty();
+  }
+
+  // Whether the IAT is terminated where the ILT is. The loader doesn't care,
+  // but a longer (or truncated) IAT is unusual.
+  bool IsIatTerminated() const noexcept
+  {
+    return iat_terminated_;
+  }
+
+private:
+  std::vector<ImportThunkPair> pairs_;
+  bool iat_terminated_{true};
+};
+}
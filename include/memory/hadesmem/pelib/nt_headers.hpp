@@ -20,39 +20,20 @@
 #include <hadesmem/error.hpp>
 #include <hadesmem/pelib/dos_header.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
 #include <hadesmem/process.hpp>
 #include <hadesmem/read.hpp>
 #include <hadesmem/write.hpp>
 
 namespace hadesmem
 {
-enum class PeDataDir : std::uint32_t
-{
-  Export,
-  Import,
-  Resource,
-  Exception,
-  Security,
-  BaseReloc,
-  Debug,
-  Architecture,
-  GlobalPTR,
-  TLS,
-  LoadConfig,
-  BoundImport,
-  IAT,
-  DelayImport,
-  COMDescriptor,
-  Reserved
-};
-
 class NtHeaders
 {
 public:
   explicit NtHeaders(Process const& process, PeFile const& pe_file)
     : process_{&process},
       pe_file_{&pe_file},
-      base_{CalculateBase(*process_, *pe_file_)}
+      base_{CalculateBase(*pe_file_)}
   {
     UpdateRead();
 
@@ -65,6 +46,17 @@ public:
 
   explicit NtHeaders(Process const&& process, PeFile&& pe_file) = delete;
 
+  // Reads from the PeFile's buffer (or the process it was constructed with).
+  explicit NtHeaders(PeFile const& pe_file)
+    : process_{nullptr}, pe_file_{&pe_file}, base_{CalculateBase(*pe_file_)}
+  {
+    UpdateRead();
+
+    EnsureValid();
+  }
+
+  explicit NtHeaders(PeFile&& pe_file) = delete;
+
   PVOID GetBase() const noexcept
   {
     return base_;
@@ -74,11 +66,13 @@ public:
   {
     if (pe_file_->Is64())
     {
-      data_64_ = Read<IMAGE_NT_HEADERS64>(*process_, base_);
+      data_64_ =
+        detail::ReadPe<IMAGE_NT_HEADERS64>(process_, *pe_file_, base_);
     }
     else
     {
-      data_32_ = Read<IMAGE_NT_HEADERS32>(*process_, base_);
+      data_32_ =
+        detail::ReadPe<IMAGE_NT_HEADERS32>(process_, *pe_file_, base_);
     }
   }
 
@@ -86,12 +80,14 @@ public:
   {
     if (pe_file_->Is64())
     {
-      Write(*process_, base_, data_64_);
+      detail::WritePe(process_, *pe_file_, base_, data_64_);
     }
     else
     {
-      Write(*process_, base_, data_32_);
+      detail::WritePe(process_, *pe_file_, base_, data_32_);
     }
+
+    pe_file_->RefreshHeaders();
   }
 
   bool IsValid() const
@@ -1139,9 +1135,10 @@ public:
   }
 
 private:
-  PBYTE CalculateBase(Process const& process, PeFile const& pe_file) const
+  PBYTE CalculateBase(PeFile const& pe_file) const
   {
-    DosHeader dos_header{process, pe_file};
+    DosHeader const dos_header =
+      process_ ? DosHeader{*process_, pe_file} : DosHeader{pe_file};
     return static_cast<PBYTE>(dos_header.GetBase()) +
            dos_header.GetNewHeaderOffset();
   }
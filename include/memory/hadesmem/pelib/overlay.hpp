@@ -142,7 +142,7 @@ private:
   Process const* process_;
   PeFile const* pe_file_;
   std::uint8_t* base_;
-  DWORD size_;
+  std::size_t size_;
   std::vector<std::uint8_t> data_;
 };
 
@@ -3,12 +3,16 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <exception>
 #include <iosfwd>
 #include <memory>
 #include <ostream>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include <windows.h>
 #include <winnt.h>
@@ -18,10 +22,16 @@
 #include <hadesmem/detail/region_alloc_size.hpp>
 #include <hadesmem/error.hpp>
 #include <hadesmem/module.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_headers.hpp>
+#include <hadesmem/pelib/view/section_index.hpp>
 #include <hadesmem/process.hpp>
 #include <hadesmem/region.hpp>
 #include <hadesmem/region_list.hpp>
 #include <hadesmem/read.hpp>
+#include <hadesmem/write.hpp>
 
 // TODO: Add proper regression tests for PeLib. This will require running
 // against a known sample set with reference data to compare to.
@@ -30,21 +40,22 @@
 // file/buffer. We usually check the RVA/VA, but we don't always validate the
 // size. Also need to check for overflow etc. when using size.
 
-// TODO: Add option to manually map data files, so we can apply fixups etc which
-// in turn means we can basically just treat it as an Image in memory. It also
-// means we can handle weird loader differences with different mapping flags for
-// XP vs 7 vs 8 etc.
+// TODO: Data files can be manually mapped (with fixups applied) and then
+// treated as an Image using pelib::MapImage, but only via the views. Add an
+// equivalent for PeFile, and handle the weird loader differences with
+// different mapping flags for XP vs 7 vs 8 etc.
 
 // TODO: Investigate what the point of IMAGE_DIRECTORY_ENTRY_IAT is. Used by
 // virtsectblXP.exe. Does it actually have to be the IAT (i.e. FirstThunk)? I'm
 // pretty sure it's different in some cases... Add warning in Dump for this and
 // run a full scan.
 
-// TODO: Decouple PeLib from Process so we can operate directly on
-// files/memory/etc. Need some sort of abstraction to replace Process (and the
-// accompanying calls to Read/Write/etc.). Dependency on hadesmem APIs in
-// general should be removed, as ideally we could make the PeFile code
-// OS-independent as all we're doing is parsing files.
+// TODO: Finish decoupling PeLib from Process. A PeFile can be constructed
+// from a BufferSource, but only DosHeader, NtHeaders, Section and SectionList
+// can be used without a Process so far. The directory types (ExportList,
+// ImportDirList, etc.) still need one. Dependency on hadesmem APIs in general
+// should be removed, as ideally we could make the PeFile code OS-independent
+// as all we're doing is parsing files.
 
 // TODO: Move to an attribute based system for warning on malformed or
 // suspicious files. Also important for testing, so we can ensure certain
@@ -67,10 +78,9 @@
 // performing adjustments where required to fit in new data or remove
 // unnecessary space.
 
-// TODO: Support more of the PE file format. (Overlay data. Resource directory.
-// Exception directory. Relocation directory. Security directory. Debug
-// directory. Load config directory. Delay import directory. Bound import
-// directory. IAT(as opposed to Import) directory. CLR runtime directory
+// TODO: Support more of the PE file format. (Overlay data. Relocation
+// directory. Security directory. Debug directory. Load config directory. Bound
+// import directory. IAT(as opposed to Import) directory. CLR runtime directory
 // support. DOS stub. Rich header. Checksum. etc.)
 
 // TODO: Reduce dependencies various components have on each other (e.g.
@@ -92,8 +102,9 @@
 // it in the underlying type. Make this more consistent. Also think about how
 // this interacts with the proposed move to an attribute based system.
 
-// TODO: Write and use synthetic files similar to Corkami as part of unit tests.
-// One sample per trick/feature/etc.
+// TODO: Extend the synthetic files (see BuildSyntheticPe) to cover more tricks
+// (one sample per trick/feature/etc.), and use them in the tests of the
+// Process based types too, not just the views.
 
 // TODO: Stop hard-swallowing warnings/errors in PeLib types, they should be
 // exposed to the tools (e.g. so Dump can warn). This should probably be fixed
@@ -101,21 +112,59 @@
 
 namespace hadesmem
 {
-// TODO: Investigate if there is a better way to implement PeLib rather than
-// branching on PeFileType everywhere.
-enum class PeFileType
+namespace detail
 {
-  kImage,
-  kData
-};
+// Reads the headers and section table of the file in a single read and parses
+// them, so that converting addresses etc. doesn't have to. Returns null rather
+// than throwing if the headers are invalid, as malformed files are common
+// (e.g. when scanning a corpus) and PeFile doesn't treat them as an error.
+inline std::shared_ptr<pelib::PeHeaders const> ReadPeHeaders(
+  Process const& process,
+  std::uint8_t* base,
+  PeFileType type,
+  std::size_t size)
+{
+  auto const dos_header = Read<pelib::ImageDosHeader>(process, base);
+  std::uint64_t const nt_headers_ofs =
+    static_cast<std::uint32_t>(dos_header.e_lfanew);
+  std::uint64_t const optional_header_ofs =
+    nt_headers_ofs + pelib::kImageOptionalHeaderOffset;
+  if (optional_header_ofs > size)
+  {
+    return nullptr;
+  }
+
+  auto const file_header = Read<pelib::ImageFileHeader>(
+    process, base + nt_headers_ofs + sizeof(std::uint32_t));
+  std::uint64_t const headers_end = (std::max)(
+    optional_header_ofs + sizeof(pelib::ImageOptionalHeader64),
+    optional_header_ofs + file_header.SizeOfOptionalHeader +
+      static_cast<std::uint64_t>(file_header.NumberOfSections) *
+        sizeof(pelib::ImageSectionHeader));
+  auto const len = static_cast<std::size_t>(
+    (std::min)(headers_end, static_cast<std::uint64_t>(size)));
+
+  auto buf = ReadVector<std::uint8_t>(process, base, len);
+  auto headers = pelib::PeHeaders::TryParse(
+    pelib::BufferSource{std::move(buf)}, size, type);
+  if (!headers)
+  {
+    return nullptr;
+  }
+
+  return std::make_shared<pelib::PeHeaders const>(std::move(*headers));
+}
+}
 
 class PeFile
 {
 public:
+  // Size is a std::size_t rather than a DWORD so that files larger than 4GB
+  // (e.g. a MappedFile) can be parsed as data.
   explicit PeFile(Process const& process,
                   void* address,
                   PeFileType type,
-                  DWORD size)
+                  std::size_t size)
     : process_{&process},
       base_{static_cast<std::uint8_t*>(address)},
       type_{type},
@@ -137,11 +186,7 @@ public:
       }
       catch (...)
       {
-        auto const module_region_size =
-          detail::GetModuleRegionSize(*process_, base_);
-        HADESMEM_DETAIL_ASSERT(module_region_size <
-                               (std::numeric_limits<DWORD>::max)());
-        size_ = static_cast<DWORD>(module_region_size);
+        size_ = detail::GetModuleRegionSize(*process_, base_);
       }
     }
 
@@ -168,12 +213,44 @@ public:
     catch (...)
     {
     }
+
+    RefreshHeaders();
   }
 
   explicit PeFile(Process const&& process,
                   void* address,
                   PeFileType type,
-                  DWORD size) = delete;
+                  std::size_t size) = delete;
+
+  // Parses the file (or image) directly from a buffer, without a Process. The
+  // source is kept alive by the PeFile, but as it is read-only so is the
+  // PeFile (i.e. UpdateWrite etc. throw).
+  explicit PeFile(pelib::BufferSource const& source, PeFileType type)
+    : process_{nullptr},
+      base_{const_cast<std::uint8_t*>(source.GetData())},
+      type_{type},
+      size_{source.GetSize()},
+      source_{source}
+  {
+    if (source.IsEmpty())
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Invalid file size."});
+    }
+
+    if (auto const dos_hdr = source.TryRead<pelib::ImageDosHeader>(0))
+    {
+      std::size_t const nt_hdrs_ofs =
+        static_cast<std::uint32_t>(dos_hdr->e_lfanew);
+      auto const signature = source.TryRead<std::uint32_t>(nt_hdrs_ofs);
+      auto const file_hdr = source.TryRead<pelib::ImageFileHeader>(
+        nt_hdrs_ofs + sizeof(std::uint32_t));
+      is_64_ = signature && file_hdr && *signature == IMAGE_NT_SIGNATURE &&
+               file_hdr->Machine == IMAGE_FILE_MACHINE_AMD64;
+    }
+
+    RefreshHeaders();
+  }
 
   PVOID GetBase() const noexcept
   {
@@ -185,7 +262,7 @@ public:
     return type_;
   }
 
-  DWORD GetSize() const noexcept
+  std::size_t GetSize() const noexcept
   {
     return size_;
   }
@@ -195,12 +272,62 @@ public:
     return is_64_;
   }
 
+  // The process the file is read from, or nullptr if it was constructed from
+  // a BufferSource.
+  Process const* GetProcess() const noexcept
+  {
+    return process_;
+  }
+
+  // The buffer the file is read from, or nullptr if it was constructed from a
+  // Process.
+  pelib::BufferSource const* GetSource() const noexcept
+  {
+    return process_ ? nullptr : &source_;
+  }
+
+  // Headers and section table as they were when the PeFile was constructed
+  // or last refreshed, or nullptr if they are invalid. The pointer is
+  // invalidated by RefreshHeaders.
+  pelib::PeHeaders const* GetHeaders() const noexcept
+  {
+    return headers_.get();
+  }
+
+  // Re-reads the cached headers. DosHeader, NtHeaders and Section do this in
+  // UpdateWrite, so it's only needed after modifying the headers some other
+  // way (e.g. Write). Copies of the PeFile made before the modification keep
+  // the old headers.
+  void RefreshHeaders() const
+  {
+    try
+    {
+      if (process_)
+      {
+        headers_ = detail::ReadPeHeaders(*process_, base_, type_, size_);
+      }
+      else
+      {
+        auto headers = pelib::PeHeaders::TryParse(source_, size_, type_);
+        headers_ =
+          headers ? std::make_shared<pelib::PeHeaders const>(std::move(*headers))
+                  : nullptr;
+      }
+    }
+    catch (...)
+    {
+      headers_ = nullptr;
+    }
+  }
+
 private:
   Process const* process_;
   PBYTE base_;
   PeFileType type_;
-  DWORD size_;
+  std::size_t size_;
   bool is_64_{false};
+  pelib::BufferSource source_;
+  mutable std::shared_ptr<pelib::PeHeaders const> headers_;
 };
 
 inline bool operator==(PeFile const& lhs, PeFile const& rhs) noexcept
@@ -249,17 +376,81 @@ inline std::wostream& operator<<(std::wostream& lhs, PeFile const& rhs)
   return lhs;
 }
 
-// TODO: Add sample files for all the corner cases we're handling, and ensure it
-// is correct, so we can add regression tests.
-// TODO: Find a better name for this functions? It's slightly confusing...
-// TODO: Measure code coverage of this and other critical functions when writing
-// tests to ensure full coverage. Then add attributes and regression tests.
-// TODO: Consider if there is a better way to handle virtual VAs other than an
-// out param. Attributes?
-inline PVOID RvaToVa(Process const& process,
+namespace detail
+{
+// Reads from the PeFile's buffer if it has one, otherwise from the process
+// (which defaults to the one the PeFile was constructed with). Used by the
+// types which can be constructed without a Process.
+template <typename T>
+T ReadPe(Process const* process, PeFile const& pe_file, void const* address)
+{
+  if (!process)
+  {
+    process = pe_file.GetProcess();
+  }
+
+  if (process)
+  {
+    return Read<T>(*process, const_cast<void*>(address));
+  }
+
+  // Addresses before the start of the buffer wrap around, so are rejected by
+  // the bounds check along with those after the end.
+  pelib::BufferSource const* const source = pe_file.GetSource();
+  return source->Read<T>(reinterpret_cast<std::uintptr_t>(address) -
+                         reinterpret_cast<std::uintptr_t>(source->GetData()));
+}
+
+template <typename T>
+void WritePe(Process const* process,
+             PeFile const& pe_file,
+             void* address,
+             T const& data)
+{
+  if (!process)
+  {
+    process = pe_file.GetProcess();
+  }
+
+  if (!process)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                    << ErrorString{"PE file is read-only."});
+  }
+
+  Write(*process, address, data);
+}
+
+// Called when PeFile failed to parse the headers, to throw the same errors as
+// RvaToVa/FileOffsetToRva always have.
+[[noreturn]] inline void ThrowInvalidPeHeaders(Process const* process,
+                                               PeFile const& pe_file)
+{
+  auto const dos_header =
+    ReadPe<pelib::ImageDosHeader>(process, pe_file, pe_file.GetBase());
+  if (dos_header.e_magic != pelib::kImageDosSignature)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                    << ErrorString{"Invalid DOS header."});
+  }
+
+  HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                  << ErrorString{"Invalid NT headers."});
+}
+
+[[noreturn]] inline void ThrowInvalidPeHeaders(Process const& process,
+                                               PeFile const& pe_file)
+{
+  ThrowInvalidPeHeaders(&process, pe_file);
+}
+}
+
+namespace detail
+{
+inline PVOID RvaToVa(Process const* process,
                      PeFile const& pe_file,
                      DWORD rva,
-                     bool* virtual_va = nullptr)
+                     bool* virtual_va)
 {
   if (virtual_va)
   {
@@ -276,215 +467,46 @@ inline PVOID RvaToVa(Process const& process,
       return nullptr;
     }
 
-    IMAGE_DOS_HEADER dos_header = Read<IMAGE_DOS_HEADER>(process, base);
-    if (dos_header.e_magic != IMAGE_DOS_SIGNATURE)
-    {
-      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
-                                      << ErrorString{"Invalid DOS header."});
-    }
-
-    BYTE* ptr_nt_headers = base + dos_header.e_lfanew;
-    if (Read<DWORD>(process, ptr_nt_headers) != IMAGE_NT_SIGNATURE)
-    {
-      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
-                                      << ErrorString{"Invalid NT headers."});
-    }
-
-    auto const file_header =
-      Read<IMAGE_FILE_HEADER>(process, ptr_nt_headers + sizeof(DWORD));
-
-    auto const optional_header_32 =
-      pe_file.Is64()
-        ? IMAGE_OPTIONAL_HEADER32{}
-        : Read<IMAGE_OPTIONAL_HEADER32>(process,
-                                        ptr_nt_headers + sizeof(DWORD) +
-                                          sizeof(IMAGE_FILE_HEADER));
-    auto const optional_header_64 =
-      pe_file.Is64()
-        ? Read<IMAGE_OPTIONAL_HEADER64>(
-            process, ptr_nt_headers + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER))
-        : IMAGE_OPTIONAL_HEADER64{};
-
-    DWORD const size_of_headers = pe_file.Is64()
-                                    ? optional_header_64.SizeOfHeaders
-                                    : optional_header_32.SizeOfHeaders;
-    DWORD const file_alignment = pe_file.Is64()
-                                   ? optional_header_64.FileAlignment
-                                   : optional_header_32.FileAlignment;
-    DWORD const size_of_image = pe_file.Is64() ? optional_header_64.SizeOfImage
-                                               : optional_header_32.SizeOfImage;
-
-    // A PE file can legally have zero sections, in which case the entire file
-    // is executable as though it were a single section whose size is equal to
-    // the SizeOfHeaders value rounded up to the nearest page.
-    // TODO: Confirm that the comment on rounding is correct, then implement it.
-    WORD num_sections = file_header.NumberOfSections;
-    if (!num_sections)
-    {
-      // In cases where the PE file has no sections it can apparently also have
-      // all sorts of messed up RVAs for data dirs etc... Make sure that none of
-      // them lie outside the file, because otherwise simply returning a direct
-      // offset from the base wouldn't work anyway...
-      if (rva > pe_file.GetSize())
-      {
-        return nullptr;
-      }
-      else
-      {
-        return base + rva;
-      }
-    }
-
-    // SizeOfHeaders can be arbitrarily large, including the size of the entire.
-    // RVAs inside the headers are treated as an offset from zero, rather than
-    // finding the 'true' location in a section.
-    if (rva < size_of_headers)
-    {
-      // TODO: This probably needs some extra checks as some cases are probably
-      // invalid, but I don't know what the checks should be. Need to
-      // investigate to see what is allowed and what is not.
-      if (rva > pe_file.GetSize() || rva > size_of_image)
-      {
-        return nullptr;
-      }
-      else
-      {
-        return base + rva;
-      }
-    }
-
-    if (rva > size_of_image)
-    {
-      return nullptr;
-    }
-
-    auto ptr_section_header = reinterpret_cast<PIMAGE_SECTION_HEADER>(
-      ptr_nt_headers + offsetof(IMAGE_NT_HEADERS, OptionalHeader) +
-      file_header.SizeOfOptionalHeader);
-    void const* const file_end =
-      static_cast<std::uint8_t*>(pe_file.GetBase()) + pe_file.GetSize();
-    // Virtual section table.
-    if (ptr_section_header >= file_end)
+    pelib::PeHeaders const* const headers = pe_file.GetHeaders();
+    if (!headers)
     {
-      if (rva > pe_file.GetSize())
-      {
-        return nullptr;
-      }
-      else
-      {
-        return base + rva;
-      }
+      detail::ThrowInvalidPeHeaders(process, pe_file);
     }
 
-    bool in_header = true;
-    for (WORD i = 0; i < num_sections; ++i)
-    {
-      // For a virtual section header, simply return nullptr. (Similar to above,
-      // except this time only the Nth entry onwards is virtual, rather than all
-      // the headers.)
-      if (ptr_section_header + 1 > file_end)
-      {
-        return nullptr;
-      }
-
-      auto const section_header =
-        Read<IMAGE_SECTION_HEADER>(process, ptr_section_header);
-
-      DWORD const virtual_beg = section_header.VirtualAddress;
-      DWORD const virtual_size = section_header.Misc.VirtualSize;
-      DWORD const raw_size = section_header.SizeOfRawData;
-      // If VirtualSize is zero then SizeOfRawData is used.
-      DWORD const virtual_end =
-        virtual_beg + (virtual_size ? virtual_size : raw_size);
-      if (virtual_beg <= rva && rva < virtual_end)
-      {
-        rva -= virtual_beg;
-
-        // If the RVA is outside the raw data (which would put it in the
-        // zero-fill of the virtual data) just return nullptr because it's
-        // invalid. Technically files like this will work when loaded by the
-        // PE loader due to the sections being mapped differention in memory
-        // to on disk, but if you want to inspect the file in that manner you
-        // should just use LoadLibrary with the appropriate flags for your
-        // scenario and then use PeFileType::kImage.
-        if (rva > raw_size)
-        {
-          // It's useful to be able to detect this case as a user for things
-          // like exports, where typically a failure to resolve an RVA would be
-          // an error/suspicious, but not in the case of a data export where it
-          // is normal for the RVA to be in the zero fill of a data segment.
-          // TODO: Find other places in this function where we need to set this
-          // flag.
-          // TODO: Also check section characteristics?
-          if (rva < virtual_size && virtual_va)
-          {
-            *virtual_va = true;
-          }
-
-          return nullptr;
-        }
-
-        // If PointerToRawData is less than 0x200 it is rounded
-        // down to 0.
-        if (section_header.PointerToRawData >= 0x200)
-        {
-          // TODO: Check whether we actually need/want to force alignment here.
-          rva += section_header.PointerToRawData & ~(file_alignment - 1);
-        }
-
-        // If the RVA now lies outside the actual file just return nullptr
-        // because it's invalid.
-        if (rva >= pe_file.GetSize())
-        {
-          return nullptr;
-        }
-
-        return base + rva;
-      }
-
-      // This should be the 'normal' case. However sometimes the RVA is at a
-      // lower address than any of the sections, so we want to detect this so we
-      // can just treat the RVA as an offset from the module base (similar to
-      // when the image is loaded).
-      if (virtual_beg <= rva)
-      {
-        in_header = false;
-      }
-
-      ++ptr_section_header;
-    }
+    std::size_t const offset = headers->RvaToOffset(rva, virtual_va);
+    return offset == pelib::PeHeaders::kInvalidOffset ? nullptr
+                                                      : base + offset;
+  }
+  else if (type == PeFileType::kImage)
+  {
+    return rva ? (base + rva) : nullptr;
+  }
+  else
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                    << ErrorString{"Unhandled file type."});
+  }
+}
 
-    // Doing the same thing as in the SizeOfHeaders check above because we're
-    // not sure of better criteria to base it off. Perhaps it's correct now?
-    if (in_header && rva < pe_file.GetSize())
-    {
-      // Only applies in low alignment, otherwise it's invalid?
-      if (file_alignment < 200)
-      {
-        return base + rva;
-      }
-      // Also only applies if the RVA is smaller than file alignment?
-      else if (rva < file_alignment)
-      {
-        return base + rva;
-      }
-      else
-      {
-        return nullptr;
-      }
-    }
+inline DWORD FileOffsetToRva(Process const* process,
+                             PeFile const& pe_file,
+                             DWORD file_offset)
+{
+  PeFileType const type = pe_file.GetType();
 
-    // Sample: nullSOH-XP (Corkami PE Corpus)
-    if (rva < size_of_image && rva < pe_file.GetSize())
+  if (type == PeFileType::kData)
+  {
+    pelib::PeHeaders const* const headers = pe_file.GetHeaders();
+    if (!headers)
     {
-      return base + rva;
+      detail::ThrowInvalidPeHeaders(process, pe_file);
     }
 
-    return nullptr;
+    return headers->FileOffsetToRva(file_offset);
   }
   else if (type == PeFileType::kImage)
   {
-    return rva ? (base + rva) : nullptr;
+    return file_offset;
   }
   else
   {
@@ -492,6 +514,31 @@ inline PVOID RvaToVa(Process const& process,
                                     << ErrorString{"Unhandled file type."});
   }
 }
+}
+
+// For PeFileType::kData this is a lookup into the headers cached by PeFile (see
+// PeHeaders::RvaToOffset for the corner cases handled), so doesn't read
+// anything.
+// TODO: Add sample files for all the corner cases we're handling, and ensure it
+// is correct, so we can add regression tests.
+// TODO: Find a better name for this functions? It's slightly confusing...
+// TODO: Measure code coverage of this and other critical functions when writing
+// tests to ensure full coverage. Then add attributes and regression tests.
+// TODO: Consider if there is a better way to handle virtual VAs other than an
+// out param. Attributes?
+inline PVOID RvaToVa(Process const& process,
+                     PeFile const& pe_file,
+                     DWORD rva,
+                     bool* virtual_va = nullptr)
+{
+  return detail::RvaToVa(&process, pe_file, rva, virtual_va);
+}
+
+inline PVOID
+  RvaToVa(PeFile const& pe_file, DWORD rva, bool* virtual_va = nullptr)
+{
+  return detail::RvaToVa(nullptr, pe_file, rva, virtual_va);
+}
 
 // TODO: 'Harden' this function against malicious/malformed PE files like is
 // done for RvaToVa.
@@ -499,66 +546,127 @@ inline DWORD FileOffsetToRva(Process const& process,
                              PeFile const& pe_file,
                              DWORD file_offset)
 {
-  PeFileType const type = pe_file.GetType();
-  PBYTE base = static_cast<PBYTE>(pe_file.GetBase());
+  return detail::FileOffsetToRva(&process, pe_file, file_offset);
+}
 
-  if (type == PeFileType::kData)
+inline DWORD FileOffsetToRva(PeFile const& pe_file, DWORD file_offset)
+{
+  return detail::FileOffsetToRva(nullptr, pe_file, file_offset);
+}
+
+// Built once per PeFile along with the rest of the cached headers, so lookups
+// don't read anything. Indices are into the section table (i.e. the same as
+// for Section).
+inline pelib::SectionIndex const& GetSectionIndex(Process const& process,
+                                                  PeFile const& pe_file)
+{
+  pelib::PeHeaders const* const headers = pe_file.GetHeaders();
+  if (!headers)
   {
-    IMAGE_DOS_HEADER dos_header = Read<IMAGE_DOS_HEADER>(process, base);
-    if (dos_header.e_magic != IMAGE_DOS_SIGNATURE)
-    {
-      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
-                                      << ErrorString{"Invalid DOS header."});
-    }
+    detail::ThrowInvalidPeHeaders(process, pe_file);
+  }
 
-    BYTE* ptr_nt_headers = base + dos_header.e_lfanew;
-    if (Read<DWORD>(process, ptr_nt_headers) != IMAGE_NT_SIGNATURE)
-    {
-      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
-                                      << ErrorString{"Invalid NT headers."});
-    }
+  return headers->GetSectionIndex();
+}
+
+inline pelib::SectionIndex const& GetSectionIndex(PeFile const& pe_file)
+{
+  pelib::PeHeaders const* const headers = pe_file.GetHeaders();
+  if (!headers)
+  {
+    detail::ThrowInvalidPeHeaders(nullptr, pe_file);
+  }
+
+  return headers->GetSectionIndex();
+}
+
+namespace detail
+{
+// Same as RvaToVa, but also checks that the entire object is inside the
+// file/image, so that a bogus RVA near the end can't make us read past it.
+inline void* RvaToVaChecked(Process const& process,
+                            PeFile const& pe_file,
+                            DWORD rva,
+                            std::size_t size)
+{
+  auto const va = static_cast<std::uint8_t*>(RvaToVa(process, pe_file, rva));
+  auto const base = static_cast<std::uint8_t*>(pe_file.GetBase());
+  if (!va || va < base || pe_file.GetSize() < size ||
+      static_cast<std::size_t>(va - base) > pe_file.GetSize() - size)
+  {
+    return nullptr;
+  }
 
-    auto const file_header =
-      Read<IMAGE_FILE_HEADER>(process, ptr_nt_headers + sizeof(DWORD));
+  return va;
+}
 
-    auto ptr_section_header = reinterpret_cast<PIMAGE_SECTION_HEADER>(
-      ptr_nt_headers + offsetof(IMAGE_NT_HEADERS, OptionalHeader) +
-      file_header.SizeOfOptionalHeader);
+// Reads an array of T which ends at the first element matching is_terminator
+// (which isn't included), at the end of the file, at the first unreadable
+// element, or after max_count elements, whichever comes first. The array is
+// read in geometrically growing chunks, so a long array costs a handful of
+// reads rather than one per element. Returns an empty vector if the RVA is
+// outside the file.
+template <typename T, typename Pred>
+std::vector<T> ReadTerminatedArray(Process const& process,
+                                   PeFile const& pe_file,
+                                   DWORD rva,
+                                   Pred is_terminator,
+                                   std::size_t max_count = static_cast<
+                                     std::size_t>(-1))
+{
+  std::size_t const kInitialChunk = 0x20;
+  std::size_t const kMaxChunk = 0x1000;
+
+  std::vector<T> elems;
+  auto cur = static_cast<std::uint8_t*>(RvaToVa(process, pe_file, rva));
+  auto const base = static_cast<std::uint8_t*>(pe_file.GetBase());
+  auto const end = base + pe_file.GetSize();
+  if (!cur || cur < base || cur >= end)
+  {
+    return elems;
+  }
 
-    WORD num_sections = file_header.NumberOfSections;
-    for (WORD i = 0; i < num_sections; ++i)
+  std::size_t available = static_cast<std::size_t>(end - cur) / sizeof(T);
+  std::size_t chunk = kInitialChunk;
+  while (available && elems.size() < max_count)
+  {
+    std::size_t const count =
+      (std::min)((std::min)(chunk, available), max_count - elems.size());
+    std::vector<T> buf;
+    try
     {
-      auto const section_header =
-        Read<IMAGE_SECTION_HEADER>(process, ptr_section_header);
+      buf = ReadVector<T>(process, cur, count);
+    }
+    catch (std::exception const& /*e*/)
+    {
+      // Retry an element at a time to find where the readable part ends.
+      if (count == 1)
+      {
+        return elems;
+      }
 
-      DWORD const raw_beg = section_header.PointerToRawData;
-      DWORD const raw_size = section_header.SizeOfRawData;
-      DWORD const raw_end = raw_beg + raw_size;
-      if (raw_beg <= file_offset && file_offset < raw_end)
+      chunk = 1;
+      continue;
+    }
+
+    for (auto const& elem : buf)
+    {
+      if (is_terminator(elem))
       {
-        file_offset -= raw_beg;
-        file_offset += section_header.VirtualAddress;
-        return file_offset;
+        return elems;
       }
 
-      ++ptr_section_header;
+      elems.push_back(elem);
     }
 
-    return 0;
-  }
-  else if (type == PeFileType::kImage)
-  {
-    return file_offset;
-  }
-  else
-  {
-    HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
-                                    << ErrorString{"Unhandled file type."});
+    cur += count * sizeof(T);
+    available -= count;
+    chunk = (std::min)(chunk * 2, kMaxChunk);
   }
+
+  return elems;
 }
 
-namespace detail
-{
 // TODO: Handle virtual termination.
 // TODO: Warn in tools when EOF/Virtual/etc. termination is detected.
 // TODO: Move this somewhere more appropriate.
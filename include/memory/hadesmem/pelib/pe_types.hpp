@@ -0,0 +1,40 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstdint>
+
+// Types shared between the Process based PeLib types and the OS-independent
+// views. Must not depend on the Windows headers.
+
+namespace hadesmem
+{
+// TODO: Investigate if there is a better way to implement PeLib rather than
+// branching on PeFileType everywhere.
+enum class PeFileType
+{
+  kImage,
+  kData
+};
+
+enum class PeDataDir : std::uint32_t
+{
+  Export,
+  Import,
+  Resource,
+  Exception,
+  Security,
+  BaseReloc,
+  Debug,
+  Architecture,
+  GlobalPTR,
+  TLS,
+  LoadConfig,
+  BoundImport,
+  IAT,
+  DelayImport,
+  COMDescriptor,
+  Reserved
+};
+}
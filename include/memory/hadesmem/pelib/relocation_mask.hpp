@@ -0,0 +1,125 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/base_relocation_table.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_headers.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+namespace hadesmem
+{
+// Builds a mask of the bytes covered by base relocations, indexed by RVA (for
+// files too). These are the bytes which differ between the file on disk and
+// each load of the module at a different base, so signatures and comparisons
+// should ignore them.
+//
+// The relocation directory is read in one go and decoded by
+// BaseRelocationTable, rather than being walked with RelocationBlockList
+// (which reads each block and entry separately). The mask is empty if the file
+// has no relocations.
+inline pelib::RelocationMask GetRelocationMask(Process const& process,
+                                               PeFile const& pe_file)
+{
+  pelib::PeHeaders const* const headers = pe_file.GetHeaders();
+  if (!headers)
+  {
+    detail::ThrowInvalidPeHeaders(process, pe_file);
+  }
+
+  pelib::ImageDataDirectory const reloc_dir =
+    headers->GetDataDir(PeDataDir::BaseReloc);
+  if (!reloc_dir.VirtualAddress || !reloc_dir.Size)
+  {
+    return pelib::RelocationMask{};
+  }
+
+  auto const base = static_cast<std::uint8_t*>(pe_file.GetBase());
+  auto const reloc_dir_va = static_cast<std::uint8_t*>(
+    RvaToVa(process, pe_file, reloc_dir.VirtualAddress));
+  std::size_t const file_size = pe_file.GetSize();
+  if (!reloc_dir_va || reloc_dir_va < base ||
+      static_cast<std::size_t>(reloc_dir_va - base) >= file_size)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(
+      Error{} << ErrorString{"Invalid relocation directory."});
+  }
+
+  std::size_t const reloc_dir_size =
+    (std::min)(static_cast<std::size_t>(reloc_dir.Size),
+               file_size - static_cast<std::size_t>(reloc_dir_va - base));
+
+  std::vector<std::uint8_t> const reloc_data =
+    ReadVector<std::uint8_t>(process, reloc_dir_va, reloc_dir_size);
+  pelib::BaseRelocationTable const relocs{reloc_data.data(),
+                                          reloc_data.size()};
+  return pelib::RelocationMask{relocs, headers->GetSizeOfImage()};
+}
+
+// Caches the relocation mask of each module used, so scanning a module for
+// many patterns only reads and decodes its relocations once.
+//
+// Modules are cached by identity (base, SizeOfImage and TimeDateStamp) rather
+// than just by handle, so a module which is unloaded and replaced by a
+// different one at the same base doesn't get a stale mask.
+class RelocationMaskCache
+{
+public:
+  explicit RelocationMaskCache(Process const& process) : process_{&process}
+  {
+  }
+
+  explicit RelocationMaskCache(Process const&& process) = delete;
+
+  std::shared_ptr<pelib::RelocationMask const> GetMask(HMODULE module)
+  {
+    PeFile const pe_file{*process_, module, PeFileType::kImage, 0};
+    pelib::PeHeaders const* const headers = pe_file.GetHeaders();
+    if (!headers)
+    {
+      detail::ThrowInvalidPeHeaders(*process_, pe_file);
+    }
+
+    ModuleIdentity const identity{reinterpret_cast<std::uintptr_t>(module),
+                                  headers->GetSizeOfImage(),
+                                  headers->GetFileHeader().TimeDateStamp};
+    auto iter = masks_.find(identity);
+    if (iter == std::end(masks_))
+    {
+      iter = masks_.emplace(identity,
+                            std::make_shared<pelib::RelocationMask const>(
+                              GetRelocationMask(*process_, pe_file))).first;
+    }
+
+    return iter->second;
+  }
+
+  void Clear() noexcept
+  {
+    masks_.clear();
+  }
+
+private:
+  using ModuleIdentity = std::tuple<std::uintptr_t, DWORD, DWORD>;
+
+  Process const* process_;
+  std::map<ModuleIdentity, std::shared_ptr<pelib::RelocationMask const>>
+    masks_;
+};
+}
@@ -0,0 +1,390 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cwchar>
+#include <iosfwd>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/resource_dir_table.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+// TODO: Add language fallback when looking up a resource without a language,
+// the same as FindResource (thread, user and system default languages, then
+// neutral).
+
+// TODO: Add parsers for common resource types (version info, manifests, icons,
+// etc.).
+
+namespace hadesmem
+{
+// Identifies a resource type, name or language by either ID or name. As with
+// the Win32 resource APIs, a name of the form "#123" is treated as ID 123.
+class ResourceId
+{
+public:
+  explicit ResourceId(WORD id) noexcept : id_{id}
+  {
+  }
+
+  explicit ResourceId(std::wstring const& name) : named_{true}, name_(name)
+  {
+    if (name.size() > 1 && name[0] == L'#')
+    {
+      wchar_t* end = nullptr;
+      unsigned long const id = std::wcstoul(name.c_str() + 1, &end, 10);
+      if (end && !*end && id <= 0xFFFF)
+      {
+        named_ = false;
+        id_ = static_cast<WORD>(id);
+        name_.clear();
+      }
+    }
+  }
+
+  bool IsNamed() const noexcept
+  {
+    return named_;
+  }
+
+  // Only valid if !IsNamed().
+  WORD GetId() const noexcept
+  {
+    return id_;
+  }
+
+  // Only valid if IsNamed().
+  std::wstring const& GetName() const noexcept
+  {
+    return name_;
+  }
+
+private:
+  bool named_{};
+  WORD id_{};
+  std::wstring name_;
+};
+
+inline bool operator==(ResourceId const& lhs, ResourceId const& rhs)
+{
+  return lhs.IsNamed() == rhs.IsNamed() &&
+         (lhs.IsNamed() ? lhs.GetName() == rhs.GetName()
+                        : lhs.GetId() == rhs.GetId());
+}
+
+inline bool operator!=(ResourceId const& lhs, ResourceId const& rhs)
+{
+  return !(lhs == rhs);
+}
+
+inline std::wostream& operator<<(std::wostream& lhs, ResourceId const& rhs)
+{
+  std::locale const old = lhs.imbue(std::locale::classic());
+  if (rhs.IsNamed())
+  {
+    lhs << rhs.GetName();
+  }
+  else
+  {
+    lhs << L'#' << rhs.GetId();
+  }
+  lhs.imbue(old);
+  return lhs;
+}
+
+// A leaf of the standard type/name/language resource tree.
+struct Resource
+{
+  ResourceId type;
+  ResourceId name;
+  ResourceId language;
+  ResourceDataEntry data;
+};
+
+// Resource directory (.rsrc). The tree is read lazily, a table at a time, so
+// looking up a single resource only reads the tables on its path.
+//
+// Hardened for malformed files: every structure is bounds checked against the
+// file, cycles and overly deep trees are rejected, each table is read at most
+// once, and the total number of entries read is capped (see
+// detail::ResourceDirContext). Not thread safe, as tables are cached as they
+// are read.
+class ResourceDir
+{
+public:
+  explicit ResourceDir(Process const& process, PeFile const& pe_file)
+    : process_{&process}, pe_file_{&pe_file}
+  {
+    NtHeaders const nt_headers{process, pe_file};
+
+    rva_ = nt_headers.GetDataDirectoryVirtualAddress(PeDataDir::Resource);
+    size_ = nt_headers.GetDataDirectorySize(PeDataDir::Resource);
+    if (!rva_)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"PE file has no resource directory."});
+    }
+
+    base_ = static_cast<std::uint8_t*>(RvaToVa(process, pe_file, rva_));
+    if (!base_)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Resource directory is invalid."});
+    }
+
+    context_ =
+      std::make_shared<detail::ResourceDirContext>(process, pe_file, rva_);
+  }
+
+  explicit ResourceDir(Process const&& process, PeFile const& pe_file) = delete;
+
+  explicit ResourceDir(Process const& process, PeFile&& pe_file) = delete;
+
+  explicit ResourceDir(Process const&& process, PeFile&& pe_file) = delete;
+
+  void* GetBase() const noexcept
+  {
+    return base_;
+  }
+
+  DWORD GetRva() const noexcept
+  {
+    return rva_;
+  }
+
+  DWORD GetSize() const noexcept
+  {
+    return size_;
+  }
+
+  // The table of resource types.
+  ResourceDirTable GetRoot() const
+  {
+    return ResourceDirTable{context_, 0};
+  }
+
+  // Returns nullptr if there is no such resource. Throws if a table on the
+  // path is invalid.
+  std::unique_ptr<ResourceDataEntry> Find(ResourceId const& type,
+                                          ResourceId const& name,
+                                          ResourceId const& language) const
+  {
+    std::unique_ptr<ResourceDirTable> const name_table =
+      FindLanguageTable(type, name);
+    ResourceDirEntry const* const language_entry =
+      name_table ? FindEntry(*name_table, language) : nullptr;
+    if (!language_entry || language_entry->IsDirectory())
+    {
+      return nullptr;
+    }
+
+    return std::make_unique<ResourceDataEntry>(
+      name_table->GetDataEntry(*language_entry));
+  }
+
+  // Same as above, but returns the first language of the resource.
+  std::unique_ptr<ResourceDataEntry> Find(ResourceId const& type,
+                                          ResourceId const& name) const
+  {
+    std::unique_ptr<ResourceDirTable> const name_table =
+      FindLanguageTable(type, name);
+    if (!name_table || name_table->empty() ||
+        name_table->begin()->IsDirectory())
+    {
+      return nullptr;
+    }
+
+    return std::make_unique<ResourceDataEntry>(
+      name_table->GetDataEntry(*name_table->begin()));
+  }
+
+  // Reads the data of a resource.
+  std::vector<BYTE> ReadData(ResourceDataEntry const& data_entry) const
+  {
+    void* const va = detail::RvaToVaChecked(*process_,
+                                            *pe_file_,
+                                            data_entry.GetOffsetToData(),
+                                            data_entry.GetSize());
+    if (!va)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Invalid resource data."});
+    }
+
+    return ReadVector<BYTE>(*process_, va, data_entry.GetSize());
+  }
+
+  // Walks the whole tree, returning every leaf found at the standard depth.
+  // Invalid subtrees and entries are skipped, and each table is visited at
+  // most once, so the walk is linear in the size of the tree even for
+  // malformed files. Throws if the root table is invalid.
+  std::vector<Resource> GetResources() const
+  {
+    std::vector<Resource> resources;
+    std::set<DWORD> visited;
+
+    ResourceDirTable const root = GetRoot();
+    visited.insert(root.GetOffset());
+    for (auto const& type_entry : root)
+    {
+      std::unique_ptr<ResourceDirTable> const type_table =
+        TryGetSubdirectory(root, type_entry, visited);
+      if (!type_table)
+      {
+        continue;
+      }
+
+      for (auto const& name_entry : *type_table)
+      {
+        std::unique_ptr<ResourceDirTable> const name_table =
+          TryGetSubdirectory(*type_table, name_entry, visited);
+        if (!name_table)
+        {
+          continue;
+        }
+
+        for (auto const& language_entry : *name_table)
+        {
+          try
+          {
+            resources.push_back(
+              Resource{GetEntryId(root, type_entry),
+                       GetEntryId(*type_table, name_entry),
+                       GetEntryId(*name_table, language_entry),
+                       name_table->GetDataEntry(language_entry)});
+          }
+          catch (std::exception const& /*e*/)
+          {
+            continue;
+          }
+        }
+      }
+    }
+
+    return resources;
+  }
+
+private:
+  static ResourceDirEntry const* FindEntry(ResourceDirTable const& table,
+                                           ResourceId const& id)
+  {
+    return id.IsNamed() ? table.Find(id.GetName()) : table.Find(id.GetId());
+  }
+
+  static ResourceId GetEntryId(ResourceDirTable const& table,
+                               ResourceDirEntry const& entry)
+  {
+    return entry.IsNamed() ? ResourceId{table.GetName(entry)}
+                           : ResourceId{entry.GetId()};
+  }
+
+  static std::unique_ptr<ResourceDirTable>
+    TryGetSubdirectory(ResourceDirTable const& table,
+                       ResourceDirEntry const& entry,
+                       std::set<DWORD>& visited)
+  {
+    if (!entry.IsDirectory() || !visited.insert(entry.GetOffset()).second)
+    {
+      return nullptr;
+    }
+
+    try
+    {
+      return std::make_unique<ResourceDirTable>(table.GetSubdirectory(entry));
+    }
+    catch (std::exception const& /*e*/)
+    {
+      return nullptr;
+    }
+  }
+
+  std::unique_ptr<ResourceDirTable>
+    FindLanguageTable(ResourceId const& type, ResourceId const& name) const
+  {
+    ResourceDirTable const root = GetRoot();
+    ResourceDirEntry const* const type_entry = FindEntry(root, type);
+    if (!type_entry || !type_entry->IsDirectory())
+    {
+      return nullptr;
+    }
+
+    ResourceDirTable const type_table = root.GetSubdirectory(*type_entry);
+    ResourceDirEntry const* const name_entry = FindEntry(type_table, name);
+    if (!name_entry || !name_entry->IsDirectory())
+    {
+      return nullptr;
+    }
+
+    return std::make_unique<ResourceDirTable>(
+      type_table.GetSubdirectory(*name_entry));
+  }
+
+  Process const* process_;
+  PeFile const* pe_file_;
+  std::uint8_t* base_{};
+  DWORD rva_{};
+  DWORD size_{};
+  std::shared_ptr<detail::ResourceDirContext> context_;
+};
+
+inline bool operator==(ResourceDir const& lhs, ResourceDir const& rhs) noexcept
+{
+  return lhs.GetBase() == rhs.GetBase();
+}
+
+inline bool operator!=(ResourceDir const& lhs, ResourceDir const& rhs) noexcept
+{
+  return !(lhs == rhs);
+}
+
+inline bool operator<(ResourceDir const& lhs, ResourceDir const& rhs) noexcept
+{
+  return lhs.GetBase() < rhs.GetBase();
+}
+
+inline bool operator<=(ResourceDir const& lhs, ResourceDir const& rhs) noexcept
+{
+  return lhs.GetBase() <= rhs.GetBase();
+}
+
+inline bool operator>(ResourceDir const& lhs, ResourceDir const& rhs) noexcept
+{
+  return lhs.GetBase() > rhs.GetBase();
+}
+
+inline bool operator>=(ResourceDir const& lhs, ResourceDir const& rhs) noexcept
+{
+  return lhs.GetBase() >= rhs.GetBase();
+}
+
+inline std::ostream& operator<<(std::ostream& lhs, ResourceDir const& rhs)
+{
+  std::locale const old = lhs.imbue(std::locale::classic());
+  lhs << rhs.GetBase();
+  lhs.imbue(old);
+  return lhs;
+}
+
+inline std::wostream& operator<<(std::wostream& lhs, ResourceDir const& rhs)
+{
+  std::locale const old = lhs.imbue(std::locale::classic());
+  lhs << rhs.GetBase();
+  lhs.imbue(old);
+  return lhs;
+}
+}
@@ -0,0 +1,469 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/to_upper_ordinal.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+namespace hadesmem
+{
+// Entry of a resource directory table. Either a subdirectory (the next level
+// of the type/name/language tree) or a data entry, identified by either an ID
+// or a name.
+class ResourceDirEntry
+{
+public:
+  explicit ResourceDirEntry(
+    pelib::ImageResourceDirectoryEntry const& data) noexcept
+    : data_(data)
+  {
+  }
+
+  bool IsNamed() const noexcept
+  {
+    return (data_.Name & pelib::kImageResourceNameIsString) != 0;
+  }
+
+  // Only valid if !IsNamed().
+  WORD GetId() const noexcept
+  {
+    return static_cast<WORD>(data_.Name & 0xFFFF);
+  }
+
+  // Only valid if IsNamed(). Offset of the name, relative to the start of the
+  // resource directory. See ResourceDirTable::GetName.
+  DWORD GetNameOffset() const noexcept
+  {
+    return data_.Name & ~pelib::kImageResourceNameIsString;
+  }
+
+  bool IsDirectory() const noexcept
+  {
+    return (data_.OffsetToData & pelib::kImageResourceDataIsDirectory) != 0;
+  }
+
+  // Offset of the subdirectory or data entry, relative to the start of the
+  // resource directory.
+  DWORD GetOffset() const noexcept
+  {
+    return data_.OffsetToData & ~pelib::kImageResourceDataIsDirectory;
+  }
+
+  pelib::ImageResourceDirectoryEntry const& GetData() const noexcept
+  {
+    return data_;
+  }
+
+private:
+  pelib::ImageResourceDirectoryEntry data_;
+};
+
+// Leaf of the resource tree, describing where the resource data is.
+class ResourceDataEntry
+{
+public:
+  explicit ResourceDataEntry(
+    pelib::ImageResourceDataEntry const& data) noexcept
+    : data_(data)
+  {
+  }
+
+  // An RVA (unlike the offsets in the rest of the resource directory).
+  DWORD GetOffsetToData() const noexcept
+  {
+    return data_.OffsetToData;
+  }
+
+  DWORD GetSize() const noexcept
+  {
+    return data_.Size;
+  }
+
+  DWORD GetCodePage() const noexcept
+  {
+    return data_.CodePage;
+  }
+
+  pelib::ImageResourceDataEntry const& GetData() const noexcept
+  {
+    return data_;
+  }
+
+private:
+  pelib::ImageResourceDataEntry data_;
+};
+
+namespace detail
+{
+struct ResourceDirTableData
+{
+  pelib::ImageResourceDirectory header;
+  std::vector<ResourceDirEntry> entries;
+  std::size_t num_named;
+  bool ids_sorted;
+};
+
+// State shared by all the tables of a resource directory. Each table is read
+// at most once, so walking a tree which shares subdirectories (which linkers
+// never emit, but malformed files can) doesn't read anything twice, and the
+// total number of entries read is capped.
+class ResourceDirContext
+{
+public:
+  // Far more than any real file (which have at most a few thousand), but
+  // bounds the memory used by malformed files at a few MB.
+  static std::size_t const kMaxEntries = 0x100000;
+
+  explicit ResourceDirContext(Process const& process,
+                              PeFile const& pe_file,
+                              DWORD rva)
+    : process_{&process}, pe_file_{&pe_file}, rva_{rva}
+  {
+  }
+
+  Process const& GetProcess() const noexcept
+  {
+    return *process_;
+  }
+
+  PeFile const& GetPeFile() const noexcept
+  {
+    return *pe_file_;
+  }
+
+  // Returns the address of an object at the given offset from the start of
+  // the resource directory, checking that all of it is inside the file.
+  void* OffsetToVa(DWORD offset, std::size_t size, char const* error) const
+  {
+    void* const va =
+      offset <= ~rva_
+        ? RvaToVaChecked(*process_, *pe_file_, rva_ + offset, size)
+        : nullptr;
+    if (!va)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{} << ErrorString{error});
+    }
+
+    return va;
+  }
+
+  std::shared_ptr<ResourceDirTableData const> GetTable(DWORD offset)
+  {
+    auto const iter = tables_.find(offset);
+    if (iter != std::end(tables_))
+    {
+      return iter->second;
+    }
+
+    void* const header_va = OffsetToVa(offset,
+                                       sizeof(pelib::ImageResourceDirectory),
+                                       "Invalid resource directory table.");
+    auto data = std::make_shared<ResourceDirTableData>();
+    data->header = Read<pelib::ImageResourceDirectory>(*process_, header_va);
+
+    // Clamp the number of entries to what's actually in the file, as the
+    // counts are frequently garbage in malformed files.
+    auto const entries_va = static_cast<std::uint8_t*>(header_va) +
+                            sizeof(pelib::ImageResourceDirectory);
+    auto const file_end =
+      static_cast<std::uint8_t*>(pe_file_->GetBase()) + pe_file_->GetSize();
+    std::size_t const num_available =
+      static_cast<std::size_t>(file_end - entries_va) /
+      sizeof(pelib::ImageResourceDirectoryEntry);
+    std::size_t const num_entries = (std::min)(
+      static_cast<std::size_t>(data->header.NumberOfNamedEntries) +
+        data->header.NumberOfIdEntries,
+      num_available);
+    if (num_entries > kMaxEntries - num_entries_read_)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Resource directory too large."});
+    }
+    num_entries_read_ += num_entries;
+
+    auto const entries = ReadVector<pelib::ImageResourceDirectoryEntry>(
+      *process_, entries_va, num_entries);
+    data->entries.reserve(entries.size());
+    for (auto const& entry : entries)
+    {
+      data->entries.emplace_back(entry);
+    }
+
+    // The ID entries must be sorted for a binary search to work (the loader
+    // relies on this too), but check rather than trust it.
+    data->num_named = (std::min)(
+      static_cast<std::size_t>(data->header.NumberOfNamedEntries), num_entries);
+    data->ids_sorted = true;
+    for (std::size_t i = data->num_named; i < num_entries; ++i)
+    {
+      if (data->entries[i].IsNamed() ||
+          (i > data->num_named &&
+           data->entries[i].GetId() < data->entries[i - 1].GetId()))
+      {
+        data->ids_sorted = false;
+        break;
+      }
+    }
+
+    tables_.emplace(offset, data);
+    return data;
+  }
+
+private:
+  Process const* process_;
+  PeFile const* pe_file_;
+  DWORD rva_;
+  std::map<DWORD, std::shared_ptr<ResourceDirTableData const>> tables_;
+  std::size_t num_entries_read_{};
+};
+}
+
+// A single table (one level) of the resource tree. Tables are only read when
+// they're first requested, via ResourceDir::GetRoot or GetSubdirectory.
+class ResourceDirTable
+{
+public:
+  using value_type = ResourceDirEntry;
+  using iterator = std::vector<ResourceDirEntry>::const_iterator;
+  using const_iterator = std::vector<ResourceDirEntry>::const_iterator;
+
+  // The standard tree only has three levels (type, name and language), so
+  // anything deeper than this is malformed.
+  static std::size_t const kMaxDepth = 8;
+
+  explicit ResourceDirTable(std::shared_ptr<detail::ResourceDirContext> context,
+                            DWORD offset)
+    : ResourceDirTable{std::move(context), offset, std::vector<DWORD>{}}
+  {
+  }
+
+  DWORD GetOffset() const noexcept
+  {
+    return offset_;
+  }
+
+  // Zero for the root.
+  std::size_t GetDepth() const noexcept
+  {
+    return ancestors_.size();
+  }
+
+  DWORD GetCharacteristics() const noexcept
+  {
+    return data_->header.Characteristics;
+  }
+
+  DWORD GetTimeDateStamp() const noexcept
+  {
+    return data_->header.TimeDateStamp;
+  }
+
+  WORD GetMajorVersion() const noexcept
+  {
+    return data_->header.MajorVersion;
+  }
+
+  WORD GetMinorVersion() const noexcept
+  {
+    return data_->header.MinorVersion;
+  }
+
+  // As specified in the file. The number of entries actually available may be
+  // less if the table is truncated.
+  WORD GetNumberOfNamedEntries() const noexcept
+  {
+    return data_->header.NumberOfNamedEntries;
+  }
+
+  WORD GetNumberOfIdEntries() const noexcept
+  {
+    return data_->header.NumberOfIdEntries;
+  }
+
+  const_iterator begin() const noexcept
+  {
+    return std::begin(data_->entries);
+  }
+
+  const_iterator cbegin() const noexcept
+  {
+    return std::begin(data_->entries);
+  }
+
+  const_iterator end() const noexcept
+  {
+    return std::end(data_->entries);
+  }
+
+  const_iterator cend() const noexcept
+  {
+    return std::end(data_->entries);
+  }
+
+  std::size_t size() const noexcept
+  {
+    return data_->entries.size();
+  }
+
+  bool empty() const noexcept
+  {
+    return data_->entries.empty();
+  }
+
+  // Binary search of the ID entries (falling back to a linear search if
+  // they're not sorted). Returns nullptr if there is no entry with the ID.
+  ResourceDirEntry const* Find(WORD id) const noexcept
+  {
+    auto const first = std::begin(data_->entries) +
+                       static_cast<std::ptrdiff_t>(data_->num_named);
+    auto const last = std::end(data_->entries);
+    auto const id_equal = [&](ResourceDirEntry const& e) {
+      return !e.IsNamed() && e.GetId() == id;
+    };
+    if (!data_->ids_sorted)
+    {
+      auto const iter = std::find_if(first, last, id_equal);
+      return iter != last ? &*iter : nullptr;
+    }
+
+    auto const iter =
+      std::lower_bound(first,
+                       last,
+                       id,
+                       [](ResourceDirEntry const& e, WORD value) {
+                         return e.GetId() < value;
+                       });
+    return iter != last && id_equal(*iter) ? &*iter : nullptr;
+  }
+
+  // Linear search of the named entries, as there are rarely more than a few.
+  // The same as FindResource, the name is converted to upper case before
+  // comparing (resource compilers store names in upper case). Entries with
+  // invalid names are skipped.
+  ResourceDirEntry const* Find(std::wstring const& name) const
+  {
+    std::wstring const name_upper = detail::ToUpperOrdinal(name);
+    for (std::size_t i = 0; i < data_->num_named; ++i)
+    {
+      ResourceDirEntry const& e = data_->entries[i];
+      if (!e.IsNamed())
+      {
+        continue;
+      }
+
+      try
+      {
+        if (GetName(e) == name_upper)
+        {
+          return &e;
+        }
+      }
+      catch (std::exception const& /*e*/)
+      {
+        continue;
+      }
+    }
+
+    return nullptr;
+  }
+
+  // Reads the name (an IMAGE_RESOURCE_DIR_STRING_U) of a named entry.
+  std::wstring GetName(ResourceDirEntry const& entry) const
+  {
+    HADESMEM_DETAIL_ASSERT(entry.IsNamed());
+
+    DWORD const offset = entry.GetNameOffset();
+    auto const len_va =
+      context_->OffsetToVa(offset, sizeof(WORD), "Invalid resource name.");
+    WORD const len = Read<WORD>(context_->GetProcess(), len_va);
+    auto const str_va = context_->OffsetToVa(
+      offset, sizeof(WORD) + len * sizeof(WORD), "Invalid resource name.");
+    // Read as WORDs rather than wchar_t, which isn't always 16 bits.
+    auto const chars = ReadVector<WORD>(
+      context_->GetProcess(), static_cast<WORD*>(str_va) + 1, len);
+    return std::wstring(std::begin(chars), std::end(chars));
+  }
+
+  // Reads the subdirectory of an entry. Throws if the entry is not a
+  // directory, or would create a cycle (i.e. is an ancestor of this table)
+  // or make the tree too deep.
+  ResourceDirTable GetSubdirectory(ResourceDirEntry const& entry) const
+  {
+    if (!entry.IsDirectory())
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Resource entry is not a directory."});
+    }
+
+    DWORD const offset = entry.GetOffset();
+    if (offset == offset_ ||
+        std::find(std::begin(ancestors_), std::end(ancestors_), offset) !=
+          std::end(ancestors_))
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Resource directory cycle."});
+    }
+
+    if (GetDepth() + 1 > kMaxDepth)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Resource directory nesting too deep."});
+    }
+
+    std::vector<DWORD> ancestors = ancestors_;
+    ancestors.push_back(offset_);
+    return ResourceDirTable{context_, offset, std::move(ancestors)};
+  }
+
+  // Reads the data entry of an entry. Throws if the entry is a directory.
+  ResourceDataEntry GetDataEntry(ResourceDirEntry const& entry) const
+  {
+    if (entry.IsDirectory())
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Resource entry is a directory."});
+    }
+
+    auto const va = context_->OffsetToVa(entry.GetOffset(),
+                                         sizeof(pelib::ImageResourceDataEntry),
+                                         "Invalid resource data entry.");
+    return ResourceDataEntry{
+      Read<pelib::ImageResourceDataEntry>(context_->GetProcess(), va)};
+  }
+
+private:
+  explicit ResourceDirTable(std::shared_ptr<detail::ResourceDirContext> context,
+                            DWORD offset,
+                            std::vector<DWORD> ancestors)
+    : context_{std::move(context)},
+      offset_{offset},
+      ancestors_(std::move(ancestors))
+  {
+    HADESMEM_DETAIL_ASSERT(context_);
+    data_ = context_->GetTable(offset_);
+  }
+
+  std::shared_ptr<detail::ResourceDirContext> context_;
+  DWORD offset_;
+  std::vector<DWORD> ancestors_;
+  std::shared_ptr<detail::ResourceDirTableData const> data_;
+};
+}
@@ -0,0 +1,355 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <ostream>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+// TODO: Decode the unwind codes (UWOP_*) rather than just exposing the raw
+// slots, so that the stack frame layout can be reported.
+
+// TODO: Support the ARM/ARM64 formats (which use packed unwind data).
+
+namespace hadesmem
+{
+// An x64 RUNTIME_FUNCTION. A value type, as the entries are small and read in
+// bulk by RuntimeFunctionList.
+class RuntimeFunction
+{
+public:
+  explicit RuntimeFunction(
+    pelib::ImageRuntimeFunctionEntry const& data) noexcept
+    : data_(data)
+  {
+  }
+
+  explicit RuntimeFunction(Process const& process,
+                           PeFile const& pe_file,
+                           DWORD rva)
+  {
+    void* const va = detail::RvaToVaChecked(
+      process, pe_file, rva, sizeof(pelib::ImageRuntimeFunctionEntry));
+    if (!va)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Invalid runtime function RVA."});
+    }
+
+    data_ = Read<pelib::ImageRuntimeFunctionEntry>(process, va);
+  }
+
+  explicit RuntimeFunction(Process const&& process,
+                           PeFile const& pe_file,
+                           DWORD rva) = delete;
+
+  explicit RuntimeFunction(Process const& process,
+                           PeFile&& pe_file,
+                           DWORD rva) = delete;
+
+  explicit RuntimeFunction(Process const&& process,
+                           PeFile&& pe_file,
+                           DWORD rva) = delete;
+
+  DWORD GetBeginAddress() const noexcept
+  {
+    return data_.BeginAddress;
+  }
+
+  DWORD GetEndAddress() const noexcept
+  {
+    return data_.EndAddress;
+  }
+
+  DWORD GetUnwindInfoAddress() const noexcept
+  {
+    return data_.UnwindInfoAddress;
+  }
+
+  // The unwind info is shared with another RUNTIME_FUNCTION, located at
+  // GetUnwindInfoAddress() - 1.
+  bool IsIndirect() const noexcept
+  {
+    return (data_.UnwindInfoAddress & pelib::kRuntimeFunctionIndirect) != 0;
+  }
+
+  bool Contains(DWORD rva) const noexcept
+  {
+    return rva >= data_.BeginAddress && rva < data_.EndAddress;
+  }
+
+  pelib::ImageRuntimeFunctionEntry const& GetData() const noexcept
+  {
+    return data_;
+  }
+
+private:
+  pelib::ImageRuntimeFunctionEntry data_ = pelib::ImageRuntimeFunctionEntry{};
+};
+
+inline bool operator==(RuntimeFunction const& lhs,
+                       RuntimeFunction const& rhs) noexcept
+{
+  return lhs.GetBeginAddress() == rhs.GetBeginAddress() &&
+         lhs.GetEndAddress() == rhs.GetEndAddress() &&
+         lhs.GetUnwindInfoAddress() == rhs.GetUnwindInfoAddress();
+}
+
+inline bool operator!=(RuntimeFunction const& lhs,
+                       RuntimeFunction const& rhs) noexcept
+{
+  return !(lhs == rhs);
+}
+
+inline std::ostream& operator<<(std::ostream& lhs, RuntimeFunction const& rhs)
+{
+  std::locale const old = lhs.imbue(std::locale::classic());
+  lhs << std::hex << rhs.GetBeginAddress() << '-' << rhs.GetEndAddress()
+      << std::dec;
+  lhs.imbue(old);
+  return lhs;
+}
+
+inline std::wostream& operator<<(std::wostream& lhs,
+                                 RuntimeFunction const& rhs)
+{
+  std::locale const old = lhs.imbue(std::locale::classic());
+  lhs << std::hex << rhs.GetBeginAddress() << L'-' << rhs.GetEndAddress()
+      << std::dec;
+  lhs.imbue(old);
+  return lhs;
+}
+
+// UNWIND_INFO of an x64 RUNTIME_FUNCTION, including the trailing exception
+// handler or chained RUNTIME_FUNCTION.
+class UnwindInfo
+{
+public:
+  explicit UnwindInfo(Process const& process, PeFile const& pe_file, DWORD rva)
+  {
+    Initialize(process, pe_file, rva);
+  }
+
+  explicit UnwindInfo(Process const&& process,
+                      PeFile const& pe_file,
+                      DWORD rva) = delete;
+
+  explicit UnwindInfo(Process const& process,
+                      PeFile&& pe_file,
+                      DWORD rva) = delete;
+
+  explicit UnwindInfo(Process const&& process,
+                      PeFile&& pe_file,
+                      DWORD rva) = delete;
+
+  // Follows the indirection if the unwind info is shared with another
+  // RUNTIME_FUNCTION.
+  explicit UnwindInfo(Process const& process,
+                      PeFile const& pe_file,
+                      RuntimeFunction const& runtime_function)
+  {
+    DWORD rva = runtime_function.GetUnwindInfoAddress();
+    if (runtime_function.IsIndirect())
+    {
+      RuntimeFunction const shared{
+        process, pe_file, rva & ~pelib::kRuntimeFunctionIndirect};
+      // Only one level of indirection is allowed (the same as the loader).
+      if (shared.IsIndirect())
+      {
+        HADESMEM_DETAIL_THROW_EXCEPTION(
+          Error{} << ErrorString{"Nested indirect runtime function."});
+      }
+
+      rva = shared.GetUnwindInfoAddress();
+    }
+
+    Initialize(process, pe_file, rva);
+  }
+
+  explicit UnwindInfo(Process const&& process,
+                      PeFile const& pe_file,
+                      RuntimeFunction const& runtime_function) = delete;
+
+  explicit UnwindInfo(Process const& process,
+                      PeFile&& pe_file,
+                      RuntimeFunction const& runtime_function) = delete;
+
+  explicit UnwindInfo(Process const&& process,
+                      PeFile&& pe_file,
+                      RuntimeFunction const& runtime_function) = delete;
+
+  DWORD GetRva() const noexcept
+  {
+    return rva_;
+  }
+
+  BYTE GetVersion() const noexcept
+  {
+    return static_cast<BYTE>(header_.VersionAndFlags & 0x7);
+  }
+
+  BYTE GetFlags() const noexcept
+  {
+    return static_cast<BYTE>(header_.VersionAndFlags >> 3);
+  }
+
+  BYTE GetSizeOfProlog() const noexcept
+  {
+    return header_.SizeOfProlog;
+  }
+
+  BYTE GetCountOfCodes() const noexcept
+  {
+    return header_.CountOfCodes;
+  }
+
+  BYTE GetFrameRegister() const noexcept
+  {
+    return static_cast<BYTE>(header_.FrameRegisterAndOffset & 0xF);
+  }
+
+  // In units of 16 bytes.
+  BYTE GetFrameOffset() const noexcept
+  {
+    return static_cast<BYTE>(header_.FrameRegisterAndOffset >> 4);
+  }
+
+  // Raw UNWIND_CODE slots, not including the padding slot. Some operations
+  // use more than one slot.
+  std::vector<WORD> const& GetUnwindCodes() const noexcept
+  {
+    return unwind_codes_;
+  }
+
+  bool IsChained() const noexcept
+  {
+    return (GetFlags() & pelib::kUnwFlagChainInfo) != 0;
+  }
+
+  // Chained unwind info can't have a handler, so the handler flags are
+  // ignored if it is set (the same as RtlVirtualUnwind).
+  bool HasExceptionHandler() const noexcept
+  {
+    return !IsChained() &&
+           (GetFlags() &
+            (pelib::kUnwFlagEHandler | pelib::kUnwFlagUHandler)) != 0;
+  }
+
+  // RVA of the language specific handler. Only valid if
+  // HasExceptionHandler().
+  DWORD GetExceptionHandler() const noexcept
+  {
+    return exception_handler_;
+  }
+
+  // RVA of the language specific handler data. Only valid if
+  // HasExceptionHandler().
+  DWORD GetExceptionData() const noexcept
+  {
+    return exception_data_;
+  }
+
+  // Only valid if IsChained().
+  RuntimeFunction const& GetChainedFunction() const noexcept
+  {
+    return chained_function_;
+  }
+
+private:
+  void Initialize(Process const& process, PeFile const& pe_file, DWORD rva)
+  {
+    rva_ = rva;
+
+    void* const va = detail::RvaToVaChecked(
+      process, pe_file, rva, sizeof(pelib::ImageUnwindInfoHeader));
+    if (!va)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Invalid unwind info RVA."});
+    }
+
+    header_ = Read<pelib::ImageUnwindInfoHeader>(process, va);
+
+    // The slots are padded to an even count so that whatever follows them is
+    // DWORD aligned.
+    std::size_t const num_slots =
+      (static_cast<std::size_t>(header_.CountOfCodes) + 1) & ~std::size_t{1};
+    std::size_t const trailer_offset =
+      sizeof(pelib::ImageUnwindInfoHeader) + num_slots * sizeof(WORD);
+    std::size_t const trailer_size =
+      IsChained() ? sizeof(pelib::ImageRuntimeFunctionEntry)
+                  : HasExceptionHandler() ? sizeof(DWORD) : 0;
+    if (!detail::RvaToVaChecked(
+          process, pe_file, rva, trailer_offset + trailer_size))
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Unwind info is truncated."});
+    }
+
+    auto const codes_va =
+      static_cast<std::uint8_t*>(va) + sizeof(pelib::ImageUnwindInfoHeader);
+    unwind_codes_ =
+      ReadVector<WORD>(process, codes_va, header_.CountOfCodes);
+
+    auto const trailer_va = static_cast<std::uint8_t*>(va) + trailer_offset;
+    if (IsChained())
+    {
+      chained_function_ = RuntimeFunction{
+        Read<pelib::ImageRuntimeFunctionEntry>(process, trailer_va)};
+    }
+    else if (HasExceptionHandler())
+    {
+      exception_handler_ = Read<DWORD>(process, trailer_va);
+      exception_data_ =
+        rva + static_cast<DWORD>(trailer_offset + sizeof(DWORD));
+    }
+  }
+
+  DWORD rva_{};
+  pelib::ImageUnwindInfoHeader header_ = pelib::ImageUnwindInfoHeader{};
+  std::vector<WORD> unwind_codes_;
+  DWORD exception_handler_{};
+  DWORD exception_data_{};
+  RuntimeFunction chained_function_{pelib::ImageRuntimeFunctionEntry{}};
+};
+
+// Follows the chained unwind info of a RUNTIME_FUNCTION back to the primary
+// RUNTIME_FUNCTION (i.e. the one whose BeginAddress is the function entry
+// point). Functions split into non-contiguous blocks (e.g. by PGO) have one
+// chained entry per block.
+inline RuntimeFunction
+  GetPrimaryRuntimeFunction(Process const& process,
+                            PeFile const& pe_file,
+                            RuntimeFunction const& runtime_function)
+{
+  // Chains longer than this only happen in malformed (e.g. cyclic) files.
+  std::size_t const kMaxChainDepth = 32;
+
+  RuntimeFunction cur = runtime_function;
+  for (std::size_t i = 0; i < kMaxChainDepth; ++i)
+  {
+    UnwindInfo const unwind_info{process, pe_file, cur};
+    if (!unwind_info.IsChained())
+    {
+      return cur;
+    }
+
+    cur = unwind_info.GetChainedFunction();
+  }
+
+  HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                  << ErrorString{"Unwind chain too long."});
+}
+}
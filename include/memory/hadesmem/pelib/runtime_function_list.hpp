@@ -0,0 +1,215 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/exception_dir.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/runtime_function.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+namespace hadesmem
+{
+// All RUNTIME_FUNCTION entries of an x64 file, read in a single pass.
+//
+// Lookup by RVA is a binary search, the same as RtlLookupFunctionEntry. To
+// keep the search to a handful of entries, a dense index of the first entry
+// starting in each page of the code range is built up front (it's immutable,
+// so Find is safe to call concurrently). The index is skipped for files with
+// an implausibly large code range (i.e. malformed files), which fall back to
+// a binary search over the whole table.
+class RuntimeFunctionList
+{
+public:
+  using value_type = RuntimeFunction;
+  using iterator = std::vector<RuntimeFunction>::const_iterator;
+  using const_iterator = std::vector<RuntimeFunction>::const_iterator;
+
+  explicit RuntimeFunctionList(Process const& process, PeFile const& pe_file)
+  {
+    ExceptionDir const exception_dir{process, pe_file};
+
+    auto const entries = ReadVector<pelib::ImageRuntimeFunctionEntry>(
+      process, exception_dir.GetBase(), exception_dir.GetNumberOfEntries());
+    functions_.reserve(entries.size());
+    for (auto const& entry : entries)
+    {
+      functions_.emplace_back(entry);
+    }
+
+    // The loader requires the table to be sorted, as it binary searches it
+    // too, but the linker isn't the only thing writing these tables. Sort a
+    // copy so that lookups are still correct.
+    auto const less_begin = [](RuntimeFunction const& lhs,
+                               RuntimeFunction const& rhs) {
+      return lhs.GetBeginAddress() < rhs.GetBeginAddress();
+    };
+    sorted_ =
+      std::is_sorted(std::begin(functions_), std::end(functions_), less_begin);
+    if (!sorted_)
+    {
+      std::stable_sort(
+        std::begin(functions_), std::end(functions_), less_begin);
+    }
+
+    BuildPageIndex();
+  }
+
+  explicit RuntimeFunctionList(Process const&& process,
+                               PeFile const& pe_file) = delete;
+
+  explicit RuntimeFunctionList(Process const& process,
+                               PeFile&& pe_file) = delete;
+
+  explicit RuntimeFunctionList(Process const&& process,
+                               PeFile&& pe_file) = delete;
+
+  // Iteration is in order of BeginAddress, which is only the order in the
+  // file if IsSorted().
+  const_iterator begin() const noexcept
+  {
+    return std::begin(functions_);
+  }
+
+  const_iterator cbegin() const noexcept
+  {
+    return std::begin(functions_);
+  }
+
+  const_iterator end() const noexcept
+  {
+    return std::end(functions_);
+  }
+
+  const_iterator cend() const noexcept
+  {
+    return std::end(functions_);
+  }
+
+  std::size_t size() const noexcept
+  {
+    return functions_.size();
+  }
+
+  bool empty() const noexcept
+  {
+    return functions_.empty();
+  }
+
+  // Whether the table in the file was sorted by BeginAddress.
+  bool IsSorted() const noexcept
+  {
+    return sorted_;
+  }
+
+  // Returns the entry containing the RVA, or nullptr if there is none (e.g.
+  // leaf functions, which have no entry, or data). This is not necessarily
+  // the primary entry of the function, see GetPrimaryRuntimeFunction.
+  RuntimeFunction const* Find(DWORD rva) const noexcept
+  {
+    std::size_t lo = 0;
+    std::size_t hi = functions_.size();
+    if (!page_index_.empty())
+    {
+      DWORD const page = rva >> kPageShift;
+      if (page < first_page_ || page - first_page_ >= page_index_.size() - 1)
+      {
+        return nullptr;
+      }
+
+      // Candidates are the entries starting in the page, plus the last entry
+      // starting before it (which may extend into it).
+      std::size_t const index = page - first_page_;
+      lo = page_index_[index] ? page_index_[index] - 1 : 0;
+      hi = page_index_[index + 1];
+    }
+
+    // Last entry starting at or before the RVA.
+    RuntimeFunction const* const first = functions_.data() + lo;
+    RuntimeFunction const* const iter = std::upper_bound(
+      first,
+      functions_.data() + hi,
+      rva,
+      [](DWORD value, RuntimeFunction const& f) {
+        return value < f.GetBeginAddress();
+      });
+    if (iter == first)
+    {
+      return nullptr;
+    }
+
+    RuntimeFunction const& f = *(iter - 1);
+    return f.Contains(rva) ? &f : nullptr;
+  }
+
+private:
+  static DWORD const kPageShift = 12;
+
+  // 256MB of code, which no real file comes anywhere close to. Bounds the
+  // index at 256KB for malformed files.
+  static DWORD const kMaxIndexedPages = 0x10000;
+
+  void BuildPageIndex()
+  {
+    if (functions_.empty())
+    {
+      return;
+    }
+
+    DWORD max_end = 0;
+    for (auto const& f : functions_)
+    {
+      max_end = (std::max)(max_end, f.GetEndAddress());
+    }
+
+    first_page_ = functions_.front().GetBeginAddress() >> kPageShift;
+    if (max_end <= functions_.front().GetBeginAddress())
+    {
+      // No entry contains anything, so an empty page range means every
+      // lookup misses.
+      page_index_.assign(1, 0);
+      return;
+    }
+
+    DWORD const last_page = (max_end - 1) >> kPageShift;
+    DWORD const num_pages = last_page - first_page_ + 1;
+    if (num_pages > kMaxIndexedPages)
+    {
+      return;
+    }
+
+    // page_index_[i] is the index of the first entry starting in or after
+    // page first_page_ + i. The extra element at the end bounds the last page.
+    page_index_.resize(num_pages + 1);
+    std::size_t cur = 0;
+    for (DWORD i = 0; i <= num_pages; ++i)
+    {
+      std::uint64_t const page_start =
+        static_cast<std::uint64_t>(first_page_ + i) << kPageShift;
+      while (cur < functions_.size() &&
+             functions_[cur].GetBeginAddress() < page_start)
+      {
+        ++cur;
+      }
+
+      page_index_[i] = static_cast<DWORD>(cur);
+    }
+  }
+
+  std::vector<RuntimeFunction> functions_;
+  bool sorted_{};
+  DWORD first_page_{};
+  std::vector<DWORD> page_index_;
+};
+}
@@ -67,6 +67,30 @@ public:
                    PeFile&& pe_file,
                    void* base) = delete;
 
+  // Reads from the PeFile's buffer (or the process it was constructed with).
+  explicit Section(PeFile const& pe_file, void* base)
+    : process_{nullptr},
+      pe_file_{&pe_file},
+      base_{static_cast<std::uint8_t*>(base)}
+  {
+    if (!base_)
+    {
+      Initialize(0);
+    }
+
+    UpdateRead();
+  }
+
+  explicit Section(PeFile const& pe_file, WORD index)
+    : process_{nullptr}, pe_file_{&pe_file}, base_{nullptr}
+  {
+    Initialize(index);
+
+    UpdateRead();
+  }
+
+  explicit Section(PeFile&& pe_file, void* base) = delete;
+
   void* GetBase() const noexcept
   {
     return base_;
@@ -94,13 +118,15 @@ public:
     }
     else
     {
-      data_ = Read<IMAGE_SECTION_HEADER>(*process_, base_);
+      data_ =
+        detail::ReadPe<IMAGE_SECTION_HEADER>(process_, *pe_file_, base_);
     }
   }
 
   void UpdateWrite()
   {
-    Write(*process_, base_, data_);
+    detail::WritePe(process_, *pe_file_, base_, data_);
+    pe_file_->RefreshHeaders();
   }
 
   // TODO: Don't truncate.
@@ -227,7 +253,8 @@ private:
 
   void Initialize(WORD index)
   {
-    NtHeaders const nt_headers(*process_, *pe_file_);
+    NtHeaders const nt_headers =
+      process_ ? NtHeaders{*process_, *pe_file_} : NtHeaders{*pe_file_};
     if (!nt_headers.GetNumberOfSections())
     {
       HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
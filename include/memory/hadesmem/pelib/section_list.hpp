@@ -44,7 +44,7 @@ public:
     if (auto const num_sections = nt_headers.GetNumberOfSections())
     {
       Section const section(process, pe_file, nullptr);
-      impl_ = std::make_shared<Impl>(process, pe_file, section, num_sections);
+      impl_ = std::make_shared<Impl>(&process, pe_file, section, num_sections);
     }
   }
 
@@ -54,6 +54,18 @@ public:
 
   explicit SectionIterator(Process const&& process, PeFile&& pe_file) = delete;
 
+  explicit SectionIterator(PeFile const& pe_file)
+  {
+    NtHeaders const nt_headers(pe_file);
+    if (auto const num_sections = nt_headers.GetNumberOfSections())
+    {
+      Section const section(pe_file, nullptr);
+      impl_ = std::make_shared<Impl>(nullptr, pe_file, section, num_sections);
+    }
+  }
+
+  explicit SectionIterator(PeFile&& pe_file) = delete;
+
   reference operator*() const noexcept
   {
     HADESMEM_DETAIL_ASSERT(impl_.get());
@@ -78,7 +90,9 @@ public:
 
     auto const new_base =
       static_cast<PIMAGE_SECTION_HEADER>(impl_->section_->GetBase()) + 1U;
-    impl_->section_ = Section{*impl_->process_, *impl_->pe_file_, new_base};
+    impl_->section_ = impl_->process_
+                        ? Section{*impl_->process_, *impl_->pe_file_, new_base}
+                        : Section{*impl_->pe_file_, new_base};
 
     return *this;
   }
@@ -103,11 +117,12 @@ public:
 private:
   struct Impl
   {
-    explicit Impl(Process const& process,
+    // Process is nullptr if the iterator was constructed without one.
+    explicit Impl(Process const* process,
                   PeFile const& pe_file,
                   Section const& section,
                   WORD num_sections) noexcept
-      : process_{&process},
+      : process_{process},
         pe_file_{&pe_file},
         section_{section},
         num_sections_{num_sections}
@@ -143,19 +158,28 @@ public:
 
   explicit SectionList(Process const&& process, PeFile&& pe_file) = delete;
 
+  // Reads from the PeFile's buffer (or the process it was constructed with).
+  explicit SectionList(PeFile const& pe_file)
+    : process_{nullptr}, pe_file_{&pe_file}
+  {
+  }
+
+  explicit SectionList(PeFile&& pe_file) = delete;
+
   iterator begin()
   {
-    return iterator{*process_, *pe_file_};
+    return process_ ? iterator{*process_, *pe_file_} : iterator{*pe_file_};
   }
 
   const_iterator begin() const
   {
-    return const_iterator{*process_, *pe_file_};
+    return process_ ? const_iterator{*process_, *pe_file_}
+                    : const_iterator{*pe_file_};
   }
 
   const_iterator cbegin() const
   {
-    return const_iterator{*process_, *pe_file_};
+    return begin();
   }
 
   iterator end() noexcept
@@ -0,0 +1,482 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+
+#if defined(HADESMEM_DETAIL_SSE2)
+#include <emmintrin.h>
+#endif // #if defined(HADESMEM_DETAIL_SSE2)
+
+namespace hadesmem
+{
+namespace pelib
+{
+namespace detail
+{
+// Number of bytes modified by a relocation of the given type, or zero if the
+// type is unsupported (or ABSOLUTE, which is padding).
+inline std::uint32_t GetRelocationWidth(std::uint8_t type) noexcept
+{
+  switch (type)
+  {
+  case kImageRelBasedHigh:
+  case kImageRelBasedLow:
+  case kImageRelBasedHighAdj:
+    return 2;
+
+  case kImageRelBasedHighLow:
+    return 4;
+
+  case kImageRelBasedDir64:
+    return 8;
+
+  default:
+    return 0;
+  }
+}
+
+template <typename T>
+inline void AddRelocationDelta(std::uint8_t* target, std::uint64_t delta)
+{
+  T value;
+  std::memcpy(&value, target, sizeof(value));
+  value = static_cast<T>(value + static_cast<T>(delta));
+  std::memcpy(target, &value, sizeof(value));
+}
+}
+
+// All base relocations of an image, decoded up front into flat arrays of
+// target RVAs and types rather than one object per entry. Each block is
+// decoded straight out of the directory (eight entries at a time with SSE2),
+// and ABSOLUTE padding entries are dropped.
+//
+// HIGHADJ relocations take up two entries (the second being the low half of
+// the target value), but only appear once in the table. The low halves are
+// kept separately, in order.
+//
+// Throws if a block is malformed or contains a type other than those used on
+// x86 and x64, as the loader would refuse to load the image.
+class BaseRelocationTable
+{
+public:
+  BaseRelocationTable() noexcept
+  {
+  }
+
+  // Decodes the relocation directory of a file or image. Empty if there is no
+  // directory.
+  explicit BaseRelocationTable(PeView const& view)
+  {
+    ImageDataDirectory const dir = view.GetDataDir(PeDataDir::BaseReloc);
+    if (!dir.VirtualAddress || !dir.Size)
+    {
+      return;
+    }
+
+    std::uint8_t const* const data = view.RvaToPtr(dir.VirtualAddress);
+    if (!data)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Invalid relocation directory."});
+    }
+
+    // The loader only walks as far as the size in the data directory, but
+    // that may run off the end of the file.
+    std::uint8_t const* const end =
+      view.GetSource().GetData() + view.GetSize();
+    Decode(data,
+           (std::min)(static_cast<std::size_t>(dir.Size),
+                      static_cast<std::size_t>(end - data)));
+  }
+
+  // Decodes a raw relocation directory (e.g. one which has been read out of
+  // another process).
+  explicit BaseRelocationTable(void const* dir, std::size_t size)
+  {
+    Decode(static_cast<std::uint8_t const*>(dir), size);
+  }
+
+  std::size_t size() const noexcept
+  {
+    return rvas_.size();
+  }
+
+  bool empty() const noexcept
+  {
+    return rvas_.empty();
+  }
+
+  std::vector<std::uint32_t> const& GetRvas() const noexcept
+  {
+    return rvas_;
+  }
+
+  std::vector<std::uint8_t> const& GetTypes() const noexcept
+  {
+    return types_;
+  }
+
+  // Low halves of the HIGHADJ relocations, in the order they appear.
+  std::vector<std::uint16_t> const& GetHighAdjParams() const noexcept
+  {
+    return high_adj_params_;
+  }
+
+  // Bitmask of (1 << type) for every type in the table.
+  std::uint32_t GetTypesSeen() const noexcept
+  {
+    return types_seen_;
+  }
+
+  // One past the last byte modified by any relocation.
+  std::uint64_t GetEnd() const noexcept
+  {
+    return end_;
+  }
+
+  // Adds delta to every relocation target in an image-layout buffer. The
+  // bounds are checked once up front, and tables with a single type (i.e.
+  // all DIR64 or all HIGHLOW, which is almost always the case) are applied
+  // without any per-entry dispatch.
+  void Apply(void* image, std::size_t image_size, std::uint64_t delta) const
+  {
+    if (!delta || rvas_.empty())
+    {
+      return;
+    }
+
+    if (end_ > image_size)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Relocation target out of bounds."});
+    }
+
+    auto const base = static_cast<std::uint8_t*>(image);
+    std::size_t const count = rvas_.size();
+    std::uint32_t const* const rvas = rvas_.data();
+    if (types_seen_ == (1U << kImageRelBasedDir64))
+    {
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        detail::AddRelocationDelta<std::uint64_t>(base + rvas[i], delta);
+      }
+      return;
+    }
+
+    if (types_seen_ == (1U << kImageRelBasedHighLow))
+    {
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        detail::AddRelocationDelta<std::uint32_t>(base + rvas[i], delta);
+      }
+      return;
+    }
+
+    std::size_t high_adj_index = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      std::uint8_t* const target = base + rvas[i];
+      switch (types_[i])
+      {
+      case kImageRelBasedHigh:
+        detail::AddRelocationDelta<std::uint16_t>(target, delta >> 16);
+        break;
+
+      case kImageRelBasedLow:
+        detail::AddRelocationDelta<std::uint16_t>(target, delta);
+        break;
+
+      case kImageRelBasedHighLow:
+        detail::AddRelocationDelta<std::uint32_t>(target, delta);
+        break;
+
+      case kImageRelBasedHighAdj:
+      {
+        // Rebuild the full value so the carry out of the low half can be
+        // calculated, then round.
+        std::uint16_t high;
+        std::memcpy(&high, target, sizeof(high));
+        std::uint32_t value =
+          (static_cast<std::uint32_t>(high) << 16) +
+          static_cast<std::uint32_t>(static_cast<std::int32_t>(
+            static_cast<std::int16_t>(high_adj_params_[high_adj_index++])));
+        value += static_cast<std::uint32_t>(delta) + 0x8000;
+        high = static_cast<std::uint16_t>(value >> 16);
+        std::memcpy(target, &high, sizeof(high));
+        break;
+      }
+
+      case kImageRelBasedDir64:
+        detail::AddRelocationDelta<std::uint64_t>(target, delta);
+        break;
+      }
+    }
+  }
+
+private:
+  void Decode(std::uint8_t const* dir, std::size_t size)
+  {
+    // Upper bound, trimmed once the padding has been dropped.
+    rvas_.resize(size / sizeof(std::uint16_t));
+    types_.resize(size / sizeof(std::uint16_t));
+
+    std::size_t count = 0;
+    std::size_t pos = 0;
+    while (pos + sizeof(ImageBaseRelocation) <= size)
+    {
+      ImageBaseRelocation block;
+      std::memcpy(&block, dir + pos, sizeof(block));
+      if (block.SizeOfBlock < sizeof(ImageBaseRelocation) ||
+          block.SizeOfBlock > size - pos ||
+          block.VirtualAddress > 0xFFFFFFFFUL - 0xFFF)
+      {
+        HADESMEM_DETAIL_THROW_EXCEPTION(
+          Error{} << ErrorString{"Invalid relocation block."});
+      }
+
+      std::size_t const num_entries =
+        (block.SizeOfBlock - sizeof(ImageBaseRelocation)) /
+        sizeof(std::uint16_t);
+      count = DecodeBlock(block.VirtualAddress,
+                          dir + pos + sizeof(ImageBaseRelocation),
+                          num_entries,
+                          count);
+
+      pos += block.SizeOfBlock;
+    }
+
+    rvas_.resize(count);
+    rvas_.shrink_to_fit();
+    types_.resize(count);
+    types_.shrink_to_fit();
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      types_seen_ |= 1U << types_[i];
+    }
+
+    std::uint32_t const supported =
+      (1U << kImageRelBasedHigh) | (1U << kImageRelBasedLow) |
+      (1U << kImageRelBasedHighLow) | (1U << kImageRelBasedHighAdj) |
+      (1U << kImageRelBasedDir64);
+    if (types_seen_ & ~supported)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Unsupported relocation type."});
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      end_ = (std::max)(end_,
+                        static_cast<std::uint64_t>(rvas_[i]) +
+                          detail::GetRelocationWidth(types_[i]));
+    }
+  }
+
+  std::size_t DecodeBlock(std::uint32_t block_rva,
+                          std::uint8_t const* entries,
+                          std::size_t num_entries,
+                          std::size_t count)
+  {
+    std::size_t i = 0;
+    while (i < num_entries)
+    {
+#if defined(HADESMEM_DETAIL_SSE2)
+      // Eight entries at a time, as long as none of them need special
+      // handling. Typically only the last chunk of a block (which contains the
+      // padding) falls back to the scalar path.
+      if (i + 8 <= num_entries)
+      {
+        __m128i const raw = _mm_loadu_si128(
+          reinterpret_cast<__m128i const*>(entries + i * 2));
+        __m128i const types = _mm_srli_epi16(raw, 12);
+        __m128i const special = _mm_or_si128(
+          _mm_cmpeq_epi16(types, _mm_setzero_si128()),
+          _mm_cmpeq_epi16(types, _mm_set1_epi16(kImageRelBasedHighAdj)));
+        if (!_mm_movemask_epi8(special))
+        {
+          __m128i const offsets =
+            _mm_and_si128(raw, _mm_set1_epi16(0x0FFF));
+          __m128i const block_rva_vec =
+            _mm_set1_epi32(static_cast<int>(block_rva));
+          _mm_storeu_si128(
+            reinterpret_cast<__m128i*>(&rvas_[count]),
+            _mm_add_epi32(_mm_unpacklo_epi16(offsets, _mm_setzero_si128()),
+                          block_rva_vec));
+          _mm_storeu_si128(
+            reinterpret_cast<__m128i*>(&rvas_[count + 4]),
+            _mm_add_epi32(_mm_unpackhi_epi16(offsets, _mm_setzero_si128()),
+                          block_rva_vec));
+          _mm_storel_epi64(reinterpret_cast<__m128i*>(&types_[count]),
+                           _mm_packus_epi16(types, types));
+          count += 8;
+          i += 8;
+          continue;
+        }
+      }
+#endif // #if defined(HADESMEM_DETAIL_SSE2)
+
+      std::uint16_t entry;
+      std::memcpy(&entry, entries + i * 2, sizeof(entry));
+      ++i;
+
+      auto const type = static_cast<std::uint8_t>(entry >> 12);
+      if (type == kImageRelBasedAbsolute)
+      {
+        continue;
+      }
+
+      if (type == kImageRelBasedHighAdj)
+      {
+        if (i == num_entries)
+        {
+          HADESMEM_DETAIL_THROW_EXCEPTION(
+            Error{} << ErrorString{"Truncated HIGHADJ relocation."});
+        }
+
+        std::uint16_t param;
+        std::memcpy(&param, entries + i * 2, sizeof(param));
+        high_adj_params_.push_back(param);
+        ++i;
+      }
+
+      rvas_[count] = block_rva + (entry & 0x0FFF);
+      types_[count] = type;
+      ++count;
+    }
+
+    return count;
+  }
+
+  std::vector<std::uint32_t> rvas_;
+  std::vector<std::uint8_t> types_;
+  std::vector<std::uint16_t> high_adj_params_;
+  std::uint32_t types_seen_{};
+  std::uint64_t end_{};
+};
+
+// One bit per byte of an image, set for every byte modified by a base
+// relocation. Used to skip (or mask out) relocated bytes when scanning or
+// comparing images which may have been loaded at different bases.
+class RelocationMask
+{
+public:
+  RelocationMask() noexcept
+  {
+  }
+
+  explicit RelocationMask(BaseRelocationTable const& relocs,
+                          std::size_t image_size)
+    : words_((image_size + 63) / 64), size_{image_size}
+  {
+    std::vector<std::uint32_t> const& rvas = relocs.GetRvas();
+    std::vector<std::uint8_t> const& types = relocs.GetTypes();
+    for (std::size_t i = 0; i < rvas.size(); ++i)
+    {
+      std::size_t const rva = rvas[i];
+      if (rva >= size_)
+      {
+        continue;
+      }
+
+      std::size_t const width = (std::min)(
+        static_cast<std::size_t>(detail::GetRelocationWidth(types[i])),
+        size_ - rva);
+      std::uint64_t const bits = (1ULL << width) - 1;
+      std::size_t const word = rva / 64;
+      std::size_t const shift = rva % 64;
+      words_[word] |= bits << shift;
+      if (shift + width > 64)
+      {
+        words_[word + 1] |= bits >> (64 - shift);
+      }
+    }
+  }
+
+  std::size_t GetSize() const noexcept
+  {
+    return size_;
+  }
+
+  std::vector<std::uint64_t> const& GetWords() const noexcept
+  {
+    return words_;
+  }
+
+  // Whether the byte at rva is relocated. False if it's outside the image.
+  bool Test(std::size_t rva) const noexcept
+  {
+    return rva < size_ && ((words_[rva / 64] >> (rva % 64)) & 1);
+  }
+
+  // Whether any byte in [rva, rva + len) is relocated. The range is clipped to
+  // the image.
+  bool TestRange(std::size_t rva, std::size_t len) const noexcept
+  {
+    if (rva >= size_ || !len)
+    {
+      return false;
+    }
+
+    std::size_t const end = rva + (std::min)(len, size_ - rva);
+    std::size_t const first_word = rva / 64;
+    std::size_t const last_word = (end - 1) / 64;
+    for (std::size_t word = first_word; word <= last_word; ++word)
+    {
+      std::uint64_t bits = words_[word];
+      if (word == first_word)
+      {
+        bits &= ~0ULL << (rva % 64);
+      }
+      if (word == last_word && end % 64)
+      {
+        bits &= ~0ULL >> (64 - end % 64);
+      }
+      if (bits)
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  // The 64 bits of the mask starting at rva (bit zero being rva itself), for
+  // combining with the result of a vector compare. Bits outside the image are
+  // clear.
+  std::uint64_t GetBits(std::size_t rva) const noexcept
+  {
+    if (rva >= size_)
+    {
+      return 0;
+    }
+
+    std::size_t const word = rva / 64;
+    std::size_t const shift = rva % 64;
+    std::uint64_t bits = words_[word] >> shift;
+    if (shift && word + 1 < words_.size())
+    {
+      bits |= words_[word + 1] << (64 - shift);
+    }
+
+    return bits;
+  }
+
+private:
+  std::vector<std::uint64_t> words_;
+  std::size_t size_{};
+};
+}
+}
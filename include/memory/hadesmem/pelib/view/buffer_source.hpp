@@ -0,0 +1,224 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/static_assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/view/pe_result.hpp>
+
+namespace hadesmem
+{
+namespace pelib
+{
+// Bounds-checked, read-only view of a contiguous buffer containing a PE file
+// (or image). This is the OS-independent replacement for the Process/Read pair
+// used by the Process based PeLib types. All offsets are relative to the start
+// of the buffer.
+//
+// The source optionally shares ownership of the underlying storage, so copies
+// of a source (and views built on it) keep the buffer alive. Non-owning sources
+// require the caller to ensure the buffer outlives them.
+//
+// Each Read function has a Try variant which returns a PeResult rather than
+// throwing, for the hot paths of corpus scans (where malformed files are the
+// norm rather than the exception).
+class BufferSource
+{
+public:
+  BufferSource() noexcept
+  {
+  }
+
+  explicit BufferSource(void const* data, std::size_t size) noexcept
+    : data_{static_cast<std::uint8_t const*>(data)}, size_{size}
+  {
+    HADESMEM_DETAIL_ASSERT(size ? data != nullptr : true);
+  }
+
+  explicit BufferSource(void const* data,
+                        std::size_t size,
+                        std::shared_ptr<void const> owner) noexcept
+    : data_{static_cast<std::uint8_t const*>(data)},
+      size_{size},
+      owner_{std::move(owner)}
+  {
+    HADESMEM_DETAIL_ASSERT(size ? data != nullptr : true);
+  }
+
+  // Takes ownership of the buffer (e.g. the result of PeFileToBuffer).
+  template <typename T> explicit BufferSource(std::vector<T>&& buf)
+  {
+    HADESMEM_DETAIL_STATIC_ASSERT(std::is_trivial<T>::value);
+
+    auto owner = std::make_shared<std::vector<T>>(std::move(buf));
+    data_ = reinterpret_cast<std::uint8_t const*>(owner->data());
+    size_ = owner->size() * sizeof(T);
+    owner_ = std::move(owner);
+  }
+
+  std::uint8_t const* GetData() const noexcept
+  {
+    return data_;
+  }
+
+  std::size_t GetSize() const noexcept
+  {
+    return size_;
+  }
+
+  bool IsEmpty() const noexcept
+  {
+    return size_ == 0;
+  }
+
+  bool Contains(std::size_t offset, std::size_t len) const noexcept
+  {
+    return offset <= size_ && len <= size_ - offset;
+  }
+
+  std::uint8_t const* GetPtr(std::size_t offset, std::size_t len) const
+  {
+    if (!Contains(offset, len))
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Read out of bounds."});
+    }
+
+    return data_ + offset;
+  }
+
+  template <typename T> PeResult<T> TryRead(std::size_t offset) const
+  {
+    HADESMEM_DETAIL_STATIC_ASSERT(std::is_trivial<T>::value);
+
+    if (!Contains(offset, sizeof(T)))
+    {
+      return PeError::kOutOfBounds;
+    }
+
+    // Always copy out, as nothing in a PE file is guaranteed to be aligned.
+    T data;
+    std::memcpy(std::addressof(data), data_ + offset, sizeof(T));
+    return data;
+  }
+
+  template <typename T> T Read(std::size_t offset) const
+  {
+    return TryRead<T>(offset).GetValueOrThrow();
+  }
+
+  // Reads as much of the object as lies within the buffer and zero-fills the
+  // remainder, similar to what the loader does when the headers are
+  // truncated by the end of the file. Returns the number of bytes read.
+  template <typename T> std::size_t ReadTruncated(std::size_t offset,
+                                                  T& data) const noexcept
+  {
+    HADESMEM_DETAIL_STATIC_ASSERT(std::is_trivial<T>::value);
+
+    std::memset(std::addressof(data), 0, sizeof(T));
+    if (offset >= size_)
+    {
+      return 0;
+    }
+
+    std::size_t const len = (std::min)(sizeof(T), size_ - offset);
+    std::memcpy(std::addressof(data), data_ + offset, len);
+    return len;
+  }
+
+  template <typename T>
+  PeResult<std::vector<T>> TryReadVector(std::size_t offset,
+                                         std::size_t count) const
+  {
+    HADESMEM_DETAIL_STATIC_ASSERT(std::is_trivial<T>::value);
+
+    if (count > size_ / sizeof(T) || !Contains(offset, count * sizeof(T)))
+    {
+      return PeError::kOutOfBounds;
+    }
+
+    std::vector<T> data(count);
+    if (count)
+    {
+      std::memcpy(data.data(), data_ + offset, count * sizeof(T));
+    }
+    return PeResult<std::vector<T>>{std::move(data)};
+  }
+
+  template <typename T>
+  std::vector<T> ReadVector(std::size_t offset, std::size_t count) const
+  {
+    return TryReadVector<T>(offset, count).GetValueOrThrow();
+  }
+
+  // Reads a null-terminated string. Strings terminated by the end of the
+  // buffer rather than a null are accepted, as the loader allows it.
+  // Sample: maxsecXP.exe (Corkami PE Corpus)
+  template <typename CharT>
+  PeResult<std::basic_string<CharT>> TryReadString(std::size_t offset) const
+  {
+    HADESMEM_DETAIL_STATIC_ASSERT(std::is_trivial<CharT>::value);
+
+    if (offset >= size_)
+    {
+      return PeError::kOutOfBounds;
+    }
+
+    std::size_t const max_len = (size_ - offset) / sizeof(CharT);
+    std::uint8_t const* const beg = data_ + offset;
+    std::size_t len = 0;
+    for (; len < max_len; ++len)
+    {
+      CharT c;
+      std::memcpy(&c, beg + len * sizeof(CharT), sizeof(CharT));
+      if (c == CharT())
+      {
+        break;
+      }
+    }
+
+    std::basic_string<CharT> str(len, CharT());
+    if (len)
+    {
+      std::memcpy(&str[0], beg, len * sizeof(CharT));
+    }
+    return PeResult<std::basic_string<CharT>>{std::move(str)};
+  }
+
+  template <typename CharT>
+  std::basic_string<CharT> ReadString(std::size_t offset) const
+  {
+    return TryReadString<CharT>(offset).GetValueOrThrow();
+  }
+
+  BufferSource SubSource(std::size_t offset, std::size_t len) const
+  {
+    if (!Contains(offset, len))
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Invalid sub-source."});
+    }
+
+    return BufferSource{data_ + offset, len, owner_};
+  }
+
+private:
+  std::uint8_t const* data_{};
+  std::size_t size_{};
+  std::shared_ptr<void const> owner_;
+};
+}
+}
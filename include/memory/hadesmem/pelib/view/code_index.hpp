@@ -0,0 +1,832 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <udis86.h>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/load_config_dir.hpp>
+#include <hadesmem/pelib/view/module_identity.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+#include <hadesmem/pelib/view/section_index.hpp>
+
+// TODO: Follow jump tables (indirect jumps through a table in .rdata), which
+// currently end the block without adding any of the targets.
+
+// TODO: Recognize calls to noreturn functions (e.g. ExitProcess,
+// __report_gsfailure), which currently fall through into whatever follows.
+
+namespace hadesmem
+{
+namespace pelib
+{
+struct CodeIndexFlags
+{
+  enum : std::uint32_t
+  {
+    kNone = 0,
+    // Function starts (and chained chunks) from the exception directory.
+    kSeedExceptionData = 1 << 0,
+    // Exported RVAs in executable sections (i.e. not forwarders or data).
+    kSeedExports = 1 << 1,
+    kSeedEntryPoint = 1 << 2,
+    // The CFG function table from the load config directory.
+    kSeedGuardCf = 1 << 3,
+    // Treat the targets of direct calls as functions too, and analyze them
+    // in turn.
+    kFollowCalls = 1 << 4,
+    kAll = (1 << 5) - 1,
+    kInvalidFlagMaxValue = 1 << 5
+  };
+};
+
+struct CodeIndexOptions
+{
+  // Bitmask of CodeIndexFlags.
+  std::uint32_t flags{CodeIndexFlags::kAll};
+  // Zero for one per hardware thread.
+  std::uint32_t num_threads{};
+};
+
+namespace detail
+{
+// Instructions decoded sequentially, from a block start up to (and
+// including) the instruction ending the block, or up to code which was
+// already decoded.
+struct CodeIndexRun
+{
+  std::uint32_t start;
+  std::uint32_t end;
+};
+
+// Everything found by the recursive descent from a single seed.
+struct CodeIndexTaskResult
+{
+  std::vector<CodeIndexRun> runs;
+  // Every run start, plus targets which had already been decoded (and so
+  // don't get a run of their own).
+  std::vector<std::uint32_t> leaders;
+  std::vector<std::uint32_t> call_targets;
+};
+
+inline bool IsCodeIndexConditionalBranch(enum ud_mnemonic_code mnemonic)
+{
+  switch (mnemonic)
+  {
+  case UD_Ijo:
+  case UD_Ijno:
+  case UD_Ijb:
+  case UD_Ijae:
+  case UD_Ijz:
+  case UD_Ijnz:
+  case UD_Ijbe:
+  case UD_Ija:
+  case UD_Ijs:
+  case UD_Ijns:
+  case UD_Ijp:
+  case UD_Ijnp:
+  case UD_Ijl:
+  case UD_Ijge:
+  case UD_Ijle:
+  case UD_Ijg:
+  case UD_Ijcxz:
+  case UD_Ijecxz:
+  case UD_Ijrcxz:
+  case UD_Iloop:
+  case UD_Iloope:
+  case UD_Iloopne:
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+// Instructions which execution never falls through (not counting JMP, which
+// is handled separately as it may have a known target).
+inline bool IsCodeIndexTerminator(enum ud_mnemonic_code mnemonic)
+{
+  switch (mnemonic)
+  {
+  case UD_Iret:
+  case UD_Iretf:
+  case UD_Iiretw:
+  case UD_Iiretd:
+  case UD_Iiretq:
+  case UD_Iint3:
+  case UD_Ihlt:
+  case UD_Iud2:
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+// Target of a relative branch, or false if the operand isn't an immediate
+// (i.e. the branch is indirect).
+inline bool GetCodeIndexBranchTarget(ud_t const& ud_obj, std::uint32_t& target)
+{
+  ud_operand_t const* const op = ud_insn_opr(&ud_obj, 0);
+  if (!op || op->type != UD_OP_JIMM)
+  {
+    return false;
+  }
+
+  std::int64_t rel = 0;
+  switch (op->size)
+  {
+  case sizeof(std::int8_t) * CHAR_BIT:
+    rel = op->lval.sbyte;
+    break;
+  case sizeof(std::int16_t) * CHAR_BIT:
+    rel = op->lval.sword;
+    break;
+  case sizeof(std::int32_t) * CHAR_BIT:
+    rel = op->lval.sdword;
+    break;
+  default:
+    return false;
+  }
+
+  // The PC is set to the RVA, so this is an RVA too (modulo wrapping, which
+  // is left for the section lookup to reject).
+  target = static_cast<std::uint32_t>(ud_insn_off(&ud_obj) +
+                                      ud_insn_len(&ud_obj) + rel);
+  return true;
+}
+
+// Recursive descent from one seed at a time. Each worker has its own
+// decoder, and nothing is shared between seeds except the (read only) view
+// and set of known functions, so seeds can be analyzed in any order and on
+// any thread with the same result.
+class CodeIndexAnalyzer
+{
+public:
+  explicit CodeIndexAnalyzer(PeView const& view,
+                             std::vector<std::uint32_t> const& functions)
+    : view_{&view}, functions_{&functions}
+  {
+    ud_init(&ud_obj_);
+    ud_set_mode(&ud_obj_, view.Is64() ? 64 : 32);
+    // Only the decoded instructions are needed, not the text.
+    ud_set_syntax(&ud_obj_, nullptr);
+  }
+
+  CodeIndexTaskResult Analyze(std::uint32_t seed)
+  {
+    CodeIndexTaskResult result;
+    visited_.clear();
+    worklist_.assign(1, seed);
+    result.leaders.push_back(seed);
+
+    while (!worklist_.empty())
+    {
+      std::uint32_t const start = worklist_.back();
+      worklist_.pop_back();
+      if (visited_.count(start))
+      {
+        continue;
+      }
+
+      std::uint32_t const end = DecodeRun(seed, start, result);
+      if (end != start)
+      {
+        CodeIndexRun const run{start, end};
+        result.runs.push_back(run);
+      }
+    }
+
+    return result;
+  }
+
+private:
+  // Bytes of the executable section containing the RVA, from the RVA up to
+  // the end of the section (or of the data actually present).
+  std::uint8_t const* GetCode(std::uint32_t rva, std::size_t& size) const
+  {
+    SectionIndex const& index = view_->GetSectionIndex();
+    std::uint32_t const section = index.FindRva(rva);
+    if (section == SectionIndex::kInvalidIndex)
+    {
+      return nullptr;
+    }
+
+    SectionIndexEntry const& entry = index.GetEntry(section);
+    if (!(entry.characteristics & (kImageScnCntCode | kImageScnMemExecute)))
+    {
+      return nullptr;
+    }
+
+    bool virtual_va = false;
+    std::uint8_t const* const code = view_->RvaToPtr(rva, &virtual_va);
+    if (!code || virtual_va)
+    {
+      return nullptr;
+    }
+
+    std::uint8_t const* const end =
+      view_->GetSource().GetData() + view_->GetSize();
+    size = (std::min)(static_cast<std::size_t>(end - code),
+                      static_cast<std::size_t>(entry.GetVirtualEnd() - rva));
+    if (view_->GetType() == PeFileType::kData)
+    {
+      std::uint32_t const section_offset = rva - entry.virtual_address;
+      size = section_offset < entry.size_of_raw_data
+               ? (std::min)(size,
+                            static_cast<std::size_t>(entry.size_of_raw_data -
+                                                     section_offset))
+               : 0;
+    }
+
+    return size ? code : nullptr;
+  }
+
+  // Returns the end of the run.
+  std::uint32_t DecodeRun(std::uint32_t seed,
+                          std::uint32_t start,
+                          CodeIndexTaskResult& result)
+  {
+    std::size_t size = 0;
+    std::uint8_t const* const code = GetCode(start, size);
+    if (!code)
+    {
+      return start;
+    }
+
+    ud_set_input_buffer(&ud_obj_, code, size);
+    ud_set_pc(&ud_obj_, start);
+
+    std::uint32_t pos = start;
+    for (;;)
+    {
+      if (pos != start && visited_.count(pos))
+      {
+        return pos;
+      }
+
+      std::uint32_t const len = ud_disassemble(&ud_obj_);
+      if (!len || ud_obj_.mnemonic == UD_Iinvalid)
+      {
+        return pos;
+      }
+
+      visited_.insert(pos);
+      pos += len;
+
+      enum ud_mnemonic_code const mnemonic = ud_obj_.mnemonic;
+      std::uint32_t target = 0;
+      if (IsCodeIndexTerminator(mnemonic))
+      {
+        return pos;
+      }
+      else if (mnemonic == UD_Ijmp)
+      {
+        // Jumps to another function are tail calls, not part of this one.
+        if (GetCodeIndexBranchTarget(ud_obj_, target) &&
+            (target == seed || !IsKnownFunction(target)))
+        {
+          AddTarget(target, result);
+        }
+        return pos;
+      }
+      else if (IsCodeIndexConditionalBranch(mnemonic))
+      {
+        if (GetCodeIndexBranchTarget(ud_obj_, target))
+        {
+          AddTarget(target, result);
+        }
+        AddTarget(pos, result);
+        return pos;
+      }
+      else if (mnemonic == UD_Icall &&
+               GetCodeIndexBranchTarget(ud_obj_, target))
+      {
+        result.call_targets.push_back(target);
+      }
+    }
+  }
+
+  void AddTarget(std::uint32_t target, CodeIndexTaskResult& result)
+  {
+    result.leaders.push_back(target);
+    worklist_.push_back(target);
+  }
+
+  bool IsKnownFunction(std::uint32_t rva) const
+  {
+    return std::binary_search(
+      std::begin(*functions_), std::end(*functions_), rva);
+  }
+
+  PeView const* view_;
+  std::vector<std::uint32_t> const* functions_;
+  ud_t ud_obj_;
+  std::unordered_set<std::uint32_t> visited_;
+  std::vector<std::uint32_t> worklist_;
+};
+
+inline void SortUnique(std::vector<std::uint32_t>& v)
+{
+  std::sort(std::begin(v), std::end(v));
+  v.erase(std::unique(std::begin(v), std::end(v)), std::end(v));
+}
+
+// Analyzes each seed, spreading them across the given number of threads in
+// small batches (as the cost per seed varies wildly). The results are in the
+// same order as the seeds, whatever the number of threads.
+inline std::vector<CodeIndexTaskResult>
+  AnalyzeCodeIndexSeeds(PeView const& view,
+                        std::vector<std::uint32_t> const& functions,
+                        std::vector<std::uint32_t> const& seeds,
+                        std::uint32_t num_threads)
+{
+  std::vector<CodeIndexTaskResult> results(seeds.size());
+  std::size_t const kBatchSize = 64;
+  std::size_t const num_batches = (seeds.size() + kBatchSize - 1) / kBatchSize;
+  std::atomic<std::size_t> next_batch{0};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  auto const worker = [&]() {
+    try
+    {
+      CodeIndexAnalyzer analyzer{view, functions};
+      for (std::size_t batch = next_batch++; batch < num_batches;
+           batch = next_batch++)
+      {
+        std::size_t const end =
+          (std::min)((batch + 1) * kBatchSize, seeds.size());
+        for (std::size_t i = batch * kBatchSize; i < end; ++i)
+        {
+          results[i] = analyzer.Analyze(seeds[i]);
+        }
+      }
+    }
+    catch (...)
+    {
+      // Stop the other workers early, and report the first error.
+      next_batch = num_batches;
+      std::lock_guard<std::mutex> lock{error_mutex};
+      if (!error)
+      {
+        error = std::current_exception();
+      }
+    }
+  };
+
+  std::size_t const num_workers =
+    (std::min)(static_cast<std::size_t>(num_threads), num_batches);
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < num_workers; ++i)
+  {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  if (error)
+  {
+    std::rethrow_exception(error);
+  }
+
+  return results;
+}
+}
+
+// Function and basic block boundaries of the code in a module, found by
+// recursive descent disassembly from the functions already known from the
+// headers (the exception directory, exports, entry point and CFG function
+// table), and then from the targets of any calls found along the way.
+//
+// Everything is stored as sorted arrays of RVAs, so lookups are a binary
+// search, and the index costs 16 bytes per function and block.
+//
+// A basic block starts at a function start or branch target, or after a
+// conditional branch, and ends before the next block starts or after a
+// branch, return, or other instruction which never falls through. The end of
+// a function is the end of the furthest block reached from it before the
+// next function starts, so cold code moved elsewhere (e.g. by PGO) isn't
+// counted. Code is only looked for in executable sections, and indirect
+// branches are not followed.
+//
+// Seeds are analyzed in parallel, with the same result however many threads
+// are used.
+class CodeIndex
+{
+public:
+  static std::uint32_t const kInvalidIndex = static_cast<std::uint32_t>(-1);
+
+  CodeIndex() noexcept
+  {
+  }
+
+  explicit CodeIndex(PeView const& view,
+                     CodeIndexOptions const& options = CodeIndexOptions{})
+  {
+    std::uint32_t num_threads = options.num_threads;
+    if (!num_threads)
+    {
+      num_threads = (std::max)(std::thread::hardware_concurrency(), 1U);
+    }
+
+    std::vector<std::uint32_t> functions;
+    std::vector<std::uint32_t> chunks;
+    GetSeeds(view, options.flags, functions, chunks);
+
+    // Each round analyzes the functions found in the last one (starting
+    // with the seeds), so no function is analyzed twice.
+    std::vector<detail::CodeIndexTaskResult> results;
+    // Start of each function, and the index of its result.
+    std::vector<std::pair<std::uint32_t, std::size_t>> function_results;
+    std::vector<std::uint32_t> pending = functions;
+    pending.insert(std::end(pending), std::begin(chunks), std::end(chunks));
+    detail::SortUnique(pending);
+    while (!pending.empty())
+    {
+      auto round_results = detail::AnalyzeCodeIndexSeeds(
+        view, functions, pending, num_threads);
+
+      std::vector<std::uint32_t> new_functions;
+      if (options.flags & CodeIndexFlags::kFollowCalls)
+      {
+        for (auto const& result : round_results)
+        {
+          for (std::uint32_t const target : result.call_targets)
+          {
+            if (!std::binary_search(
+                  std::begin(functions), std::end(functions), target))
+            {
+              new_functions.push_back(target);
+            }
+          }
+        }
+        detail::SortUnique(new_functions);
+      }
+
+      for (std::size_t i = 0; i < pending.size(); ++i)
+      {
+        if (std::binary_search(
+              std::begin(functions), std::end(functions), pending[i]))
+        {
+          function_results.emplace_back(pending[i], results.size());
+        }
+        results.push_back(std::move(round_results[i]));
+      }
+
+      functions.insert(std::end(functions),
+                       std::begin(new_functions),
+                       std::end(new_functions));
+      std::sort(std::begin(functions), std::end(functions));
+      pending = std::move(new_functions);
+    }
+
+    BuildBlocks(results);
+    BuildFunctions(results, function_results);
+  }
+
+  // Sorted function start RVAs. Only functions with at least one decodable
+  // instruction are included.
+  std::vector<std::uint32_t> const& GetFunctions() const noexcept
+  {
+    return functions_;
+  }
+
+  // End RVA of each function (see above), in the same order.
+  std::vector<std::uint32_t> const& GetFunctionEnds() const noexcept
+  {
+    return function_ends_;
+  }
+
+  // Sorted block start RVAs.
+  std::vector<std::uint32_t> const& GetBlocks() const noexcept
+  {
+    return blocks_;
+  }
+
+  // End RVA of each block, in the same order.
+  std::vector<std::uint32_t> const& GetBlockEnds() const noexcept
+  {
+    return block_ends_;
+  }
+
+  bool IsFunctionStart(std::uint32_t rva) const noexcept
+  {
+    return std::binary_search(
+      std::begin(functions_), std::end(functions_), rva);
+  }
+
+  // Index of the function whose body contains the RVA, or kInvalidIndex.
+  // Where functions overlap the closest start wins.
+  std::uint32_t FindFunction(std::uint32_t rva) const noexcept
+  {
+    return Find(functions_, function_ends_, rva);
+  }
+
+  // Index of the block containing the RVA, or kInvalidIndex.
+  std::uint32_t FindBlock(std::uint32_t rva) const noexcept
+  {
+    return Find(blocks_, block_ends_, rva);
+  }
+
+  // Number of bytes from the RVA to the end of its block, i.e. how much can
+  // be overwritten (e.g. by a hook) without running into code which may be
+  // jumped to from elsewhere, or off the end of the function. Zero if the
+  // RVA isn't in a block.
+  std::uint32_t GetSafePatchSize(std::uint32_t rva) const noexcept
+  {
+    std::uint32_t const index = FindBlock(rva);
+    return index == kInvalidIndex ? 0 : block_ends_[index] - rva;
+  }
+
+private:
+  static std::uint32_t Find(std::vector<std::uint32_t> const& starts,
+                            std::vector<std::uint32_t> const& ends,
+                            std::uint32_t rva) noexcept
+  {
+    auto const iter =
+      std::upper_bound(std::begin(starts), std::end(starts), rva);
+    if (iter == std::begin(starts))
+    {
+      return kInvalidIndex;
+    }
+
+    std::size_t const index = (iter - std::begin(starts)) - 1;
+    return rva < ends[index] ? static_cast<std::uint32_t>(index)
+                             : kInvalidIndex;
+  }
+
+  static void GetSeeds(PeView const& view,
+                       std::uint32_t flags,
+                       std::vector<std::uint32_t>& functions,
+                       std::vector<std::uint32_t>& chunks)
+  {
+    if ((flags & CodeIndexFlags::kSeedExceptionData) && view.Is64())
+    {
+      GetExceptionDataSeeds(view, functions, chunks);
+    }
+
+    if (flags & CodeIndexFlags::kSeedExports)
+    {
+      GetExportSeeds(view, functions);
+    }
+
+    if ((flags & CodeIndexFlags::kSeedEntryPoint) &&
+        view.GetAddressOfEntryPoint())
+    {
+      functions.push_back(view.GetAddressOfEntryPoint());
+    }
+
+    if (flags & CodeIndexFlags::kSeedGuardCf)
+    {
+      // The directory is only a hint here, so a malformed one is ignored
+      // rather than failing the whole analysis.
+      try
+      {
+        LoadConfigDir const load_config{view};
+        auto const& cf_functions = load_config.GetGuardCFFunctions();
+        functions.insert(std::end(functions),
+                         std::begin(cf_functions),
+                         std::end(cf_functions));
+      }
+      catch (Error const&)
+      {
+      }
+    }
+
+    detail::SortUnique(functions);
+    detail::SortUnique(chunks);
+  }
+
+  // Chained entries describe a chunk of another function (e.g. cold code),
+  // so they only seed blocks.
+  static void GetExceptionDataSeeds(PeView const& view,
+                                    std::vector<std::uint32_t>& functions,
+                                    std::vector<std::uint32_t>& chunks)
+  {
+    ImageDataDirectory const dir = view.GetDataDir(PeDataDir::Exception);
+    if (!dir.VirtualAddress || !dir.Size)
+    {
+      return;
+    }
+
+    auto const entries = view.TryReadVectorRva<ImageRuntimeFunctionEntry>(
+      dir.VirtualAddress, dir.Size / sizeof(ImageRuntimeFunctionEntry));
+    if (!entries)
+    {
+      return;
+    }
+
+    for (auto const& entry : *entries)
+    {
+      if (!entry.BeginAddress)
+      {
+        continue;
+      }
+
+      bool chained = false;
+      if (!(entry.UnwindInfoAddress & kRuntimeFunctionIndirect))
+      {
+        auto const unwind_info =
+          view.TryReadRva<ImageUnwindInfoHeader>(entry.UnwindInfoAddress);
+        chained = unwind_info &&
+                  ((unwind_info->VersionAndFlags >> 3) & kUnwFlagChainInfo);
+      }
+
+      (chained ? chunks : functions).push_back(entry.BeginAddress);
+    }
+  }
+
+  static void GetExportSeeds(PeView const& view,
+                             std::vector<std::uint32_t>& functions)
+  {
+    ImageDataDirectory const dir = view.GetDataDir(PeDataDir::Export);
+    if (!dir.VirtualAddress || !dir.Size)
+    {
+      return;
+    }
+
+    auto const export_dir =
+      view.TryReadRva<ImageExportDirectory>(dir.VirtualAddress);
+    if (!export_dir)
+    {
+      return;
+    }
+
+    auto const rvas = view.TryReadVectorRva<std::uint32_t>(
+      export_dir->AddressOfFunctions, export_dir->NumberOfFunctions);
+    if (!rvas)
+    {
+      return;
+    }
+
+    for (std::uint32_t const rva : *rvas)
+    {
+      // Forwarders point into the export directory. Data exports are
+      // dropped later, along with anything else not in executable sections.
+      bool const forwarded =
+        rva >= dir.VirtualAddress && rva - dir.VirtualAddress < dir.Size;
+      if (rva && !forwarded)
+      {
+        functions.push_back(rva);
+      }
+    }
+  }
+
+  // Each leader starts a block if it is covered by a run, ending at the
+  // next leader or the end of the covered range, whichever is first.
+  void BuildBlocks(std::vector<detail::CodeIndexTaskResult> const& results)
+  {
+    std::vector<detail::CodeIndexRun> runs;
+    std::vector<std::uint32_t> leaders;
+    for (auto const& result : results)
+    {
+      runs.insert(
+        std::end(runs), std::begin(result.runs), std::end(result.runs));
+      leaders.insert(std::end(leaders),
+                     std::begin(result.leaders),
+                     std::end(result.leaders));
+    }
+
+    std::sort(std::begin(runs),
+              std::end(runs),
+              [](detail::CodeIndexRun const& lhs,
+                 detail::CodeIndexRun const& rhs) {
+                return lhs.start < rhs.start;
+              });
+    std::vector<detail::CodeIndexRun> covered;
+    for (auto const& run : runs)
+    {
+      if (!covered.empty() && run.start <= covered.back().end)
+      {
+        covered.back().end = (std::max)(covered.back().end, run.end);
+      }
+      else
+      {
+        covered.push_back(run);
+      }
+    }
+
+    detail::SortUnique(leaders);
+    auto range = std::begin(covered);
+    for (std::size_t i = 0; i < leaders.size(); ++i)
+    {
+      std::uint32_t const leader = leaders[i];
+      while (range != std::end(covered) && range->end <= leader)
+      {
+        ++range;
+      }
+      if (range == std::end(covered) || leader < range->start)
+      {
+        continue;
+      }
+
+      std::uint32_t end = range->end;
+      if (i + 1 < leaders.size())
+      {
+        end = (std::min)(end, leaders[i + 1]);
+      }
+      blocks_.push_back(leader);
+      block_ends_.push_back(end);
+    }
+  }
+
+  void BuildFunctions(
+    std::vector<detail::CodeIndexTaskResult> const& results,
+    std::vector<std::pair<std::uint32_t, std::size_t>>& function_results)
+  {
+    std::sort(std::begin(function_results), std::end(function_results));
+    for (std::size_t i = 0; i < function_results.size(); ++i)
+    {
+      std::uint32_t const start = function_results[i].first;
+      auto const& runs = results[function_results[i].second].runs;
+      if (runs.empty() || runs.front().start != start)
+      {
+        continue;
+      }
+
+      std::uint32_t const next = i + 1 < function_results.size()
+                                   ? function_results[i + 1].first
+                                   : 0xFFFFFFFF;
+      std::uint32_t end = runs.front().end;
+      for (auto const& run : runs)
+      {
+        if (run.start >= start && run.start < next)
+        {
+          end = (std::max)(end, run.end);
+        }
+      }
+
+      functions_.push_back(start);
+      function_ends_.push_back(end);
+    }
+  }
+
+  std::vector<std::uint32_t> functions_;
+  std::vector<std::uint32_t> function_ends_;
+  std::vector<std::uint32_t> blocks_;
+  std::vector<std::uint32_t> block_ends_;
+};
+
+// Caches the code index of each module used, so hooking or generating
+// signatures for many functions in a module only analyzes it once.
+//
+// Modules are cached by identity (see GetModuleIdentity), so the index of a
+// module built from the file on disk can be reused for any loaded copy of it
+// (the index only holds RVAs).
+class CodeIndexCache
+{
+public:
+  explicit CodeIndexCache(CodeIndexOptions const& options = CodeIndexOptions{})
+    : options_(options)
+  {
+  }
+
+  std::shared_ptr<CodeIndex const> GetIndex(PeView const& view)
+  {
+    ModuleIdentity const identity = GetModuleIdentity(view);
+    auto iter = indexes_.find(identity);
+    if (iter == std::end(indexes_))
+    {
+      iter = indexes_.emplace(identity,
+                              std::make_shared<CodeIndex const>(
+                                view, options_)).first;
+    }
+
+    return iter->second;
+  }
+
+  void Clear() noexcept
+  {
+    indexes_.clear();
+  }
+
+private:
+  CodeIndexOptions options_;
+  std::map<ModuleIdentity, std::shared_ptr<CodeIndex const>> indexes_;
+};
+}
+}
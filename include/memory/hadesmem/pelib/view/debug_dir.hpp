@@ -0,0 +1,254 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+
+namespace hadesmem
+{
+namespace pelib
+{
+// Function (or data) contribution recorded by the linker for LTCG/PGO builds.
+struct DebugDirPogoEntry
+{
+  std::uint32_t rva;
+  std::uint32_t size;
+  std::string name;
+};
+
+// Debug directory of a file or image, along with the contents of the entries
+// which identify the build: the CodeView (RSDS) record naming the PDB, the
+// POGO section contributions and the repro hash of deterministic builds.
+//
+// The loader never looks at the debug directory, so nothing here is treated
+// as an error. Entries which don't fit in the buffer are dropped, and entry
+// data which can't be located (or is malformed) is ignored.
+class DebugDir
+{
+public:
+  DebugDir() noexcept
+  {
+  }
+
+  explicit DebugDir(PeView const& view)
+  {
+    ImageDataDirectory const dir = view.GetDataDir(PeDataDir::Debug);
+    if (!dir.VirtualAddress || dir.Size < sizeof(ImageDebugDirectory))
+    {
+      return;
+    }
+
+    std::size_t const offset = view.RvaToOffset(dir.VirtualAddress);
+    if (offset == PeView::kInvalidOffset || offset >= view.GetSize())
+    {
+      return;
+    }
+
+    std::size_t const count =
+      (std::min)(static_cast<std::size_t>(dir.Size),
+                 view.GetSize() - offset) /
+      sizeof(ImageDebugDirectory);
+    entries_ = view.GetSource().ReadVector<ImageDebugDirectory>(offset, count);
+
+    for (auto const& entry : entries_)
+    {
+      std::uint8_t const* const data = GetEntryData(view, entry);
+      if (!data)
+      {
+        continue;
+      }
+
+      switch (entry.Type)
+      {
+      case kImageDebugTypeCodeView:
+        if (!has_pdb_info_)
+        {
+          ParseCodeView(data, entry.SizeOfData);
+        }
+        break;
+
+      case kImageDebugTypePogo:
+        ParsePogo(data, entry.SizeOfData);
+        break;
+
+      case kImageDebugTypeRepro:
+        ParseRepro(data, entry.SizeOfData);
+        break;
+      }
+    }
+  }
+
+  std::vector<ImageDebugDirectory> const& GetEntries() const noexcept
+  {
+    return entries_;
+  }
+
+  // Whether there is an RSDS CodeView record (i.e. a PDB 7.0 reference).
+  bool HasPdbInfo() const noexcept
+  {
+    return has_pdb_info_;
+  }
+
+  // GUID of the PDB, in its in-memory (little-endian) layout.
+  std::array<std::uint8_t, 16> const& GetPdbGuid() const noexcept
+  {
+    return pdb_guid_;
+  }
+
+  std::uint32_t GetPdbAge() const noexcept
+  {
+    return pdb_age_;
+  }
+
+  // Path of the PDB as written by the linker (UTF-8).
+  std::string const& GetPdbPath() const noexcept
+  {
+    return pdb_path_;
+  }
+
+  // In the order written by the linker, which is by RVA.
+  std::vector<DebugDirPogoEntry> const& GetPogoEntries() const noexcept
+  {
+    return pogo_entries_;
+  }
+
+  // Empty for images built without /Brepro, and for older deterministic
+  // builds which only put the hash in the TimeDateStamp fields.
+  std::vector<std::uint8_t> const& GetReproHash() const noexcept
+  {
+    return repro_hash_;
+  }
+
+private:
+  // The data is normally mapped (AddressOfRawData), but older linkers and
+  // some post-processing tools leave it outside the image, in which case it
+  // can only be found in the file.
+  static std::uint8_t const* GetEntryData(PeView const& view,
+                                          ImageDebugDirectory const& entry)
+  {
+    if (!entry.SizeOfData)
+    {
+      return nullptr;
+    }
+
+    std::uint8_t const* const end = view.GetSource().GetData() + view.GetSize();
+    if (entry.AddressOfRawData)
+    {
+      std::uint8_t const* const data = view.RvaToPtr(entry.AddressOfRawData);
+      if (data && static_cast<std::size_t>(end - data) >= entry.SizeOfData)
+      {
+        return data;
+      }
+    }
+
+    if (view.GetType() == PeFileType::kData && entry.PointerToRawData &&
+        view.GetSource().Contains(entry.PointerToRawData, entry.SizeOfData))
+    {
+      return view.GetSource().GetData() + entry.PointerToRawData;
+    }
+
+    return nullptr;
+  }
+
+  void ParseCodeView(std::uint8_t const* data, std::size_t size)
+  {
+    CvInfoPdb70 cv_info;
+    if (size < sizeof(cv_info))
+    {
+      return;
+    }
+
+    std::memcpy(&cv_info, data, sizeof(cv_info));
+    if (cv_info.CvSignature != kCodeViewSignatureRsds)
+    {
+      return;
+    }
+
+    has_pdb_info_ = true;
+    std::memcpy(pdb_guid_.data(), cv_info.Signature, pdb_guid_.size());
+    pdb_age_ = cv_info.Age;
+
+    char const* const path =
+      reinterpret_cast<char const*>(data) + sizeof(cv_info);
+    std::size_t const max_len = size - sizeof(cv_info);
+    std::size_t len = 0;
+    while (len < max_len && path[len])
+    {
+      ++len;
+    }
+    pdb_path_.assign(path, len);
+  }
+
+  // A signature (e.g. 'LTCG' or 'PGU') followed by a sequence of RVA, size
+  // and null-terminated name, each padded to a multiple of four bytes.
+  void ParsePogo(std::uint8_t const* data, std::size_t size)
+  {
+    std::size_t pos = sizeof(std::uint32_t);
+    while (pos < size && size - pos > 2 * sizeof(std::uint32_t))
+    {
+      DebugDirPogoEntry entry;
+      std::memcpy(&entry.rva, data + pos, sizeof(entry.rva));
+      std::memcpy(&entry.size,
+                  data + pos + sizeof(std::uint32_t),
+                  sizeof(entry.size));
+      pos += 2 * sizeof(std::uint32_t);
+
+      char const* const name = reinterpret_cast<char const*>(data) + pos;
+      std::size_t len = 0;
+      while (pos + len < size && name[len])
+      {
+        ++len;
+      }
+      if (pos + len == size)
+      {
+        // Unterminated name, so the data is truncated.
+        return;
+      }
+      entry.name.assign(name, len);
+      pogo_entries_.push_back(std::move(entry));
+
+      pos += (len + 1 + 3) & ~static_cast<std::size_t>(3);
+    }
+  }
+
+  // The length of the hash followed by the hash itself.
+  void ParseRepro(std::uint8_t const* data, std::size_t size)
+  {
+    std::uint32_t len;
+    if (size < sizeof(len))
+    {
+      return;
+    }
+
+    std::memcpy(&len, data, sizeof(len));
+    if (len > size - sizeof(len))
+    {
+      return;
+    }
+
+    repro_hash_.assign(data + sizeof(len), data + sizeof(len) + len);
+  }
+
+  std::vector<ImageDebugDirectory> entries_;
+  bool has_pdb_info_{};
+  std::array<std::uint8_t, 16> pdb_guid_{};
+  std::uint32_t pdb_age_{};
+  std::string pdb_path_;
+  std::vector<DebugDirPogoEntry> pogo_entries_;
+  std::vector<std::uint8_t> repro_hash_;
+};
+}
+}
@@ -0,0 +1,120 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/pelib/view/base_relocation_table.hpp>
+
+#if defined(HADESMEM_DETAIL_SSE2)
+#include <emmintrin.h>
+#endif // #if defined(HADESMEM_DETAIL_SSE2)
+
+namespace hadesmem
+{
+namespace pelib
+{
+namespace detail
+{
+// Returns the index of the first byte at or after pos which differs between
+// lhs and rhs and isn't covered by a relocation, or size if there is none.
+inline std::size_t FindImageMismatch(std::uint8_t const* lhs,
+                                     std::uint8_t const* rhs,
+                                     std::size_t pos,
+                                     std::size_t size,
+                                     RelocationMask const& relocs) noexcept
+{
+#if defined(HADESMEM_DETAIL_SSE2)
+  for (; pos + 16 <= size; pos += 16)
+  {
+    __m128i const l =
+      _mm_loadu_si128(reinterpret_cast<__m128i const*>(lhs + pos));
+    __m128i const r =
+      _mm_loadu_si128(reinterpret_cast<__m128i const*>(rhs + pos));
+    auto const same =
+      static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(l, r))) |
+      static_cast<std::uint32_t>(relocs.GetBits(pos) & 0xFFFF);
+    if (same != 0xFFFF)
+    {
+      break;
+    }
+  }
+#endif // #if defined(HADESMEM_DETAIL_SSE2)
+
+  while (pos < size && (lhs[pos] == rhs[pos] || relocs.Test(pos)))
+  {
+    ++pos;
+  }
+
+  return pos;
+}
+}
+
+// Run of bytes which differ between two images.
+struct ImageDiffRun
+{
+  std::size_t rva;
+  std::size_t len;
+};
+
+// Calls func(ImageDiffRun const&) for each run of bytes which differ between
+// two images of the same module (e.g. a module in memory and the same file
+// mapped by MapImage at the module's base, or the same module in two
+// processes), in RVA order. Bytes covered by a relocation in relocs are
+// treated as equal, so images loaded at different bases can be compared.
+// Differing bytes separated by merge_gap or fewer equal bytes are reported as
+// one run.
+template <typename Func>
+inline void ForEachImageDiff(void const* lhs,
+                             void const* rhs,
+                             std::size_t size,
+                             RelocationMask const& relocs,
+                             Func func,
+                             std::size_t merge_gap = 0)
+{
+  auto const l_data = static_cast<std::uint8_t const*>(lhs);
+  auto const r_data = static_cast<std::uint8_t const*>(rhs);
+  std::size_t pos = 0;
+  for (;;)
+  {
+    pos = detail::FindImageMismatch(l_data, r_data, pos, size, relocs);
+    if (pos == size)
+    {
+      break;
+    }
+
+    std::size_t last = pos;
+    for (std::size_t i = pos + 1; i < size && i - last <= merge_gap + 1; ++i)
+    {
+      if (l_data[i] != r_data[i] && !relocs.Test(i))
+      {
+        last = i;
+      }
+    }
+
+    func(ImageDiffRun{pos, last + 1 - pos});
+    pos = last + 1;
+  }
+}
+
+inline std::vector<ImageDiffRun> DiffImages(void const* lhs,
+                                            void const* rhs,
+                                            std::size_t size,
+                                            RelocationMask const& relocs,
+                                            std::size_t merge_gap = 0)
+{
+  std::vector<ImageDiffRun> runs;
+  ForEachImageDiff(lhs,
+                   rhs,
+                   size,
+                   relocs,
+                   [&](ImageDiffRun const& run) { runs.push_back(run); },
+                   merge_gap);
+  return runs;
+}
+}
+}
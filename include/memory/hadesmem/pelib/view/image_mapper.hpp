@@ -0,0 +1,195 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/base_relocation_table.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+
+// TODO: Handle the loader differences between XP, 7, 8, etc. (e.g. rounding
+// of the raw size of a section, and which malformed files are rejected).
+
+namespace hadesmem
+{
+namespace pelib
+{
+namespace detail
+{
+// Far larger than any real image. Bounds the allocation for malformed files
+// with a huge SizeOfImage.
+std::uint32_t const kMaxMappedImageSize = 0x40000000;
+
+inline std::uint64_t AlignUp(std::uint64_t n, std::uint32_t alignment)
+{
+  return alignment ? (n + alignment - 1) / alignment * alignment : n;
+}
+}
+
+// Maps a file into image layout (headers at zero, each section at its RVA,
+// zero fill everywhere else) and applies base relocations for the given base,
+// the same as the loader would, but into a buffer and without any OS
+// involvement. ImageBase in the mapped headers is updated to the new base.
+//
+// The result can be wrapped in a PeView of type PeFileType::kImage, where RVA
+// lookups are a simple bounds check rather than a section table search:
+//
+//   PeView const image{BufferSource{MapImage(file, base)},
+//                      PeFileType::kImage};
+//
+// Sections are mapped using the same rules PeView uses for RVA lookups in data
+// files, so both layouts give the same bytes for any RVA backed by the file.
+// Where sections overlap, the first one in the section table wins, again to
+// match the RVA lookups.
+//
+// If the view is already an image it is copied and rebased (the current base
+// being the ImageBase in its headers, which is what the loader leaves there).
+//
+// Throws if the image needs relocating but the relocations have been stripped,
+// or if the relocations are invalid (a bad block size, an unsupported type or
+// a target outside the image). The loader refuses to load such images too.
+inline std::vector<std::uint8_t> MapImage(PeView const& view,
+                                          std::uint64_t base)
+{
+  std::uint64_t const image_size =
+    detail::AlignUp(view.GetSizeOfImage(), view.GetSectionAlignment());
+  if (!image_size || image_size > detail::kMaxMappedImageSize)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                    << ErrorString{"Invalid SizeOfImage."});
+  }
+
+  if (!view.Is64() && base > 0xFFFFFFFFULL)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(Error{} << ErrorString{"Invalid base."});
+  }
+
+  std::vector<std::uint8_t> image(static_cast<std::size_t>(image_size));
+  std::uint8_t const* const file = view.GetSource().GetData();
+  std::size_t const file_size = view.GetSize();
+
+  auto const map_range =
+    [&](std::uint64_t rva, std::uint64_t offset, std::uint64_t len) {
+      if (rva >= image.size() || offset >= file_size)
+      {
+        return;
+      }
+
+      len = (std::min)(len, static_cast<std::uint64_t>(image.size() - rva));
+      len = (std::min)(len, static_cast<std::uint64_t>(file_size - offset));
+      std::memcpy(&image[static_cast<std::size_t>(rva)],
+                  file + offset,
+                  static_cast<std::size_t>(len));
+    };
+
+  std::vector<ImageSectionHeader> const& sections = view.GetSections();
+  if (view.GetType() == PeFileType::kImage ||
+      view.HasVirtualSectionTable() || !view.GetNumberOfSections())
+  {
+    // RVAs are used as file offsets in all of these cases.
+    map_range(0, 0, file_size);
+  }
+  else
+  {
+    // Always map the whole section table, even if SizeOfHeaders is too small
+    // to cover it, so the result can be parsed. The loader maps at least a
+    // page of headers in that case anyway.
+    std::uint64_t const section_table_end =
+      view.GetSectionTableOffset() +
+      static_cast<std::uint64_t>(sections.size()) *
+        sizeof(ImageSectionHeader);
+    map_range(0,
+              0,
+              (std::max)(static_cast<std::uint64_t>(view.GetSizeOfHeaders()),
+                         section_table_end));
+
+    // In reverse, so the first of any overlapping sections is copied last.
+    std::uint32_t const file_alignment = view.GetFileAlignment();
+    std::uint32_t const section_alignment = view.GetSectionAlignment();
+    for (auto it = sections.rbegin(); it != sections.rend(); ++it)
+    {
+      ImageSectionHeader const& section = *it;
+      std::uint32_t const virtual_size =
+        section.VirtualSize ? section.VirtualSize : section.SizeOfRawData;
+      std::uint32_t const raw_ptr =
+        section.PointerToRawData >= 0x200
+          ? section.PointerToRawData & ~(file_alignment - 1)
+          : 0;
+      std::uint64_t const raw_size =
+        (std::min)(static_cast<std::uint64_t>(section.SizeOfRawData),
+                   detail::AlignUp(virtual_size, section_alignment));
+      map_range(section.VirtualAddress, raw_ptr, raw_size);
+    }
+  }
+
+  std::uint64_t const old_base = view.GetImageBase();
+  std::uint64_t const delta = base - old_base;
+  if (delta)
+  {
+    ImageDataDirectory const reloc_dir = view.GetDataDir(PeDataDir::BaseReloc);
+    if (reloc_dir.VirtualAddress && reloc_dir.Size)
+    {
+      // Read from the mapped image, the same as the loader.
+      if (reloc_dir.VirtualAddress >= image.size())
+      {
+        HADESMEM_DETAIL_THROW_EXCEPTION(
+          Error{} << ErrorString{"Invalid relocation directory."});
+      }
+
+      std::size_t const reloc_dir_size = (std::min)(
+        static_cast<std::size_t>(reloc_dir.Size),
+        image.size() - reloc_dir.VirtualAddress);
+      BaseRelocationTable const relocs{&image[reloc_dir.VirtualAddress],
+                                       reloc_dir_size};
+      relocs.Apply(image.data(), image.size(), delta);
+    }
+    else if (view.GetFileHeader().Characteristics & kImageFileRelocsStripped)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Relocations have been stripped."});
+    }
+
+    std::uint64_t const image_base_offset =
+      view.GetNtHeadersOffset() + kImageOptionalHeaderOffset +
+      (view.Is64() ? offsetof(ImageOptionalHeader64, ImageBase)
+                   : offsetof(ImageOptionalHeader32, ImageBase));
+    if (view.Is64())
+    {
+      if (image_base_offset + sizeof(std::uint64_t) <= image.size())
+      {
+        std::memcpy(&image[static_cast<std::size_t>(image_base_offset)],
+                    &base,
+                    sizeof(base));
+      }
+    }
+    else
+    {
+      auto const base_32 = static_cast<std::uint32_t>(base);
+      if (image_base_offset + sizeof(base_32) <= image.size())
+      {
+        std::memcpy(&image[static_cast<std::size_t>(image_base_offset)],
+                    &base_32,
+                    sizeof(base_32));
+      }
+    }
+  }
+
+  return image;
+}
+
+// Maps the file at its preferred base, so no relocations are applied.
+inline std::vector<std::uint8_t> MapImage(PeView const& view)
+{
+  return MapImage(view, view.GetImageBase());
+}
+}
+}
@@ -0,0 +1,240 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+
+namespace hadesmem
+{
+namespace pelib
+{
+namespace detail
+{
+template <typename LoadConfigT>
+inline ImageLoadConfigDirectory64 ReadLoadConfig(PeView const& view,
+                                                 std::size_t offset,
+                                                 std::uint32_t& size)
+{
+  // The Size field says how much of the structure is present, which may be
+  // less than we know about (older linkers) or more (newer ones). Anything
+  // after it is zeroed, including whatever follows it in the buffer.
+  LoadConfigT dir;
+  std::size_t const len = view.GetSource().ReadTruncated(offset, dir);
+  if (len < sizeof(dir.Size))
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(
+      Error{} << ErrorString{"Invalid load config directory."});
+  }
+
+  size = dir.Size;
+  std::size_t const present = (std::min)(static_cast<std::size_t>(dir.Size),
+                                         len);
+  if (present < sizeof(dir))
+  {
+    std::memset(reinterpret_cast<std::uint8_t*>(&dir) + present,
+                0,
+                sizeof(dir) - present);
+  }
+
+  ImageLoadConfigDirectory64 result{};
+  result.Size = dir.Size;
+  result.TimeDateStamp = dir.TimeDateStamp;
+  result.MajorVersion = dir.MajorVersion;
+  result.MinorVersion = dir.MinorVersion;
+  result.SecurityCookie = dir.SecurityCookie;
+  result.SEHandlerTable = dir.SEHandlerTable;
+  result.SEHandlerCount = dir.SEHandlerCount;
+  result.GuardCFCheckFunctionPointer = dir.GuardCFCheckFunctionPointer;
+  result.GuardCFDispatchFunctionPointer = dir.GuardCFDispatchFunctionPointer;
+  result.GuardCFFunctionTable = dir.GuardCFFunctionTable;
+  result.GuardCFFunctionCount = dir.GuardCFFunctionCount;
+  result.GuardFlags = dir.GuardFlags;
+  return result;
+}
+}
+
+// Load config directory of a file or image, with the fields of both the 32
+// and 64-bit versions widened to 64 bits, and its SafeSEH and CFG tables
+// converted to RVAs.
+//
+// The CFG function table (every function which may be the target of an
+// indirect call) is sorted, so it doubles as a cheap source of function
+// starts, even for images without exception data (i.e. x86).
+//
+// Throws if the directory or either table lies outside the buffer, as the
+// loader would refuse to load the image.
+class LoadConfigDir
+{
+public:
+  LoadConfigDir() noexcept
+  {
+  }
+
+  // Empty if there is no directory.
+  explicit LoadConfigDir(PeView const& view)
+  {
+    ImageDataDirectory const data_dir = view.GetDataDir(PeDataDir::LoadConfig);
+    if (!data_dir.VirtualAddress)
+    {
+      return;
+    }
+
+    std::size_t const offset = view.RvaToOffset(data_dir.VirtualAddress);
+    if (offset == PeView::kInvalidOffset)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Invalid load config directory."});
+    }
+
+    dir_ = view.Is64()
+             ? detail::ReadLoadConfig<ImageLoadConfigDirectory64>(
+                 view, offset, size_)
+             : detail::ReadLoadConfig<ImageLoadConfigDirectory32>(
+                 view, offset, size_);
+    valid_ = true;
+
+    safe_seh_handlers_ = ReadTable(view,
+                                   dir_.SEHandlerTable,
+                                   dir_.SEHandlerCount,
+                                   sizeof(std::uint32_t));
+
+    std::size_t const cf_stride =
+      sizeof(std::uint32_t) +
+      ((dir_.GuardFlags & kImageGuardCfFunctionTableSizeMask) >>
+       kImageGuardCfFunctionTableSizeShift);
+    guard_cf_functions_ = ReadTable(view,
+                                    dir_.GuardCFFunctionTable,
+                                    dir_.GuardCFFunctionCount,
+                                    cf_stride);
+  }
+
+  bool IsValid() const noexcept
+  {
+    return valid_;
+  }
+
+  // Size of the directory according to itself (not the data directory).
+  std::uint32_t GetSize() const noexcept
+  {
+    return size_;
+  }
+
+  std::uint32_t GetTimeDateStamp() const noexcept
+  {
+    return dir_.TimeDateStamp;
+  }
+
+  std::uint64_t GetSecurityCookie() const noexcept
+  {
+    return dir_.SecurityCookie;
+  }
+
+  std::uint64_t GetSEHandlerTable() const noexcept
+  {
+    return dir_.SEHandlerTable;
+  }
+
+  std::uint64_t GetSEHandlerCount() const noexcept
+  {
+    return dir_.SEHandlerCount;
+  }
+
+  std::uint64_t GetGuardCFCheckFunctionPointer() const noexcept
+  {
+    return dir_.GuardCFCheckFunctionPointer;
+  }
+
+  std::uint64_t GetGuardCFDispatchFunctionPointer() const noexcept
+  {
+    return dir_.GuardCFDispatchFunctionPointer;
+  }
+
+  std::uint64_t GetGuardCFFunctionTable() const noexcept
+  {
+    return dir_.GuardCFFunctionTable;
+  }
+
+  std::uint64_t GetGuardCFFunctionCount() const noexcept
+  {
+    return dir_.GuardCFFunctionCount;
+  }
+
+  std::uint32_t GetGuardFlags() const noexcept
+  {
+    return dir_.GuardFlags;
+  }
+
+  // RVAs of the SafeSEH handlers, sorted.
+  std::vector<std::uint32_t> const& GetSafeSehHandlers() const noexcept
+  {
+    return safe_seh_handlers_;
+  }
+
+  // RVAs of the valid CFG call targets, sorted.
+  std::vector<std::uint32_t> const& GetGuardCFFunctions() const noexcept
+  {
+    return guard_cf_functions_;
+  }
+
+private:
+  // Each entry starts with an RVA, followed by stride - 4 bytes of flags
+  // (which we don't need). The table itself is referenced by VA.
+  static std::vector<std::uint32_t> ReadTable(PeView const& view,
+                                              std::uint64_t va,
+                                              std::uint64_t count,
+                                              std::size_t stride)
+  {
+    std::vector<std::uint32_t> rvas;
+    if (!va || !count)
+    {
+      return rvas;
+    }
+
+    std::uint64_t const image_base = view.GetImageBase();
+    std::uint8_t const* const data =
+      (va >= image_base && va - image_base <= 0xFFFFFFFFULL)
+        ? view.RvaToPtr(static_cast<std::uint32_t>(va - image_base))
+        : nullptr;
+    std::uint8_t const* const end =
+      view.GetSource().GetData() + view.GetSize();
+    if (!data || count > static_cast<std::size_t>(end - data) / stride)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Invalid load config table."});
+    }
+
+    rvas.resize(static_cast<std::size_t>(count));
+    for (std::size_t i = 0; i < rvas.size(); ++i)
+    {
+      std::memcpy(&rvas[i], data + i * stride, sizeof(rvas[i]));
+    }
+
+    // The linker always emits the tables sorted (the loader binary searches
+    // the SafeSEH table), so this is normally just the check.
+    if (!std::is_sorted(std::begin(rvas), std::end(rvas)))
+    {
+      std::sort(std::begin(rvas), std::end(rvas));
+    }
+
+    return rvas;
+  }
+
+  ImageLoadConfigDirectory64 dir_ = ImageLoadConfigDirectory64{};
+  std::uint32_t size_{};
+  bool valid_{};
+  std::vector<std::uint32_t> safe_seh_handlers_;
+  std::vector<std::uint32_t> guard_cf_functions_;
+};
+}
+}
@@ -0,0 +1,283 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else // #if defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // #if defined(_WIN32)
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#if defined(_WIN32)
+#include <hadesmem/detail/smart_handle.hpp>
+#endif // #if defined(_WIN32)
+
+// TODO: Support mapping a window of the file rather than the whole file, so
+// that files larger than the address space can be handled by 32-bit builds.
+
+// TODO: Use PrefetchVirtualMemory for range hints on Windows 8 and above.
+
+namespace hadesmem
+{
+namespace pelib
+{
+// Hint for how the mapping will be accessed. Equivalent to the MADV_* advice
+// on POSIX, and FILE_FLAG_SEQUENTIAL_SCAN/FILE_FLAG_RANDOM_ACCESS on Windows.
+enum class MappedFileAccess
+{
+  kNormal,
+  kSequential,
+  kRandom
+};
+
+// Read-only memory mapping of an entire file. Pages are only read from disk
+// when they are first touched, so parsing the headers of a large file only
+// reads the pages containing the headers (unlike PeFileToBuffer which reads and
+// copies the whole file).
+//
+// The file size is 64-bit, but the whole file must fit in the address space, so
+// 32-bit builds are limited to files of a few GB.
+class MappedFile
+{
+public:
+#if defined(_WIN32)
+  using PathT = std::wstring;
+#else  // #if defined(_WIN32)
+  using PathT = std::string;
+#endif // #if defined(_WIN32)
+
+  explicit MappedFile(PathT const& path,
+                      MappedFileAccess access = MappedFileAccess::kNormal)
+  {
+    Initialize(path, access);
+  }
+
+  MappedFile(MappedFile const& other) = delete;
+
+  MappedFile& operator=(MappedFile const& other) = delete;
+
+  ~MappedFile()
+  {
+#if !defined(_WIN32)
+    if (data_)
+    {
+      ::munmap(const_cast<std::uint8_t*>(data_), size_);
+    }
+#endif // #if !defined(_WIN32)
+  }
+
+  std::uint8_t const* GetData() const noexcept
+  {
+    return data_;
+  }
+
+  std::size_t GetSize() const noexcept
+  {
+    return size_;
+  }
+
+  // Changes the access hint for a range of the file (e.g. random access for
+  // the headers and tables, then sequential for hashing the whole file).
+  // Advisory only, so failure is ignored. A no-op on Windows, where the hint
+  // can only be given when the file is opened.
+  void Advise(MappedFileAccess access,
+              std::size_t offset,
+              std::size_t len) const noexcept
+  {
+    if (offset >= size_)
+    {
+      return;
+    }
+
+    len = (std::min)(len, size_ - offset);
+
+#if defined(_WIN32)
+    (void)access;
+#else  // #if defined(_WIN32)
+    // madvise requires a page aligned address.
+    auto const page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    std::size_t const aligned_offset = offset - (offset % page_size);
+    ::madvise(const_cast<std::uint8_t*>(data_) + aligned_offset,
+              len + (offset - aligned_offset),
+              GetAdvice(access));
+#endif // #if defined(_WIN32)
+  }
+
+private:
+#if defined(_WIN32)
+  void Initialize(PathT const& path, MappedFileAccess access)
+  {
+    DWORD const flags = access == MappedFileAccess::kSequential
+                          ? FILE_FLAG_SEQUENTIAL_SCAN
+                          : access == MappedFileAccess::kRandom
+                              ? FILE_FLAG_RANDOM_ACCESS
+                              : FILE_ATTRIBUTE_NORMAL;
+    ::hadesmem::detail::SmartFileHandle const file{
+      ::CreateFileW(path.c_str(),
+                    GENERIC_READ,
+                    FILE_SHARE_READ,
+                    nullptr,
+                    OPEN_EXISTING,
+                    flags,
+                    nullptr)};
+    if (!file.IsValid())
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"CreateFileW failed."}
+                                      << ErrorCodeWinLast{last_error});
+    }
+
+    LARGE_INTEGER file_size{};
+    if (!::GetFileSizeEx(file.GetHandle(), &file_size))
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"GetFileSizeEx failed."}
+                                      << ErrorCodeWinLast{last_error});
+    }
+
+    SetSize(static_cast<std::uint64_t>(file_size.QuadPart));
+
+    // The mapping object is kept alive by the view, so the file and mapping
+    // handles can be closed as soon as the view is created.
+    ::hadesmem::detail::SmartHandle const file_mapping{::CreateFileMappingW(
+      file.GetHandle(), nullptr, PAGE_READONLY, 0, 0, nullptr)};
+    if (!file_mapping.IsValid())
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"CreateFileMappingW failed."}
+                << ErrorCodeWinLast{last_error});
+    }
+
+    view_ = ::MapViewOfFile(file_mapping.GetHandle(), FILE_MAP_READ, 0, 0, 0);
+    if (!view_.IsValid())
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"MapViewOfFile failed."}
+                                      << ErrorCodeWinLast{last_error});
+    }
+
+    data_ = static_cast<std::uint8_t const*>(view_.GetHandle());
+  }
+#else  // #if defined(_WIN32)
+  static int GetAdvice(MappedFileAccess access) noexcept
+  {
+    return access == MappedFileAccess::kSequential
+             ? MADV_SEQUENTIAL
+             : access == MappedFileAccess::kRandom ? MADV_RANDOM : MADV_NORMAL;
+  }
+
+  void Initialize(PathT const& path, MappedFileAccess access)
+  {
+    int const fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+      int const last_error = errno;
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"open failed."}
+                                      << boost::errinfo_errno{last_error});
+    }
+
+    // The mapping keeps its own reference to the file, so the descriptor can
+    // be closed as soon as the mapping is created.
+    struct FdCloser
+    {
+      ~FdCloser()
+      {
+        ::close(fd);
+      }
+
+      int fd;
+    } const fd_closer{fd};
+
+    struct stat file_stat = {};
+    if (::fstat(fd, &file_stat) == -1)
+    {
+      int const last_error = errno;
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"fstat failed."}
+                                      << boost::errinfo_errno{last_error});
+    }
+
+    SetSize(static_cast<std::uint64_t>(file_stat.st_size));
+
+    void* const data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      int const last_error = errno;
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"mmap failed."}
+                                      << boost::errinfo_errno{last_error});
+    }
+
+    data_ = static_cast<std::uint8_t const*>(data);
+
+    if (access != MappedFileAccess::kNormal)
+    {
+      ::madvise(data, size_, GetAdvice(access));
+    }
+  }
+#endif // #if defined(_WIN32)
+
+  void SetSize(std::uint64_t file_size)
+  {
+    // Empty files can't be mapped, and aren't PE files anyway.
+    if (!file_size)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Empty or invalid file."});
+    }
+
+    if (file_size > (std::numeric_limits<std::size_t>::max)())
+    {
+#if defined(_WIN32)
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"File too large to map."}
+                << ErrorCodeWinLast{ERROR_FILE_TOO_LARGE});
+#else  // #if defined(_WIN32)
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"File too large to map."}
+                                      << boost::errinfo_errno{EFBIG});
+#endif // #if defined(_WIN32)
+    }
+
+    size_ = static_cast<std::size_t>(file_size);
+  }
+
+#if defined(_WIN32)
+  ::hadesmem::detail::SmartMappedFileHandle view_;
+#endif // #if defined(_WIN32)
+  std::uint8_t const* data_{};
+  std::size_t size_{};
+};
+
+// Maps the file and returns a source which keeps the mapping alive for as long
+// as it (or a copy, or a view built on it) exists.
+inline BufferSource
+  MapFileSource(MappedFile::PathT const& path,
+                MappedFileAccess access = MappedFileAccess::kNormal)
+{
+  auto const file = std::make_shared<MappedFile const>(path, access);
+  return BufferSource{file->GetData(), file->GetSize(), file};
+}
+}
+}
@@ -0,0 +1,191 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/sha.hpp>
+#include <hadesmem/pelib/view/debug_dir.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+
+namespace hadesmem
+{
+namespace pelib
+{
+// Where a module identity came from, from most to least preferred.
+enum class ModuleIdentityKind
+{
+  kPdb,
+  kTimeDateStamp,
+  kContentHash
+};
+
+// Identifies a build of a module, for use as a cache key. Identities of
+// different kinds never compare equal, so the same module may have
+// different identities depending on what was available when it was looked
+// at (e.g. a file vs. an image whose debug data isn't mapped).
+class ModuleIdentity
+{
+public:
+  ModuleIdentity() noexcept
+  {
+  }
+
+  explicit ModuleIdentity(ModuleIdentityKind kind,
+                          std::vector<std::uint8_t> key)
+    : kind_{kind}, key_(std::move(key))
+  {
+  }
+
+  ModuleIdentityKind GetKind() const noexcept
+  {
+    return kind_;
+  }
+
+  std::vector<std::uint8_t> const& GetKey() const noexcept
+  {
+    return key_;
+  }
+
+  // For the PDB and TimeDateStamp kinds this is the key used by symbol
+  // servers for the PDB and the binary respectively (GUID and age, or
+  // TimeDateStamp and SizeOfImage), so it can also be used to look them up.
+  // Otherwise it's the hex digest.
+  std::string ToString() const
+  {
+    std::string str;
+    auto const append_hex = [&](std::uint64_t value, std::size_t width) {
+      char const digits[] = "0123456789ABCDEF";
+      for (std::size_t i = width; i-- > 0;)
+      {
+        str += digits[(value >> (i * 4)) & 0xF];
+      }
+    };
+    // Symbol servers format the age and SizeOfImage with "%x".
+    auto const append_short_hex = [&](std::uint32_t value) {
+      char const digits[] = "0123456789abcdef";
+      std::size_t width = 1;
+      while (width < 8 && (value >> (width * 4)))
+      {
+        ++width;
+      }
+      for (std::size_t i = width; i-- > 0;)
+      {
+        str += digits[(value >> (i * 4)) & 0xF];
+      }
+    };
+    auto const read_le = [&](std::size_t offset, std::size_t len) {
+      std::uint32_t value = 0;
+      for (std::size_t i = len; i-- > 0;)
+      {
+        value = (value << 8) | key_[offset + i];
+      }
+      return value;
+    };
+
+    if (kind_ == ModuleIdentityKind::kPdb && key_.size() == 20)
+    {
+      append_hex(read_le(0, 4), 8);
+      append_hex(read_le(4, 2), 4);
+      append_hex(read_le(6, 2), 4);
+      for (std::size_t i = 8; i < 16; ++i)
+      {
+        append_hex(key_[i], 2);
+      }
+      append_short_hex(read_le(16, 4));
+    }
+    else if (kind_ == ModuleIdentityKind::kTimeDateStamp && key_.size() == 8)
+    {
+      append_hex(read_le(0, 4), 8);
+      append_short_hex(read_le(4, 4));
+    }
+    else
+    {
+      for (std::uint8_t b : key_)
+      {
+        append_hex(b, 2);
+      }
+    }
+
+    return str;
+  }
+
+private:
+  ModuleIdentityKind kind_{ModuleIdentityKind::kContentHash};
+  std::vector<std::uint8_t> key_;
+};
+
+inline bool operator==(ModuleIdentity const& lhs, ModuleIdentity const& rhs)
+{
+  return lhs.GetKind() == rhs.GetKind() && lhs.GetKey() == rhs.GetKey();
+}
+
+inline bool operator!=(ModuleIdentity const& lhs, ModuleIdentity const& rhs)
+{
+  return !(lhs == rhs);
+}
+
+inline bool operator<(ModuleIdentity const& lhs, ModuleIdentity const& rhs)
+{
+  if (lhs.GetKind() != rhs.GetKind())
+  {
+    return lhs.GetKind() < rhs.GetKind();
+  }
+
+  return lhs.GetKey() < rhs.GetKey();
+}
+
+namespace detail
+{
+inline void AppendLe32(std::vector<std::uint8_t>& key, std::uint32_t value)
+{
+  for (std::size_t i = 0; i < 4; ++i)
+  {
+    key.push_back(static_cast<std::uint8_t>(value >> (i * 8)));
+  }
+}
+}
+
+// Gets the identity of a module from as little of it as possible. In order
+// of preference:
+// - The GUID and age of its PDB, from the CodeView debug record. Only a few
+//   hundred bytes of headers and debug data are touched.
+// - Its TimeDateStamp and SizeOfImage, from the headers alone. Deterministic
+//   builds put (part of) a content hash in the TimeDateStamp instead, which
+//   works just as well.
+// - The SHA-256 of the whole buffer. Note that for images this depends on
+//   the load address (relocations) and anything else written since loading.
+inline ModuleIdentity GetModuleIdentity(PeView const& view)
+{
+  DebugDir const debug_dir{view};
+  if (debug_dir.HasPdbInfo())
+  {
+    auto const& guid = debug_dir.GetPdbGuid();
+    std::vector<std::uint8_t> key(std::begin(guid), std::end(guid));
+    detail::AppendLe32(key, debug_dir.GetPdbAge());
+    return ModuleIdentity{ModuleIdentityKind::kPdb, std::move(key)};
+  }
+
+  std::uint32_t const time_date_stamp = view.GetFileHeader().TimeDateStamp;
+  if (time_date_stamp)
+  {
+    std::vector<std::uint8_t> key;
+    detail::AppendLe32(key, time_date_stamp);
+    detail::AppendLe32(key, view.GetSizeOfImage());
+    return ModuleIdentity{ModuleIdentityKind::kTimeDateStamp, std::move(key)};
+  }
+
+  auto const digest = ::hadesmem::detail::Sha256::Hash(
+    view.GetSource().GetData(), view.GetSize());
+  return ModuleIdentity{ModuleIdentityKind::kContentHash,
+                        std::vector<std::uint8_t>(std::begin(digest),
+                                                  std::end(digest))};
+}
+}
+}
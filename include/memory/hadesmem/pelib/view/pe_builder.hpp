@@ -0,0 +1,880 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/image_mapper.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+
+// TODO: Fix up PointerToRawData in the debug directory, which is a file
+// offset and so is stale once the sections have been moved.
+
+// TODO: Support keeping the overlay (data after the last section).
+
+namespace hadesmem
+{
+namespace pelib
+{
+struct PeBuilderImport
+{
+  // Empty for imports by ordinal.
+  std::string name;
+  std::uint16_t hint{};
+  std::uint16_t ordinal{};
+};
+
+struct PeBuilderImportDir
+{
+  std::string name;
+  // If empty, the descriptor below is written as is (e.g. to keep an existing
+  // descriptor whose name and thunks are already in the image).
+  std::vector<PeBuilderImport> imports;
+  // RVA of an existing IAT to point the descriptor at, for when code already
+  // references it (e.g. in a dump). The existing IAT is left untouched. If
+  // zero, a new IAT is allocated next to the ILT.
+  std::uint32_t first_thunk{};
+  // Only TimeDateStamp and ForwarderChain are used if there are imports.
+  ImageImportDescriptor descriptor{};
+};
+
+struct PeLayoutSection
+{
+  std::uint32_t virtual_address;
+  std::uint32_t virtual_size;
+  std::uint32_t pointer_to_raw_data;
+  std::uint32_t size_of_raw_data;
+};
+
+// Everything about the output which depends on the edits, computed up front
+// so the output can be written in a single pass into a single allocation.
+struct PeLayout
+{
+  std::uint32_t nt_headers_offset;
+  std::uint32_t size_of_headers;
+  std::uint32_t size_of_image;
+  std::uint32_t file_size;
+  std::vector<PeLayoutSection> sections;
+  // Offset of the generated import data within its section.
+  std::uint32_t import_offset;
+  std::uint32_t import_size;
+  ImageDataDirectory import_dir;
+  ImageDataDirectory iat_dir;
+};
+
+namespace detail
+{
+// Offsets of everything in a generated import directory, relative to its
+// start. In order: the descriptors (and the null terminator), the ILTs, the
+// new IATs (contiguous, so the IAT data directory can cover them), the
+// hint/name entries and finally the module names. Strings are only stored
+// once, however many times they are used.
+class PeBuilderImportLayout
+{
+public:
+  explicit PeBuilderImportLayout(std::vector<PeBuilderImportDir> const& dirs,
+                                 bool is_64)
+    : thunk_size_{is_64 ? 8U : 4U}
+  {
+    std::uint64_t size =
+      (dirs.size() + 1) * static_cast<std::uint64_t>(
+                            sizeof(ImageImportDescriptor));
+
+    size = ::hadesmem::pelib::detail::AlignUp(size, thunk_size_);
+    for (auto const& dir : dirs)
+    {
+      ilt_offsets_.push_back(size);
+      size += GetThunksSize(dir);
+    }
+
+    iat_begin_ = size;
+    for (auto const& dir : dirs)
+    {
+      iat_offsets_.push_back(size);
+      if (!dir.imports.empty() && !dir.first_thunk)
+      {
+        size += GetThunksSize(dir);
+      }
+    }
+    iat_end_ = size;
+
+    for (auto const& dir : dirs)
+    {
+      for (auto const& import : dir.imports)
+      {
+        if (!import.name.empty() &&
+            hint_names_.find(import.name) == std::end(hint_names_))
+        {
+          hint_names_[import.name] = HintName{size, import.hint};
+          size += ::hadesmem::pelib::detail::AlignUp(
+            sizeof(std::uint16_t) + import.name.size() + 1, 2);
+        }
+      }
+    }
+
+    for (auto const& dir : dirs)
+    {
+      if (!dir.imports.empty() &&
+          name_offsets_.find(dir.name) == std::end(name_offsets_))
+      {
+        name_offsets_[dir.name] = size;
+        size += dir.name.size() + 1;
+      }
+    }
+
+    size_ = size;
+  }
+
+  std::uint64_t GetSize() const noexcept
+  {
+    return size_;
+  }
+
+  ImageDataDirectory GetImportDir(std::uint32_t rva,
+                                  std::size_t num_dirs) const noexcept
+  {
+    return ImageDataDirectory{
+      rva,
+      static_cast<std::uint32_t>((num_dirs + 1) *
+                                 sizeof(ImageImportDescriptor))};
+  }
+
+  // Zero if there are no new IATs.
+  ImageDataDirectory GetIatDir(std::uint32_t rva) const noexcept
+  {
+    if (iat_begin_ == iat_end_)
+    {
+      return ImageDataDirectory{};
+    }
+
+    return ImageDataDirectory{rva + static_cast<std::uint32_t>(iat_begin_),
+                              static_cast<std::uint32_t>(iat_end_ -
+                                                         iat_begin_)};
+  }
+
+  // The output must be zeroed, and at least GetSize() bytes.
+  void Write(std::vector<PeBuilderImportDir> const& dirs,
+             std::uint8_t* out,
+             std::uint32_t rva) const
+  {
+    for (std::size_t i = 0; i < dirs.size(); ++i)
+    {
+      auto const& dir = dirs[i];
+      ImageImportDescriptor desc = dir.descriptor;
+      if (!dir.imports.empty())
+      {
+        auto const ilt_rva = rva + static_cast<std::uint32_t>(ilt_offsets_[i]);
+        desc.OriginalFirstThunk = ilt_rva;
+        desc.Name = rva + static_cast<std::uint32_t>(
+                            name_offsets_.find(dir.name)->second);
+        desc.FirstThunk =
+          dir.first_thunk
+            ? dir.first_thunk
+            : rva + static_cast<std::uint32_t>(iat_offsets_[i]);
+
+        WriteThunks(dir, out + ilt_offsets_[i], rva);
+        if (!dir.first_thunk)
+        {
+          WriteThunks(dir, out + iat_offsets_[i], rva);
+        }
+      }
+
+      std::memcpy(out + i * sizeof(ImageImportDescriptor), &desc, sizeof(desc));
+    }
+
+    for (auto const& hint_name : hint_names_)
+    {
+      std::uint8_t* const p = out + hint_name.second.offset;
+      std::uint16_t const hint = hint_name.second.hint;
+      std::memcpy(p, &hint, sizeof(hint));
+      std::memcpy(p + sizeof(hint),
+                  hint_name.first.c_str(),
+                  hint_name.first.size() + 1);
+    }
+
+    for (auto const& name : name_offsets_)
+    {
+      std::memcpy(
+        out + name.second, name.first.c_str(), name.first.size() + 1);
+    }
+  }
+
+private:
+  struct HintName
+  {
+    std::uint64_t offset;
+    // Of the first import with the name.
+    std::uint16_t hint;
+  };
+
+  std::uint64_t GetThunksSize(PeBuilderImportDir const& dir) const noexcept
+  {
+    return dir.imports.empty()
+             ? 0
+             : (dir.imports.size() + 1) * static_cast<std::uint64_t>(
+                                            thunk_size_);
+  }
+
+  void WriteThunks(PeBuilderImportDir const& dir,
+                   std::uint8_t* out,
+                   std::uint32_t rva) const
+  {
+    std::uint64_t const ordinal_flag =
+      thunk_size_ == 8 ? kImageOrdinalFlag64 : kImageOrdinalFlag32;
+    for (auto const& import : dir.imports)
+    {
+      std::uint64_t const thunk =
+        import.name.empty()
+          ? (ordinal_flag | import.ordinal)
+          : rva + hint_names_.find(import.name)->second.offset;
+      std::memcpy(out, &thunk, thunk_size_);
+      out += thunk_size_;
+    }
+  }
+
+  std::uint32_t thunk_size_;
+  std::vector<std::uint64_t> ilt_offsets_;
+  std::vector<std::uint64_t> iat_offsets_;
+  std::uint64_t iat_begin_{};
+  std::uint64_t iat_end_{};
+  std::map<std::string, HintName> hint_names_;
+  std::map<std::string, std::uint64_t> name_offsets_;
+  std::uint64_t size_{};
+};
+}
+
+// Rebuilds a file from a parsed view plus a set of edits (new sections,
+// resized sections, a new import directory, a stripped DOS stub, etc.).
+//
+// Nothing is copied until Build is called. Plan then computes the final
+// layout (header size, section RVAs and file offsets, the import directory)
+// in a single pass, after which the output is allocated once at its final
+// size and each section is copied into it exactly once. Section data is
+// referenced rather than copied, so the view's source (and any buffers given
+// to SetSectionData) must outlive the builder.
+//
+// The output is always laid out as a normal file (sections in section table
+// order, each at a FileAlignment aligned offset), whatever the layout of the
+// view. The security directory is cleared, as any certificate table is
+// dropped along with the rest of the overlay (and is invalid anyway once the
+// file has changed). The checksum is not updated (see UpdatePeChecksum).
+class PeBuilder
+{
+public:
+  explicit PeBuilder(PeView const& view)
+    : source_{view.GetSource()},
+      is_64_{view.Is64()},
+      dos_header_(view.GetDosHeader()),
+      size_of_headers_{view.GetSizeOfHeaders()},
+      section_alignment_{view.GetSectionAlignment()},
+      file_alignment_{view.GetFileAlignment()},
+      num_rva_and_sizes_{view.GetNumberOfRvaAndSizes()}
+  {
+    // Padded out to a full optional header, so every field can be patched
+    // without checking, even if SizeOfOptionalHeader is smaller.
+    std::size_t const optional_header_size =
+      view.GetFileHeader().SizeOfOptionalHeader;
+    nt_headers_.resize(kImageOptionalHeaderOffset +
+                       (std::max)(optional_header_size,
+                                  is_64_ ? sizeof(ImageOptionalHeader64)
+                                         : sizeof(ImageOptionalHeader32)));
+    CopyFromSource(view.GetNtHeadersOffset(),
+                   kImageOptionalHeaderOffset + optional_header_size,
+                   nt_headers_.data());
+    original_section_table_end_ =
+      static_cast<std::uint64_t>(view.GetNtHeadersOffset()) +
+      kImageOptionalHeaderOffset + optional_header_size +
+      view.GetNumberOfSections() *
+        static_cast<std::uint64_t>(sizeof(ImageSectionHeader));
+
+    // Located the same way as when mapping (see MapImage), so the builder
+    // sees the same bytes the loader would.
+    bool const rva_is_offset = view.GetType() == PeFileType::kImage ||
+                               view.HasVirtualSectionTable();
+    for (auto const& header : view.GetSections())
+    {
+      std::uint32_t const virtual_size =
+        header.VirtualSize ? header.VirtualSize : header.SizeOfRawData;
+      std::uint32_t const raw_ptr =
+        rva_is_offset ? header.VirtualAddress
+                      : (header.PointerToRawData >= 0x200
+                           ? header.PointerToRawData & ~(file_alignment_ - 1)
+                           : 0);
+      std::uint64_t const raw_size = (std::min)(
+        static_cast<std::uint64_t>(header.SizeOfRawData),
+        ::hadesmem::pelib::detail::AlignUp(virtual_size, section_alignment_));
+
+      Section section{};
+      section.header = header;
+      section.size = static_cast<std::uint32_t>(raw_size);
+      if (raw_ptr < source_.GetSize())
+      {
+        section.data = source_.GetData() + raw_ptr;
+        section.data_size = static_cast<std::size_t>((std::min)(
+          raw_size, static_cast<std::uint64_t>(source_.GetSize() - raw_ptr)));
+      }
+      sections_.push_back(section);
+    }
+  }
+
+  std::size_t GetNumberOfSections() const noexcept
+  {
+    return sections_.size();
+  }
+
+  // PointerToRawData and SizeOfRawData are only final in the layout.
+  ImageSectionHeader const& GetSectionHeader(std::size_t index) const
+  {
+    return GetSection(index).header;
+  }
+
+  void SetImageBase(std::uint64_t image_base)
+  {
+    if (is_64_)
+    {
+      PatchNtHeaders(kImageOptionalHeaderOffset +
+                       offsetof(ImageOptionalHeader64, ImageBase),
+                     image_base);
+    }
+    else
+    {
+      PatchNtHeaders(kImageOptionalHeaderOffset +
+                       offsetof(ImageOptionalHeader32, ImageBase),
+                     static_cast<std::uint32_t>(image_base));
+    }
+  }
+
+  void SetAddressOfEntryPoint(std::uint32_t address_of_entry_point)
+  {
+    PatchNtHeaders(GetOptionalHeaderFieldOffset(
+                     offsetof(ImageOptionalHeader32, AddressOfEntryPoint),
+                     offsetof(ImageOptionalHeader64, AddressOfEntryPoint)),
+                   address_of_entry_point);
+  }
+
+  // Throws if the data directory is past NumberOfRvaAndSizes.
+  void SetDataDir(PeDataDir data_dir, ImageDataDirectory const& value)
+  {
+    PatchNtHeaders(GetDataDirOffset(data_dir), value);
+  }
+
+  // Moves the NT headers to directly after the DOS header, dropping the DOS
+  // stub (and the Rich header, if any).
+  void StripDosStub() noexcept
+  {
+    strip_dos_stub_ = true;
+  }
+
+  // Whether a section can be added without the headers overlapping the
+  // first section.
+  bool CanAddSection() const noexcept
+  {
+    return GetHeadersEnd(sections_.size() + 1) <= GetFirstSectionRva();
+  }
+
+  // Added after the existing sections, both in the section table and in
+  // memory. The size of the data is the raw size, and the virtual size is
+  // at least that.
+  std::size_t AddSection(char const* name,
+                         std::uint32_t characteristics,
+                         std::vector<std::uint8_t> data,
+                         std::uint32_t virtual_size = 0)
+  {
+    if (!CanAddSection())
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"No space for new section header."});
+    }
+
+    Section section{};
+    std::memcpy(section.header.Name,
+                name,
+                (std::min)(std::strlen(name), sizeof(section.header.Name)));
+    section.header.Characteristics = characteristics;
+    section.header.VirtualSize =
+      (std::max)(virtual_size, static_cast<std::uint32_t>(data.size()));
+    section.size = static_cast<std::uint32_t>(data.size());
+    section.owned = BufferSource{std::move(data)};
+    section.data = section.owned.GetData();
+    section.data_size = section.owned.GetSize();
+    section.added = true;
+    section.changed = true;
+    sections_.push_back(section);
+    return sections_.size() - 1;
+  }
+
+  // Replaces the raw data of a section (without copying it, so the buffer
+  // must outlive the builder). The virtual size is unchanged.
+  void SetSectionData(std::size_t index, void const* data, std::size_t size)
+  {
+    Section& section = GetSection(index);
+    section.data = static_cast<std::uint8_t const*>(data);
+    section.data_size = size;
+    section.size = static_cast<std::uint32_t>(size);
+    section.changed = true;
+  }
+
+  // Truncates or zero extends the raw data of a section.
+  void ResizeSection(std::size_t index,
+                     std::uint32_t raw_size,
+                     std::uint32_t virtual_size)
+  {
+    Section& section = GetSection(index);
+    section.size = raw_size;
+    section.data_size = (std::min)(section.data_size,
+                                   static_cast<std::size_t>(raw_size));
+    section.header.VirtualSize = virtual_size;
+    section.changed = true;
+  }
+
+  // Replaces the import directory with a generated one, appended to the
+  // given section (which must be the last in memory, or be followed by
+  // enough free virtual space). The import and IAT data directories are
+  // updated to match.
+  void SetImportDirs(std::vector<PeBuilderImportDir> dirs,
+                     std::size_t section_index)
+  {
+    for (auto const& dir : dirs)
+    {
+      if (dir.imports.empty() && !dir.descriptor.FirstThunk)
+      {
+        HADESMEM_DETAIL_THROW_EXCEPTION(
+          Error{} << ErrorString{"Invalid import directory."});
+      }
+    }
+
+    // Make sure the data directories exist now, rather than failing later.
+    GetDataDirOffset(PeDataDir::Import);
+    GetDataDirOffset(PeDataDir::IAT);
+
+    GetSection(section_index).changed = true;
+    import_dirs_ = std::move(dirs);
+    import_section_ = section_index;
+    has_import_dirs_ = true;
+  }
+
+  PeLayout Plan() const
+  {
+    PeLayout layout{};
+    layout.nt_headers_offset =
+      strip_dos_stub_ ? static_cast<std::uint32_t>(sizeof(ImageDosHeader))
+                      : static_cast<std::uint32_t>(dos_header_.e_lfanew);
+
+    std::uint64_t const headers_end = GetHeadersEnd(sections_.size());
+    if (headers_end > GetFirstSectionRva())
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"No space for section headers."});
+    }
+
+    std::uint64_t const size_of_headers = ::hadesmem::pelib::detail::AlignUp(
+      (std::max)(headers_end,
+                 static_cast<std::uint64_t>(
+                   strip_dos_stub_ ? 0 : size_of_headers_)),
+      file_alignment_);
+    if (size_of_headers > ::hadesmem::pelib::detail::kMaxMappedImageSize)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Headers too large."});
+    }
+
+    detail::PeBuilderImportLayout const import_layout{import_dirs_, is_64_};
+
+    // Virtual layout. Added sections go after everything else, in order.
+    std::vector<std::uint64_t> sizes;
+    std::vector<std::uint64_t> virtual_ends;
+    std::uint64_t image_end =
+      ::hadesmem::pelib::detail::AlignUp(size_of_headers, section_alignment_);
+    for (std::size_t i = 0; i < sections_.size(); ++i)
+    {
+      Section const& section = sections_[i];
+      std::uint64_t size = section.size;
+      std::uint64_t virtual_size = section.header.VirtualSize
+                                     ? section.header.VirtualSize
+                                     : section.size;
+      if (has_import_dirs_ && i == import_section_)
+      {
+        // After the virtual data, which may be uninitialized data the
+        // program relies on being zero.
+        std::uint64_t const import_offset =
+          ::hadesmem::pelib::detail::AlignUp((std::max)(size, virtual_size),
+                                             16);
+        layout.import_offset = static_cast<std::uint32_t>(import_offset);
+        layout.import_size =
+          static_cast<std::uint32_t>(import_layout.GetSize());
+        size = import_offset + import_layout.GetSize();
+        virtual_size = size;
+      }
+
+      std::uint64_t const virtual_address =
+        section.added ? image_end : section.header.VirtualAddress;
+      std::uint64_t const virtual_end =
+        virtual_address +
+        ::hadesmem::pelib::detail::AlignUp(virtual_size, section_alignment_);
+      image_end = (std::max)(image_end, virtual_end);
+      if (image_end > ::hadesmem::pelib::detail::kMaxMappedImageSize)
+      {
+        HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                        << ErrorString{"Image too large."});
+      }
+
+      layout.sections.push_back(
+        PeLayoutSection{static_cast<std::uint32_t>(virtual_address),
+                        static_cast<std::uint32_t>(virtual_size),
+                        0,
+                        0});
+      sizes.push_back(size);
+      virtual_ends.push_back(virtual_end);
+    }
+
+    CheckOverlaps(layout, virtual_ends);
+
+    // File layout, in section table order.
+    std::uint64_t file_end = size_of_headers;
+    for (std::size_t i = 0; i < sections_.size(); ++i)
+    {
+      std::uint64_t const raw_size =
+        ::hadesmem::pelib::detail::AlignUp(sizes[i], file_alignment_);
+      if (!raw_size)
+      {
+        continue;
+      }
+
+      std::uint64_t const raw_ptr =
+        ::hadesmem::pelib::detail::AlignUp(file_end, file_alignment_);
+      file_end = raw_ptr + raw_size;
+      if (file_end > ::hadesmem::pelib::detail::kMaxMappedImageSize)
+      {
+        HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                        << ErrorString{"File too large."});
+      }
+
+      layout.sections[i].pointer_to_raw_data =
+        static_cast<std::uint32_t>(raw_ptr);
+      layout.sections[i].size_of_raw_data =
+        static_cast<std::uint32_t>(raw_size);
+    }
+
+    layout.size_of_headers = static_cast<std::uint32_t>(size_of_headers);
+    layout.file_size = static_cast<std::uint32_t>(file_end);
+    layout.size_of_image =
+      sections_.empty()
+        ? GetOptionalHeaderField<std::uint32_t>(
+            offsetof(ImageOptionalHeader32, SizeOfImage),
+            offsetof(ImageOptionalHeader64, SizeOfImage))
+        : static_cast<std::uint32_t>(image_end);
+
+    if (has_import_dirs_)
+    {
+      std::uint32_t const import_rva =
+        layout.sections[import_section_].virtual_address +
+        layout.import_offset;
+      layout.import_dir =
+        import_layout.GetImportDir(import_rva, import_dirs_.size());
+      layout.iat_dir = import_layout.GetIatDir(import_rva);
+    }
+
+    return layout;
+  }
+
+  std::vector<std::uint8_t> Build() const
+  {
+    PeLayout const layout = Plan();
+    std::vector<std::uint8_t> out(layout.file_size);
+
+    // The original headers are kept as is (including anything after the
+    // section table, such as bound imports), except for what's rewritten
+    // below.
+    std::size_t const headers_size = static_cast<std::size_t>(
+      strip_dos_stub_ ? sizeof(ImageDosHeader)
+                      : (std::min)(size_of_headers_, layout.size_of_headers));
+    CopyFromSource(0, headers_size, out.data());
+
+    ImageDosHeader dos_header = dos_header_;
+    dos_header.e_lfanew = static_cast<std::int32_t>(layout.nt_headers_offset);
+    std::memcpy(out.data(), &dos_header, sizeof(dos_header));
+
+    std::vector<std::uint8_t> nt_headers = GetFinalNtHeaders(layout);
+    std::size_t const nt_headers_size =
+      kImageOptionalHeaderOffset + GetSizeOfOptionalHeader();
+    std::memcpy(
+      &out[layout.nt_headers_offset], nt_headers.data(), nt_headers_size);
+
+    std::size_t section_header_offset =
+      layout.nt_headers_offset + nt_headers_size;
+    for (std::size_t i = 0; i < sections_.size(); ++i)
+    {
+      ImageSectionHeader header = sections_[i].header;
+      header.VirtualAddress = layout.sections[i].virtual_address;
+      header.VirtualSize = layout.sections[i].virtual_size;
+      header.PointerToRawData = layout.sections[i].pointer_to_raw_data;
+      header.SizeOfRawData = layout.sections[i].size_of_raw_data;
+      std::memcpy(&out[section_header_offset], &header, sizeof(header));
+      section_header_offset += sizeof(header);
+    }
+
+    for (std::size_t i = 0; i < sections_.size(); ++i)
+    {
+      Section const& section = sections_[i];
+      std::uint8_t* const raw_data =
+        out.data() + layout.sections[i].pointer_to_raw_data;
+      if (section.data_size)
+      {
+        std::memcpy(raw_data,
+                    section.data,
+                    (std::min)(section.data_size,
+                               static_cast<std::size_t>(section.size)));
+      }
+
+      if (has_import_dirs_ && i == import_section_)
+      {
+        detail::PeBuilderImportLayout const import_layout{import_dirs_,
+                                                          is_64_};
+        import_layout.Write(import_dirs_,
+                            raw_data + layout.import_offset,
+                            layout.import_dir.VirtualAddress);
+      }
+    }
+
+    return out;
+  }
+
+private:
+  struct Section
+  {
+    ImageSectionHeader header;
+    std::uint8_t const* data;
+    // Bytes available at data. Anything past that (up to size) is zero.
+    std::size_t data_size;
+    std::uint32_t size;
+    BufferSource owned;
+    bool added;
+    bool changed;
+  };
+
+  Section& GetSection(std::size_t index)
+  {
+    if (index >= sections_.size())
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Invalid section index."});
+    }
+
+    return sections_[index];
+  }
+
+  Section const& GetSection(std::size_t index) const
+  {
+    return const_cast<PeBuilder*>(this)->GetSection(index);
+  }
+
+  void CopyFromSource(std::size_t offset, std::size_t len, void* out) const
+  {
+    if (offset < source_.GetSize())
+    {
+      std::memcpy(out,
+                  source_.GetData() + offset,
+                  (std::min)(len, source_.GetSize() - offset));
+    }
+  }
+
+  std::size_t GetSizeOfOptionalHeader() const noexcept
+  {
+    ImageFileHeader file_header;
+    std::memcpy(&file_header,
+                nt_headers_.data() + sizeof(std::uint32_t),
+                sizeof(file_header));
+    return file_header.SizeOfOptionalHeader;
+  }
+
+  std::uint64_t GetHeadersEnd(std::size_t num_sections) const noexcept
+  {
+    std::uint64_t const nt_headers_offset =
+      strip_dos_stub_ ? sizeof(ImageDosHeader)
+                      : static_cast<std::uint32_t>(dos_header_.e_lfanew);
+    return nt_headers_offset + kImageOptionalHeaderOffset +
+           GetSizeOfOptionalHeader() +
+           num_sections *
+             static_cast<std::uint64_t>(sizeof(ImageSectionHeader));
+  }
+
+  std::uint64_t GetFirstSectionRva() const noexcept
+  {
+    std::uint64_t first_rva = ~0ULL;
+    for (auto const& section : sections_)
+    {
+      if (!section.added)
+      {
+        first_rva = (std::min)(
+          first_rva, static_cast<std::uint64_t>(section.header.VirtualAddress));
+      }
+    }
+    return first_rva;
+  }
+
+  // Only sections which have been added or changed are checked, so files
+  // which were already malformed can still be rebuilt.
+  void CheckOverlaps(PeLayout const& layout,
+                     std::vector<std::uint64_t> const& virtual_ends) const
+  {
+    std::vector<std::size_t> order(sections_.size());
+    for (std::size_t i = 0; i < order.size(); ++i)
+    {
+      order[i] = i;
+    }
+    std::stable_sort(std::begin(order),
+                     std::end(order),
+                     [&](std::size_t lhs, std::size_t rhs) {
+                       return layout.sections[lhs].virtual_address <
+                              layout.sections[rhs].virtual_address;
+                     });
+
+    for (std::size_t i = 1; i < order.size(); ++i)
+    {
+      std::size_t const prev = order[i - 1];
+      std::size_t const cur = order[i];
+      if ((sections_[prev].changed || sections_[cur].changed) &&
+          virtual_ends[prev] > layout.sections[cur].virtual_address)
+      {
+        HADESMEM_DETAIL_THROW_EXCEPTION(
+          Error{} << ErrorString{"Overlapping sections."});
+      }
+    }
+  }
+
+  std::size_t GetOptionalHeaderFieldOffset(std::size_t offset_32,
+                                           std::size_t offset_64) const noexcept
+  {
+    return kImageOptionalHeaderOffset + (is_64_ ? offset_64 : offset_32);
+  }
+
+  template <typename T>
+  T GetOptionalHeaderField(std::size_t offset_32, std::size_t offset_64) const
+  {
+    T value;
+    std::size_t const offset =
+      GetOptionalHeaderFieldOffset(offset_32, offset_64);
+    std::memcpy(&value, &nt_headers_[offset], sizeof(value));
+    return value;
+  }
+
+  std::size_t GetDataDirOffsetUnchecked(PeDataDir data_dir) const noexcept
+  {
+    return GetOptionalHeaderFieldOffset(
+             offsetof(ImageOptionalHeader32, DataDirectory),
+             offsetof(ImageOptionalHeader64, DataDirectory)) +
+           static_cast<std::uint32_t>(data_dir) * sizeof(ImageDataDirectory);
+  }
+
+  // Whether the data directory is within both NumberOfRvaAndSizes and
+  // SizeOfOptionalHeader.
+  bool HasDataDir(PeDataDir data_dir) const noexcept
+  {
+    return static_cast<std::uint32_t>(data_dir) < num_rva_and_sizes_ &&
+           GetDataDirOffsetUnchecked(data_dir) + sizeof(ImageDataDirectory) <=
+             kImageOptionalHeaderOffset + GetSizeOfOptionalHeader();
+  }
+
+  std::size_t GetDataDirOffset(PeDataDir data_dir) const
+  {
+    if (!HasDataDir(data_dir))
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Data directory not present."});
+    }
+
+    return GetDataDirOffsetUnchecked(data_dir);
+  }
+
+  template <typename T>
+  static void PatchBuffer(std::vector<std::uint8_t>& buf,
+                          std::size_t offset,
+                          T const& value)
+  {
+    HADESMEM_DETAIL_ASSERT(offset + sizeof(value) <= buf.size());
+    std::memcpy(&buf[offset], &value, sizeof(value));
+  }
+
+  template <typename T> void PatchNtHeaders(std::size_t offset, T const& value)
+  {
+    PatchBuffer(nt_headers_, offset, value);
+  }
+
+  std::vector<std::uint8_t> GetFinalNtHeaders(PeLayout const& layout) const
+  {
+    std::vector<std::uint8_t> nt_headers = nt_headers_;
+    PatchBuffer(nt_headers,
+                sizeof(std::uint32_t) +
+                  offsetof(ImageFileHeader, NumberOfSections),
+                static_cast<std::uint16_t>(sections_.size()));
+    PatchBuffer(nt_headers,
+                GetOptionalHeaderFieldOffset(
+                  offsetof(ImageOptionalHeader32, SizeOfImage),
+                  offsetof(ImageOptionalHeader64, SizeOfImage)),
+                layout.size_of_image);
+    PatchBuffer(nt_headers,
+                GetOptionalHeaderFieldOffset(
+                  offsetof(ImageOptionalHeader32, SizeOfHeaders),
+                  offsetof(ImageOptionalHeader64, SizeOfHeaders)),
+                layout.size_of_headers);
+
+    if (HasDataDir(PeDataDir::Security))
+    {
+      PatchBuffer(nt_headers,
+                  GetDataDirOffset(PeDataDir::Security),
+                  ImageDataDirectory{});
+    }
+
+    // Bound imports are in the headers, so are overwritten if the section
+    // table has grown or moved.
+    if (HasDataDir(PeDataDir::BoundImport) &&
+        (GetHeadersEnd(sections_.size()) > original_section_table_end_ ||
+         strip_dos_stub_))
+    {
+      PatchBuffer(nt_headers,
+                  GetDataDirOffset(PeDataDir::BoundImport),
+                  ImageDataDirectory{});
+    }
+
+    if (has_import_dirs_)
+    {
+      PatchBuffer(
+        nt_headers, GetDataDirOffset(PeDataDir::Import), layout.import_dir);
+      PatchBuffer(nt_headers, GetDataDirOffset(PeDataDir::IAT), layout.iat_dir);
+    }
+
+    return nt_headers;
+  }
+
+  BufferSource source_;
+  bool is_64_;
+  ImageDosHeader dos_header_;
+  std::uint32_t size_of_headers_;
+  std::uint32_t section_alignment_;
+  std::uint32_t file_alignment_;
+  std::uint32_t num_rva_and_sizes_;
+  std::uint64_t original_section_table_end_{};
+  // Signature, file header and optional header.
+  std::vector<std::uint8_t> nt_headers_;
+  std::vector<Section> sections_;
+  bool strip_dos_stub_{};
+  std::vector<PeBuilderImportDir> import_dirs_;
+  std::size_t import_section_{};
+  bool has_import_dirs_{};
+};
+}
+}
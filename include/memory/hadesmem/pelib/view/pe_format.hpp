@@ -0,0 +1,496 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <winnt.h>
+#endif // #if defined(_WIN32)
+
+#include <hadesmem/detail/static_assert.hpp>
+
+// OS-independent definitions of the PE format structures used by the PeLib
+// views. Layout (and field names) match those in winnt.h, which is checked
+// below when building for Windows.
+//
+// The views (everything under pelib/view) are supposed to build and run on
+// other platforms too, so they must not depend on Process or anything else
+// Windows-only, other than behind _WIN32 (as in MappedFile). The same goes for
+// their tests.
+
+namespace hadesmem
+{
+namespace pelib
+{
+std::uint16_t const kImageDosSignature = 0x5A4D;
+std::uint32_t const kImageNtSignature = 0x00004550;
+std::uint16_t const kImageNtOptionalHdr32Magic = 0x10B;
+std::uint16_t const kImageNtOptionalHdr64Magic = 0x20B;
+std::uint16_t const kImageFileMachineI386 = 0x014C;
+std::uint16_t const kImageFileMachineAmd64 = 0x8664;
+std::uint32_t const kImageNumberOfDirectoryEntries = 16;
+std::uint32_t const kImageSizeOfShortName = 8;
+
+struct ImageDosHeader
+{
+  std::uint16_t e_magic;
+  std::uint16_t e_cblp;
+  std::uint16_t e_cp;
+  std::uint16_t e_crlc;
+  std::uint16_t e_cparhdr;
+  std::uint16_t e_minalloc;
+  std::uint16_t e_maxalloc;
+  std::uint16_t e_ss;
+  std::uint16_t e_sp;
+  std::uint16_t e_csum;
+  std::uint16_t e_ip;
+  std::uint16_t e_cs;
+  std::uint16_t e_lfarlc;
+  std::uint16_t e_ovno;
+  std::uint16_t e_res[4];
+  std::uint16_t e_oemid;
+  std::uint16_t e_oeminfo;
+  std::uint16_t e_res2[10];
+  std::int32_t e_lfanew;
+};
+
+struct ImageFileHeader
+{
+  std::uint16_t Machine;
+  std::uint16_t NumberOfSections;
+  std::uint32_t TimeDateStamp;
+  std::uint32_t PointerToSymbolTable;
+  std::uint32_t NumberOfSymbols;
+  std::uint16_t SizeOfOptionalHeader;
+  std::uint16_t Characteristics;
+};
+
+struct ImageDataDirectory
+{
+  std::uint32_t VirtualAddress;
+  std::uint32_t Size;
+};
+
+struct ImageOptionalHeader32
+{
+  std::uint16_t Magic;
+  std::uint8_t MajorLinkerVersion;
+  std::uint8_t MinorLinkerVersion;
+  std::uint32_t SizeOfCode;
+  std::uint32_t SizeOfInitializedData;
+  std::uint32_t SizeOfUninitializedData;
+  std::uint32_t AddressOfEntryPoint;
+  std::uint32_t BaseOfCode;
+  std::uint32_t BaseOfData;
+  std::uint32_t ImageBase;
+  std::uint32_t SectionAlignment;
+  std::uint32_t FileAlignment;
+  std::uint16_t MajorOperatingSystemVersion;
+  std::uint16_t MinorOperatingSystemVersion;
+  std::uint16_t MajorImageVersion;
+  std::uint16_t MinorImageVersion;
+  std::uint16_t MajorSubsystemVersion;
+  std::uint16_t MinorSubsystemVersion;
+  std::uint32_t Win32VersionValue;
+  std::uint32_t SizeOfImage;
+  std::uint32_t SizeOfHeaders;
+  std::uint32_t CheckSum;
+  std::uint16_t Subsystem;
+  std::uint16_t DllCharacteristics;
+  std::uint32_t SizeOfStackReserve;
+  std::uint32_t SizeOfStackCommit;
+  std::uint32_t SizeOfHeapReserve;
+  std::uint32_t SizeOfHeapCommit;
+  std::uint32_t LoaderFlags;
+  std::uint32_t NumberOfRvaAndSizes;
+  ImageDataDirectory DataDirectory[kImageNumberOfDirectoryEntries];
+};
+
+struct ImageOptionalHeader64
+{
+  std::uint16_t Magic;
+  std::uint8_t MajorLinkerVersion;
+  std::uint8_t MinorLinkerVersion;
+  std::uint32_t SizeOfCode;
+  std::uint32_t SizeOfInitializedData;
+  std::uint32_t SizeOfUninitializedData;
+  std::uint32_t AddressOfEntryPoint;
+  std::uint32_t BaseOfCode;
+  std::uint64_t ImageBase;
+  std::uint32_t SectionAlignment;
+  std::uint32_t FileAlignment;
+  std::uint16_t MajorOperatingSystemVersion;
+  std::uint16_t MinorOperatingSystemVersion;
+  std::uint16_t MajorImageVersion;
+  std::uint16_t MinorImageVersion;
+  std::uint16_t MajorSubsystemVersion;
+  std::uint16_t MinorSubsystemVersion;
+  std::uint32_t Win32VersionValue;
+  std::uint32_t SizeOfImage;
+  std::uint32_t SizeOfHeaders;
+  std::uint32_t CheckSum;
+  std::uint16_t Subsystem;
+  std::uint16_t DllCharacteristics;
+  std::uint64_t SizeOfStackReserve;
+  std::uint64_t SizeOfStackCommit;
+  std::uint64_t SizeOfHeapReserve;
+  std::uint64_t SizeOfHeapCommit;
+  std::uint32_t LoaderFlags;
+  std::uint32_t NumberOfRvaAndSizes;
+  ImageDataDirectory DataDirectory[kImageNumberOfDirectoryEntries];
+};
+
+// Misc is flattened to VirtualSize (PhysicalAddress is never used).
+struct ImageSectionHeader
+{
+  std::uint8_t Name[kImageSizeOfShortName];
+  std::uint32_t VirtualSize;
+  std::uint32_t VirtualAddress;
+  std::uint32_t SizeOfRawData;
+  std::uint32_t PointerToRawData;
+  std::uint32_t PointerToRelocations;
+  std::uint32_t PointerToLinenumbers;
+  std::uint16_t NumberOfRelocations;
+  std::uint16_t NumberOfLinenumbers;
+  std::uint32_t Characteristics;
+};
+
+std::uint32_t const kImageScnCntCode = 0x00000020;
+std::uint32_t const kImageScnMemExecute = 0x20000000;
+
+// x64 exception handling structures. The SDK only defines RUNTIME_FUNCTION
+// for x64 builds (and doesn't define UNWIND_INFO at all), but x64 files need
+// to be parsed from any build.
+std::uint8_t const kUnwFlagEHandler = 0x1;
+std::uint8_t const kUnwFlagUHandler = 0x2;
+std::uint8_t const kUnwFlagChainInfo = 0x4;
+
+// Set in UnwindInfoAddress when it is the RVA (plus one) of another
+// RUNTIME_FUNCTION whose unwind info is shared, rather than the RVA of an
+// UNWIND_INFO.
+std::uint32_t const kRuntimeFunctionIndirect = 0x1;
+
+struct ImageRuntimeFunctionEntry
+{
+  std::uint32_t BeginAddress;
+  std::uint32_t EndAddress;
+  std::uint32_t UnwindInfoAddress;
+};
+
+// Fixed size part of UNWIND_INFO. It is followed by CountOfCodes UNWIND_CODE
+// slots (padded to an even count), then either the chained RUNTIME_FUNCTION
+// or the exception handler RVA and handler data, depending on the flags.
+struct ImageUnwindInfoHeader
+{
+  // Version in the low 3 bits, flags in the high 5 bits.
+  std::uint8_t VersionAndFlags;
+  std::uint8_t SizeOfProlog;
+  std::uint8_t CountOfCodes;
+  // Frame register in the low 4 bits, scaled frame offset in the high 4 bits.
+  std::uint8_t FrameRegisterAndOffset;
+};
+
+// Resource directory structures. The SDK versions of the entry use bitfields,
+// which makes the flags awkward to check, so they're flattened here.
+std::uint32_t const kImageResourceNameIsString = 0x80000000;
+std::uint32_t const kImageResourceDataIsDirectory = 0x80000000;
+
+struct ImageResourceDirectory
+{
+  std::uint32_t Characteristics;
+  std::uint32_t TimeDateStamp;
+  std::uint16_t MajorVersion;
+  std::uint16_t MinorVersion;
+  std::uint16_t NumberOfNamedEntries;
+  std::uint16_t NumberOfIdEntries;
+};
+
+struct ImageResourceDirectoryEntry
+{
+  // Offset of an IMAGE_RESOURCE_DIR_STRING_U if kImageResourceNameIsString is
+  // set, otherwise the ID in the low 16 bits.
+  std::uint32_t Name;
+  // Offset of an ImageResourceDirectory if kImageResourceDataIsDirectory is
+  // set, otherwise the offset of an ImageResourceDataEntry. Offsets are
+  // relative to the start of the resource directory.
+  std::uint32_t OffsetToData;
+};
+
+struct ImageResourceDataEntry
+{
+  // An RVA, unlike the offsets in the directory entries.
+  std::uint32_t OffsetToData;
+  std::uint32_t Size;
+  std::uint32_t CodePage;
+  std::uint32_t Reserved;
+};
+
+// Set in Attributes when the descriptor's addresses are RVAs. Descriptors
+// emitted by old (VC6 era) linkers leave it clear and use VAs instead.
+std::uint32_t const kDelayLoadRvaBased = 0x1;
+
+struct ImageDelayLoadDescriptor
+{
+  std::uint32_t Attributes;
+  std::uint32_t DllNameRVA;
+  std::uint32_t ModuleHandleRVA;
+  std::uint32_t ImportAddressTableRVA;
+  std::uint32_t ImportNameTableRVA;
+  std::uint32_t BoundImportAddressTableRVA;
+  std::uint32_t UnloadInformationTableRVA;
+  std::uint32_t TimeDateStamp;
+};
+
+// Export, import and TLS directory structures. The unions in the SDK
+// versions are flattened to the member which is actually used.
+struct ImageExportDirectory
+{
+  std::uint32_t Characteristics;
+  std::uint32_t TimeDateStamp;
+  std::uint16_t MajorVersion;
+  std::uint16_t MinorVersion;
+  std::uint32_t Name;
+  std::uint32_t Base;
+  std::uint32_t NumberOfFunctions;
+  std::uint32_t NumberOfNames;
+  std::uint32_t AddressOfFunctions;
+  std::uint32_t AddressOfNames;
+  std::uint32_t AddressOfNameOrdinals;
+};
+
+std::uint32_t const kImageOrdinalFlag32 = 0x80000000;
+std::uint64_t const kImageOrdinalFlag64 = 0x8000000000000000ULL;
+
+struct ImageImportDescriptor
+{
+  std::uint32_t OriginalFirstThunk;
+  std::uint32_t TimeDateStamp;
+  std::uint32_t ForwarderChain;
+  std::uint32_t Name;
+  std::uint32_t FirstThunk;
+};
+
+// Unlike the other directories, the addresses in the TLS directory are VAs.
+struct ImageTlsDirectory32
+{
+  std::uint32_t StartAddressOfRawData;
+  std::uint32_t EndAddressOfRawData;
+  std::uint32_t AddressOfIndex;
+  std::uint32_t AddressOfCallBacks;
+  std::uint32_t SizeOfZeroFill;
+  std::uint32_t Characteristics;
+};
+
+struct ImageTlsDirectory64
+{
+  std::uint64_t StartAddressOfRawData;
+  std::uint64_t EndAddressOfRawData;
+  std::uint64_t AddressOfIndex;
+  std::uint64_t AddressOfCallBacks;
+  std::uint32_t SizeOfZeroFill;
+  std::uint32_t Characteristics;
+};
+
+// Base relocation block header. Followed by (SizeOfBlock - 8) / 2 entries,
+// each with the type in the high 4 bits and the offset from VirtualAddress in
+// the low 12 bits.
+std::uint16_t const kImageRelBasedAbsolute = 0;
+std::uint16_t const kImageRelBasedHigh = 1;
+std::uint16_t const kImageRelBasedLow = 2;
+std::uint16_t const kImageRelBasedHighLow = 3;
+std::uint16_t const kImageRelBasedHighAdj = 4;
+std::uint16_t const kImageRelBasedDir64 = 10;
+
+std::uint16_t const kImageFileRelocsStripped = 0x0001;
+
+struct ImageBaseRelocation
+{
+  std::uint32_t VirtualAddress;
+  std::uint32_t SizeOfBlock;
+};
+
+// Debug directory entry. The directory is an array of these, the number of
+// entries being the size in the data directory divided by sizeof(entry).
+std::uint32_t const kImageDebugTypeCodeView = 2;
+std::uint32_t const kImageDebugTypePogo = 13;
+std::uint32_t const kImageDebugTypeRepro = 16;
+
+struct ImageDebugDirectory
+{
+  std::uint32_t Characteristics;
+  std::uint32_t TimeDateStamp;
+  std::uint16_t MajorVersion;
+  std::uint16_t MinorVersion;
+  std::uint32_t Type;
+  std::uint32_t SizeOfData;
+  std::uint32_t AddressOfRawData;
+  std::uint32_t PointerToRawData;
+};
+
+// CodeView debug info written by the linker for PDBs from VC 7.0 onwards.
+// Followed by the null-terminated (UTF-8) path of the PDB.
+std::uint32_t const kCodeViewSignatureRsds = 0x53445352;
+
+struct CvInfoPdb70
+{
+  std::uint32_t CvSignature;
+  std::uint8_t Signature[16];
+  std::uint32_t Age;
+};
+
+// Load config directory, up to and including the CFG fields. Older images
+// have a smaller directory (Size is the number of bytes actually present),
+// and newer ones may have more fields after GuardFlags. Unlike most other
+// directories, the addresses are VAs.
+std::uint32_t const kImageGuardCfFunctionTableSizeMask = 0xF0000000;
+std::uint32_t const kImageGuardCfFunctionTableSizeShift = 28;
+
+struct ImageLoadConfigDirectory32
+{
+  std::uint32_t Size;
+  std::uint32_t TimeDateStamp;
+  std::uint16_t MajorVersion;
+  std::uint16_t MinorVersion;
+  std::uint32_t GlobalFlagsClear;
+  std::uint32_t GlobalFlagsSet;
+  std::uint32_t CriticalSectionDefaultTimeout;
+  std::uint32_t DeCommitFreeBlockThreshold;
+  std::uint32_t DeCommitTotalFreeThreshold;
+  std::uint32_t LockPrefixTable;
+  std::uint32_t MaximumAllocationSize;
+  std::uint32_t VirtualMemoryThreshold;
+  std::uint32_t ProcessHeapFlags;
+  std::uint32_t ProcessAffinityMask;
+  std::uint16_t CSDVersion;
+  std::uint16_t Reserved1;
+  std::uint32_t EditList;
+  std::uint32_t SecurityCookie;
+  std::uint32_t SEHandlerTable;
+  std::uint32_t SEHandlerCount;
+  std::uint32_t GuardCFCheckFunctionPointer;
+  std::uint32_t GuardCFDispatchFunctionPointer;
+  std::uint32_t GuardCFFunctionTable;
+  std::uint32_t GuardCFFunctionCount;
+  std::uint32_t GuardFlags;
+};
+
+// Note that the last field leaves 4 bytes of trailing padding, so the size
+// of the directory with all of these fields present is 148 (not sizeof).
+struct ImageLoadConfigDirectory64
+{
+  std::uint32_t Size;
+  std::uint32_t TimeDateStamp;
+  std::uint16_t MajorVersion;
+  std::uint16_t MinorVersion;
+  std::uint32_t GlobalFlagsClear;
+  std::uint32_t GlobalFlagsSet;
+  std::uint32_t CriticalSectionDefaultTimeout;
+  std::uint64_t DeCommitFreeBlockThreshold;
+  std::uint64_t DeCommitTotalFreeThreshold;
+  std::uint64_t LockPrefixTable;
+  std::uint64_t MaximumAllocationSize;
+  std::uint64_t VirtualMemoryThreshold;
+  std::uint64_t ProcessAffinityMask;
+  std::uint32_t ProcessHeapFlags;
+  std::uint16_t CSDVersion;
+  std::uint16_t Reserved1;
+  std::uint64_t EditList;
+  std::uint64_t SecurityCookie;
+  std::uint64_t SEHandlerTable;
+  std::uint64_t SEHandlerCount;
+  std::uint64_t GuardCFCheckFunctionPointer;
+  std::uint64_t GuardCFDispatchFunctionPointer;
+  std::uint64_t GuardCFFunctionTable;
+  std::uint64_t GuardCFFunctionCount;
+  std::uint32_t GuardFlags;
+};
+
+// Offset of the optional header from the start of the NT headers (i.e.
+// sizeof(Signature) + sizeof(IMAGE_FILE_HEADER)).
+std::uint32_t const kImageOptionalHeaderOffset =
+  sizeof(std::uint32_t) + sizeof(ImageFileHeader);
+
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageDosHeader) == 64);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageFileHeader) == 20);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageDataDirectory) == 8);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageOptionalHeader32) == 224);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageOptionalHeader64) == 240);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageSectionHeader) == 40);
+HADESMEM_DETAIL_STATIC_ASSERT(kImageOptionalHeaderOffset == 24);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageRuntimeFunctionEntry) == 12);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageUnwindInfoHeader) == 4);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageResourceDirectory) == 16);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageResourceDirectoryEntry) == 8);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageResourceDataEntry) == 16);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageDelayLoadDescriptor) == 32);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageExportDirectory) == 40);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageImportDescriptor) == 20);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageTlsDirectory32) == 24);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageTlsDirectory64) == 40);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageBaseRelocation) == 8);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageDebugDirectory) == 28);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(CvInfoPdb70) == 24);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageLoadConfigDirectory32) == 92);
+HADESMEM_DETAIL_STATIC_ASSERT(offsetof(ImageLoadConfigDirectory64,
+                                       SEHandlerCount) == 104);
+HADESMEM_DETAIL_STATIC_ASSERT(offsetof(ImageLoadConfigDirectory64,
+                                       GuardFlags) == 144);
+
+#if defined(_WIN32)
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageDosHeader) ==
+                              sizeof(IMAGE_DOS_HEADER));
+HADESMEM_DETAIL_STATIC_ASSERT(offsetof(ImageDosHeader, e_lfanew) ==
+                              offsetof(IMAGE_DOS_HEADER, e_lfanew));
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageFileHeader) ==
+                              sizeof(IMAGE_FILE_HEADER));
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageOptionalHeader32) ==
+                              sizeof(IMAGE_OPTIONAL_HEADER32));
+HADESMEM_DETAIL_STATIC_ASSERT(
+  offsetof(ImageOptionalHeader32, DataDirectory) ==
+  offsetof(IMAGE_OPTIONAL_HEADER32, DataDirectory));
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageOptionalHeader64) ==
+                              sizeof(IMAGE_OPTIONAL_HEADER64));
+HADESMEM_DETAIL_STATIC_ASSERT(
+  offsetof(ImageOptionalHeader64, DataDirectory) ==
+  offsetof(IMAGE_OPTIONAL_HEADER64, DataDirectory));
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageSectionHeader) ==
+                              sizeof(IMAGE_SECTION_HEADER));
+HADESMEM_DETAIL_STATIC_ASSERT(kImageOptionalHeaderOffset ==
+                              offsetof(IMAGE_NT_HEADERS, OptionalHeader));
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageResourceDirectory) ==
+                              sizeof(IMAGE_RESOURCE_DIRECTORY));
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageResourceDirectoryEntry) ==
+                              sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY));
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageResourceDataEntry) ==
+                              sizeof(IMAGE_RESOURCE_DATA_ENTRY));
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageDelayLoadDescriptor) ==
+                              sizeof(IMAGE_DELAYLOAD_DESCRIPTOR));
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageBaseRelocation) ==
+                              sizeof(IMAGE_BASE_RELOCATION));
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageExportDirectory) ==
+                              sizeof(IMAGE_EXPORT_DIRECTORY));
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageImportDescriptor) ==
+                              sizeof(IMAGE_IMPORT_DESCRIPTOR));
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageTlsDirectory32) ==
+                              sizeof(IMAGE_TLS_DIRECTORY32));
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageTlsDirectory64) ==
+                              sizeof(IMAGE_TLS_DIRECTORY64));
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageDebugDirectory) ==
+                              sizeof(IMAGE_DEBUG_DIRECTORY));
+HADESMEM_DETAIL_STATIC_ASSERT(
+  offsetof(ImageLoadConfigDirectory32, GuardFlags) ==
+  offsetof(IMAGE_LOAD_CONFIG_DIRECTORY32, GuardFlags));
+HADESMEM_DETAIL_STATIC_ASSERT(
+  offsetof(ImageLoadConfigDirectory64, GuardFlags) ==
+  offsetof(IMAGE_LOAD_CONFIG_DIRECTORY64, GuardFlags));
+#if defined(_M_AMD64)
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(ImageRuntimeFunctionEntry) ==
+                              sizeof(IMAGE_RUNTIME_FUNCTION_ENTRY));
+#endif // #if defined(_M_AMD64)
+#endif // #if defined(_WIN32)
+}
+}
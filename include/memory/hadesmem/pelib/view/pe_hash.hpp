@@ -0,0 +1,408 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/sha.hpp>
+#include <hadesmem/detail/static_assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_headers.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+
+#if defined(HADESMEM_DETAIL_SSE2)
+#include <emmintrin.h>
+#endif // #if defined(HADESMEM_DETAIL_SSE2)
+
+// Streaming PE checksum and Authenticode image hash. Both take the file a
+// chunk at a time, in order, with chunks of any size (e.g. successive windows
+// of a mapped file, or the buffers from a series of ReadFile calls), so the
+// whole file never needs to be in memory at once.
+
+// TODO: Hash the sections in PointerToRawData order as the Authenticode spec
+// describes, rather than in file order. They are only different for files
+// with sections out of order or overlapping, which signtool won't sign anyway.
+
+namespace hadesmem
+{
+namespace pelib
+{
+namespace detail
+{
+// Processed per pass of the SSE2 loop before the 32-bit lanes are folded
+// into the total. Each pass adds at most 2 * 0xFFFF to each lane.
+std::size_t const kPeChecksumMaxBlocks = 0x4000;
+
+// Sum of the little endian 16-bit words in [p, p + len). len must be even.
+// Returned unfolded, as the fold is the same no matter when it is done (the
+// checksum is a ones' complement sum).
+inline std::uint64_t PeChecksumSum(std::uint8_t const* p,
+                                   std::size_t len) noexcept
+{
+  std::uint64_t sum = 0;
+
+#if defined(HADESMEM_DETAIL_SSE2)
+  __m128i const zero = _mm_setzero_si128();
+  while (len >= 16)
+  {
+    std::size_t const num_blocks = (std::min)(len / 16, kPeChecksumMaxBlocks);
+    __m128i acc = zero;
+    for (std::size_t i = 0; i < num_blocks; ++i, p += 16)
+    {
+      __m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+      acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+      acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+    }
+    len -= num_blocks * 16;
+
+    std::uint32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    sum += static_cast<std::uint64_t>(lanes[0]) + lanes[1] + lanes[2] +
+           lanes[3];
+  }
+#endif // #if defined(HADESMEM_DETAIL_SSE2)
+
+  for (; len >= 2; len -= 2, p += 2)
+  {
+    sum += static_cast<std::uint64_t>(p[0] | (p[1] << 8));
+  }
+
+  return sum;
+}
+
+inline std::uint32_t PeChecksumFold(std::uint64_t sum) noexcept
+{
+  while (sum >> 16)
+  {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  }
+  return static_cast<std::uint32_t>(sum);
+}
+
+// Sorted, disjoint [beg, end) file ranges.
+using PeHashRanges = std::vector<std::pair<std::uint64_t, std::uint64_t>>;
+
+inline PeHashRanges MergePeHashRanges(PeHashRanges ranges)
+{
+  std::sort(std::begin(ranges), std::end(ranges));
+
+  PeHashRanges merged;
+  for (auto const& range : ranges)
+  {
+    if (range.first >= range.second)
+    {
+      continue;
+    }
+
+    if (!merged.empty() && range.first <= merged.back().second)
+    {
+      merged.back().second = (std::max)(merged.back().second, range.second);
+    }
+    else
+    {
+      merged.push_back(range);
+    }
+  }
+
+  return merged;
+}
+
+// Splits the chunk at [pos, pos + len) of the file at the given ranges, and
+// calls func(p, n, excluded) for each piece, in order.
+template <typename Func>
+void SplitPeHashChunk(std::uint64_t pos,
+                      std::uint8_t const* p,
+                      std::size_t len,
+                      PeHashRanges const& ranges,
+                      Func func)
+{
+  std::uint64_t const end = pos + len;
+  for (auto const& range : ranges)
+  {
+    if (pos == end || range.first >= end)
+    {
+      break;
+    }
+
+    if (range.second <= pos)
+    {
+      continue;
+    }
+
+    if (range.first > pos)
+    {
+      auto const n = static_cast<std::size_t>(range.first - pos);
+      func(p, n, false);
+      p += n;
+      pos += n;
+    }
+
+    auto const excluded_len =
+      static_cast<std::size_t>((std::min)(range.second, end) - pos);
+    func(p, excluded_len, true);
+    p += excluded_len;
+    pos += excluded_len;
+  }
+
+  if (pos != end)
+  {
+    func(p, static_cast<std::size_t>(end - pos), false);
+  }
+}
+}
+
+HADESMEM_DETAIL_STATIC_ASSERT(offsetof(ImageOptionalHeader32, CheckSum) ==
+                              offsetof(ImageOptionalHeader64, CheckSum));
+
+// File offset of the optional header's CheckSum field.
+inline std::uint64_t GetPeChecksumOffset(PeHeaders const& headers) noexcept
+{
+  return static_cast<std::uint64_t>(headers.GetNtHeadersOffset()) +
+         kImageOptionalHeaderOffset + offsetof(ImageOptionalHeader32, CheckSum);
+}
+
+// Ranges excluded from the Authenticode image hash: the CheckSum field, the
+// security data directory entry (if present), and the attribute certificate
+// table it points to. The latter is addressed by file offset, not RVA.
+inline detail::PeHashRanges
+  GetPeImageHashExcludedRanges(PeHeaders const& headers)
+{
+  std::uint64_t const checksum_offset = GetPeChecksumOffset(headers);
+  detail::PeHashRanges ranges{{checksum_offset, checksum_offset + 4}};
+
+  if (headers.HasDataDir(PeDataDir::Security))
+  {
+    std::uint64_t const data_dir_offset =
+      static_cast<std::uint64_t>(headers.GetNtHeadersOffset()) +
+      kImageOptionalHeaderOffset +
+      (headers.Is64() ? offsetof(ImageOptionalHeader64, DataDirectory)
+                      : offsetof(ImageOptionalHeader32, DataDirectory)) +
+      static_cast<std::uint32_t>(PeDataDir::Security) *
+        sizeof(ImageDataDirectory);
+    ranges.emplace_back(data_dir_offset,
+                        data_dir_offset + sizeof(ImageDataDirectory));
+
+    auto const security_dir = headers.GetDataDir(PeDataDir::Security);
+    if (security_dir.VirtualAddress && security_dir.Size)
+    {
+      ranges.emplace_back(security_dir.VirtualAddress,
+                          static_cast<std::uint64_t>(
+                            security_dir.VirtualAddress) +
+                            security_dir.Size);
+    }
+  }
+
+  return detail::MergePeHashRanges(std::move(ranges));
+}
+
+// The optional header checksum, as calculated by CheckSumMappedFile: the ones'
+// complement sum of the file as 16-bit words (with the CheckSum field taken as
+// zero, and an odd trailing byte zero extended), plus the file size.
+class PeChecksum
+{
+public:
+  explicit PeChecksum(std::uint64_t checksum_offset)
+    : excluded_{{checksum_offset, checksum_offset + 4}}
+  {
+  }
+
+  explicit PeChecksum(PeHeaders const& headers)
+    : PeChecksum{GetPeChecksumOffset(headers)}
+  {
+  }
+
+  void Update(void const* data, std::size_t len)
+  {
+    detail::SplitPeHashChunk(
+      pos_,
+      static_cast<std::uint8_t const*>(data),
+      len,
+      excluded_,
+      [this](std::uint8_t const* p, std::size_t n, bool excluded) {
+        if (excluded)
+        {
+          AddZeros(n);
+        }
+        else
+        {
+          AddBytes(p, n);
+        }
+      });
+    pos_ += len;
+  }
+
+  // The file size is the total amount of data passed to Update.
+  std::uint32_t GetChecksum() const noexcept
+  {
+    std::uint64_t const sum = sum_ + (has_odd_byte_ ? odd_byte_ : 0);
+    return detail::PeChecksumFold(sum) + static_cast<std::uint32_t>(pos_);
+  }
+
+private:
+  void AddBytes(std::uint8_t const* p, std::size_t n) noexcept
+  {
+    if (!n)
+    {
+      return;
+    }
+
+    if (has_odd_byte_)
+    {
+      sum_ += static_cast<std::uint64_t>(odd_byte_ | (p[0] << 8));
+      has_odd_byte_ = false;
+      ++p;
+      --n;
+    }
+
+    std::size_t const even_len = n & ~static_cast<std::size_t>(1);
+    sum_ += detail::PeChecksumSum(p, even_len);
+    if (n != even_len)
+    {
+      odd_byte_ = p[even_len];
+      has_odd_byte_ = true;
+    }
+  }
+
+  void AddZeros(std::size_t n) noexcept
+  {
+    if (!n)
+    {
+      return;
+    }
+
+    if (has_odd_byte_)
+    {
+      sum_ += odd_byte_;
+      has_odd_byte_ = false;
+      --n;
+    }
+
+    if (n % 2)
+    {
+      odd_byte_ = 0;
+      has_odd_byte_ = true;
+    }
+  }
+
+  detail::PeHashRanges excluded_;
+  std::uint64_t pos_{};
+  std::uint64_t sum_{};
+  std::uint8_t odd_byte_{};
+  bool has_odd_byte_{};
+};
+
+// Authenticode image hash (the digest signed in a file's certificate), using
+// either ::hadesmem::detail::Sha1 or ::hadesmem::detail::Sha256.
+template <typename Hasher> class PeImageHasher
+{
+public:
+  using Digest = typename Hasher::Digest;
+
+  explicit PeImageHasher(PeHeaders const& headers)
+    : excluded_(GetPeImageHashExcludedRanges(headers))
+  {
+  }
+
+  void Update(void const* data, std::size_t len)
+  {
+    detail::SplitPeHashChunk(
+      pos_,
+      static_cast<std::uint8_t const*>(data),
+      len,
+      excluded_,
+      [this](std::uint8_t const* p, std::size_t n, bool excluded) {
+        if (!excluded)
+        {
+          hasher_.Update(p, n);
+        }
+      });
+    pos_ += len;
+  }
+
+  Digest Finalize()
+  {
+    pos_ = 0;
+    return hasher_.Finalize();
+  }
+
+private:
+  detail::PeHashRanges excluded_;
+  Hasher hasher_;
+  std::uint64_t pos_{};
+};
+
+namespace detail
+{
+// Chunk size used when hashing a whole source, so that mapped files are read
+// sequentially in reasonably sized pieces.
+std::size_t const kPeHashChunkSize = 1 << 20;
+
+template <typename Func>
+void ForEachPeHashSourceChunk(PeView const& view, Func func)
+{
+  if (view.GetType() != PeFileType::kData)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(
+      Error{} << ErrorString{"PE checksums and image hashes are only defined "
+                             "for data files."});
+  }
+
+  std::uint8_t const* const data = view.GetSource().GetData();
+  std::size_t const size = view.GetSource().GetSize();
+  for (std::size_t offset = 0; offset < size; offset += kPeHashChunkSize)
+  {
+    func(data + offset, (std::min)(kPeHashChunkSize, size - offset));
+  }
+}
+}
+
+inline std::uint32_t ComputePeChecksum(PeView const& view)
+{
+  PeChecksum checksum{view};
+  detail::ForEachPeHashSourceChunk(
+    view, [&](std::uint8_t const* p, std::size_t n) { checksum.Update(p, n); });
+  return checksum.GetChecksum();
+}
+
+template <typename Hasher>
+typename Hasher::Digest ComputePeImageHash(PeView const& view)
+{
+  PeImageHasher<Hasher> hasher{view};
+  detail::ForEachPeHashSourceChunk(
+    view, [&](std::uint8_t const* p, std::size_t n) { hasher.Update(p, n); });
+  return hasher.Finalize();
+}
+
+// Recalculates the checksum of the file in the buffer (e.g. a dumped module
+// after its headers have been fixed) and writes it to the CheckSum field.
+// Returns the new checksum.
+inline std::uint32_t UpdatePeChecksum(void* data, std::size_t size)
+{
+  PeView const view{BufferSource{data, size}, PeFileType::kData};
+  std::uint32_t const checksum = ComputePeChecksum(view);
+
+  std::uint64_t const checksum_offset = GetPeChecksumOffset(view);
+  if (!view.GetSource().Contains(static_cast<std::size_t>(checksum_offset),
+                                 sizeof(checksum)))
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(
+      Error{} << ErrorString{GetPeErrorString(PeError::kOutOfBounds)});
+  }
+
+  std::memcpy(static_cast<std::uint8_t*>(data) + checksum_offset,
+              &checksum,
+              sizeof(checksum));
+  return checksum;
+}
+}
+}
@@ -0,0 +1,625 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_result.hpp>
+#include <hadesmem/pelib/view/section_index.hpp>
+
+namespace hadesmem
+{
+namespace pelib
+{
+// Anomalies found while parsing the headers. None of them stop the headers
+// being parsed (the loader accepts most of them too), but they're worth
+// flagging when looking for malformed or suspicious files, and are found for
+// free as part of the parse.
+struct PeAnomalies
+{
+  enum : std::uint32_t
+  {
+    kNone = 0,
+    // The machine is neither I386 nor AMD64, or the optional header magic
+    // doesn't match it. PeView and NtHeaders reject these files.
+    kInvalidOptionalHeaderMagic = 1 << 0,
+    // The optional header runs off the end of the file (and is zero filled).
+    kTruncatedOptionalHeader = 1 << 1,
+    // SizeOfOptionalHeader isn't the size of the optional header for the
+    // architecture.
+    kNonStandardOptionalHeaderSize = 1 << 2,
+    // NumberOfRvaAndSizes is larger than the number of data directories.
+    kExtraDataDirs = 1 << 3,
+    // The section table starts past the end of the file.
+    kVirtualSectionTable = 1 << 4,
+    // Some of the section headers are past the end of the file.
+    kTruncatedSectionTable = 1 << 5,
+    kNoSections = 1 << 6,
+    // Two or more sections overlap in memory.
+    kOverlappingSections = 1 << 7,
+    // The raw data of a section runs past the end of the file.
+    kSectionOutsideFile = 1 << 8,
+    // SectionAlignment is smaller than a page.
+    kLowAlignment = 1 << 9,
+    // AddressOfEntryPoint is outside SizeOfImage.
+    kEntryPointOutsideImage = 1 << 10,
+    kInvalidFlagMaxValue = 1 << 11
+  };
+};
+
+// Immutable model of the DOS header, NT headers and section table of a PE file,
+// parsed once and then used to answer queries without any further reads.
+//
+// The source only needs to cover the headers (as long as it includes the
+// entire section table, or runs to the end of the file), which lets the
+// Process based types build a model from a single read. Bounds for RVA
+// conversion are based on file_size rather than the size of the source.
+//
+// Only the DOS and NT signatures are validated (same as RvaToVa historically
+// did). Use PeView for a fully validated view of a file.
+class PeHeaders
+{
+public:
+  static std::size_t const kInvalidOffset = static_cast<std::size_t>(-1);
+
+  explicit PeHeaders(BufferSource const& source,
+                     std::size_t file_size,
+                     PeFileType type)
+    : type_{type}, file_size_{file_size}
+  {
+    PeError const error = Parse(source);
+    if (error != PeError::kNone)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{GetPeErrorString(error)});
+    }
+  }
+
+  // Same as the constructor, but returns an error rather than throwing if the
+  // headers are invalid.
+  static PeResult<PeHeaders> TryParse(BufferSource const& source,
+                                      std::size_t file_size,
+                                      PeFileType type)
+  {
+    PeHeaders headers{type, file_size};
+    PeError const error = headers.Parse(source);
+    if (error != PeError::kNone)
+    {
+      return error;
+    }
+
+    return PeResult<PeHeaders>{std::move(headers)};
+  }
+
+  PeFileType GetType() const noexcept
+  {
+    return type_;
+  }
+
+  std::size_t GetFileSize() const noexcept
+  {
+    return file_size_;
+  }
+
+  bool Is64() const noexcept
+  {
+    return is_64_;
+  }
+
+  ImageDosHeader const& GetDosHeader() const noexcept
+  {
+    return dos_header_;
+  }
+
+  std::uint32_t GetNtHeadersOffset() const noexcept
+  {
+    return nt_headers_offset_;
+  }
+
+  std::uint32_t GetNtSignature() const noexcept
+  {
+    return nt_signature_;
+  }
+
+  ImageFileHeader const& GetFileHeader() const noexcept
+  {
+    return file_header_;
+  }
+
+  // Zeroed if the file is PE32+.
+  ImageOptionalHeader32 const& GetOptionalHeader32() const noexcept
+  {
+    return optional_header_32_;
+  }
+
+  // Zeroed if the file is PE32.
+  ImageOptionalHeader64 const& GetOptionalHeader64() const noexcept
+  {
+    return optional_header_64_;
+  }
+
+  std::uint16_t GetMagic() const noexcept
+  {
+    return is_64_ ? optional_header_64_.Magic : optional_header_32_.Magic;
+  }
+
+  std::uint64_t GetImageBase() const noexcept
+  {
+    return is_64_ ? optional_header_64_.ImageBase
+                  : optional_header_32_.ImageBase;
+  }
+
+  std::uint32_t GetAddressOfEntryPoint() const noexcept
+  {
+    return is_64_ ? optional_header_64_.AddressOfEntryPoint
+                  : optional_header_32_.AddressOfEntryPoint;
+  }
+
+  std::uint32_t GetSectionAlignment() const noexcept
+  {
+    return is_64_ ? optional_header_64_.SectionAlignment
+                  : optional_header_32_.SectionAlignment;
+  }
+
+  std::uint32_t GetFileAlignment() const noexcept
+  {
+    return is_64_ ? optional_header_64_.FileAlignment
+                  : optional_header_32_.FileAlignment;
+  }
+
+  std::uint32_t GetSizeOfImage() const noexcept
+  {
+    return is_64_ ? optional_header_64_.SizeOfImage
+                  : optional_header_32_.SizeOfImage;
+  }
+
+  std::uint32_t GetSizeOfHeaders() const noexcept
+  {
+    return is_64_ ? optional_header_64_.SizeOfHeaders
+                  : optional_header_32_.SizeOfHeaders;
+  }
+
+  std::uint32_t GetNumberOfRvaAndSizes() const noexcept
+  {
+    return is_64_ ? optional_header_64_.NumberOfRvaAndSizes
+                  : optional_header_32_.NumberOfRvaAndSizes;
+  }
+
+  std::uint32_t GetNumberOfRvaAndSizesClamped() const noexcept
+  {
+    return (std::min)(GetNumberOfRvaAndSizes(), kImageNumberOfDirectoryEntries);
+  }
+
+  bool HasDataDir(PeDataDir data_dir) const noexcept
+  {
+    return static_cast<std::uint32_t>(data_dir) <
+           GetNumberOfRvaAndSizesClamped();
+  }
+
+  // Data dirs beyond NumberOfRvaAndSizes are returned zeroed (i.e. the same
+  // as an empty one), rather than throwing like NtHeaders does.
+  ImageDataDirectory GetDataDir(PeDataDir data_dir) const noexcept
+  {
+    if (!HasDataDir(data_dir))
+    {
+      return ImageDataDirectory{};
+    }
+
+    auto const i = static_cast<std::uint32_t>(data_dir);
+    return is_64_ ? optional_header_64_.DataDirectory[i]
+                  : optional_header_32_.DataDirectory[i];
+  }
+
+  // The number of sections claimed by the file header. May be larger than
+  // GetSections().size() if some of the headers lie outside the file.
+  std::uint16_t GetNumberOfSections() const noexcept
+  {
+    return file_header_.NumberOfSections;
+  }
+
+  bool HasVirtualSectionTable() const noexcept
+  {
+    return virtual_section_table_;
+  }
+
+  std::size_t GetSectionTableOffset() const noexcept
+  {
+    return section_table_offset_;
+  }
+
+  std::vector<ImageSectionHeader> const& GetSections() const noexcept
+  {
+    return sections_;
+  }
+
+  // Converts an RVA to an offset into the file, or kInvalidOffset if it
+  // doesn't map to the file. This is what RvaToVa is built on, and handles all
+  // of the same corner cases, but is O(log n) in the number of sections.
+  // TODO: Add sample files for all the corner cases we're handling.
+  std::size_t RvaToOffset(std::uint32_t rva,
+                          bool* virtual_va = nullptr) const noexcept
+  {
+    std::size_t hint = 0;
+    return RvaToOffset(rva, virtual_va, hint);
+  }
+
+  // Same as calling RvaToOffset for each RVA, but cheaper for runs of RVAs in
+  // the same section (see SectionIndex::FindRvas).
+  void RvasToOffsets(std::uint32_t const* rvas,
+                     std::size_t count,
+                     std::size_t* offsets) const noexcept
+  {
+    std::size_t hint = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      offsets[i] = RvaToOffset(rvas[i], nullptr, hint);
+    }
+  }
+
+  SectionIndex const& GetSectionIndex() const noexcept
+  {
+    return section_index_;
+  }
+
+  // Bitmask of PeAnomalies.
+  std::uint32_t GetAnomalies() const noexcept
+  {
+    return anomalies_;
+  }
+
+  bool HasAnomaly(std::uint32_t anomaly) const noexcept
+  {
+    return !!(anomalies_ & anomaly);
+  }
+
+  // Returns zero if the offset is not in any section.
+  std::uint32_t FileOffsetToRva(std::size_t file_offset) const noexcept
+  {
+    if (type_ == PeFileType::kImage)
+    {
+      return static_cast<std::uint32_t>(file_offset);
+    }
+
+    if (file_offset > (std::numeric_limits<std::uint32_t>::max)())
+    {
+      return 0;
+    }
+
+    std::uint32_t const index =
+      section_index_.FindFileOffset(static_cast<std::uint32_t>(file_offset));
+    if (index == SectionIndex::kInvalidIndex)
+    {
+      return 0;
+    }
+
+    ImageSectionHeader const& section = sections_[index];
+    return static_cast<std::uint32_t>(file_offset) -
+           section.PointerToRawData + section.VirtualAddress;
+  }
+
+private:
+  std::size_t RvaToOffset(std::uint32_t rva,
+                          bool* virtual_va,
+                          std::size_t& hint) const noexcept
+  {
+    if (virtual_va)
+    {
+      *virtual_va = false;
+    }
+
+    if (type_ == PeFileType::kImage)
+    {
+      return (rva && rva <= file_size_) ? rva : kInvalidOffset;
+    }
+
+    if (!rva)
+    {
+      return kInvalidOffset;
+    }
+
+    // A PE file can legally have zero sections, in which case the entire file
+    // is executable as though it were a single section whose size is equal to
+    // the SizeOfHeaders value rounded up to the nearest page.
+    // TODO: Confirm that the comment on rounding is correct, then implement it.
+    // In cases where the PE file has no sections it can apparently also have
+    // all sorts of messed up RVAs for data dirs etc... Make sure that none of
+    // them lie outside the file, because otherwise simply returning a direct
+    // offset from the base wouldn't work anyway...
+    if (!file_header_.NumberOfSections)
+    {
+      return rva > file_size_ ? kInvalidOffset : rva;
+    }
+
+    // SizeOfHeaders can be arbitrarily large, including the size of the entire
+    // file. RVAs inside the headers are treated as an offset from zero, rather
+    // than finding the 'true' location in a section.
+    // TODO: This probably needs some extra checks as some cases are probably
+    // invalid, but I don't know what the checks should be.
+    if (rva < GetSizeOfHeaders())
+    {
+      return (rva > file_size_ || rva > GetSizeOfImage()) ? kInvalidOffset
+                                                          : rva;
+    }
+
+    if (rva > GetSizeOfImage())
+    {
+      return kInvalidOffset;
+    }
+
+    // Virtual section table.
+    if (virtual_section_table_)
+    {
+      return rva > file_size_ ? kInvalidOffset : rva;
+    }
+
+    // Same result as checking each section in order and taking the first
+    // match, which is what the loader does.
+    std::uint32_t const index = section_index_.FindRva(rva, hint);
+    if (index != SectionIndex::kInvalidIndex)
+    {
+      ImageSectionHeader const& section = sections_[index];
+      std::uint32_t offset = rva - section.VirtualAddress;
+
+      // If the RVA is outside the raw data (which would put it in the
+      // zero-fill of the virtual data) it's invalid. Technically files like
+      // this will work when loaded by the PE loader due to the sections being
+      // mapped differently in memory to on disk, but if you want to inspect
+      // the file in that manner you should map it as an image instead.
+      if (offset > section.SizeOfRawData)
+      {
+        // It's useful to be able to detect this case as a user for things
+        // like exports, where typically a failure to resolve an RVA would be
+        // an error/suspicious, but not in the case of a data export where it
+        // is normal for the RVA to be in the zero fill of a data segment.
+        // TODO: Also check section characteristics?
+        if (offset < section.VirtualSize && virtual_va)
+        {
+          *virtual_va = true;
+        }
+
+        return kInvalidOffset;
+      }
+
+      // If PointerToRawData is less than 0x200 it is rounded down to 0.
+      // TODO: Check whether we actually need/want to force alignment here.
+      if (section.PointerToRawData >= 0x200)
+      {
+        offset += section.PointerToRawData & ~(GetFileAlignment() - 1);
+      }
+
+      return offset >= file_size_ ? kInvalidOffset : offset;
+    }
+
+    // For a virtual section header, the RVA is invalid. (Similar to above,
+    // except this time only the Nth entry onwards is virtual, rather than all
+    // the headers.) A linear scan would hit it before concluding that no
+    // section matches.
+    if (sections_.size() < file_header_.NumberOfSections)
+    {
+      return kInvalidOffset;
+    }
+
+    // Sometimes the RVA is at a lower address than any of the sections, in
+    // which case we treat the RVA as an offset from the module base (similar
+    // to when the image is loaded). Doing the same thing as in the
+    // SizeOfHeaders check above because we're not sure of better criteria to
+    // base it off. Only applies in low alignment, or if the RVA is smaller than
+    // the file alignment, otherwise it's invalid?
+    if (rva < min_virtual_address_ && rva < file_size_)
+    {
+      std::uint32_t const file_alignment = GetFileAlignment();
+      return (file_alignment < 200 || rva < file_alignment) ? rva
+                                                            : kInvalidOffset;
+    }
+
+    // Sample: nullSOH-XP (Corkami PE Corpus)
+    if (rva < GetSizeOfImage() && rva < file_size_)
+    {
+      return rva;
+    }
+
+    return kInvalidOffset;
+  }
+
+  explicit PeHeaders(PeFileType type, std::size_t file_size) noexcept
+    : type_{type}, file_size_{file_size}
+  {
+  }
+
+  PeError Parse(BufferSource const& source)
+  {
+    if (!file_size_)
+    {
+      return PeError::kInvalidFileSize;
+    }
+
+    auto const dos_header = source.TryRead<ImageDosHeader>(0);
+    if (!dos_header)
+    {
+      return dos_header.GetError();
+    }
+
+    dos_header_ = *dos_header;
+    if (dos_header_.e_magic != kImageDosSignature)
+    {
+      return PeError::kInvalidDosHeader;
+    }
+
+    // e_lfanew is signed, but a negative value is just a very large offset as
+    // far as we're concerned, which will fail the bounds check.
+    nt_headers_offset_ = static_cast<std::uint32_t>(dos_header_.e_lfanew);
+    auto const nt_signature =
+      source.TryRead<std::uint32_t>(nt_headers_offset_);
+    if (!nt_signature)
+    {
+      return nt_signature.GetError();
+    }
+
+    nt_signature_ = *nt_signature;
+    if (nt_signature_ != kImageNtSignature)
+    {
+      return PeError::kInvalidNtHeaders;
+    }
+
+    auto const file_header = source.TryRead<ImageFileHeader>(
+      nt_headers_offset_ + sizeof(std::uint32_t));
+    if (!file_header)
+    {
+      return file_header.GetError();
+    }
+
+    file_header_ = *file_header;
+    is_64_ = file_header_.Machine == kImageFileMachineAmd64;
+
+    // The optional header may be truncated by the end of the file in the case
+    // of tiny files, in which case the loader treats the rest as zero.
+    std::size_t const optional_header_offset =
+      nt_headers_offset_ + kImageOptionalHeaderOffset;
+    std::size_t const optional_header_size =
+      is_64_ ? sizeof(optional_header_64_) : sizeof(optional_header_32_);
+    std::size_t const optional_header_read =
+      is_64_ ? source.ReadTruncated(optional_header_offset, optional_header_64_)
+             : source.ReadTruncated(optional_header_offset, optional_header_32_);
+    if (optional_header_read < optional_header_size)
+    {
+      anomalies_ |= PeAnomalies::kTruncatedOptionalHeader;
+    }
+
+    if (file_header_.SizeOfOptionalHeader != optional_header_size)
+    {
+      anomalies_ |= PeAnomalies::kNonStandardOptionalHeaderSize;
+    }
+
+    // Only the section headers which are actually in the file are cached. The
+    // remainder (if any) are 'virtual' and handled specially when converting
+    // RVAs.
+    std::uint64_t const section_table_offset =
+      static_cast<std::uint64_t>(optional_header_offset) +
+      file_header_.SizeOfOptionalHeader;
+    virtual_section_table_ = section_table_offset >= file_size_;
+    if (!virtual_section_table_)
+    {
+      section_table_offset_ = static_cast<std::size_t>(section_table_offset);
+      std::size_t const num_sections =
+        (std::min)(static_cast<std::size_t>(file_header_.NumberOfSections),
+                   (file_size_ - section_table_offset_) /
+                     sizeof(ImageSectionHeader));
+      auto sections = source.TryReadVector<ImageSectionHeader>(
+        section_table_offset_, num_sections);
+      if (!sections)
+      {
+        return sections.GetError();
+      }
+
+      sections_ = std::move(*sections);
+      if (num_sections < file_header_.NumberOfSections)
+      {
+        anomalies_ |= PeAnomalies::kTruncatedSectionTable;
+      }
+    }
+    else if (file_header_.NumberOfSections)
+    {
+      anomalies_ |= PeAnomalies::kVirtualSectionTable;
+    }
+
+    BuildSectionTables();
+    FindAnomalies();
+
+    return PeError::kNone;
+  }
+
+  // Anomalies which only depend on the parsed headers. The rest are found
+  // while parsing.
+  void FindAnomalies() noexcept
+  {
+    if (GetMagic() != (is_64_ ? kImageNtOptionalHdr64Magic
+                              : kImageNtOptionalHdr32Magic) ||
+        file_header_.Machine !=
+          (is_64_ ? kImageFileMachineAmd64 : kImageFileMachineI386))
+    {
+      anomalies_ |= PeAnomalies::kInvalidOptionalHeaderMagic;
+    }
+
+    if (GetNumberOfRvaAndSizes() > kImageNumberOfDirectoryEntries)
+    {
+      anomalies_ |= PeAnomalies::kExtraDataDirs;
+    }
+
+    if (!file_header_.NumberOfSections)
+    {
+      anomalies_ |= PeAnomalies::kNoSections;
+    }
+
+    if (section_index_.HasVirtualOverlaps())
+    {
+      anomalies_ |= PeAnomalies::kOverlappingSections;
+    }
+
+    if (GetSectionAlignment() < 0x1000)
+    {
+      anomalies_ |= PeAnomalies::kLowAlignment;
+    }
+
+    if (GetAddressOfEntryPoint() >= GetSizeOfImage())
+    {
+      anomalies_ |= PeAnomalies::kEntryPointOutsideImage;
+    }
+
+    // Images don't have a file layout to check against.
+    if (type_ == PeFileType::kData)
+    {
+      for (auto const& section : sections_)
+      {
+        if (static_cast<std::uint64_t>(section.PointerToRawData) +
+              section.SizeOfRawData >
+            file_size_)
+        {
+          anomalies_ |= PeAnomalies::kSectionOutsideFile;
+          break;
+        }
+      }
+    }
+  }
+
+  void BuildSectionTables()
+  {
+    min_virtual_address_ = (std::numeric_limits<std::uint32_t>::max)();
+    for (auto const& section : sections_)
+    {
+      min_virtual_address_ =
+        (std::min)(min_virtual_address_, section.VirtualAddress);
+    }
+
+    section_index_ = SectionIndex{sections_};
+  }
+
+  PeFileType type_;
+  std::size_t file_size_;
+  bool is_64_{};
+  ImageDosHeader dos_header_ = ImageDosHeader{};
+  std::uint32_t nt_headers_offset_{};
+  std::uint32_t nt_signature_{};
+  ImageFileHeader file_header_ = ImageFileHeader{};
+  ImageOptionalHeader32 optional_header_32_ = ImageOptionalHeader32{};
+  ImageOptionalHeader64 optional_header_64_ = ImageOptionalHeader64{};
+  bool virtual_section_table_{};
+  std::size_t section_table_offset_{};
+  std::vector<ImageSectionHeader> sections_;
+  std::uint32_t min_virtual_address_{};
+  SectionIndex section_index_;
+  std::uint32_t anomalies_{};
+};
+}
+}
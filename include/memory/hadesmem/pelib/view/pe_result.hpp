@@ -0,0 +1,149 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/optional.hpp>
+#include <hadesmem/error.hpp>
+
+namespace hadesmem
+{
+namespace pelib
+{
+// Reason a non-throwing (Try*) parse or read failed. Each corresponds to an
+// error thrown by the equivalent throwing function.
+enum class PeError : std::uint32_t
+{
+  kNone,
+  kInvalidFileSize,
+  kOutOfBounds,
+  kInvalidDosHeader,
+  kInvalidNtHeaders,
+  kInvalidRva,
+  kInvalidSummary
+};
+
+inline char const* GetPeErrorString(PeError error) noexcept
+{
+  switch (error)
+  {
+  case PeError::kNone:
+    return "No error.";
+  case PeError::kInvalidFileSize:
+    return "Invalid file size.";
+  case PeError::kOutOfBounds:
+    return "Read out of bounds.";
+  case PeError::kInvalidDosHeader:
+    return "DOS header magic invalid.";
+  case PeError::kInvalidNtHeaders:
+    return "NT headers signature invalid.";
+  case PeError::kInvalidRva:
+    return "Invalid RVA.";
+  case PeError::kInvalidSummary:
+    return "Invalid or incompatible PE summary.";
+  }
+
+  return "Unknown error.";
+}
+
+// Either a value or the reason there isn't one. Returned by the Try*
+// functions, which never throw because of a malformed file (only on
+// allocation failure etc.), so scanning a large corpus doesn't spend most of
+// its time unwinding.
+//
+// The throwing API is implemented on top of these via GetValueOrThrow.
+template <typename T> class PeResult
+{
+public:
+  PeResult(T const& value) : value_{value}
+  {
+  }
+
+  PeResult(T&& value) : value_{std::move(value)}
+  {
+  }
+
+  PeResult(PeError error) noexcept : error_{error}
+  {
+    HADESMEM_DETAIL_ASSERT(error != PeError::kNone);
+  }
+
+  explicit operator bool() const noexcept
+  {
+    return HasValue();
+  }
+
+  bool HasValue() const noexcept
+  {
+    return !!value_;
+  }
+
+  PeError GetError() const noexcept
+  {
+    return error_;
+  }
+
+  T& GetValue() noexcept
+  {
+    HADESMEM_DETAIL_ASSERT(HasValue());
+    return value_.Get();
+  }
+
+  T const& GetValue() const noexcept
+  {
+    HADESMEM_DETAIL_ASSERT(HasValue());
+    return value_.Get();
+  }
+
+  T& operator*() noexcept
+  {
+    return GetValue();
+  }
+
+  T const& operator*() const noexcept
+  {
+    return GetValue();
+  }
+
+  T* operator->() noexcept
+  {
+    return &GetValue();
+  }
+
+  T const* operator->() const noexcept
+  {
+    return &GetValue();
+  }
+
+  T& GetValueOrThrow() &
+  {
+    ThrowIfError();
+    return value_.Get();
+  }
+
+  T GetValueOrThrow() &&
+  {
+    ThrowIfError();
+    return std::move(value_.Get());
+  }
+
+private:
+  void ThrowIfError() const
+  {
+    if (!HasValue())
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{GetPeErrorString(error_)});
+    }
+  }
+
+  ::hadesmem::detail::Optional<T> value_;
+  PeError error_{PeError::kNone};
+};
+}
+}
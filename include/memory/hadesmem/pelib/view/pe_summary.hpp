@@ -0,0 +1,1166 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/optional.hpp>
+#include <hadesmem/detail/sha.hpp>
+#include <hadesmem/detail/static_assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/base_relocation_table.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_headers.hpp>
+#include <hadesmem/pelib/view/pe_result.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+
+// Compact, position independent summary of a parsed PE file (headers,
+// section table, exports, imports and relocations), intended to be written to
+// disk once and then memory mapped on later runs rather than parsing the file
+// again (see PeSummaryCache).
+//
+// The layout is a fixed header followed by flat tables of fixed size records,
+// with all strings in a single pool at the end. Loading only checks that the
+// header and table bounds are sane, and the list types read records straight
+// out of the buffer as they are iterated, so there is no per-entry work until
+// an entry is actually used. Assumes a little endian target, which is all we
+// support anyway.
+
+namespace hadesmem
+{
+namespace pelib
+{
+// "HMPS"
+std::uint32_t const kPeSummaryMagic = 0x53504D48;
+
+// Must be bumped whenever the layout (or the meaning of any field) changes,
+// so that stale cache files are rebuilt rather than misread.
+std::uint32_t const kPeSummaryVersion = 1;
+
+// Stands in for a string offset when there is no string (e.g. exports by
+// ordinal).
+std::uint32_t const kPeSummaryNoString = 0xFFFFFFFF;
+
+using PeSummaryKey = ::hadesmem::detail::Sha256::Digest;
+
+struct PeSummaryFlags
+{
+  enum : std::uint32_t
+  {
+    kNone = 0,
+    kIs64 = 1 << 0,
+    // Summarizes an image rather than a data file (see PeFileType).
+    kImage = 1 << 1,
+    // The relocation directory is malformed (BaseRelocationTable throws), so
+    // the relocation summary is empty.
+    kInvalidRelocations = 1 << 2,
+    kInvalidFlagMaxValue = 1 << 3
+  };
+};
+
+struct PeSummaryTable
+{
+  std::uint32_t offset;
+  std::uint32_t count;
+};
+
+struct PeSummaryHeader
+{
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t size;
+  std::uint32_t flags;
+  std::uint64_t file_size;
+  // SHA-256 of the summarized file.
+  std::uint8_t content_hash[32];
+  ImageFileHeader file_header;
+  std::uint32_t anomalies;
+  // ImageOptionalHeader32 or ImageOptionalHeader64, depending on kIs64.
+  std::uint8_t optional_header[sizeof(ImageOptionalHeader64)];
+  std::uint32_t export_ordinal_base;
+  std::uint32_t export_module_name;
+  std::uint64_t reloc_end;
+  std::uint32_t num_relocs;
+  std::uint32_t reloc_types_seen;
+  // ImageSectionHeader.
+  PeSummaryTable sections;
+  // PeSummaryExportEntry, sorted by procedure number.
+  PeSummaryTable exports;
+  // std::uint32_t indexes into exports, sorted by name.
+  PeSummaryTable export_names;
+  // PeSummaryImportDirEntry.
+  PeSummaryTable import_dirs;
+  // PeSummaryImportThunkEntry.
+  PeSummaryTable import_thunks;
+  // Null-terminated strings. The last byte is always a null, so reading any
+  // offset within the pool always finds a terminator.
+  PeSummaryTable strings;
+};
+
+struct PeSummaryExportFlags
+{
+  enum : std::uint16_t
+  {
+    kNone = 0,
+    kByName = 1 << 0,
+    kForwarded = 1 << 1,
+    kInvalidFlagMaxValue = 1 << 2
+  };
+};
+
+struct PeSummaryExportEntry
+{
+  // Zero for forwarded exports.
+  std::uint32_t rva;
+  std::uint32_t name;
+  std::uint32_t forwarder;
+  std::uint16_t procedure_number;
+  std::uint16_t flags;
+};
+
+struct PeSummaryImportDirEntry
+{
+  std::uint32_t name;
+  std::uint32_t original_first_thunk;
+  std::uint32_t time_date_stamp;
+  std::uint32_t forwarder_chain;
+  std::uint32_t first_thunk;
+  // Range of this descriptor's entries in the thunk table.
+  std::uint32_t thunk_index;
+  std::uint32_t num_thunks;
+  std::uint32_t reserved;
+};
+
+struct PeSummaryImportThunkEntry
+{
+  // The raw thunk (from the ILT if there is one, otherwise the IAT).
+  std::uint64_t address_of_data;
+  std::uint32_t name;
+  std::uint16_t hint;
+  std::uint16_t by_ordinal;
+};
+
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(PeSummaryTable) == 8);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(PeSummaryHeader) == 392);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(PeSummaryExportEntry) == 16);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(PeSummaryImportDirEntry) == 32);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(PeSummaryImportThunkEntry) == 16);
+
+// Read-only view of a serialized summary (e.g. a mapped cache file). The
+// source is validated once on construction, after which every accessor is
+// noexcept.
+class PeSummary
+{
+public:
+  explicit PeSummary(BufferSource const& source)
+    : PeSummary{TryParse(source).GetValueOrThrow()}
+  {
+  }
+
+  static PeResult<PeSummary> TryParse(BufferSource const& source)
+  {
+    auto const header = source.TryRead<PeSummaryHeader>(0);
+    if (!header || !IsValid(*header, source))
+    {
+      return PeError::kInvalidSummary;
+    }
+
+    return PeSummary{source, *header};
+  }
+
+  BufferSource const& GetSource() const noexcept
+  {
+    return source_;
+  }
+
+  bool Is64() const noexcept
+  {
+    return !!(header_.flags & PeSummaryFlags::kIs64);
+  }
+
+  PeFileType GetType() const noexcept
+  {
+    return (header_.flags & PeSummaryFlags::kImage) ? PeFileType::kImage
+                                                    : PeFileType::kData;
+  }
+
+  std::uint32_t GetFlags() const noexcept
+  {
+    return header_.flags;
+  }
+
+  std::uint64_t GetFileSize() const noexcept
+  {
+    return header_.file_size;
+  }
+
+  PeSummaryKey GetContentHash() const noexcept
+  {
+    PeSummaryKey key;
+    std::memcpy(key.data(), header_.content_hash, key.size());
+    return key;
+  }
+
+  // PeAnomalies of the summarized file.
+  std::uint32_t GetAnomalies() const noexcept
+  {
+    return header_.anomalies;
+  }
+
+  ImageFileHeader const& GetFileHeader() const noexcept
+  {
+    return header_.file_header;
+  }
+
+  ImageOptionalHeader32 GetOptionalHeader32() const noexcept
+  {
+    HADESMEM_DETAIL_ASSERT(!Is64());
+    ImageOptionalHeader32 optional_header;
+    std::memcpy(&optional_header,
+                header_.optional_header,
+                sizeof(optional_header));
+    return optional_header;
+  }
+
+  ImageOptionalHeader64 GetOptionalHeader64() const noexcept
+  {
+    HADESMEM_DETAIL_ASSERT(Is64());
+    ImageOptionalHeader64 optional_header;
+    std::memcpy(&optional_header,
+                header_.optional_header,
+                sizeof(optional_header));
+    return optional_header;
+  }
+
+  std::uint64_t GetImageBase() const noexcept
+  {
+    return Is64() ? GetOptionalHeader64().ImageBase
+                  : GetOptionalHeader32().ImageBase;
+  }
+
+  std::uint32_t GetAddressOfEntryPoint() const noexcept
+  {
+    return Is64() ? GetOptionalHeader64().AddressOfEntryPoint
+                  : GetOptionalHeader32().AddressOfEntryPoint;
+  }
+
+  std::uint32_t GetSizeOfImage() const noexcept
+  {
+    return Is64() ? GetOptionalHeader64().SizeOfImage
+                  : GetOptionalHeader32().SizeOfImage;
+  }
+
+  // Same semantics as PeHeaders::GetDataDir.
+  ImageDataDirectory GetDataDir(PeDataDir data_dir) const noexcept
+  {
+    auto const i = static_cast<std::uint32_t>(data_dir);
+    if (Is64())
+    {
+      auto const optional_header = GetOptionalHeader64();
+      return i < optional_header.NumberOfRvaAndSizes &&
+                 i < kImageNumberOfDirectoryEntries
+               ? optional_header.DataDirectory[i]
+               : ImageDataDirectory{};
+    }
+
+    auto const optional_header = GetOptionalHeader32();
+    return i < optional_header.NumberOfRvaAndSizes &&
+               i < kImageNumberOfDirectoryEntries
+             ? optional_header.DataDirectory[i]
+             : ImageDataDirectory{};
+  }
+
+  // The section headers which were inside the file (see
+  // PeHeaders::GetSections).
+  std::uint32_t GetNumberOfSections() const noexcept
+  {
+    return header_.sections.count;
+  }
+
+  ImageSectionHeader GetSection(std::uint32_t index) const noexcept
+  {
+    return ReadRecord<ImageSectionHeader>(header_.sections, index);
+  }
+
+  std::uint32_t GetExportOrdinalBase() const noexcept
+  {
+    return header_.export_ordinal_base;
+  }
+
+  // Empty if there is no export directory.
+  char const* GetExportModuleName() const noexcept
+  {
+    return GetString(header_.export_module_name);
+  }
+
+  std::uint32_t GetNumberOfExports() const noexcept
+  {
+    return header_.exports.count;
+  }
+
+  std::uint32_t GetNumberOfImportDirs() const noexcept
+  {
+    return header_.import_dirs.count;
+  }
+
+  std::uint32_t GetNumberOfRelocations() const noexcept
+  {
+    return header_.num_relocs;
+  }
+
+  // Same as BaseRelocationTable::GetTypesSeen.
+  std::uint32_t GetRelocationTypesSeen() const noexcept
+  {
+    return header_.reloc_types_seen;
+  }
+
+  // Same as BaseRelocationTable::GetEnd.
+  std::uint64_t GetRelocationEnd() const noexcept
+  {
+    return header_.reloc_end;
+  }
+
+  // Raw record access for the list types. Out of range indexes return a
+  // zeroed record.
+
+  PeSummaryExportEntry GetExportEntry(std::uint32_t index) const noexcept
+  {
+    return ReadRecord<PeSummaryExportEntry>(header_.exports, index);
+  }
+
+  std::uint32_t GetExportNameIndex(std::uint32_t index) const noexcept
+  {
+    return ReadRecord<std::uint32_t>(header_.export_names, index);
+  }
+
+  std::uint32_t GetNumberOfExportNames() const noexcept
+  {
+    return header_.export_names.count;
+  }
+
+  PeSummaryImportDirEntry GetImportDirEntry(std::uint32_t index) const noexcept
+  {
+    return ReadRecord<PeSummaryImportDirEntry>(header_.import_dirs, index);
+  }
+
+  PeSummaryImportThunkEntry
+    GetImportThunkEntry(std::uint32_t index) const noexcept
+  {
+    return ReadRecord<PeSummaryImportThunkEntry>(header_.import_thunks, index);
+  }
+
+  std::uint32_t GetNumberOfImportThunks() const noexcept
+  {
+    return header_.import_thunks.count;
+  }
+
+  // Points directly into the source. Empty for kPeSummaryNoString (or any
+  // other offset outside the pool).
+  char const* GetString(std::uint32_t offset) const noexcept
+  {
+    if (offset >= header_.strings.count)
+    {
+      return "";
+    }
+
+    return reinterpret_cast<char const*>(source_.GetData() +
+                                         header_.strings.offset + offset);
+  }
+
+private:
+  explicit PeSummary(BufferSource const& source, PeSummaryHeader const& header)
+    : source_{source}, header_(header)
+  {
+  }
+
+  static bool IsValidTable(PeSummaryTable const& table,
+                           std::size_t record_size,
+                           std::size_t size) noexcept
+  {
+    return table.offset <= size &&
+           table.count <= (size - table.offset) / record_size;
+  }
+
+  static bool IsValid(PeSummaryHeader const& header,
+                      BufferSource const& source) noexcept
+  {
+    std::size_t const size = source.GetSize();
+    return header.magic == kPeSummaryMagic &&
+           header.version == kPeSummaryVersion && header.size == size &&
+           header.flags < PeSummaryFlags::kInvalidFlagMaxValue &&
+           IsValidTable(header.sections, sizeof(ImageSectionHeader), size) &&
+           IsValidTable(header.exports, sizeof(PeSummaryExportEntry), size) &&
+           IsValidTable(header.export_names, sizeof(std::uint32_t), size) &&
+           IsValidTable(
+             header.import_dirs, sizeof(PeSummaryImportDirEntry), size) &&
+           IsValidTable(
+             header.import_thunks, sizeof(PeSummaryImportThunkEntry), size) &&
+           IsValidTable(header.strings, 1, size) &&
+           (!header.strings.count ||
+            !source.GetData()[header.strings.offset + header.strings.count -
+                              1]);
+  }
+
+  template <typename T>
+  T ReadRecord(PeSummaryTable const& table, std::uint32_t index) const noexcept
+  {
+    HADESMEM_DETAIL_STATIC_ASSERT(std::is_trivial<T>::value);
+
+    T record;
+    if (index >= table.count)
+    {
+      std::memset(&record, 0, sizeof(record));
+      return record;
+    }
+
+    // Copied out, as nothing guarantees the source is suitably aligned.
+    std::memcpy(&record,
+                source_.GetData() + table.offset + index * sizeof(T),
+                sizeof(T));
+    return record;
+  }
+
+  BufferSource source_;
+  PeSummaryHeader header_;
+};
+
+namespace detail
+{
+// Input iterator over the records of a list type, constructing each value on
+// dereference (so there is no per-entry work for entries which are skipped).
+template <typename ListT, typename ValueT> class PeSummaryIterator
+{
+public:
+  using value_type = ValueT;
+  using difference_type = std::ptrdiff_t;
+  using pointer = ValueT const*;
+  using reference = ValueT;
+  using iterator_category = std::input_iterator_tag;
+
+  PeSummaryIterator() noexcept
+  {
+  }
+
+  explicit PeSummaryIterator(ListT const& list, std::uint32_t index) noexcept
+    : list_{&list}, index_{index}
+  {
+  }
+
+  reference operator*() const noexcept
+  {
+    HADESMEM_DETAIL_ASSERT(list_);
+    return list_->GetByIndex(index_);
+  }
+
+  PeSummaryIterator& operator++() noexcept
+  {
+    ++index_;
+    return *this;
+  }
+
+  PeSummaryIterator operator++(int) noexcept
+  {
+    PeSummaryIterator const iter{*this};
+    ++*this;
+    return iter;
+  }
+
+  bool operator==(PeSummaryIterator const& other) const noexcept
+  {
+    return index_ == other.index_;
+  }
+
+  bool operator!=(PeSummaryIterator const& other) const noexcept
+  {
+    return !(*this == other);
+  }
+
+private:
+  ListT const* list_{};
+  std::uint32_t index_{};
+};
+}
+
+// Equivalent of Export.
+class PeSummaryExport
+{
+public:
+  explicit PeSummaryExport(PeSummary const& summary,
+                           PeSummaryExportEntry const& entry) noexcept
+    : summary_{&summary}, entry_(entry)
+  {
+  }
+
+  std::uint32_t GetRva() const noexcept
+  {
+    return entry_.rva;
+  }
+
+  // Empty for exports by ordinal.
+  char const* GetName() const noexcept
+  {
+    return summary_->GetString(entry_.name);
+  }
+
+  std::uint16_t GetProcedureNumber() const noexcept
+  {
+    return entry_.procedure_number;
+  }
+
+  std::uint16_t GetOrdinalNumber() const noexcept
+  {
+    return static_cast<std::uint16_t>(entry_.procedure_number -
+                                      summary_->GetExportOrdinalBase());
+  }
+
+  bool ByName() const noexcept
+  {
+    return !!(entry_.flags & PeSummaryExportFlags::kByName);
+  }
+
+  bool ByOrdinal() const noexcept
+  {
+    return !ByName();
+  }
+
+  bool IsForwarded() const noexcept
+  {
+    return !!(entry_.flags & PeSummaryExportFlags::kForwarded);
+  }
+
+  // Empty unless forwarded.
+  char const* GetForwarder() const noexcept
+  {
+    return summary_->GetString(entry_.forwarder);
+  }
+
+private:
+  PeSummary const* summary_;
+  PeSummaryExportEntry entry_;
+};
+
+// Equivalent of ExportList, in order of procedure number. Also supports
+// lookup by name or procedure number in O(log n).
+class PeSummaryExportList
+{
+public:
+  using value_type = PeSummaryExport;
+  using iterator = detail::PeSummaryIterator<PeSummaryExportList, value_type>;
+  using const_iterator = iterator;
+
+  explicit PeSummaryExportList(PeSummary const& summary) noexcept
+    : summary_{&summary}
+  {
+  }
+
+  const_iterator begin() const noexcept
+  {
+    return const_iterator{*this, 0};
+  }
+
+  const_iterator end() const noexcept
+  {
+    return const_iterator{*this, size()};
+  }
+
+  std::uint32_t size() const noexcept
+  {
+    return summary_->GetNumberOfExports();
+  }
+
+  bool empty() const noexcept
+  {
+    return !size();
+  }
+
+  value_type GetByIndex(std::uint32_t index) const noexcept
+  {
+    return value_type{*summary_, summary_->GetExportEntry(index)};
+  }
+
+  ::hadesmem::detail::Optional<value_type> Find(char const* name) const
+  {
+    std::uint32_t lo = 0;
+    std::uint32_t hi = summary_->GetNumberOfExportNames();
+    while (lo < hi)
+    {
+      std::uint32_t const mid = lo + (hi - lo) / 2;
+      auto const entry =
+        summary_->GetExportEntry(summary_->GetExportNameIndex(mid));
+      int const cmp = std::strcmp(summary_->GetString(entry.name), name);
+      if (!cmp)
+      {
+        return ::hadesmem::detail::Optional<value_type>{
+          value_type{*summary_, entry}};
+      }
+
+      if (cmp < 0)
+      {
+        lo = mid + 1;
+      }
+      else
+      {
+        hi = mid;
+      }
+    }
+
+    return {};
+  }
+
+  ::hadesmem::detail::Optional<value_type>
+    Find(std::uint16_t procedure_number) const
+  {
+    std::uint32_t lo = 0;
+    std::uint32_t hi = size();
+    while (lo < hi)
+    {
+      std::uint32_t const mid = lo + (hi - lo) / 2;
+      auto const entry = summary_->GetExportEntry(mid);
+      if (entry.procedure_number == procedure_number)
+      {
+        return ::hadesmem::detail::Optional<value_type>{
+          value_type{*summary_, entry}};
+      }
+
+      if (entry.procedure_number < procedure_number)
+      {
+        lo = mid + 1;
+      }
+      else
+      {
+        hi = mid;
+      }
+    }
+
+    return {};
+  }
+
+private:
+  PeSummary const* summary_;
+};
+
+// Equivalent of ImportThunk.
+class PeSummaryImportThunk
+{
+public:
+  explicit PeSummaryImportThunk(PeSummary const& summary,
+                                PeSummaryImportThunkEntry const& entry) noexcept
+    : summary_{&summary}, entry_(entry)
+  {
+  }
+
+  std::uint64_t GetAddressOfData() const noexcept
+  {
+    return entry_.address_of_data;
+  }
+
+  bool ByOrdinal() const noexcept
+  {
+    return !!entry_.by_ordinal;
+  }
+
+  std::uint16_t GetOrdinal() const noexcept
+  {
+    return static_cast<std::uint16_t>(entry_.address_of_data & 0xFFFF);
+  }
+
+  // Zero for imports by ordinal.
+  std::uint16_t GetHint() const noexcept
+  {
+    return entry_.hint;
+  }
+
+  // Empty for imports by ordinal.
+  char const* GetName() const noexcept
+  {
+    return summary_->GetString(entry_.name);
+  }
+
+private:
+  PeSummary const* summary_;
+  PeSummaryImportThunkEntry entry_;
+};
+
+// Equivalent of ImportThunkList.
+class PeSummaryImportThunkList
+{
+public:
+  using value_type = PeSummaryImportThunk;
+  using iterator =
+    detail::PeSummaryIterator<PeSummaryImportThunkList, value_type>;
+  using const_iterator = iterator;
+
+  explicit PeSummaryImportThunkList(PeSummary const& summary,
+                                    std::uint32_t thunk_index,
+                                    std::uint32_t num_thunks) noexcept
+    : summary_{&summary}, thunk_index_{thunk_index}, num_thunks_{num_thunks}
+  {
+  }
+
+  const_iterator begin() const noexcept
+  {
+    return const_iterator{*this, 0};
+  }
+
+  const_iterator end() const noexcept
+  {
+    return const_iterator{*this, size()};
+  }
+
+  std::uint32_t size() const noexcept
+  {
+    return num_thunks_;
+  }
+
+  bool empty() const noexcept
+  {
+    return !size();
+  }
+
+  value_type GetByIndex(std::uint32_t index) const noexcept
+  {
+    return value_type{*summary_,
+                      summary_->GetImportThunkEntry(thunk_index_ + index)};
+  }
+
+private:
+  PeSummary const* summary_;
+  std::uint32_t thunk_index_;
+  std::uint32_t num_thunks_;
+};
+
+// Equivalent of ImportDir.
+class PeSummaryImportDir
+{
+public:
+  explicit PeSummaryImportDir(PeSummary const& summary,
+                              PeSummaryImportDirEntry const& entry) noexcept
+    : summary_{&summary}, entry_(entry)
+  {
+  }
+
+  char const* GetName() const noexcept
+  {
+    return summary_->GetString(entry_.name);
+  }
+
+  std::uint32_t GetOriginalFirstThunk() const noexcept
+  {
+    return entry_.original_first_thunk;
+  }
+
+  std::uint32_t GetTimeDateStamp() const noexcept
+  {
+    return entry_.time_date_stamp;
+  }
+
+  std::uint32_t GetForwarderChain() const noexcept
+  {
+    return entry_.forwarder_chain;
+  }
+
+  std::uint32_t GetFirstThunk() const noexcept
+  {
+    return entry_.first_thunk;
+  }
+
+  // Empty if the thunk range is outside the thunk table (which only happens
+  // if the summary has been tampered with).
+  PeSummaryImportThunkList GetThunks() const noexcept
+  {
+    std::uint32_t const num_thunks = summary_->GetNumberOfImportThunks();
+    bool const valid = entry_.thunk_index <= num_thunks &&
+                       entry_.num_thunks <= num_thunks - entry_.thunk_index;
+    return PeSummaryImportThunkList{
+      *summary_, entry_.thunk_index, valid ? entry_.num_thunks : 0};
+  }
+
+private:
+  PeSummary const* summary_;
+  PeSummaryImportDirEntry entry_;
+};
+
+// Equivalent of ImportDirList.
+class PeSummaryImportDirList
+{
+public:
+  using value_type = PeSummaryImportDir;
+  using iterator =
+    detail::PeSummaryIterator<PeSummaryImportDirList, value_type>;
+  using const_iterator = iterator;
+
+  explicit PeSummaryImportDirList(PeSummary const& summary) noexcept
+    : summary_{&summary}
+  {
+  }
+
+  const_iterator begin() const noexcept
+  {
+    return const_iterator{*this, 0};
+  }
+
+  const_iterator end() const noexcept
+  {
+    return const_iterator{*this, size()};
+  }
+
+  std::uint32_t size() const noexcept
+  {
+    return summary_->GetNumberOfImportDirs();
+  }
+
+  bool empty() const noexcept
+  {
+    return !size();
+  }
+
+  value_type GetByIndex(std::uint32_t index) const noexcept
+  {
+    return value_type{*summary_, summary_->GetImportDirEntry(index)};
+  }
+
+private:
+  PeSummary const* summary_;
+};
+
+// Parses a file via the views and serializes the result. Tables are read with
+// the non-throwing reads and cut short at the first invalid entry, the same
+// as a corpus scan would (so malformed files still get a summary of whatever
+// could be parsed).
+class PeSummaryBuilder
+{
+public:
+  explicit PeSummaryBuilder(PeView const& view) : view_{&view}
+  {
+  }
+
+  std::vector<std::uint8_t> Build()
+  {
+    PeSummaryHeader header{};
+    header.magic = kPeSummaryMagic;
+    header.version = kPeSummaryVersion;
+    header.flags |=
+      view_->Is64() ? PeSummaryFlags::kIs64 : PeSummaryFlags::kNone;
+    header.flags |= view_->GetType() == PeFileType::kImage
+                      ? PeSummaryFlags::kImage
+                      : PeSummaryFlags::kNone;
+    header.file_size = view_->GetSize();
+    auto const content_hash = ::hadesmem::detail::Sha256::Hash(
+      view_->GetSource().GetData(), view_->GetSize());
+    std::memcpy(
+      header.content_hash, content_hash.data(), sizeof(header.content_hash));
+    header.file_header = view_->GetFileHeader();
+    header.anomalies = view_->GetAnomalies();
+    if (view_->Is64())
+    {
+      auto const& optional_header = view_->GetOptionalHeader64();
+      std::memcpy(
+        header.optional_header, &optional_header, sizeof(optional_header));
+    }
+    else
+    {
+      auto const& optional_header = view_->GetOptionalHeader32();
+      std::memcpy(
+        header.optional_header, &optional_header, sizeof(optional_header));
+    }
+
+    SummarizeExports(header);
+    if (view_->Is64())
+    {
+      SummarizeImports(kImageOrdinalFlag64);
+    }
+    else
+    {
+      SummarizeImports(kImageOrdinalFlag32);
+    }
+    SummarizeRelocations(header);
+
+    auto const& sections = view_->GetSections();
+    std::vector<std::uint8_t> buf(sizeof(PeSummaryHeader));
+    header.sections = AppendTable(buf, sections);
+    header.exports = AppendTable(buf, exports_);
+    header.export_names = AppendTable(buf, export_names_);
+    header.import_dirs = AppendTable(buf, import_dirs_);
+    header.import_thunks = AppendTable(buf, import_thunks_);
+    header.strings = AppendTable(buf, strings_);
+    header.size = static_cast<std::uint32_t>(buf.size());
+
+    std::memcpy(buf.data(), &header, sizeof(header));
+    return buf;
+  }
+
+private:
+  // Bounds the thunks read in total to linear in the file size, even if
+  // every descriptor points at the same huge thunk array.
+  std::size_t GetMaxImportThunks() const noexcept
+  {
+    return view_->GetSize() / sizeof(std::uint32_t);
+  }
+
+  void SummarizeExports(PeSummaryHeader& header)
+  {
+    header.export_module_name = kPeSummaryNoString;
+
+    auto const dir_data = view_->GetDataDir(PeDataDir::Export);
+    if (!dir_data.VirtualAddress || !dir_data.Size)
+    {
+      return;
+    }
+
+    auto const dir = view_->TryReadRva<ImageExportDirectory>(
+      dir_data.VirtualAddress);
+    if (!dir)
+    {
+      return;
+    }
+
+    header.export_ordinal_base = dir->Base;
+    auto const module_name = view_->TryReadStringRva<char>(dir->Name);
+    if (module_name)
+    {
+      header.export_module_name = AddString(*module_name);
+    }
+
+    // Procedure numbers are only 16 bits (see Export), so anything past
+    // that can never be looked up anyway.
+    std::uint32_t const num_funcs = (std::min)(
+      dir->NumberOfFunctions, 0x10000 - (std::min)(dir->Base, 0x10000U));
+    auto const functions = view_->TryReadVectorRva<std::uint32_t>(
+      dir->AddressOfFunctions, num_funcs);
+    if (!functions)
+    {
+      return;
+    }
+
+    // Maps each ordinal number to the index of its name (if any). Later
+    // names win, the same as ExportTables.
+    std::vector<std::uint32_t> name_indexes(num_funcs, kPeSummaryNoString);
+    auto const names = view_->TryReadVectorRva<std::uint32_t>(
+      dir->AddressOfNames, dir->NumberOfNames);
+    auto const name_ordinals = view_->TryReadVectorRva<std::uint16_t>(
+      dir->AddressOfNameOrdinals, dir->NumberOfNames);
+    if (names && name_ordinals)
+    {
+      for (std::uint32_t i = 0; i < names->size(); ++i)
+      {
+        std::uint16_t const ordinal_number = (*name_ordinals)[i];
+        if (ordinal_number < num_funcs)
+        {
+          name_indexes[ordinal_number] = i;
+        }
+      }
+    }
+
+    std::uint32_t const dir_end = dir_data.VirtualAddress + dir_data.Size;
+    for (std::uint32_t i = 0; i < num_funcs; ++i)
+    {
+      std::uint32_t const func_rva = (*functions)[i];
+      if (!func_rva)
+      {
+        continue;
+      }
+
+      PeSummaryExportEntry entry{};
+      entry.procedure_number = static_cast<std::uint16_t>(i + dir->Base);
+      entry.name = kPeSummaryNoString;
+      entry.forwarder = kPeSummaryNoString;
+
+      if (name_indexes[i] != kPeSummaryNoString)
+      {
+        auto const name =
+          view_->TryReadStringRva<char>((*names)[name_indexes[i]]);
+        if (name)
+        {
+          entry.flags |= PeSummaryExportFlags::kByName;
+          entry.name = AddString(*name);
+        }
+      }
+
+      if (func_rva >= dir_data.VirtualAddress && func_rva + 4 < dir_end)
+      {
+        auto const forwarder = view_->TryReadStringRva<char>(func_rva);
+        if (forwarder)
+        {
+          entry.flags |= PeSummaryExportFlags::kForwarded;
+          entry.forwarder = AddString(*forwarder);
+        }
+      }
+      else
+      {
+        entry.rva = func_rva;
+      }
+
+      exports_.push_back(entry);
+    }
+
+    for (std::uint32_t i = 0; i < exports_.size(); ++i)
+    {
+      if (exports_[i].flags & PeSummaryExportFlags::kByName)
+      {
+        export_names_.push_back(i);
+      }
+    }
+
+    std::sort(std::begin(export_names_),
+              std::end(export_names_),
+              [&](std::uint32_t lhs, std::uint32_t rhs) {
+                return std::strcmp(GetString(exports_[lhs].name),
+                                   GetString(exports_[rhs].name)) < 0;
+              });
+  }
+
+  template <typename Thunk> void SummarizeImports(Thunk ordinal_flag)
+  {
+    auto const dir_data = view_->GetDataDir(PeDataDir::Import);
+    if (!dir_data.VirtualAddress)
+    {
+      return;
+    }
+
+    std::size_t const max_thunks = GetMaxImportThunks();
+    for (std::uint32_t rva = dir_data.VirtualAddress;;
+         rva += sizeof(ImageImportDescriptor))
+    {
+      auto const desc = view_->TryReadRva<ImageImportDescriptor>(rva);
+      if (!desc || !desc->FirstThunk)
+      {
+        break;
+      }
+
+      PeSummaryImportDirEntry entry{};
+      auto const name = view_->TryReadStringRva<char>(desc->Name);
+      entry.name = name ? AddString(*name) : kPeSummaryNoString;
+      entry.original_first_thunk = desc->OriginalFirstThunk;
+      entry.time_date_stamp = desc->TimeDateStamp;
+      entry.forwarder_chain = desc->ForwarderChain;
+      entry.first_thunk = desc->FirstThunk;
+      entry.thunk_index = static_cast<std::uint32_t>(import_thunks_.size());
+
+      std::uint32_t const thunks_rva = desc->OriginalFirstThunk
+                                         ? desc->OriginalFirstThunk
+                                         : desc->FirstThunk;
+      for (std::uint32_t thunk_rva = thunks_rva;
+           import_thunks_.size() < max_thunks;
+           thunk_rva += sizeof(Thunk))
+      {
+        auto const thunk = view_->TryReadRva<Thunk>(thunk_rva);
+        if (!thunk || !*thunk)
+        {
+          break;
+        }
+
+        PeSummaryImportThunkEntry thunk_entry{};
+        thunk_entry.address_of_data = *thunk;
+        thunk_entry.name = kPeSummaryNoString;
+        if (*thunk & ordinal_flag)
+        {
+          thunk_entry.by_ordinal = 1;
+        }
+        else
+        {
+          auto const by_name_rva = static_cast<std::uint32_t>(*thunk);
+          auto const hint = view_->TryReadRva<std::uint16_t>(by_name_rva);
+          auto const import_name = view_->TryReadStringRva<char>(
+            by_name_rva + sizeof(std::uint16_t));
+          thunk_entry.hint = hint ? *hint : 0;
+          if (import_name)
+          {
+            thunk_entry.name = AddString(*import_name);
+          }
+        }
+
+        import_thunks_.push_back(thunk_entry);
+      }
+
+      entry.num_thunks =
+        static_cast<std::uint32_t>(import_thunks_.size()) - entry.thunk_index;
+      import_dirs_.push_back(entry);
+    }
+  }
+
+  void SummarizeRelocations(PeSummaryHeader& header)
+  {
+    try
+    {
+      BaseRelocationTable const relocs{*view_};
+      header.num_relocs = static_cast<std::uint32_t>(relocs.size());
+      header.reloc_types_seen = relocs.GetTypesSeen();
+      header.reloc_end = relocs.GetEnd();
+    }
+    catch (Error const&)
+    {
+      header.flags |= PeSummaryFlags::kInvalidRelocations;
+    }
+  }
+
+  // Identical strings (e.g. the module names of split import descriptors)
+  // are only stored once.
+  std::uint32_t AddString(std::string const& str)
+  {
+    auto const iter = string_offsets_.find(str);
+    if (iter != std::end(string_offsets_))
+    {
+      return iter->second;
+    }
+
+    auto const offset = static_cast<std::uint32_t>(strings_.size());
+    strings_.insert(std::end(strings_), std::begin(str), std::end(str));
+    strings_.push_back('\0');
+    string_offsets_.emplace(str, offset);
+    return offset;
+  }
+
+  char const* GetString(std::uint32_t offset) const noexcept
+  {
+    return offset < strings_.size() ? &strings_[offset] : "";
+  }
+
+  // Tables are 8 byte aligned (relative to the start of the summary), so
+  // every record is naturally aligned if the summary itself is.
+  template <typename T>
+  static PeSummaryTable AppendTable(std::vector<std::uint8_t>& buf,
+                                    std::vector<T> const& records)
+  {
+    HADESMEM_DETAIL_STATIC_ASSERT(std::is_trivial<T>::value);
+
+    buf.resize((buf.size() + 7) & ~static_cast<std::size_t>(7));
+    PeSummaryTable const table{static_cast<std::uint32_t>(buf.size()),
+                               static_cast<std::uint32_t>(records.size())};
+    if (!records.empty())
+    {
+      auto const p = reinterpret_cast<std::uint8_t const*>(records.data());
+      buf.insert(std::end(buf), p, p + records.size() * sizeof(T));
+    }
+    return table;
+  }
+
+  PeView const* view_;
+  std::vector<PeSummaryExportEntry> exports_;
+  std::vector<std::uint32_t> export_names_;
+  std::vector<PeSummaryImportDirEntry> import_dirs_;
+  std::vector<PeSummaryImportThunkEntry> import_thunks_;
+  std::vector<char> strings_;
+  std::unordered_map<std::string, std::uint32_t> string_offsets_;
+};
+
+inline std::vector<std::uint8_t> BuildPeSummary(PeView const& view)
+{
+  return PeSummaryBuilder{view}.Build();
+}
+}
+}
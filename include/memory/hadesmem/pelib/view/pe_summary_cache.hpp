@@ -0,0 +1,234 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else // #if defined(_WIN32)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // #if defined(_WIN32)
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/optional.hpp>
+#include <hadesmem/detail/sha.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/mapped_file.hpp>
+#include <hadesmem/pelib/view/pe_summary.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+
+// TODO: Evict old entries (e.g. by last access time) once the cache grows
+// past a configurable size.
+
+namespace hadesmem
+{
+namespace pelib
+{
+// Directory of PeSummary files, each named after the SHA-256 of the file it
+// summarizes. A hit costs one hash of the file (to get the key) and one
+// mapping of the summary, rather than parsing the file again.
+//
+// Summaries are written to a temporary file (unique to the call) and then
+// renamed into place, so readers never see a partial file, and threads or
+// processes sharing a directory at worst build the same summary more than
+// once. Cache files which are invalid or from another version of the format
+// are treated as misses and replaced.
+class PeSummaryCache
+{
+public:
+  using PathT = MappedFile::PathT;
+
+  // The directory must already exist.
+  explicit PeSummaryCache(PathT const& dir) : dir_{dir}
+  {
+  }
+
+  PathT GetPath(PeSummaryKey const& key) const
+  {
+    PathT path = dir_;
+    if (!path.empty() && path.back() != '/' && path.back() != '\\')
+    {
+      path += '/';
+    }
+
+    char const digits[] = "0123456789abcdef";
+    for (std::uint8_t b : key)
+    {
+      path += static_cast<PathT::value_type>(digits[b >> 4]);
+      path += static_cast<PathT::value_type>(digits[b & 0xF]);
+    }
+
+    for (char c : ".pes")
+    {
+      if (c)
+      {
+        path += static_cast<PathT::value_type>(c);
+      }
+    }
+
+    return path;
+  }
+
+  // Empty if there is no valid summary for the key.
+  ::hadesmem::detail::Optional<PeSummary> Find(PeSummaryKey const& key) const
+  {
+    PathT const path = GetPath(key);
+    if (!IsNonEmptyFile(path))
+    {
+      return {};
+    }
+
+    auto summary =
+      PeSummary::TryParse(MapFileSource(path, MappedFileAccess::kRandom));
+    if (!summary || summary->GetContentHash() != key)
+    {
+      return {};
+    }
+
+    return ::hadesmem::detail::Optional<PeSummary>{std::move(*summary)};
+  }
+
+  // Returns the summary of the file, building and storing it first if it
+  // isn't already cached. Failing to store it (e.g. the directory is
+  // read-only or the disk is full) is not an error, as the summary is still
+  // valid; it will just be built again next time.
+  PeSummary Get(PeView const& view)
+  {
+    PeSummaryKey const key = ::hadesmem::detail::Sha256::Hash(
+      view.GetSource().GetData(), view.GetSize());
+    auto summary = Find(key);
+    if (summary)
+    {
+      return std::move(*summary);
+    }
+
+    std::vector<std::uint8_t> buf = BuildPeSummary(view);
+    try
+    {
+      Store(key, buf);
+    }
+    catch (std::exception const& /*e*/)
+    {
+      // Nothing to do here.
+    }
+
+    return PeSummary{BufferSource{std::move(buf)}};
+  }
+
+  // Throws if the summary can't be written. The temporary file is removed
+  // either way.
+  void Store(PeSummaryKey const& key, std::vector<std::uint8_t> const& buf)
+  {
+    PathT const path = GetPath(key);
+    PathT tmp_path = path;
+    std::string const tmp_suffix = std::to_string(GetProcessId()) + "." +
+                                   std::to_string(GetNextTmpId()) + ".tmp";
+    for (char c : tmp_suffix)
+    {
+      tmp_path += static_cast<PathT::value_type>(c);
+    }
+
+    bool written = false;
+    {
+      std::ofstream out{tmp_path, std::ios::binary | std::ios::trunc};
+      out.write(reinterpret_cast<char const*>(buf.data()),
+                static_cast<std::streamsize>(buf.size()));
+      out.close();
+      written = !!out;
+    }
+
+    if (!written)
+    {
+      RemoveFile(tmp_path);
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Failed to write PE summary."});
+    }
+
+    Rename(tmp_path, path);
+  }
+
+private:
+  // Distinguishes temporary files of concurrent stores within a process.
+  static std::uint32_t GetNextTmpId()
+  {
+    static std::atomic<std::uint32_t> next_id{0};
+    return next_id++;
+  }
+
+#if defined(_WIN32)
+  static bool IsNonEmptyFile(PathT const& path)
+  {
+    WIN32_FILE_ATTRIBUTE_DATA data{};
+    return ::GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data) &&
+           !(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+           (data.nFileSizeLow || data.nFileSizeHigh);
+  }
+
+  static std::uint32_t GetProcessId()
+  {
+    return ::GetCurrentProcessId();
+  }
+
+  static void RemoveFile(PathT const& path)
+  {
+    ::DeleteFileW(path.c_str());
+  }
+
+  static void Rename(PathT const& from, PathT const& to)
+  {
+    if (!::MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+      DWORD const last_error = ::GetLastError();
+      RemoveFile(from);
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"MoveFileExW failed."}
+                                      << ErrorCodeWinLast{last_error});
+    }
+  }
+#else  // #if defined(_WIN32)
+  static bool IsNonEmptyFile(PathT const& path)
+  {
+    struct stat file_stat = {};
+    return ::stat(path.c_str(), &file_stat) == 0 &&
+           S_ISREG(file_stat.st_mode) && file_stat.st_size > 0;
+  }
+
+  static std::uint32_t GetProcessId()
+  {
+    return static_cast<std::uint32_t>(::getpid());
+  }
+
+  static void RemoveFile(PathT const& path)
+  {
+    std::remove(path.c_str());
+  }
+
+  static void Rename(PathT const& from, PathT const& to)
+  {
+    if (std::rename(from.c_str(), to.c_str()))
+    {
+      int const last_error = errno;
+      RemoveFile(from);
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"rename failed."}
+                                      << boost::errinfo_errno{last_error});
+    }
+  }
+#endif // #if defined(_WIN32)
+
+  PathT dir_;
+};
+}
+}
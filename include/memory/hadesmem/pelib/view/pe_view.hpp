@@ -0,0 +1,149 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_headers.hpp>
+#include <hadesmem/pelib/view/pe_result.hpp>
+
+// TODO: Port the rest of PeLib (exports, imports, relocations, TLS, etc.) to
+// views, then reimplement the Process based types on top of them by reading
+// the relevant part of the target into a BufferSource.
+
+namespace hadesmem
+{
+namespace pelib
+{
+// OS-independent equivalent of PeFile + NtHeaders + SectionList, operating on a
+// BufferSource rather than a Process. The headers and section table are parsed
+// once on construction (see PeHeaders), so everything other than the Read*
+// functions is just a lookup into the cached data.
+//
+// Unlike PeHeaders, the NT headers are fully validated (the same as
+// NtHeaders).
+//
+// For PeFileType::kData the buffer is the raw file, for PeFileType::kImage it
+// is an image laid out as the loader would (e.g. a copy of a loaded module).
+//
+// The throwing functions are wrappers around the Try* functions, which return
+// a PeResult instead.
+class PeView : public PeHeaders
+{
+public:
+  explicit PeView(BufferSource const& source, PeFileType type)
+    : PeHeaders{source, source.GetSize(), type}, source_{source}
+  {
+    if (HasAnomaly(PeAnomalies::kInvalidOptionalHeaderMagic))
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{GetPeErrorString(PeError::kInvalidNtHeaders)});
+    }
+  }
+
+  static PeResult<PeView> TryParse(BufferSource const& source, PeFileType type)
+  {
+    auto headers = PeHeaders::TryParse(source, source.GetSize(), type);
+    if (!headers)
+    {
+      return headers.GetError();
+    }
+
+    if (headers->HasAnomaly(PeAnomalies::kInvalidOptionalHeaderMagic))
+    {
+      return PeError::kInvalidNtHeaders;
+    }
+
+    return PeView{std::move(*headers), source};
+  }
+
+  BufferSource const& GetSource() const noexcept
+  {
+    return source_;
+  }
+
+  std::size_t GetSize() const noexcept
+  {
+    return source_.GetSize();
+  }
+
+  std::uint8_t const* RvaToPtr(std::uint32_t rva,
+                               bool* virtual_va = nullptr) const noexcept
+  {
+    std::size_t const offset = RvaToOffset(rva, virtual_va);
+    return offset == kInvalidOffset ? nullptr : source_.GetData() + offset;
+  }
+
+  template <typename T> PeResult<T> TryReadRva(std::uint32_t rva) const
+  {
+    std::size_t const offset = RvaToOffset(rva);
+    if (offset == kInvalidOffset)
+    {
+      return PeError::kInvalidRva;
+    }
+
+    return source_.TryRead<T>(offset);
+  }
+
+  template <typename T>
+  PeResult<std::vector<T>> TryReadVectorRva(std::uint32_t rva,
+                                            std::size_t count) const
+  {
+    std::size_t const offset = RvaToOffset(rva);
+    if (offset == kInvalidOffset)
+    {
+      return PeError::kInvalidRva;
+    }
+
+    return source_.TryReadVector<T>(offset, count);
+  }
+
+  template <typename CharT>
+  PeResult<std::basic_string<CharT>> TryReadStringRva(std::uint32_t rva) const
+  {
+    std::size_t const offset = RvaToOffset(rva);
+    if (offset == kInvalidOffset)
+    {
+      return PeError::kInvalidRva;
+    }
+
+    return source_.TryReadString<CharT>(offset);
+  }
+
+  template <typename T> T ReadRva(std::uint32_t rva) const
+  {
+    return TryReadRva<T>(rva).GetValueOrThrow();
+  }
+
+  template <typename T>
+  std::vector<T> ReadVectorRva(std::uint32_t rva, std::size_t count) const
+  {
+    return TryReadVectorRva<T>(rva, count).GetValueOrThrow();
+  }
+
+  template <typename CharT>
+  std::basic_string<CharT> ReadStringRva(std::uint32_t rva) const
+  {
+    return TryReadStringRva<CharT>(rva).GetValueOrThrow();
+  }
+
+private:
+  explicit PeView(PeHeaders&& headers, BufferSource const& source)
+    : PeHeaders{std::move(headers)}, source_{source}
+  {
+  }
+
+  BufferSource source_;
+};
+}
+}
@@ -0,0 +1,352 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+
+namespace hadesmem
+{
+namespace pelib
+{
+namespace detail
+{
+// Disjoint, sorted set of [beg, end) intervals, each mapped to the index of the
+// first section (in header order) which covers it. Built from possibly
+// overlapping input ranges so that lookups give the same answer as a linear
+// scan of the section table, just in O(log n).
+class SectionIntervalTable
+{
+public:
+  SectionIntervalTable() noexcept
+  {
+  }
+
+  // Empty ranges (including those which wrap) are ignored, as they can never
+  // match in a linear scan either.
+  explicit SectionIntervalTable(
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> const& ranges)
+  {
+    struct Event
+    {
+      std::uint32_t pos;
+      bool add;
+      std::uint32_t index;
+    };
+
+    std::vector<Event> events;
+    events.reserve(ranges.size() * 2);
+    for (std::uint32_t i = 0; i < ranges.size(); ++i)
+    {
+      if (ranges[i].first < ranges[i].second)
+      {
+        events.push_back(Event{ranges[i].first, true, i});
+        events.push_back(Event{ranges[i].second, false, i});
+      }
+    }
+
+    std::sort(std::begin(events),
+              std::end(events),
+              [](Event const& lhs, Event const& rhs) {
+                return lhs.pos < rhs.pos;
+              });
+
+    // Sweep over the boundaries, tracking the set of active ranges. Each
+    // elementary interval belongs to the lowest active index.
+    std::set<std::uint32_t> active;
+    for (std::size_t i = 0; i < events.size();)
+    {
+      has_overlaps_ = has_overlaps_ || active.size() > 1;
+
+      std::uint32_t const pos = events[i].pos;
+      for (; i < events.size() && events[i].pos == pos; ++i)
+      {
+        if (events[i].add)
+        {
+          active.insert(events[i].index);
+        }
+        else
+        {
+          active.erase(events[i].index);
+        }
+      }
+
+      if (!intervals_.empty() && intervals_.back().end == 0)
+      {
+        intervals_.back().end = pos;
+      }
+
+      if (!active.empty())
+      {
+        std::uint32_t const index = *active.begin();
+        if (!intervals_.empty() && intervals_.back().end == pos &&
+            intervals_.back().index == index)
+        {
+          intervals_.back().end = 0;
+        }
+        else
+        {
+          intervals_.push_back(Interval{pos, 0, index});
+        }
+      }
+    }
+
+    HADESMEM_DETAIL_ASSERT(intervals_.empty() || intervals_.back().end != 0);
+  }
+
+  // Returns the index of the first range containing pos, or kInvalidIndex.
+  std::uint32_t Find(std::uint32_t pos) const noexcept
+  {
+    std::size_t hint = 0;
+    return Find(pos, hint);
+  }
+
+  // Same as above, but checks the interval found by the previous call first,
+  // so runs of nearby positions (e.g. sorted input) skip the search.
+  std::uint32_t Find(std::uint32_t pos, std::size_t& hint) const noexcept
+  {
+    if (hint < intervals_.size() && intervals_[hint].beg <= pos &&
+        pos < intervals_[hint].end)
+    {
+      return intervals_[hint].index;
+    }
+
+    std::size_t const i = LowerBound(pos);
+    if (i == intervals_.size() || pos < intervals_[i].beg)
+    {
+      return kInvalidIndex;
+    }
+
+    hint = i;
+    return intervals_[i].index;
+  }
+
+  // Returns the index of every range which is the first match for some
+  // position in [beg, end), sorted and without duplicates.
+  std::vector<std::uint32_t> FindRange(std::uint32_t beg,
+                                       std::uint32_t end) const
+  {
+    std::vector<std::uint32_t> indices;
+    if (beg >= end)
+    {
+      return indices;
+    }
+
+    for (std::size_t i = LowerBound(beg);
+         i < intervals_.size() && intervals_[i].beg < end;
+         ++i)
+    {
+      indices.push_back(intervals_[i].index);
+    }
+
+    std::sort(std::begin(indices), std::end(indices));
+    indices.erase(std::unique(std::begin(indices), std::end(indices)),
+                  std::end(indices));
+    return indices;
+  }
+
+  // Whether any position is covered by more than one range.
+  bool HasOverlaps() const noexcept
+  {
+    return has_overlaps_;
+  }
+
+  static std::uint32_t const kInvalidIndex = static_cast<std::uint32_t>(-1);
+
+private:
+  // An end of zero marks an interval which is still open during construction.
+  // Valid since every range is non-empty, so no interval can end at zero.
+  struct Interval
+  {
+    std::uint32_t beg;
+    std::uint32_t end;
+    std::uint32_t index;
+  };
+
+  // Index of the first interval which ends after pos.
+  std::size_t LowerBound(std::uint32_t pos) const noexcept
+  {
+    auto const iter = std::upper_bound(
+      std::begin(intervals_),
+      std::end(intervals_),
+      pos,
+      [](std::uint32_t p, Interval const& i) { return p < i.end; });
+    return static_cast<std::size_t>(iter - std::begin(intervals_));
+  }
+
+  std::vector<Interval> intervals_;
+  bool has_overlaps_{};
+};
+}
+
+// Where a section is, in memory and in the file. Ends are exclusive, and wrap
+// the same way the loader's arithmetic does (making the range empty).
+struct SectionIndexEntry
+{
+  std::uint32_t virtual_address;
+  // VirtualSize, or SizeOfRawData if that is zero (as for the loader).
+  std::uint32_t virtual_size;
+  std::uint32_t pointer_to_raw_data;
+  std::uint32_t size_of_raw_data;
+  std::uint32_t characteristics;
+
+  std::uint32_t GetVirtualEnd() const noexcept
+  {
+    return virtual_address + virtual_size;
+  }
+
+  std::uint32_t GetRawEnd() const noexcept
+  {
+    return pointer_to_raw_data + size_of_raw_data;
+  }
+};
+
+// Answers "which section contains this RVA/file offset" in O(log n), from
+// sorted interval tables built once from the section table. Where sections
+// overlap the first one in header order wins, the same as a linear scan of
+// the section table (and the loader).
+//
+// PeHeaders builds one as part of parsing, so every PeFile and PeView has one
+// already (see GetSectionIndex). Translating an RVA to a file offset has a
+// lot of corner cases outside of the sections (see PeHeaders::RvaToOffset),
+// so that is left to PeHeaders.
+class SectionIndex
+{
+public:
+  static std::uint32_t const kInvalidIndex =
+    detail::SectionIntervalTable::kInvalidIndex;
+
+  SectionIndex() noexcept
+  {
+  }
+
+  explicit SectionIndex(std::vector<ImageSectionHeader> const& sections)
+  {
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> virtual_ranges;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> raw_ranges;
+    entries_.reserve(sections.size());
+    virtual_ranges.reserve(sections.size());
+    raw_ranges.reserve(sections.size());
+    for (auto const& section : sections)
+    {
+      SectionIndexEntry const entry{
+        section.VirtualAddress,
+        section.VirtualSize ? section.VirtualSize : section.SizeOfRawData,
+        section.PointerToRawData,
+        section.SizeOfRawData,
+        section.Characteristics};
+      entries_.push_back(entry);
+      virtual_ranges.emplace_back(entry.virtual_address, entry.GetVirtualEnd());
+      raw_ranges.emplace_back(entry.pointer_to_raw_data, entry.GetRawEnd());
+    }
+
+    virtual_table_ = detail::SectionIntervalTable{virtual_ranges};
+    raw_table_ = detail::SectionIntervalTable{raw_ranges};
+  }
+
+  std::size_t GetNumberOfSections() const noexcept
+  {
+    return entries_.size();
+  }
+
+  // In header order, so the indices returned by the Find* functions index
+  // into both this and the section table.
+  std::vector<SectionIndexEntry> const& GetEntries() const noexcept
+  {
+    return entries_;
+  }
+
+  SectionIndexEntry const& GetEntry(std::uint32_t index) const noexcept
+  {
+    HADESMEM_DETAIL_ASSERT(index < entries_.size());
+    return entries_[index];
+  }
+
+  // Returns kInvalidIndex if no section contains the RVA.
+  std::uint32_t FindRva(std::uint32_t rva) const noexcept
+  {
+    return virtual_table_.Find(rva);
+  }
+
+  // Returns kInvalidIndex if no section contains the offset.
+  std::uint32_t FindFileOffset(std::uint32_t file_offset) const noexcept
+  {
+    return raw_table_.Find(file_offset);
+  }
+
+  // Same as FindRva, but checks the section found by the previous call first
+  // (hint starts at zero, and is updated by each call).
+  std::uint32_t FindRva(std::uint32_t rva, std::size_t& hint) const noexcept
+  {
+    return virtual_table_.Find(rva, hint);
+  }
+
+  // Same as calling FindRva for each RVA, but cheaper for runs of RVAs in the
+  // same section (e.g. sorted input, or a table of pointers into code).
+  void FindRvas(std::uint32_t const* rvas,
+                std::size_t count,
+                std::uint32_t* indices) const noexcept
+  {
+    std::size_t hint = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      indices[i] = virtual_table_.Find(rvas[i], hint);
+    }
+  }
+
+  // Same as calling FindFileOffset for each offset.
+  void FindFileOffsets(std::uint32_t const* file_offsets,
+                       std::size_t count,
+                       std::uint32_t* indices) const noexcept
+  {
+    std::size_t hint = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      indices[i] = raw_table_.Find(file_offsets[i], hint);
+    }
+  }
+
+  // Sections which FindRva returns for at least one RVA in [beg, end), in
+  // header order. O(log n + k).
+  std::vector<std::uint32_t> FindRvaRange(std::uint32_t beg,
+                                          std::uint32_t end) const
+  {
+    return virtual_table_.FindRange(beg, end);
+  }
+
+  // Sections which FindFileOffset returns for at least one offset in
+  // [beg, end), in header order. O(log n + k).
+  std::vector<std::uint32_t> FindFileOffsetRange(std::uint32_t beg,
+                                                 std::uint32_t end) const
+  {
+    return raw_table_.FindRange(beg, end);
+  }
+
+  // Whether any RVA is covered by more than one section.
+  bool HasVirtualOverlaps() const noexcept
+  {
+    return virtual_table_.HasOverlaps();
+  }
+
+  // Whether any file offset is covered by more than one section.
+  bool HasRawOverlaps() const noexcept
+  {
+    return raw_table_.HasOverlaps();
+  }
+
+private:
+  std::vector<SectionIndexEntry> entries_;
+  detail::SectionIntervalTable virtual_table_;
+  detail::SectionIntervalTable raw_table_;
+};
+}
+}
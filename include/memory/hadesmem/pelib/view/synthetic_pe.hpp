@@ -0,0 +1,793 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/pe_builder.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+
+// Generator for synthetic PE files, in the spirit of the Corkami PE corpus, so
+// PeLib can be tested (and benchmarked, and fuzzed) without a sample set of
+// real files, and on any OS.
+
+namespace hadesmem
+{
+namespace pelib
+{
+struct SyntheticPeFlags
+{
+  enum : std::uint32_t
+  {
+    kNone = 0,
+    // NumberOfSections is non-zero, but SizeOfOptionalHeader puts the section
+    // table past the end of the file. Everything is in the headers, which
+    // cover the whole file (with RVAs equal to file offsets).
+    // Sample: virtsectblXP.exe (Corkami PE Corpus)
+    kVirtualSectionTable = 1 << 0,
+    // No sections at all. Laid out the same as kVirtualSectionTable.
+    // Sample: nosectionXP.exe (Corkami PE Corpus)
+    kNoSections = 1 << 1,
+    // The export directory's module name is the last thing in the file, and is
+    // terminated by the end of the file rather than a null. Implies an export
+    // directory (possibly with no exports).
+    kEofTerminatedString = 1 << 2,
+    kInvalidFlagMaxValue = 1 << 3
+  };
+};
+
+// Everything defaults to zero, which gives a (32-bit) DLL with nothing but an
+// entry point.
+struct SyntheticPeOptions
+{
+  bool is_64{};
+  // Empty sections added after the ones holding the code and directories.
+  std::uint32_t num_extra_sections{};
+  // All exported by name (see GetSyntheticExportName), so at most 0xFFFF.
+  std::uint32_t num_exports{};
+  std::uint32_t num_import_modules{};
+  std::uint32_t num_imports_per_module{};
+  // Pointer sized, in a data section. The VAs in the TLS directory aren't
+  // relocated, so this is the exact number of relocations in the file.
+  std::uint32_t num_relocations{};
+  std::uint32_t num_tls_callbacks{};
+  // Bitmask of SyntheticPeFlags.
+  std::uint32_t flags{SyntheticPeFlags::kNone};
+};
+
+namespace detail
+{
+inline std::string GetSyntheticName(char const* prefix, std::uint32_t n)
+{
+  std::string const num = std::to_string(n);
+  return prefix + std::string(num.size() < 5 ? 5 - num.size() : 0, '0') + num;
+}
+
+inline std::uint32_t AlignSynthetic(std::uint32_t n, std::uint32_t alignment)
+{
+  return (n + alignment - 1) & ~(alignment - 1);
+}
+
+template <typename T>
+inline void
+  WriteSynthetic(std::vector<std::uint8_t>& buf, std::uint32_t pos, T const& t)
+{
+  HADESMEM_DETAIL_ASSERT(pos + sizeof(T) <= buf.size());
+  std::memcpy(&buf[pos], std::addressof(t), sizeof(T));
+}
+
+inline void WriteSyntheticString(std::vector<std::uint8_t>& buf,
+                                 std::uint32_t pos,
+                                 std::string const& str,
+                                 bool terminate = true)
+{
+  std::size_t const len = str.size() + (terminate ? 1 : 0);
+  HADESMEM_DETAIL_ASSERT(pos + len <= buf.size());
+  std::memcpy(&buf[pos], str.c_str(), len);
+}
+
+inline void WriteSyntheticPtr(std::vector<std::uint8_t>& buf,
+                              std::uint32_t pos,
+                              bool is_64,
+                              std::uint64_t ptr)
+{
+  if (is_64)
+  {
+    WriteSynthetic(buf, pos, ptr);
+  }
+  else
+  {
+    WriteSynthetic(buf, pos, static_cast<std::uint32_t>(ptr));
+  }
+}
+
+struct SyntheticSection
+{
+  char const* name;
+  std::uint32_t characteristics;
+  std::uint32_t size;
+  std::uint32_t rva;
+  std::uint32_t raw_offset;
+  std::uint32_t raw_size;
+};
+
+std::uint32_t const kSyntheticCode = 0x60000020;
+std::uint32_t const kSyntheticRData = 0x40000040;
+std::uint32_t const kSyntheticData = 0xC0000040;
+std::uint32_t const kSyntheticReloc = 0x42000040;
+
+template <typename OptionalHeader>
+inline void FillSyntheticOptionalHeader(OptionalHeader& optional_header,
+                                        std::uint32_t entry_point,
+                                        std::uint64_t image_base,
+                                        std::uint32_t section_alignment,
+                                        std::uint32_t file_alignment,
+                                        std::uint32_t image_size,
+                                        std::uint32_t headers_size,
+                                        bool has_relocs)
+{
+  using Ptr = decltype(optional_header.ImageBase);
+  optional_header.MajorLinkerVersion = 14;
+  optional_header.AddressOfEntryPoint = entry_point;
+  optional_header.BaseOfCode = entry_point;
+  optional_header.ImageBase = static_cast<Ptr>(image_base);
+  optional_header.SectionAlignment = section_alignment;
+  optional_header.FileAlignment = file_alignment;
+  optional_header.MajorOperatingSystemVersion = 6;
+  optional_header.MajorSubsystemVersion = 6;
+  optional_header.SizeOfImage = image_size;
+  optional_header.SizeOfHeaders = headers_size;
+  // IMAGE_SUBSYSTEM_WINDOWS_GUI
+  optional_header.Subsystem = 2;
+  // IMAGE_DLLCHARACTERISTICS_NX_COMPAT, plus DYNAMIC_BASE if relocatable.
+  optional_header.DllCharacteristics =
+    static_cast<std::uint16_t>(0x0100 | (has_relocs ? 0x0040 : 0));
+  optional_header.SizeOfStackReserve = 0x100000;
+  optional_header.SizeOfStackCommit = 0x1000;
+  optional_header.SizeOfHeapReserve = 0x100000;
+  optional_header.SizeOfHeapCommit = 0x1000;
+  optional_header.NumberOfRvaAndSizes = kImageNumberOfDirectoryEntries;
+}
+}
+
+inline std::string GetSyntheticExportName(std::uint32_t n)
+{
+  return detail::GetSyntheticName("Export", n);
+}
+
+inline std::string GetSyntheticImportName(std::uint32_t n)
+{
+  return detail::GetSyntheticName("Import", n);
+}
+
+inline std::string GetSyntheticImportModuleName(std::uint32_t n)
+{
+  return detail::GetSyntheticName("module", n) + ".dll";
+}
+
+inline std::string GetSyntheticModuleName()
+{
+  return "synthetic.dll";
+}
+
+// Builds a DLL (in file layout) according to the options, for use as a
+// PeFileType::kData source.
+//
+// The sections are .text (a ret for the entry point, each TLS callback and
+// each export, in that order), .rdata (the export, import and TLS
+// directories), .data (TLS data and the relocated pointers, all of which point
+// at the entry point) and .reloc, with any empty ones left out. Names follow
+// GetSyntheticExportName etc., with export N having ordinal N + 1, and import N
+// of each module having a hint of N.
+//
+// Throws if the options can't be represented (too many exports, or a file too
+// large to have a virtual section table).
+inline std::vector<std::uint8_t>
+  BuildSyntheticPe(SyntheticPeOptions const& options)
+{
+  if (options.flags >= SyntheticPeFlags::kInvalidFlagMaxValue)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                    << ErrorString{"Invalid flags."});
+  }
+
+  if (options.num_exports > 0xFFFF)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                    << ErrorString{"Too many exports."});
+  }
+
+  bool const is_64 = options.is_64;
+  bool const no_sections = !!(options.flags & SyntheticPeFlags::kNoSections);
+  bool const virtual_section_table =
+    !no_sections && !!(options.flags & SyntheticPeFlags::kVirtualSectionTable);
+  bool const flat = no_sections || virtual_section_table;
+  bool const eof_string =
+    !!(options.flags & SyntheticPeFlags::kEofTerminatedString);
+  bool const has_exports = options.num_exports || eof_string;
+  bool const has_imports = !!options.num_import_modules;
+  bool const has_tls = !!options.num_tls_callbacks;
+  bool const has_relocs = !!options.num_relocations;
+
+  std::uint32_t const ptr_size = is_64 ? 8U : 4U;
+  std::uint64_t const image_base = is_64 ? 0x180000000ULL : 0x10000000ULL;
+  std::uint32_t const file_alignment = 0x200;
+  std::uint32_t const section_alignment = flat ? file_alignment : 0x1000;
+  // Layouts with everything in the headers are packed more tightly, to keep
+  // within the limit on SizeOfOptionalHeader.
+  std::uint32_t const blob_alignment = flat ? 0x10 : section_alignment;
+
+  // Layout of each section relative to its start. Nothing depends on the
+  // section RVAs (which are all at least 16 byte aligned) except .reloc.
+  std::uint32_t const num_exports = options.num_exports;
+  std::uint32_t const num_modules = options.num_import_modules;
+  std::uint32_t const num_imports = options.num_imports_per_module;
+  std::uint32_t const num_callbacks = options.num_tls_callbacks;
+  std::uint32_t const text_size = 1 + num_callbacks + num_exports;
+
+  std::uint32_t rdata_size = 0;
+  std::uint32_t const export_dir_pos = rdata_size;
+  std::uint32_t export_name_pos = 0;
+  std::vector<std::uint32_t> export_name_poses;
+  if (has_exports)
+  {
+    rdata_size += static_cast<std::uint32_t>(sizeof(ImageExportDirectory)) +
+                  num_exports * 10;
+    if (!eof_string)
+    {
+      export_name_pos = rdata_size;
+      rdata_size +=
+        static_cast<std::uint32_t>(GetSyntheticModuleName().size() + 1);
+    }
+
+    for (std::uint32_t i = 0; i < num_exports; ++i)
+    {
+      export_name_poses.push_back(rdata_size);
+      rdata_size +=
+        static_cast<std::uint32_t>(GetSyntheticExportName(i).size() + 1);
+    }
+  }
+  std::uint32_t const export_dir_size = rdata_size - export_dir_pos;
+
+  rdata_size = detail::AlignSynthetic(rdata_size, 8);
+  std::uint32_t const import_dir_pos = rdata_size;
+  std::uint32_t const thunks_size = (num_imports + 1) * ptr_size;
+  std::uint32_t ilt_pos = 0;
+  std::uint32_t iat_pos = 0;
+  std::vector<std::uint32_t> module_name_poses;
+  std::vector<std::uint32_t> import_name_poses;
+  if (has_imports)
+  {
+    rdata_size += (num_modules + 1) *
+                  static_cast<std::uint32_t>(sizeof(ImageImportDescriptor));
+    rdata_size = detail::AlignSynthetic(rdata_size, 8);
+    ilt_pos = rdata_size;
+    rdata_size += num_modules * thunks_size;
+    iat_pos = rdata_size;
+    rdata_size += num_modules * thunks_size;
+    for (std::uint32_t i = 0; i < num_modules; ++i)
+    {
+      module_name_poses.push_back(rdata_size);
+      rdata_size += static_cast<std::uint32_t>(
+        GetSyntheticImportModuleName(i).size() + 1);
+    }
+
+    // Hint/name entries are word aligned. The names are shared by each module.
+    for (std::uint32_t i = 0; i < num_imports; ++i)
+    {
+      rdata_size = detail::AlignSynthetic(rdata_size, 2);
+      import_name_poses.push_back(rdata_size);
+      rdata_size += static_cast<std::uint32_t>(
+        sizeof(std::uint16_t) + GetSyntheticImportName(i).size() + 1);
+    }
+  }
+
+  rdata_size = detail::AlignSynthetic(rdata_size, 8);
+  std::uint32_t const tls_dir_pos = rdata_size;
+  std::uint32_t const tls_dir_size = static_cast<std::uint32_t>(
+    is_64 ? sizeof(ImageTlsDirectory64) : sizeof(ImageTlsDirectory32));
+  std::uint32_t const callbacks_pos = tls_dir_pos + tls_dir_size;
+  if (has_tls)
+  {
+    rdata_size = callbacks_pos + (num_callbacks + 1) * ptr_size;
+  }
+
+  // TLS template and index, then the relocated pointers.
+  std::uint32_t const tls_data_size = 8;
+  std::uint32_t const tls_index_pos = tls_data_size;
+  std::uint32_t const relocated_pos = has_tls ? 16 : 0;
+  std::uint32_t const data_size =
+    relocated_pos + options.num_relocations * ptr_size;
+
+  std::string const eof_name = GetSyntheticModuleName();
+  std::size_t const kNoSection = static_cast<std::size_t>(-1);
+  std::vector<detail::SyntheticSection> sections;
+  auto const add_section = [&](
+    char const* name, std::uint32_t characteristics, std::uint32_t size) {
+    sections.push_back(
+      detail::SyntheticSection{name, characteristics, size, 0, 0, 0});
+    return sections.size() - 1;
+  };
+  add_section(".text", detail::kSyntheticCode, text_size);
+  std::size_t const rdata_index =
+    rdata_size ? add_section(".rdata", detail::kSyntheticRData, rdata_size)
+               : kNoSection;
+  std::size_t const data_index =
+    data_size ? add_section(".data", detail::kSyntheticData, data_size)
+              : kNoSection;
+  std::size_t const reloc_index =
+    has_relocs ? add_section(".reloc", detail::kSyntheticReloc, 0)
+               : kNoSection;
+  for (std::uint32_t i = 0; i < options.num_extra_sections; ++i)
+  {
+    add_section(".extra", detail::kSyntheticData, file_alignment);
+  }
+  std::size_t const eof_index =
+    eof_string ? add_section(".eof",
+                             detail::kSyntheticRData,
+                             static_cast<std::uint32_t>(eof_name.size()))
+               : kNoSection;
+
+  std::uint32_t const nt_headers_offset = sizeof(ImageDosHeader);
+  std::uint32_t const optional_header_size = static_cast<std::uint32_t>(
+    is_64 ? sizeof(ImageOptionalHeader64) : sizeof(ImageOptionalHeader32));
+  std::uint32_t const section_table_offset =
+    nt_headers_offset + kImageOptionalHeaderOffset + optional_header_size;
+  std::uint32_t const num_sections =
+    no_sections ? 0U : static_cast<std::uint32_t>(sections.size());
+  std::uint32_t const headers_end =
+    section_table_offset +
+    (flat ? 0U : num_sections * static_cast<std::uint32_t>(
+                                  sizeof(ImageSectionHeader)));
+  std::uint32_t headers_size =
+    detail::AlignSynthetic(headers_end, file_alignment);
+
+  // RVAs equal file offsets in the flat layouts, and the file ends right
+  // after the last section if it holds the EOF terminated string.
+  std::uint32_t next_rva = flat ? detail::AlignSynthetic(headers_end, 0x10)
+                                : detail::AlignSynthetic(headers_size,
+                                                         section_alignment);
+  std::uint32_t next_raw_offset = headers_size;
+  std::vector<std::uint32_t> relocated_rvas;
+  for (std::size_t i = 0; i < sections.size(); ++i)
+  {
+    detail::SyntheticSection& section = sections[i];
+    section.rva = next_rva;
+    if (i == reloc_index)
+    {
+      // One block per page, padded with an ABSOLUTE entry if necessary.
+      for (std::uint32_t j = 0; j < options.num_relocations;)
+      {
+        std::uint32_t const page = relocated_rvas[j] & ~0xFFFU;
+        std::uint32_t count = 0;
+        for (; j < options.num_relocations &&
+                 (relocated_rvas[j] & ~0xFFFU) == page;
+             ++j)
+        {
+          ++count;
+        }
+        section.size += static_cast<std::uint32_t>(
+          sizeof(ImageBaseRelocation) +
+          detail::AlignSynthetic(count, 2) * sizeof(std::uint16_t));
+      }
+    }
+
+    if (i == data_index)
+    {
+      for (std::uint32_t j = 0; j < options.num_relocations; ++j)
+      {
+        relocated_rvas.push_back(section.rva + relocated_pos + j * ptr_size);
+      }
+    }
+
+    bool const last = i + 1 == sections.size();
+    section.raw_offset = flat ? section.rva : next_raw_offset;
+    section.raw_size = (last && eof_string)
+                         ? section.size
+                         : detail::AlignSynthetic(section.size, file_alignment);
+    next_rva = detail::AlignSynthetic(section.rva + section.size,
+                                      last ? section_alignment
+                                           : blob_alignment);
+    next_raw_offset = section.raw_offset + section.raw_size;
+  }
+
+  std::uint32_t const file_size =
+    flat ? (eof_string ? sections.back().rva + sections.back().size
+                       : detail::AlignSynthetic(sections.back().rva +
+                                                  sections.back().size,
+                                                file_alignment))
+         : next_raw_offset;
+  std::uint32_t const image_size =
+    detail::AlignSynthetic(next_rva, section_alignment);
+  std::uint32_t size_of_optional_header = optional_header_size;
+  if (flat)
+  {
+    headers_size = detail::AlignSynthetic(file_size, file_alignment);
+    if (virtual_section_table)
+    {
+      std::uint32_t const virtual_size_of_optional_header =
+        file_size - nt_headers_offset - kImageOptionalHeaderOffset;
+      if (virtual_size_of_optional_header > 0xFFFF)
+      {
+        HADESMEM_DETAIL_THROW_EXCEPTION(
+          Error{} << ErrorString{"File too large for a virtual section "
+                                 "table."});
+      }
+      size_of_optional_header = virtual_size_of_optional_header;
+    }
+  }
+
+  // Everything is written at its RVA, then copied into file layout.
+  std::vector<std::uint8_t> image(
+    (std::max)(image_size, detail::AlignSynthetic(file_size, 0x1000)));
+
+  std::uint32_t const text_rva = sections[0].rva;
+  std::memset(&image[text_rva], 0xC3, text_size);
+  std::uint32_t const rdata_rva =
+    rdata_index != kNoSection ? sections[rdata_index].rva : 0U;
+  std::uint32_t const data_rva =
+    data_index != kNoSection ? sections[data_index].rva : 0U;
+
+  ImageDataDirectory data_dirs[kImageNumberOfDirectoryEntries] = {};
+  auto const set_data_dir =
+    [&](PeDataDir data_dir, std::uint32_t rva, std::uint32_t size) {
+      data_dirs[static_cast<std::uint32_t>(data_dir)] =
+        ImageDataDirectory{rva, size};
+    };
+
+  if (has_exports)
+  {
+    std::uint32_t const dir_rva = rdata_rva + export_dir_pos;
+    std::uint32_t const functions_rva =
+      dir_rva + static_cast<std::uint32_t>(sizeof(ImageExportDirectory));
+    std::uint32_t const names_rva = functions_rva + num_exports * 4;
+    std::uint32_t const ordinals_rva = names_rva + num_exports * 4;
+    ImageExportDirectory dir = ImageExportDirectory{};
+    dir.Name =
+      eof_string ? sections[eof_index].rva : rdata_rva + export_name_pos;
+    dir.Base = 1;
+    dir.NumberOfFunctions = num_exports;
+    dir.NumberOfNames = num_exports;
+    dir.AddressOfFunctions = functions_rva;
+    dir.AddressOfNames = names_rva;
+    dir.AddressOfNameOrdinals = ordinals_rva;
+    detail::WriteSynthetic(image, dir_rva, dir);
+    if (!eof_string)
+    {
+      detail::WriteSyntheticString(
+        image, rdata_rva + export_name_pos, GetSyntheticModuleName());
+    }
+
+    for (std::uint32_t i = 0; i < num_exports; ++i)
+    {
+      std::uint32_t const name_rva = rdata_rva + export_name_poses[i];
+      detail::WriteSynthetic(
+        image, functions_rva + i * 4, text_rva + 1 + num_callbacks + i);
+      detail::WriteSynthetic(image, names_rva + i * 4, name_rva);
+      detail::WriteSynthetic(
+        image, ordinals_rva + i * 2, static_cast<std::uint16_t>(i));
+      detail::WriteSyntheticString(image, name_rva, GetSyntheticExportName(i));
+    }
+
+    set_data_dir(PeDataDir::Export, dir_rva, export_dir_size);
+  }
+
+  if (has_imports)
+  {
+    for (std::uint32_t i = 0; i < num_imports; ++i)
+    {
+      std::uint32_t const hint_name_rva = rdata_rva + import_name_poses[i];
+      detail::WriteSynthetic(
+        image, hint_name_rva, static_cast<std::uint16_t>(i));
+      detail::WriteSyntheticString(image,
+                                   hint_name_rva + sizeof(std::uint16_t),
+                                   GetSyntheticImportName(i));
+    }
+
+    for (std::uint32_t i = 0; i < num_modules; ++i)
+    {
+      ImageImportDescriptor desc = ImageImportDescriptor{};
+      desc.OriginalFirstThunk = rdata_rva + ilt_pos + i * thunks_size;
+      desc.Name = rdata_rva + module_name_poses[i];
+      desc.FirstThunk = rdata_rva + iat_pos + i * thunks_size;
+      detail::WriteSynthetic(
+        image,
+        rdata_rva + import_dir_pos +
+          i * static_cast<std::uint32_t>(sizeof(ImageImportDescriptor)),
+        desc);
+      detail::WriteSyntheticString(
+        image, desc.Name, GetSyntheticImportModuleName(i));
+
+      // The IAT is the same as the ILT on disk (i.e. not bound).
+      for (std::uint32_t j = 0; j < num_imports; ++j)
+      {
+        std::uint64_t const thunk = rdata_rva + import_name_poses[j];
+        detail::WriteSyntheticPtr(
+          image, desc.OriginalFirstThunk + j * ptr_size, is_64, thunk);
+        detail::WriteSyntheticPtr(
+          image, desc.FirstThunk + j * ptr_size, is_64, thunk);
+      }
+    }
+
+    set_data_dir(
+      PeDataDir::Import,
+      rdata_rva + import_dir_pos,
+      (num_modules + 1) * static_cast<std::uint32_t>(
+                            sizeof(ImageImportDescriptor)));
+    set_data_dir(
+      PeDataDir::IAT, rdata_rva + iat_pos, num_modules * thunks_size);
+  }
+
+  if (has_tls)
+  {
+    std::uint64_t const data_va = image_base + data_rva;
+    std::uint64_t const callbacks_va = image_base + rdata_rva + callbacks_pos;
+    if (is_64)
+    {
+      ImageTlsDirectory64 dir = ImageTlsDirectory64{};
+      dir.StartAddressOfRawData = data_va;
+      dir.EndAddressOfRawData = data_va + tls_data_size;
+      dir.AddressOfIndex = data_va + tls_index_pos;
+      dir.AddressOfCallBacks = callbacks_va;
+      detail::WriteSynthetic(image, rdata_rva + tls_dir_pos, dir);
+    }
+    else
+    {
+      ImageTlsDirectory32 dir = ImageTlsDirectory32{};
+      dir.StartAddressOfRawData = static_cast<std::uint32_t>(data_va);
+      dir.EndAddressOfRawData =
+        static_cast<std::uint32_t>(data_va + tls_data_size);
+      dir.AddressOfIndex = static_cast<std::uint32_t>(data_va + tls_index_pos);
+      dir.AddressOfCallBacks = static_cast<std::uint32_t>(callbacks_va);
+      detail::WriteSynthetic(image, rdata_rva + tls_dir_pos, dir);
+    }
+
+    for (std::uint32_t i = 0; i < num_callbacks; ++i)
+    {
+      detail::WriteSyntheticPtr(image,
+                                rdata_rva + callbacks_pos + i * ptr_size,
+                                is_64,
+                                image_base + text_rva + 1 + i);
+    }
+
+    set_data_dir(PeDataDir::TLS, rdata_rva + tls_dir_pos, tls_dir_size);
+  }
+
+  if (has_relocs)
+  {
+    std::uint16_t const type =
+      is_64 ? kImageRelBasedDir64 : kImageRelBasedHighLow;
+    std::uint32_t pos = sections[reloc_index].rva;
+    for (std::uint32_t i = 0; i < options.num_relocations;)
+    {
+      std::uint32_t const page = relocated_rvas[i] & ~0xFFFU;
+      std::uint32_t const block_pos = pos;
+      pos += sizeof(ImageBaseRelocation);
+      for (; i < options.num_relocations &&
+               (relocated_rvas[i] & ~0xFFFU) == page;
+           ++i)
+      {
+        detail::WriteSyntheticPtr(
+          image, relocated_rvas[i], is_64, image_base + text_rva);
+        detail::WriteSynthetic(
+          image,
+          pos,
+          static_cast<std::uint16_t>(type << 12 | (relocated_rvas[i] & 0xFFF)));
+        pos += sizeof(std::uint16_t);
+      }
+      pos = detail::AlignSynthetic(pos, 4);
+      detail::WriteSynthetic(
+        image, block_pos, ImageBaseRelocation{page, pos - block_pos});
+    }
+
+    set_data_dir(PeDataDir::BaseReloc,
+                 sections[reloc_index].rva,
+                 pos - sections[reloc_index].rva);
+  }
+
+  if (eof_string)
+  {
+    detail::WriteSyntheticString(
+      image, sections[eof_index].rva, eof_name, false);
+  }
+
+  ImageDosHeader dos_header = ImageDosHeader{};
+  dos_header.e_magic = kImageDosSignature;
+  dos_header.e_lfanew = static_cast<std::int32_t>(nt_headers_offset);
+  detail::WriteSynthetic(image, 0, dos_header);
+  detail::WriteSynthetic(image, nt_headers_offset, kImageNtSignature);
+
+  ImageFileHeader file_header = ImageFileHeader{};
+  file_header.Machine = is_64 ? kImageFileMachineAmd64 : kImageFileMachineI386;
+  file_header.NumberOfSections = static_cast<std::uint16_t>(num_sections);
+  file_header.TimeDateStamp = 0x55555555;
+  file_header.SizeOfOptionalHeader =
+    static_cast<std::uint16_t>(size_of_optional_header);
+  // IMAGE_FILE_EXECUTABLE_IMAGE | IMAGE_FILE_DLL, plus
+  // IMAGE_FILE_LARGE_ADDRESS_AWARE or IMAGE_FILE_32BIT_MACHINE.
+  file_header.Characteristics = static_cast<std::uint16_t>(
+    0x2002 | (is_64 ? 0x0020 : 0x0100) |
+    (has_relocs ? 0 : kImageFileRelocsStripped));
+  detail::WriteSynthetic(
+    image, nt_headers_offset + sizeof(std::uint32_t), file_header);
+
+  std::uint32_t const optional_header_offset =
+    nt_headers_offset + kImageOptionalHeaderOffset;
+  if (is_64)
+  {
+    ImageOptionalHeader64 optional_header = ImageOptionalHeader64{};
+    optional_header.Magic = kImageNtOptionalHdr64Magic;
+    detail::FillSyntheticOptionalHeader(optional_header,
+                                        text_rva,
+                                        image_base,
+                                        section_alignment,
+                                        file_alignment,
+                                        image_size,
+                                        headers_size,
+                                        has_relocs);
+    std::copy(std::begin(data_dirs),
+              std::end(data_dirs),
+              std::begin(optional_header.DataDirectory));
+    detail::WriteSynthetic(image, optional_header_offset, optional_header);
+  }
+  else
+  {
+    ImageOptionalHeader32 optional_header = ImageOptionalHeader32{};
+    optional_header.Magic = kImageNtOptionalHdr32Magic;
+    detail::FillSyntheticOptionalHeader(optional_header,
+                                        text_rva,
+                                        image_base,
+                                        section_alignment,
+                                        file_alignment,
+                                        image_size,
+                                        headers_size,
+                                        has_relocs);
+    optional_header.BaseOfData = rdata_rva;
+    std::copy(std::begin(data_dirs),
+              std::end(data_dirs),
+              std::begin(optional_header.DataDirectory));
+    detail::WriteSynthetic(image, optional_header_offset, optional_header);
+  }
+
+  if (flat)
+  {
+    image.resize(file_size);
+    return image;
+  }
+
+  std::vector<std::uint8_t> file(file_size);
+  std::copy(std::begin(image),
+            std::begin(image) + headers_size,
+            std::begin(file));
+  for (std::size_t i = 0; i < sections.size(); ++i)
+  {
+    detail::SyntheticSection const& section = sections[i];
+    ImageSectionHeader header = ImageSectionHeader{};
+    std::memcpy(header.Name,
+                section.name,
+                (std::min)(std::strlen(section.name),
+                           static_cast<std::size_t>(kImageSizeOfShortName)));
+    header.VirtualSize = section.size;
+    header.VirtualAddress = section.rva;
+    header.SizeOfRawData = section.raw_size;
+    header.PointerToRawData = section.raw_offset;
+    header.Characteristics = section.characteristics;
+    detail::WriteSynthetic(
+      file,
+      section_table_offset +
+        static_cast<std::uint32_t>(i * sizeof(ImageSectionHeader)),
+      header);
+    std::copy(std::begin(image) + section.rva,
+              std::begin(image) + section.rva + section.raw_size,
+              std::begin(file) + section.raw_offset);
+  }
+
+  return file;
+}
+
+// A synthetic file (see BuildSyntheticPe) plus one extra section of
+// hand-written data, for the tricks and malformed directories the generator
+// doesn't cover. The section is added with PeBuilder, and its RVA is fixed on
+// construction so the data can refer to it. The data is written by RVA.
+//
+// The virtual size defaults to the raw size. It can be smaller (the rest of
+// the raw data is still mapped) or larger (zero fill).
+class SyntheticPeBuilder
+{
+public:
+  explicit SyntheticPeBuilder(SyntheticPeOptions const& options,
+                              std::uint32_t size,
+                              std::uint32_t virtual_size = 0)
+    : builder_{PeView{BufferSource{BuildSyntheticPe(options)},
+                      PeFileType::kData}},
+      data_(size)
+  {
+    index_ = builder_.AddSection(".test", detail::kSyntheticData, {});
+    builder_.ResizeSection(index_, size, virtual_size ? virtual_size : size);
+    auto const layout = builder_.Plan();
+    rva_ = layout.sections[index_].virtual_address;
+    raw_ = layout.sections[index_].pointer_to_raw_data;
+  }
+
+  // The builder the section was added to, for changes to the rest of the
+  // file. Adding sections or imports may move the extra section.
+  PeBuilder& GetBuilder() noexcept
+  {
+    return builder_;
+  }
+
+  std::uint32_t GetRva() const noexcept
+  {
+    return rva_;
+  }
+
+  std::uint32_t GetSize() const noexcept
+  {
+    return static_cast<std::uint32_t>(data_.size());
+  }
+
+  // File offset of an RVA in the section, in the output of Build.
+  std::uint32_t RvaToOffset(std::uint32_t rva) const
+  {
+    HADESMEM_DETAIL_ASSERT(rva >= rva_ && rva - rva_ <= data_.size());
+    return rva - rva_ + raw_;
+  }
+
+  void Write(std::uint32_t rva, void const* data, std::size_t len)
+  {
+    HADESMEM_DETAIL_ASSERT(rva >= rva_ && len <= data_.size() &&
+                           rva - rva_ <= data_.size() - len);
+    if (len)
+    {
+      std::memcpy(&data_[rva - rva_], data, len);
+    }
+  }
+
+  template <typename T> void Write(std::uint32_t rva, T const& data)
+  {
+    Write(rva, std::addressof(data), sizeof(data));
+  }
+
+  void WriteString(std::uint32_t rva, std::string const& str)
+  {
+    Write(rva, str.c_str(), str.size() + 1);
+  }
+
+  void SetDataDir(PeDataDir data_dir, std::uint32_t rva, std::uint32_t size)
+  {
+    ImageDataDirectory dir = ImageDataDirectory{};
+    dir.VirtualAddress = rva;
+    dir.Size = size;
+    builder_.SetDataDir(data_dir, dir);
+  }
+
+  std::vector<std::uint8_t> Build() const
+  {
+    // A copy, so the builder never points at our buffer.
+    PeBuilder builder{builder_};
+    builder.SetSectionData(index_, data_.data(), data_.size());
+    return builder.Build();
+  }
+
+private:
+  PeBuilder builder_;
+  std::vector<std::uint8_t> data_;
+  std::size_t index_{};
+  std::uint32_t rva_{};
+  std::uint32_t raw_{};
+};
+}
+}
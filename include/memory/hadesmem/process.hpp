@@ -13,6 +13,7 @@
 
 #include <hadesmem/config.hpp>
 #include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/read_cache.hpp>
 #include <hadesmem/detail/smart_handle.hpp>
 #include <hadesmem/detail/trace.hpp>
 #include <hadesmem/detail/winapi.hpp>
@@ -35,6 +36,10 @@
 // cross-arch inject workaround from Cerberus until we finish adding full native
 // support.
 
+// TODO: The read cache is only invalidated by writes made through the same
+// Process object. Other mutations (freeing or reprotecting memory, writes from
+// the target itself, etc.) are the responsibility of the caller.
+
 namespace hadesmem
 {
 class Process
@@ -45,6 +50,8 @@ public:
     CheckWoW64();
   }
 
+  // The read cache (if any) is owned by the derived type, so it is never
+  // transferred by copying or moving, only the process identity is.
   Process(Process const& other)
     : handle_{DuplicateHandle(other.id_, other.handle_.GetHandle())},
       id_{other.id_}
@@ -74,6 +81,11 @@ public:
 
     other.id_ = 0;
 
+    if (read_cache_)
+    {
+      read_cache_->InvalidateAll();
+    }
+
     return *this;
   }
 
@@ -104,6 +116,22 @@ public:
     }
 
     id_ = 0;
+
+    if (read_cache_)
+    {
+      read_cache_->InvalidateAll();
+    }
+  }
+
+  detail::ReadCache* GetReadCache() const noexcept
+  {
+    return read_cache_;
+  }
+
+protected:
+  void SetReadCache(detail::ReadCache* read_cache) noexcept
+  {
+    read_cache_ = read_cache;
   }
 
 private:
@@ -155,6 +183,7 @@ private:
 
   detail::SmartHandle handle_;
   DWORD id_;
+  detail::ReadCache* read_cache_{};
 };
 
 inline bool operator==(Process const& lhs, Process const& rhs) noexcept
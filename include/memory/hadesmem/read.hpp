@@ -3,8 +3,10 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <iterator>
 #include <memory>
@@ -83,6 +85,55 @@ inline void
   std::copy(std::begin(data), std::end(data), out);
 }
 
+namespace detail
+{
+// Cached processes already hold whole pages, so rather than querying and
+// reprotecting regions ourselves we walk the string a page at a time through
+// the cache.
+template <typename T, typename OutputIterator>
+void ReadStringCached(Process const& process,
+                      PVOID address,
+                      OutputIterator data,
+                      void* upper_bound)
+{
+  std::uintptr_t const kPageSize = 0x1000;
+
+  T* cur = static_cast<T*>(address);
+  std::vector<T> buf;
+  for (;;)
+  {
+    if (upper_bound && cur + 1 > upper_bound)
+    {
+      return;
+    }
+
+    auto const cur_raw = reinterpret_cast<std::uintptr_t>(cur);
+    std::uintptr_t end_raw = (cur_raw & ~(kPageSize - 1)) + kPageSize;
+    if (upper_bound)
+    {
+      end_raw =
+        (std::min)(end_raw, reinterpret_cast<std::uintptr_t>(upper_bound));
+    }
+    std::size_t const buf_len = (std::max)(
+      static_cast<std::size_t>((end_raw - cur_raw) / sizeof(T)),
+      static_cast<std::size_t>(1));
+
+    buf.resize(buf_len);
+    ReadImpl(process, cur, buf.data(), buf.size() * sizeof(T));
+
+    auto const iter = std::find(std::begin(buf), std::end(buf), T());
+    std::copy(std::begin(buf), iter, data);
+
+    if (iter != std::end(buf))
+    {
+      return;
+    }
+
+    cur += buf_len;
+  }
+}
+}
+
 template <typename T, typename OutputIterator>
 void ReadStringEx(Process const& process,
                   PVOID address,
@@ -97,6 +148,12 @@ void ReadStringEx(Process const& process,
 
   HADESMEM_DETAIL_ASSERT(chunk_len != 0);
 
+  if (process.GetReadCache())
+  {
+    detail::ReadStringCached<T>(process, address, data, upper_bound);
+    return;
+  }
+
   for (;;)
   {
     detail::ProtectGuard protect_guard{
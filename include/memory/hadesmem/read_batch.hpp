@@ -0,0 +1,206 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/read_impl.hpp>
+#include <hadesmem/detail/static_assert.hpp>
+#include <hadesmem/detail/type_traits.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+
+// TODO: Use the batch API in PeLib and PeDumper where we currently issue long
+// runs of tiny independent reads.
+
+// TODO: There is no vectored equivalent of ReadProcessMemory, so we issue one
+// call per coalesced span. If we ever gain a backend which supports scatter
+// reads (e.g. a driver) then we should pass the spans through in one go.
+
+namespace hadesmem
+{
+struct ReadBatchRequest
+{
+  void* address;
+  void* data;
+  std::size_t len;
+  bool succeeded;
+};
+
+template <typename T>
+inline ReadBatchRequest MakeReadBatchRequest(PVOID address, T& data)
+{
+  HADESMEM_DETAIL_STATIC_ASSERT(detail::IsTriviallyCopyable<T>::value);
+
+  HADESMEM_DETAIL_ASSERT(address != nullptr);
+
+  return ReadBatchRequest{address, std::addressof(data), sizeof(T), false};
+}
+
+namespace detail
+{
+struct ReadBatchTraits
+{
+  static std::uintptr_t const kPageSize = 0x1000;
+  // Upper bound on the size of a single coalesced span (and therefore the
+  // scratch buffer), so a batch covering a huge range doesn't balloon memory.
+  static std::uintptr_t const kMaxSpanLen = 0x100000;
+};
+
+struct ReadBatchSpan
+{
+  std::uintptr_t beg;
+  std::uintptr_t end;
+  std::size_t first;
+  std::size_t last;
+};
+
+inline std::uintptr_t ReadBatchPageDown(std::uintptr_t address) noexcept
+{
+  return address & ~(ReadBatchTraits::kPageSize - 1);
+}
+
+inline std::uintptr_t ReadBatchPageUp(std::uintptr_t address) noexcept
+{
+  return ReadBatchPageDown(address + ReadBatchTraits::kPageSize - 1);
+}
+
+inline void ReadBatchIsolate(Process const& process,
+                             ReadBatchRequest& request,
+                             std::uint32_t flags)
+{
+  try
+  {
+    ReadImpl(process, request.address, request.data, request.len, flags);
+    request.succeeded = true;
+  }
+  catch (std::exception const& /*e*/)
+  {
+    request.succeeded = false;
+  }
+}
+}
+
+// Reads a list of independent (address, len, data) requests with as few
+// underlying reads as possible. Requests are sorted and coalesced into page
+// granular spans, each of which is read once. If a span fails then its
+// requests are retried individually so a single bad address only fails the
+// requests which actually touch it. Returns the number of failed requests.
+inline std::size_t ReadBatch(Process const& process,
+                             ReadBatchRequest* requests,
+                             std::size_t count,
+                             std::uint32_t flags = ReadFlags::kNone)
+{
+  HADESMEM_DETAIL_ASSERT(count ? requests != nullptr : true);
+
+  std::vector<std::size_t> order;
+  order.reserve(count);
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    ReadBatchRequest& request = requests[i];
+    HADESMEM_DETAIL_ASSERT(request.len ? request.data != nullptr : true);
+
+    auto const address = reinterpret_cast<std::uintptr_t>(request.address);
+    if (!request.len)
+    {
+      request.succeeded = true;
+    }
+    else if (!address || address + request.len < address)
+    {
+      request.succeeded = false;
+    }
+    else
+    {
+      request.succeeded = false;
+      order.push_back(i);
+    }
+  }
+
+  std::sort(std::begin(order),
+            std::end(order),
+            [&](std::size_t lhs, std::size_t rhs) {
+              return requests[lhs].address < requests[rhs].address;
+            });
+
+  std::vector<detail::ReadBatchSpan> spans;
+  for (std::size_t i = 0; i < order.size(); ++i)
+  {
+    ReadBatchRequest const& request = requests[order[i]];
+    auto const address = reinterpret_cast<std::uintptr_t>(request.address);
+    std::uintptr_t const beg = detail::ReadBatchPageDown(address);
+    std::uintptr_t const end = detail::ReadBatchPageUp(address + request.len);
+
+    if (!spans.empty())
+    {
+      detail::ReadBatchSpan& span = spans.back();
+      std::uintptr_t const new_end = (std::max)(span.end, end);
+      if (beg <= span.end &&
+          new_end - span.beg <= detail::ReadBatchTraits::kMaxSpanLen)
+      {
+        span.end = new_end;
+        span.last = i + 1;
+        continue;
+      }
+    }
+
+    spans.push_back(detail::ReadBatchSpan{beg, end, i, i + 1});
+  }
+
+  std::vector<std::uint8_t> buf;
+  for (auto const& span : spans)
+  {
+    auto const span_len = static_cast<std::size_t>(span.end - span.beg);
+    buf.resize(span_len);
+
+    try
+    {
+      detail::ReadImpl(process,
+                       reinterpret_cast<void*>(span.beg),
+                       buf.data(),
+                       span_len,
+                       flags);
+    }
+    catch (std::exception const& /*e*/)
+    {
+      for (std::size_t i = span.first; i < span.last; ++i)
+      {
+        detail::ReadBatchIsolate(process, requests[order[i]], flags);
+      }
+
+      continue;
+    }
+
+    for (std::size_t i = span.first; i < span.last; ++i)
+    {
+      ReadBatchRequest& request = requests[order[i]];
+      auto const offset =
+        reinterpret_cast<std::uintptr_t>(request.address) - span.beg;
+      std::memcpy(request.data, buf.data() + offset, request.len);
+      request.succeeded = true;
+    }
+  }
+
+  return static_cast<std::size_t>(
+    std::count_if(requests, requests + count, [](ReadBatchRequest const& r) {
+      return !r.succeeded;
+    }));
+}
+
+inline std::size_t ReadBatch(Process const& process,
+                             std::vector<ReadBatchRequest>& requests,
+                             std::uint32_t flags = ReadFlags::kNone)
+{
+  return ReadBatch(process, requests.data(), requests.size(), flags);
+}
+}
@@ -0,0 +1,290 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/query_region.hpp>
+#include <hadesmem/detail/read_cache.hpp>
+#include <hadesmem/detail/read_impl.hpp>
+#include <hadesmem/detail/static_assert.hpp>
+#include <hadesmem/detail/type_traits.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+
+// TODO: Convert PeLib to use views for header and directory parsing, so
+// parsing a local buffer (Cerberus, ValidateDiskHeaders, DumpFile, etc.)
+// doesn't go through ReadProcessMemory at all.
+
+// TODO: Support views over snapshots once we have a snapshot backend other
+// than a frozen CachedProcess.
+
+namespace hadesmem
+{
+struct ReadViewFlags
+{
+  enum : std::uint32_t
+  {
+    kNone,
+    // Caller guarantees the range is committed and readable in the local
+    // process, so skip querying it. Ignored for remote processes.
+    kAssumeReadable
+  };
+};
+
+class ReadView;
+
+inline ReadView MakeReadView(Process const& process,
+                             PVOID address,
+                             std::size_t len,
+                             std::uint32_t flags = ReadViewFlags::kNone);
+
+// Bounded, read-only view of memory in a process. Depending on the backend the
+// view either points directly at the memory (local process or cached page) or
+// owns a copy of it (remote process).
+//
+// Direct views of the local process do not keep the memory alive, so the
+// caller must ensure it outlives the view. Views of a CachedProcess page hold a
+// reference to the page, so remain valid (and unchanged) after the page is
+// evicted or invalidated.
+class ReadView
+{
+public:
+  // Copies no larger than this are stored inline rather than on the heap.
+  static std::size_t const kInlineLen = 64;
+
+  ReadView() noexcept
+  {
+  }
+
+  ReadView(ReadView const& other)
+    : address_{other.address_},
+      data_{other.data_},
+      size_{other.size_},
+      is_direct_{other.is_direct_},
+      owner_{other.owner_},
+      inline_buf_(other.inline_buf_)
+  {
+    FixupInline(other);
+  }
+
+  ReadView& operator=(ReadView const& other)
+  {
+    address_ = other.address_;
+    data_ = other.data_;
+    size_ = other.size_;
+    is_direct_ = other.is_direct_;
+    owner_ = other.owner_;
+    inline_buf_ = other.inline_buf_;
+    FixupInline(other);
+
+    return *this;
+  }
+
+  PVOID GetAddress() const noexcept
+  {
+    return address_;
+  }
+
+  void const* GetData() const noexcept
+  {
+    return data_;
+  }
+
+  std::size_t GetSize() const noexcept
+  {
+    return size_;
+  }
+
+  bool IsEmpty() const noexcept
+  {
+    return size_ == 0;
+  }
+
+  // Whether the view refers to the original (or cached) memory rather than a
+  // private copy.
+  bool IsDirect() const noexcept
+  {
+    return is_direct_;
+  }
+
+  std::uint8_t const* begin() const noexcept
+  {
+    return static_cast<std::uint8_t const*>(data_);
+  }
+
+  std::uint8_t const* end() const noexcept
+  {
+    return begin() + size_;
+  }
+
+  bool Contains(std::size_t offset, std::size_t len) const noexcept
+  {
+    return offset <= size_ && len <= size_ - offset;
+  }
+
+  template <typename T> T const* As(std::size_t offset = 0) const
+  {
+    HADESMEM_DETAIL_STATIC_ASSERT(detail::IsTriviallyCopyable<T>::value);
+
+    if (!Contains(offset, sizeof(T)))
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"View too small."});
+    }
+
+    return reinterpret_cast<T const*>(begin() + offset);
+  }
+
+  template <typename T> T Get(std::size_t offset = 0) const
+  {
+    HADESMEM_DETAIL_STATIC_ASSERT(detail::IsTriviallyCopyable<T>::value);
+    HADESMEM_DETAIL_STATIC_ASSERT(std::is_default_constructible<T>::value);
+
+    // Copy out rather than dereferencing As<T> so unaligned data is fine.
+    T data;
+    std::memcpy(std::addressof(data), As<T>(offset), sizeof(T));
+    return data;
+  }
+
+  ReadView SubView(std::size_t offset, std::size_t len) const
+  {
+    if (!Contains(offset, len))
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Invalid sub-view."});
+    }
+
+    ReadView view{*this};
+    view.address_ = static_cast<std::uint8_t*>(address_) + offset;
+    view.data_ = view.begin() + offset;
+    view.size_ = len;
+    return view;
+  }
+
+private:
+  friend ReadView MakeReadView(Process const& process,
+                               PVOID address,
+                               std::size_t len,
+                               std::uint32_t flags);
+
+  void FixupInline(ReadView const& other) noexcept
+  {
+    auto const other_beg = other.inline_buf_.data();
+    auto const other_data = static_cast<std::uint8_t const*>(other.data_);
+    if (other_data >= other_beg && other_data < other_beg + kInlineLen)
+    {
+      data_ = inline_buf_.data() + (other_data - other_beg);
+    }
+  }
+
+  PVOID address_{};
+  void const* data_{};
+  std::size_t size_{};
+  bool is_direct_{};
+  std::shared_ptr<void const> owner_;
+  std::array<std::uint8_t, kInlineLen> inline_buf_;
+};
+
+namespace detail
+{
+inline bool CanReadLocalDirect(Process const& process,
+                               PVOID address,
+                               std::size_t len)
+{
+  auto const beg = static_cast<std::uint8_t*>(address);
+  auto const end = beg + len;
+  for (auto cur = beg; cur < end;)
+  {
+    MEMORY_BASIC_INFORMATION const mbi = Query(process, cur);
+    // PAGE_EXECUTE is readable via ReadProcessMemory but not via a pointer.
+    if (!CanRead(mbi) || IsGuard(mbi) ||
+        (mbi.Protect & 0xFF) == PAGE_EXECUTE)
+    {
+      return false;
+    }
+
+    cur = static_cast<std::uint8_t*>(mbi.BaseAddress) + mbi.RegionSize;
+  }
+
+  return true;
+}
+}
+
+inline ReadView MakeReadView(Process const& process,
+                             PVOID address,
+                             std::size_t len,
+                             std::uint32_t flags)
+{
+  HADESMEM_DETAIL_ASSERT(len ? address != nullptr : true);
+
+  auto const address_raw = reinterpret_cast<std::uintptr_t>(address);
+  if (address_raw + len < address_raw)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                    << ErrorString{"Invalid view range."});
+  }
+
+  ReadView view;
+  view.address_ = address;
+  view.size_ = len;
+
+  if (!len)
+  {
+    view.data_ = view.inline_buf_.data();
+    view.is_direct_ = true;
+    return view;
+  }
+
+  // A cached process gets cache semantics even when it's local, so a frozen
+  // cache still behaves like a snapshot.
+  if (detail::ReadCache* const read_cache = process.GetReadCache())
+  {
+    void const* data = nullptr;
+    auto owner = read_cache->Pin(process, address, len, data);
+    if (owner)
+    {
+      view.data_ = data;
+      view.owner_ = std::move(owner);
+      view.is_direct_ = true;
+      return view;
+    }
+  }
+  else if (process.GetId() == ::GetCurrentProcessId() &&
+           (!!(flags & ReadViewFlags::kAssumeReadable) ||
+            detail::CanReadLocalDirect(process, address, len)))
+  {
+    view.data_ = address;
+    view.is_direct_ = true;
+    return view;
+  }
+
+  if (len <= ReadView::kInlineLen)
+  {
+    detail::ReadImpl(process, address, view.inline_buf_.data(), len);
+    view.data_ = view.inline_buf_.data();
+  }
+  else
+  {
+    auto buf = std::make_shared<std::vector<std::uint8_t>>(len);
+    detail::ReadImpl(process, address, buf->data(), len);
+    view.data_ = buf->data();
+    view.owner_ = std::move(buf);
+  }
+
+  return view;
+}
+}
@@ -0,0 +1,733 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <emmintrin.h>
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/filesystem.hpp>
+#include <hadesmem/detail/query_region.hpp>
+#include <hadesmem/detail/read_impl.hpp>
+#include <hadesmem/detail/smart_handle.hpp>
+#include <hadesmem/detail/static_assert.hpp>
+#include <hadesmem/detail/xxhash.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/region.hpp>
+#include <hadesmem/region_list.hpp>
+
+// TODO: Map page data lazily in fixed size windows rather than mapping the
+// entire file, so large snapshots can be opened from x86 processes.
+
+// TODO: Support incremental snapshots (only storing pages whose hash differs
+// from a base snapshot).
+
+// TODO: Add a 'verify' mode to the diff which byte compares pages even when
+// their hashes match, for the paranoid.
+
+namespace hadesmem
+{
+struct SnapshotFlags
+{
+  enum : std::uint32_t
+  {
+    kNone = 0,
+    // Only capture MEM_PRIVATE regions (i.e. skip images and mapped files).
+    kPrivateOnly = 1 << 0,
+    // Only capture writable regions.
+    kWritableOnly = 1 << 1
+  };
+};
+
+// On-disk (and in-memory) layout of a snapshot:
+//   SnapshotHeader
+//   Page data (kPageSize bytes per readable page)
+//   SnapshotRegion[region_count]
+//   SnapshotPage[page_count] (sorted by address)
+// All fields are fixed size so snapshots can be shared between x86 and x64.
+struct SnapshotHeader
+{
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t page_size;
+  std::uint32_t flags;
+  std::uint32_t process_id;
+  std::uint32_t reserved;
+  std::int64_t time;
+  std::uint64_t region_count;
+  std::uint64_t region_offset;
+  std::uint64_t page_count;
+  std::uint64_t page_offset;
+  std::uint64_t file_size;
+};
+
+struct SnapshotRegion
+{
+  std::uint64_t base;
+  std::uint64_t size;
+  std::uint64_t alloc_base;
+  std::uint32_t alloc_protect;
+  std::uint32_t state;
+  std::uint32_t protect;
+  std::uint32_t type;
+  std::uint64_t first_page;
+  std::uint64_t page_count;
+};
+
+struct SnapshotPage
+{
+  std::uint64_t address;
+  std::uint64_t hash;
+  // Offset of the page data from the start of the snapshot, or kNoData if
+  // the page could not be read.
+  std::uint64_t data_offset;
+};
+
+namespace detail
+{
+struct SnapshotTraits
+{
+  static std::uint32_t const kMagic = 0x53534D48; // "HMSS"
+  static std::uint32_t const kVersion = 1;
+  static std::uint32_t const kPageSize = 0x1000;
+  static std::size_t const kChunkPages = 0x40;
+  static std::uint64_t const kNoData = ~0ULL;
+};
+
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(SnapshotHeader) == 72);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(SnapshotRegion) == 56);
+HADESMEM_DETAIL_STATIC_ASSERT(sizeof(SnapshotPage) == 24);
+
+class SnapshotVectorSink
+{
+public:
+  explicit SnapshotVectorSink(std::vector<std::uint8_t>& buffer)
+    : buffer_{&buffer}
+  {
+  }
+
+  std::uint64_t Tell() const
+  {
+    return buffer_->size();
+  }
+
+  void Write(void const* data, std::size_t len)
+  {
+    auto const beg = static_cast<std::uint8_t const*>(data);
+    buffer_->insert(std::end(*buffer_), beg, beg + len);
+  }
+
+  void WriteAt(std::uint64_t offset, void const* data, std::size_t len)
+  {
+    HADESMEM_DETAIL_ASSERT(offset + len <= buffer_->size());
+    std::memcpy(
+      buffer_->data() + static_cast<std::size_t>(offset), data, len);
+  }
+
+private:
+  std::vector<std::uint8_t>* buffer_;
+};
+
+class SnapshotFileSink
+{
+public:
+  explicit SnapshotFileSink(std::wstring const& path)
+    : file_{OpenFile<char>(path, std::ios::out | std::ios::binary)}
+  {
+    if (!*file_)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Failed to create file."});
+    }
+  }
+
+  std::uint64_t Tell() const
+  {
+    return static_cast<std::uint64_t>(file_->tellp());
+  }
+
+  void Write(void const* data, std::size_t len)
+  {
+    if (!file_->write(static_cast<char const*>(data),
+                      static_cast<std::streamsize>(len)))
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Failed to write file."});
+    }
+  }
+
+  void WriteAt(std::uint64_t offset, void const* data, std::size_t len)
+  {
+    std::streampos const cur = file_->tellp();
+    if (!file_->seekp(static_cast<std::streamoff>(offset), std::ios::beg))
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Failed to seek file."});
+    }
+
+    Write(data, len);
+
+    if (!file_->seekp(cur) || !file_->flush())
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Failed to seek file."});
+    }
+  }
+
+private:
+  std::unique_ptr<std::basic_fstream<char>> file_;
+};
+
+inline bool ShouldCaptureRegion(Region const& region, std::uint32_t flags)
+{
+  MEMORY_BASIC_INFORMATION mbi{};
+  mbi.State = region.GetState();
+  mbi.Protect = region.GetProtect();
+  if (!CanRead(mbi) || IsBadProtect(mbi))
+  {
+    return false;
+  }
+
+  if (!!(flags & SnapshotFlags::kPrivateOnly) &&
+      region.GetType() != MEM_PRIVATE)
+  {
+    return false;
+  }
+
+  if (!!(flags & SnapshotFlags::kWritableOnly) && !CanWrite(mbi))
+  {
+    return false;
+  }
+
+  return true;
+}
+
+template <typename Sink>
+void CaptureSnapshot(Process const& process, Sink& sink, std::uint32_t flags)
+{
+  std::uint32_t const page_size = SnapshotTraits::kPageSize;
+
+  SnapshotHeader header{};
+  header.magic = SnapshotTraits::kMagic;
+  header.version = SnapshotTraits::kVersion;
+  header.page_size = page_size;
+  header.flags = flags;
+  header.process_id = process.GetId();
+  header.time = static_cast<std::int64_t>(std::time(nullptr));
+  sink.Write(&header, sizeof(header));
+
+  std::vector<SnapshotRegion> regions;
+  std::vector<SnapshotPage> pages;
+  std::vector<std::uint8_t> buf(SnapshotTraits::kChunkPages * page_size);
+
+  for (auto const& region : RegionList{process})
+  {
+    if (!ShouldCaptureRegion(region, flags))
+    {
+      continue;
+    }
+
+    SnapshotRegion info{};
+    info.base = reinterpret_cast<std::uintptr_t>(region.GetBase());
+    info.size = region.GetSize();
+    info.alloc_base = reinterpret_cast<std::uintptr_t>(region.GetAllocBase());
+    info.alloc_protect = region.GetAllocProtect();
+    info.state = region.GetState();
+    info.protect = region.GetProtect();
+    info.type = region.GetType();
+    info.first_page = pages.size();
+
+    // Read in large chunks, falling back to individual pages if a chunk fails
+    // (e.g. because the region was modified since it was queried).
+    auto const region_beg = static_cast<std::uint8_t*>(region.GetBase());
+    for (std::size_t offset = 0; offset < region.GetSize();
+         offset += buf.size())
+    {
+      std::size_t const chunk_len = (std::min)(
+        static_cast<std::size_t>(region.GetSize()) - offset, buf.size());
+
+      bool chunk_ok = true;
+      try
+      {
+        ReadUnchecked(process, region_beg + offset, buf.data(), chunk_len);
+      }
+      catch (std::exception const& /*e*/)
+      {
+        chunk_ok = false;
+      }
+
+      for (std::size_t page = 0; page < chunk_len; page += page_size)
+      {
+        std::uint8_t* const page_addr = region_beg + offset + page;
+        std::uint8_t* const page_buf = buf.data() + page;
+
+        bool page_ok = chunk_ok;
+        if (!page_ok)
+        {
+          try
+          {
+            ReadUnchecked(process, page_addr, page_buf, page_size);
+            page_ok = true;
+          }
+          catch (std::exception const& /*e*/)
+          {
+          }
+        }
+
+        SnapshotPage page_info{};
+        page_info.address = reinterpret_cast<std::uintptr_t>(page_addr);
+        if (page_ok)
+        {
+          page_info.hash = XxHash64(page_buf, page_size);
+          page_info.data_offset = sink.Tell();
+          sink.Write(page_buf, page_size);
+        }
+        else
+        {
+          page_info.data_offset = SnapshotTraits::kNoData;
+        }
+
+        pages.push_back(page_info);
+      }
+    }
+
+    info.page_count = pages.size() - info.first_page;
+    regions.push_back(info);
+  }
+
+  header.region_count = regions.size();
+  header.region_offset = sink.Tell();
+  if (!regions.empty())
+  {
+    sink.Write(regions.data(), regions.size() * sizeof(SnapshotRegion));
+  }
+
+  header.page_count = pages.size();
+  header.page_offset = sink.Tell();
+  if (!pages.empty())
+  {
+    sink.Write(pages.data(), pages.size() * sizeof(SnapshotPage));
+  }
+
+  header.file_size = sink.Tell();
+  sink.WriteAt(0, &header, sizeof(header));
+}
+
+// Returns the index of the first byte at or after pos which differs between
+// lhs and rhs, or len if there is none.
+inline std::size_t SnapshotFindMismatch(std::uint8_t const* lhs,
+                                        std::uint8_t const* rhs,
+                                        std::size_t pos,
+                                        std::size_t len) noexcept
+{
+  for (; pos + 16 <= len; pos += 16)
+  {
+    __m128i const l =
+      _mm_loadu_si128(reinterpret_cast<__m128i const*>(lhs + pos));
+    __m128i const r =
+      _mm_loadu_si128(reinterpret_cast<__m128i const*>(rhs + pos));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(l, r)) != 0xFFFF)
+    {
+      break;
+    }
+  }
+
+  while (pos < len && lhs[pos] == rhs[pos])
+  {
+    ++pos;
+  }
+
+  return pos;
+}
+}
+
+// Snapshot of the readable memory in a process, plus a hash of each page. Can
+// be captured to memory or streamed straight to disk (and later reopened), in
+// which case the file is memory mapped rather than loaded.
+//
+// Copies are shallow.
+class Snapshot
+{
+public:
+  explicit Snapshot(Process const& process,
+                    std::uint32_t flags = SnapshotFlags::kNone)
+    : storage_{std::make_shared<Storage>()}
+  {
+    detail::SnapshotVectorSink sink{storage_->buffer};
+    detail::CaptureSnapshot(process, sink, flags);
+    storage_->base = storage_->buffer.data();
+    storage_->size = storage_->buffer.size();
+    Validate();
+  }
+
+  explicit Snapshot(Process const& process,
+                    std::wstring const& path,
+                    std::uint32_t flags = SnapshotFlags::kNone)
+  {
+    {
+      detail::SnapshotFileSink sink{path};
+      detail::CaptureSnapshot(process, sink, flags);
+    }
+
+    Open(path);
+  }
+
+  explicit Snapshot(std::wstring const& path)
+  {
+    Open(path);
+  }
+
+  explicit Snapshot(Process const&& process,
+                    std::uint32_t flags = SnapshotFlags::kNone) = delete;
+
+  explicit Snapshot(Process const&& process,
+                    std::wstring const& path,
+                    std::uint32_t flags = SnapshotFlags::kNone) = delete;
+
+  DWORD GetProcessId() const noexcept
+  {
+    return GetHeader().process_id;
+  }
+
+  std::time_t GetTime() const noexcept
+  {
+    return static_cast<std::time_t>(GetHeader().time);
+  }
+
+  std::uint32_t GetFlags() const noexcept
+  {
+    return GetHeader().flags;
+  }
+
+  std::uint32_t GetPageSize() const noexcept
+  {
+    return GetHeader().page_size;
+  }
+
+  std::size_t GetRegionCount() const noexcept
+  {
+    return static_cast<std::size_t>(GetHeader().region_count);
+  }
+
+  SnapshotRegion const* GetRegions() const noexcept
+  {
+    return reinterpret_cast<SnapshotRegion const*>(
+      storage_->base + GetHeader().region_offset);
+  }
+
+  std::size_t GetPageCount() const noexcept
+  {
+    return static_cast<std::size_t>(GetHeader().page_count);
+  }
+
+  SnapshotPage const* GetPages() const noexcept
+  {
+    return reinterpret_cast<SnapshotPage const*>(storage_->base +
+                                                 GetHeader().page_offset);
+  }
+
+  // Returns nullptr if the page could not be read at capture time.
+  std::uint8_t const* GetPageData(SnapshotPage const& page) const noexcept
+  {
+    return page.data_offset == detail::SnapshotTraits::kNoData
+             ? nullptr
+             : storage_->base + page.data_offset;
+  }
+
+  // Returns nullptr if the page containing address was not captured.
+  SnapshotPage const* FindPage(void const* address) const noexcept
+  {
+    std::uint64_t const page_addr =
+      reinterpret_cast<std::uintptr_t>(address) &
+      ~static_cast<std::uint64_t>(GetPageSize() - 1);
+    SnapshotPage const* const beg = GetPages();
+    SnapshotPage const* const end = beg + GetPageCount();
+    auto const iter = std::lower_bound(
+      beg, end, page_addr, [](SnapshotPage const& page, std::uint64_t addr) {
+        return page.address < addr;
+      });
+    return (iter != end && iter->address == page_addr) ? iter : nullptr;
+  }
+
+  std::uint64_t GetStorageSize() const noexcept
+  {
+    return storage_->size;
+  }
+
+  void Save(std::wstring const& path) const
+  {
+    detail::SnapshotFileSink sink{path};
+    sink.Write(storage_->base, static_cast<std::size_t>(storage_->size));
+  }
+
+private:
+  struct Storage
+  {
+    std::vector<std::uint8_t> buffer;
+    detail::SmartFileHandle file;
+    detail::SmartHandle mapping;
+    detail::SmartMappedFileHandle view;
+    std::uint8_t const* base{};
+    std::uint64_t size{};
+  };
+
+  SnapshotHeader const& GetHeader() const noexcept
+  {
+    return *reinterpret_cast<SnapshotHeader const*>(storage_->base);
+  }
+
+  void Open(std::wstring const& path)
+  {
+    auto storage = std::make_shared<Storage>();
+
+    storage->file = ::CreateFileW(path.c_str(),
+                                  GENERIC_READ,
+                                  FILE_SHARE_READ,
+                                  nullptr,
+                                  OPEN_EXISTING,
+                                  FILE_FLAG_RANDOM_ACCESS,
+                                  nullptr);
+    if (!storage->file.IsValid())
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"CreateFileW failed."}
+                                      << ErrorCodeWinLast{last_error});
+    }
+
+    LARGE_INTEGER file_size{};
+    if (!::GetFileSizeEx(storage->file.GetHandle(), &file_size))
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"GetFileSizeEx failed."}
+                                      << ErrorCodeWinLast{last_error});
+    }
+
+    if (file_size.QuadPart < static_cast<LONGLONG>(sizeof(SnapshotHeader)) ||
+        static_cast<std::uint64_t>(file_size.QuadPart) >
+          static_cast<std::uint64_t>((std::numeric_limits<SIZE_T>::max)()))
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Invalid snapshot file size."});
+    }
+
+    storage->mapping = ::CreateFileMappingW(
+      storage->file.GetHandle(), nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!storage->mapping.IsValid())
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"CreateFileMappingW failed."}
+                << ErrorCodeWinLast{last_error});
+    }
+
+    storage->view = ::MapViewOfFile(
+      storage->mapping.GetHandle(), FILE_MAP_READ, 0, 0, 0);
+    if (!storage->view.IsValid())
+    {
+      DWORD const last_error = ::GetLastError();
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"MapViewOfFile failed."}
+                                      << ErrorCodeWinLast{last_error});
+    }
+
+    storage->base = static_cast<std::uint8_t const*>(storage->view.GetHandle());
+    storage->size = static_cast<std::uint64_t>(file_size.QuadPart);
+
+    storage_ = std::move(storage);
+    Validate();
+  }
+
+  // Snapshot files come from disk, so don't trust anything in them.
+  void Validate() const
+  {
+    auto const fail = [] {
+      HADESMEM_DETAIL_THROW_EXCEPTION(
+        Error{} << ErrorString{"Invalid or corrupt snapshot."});
+    };
+
+    std::uint64_t const size = storage_->size;
+    if (size < sizeof(SnapshotHeader))
+    {
+      fail();
+    }
+
+    SnapshotHeader const& header = GetHeader();
+    if (header.magic != detail::SnapshotTraits::kMagic ||
+        header.version != detail::SnapshotTraits::kVersion ||
+        header.page_size != detail::SnapshotTraits::kPageSize ||
+        header.file_size != size)
+    {
+      fail();
+    }
+
+    auto const fits = [&](std::uint64_t offset,
+                          std::uint64_t count,
+                          std::uint64_t elem_size) {
+      return offset <= size && count <= (size - offset) / elem_size;
+    };
+
+    if (!fits(header.region_offset,
+              header.region_count,
+              sizeof(SnapshotRegion)) ||
+        !fits(header.page_offset, header.page_count, sizeof(SnapshotPage)) ||
+        header.region_offset % 8 || header.page_offset % 8)
+    {
+      fail();
+    }
+
+    SnapshotRegion const* const regions = GetRegions();
+    for (std::size_t i = 0; i < GetRegionCount(); ++i)
+    {
+      SnapshotRegion const& region = regions[i];
+      if (region.first_page > header.page_count ||
+          region.page_count > header.page_count - region.first_page)
+      {
+        fail();
+      }
+    }
+
+    SnapshotPage const* const pages = GetPages();
+    for (std::size_t i = 0; i < GetPageCount(); ++i)
+    {
+      SnapshotPage const& page = pages[i];
+      if ((i && page.address <= pages[i - 1].address) ||
+          (page.data_offset != detail::SnapshotTraits::kNoData &&
+           !fits(page.data_offset, 1, header.page_size)))
+      {
+        fail();
+      }
+    }
+  }
+
+  std::shared_ptr<Storage> storage_;
+};
+
+// Run of bytes which differ between two snapshots. Data pointers refer into
+// the snapshots, so are only valid as long as they are. If a page is only
+// present in (or only readable in) one of the snapshots then the entire page
+// is reported, with nullptr for the missing side.
+struct SnapshotDiffRun
+{
+  std::uint64_t address;
+  std::size_t len;
+  std::uint8_t const* old_data;
+  std::uint8_t const* new_data;
+};
+
+// Calls func(SnapshotDiffRun const&) for each changed run, in address order.
+// Only pages whose hashes differ are compared byte by byte. Differing bytes
+// separated by merge_gap or fewer unchanged bytes are reported as one run.
+template <typename Func>
+inline void ForEachSnapshotDiff(Snapshot const& lhs,
+                                Snapshot const& rhs,
+                                Func func,
+                                std::size_t merge_gap = 0)
+{
+  std::size_t const page_size = lhs.GetPageSize();
+  if (rhs.GetPageSize() != page_size)
+  {
+    HADESMEM_DETAIL_THROW_EXCEPTION(
+      Error{} << ErrorString{"Mismatched snapshot page sizes."});
+  }
+
+  SnapshotPage const* l = lhs.GetPages();
+  SnapshotPage const* const l_end = l + lhs.GetPageCount();
+  SnapshotPage const* r = rhs.GetPages();
+  SnapshotPage const* const r_end = r + rhs.GetPageCount();
+
+  while (l != l_end || r != r_end)
+  {
+    std::uint8_t const* l_data = nullptr;
+    std::uint8_t const* r_data = nullptr;
+    std::uint64_t address = 0;
+    bool same_page = false;
+    if (r == r_end || (l != l_end && l->address < r->address))
+    {
+      address = l->address;
+      l_data = lhs.GetPageData(*l++);
+    }
+    else if (l == l_end || r->address < l->address)
+    {
+      address = r->address;
+      r_data = rhs.GetPageData(*r++);
+    }
+    else
+    {
+      address = l->address;
+      same_page = l->hash == r->hash;
+      l_data = lhs.GetPageData(*l++);
+      r_data = rhs.GetPageData(*r++);
+    }
+
+    if (!l_data && !r_data)
+    {
+      continue;
+    }
+
+    if (!l_data || !r_data)
+    {
+      func(SnapshotDiffRun{address, page_size, l_data, r_data});
+      continue;
+    }
+
+    if (same_page)
+    {
+      continue;
+    }
+
+    std::size_t pos = 0;
+    for (;;)
+    {
+      pos = detail::SnapshotFindMismatch(l_data, r_data, pos, page_size);
+      if (pos == page_size)
+      {
+        break;
+      }
+
+      std::size_t last = pos;
+      for (std::size_t i = pos + 1; i < page_size && i - last <= merge_gap + 1;
+           ++i)
+      {
+        if (l_data[i] != r_data[i])
+        {
+          last = i;
+        }
+      }
+
+      func(SnapshotDiffRun{
+        address + pos, last + 1 - pos, l_data + pos, r_data + pos});
+      pos = last + 1;
+    }
+  }
+}
+
+inline std::vector<SnapshotDiffRun> DiffSnapshots(Snapshot const& lhs,
+                                                  Snapshot const& rhs,
+                                                  std::size_t merge_gap = 0)
+{
+  std::vector<SnapshotDiffRun> runs;
+  ForEachSnapshotDiff(lhs,
+                      rhs,
+                      [&](SnapshotDiffRun const& run) { runs.push_back(run); },
+                      merge_gap);
+  return runs;
+}
+}
@@ -0,0 +1,494 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <windows.h>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/detail/protect_region.hpp>
+#include <hadesmem/detail/query_region.hpp>
+#include <hadesmem/detail/read_cache.hpp>
+#include <hadesmem/detail/read_impl.hpp>
+#include <hadesmem/detail/static_assert.hpp>
+#include <hadesmem/detail/trace.hpp>
+#include <hadesmem/detail/type_traits.hpp>
+#include <hadesmem/detail/write_impl.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/flush.hpp>
+#include <hadesmem/process.hpp>
+
+// TODO: Use this in Patcher and the dump tool's import/VMT rewriting.
+
+// TODO: Add a 'forced' mode to allow writing to pages with a 'bad' protection
+// mask (see ProtectGuard).
+
+namespace hadesmem
+{
+// Collects writes and applies them as a single transaction. Committing changes
+// protection once per affected page range (rather than once per write),
+// issues one write per contiguous run of written bytes, and flushes the
+// instruction cache once if any executable memory was touched. If any write
+// fails then everything already written is rolled back.
+//
+// Overlapping writes are applied in the order they were added.
+class WriteBatch
+{
+public:
+  explicit WriteBatch(Process const& process) : process_{&process}
+  {
+  }
+
+  explicit WriteBatch(Process const&& process) = delete;
+
+  void Add(PVOID address, LPCVOID data, std::size_t len)
+  {
+    HADESMEM_DETAIL_ASSERT(address != nullptr);
+    HADESMEM_DETAIL_ASSERT(len ? data != nullptr : true);
+
+    if (!len)
+    {
+      return;
+    }
+
+    auto const address_raw = reinterpret_cast<std::uintptr_t>(address);
+    if (address_raw + len < address_raw)
+    {
+      HADESMEM_DETAIL_THROW_EXCEPTION(Error{}
+                                      << ErrorString{"Invalid write range."});
+    }
+
+    auto const data_beg = static_cast<std::uint8_t const*>(data);
+    entries_.push_back(Entry{address_raw, data_.size(), len});
+    data_.insert(std::end(data_), data_beg, data_beg + len);
+  }
+
+  template <typename T> void Add(PVOID address, T const& data)
+  {
+    HADESMEM_DETAIL_STATIC_ASSERT(detail::IsTriviallyCopyable<T>::value);
+
+    Add(address, std::addressof(data), sizeof(data));
+  }
+
+  template <typename T>
+  void Add(PVOID address, std::vector<T> const& data)
+  {
+    HADESMEM_DETAIL_STATIC_ASSERT(detail::IsTriviallyCopyable<T>::value);
+
+    Add(address, data.data(), data.size() * sizeof(T));
+  }
+
+  std::size_t GetSize() const noexcept
+  {
+    return entries_.size();
+  }
+
+  bool IsEmpty() const noexcept
+  {
+    return entries_.empty();
+  }
+
+  void Clear() noexcept
+  {
+    entries_.clear();
+    data_.clear();
+  }
+
+  // Called by Commit before each contiguous run of bytes is written, with the
+  // index of the run (in address order). If it throws, the commit fails as if
+  // that write had. Only intended for testing the rollback, as there's no
+  // reliable way to make a write fail partway through a batch otherwise.
+  void SetApplyHook(std::function<void(std::size_t)> hook)
+  {
+    apply_hook_ = std::move(hook);
+  }
+
+  // Applies every write in the batch, then clears it. If any write fails then
+  // anything already written is rolled back and the batch is left untouched so
+  // it can be inspected or retried.
+  void Commit()
+  {
+    if (entries_.empty())
+    {
+      return;
+    }
+
+    std::vector<Run> runs = BuildRuns();
+    std::vector<Region> regions = QueryRegions(runs);
+
+    // Everything which can fail without side effects has been checked, so from
+    // here on we need to undo what we've done if anything goes wrong.
+    try
+    {
+      for (auto& region : regions)
+      {
+        MakeWritable(region);
+      }
+
+      Backup(runs);
+      Apply(runs);
+    }
+    catch (...)
+    {
+      RollbackUnchecked(runs, regions);
+      throw;
+    }
+
+    Restore(regions);
+
+    Flush(runs, regions);
+
+    Clear();
+  }
+
+private:
+  struct Entry
+  {
+    std::uintptr_t address;
+    std::size_t offset;
+    std::size_t len;
+  };
+
+  // Contiguous run of written bytes. Holds the original bytes (for rollback)
+  // and the final bytes (all overlapping writes applied in order).
+  struct Run
+  {
+    std::uintptr_t beg;
+    std::uintptr_t end;
+    std::vector<std::uint8_t> original;
+    std::vector<std::uint8_t> data;
+    bool backed_up;
+    bool written;
+  };
+
+  // Part of a region covered by the batch. Protection is only changed on the
+  // pages we actually write to, not the entire region.
+  struct Region
+  {
+    MEMORY_BASIC_INFORMATION mbi;
+    DWORD old_protect;
+  };
+
+  static std::uintptr_t const kPageSize = 0x1000;
+
+  static std::uintptr_t PageDown(std::uintptr_t address) noexcept
+  {
+    return address & ~(kPageSize - 1);
+  }
+
+  static std::uintptr_t PageUp(std::uintptr_t address) noexcept
+  {
+    return PageDown(address + kPageSize - 1);
+  }
+
+  std::vector<Run> BuildRuns() const
+  {
+    std::vector<std::size_t> order(entries_.size());
+    for (std::size_t i = 0; i < order.size(); ++i)
+    {
+      order[i] = i;
+    }
+
+    std::stable_sort(std::begin(order),
+                     std::end(order),
+                     [&](std::size_t lhs, std::size_t rhs) {
+                       return entries_[lhs].address < entries_[rhs].address;
+                     });
+
+    // Group the entries into runs first, and only then fill in each run's data
+    // in insertion order so the last write to a given byte wins.
+    std::vector<Run> runs;
+    std::vector<std::size_t> run_index(entries_.size());
+    for (auto const i : order)
+    {
+      Entry const& entry = entries_[i];
+      std::uintptr_t const end = entry.address + entry.len;
+      if (!runs.empty() && entry.address <= runs.back().end)
+      {
+        runs.back().end = (std::max)(runs.back().end, end);
+      }
+      else
+      {
+        runs.push_back(Run{entry.address, end, {}, {}, false, false});
+      }
+
+      run_index[i] = runs.size() - 1;
+    }
+
+    for (auto& run : runs)
+    {
+      run.data.resize(static_cast<std::size_t>(run.end - run.beg));
+    }
+
+    for (std::size_t i = 0; i < entries_.size(); ++i)
+    {
+      Entry const& entry = entries_[i];
+      Run& run = runs[run_index[i]];
+      std::memcpy(run.data.data() + (entry.address - run.beg),
+                  data_.data() + entry.offset,
+                  entry.len);
+    }
+
+    return runs;
+  }
+
+  std::vector<Region> QueryRegions(std::vector<Run> const& runs) const
+  {
+    std::vector<Region> regions;
+    for (auto const& run : runs)
+    {
+      std::uintptr_t cur = (std::max)(PageDown(run.beg),
+                                      regions.empty()
+                                        ? std::uintptr_t{}
+                                        : GetRegionEnd(regions.back()));
+      std::uintptr_t const end = PageUp(run.end);
+      while (cur < end)
+      {
+        MEMORY_BASIC_INFORMATION mbi =
+          detail::Query(*process_, reinterpret_cast<void*>(cur));
+
+        if (mbi.State != MEM_COMMIT)
+        {
+          HADESMEM_DETAIL_THROW_EXCEPTION(
+            Error{} << ErrorString{"Attempt to write to uncommitted memory."});
+        }
+
+        if (detail::IsBadProtect(mbi))
+        {
+          HADESMEM_DETAIL_THROW_EXCEPTION(
+            Error{} << ErrorString{
+              "Attempt to access page with a 'bad' protection mask."});
+        }
+
+        auto const region_beg =
+          reinterpret_cast<std::uintptr_t>(mbi.BaseAddress);
+        std::uintptr_t const region_end = region_beg + mbi.RegionSize;
+        std::uintptr_t const clip_end = (std::min)(region_end, end);
+
+        // Extend the previous entry rather than adding a new one if this is
+        // the same region (runs separated by a page or less).
+        if (!regions.empty() &&
+            regions.back().mbi.AllocationBase == mbi.AllocationBase &&
+            regions.back().mbi.Protect == mbi.Protect &&
+            GetRegionEnd(regions.back()) == cur)
+        {
+          regions.back().mbi.RegionSize += clip_end - cur;
+        }
+        else
+        {
+          mbi.BaseAddress = reinterpret_cast<void*>(cur);
+          mbi.RegionSize = clip_end - cur;
+          regions.push_back(Region{mbi, 0});
+        }
+
+        cur = clip_end;
+      }
+    }
+
+    return regions;
+  }
+
+  static std::uintptr_t GetRegionEnd(Region const& region) noexcept
+  {
+    return reinterpret_cast<std::uintptr_t>(region.mbi.BaseAddress) +
+           region.mbi.RegionSize;
+  }
+
+  void MakeWritable(Region& region) const
+  {
+    if (detail::CanWrite(region.mbi))
+    {
+      return;
+    }
+
+    try
+    {
+      region.old_protect =
+        detail::Protect(*process_, region.mbi, PAGE_EXECUTE_READWRITE);
+    }
+    catch (...)
+    {
+      // Try and fall back to PAGE_READWRITE because we might not be allowed
+      // to set EXECUTE.
+      region.old_protect =
+        detail::Protect(*process_, region.mbi, PAGE_READWRITE);
+    }
+  }
+
+  void Backup(std::vector<Run>& runs) const
+  {
+    for (auto& run : runs)
+    {
+      run.original.resize(run.data.size());
+      detail::ReadUnchecked(*process_,
+                            reinterpret_cast<void*>(run.beg),
+                            run.original.data(),
+                            run.original.size());
+      run.backed_up = true;
+    }
+  }
+
+  void Apply(std::vector<Run>& runs) const
+  {
+    detail::ReadCache* const read_cache = process_->GetReadCache();
+    for (std::size_t i = 0; i < runs.size(); ++i)
+    {
+      Run& run = runs[i];
+      if (apply_hook_)
+      {
+        apply_hook_(i);
+      }
+
+      if (read_cache)
+      {
+        read_cache->OnWrite(reinterpret_cast<void*>(run.beg), run.data.size());
+      }
+
+      // Mark before writing, a failed write may still have written a partial
+      // run which needs to be rolled back.
+      run.written = true;
+      detail::WriteUnchecked(*process_,
+                             reinterpret_cast<void*>(run.beg),
+                             run.data.data(),
+                             run.data.size());
+    }
+  }
+
+  void Restore(std::vector<Region>& regions) const
+  {
+    // Attempt to restore everything even if something fails, then report the
+    // first failure. The writes themselves are not rolled back at this point,
+    // which matches the behaviour of a failed restore in WriteImpl.
+    std::exception_ptr error;
+    for (auto& region : regions)
+    {
+      if (!region.old_protect)
+      {
+        continue;
+      }
+
+      try
+      {
+        detail::Protect(*process_, region.mbi, region.old_protect);
+        region.old_protect = 0;
+      }
+      catch (...)
+      {
+        if (!error)
+        {
+          error = std::current_exception();
+        }
+      }
+    }
+
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+
+  void Flush(std::vector<Run> const& runs,
+             std::vector<Region> const& regions) const
+  {
+    std::uintptr_t flush_beg = 0;
+    std::uintptr_t flush_end = 0;
+    for (auto const& region : regions)
+    {
+      if (!detail::CanExecute(region.mbi))
+      {
+        continue;
+      }
+
+      auto const region_beg =
+        reinterpret_cast<std::uintptr_t>(region.mbi.BaseAddress);
+      std::uintptr_t const region_end = GetRegionEnd(region);
+      if (!flush_end)
+      {
+        flush_beg = region_beg;
+      }
+      flush_end = region_end;
+    }
+
+    if (!flush_end)
+    {
+      return;
+    }
+
+    // Clip to the bytes actually written.
+    flush_beg = (std::max)(flush_beg, runs.front().beg);
+    flush_end = (std::min)(flush_end, runs.back().end);
+    FlushInstructionCache(*process_,
+                          reinterpret_cast<void*>(flush_beg),
+                          static_cast<SIZE_T>(flush_end - flush_beg));
+  }
+
+  void RollbackUnchecked(std::vector<Run>& runs,
+                         std::vector<Region>& regions) const noexcept
+  {
+    try
+    {
+      for (auto& run : runs)
+      {
+        if (run.written && run.backed_up)
+        {
+          detail::WriteUnchecked(*process_,
+                                 reinterpret_cast<void*>(run.beg),
+                                 run.original.data(),
+                                 run.original.size());
+        }
+      }
+    }
+    catch (...)
+    {
+      // WARNING: Memory is left partially modified if the rollback fails.
+      HADESMEM_DETAIL_TRACE_A(
+        boost::current_exception_diagnostic_information().c_str());
+      HADESMEM_DETAIL_ASSERT(false);
+    }
+
+    try
+    {
+      Restore(regions);
+    }
+    catch (...)
+    {
+      // WARNING: Protection is not restored if 'Restore' fails.
+      HADESMEM_DETAIL_TRACE_A(
+        boost::current_exception_diagnostic_information().c_str());
+      HADESMEM_DETAIL_ASSERT(false);
+    }
+
+    if (detail::ReadCache* const read_cache = process_->GetReadCache())
+    {
+      try
+      {
+        for (auto const& run : runs)
+        {
+          read_cache->OnWrite(reinterpret_cast<void*>(run.beg),
+                              run.data.size());
+        }
+      }
+      catch (...)
+      {
+        read_cache->InvalidateAll();
+      }
+    }
+  }
+
+  Process const* process_;
+  std::vector<Entry> entries_;
+  std::vector<std::uint8_t> data_;
+  std::function<void(std::size_t)> apply_hook_;
+};
+}
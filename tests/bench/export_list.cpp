@@ -0,0 +1,194 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/export_list.hpp>
+#include <hadesmem/pelib/export_list.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/find_procedure.hpp>
+#include <hadesmem/pelib/export.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/image_mapper.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+#include <hadesmem/process.hpp>
+
+// Enumerates the exports of a synthetic file (see BuildSyntheticPe) with the
+// maximum number of exports (65,535, all by name), then times creating a
+// sample of exports one at a time via the standalone Export constructor, which
+// has to read the export tables for each export (i.e. what every iteration of
+// ExportList used to cost).
+//
+// Also times resolving 1,000 of its exports by name via ExportCache (i.e. the
+// imports of a typical module) against a linear search over ExportList.
+
+namespace
+{
+DWORD const kNumExports = 0xFFFF;
+
+template <typename Func> double TimeMs(Func f, std::size_t iterations)
+{
+  auto const beg = std::chrono::high_resolution_clock::now();
+  for (std::size_t i = 0; i < iterations; ++i)
+  {
+    f();
+  }
+  auto const end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(end - beg).count() /
+         iterations;
+}
+
+std::vector<std::uint8_t> BuildExportBenchFile()
+{
+  hadesmem::pelib::SyntheticPeOptions options;
+  options.is_64 = true;
+  options.num_exports = kNumExports;
+  return hadesmem::pelib::BuildSyntheticPe(options);
+}
+}
+
+void BenchExportList()
+{
+  std::size_t const kIterations = 10;
+  std::size_t const kSampleSize = 256;
+
+  std::vector<std::uint8_t> buf = BuildExportBenchFile();
+
+  hadesmem::Process const process(::GetCurrentProcessId());
+  hadesmem::PeFile const pe_file(process,
+                                 buf.data(),
+                                 hadesmem::PeFileType::kData,
+                                 static_cast<DWORD>(buf.size()));
+
+  std::size_t num_exports = 0;
+  std::size_t num_named = 0;
+  double const list_ms = TimeMs(
+    [&]() {
+      num_exports = 0;
+      num_named = 0;
+      hadesmem::ExportList const export_list(process, pe_file);
+      for (auto const& e : export_list)
+      {
+        ++num_exports;
+        num_named += e.ByName();
+      }
+    },
+    kIterations);
+
+  BOOST_TEST_EQ(num_exports, static_cast<std::size_t>(kNumExports));
+  BOOST_TEST_EQ(num_named, static_cast<std::size_t>(kNumExports));
+
+  std::size_t sample_named = 0;
+  double const standalone_ms = TimeMs(
+    [&]() {
+      sample_named = 0;
+      for (std::size_t i = 0; i < kSampleSize; ++i)
+      {
+        auto const procedure_number =
+          static_cast<WORD>(1 + i * (kNumExports / kSampleSize));
+        hadesmem::Export const e(process, pe_file, procedure_number);
+        sample_named += e.ByName();
+      }
+    },
+    1);
+
+  BOOST_TEST_EQ(sample_named, kSampleSize);
+
+  double const standalone_extrapolated_ms =
+    standalone_ms / kSampleSize * kNumExports;
+
+  std::cout << "Exports: " << num_exports << "\n";
+  std::cout << "ExportList: " << list_ms << " ms\n";
+  std::cout << "Standalone Export (extrapolated from " << kSampleSize
+            << " exports): " << standalone_extrapolated_ms << " ms\n";
+  std::cout << "Speedup: "
+            << (list_ms > 0 ? standalone_extrapolated_ms / list_ms : 0)
+            << "x\n";
+}
+
+void BenchFindProcedure()
+{
+  std::size_t const kNumLookups = 1000;
+  std::size_t const kLinearSampleSize = 10;
+
+  std::vector<std::uint8_t> image =
+    hadesmem::pelib::MapImage(hadesmem::pelib::PeView{
+      hadesmem::pelib::BufferSource{BuildExportBenchFile()},
+      hadesmem::PeFileType::kData});
+  auto const module = reinterpret_cast<HMODULE>(image.data());
+
+  std::vector<std::string> names;
+  for (std::size_t i = 0; i < kNumLookups; ++i)
+  {
+    names.push_back(hadesmem::pelib::GetSyntheticExportName(
+      static_cast<std::uint32_t>(i * (kNumExports / kNumLookups))));
+  }
+
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  std::size_t num_found = 0;
+  double const cache_ms = TimeMs(
+    [&]() {
+      num_found = 0;
+      hadesmem::detail::ExportCache cache{process};
+      for (auto const& name : names)
+      {
+        num_found += cache.FindProcedure(module, name) != nullptr;
+      }
+    },
+    10);
+
+  BOOST_TEST_EQ(num_found, kNumLookups);
+
+  std::size_t num_found_linear = 0;
+  double const linear_ms = TimeMs(
+    [&]() {
+      num_found_linear = 0;
+      for (std::size_t i = 0; i < kLinearSampleSize; ++i)
+      {
+        std::string const& name = names[i * (kNumLookups / kLinearSampleSize)];
+        auto const pred = [&](hadesmem::Export const& e) {
+          return e.ByName() && e.GetName() == name;
+        };
+        FARPROC const linear =
+          hadesmem::detail::GetProcAddressInternalFromPred(
+            process, module, pred);
+        BOOST_TEST(linear ==
+                   hadesmem::detail::GetProcAddressInternal(
+                     process, module, name));
+        num_found_linear += linear != nullptr;
+      }
+    },
+    1);
+
+  BOOST_TEST_EQ(num_found_linear, kLinearSampleSize);
+
+  double const linear_extrapolated_ms =
+    linear_ms / kLinearSampleSize * kNumLookups;
+
+  std::cout << "ExportCache (" << kNumLookups << " lookups): " << cache_ms
+            << " ms\n";
+  std::cout << "Linear search (extrapolated from " << kLinearSampleSize
+            << " lookups): " << linear_extrapolated_ms << " ms\n";
+  std::cout << "Speedup: "
+            << (cache_ms > 0 ? linear_extrapolated_ms / cache_ms : 0) << "x\n";
+}
+
+int main()
+{
+  BenchExportList();
+  BenchFindProcedure();
+  return boost::report_errors();
+}
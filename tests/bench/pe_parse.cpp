@@ -0,0 +1,234 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/base_relocation_table.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+
+// Measures the throughput of parsing the headers, exports, imports and
+// relocations of a set of synthetic files (32-bit and 64-bit, from almost
+// empty up to large system DLL sized tables) via the views. Only uses the
+// OS-independent parts of PeLib, so runs on any platform.
+//
+// Exports and imports are walked the same way ExportList and ImportDirList
+// do (every name, ordinal and thunk read and bounds checked), but using the
+// non-throwing reads, as a corpus scan would.
+
+namespace
+{
+std::size_t const kIterations = 100;
+
+struct BenchFile
+{
+  std::string name;
+  std::vector<std::uint8_t> data;
+};
+
+std::vector<BenchFile> GetBenchFiles()
+{
+  std::vector<BenchFile> files;
+  for (bool is_64 : {false, true})
+  {
+    std::string const arch = is_64 ? "x64" : "x86";
+
+    hadesmem::pelib::SyntheticPeOptions small;
+    small.is_64 = is_64;
+    small.num_exports = 10;
+    small.num_import_modules = 3;
+    small.num_imports_per_module = 10;
+    small.num_relocations = 100;
+    files.push_back(
+      BenchFile{arch + " small", hadesmem::pelib::BuildSyntheticPe(small)});
+
+    // Roughly the size of the tables in kernel32 and user32.
+    hadesmem::pelib::SyntheticPeOptions large;
+    large.is_64 = is_64;
+    large.num_extra_sections = 4;
+    large.num_exports = 1500;
+    large.num_import_modules = 50;
+    large.num_imports_per_module = 40;
+    large.num_relocations = 20000;
+    large.num_tls_callbacks = 2;
+    files.push_back(
+      BenchFile{arch + " large", hadesmem::pelib::BuildSyntheticPe(large)});
+  }
+
+  return files;
+}
+
+// Returns a checksum of what was parsed, so the work can't be optimized away
+// (and so it can be checked).
+std::uint64_t ParseHeaders(hadesmem::pelib::PeView const& view)
+{
+  std::uint64_t sum = view.GetAddressOfEntryPoint();
+  for (auto const& section : view.GetSections())
+  {
+    sum += view.RvaToOffset(section.VirtualAddress);
+  }
+  return sum;
+}
+
+std::uint64_t ParseExports(hadesmem::pelib::PeView const& view)
+{
+  auto const dir_data = view.GetDataDir(hadesmem::PeDataDir::Export);
+  auto const dir = view.TryReadRva<hadesmem::pelib::ImageExportDirectory>(
+    dir_data.VirtualAddress);
+  if (!dir || !dir->NumberOfNames)
+  {
+    return 0;
+  }
+
+  auto const functions = view.TryReadVectorRva<std::uint32_t>(
+    dir->AddressOfFunctions, dir->NumberOfFunctions);
+  auto const names = view.TryReadVectorRva<std::uint32_t>(
+    dir->AddressOfNames, dir->NumberOfNames);
+  auto const ordinals = view.TryReadVectorRva<std::uint16_t>(
+    dir->AddressOfNameOrdinals, dir->NumberOfNames);
+  if (!functions || !names || !ordinals)
+  {
+    return 0;
+  }
+
+  std::uint64_t sum = 0;
+  for (std::size_t i = 0; i < names->size(); ++i)
+  {
+    auto const name = view.TryReadStringRva<char>((*names)[i]);
+    std::uint16_t const ordinal = (*ordinals)[i];
+    if (name && ordinal < functions->size())
+    {
+      sum += name->size() + (*functions)[ordinal];
+    }
+  }
+  return sum;
+}
+
+template <typename Thunk>
+std::uint64_t ParseImportsImpl(hadesmem::pelib::PeView const& view,
+                               Thunk ordinal_flag)
+{
+  auto const dir_data = view.GetDataDir(hadesmem::PeDataDir::Import);
+  if (!dir_data.VirtualAddress)
+  {
+    return 0;
+  }
+
+  std::uint64_t sum = 0;
+  for (std::uint32_t rva = dir_data.VirtualAddress;;
+       rva += sizeof(hadesmem::pelib::ImageImportDescriptor))
+  {
+    auto const desc =
+      view.TryReadRva<hadesmem::pelib::ImageImportDescriptor>(rva);
+    if (!desc || !desc->FirstThunk)
+    {
+      break;
+    }
+
+    auto const module_name = view.TryReadStringRva<char>(desc->Name);
+    sum += module_name ? module_name->size() : 0;
+    for (std::uint32_t thunk_rva = desc->OriginalFirstThunk;;
+         thunk_rva += sizeof(Thunk))
+    {
+      auto const thunk = view.TryReadRva<Thunk>(thunk_rva);
+      if (!thunk || !*thunk)
+      {
+        break;
+      }
+
+      if (*thunk & ordinal_flag)
+      {
+        sum += *thunk & 0xFFFF;
+        continue;
+      }
+
+      auto const name = view.TryReadStringRva<char>(
+        static_cast<std::uint32_t>(*thunk) + sizeof(std::uint16_t));
+      sum += name ? name->size() : 0;
+    }
+  }
+  return sum;
+}
+
+std::uint64_t ParseImports(hadesmem::pelib::PeView const& view)
+{
+  return view.Is64()
+           ? ParseImportsImpl(view, hadesmem::pelib::kImageOrdinalFlag64)
+           : ParseImportsImpl(view, hadesmem::pelib::kImageOrdinalFlag32);
+}
+
+std::uint64_t ParseRelocations(hadesmem::pelib::PeView const& view)
+{
+  hadesmem::pelib::BaseRelocationTable const relocs{view};
+  return relocs.size() + relocs.GetTypesSeen();
+}
+
+// Parses the headers of each file in full every time, as a corpus scan would,
+// then times func over the result.
+template <typename Func>
+std::uint64_t BenchParse(char const* name,
+                         std::vector<BenchFile> const& files,
+                         Func func)
+{
+  std::cout << name << ":\n";
+  std::uint64_t total_sum = 0;
+  for (auto const& file : files)
+  {
+    hadesmem::pelib::BufferSource const source{file.data.data(),
+                                               file.data.size()};
+    std::uint64_t sum = 0;
+    auto const beg = std::chrono::high_resolution_clock::now();
+    for (std::size_t i = 0; i < kIterations; ++i)
+    {
+      auto const view =
+        hadesmem::pelib::PeView::TryParse(source, hadesmem::PeFileType::kData);
+      BOOST_TEST(view.HasValue());
+      sum += view ? func(*view) : 0;
+    }
+    auto const end = std::chrono::high_resolution_clock::now();
+
+    double const ms =
+      std::chrono::duration<double, std::milli>(end - beg).count() /
+      kIterations;
+    double const mb_per_s =
+      ms > 0 ? file.data.size() / (1024.0 * 1024.0) / (ms / 1000.0) : 0;
+    std::cout << "  " << file.name << " (" << file.data.size()
+              << " bytes): " << ms << " ms (" << mb_per_s << " MB/s, "
+              << (ms > 0 ? 1000.0 / ms : 0) << " files/s)\n";
+    total_sum += sum / kIterations;
+  }
+
+  return total_sum;
+}
+}
+
+void BenchPeParse()
+{
+  std::vector<BenchFile> const files = GetBenchFiles();
+
+  BOOST_TEST(BenchParse("Headers", files, &ParseHeaders) != 0);
+  BOOST_TEST(BenchParse("Exports", files, &ParseExports) != 0);
+  BOOST_TEST(BenchParse("Imports", files, &ParseImports) != 0);
+  BOOST_TEST(BenchParse("Relocations", files, &ParseRelocations) != 0);
+}
+
+int main()
+{
+  BenchPeParse();
+  return boost::report_errors();
+}
@@ -0,0 +1,97 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/view/pe_view.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/filesystem.hpp>
+#include <hadesmem/detail/self_path.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/section.hpp>
+#include <hadesmem/pelib/section_list.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/process.hpp>
+
+// Compares parsing the headers and section table of a file in a local buffer
+// (i.e. what Dump does for every file in a corpus scan) using the Process based
+// types against PeView.
+
+namespace
+{
+template <typename Func> double TimeMs(Func f, std::size_t iterations)
+{
+  auto const beg = std::chrono::high_resolution_clock::now();
+  for (std::size_t i = 0; i < iterations; ++i)
+  {
+    f();
+  }
+  auto const end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(end - beg).count() /
+         iterations;
+}
+}
+
+void BenchPeView()
+{
+  std::size_t const kIterations = 1000;
+
+  std::vector<char> buf =
+    hadesmem::detail::PeFileToBuffer(hadesmem::detail::GetSelfPath());
+
+  hadesmem::Process const process(::GetCurrentProcessId());
+  std::uintptr_t legacy_sum = 0;
+  double const legacy_ms = TimeMs(
+    [&]() {
+      hadesmem::PeFile const pe_file(process,
+                                     buf.data(),
+                                     hadesmem::PeFileType::kData,
+                                     static_cast<DWORD>(buf.size()));
+      hadesmem::NtHeaders const nt_headers(process, pe_file);
+      legacy_sum = reinterpret_cast<std::uintptr_t>(hadesmem::RvaToVa(
+                     process, pe_file, nt_headers.GetAddressOfEntryPoint())) -
+                   reinterpret_cast<std::uintptr_t>(buf.data());
+      for (auto const& section : hadesmem::SectionList(process, pe_file))
+      {
+        legacy_sum += section.GetVirtualAddress();
+      }
+    },
+    kIterations);
+
+  hadesmem::pelib::BufferSource const source{buf.data(), buf.size()};
+  std::uintptr_t view_sum = 0;
+  double const view_ms = TimeMs(
+    [&]() {
+      hadesmem::pelib::PeView const pe_view(source,
+                                            hadesmem::PeFileType::kData);
+      view_sum = pe_view.RvaToOffset(pe_view.GetAddressOfEntryPoint());
+      for (auto const& section : pe_view.GetSections())
+      {
+        view_sum += section.VirtualAddress;
+      }
+    },
+    kIterations);
+
+  BOOST_TEST_EQ(legacy_sum, view_sum);
+
+  std::cout << "PeFile + NtHeaders + SectionList: " << legacy_ms << " ms\n";
+  std::cout << "PeView: " << view_ms << " ms\n";
+  std::cout << "Speedup: " << (view_ms > 0 ? legacy_ms / view_ms : 0)
+            << "x\n";
+}
+
+int main()
+{
+  BenchPeView();
+  return boost::report_errors();
+}
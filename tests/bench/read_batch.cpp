@@ -0,0 +1,99 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/read_batch.hpp>
+#include <hadesmem/read_batch.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+
+// Compares ReadBatch against the equivalent loop of Read<T> calls for a set of
+// small scattered reads, similar to what PeLib does when walking thunk or
+// export tables.
+
+namespace
+{
+template <typename Func> double TimeMs(Func f, std::size_t iterations)
+{
+  auto const beg = std::chrono::high_resolution_clock::now();
+  for (std::size_t i = 0; i < iterations; ++i)
+  {
+    f();
+  }
+  auto const end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(end - beg).count() /
+         iterations;
+}
+}
+
+void BenchReadBatch()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  std::size_t const kBufLen = 0x100000;
+  std::size_t const kNumReads = 0x4000;
+  std::size_t const kIterations = 10;
+
+  std::vector<std::uint64_t> buf(kBufLen / sizeof(std::uint64_t));
+  std::mt19937 rng{0x1234};
+  for (auto& v : buf)
+  {
+    v = (static_cast<std::uint64_t>(rng()) << 32) | rng();
+  }
+
+  std::uniform_int_distribution<std::size_t> dist{0, buf.size() - 1};
+  std::vector<std::size_t> indexes(kNumReads);
+  for (auto& i : indexes)
+  {
+    i = dist(rng);
+  }
+
+  std::vector<std::uint64_t> loop_out(kNumReads);
+  double const loop_ms = TimeMs(
+    [&]() {
+      for (std::size_t i = 0; i < kNumReads; ++i)
+      {
+        loop_out[i] = hadesmem::Read<std::uint64_t>(process, &buf[indexes[i]]);
+      }
+    },
+    kIterations);
+
+  std::vector<std::uint64_t> batch_out(kNumReads);
+  std::vector<hadesmem::ReadBatchRequest> requests;
+  requests.reserve(kNumReads);
+  for (std::size_t i = 0; i < kNumReads; ++i)
+  {
+    requests.push_back(
+      hadesmem::MakeReadBatchRequest(&buf[indexes[i]], batch_out[i]));
+  }
+  std::size_t failed = 0;
+  double const batch_ms = TimeMs(
+    [&]() { failed = hadesmem::ReadBatch(process, requests); }, kIterations);
+
+  BOOST_TEST_EQ(failed, std::size_t{0});
+  BOOST_TEST(loop_out == batch_out);
+
+  std::cout << "Read<T> loop: " << loop_ms << " ms (" << kNumReads
+            << " reads)\n";
+  std::cout << "ReadBatch: " << batch_ms << " ms (" << kNumReads
+            << " reads)\n";
+  std::cout << "Speedup: " << (batch_ms > 0 ? loop_ms / batch_ms : 0)
+            << "x\n";
+}
+
+int main()
+{
+  BenchReadBatch();
+  return boost::report_errors();
+}
@@ -0,0 +1,149 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/cached_process.hpp>
+#include <hadesmem/cached_process.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/alloc.hpp>
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+#include <hadesmem/read.hpp>
+#include <hadesmem/write.hpp>
+
+void TestCachedProcess()
+{
+  hadesmem::CachedProcess process(::GetCurrentProcessId());
+  BOOST_TEST_EQ(process.GetId(), ::GetCurrentProcessId());
+  std::size_t const default_capacity =
+    hadesmem::CachedProcess::kDefaultCapacity;
+  BOOST_TEST_EQ(process.GetCapacity(), default_capacity);
+  BOOST_TEST(!process.IsFrozen());
+
+  SYSTEM_INFO sys_info{};
+  ::GetSystemInfo(&sys_info);
+  DWORD const page_size = sys_info.dwPageSize;
+
+  hadesmem::Allocator const allocator(process, page_size * 4);
+  auto const base = static_cast<std::uint8_t*>(allocator.GetBase());
+  for (DWORD i = 0; i < page_size * 4; ++i)
+  {
+    base[i] = static_cast<std::uint8_t>(i);
+  }
+
+  // Read which straddles a page boundary should fetch both pages once.
+  std::uint8_t* const straddle = base + page_size - 2;
+  auto const value = hadesmem::Read<std::uint32_t>(process, straddle);
+  std::uint32_t value_real = 0;
+  std::memcpy(&value_real, straddle, sizeof(value_real));
+  BOOST_TEST_EQ(value, value_real);
+  BOOST_TEST_EQ(process.GetMisses(), 2ULL);
+  BOOST_TEST_EQ(process.GetHits(), 0ULL);
+  BOOST_TEST_EQ(process.GetCachedPageCount(), 2UL);
+
+  hadesmem::Read<std::uint32_t>(process, straddle);
+  BOOST_TEST_EQ(process.GetMisses(), 2ULL);
+  BOOST_TEST_EQ(process.GetHits(), 2ULL);
+
+  // Direct modification is invisible until the cache is invalidated.
+  base[0] = 0xCC;
+  BOOST_TEST_EQ(hadesmem::Read<std::uint8_t>(process, base), 0);
+  process.Invalidate(base, 1);
+  BOOST_TEST_EQ(hadesmem::Read<std::uint8_t>(process, base), 0xCC);
+  BOOST_TEST_EQ(process.GetCachedPageCount(), 2UL);
+
+  // Writes through the process invalidate the pages they touch.
+  hadesmem::Write<std::uint8_t>(process, base + 1, 0xDD);
+  BOOST_TEST_EQ(process.GetCachedPageCount(), 1UL);
+  BOOST_TEST_EQ(hadesmem::Read<std::uint8_t>(process, base + 1), 0xDD);
+
+  // Frozen caches ignore writes.
+  process.Freeze();
+  BOOST_TEST(process.IsFrozen());
+  hadesmem::Write<std::uint8_t>(process, base + 2, 0xEE);
+  BOOST_TEST_EQ(hadesmem::Read<std::uint8_t>(process, base + 2), 2);
+  process.Thaw();
+  BOOST_TEST(!process.IsFrozen());
+  process.InvalidateAll();
+  BOOST_TEST_EQ(process.GetCachedPageCount(), 0UL);
+  BOOST_TEST_EQ(hadesmem::Read<std::uint8_t>(process, base + 2), 0xEE);
+
+  process.ResetCounters();
+  BOOST_TEST_EQ(process.GetHits(), 0ULL);
+  BOOST_TEST_EQ(process.GetMisses(), 0ULL);
+
+  // Strings are walked through the cache too.
+  std::string const str = "Hello, cache!";
+  char* const str_addr = reinterpret_cast<char*>(base + page_size * 2 - 5);
+  std::memcpy(str_addr, str.c_str(), str.size() + 1);
+  process.InvalidateAll();
+  BOOST_TEST_EQ(hadesmem::ReadString<char>(process, str_addr), str);
+  BOOST_TEST_EQ(
+    hadesmem::ReadStringBounded<char>(process, str_addr, str_addr + 5),
+    str.substr(0, 5));
+  BOOST_TEST(process.GetHits() != 0);
+}
+
+void TestCachedProcessEviction()
+{
+  hadesmem::CachedProcess process(::GetCurrentProcessId(), 2);
+  BOOST_TEST_EQ(process.GetCapacity(), 2UL);
+
+  SYSTEM_INFO sys_info{};
+  ::GetSystemInfo(&sys_info);
+  DWORD const page_size = sys_info.dwPageSize;
+
+  // The cached process is moved from below, so don't tie the allocation to it.
+  hadesmem::Process const process_alloc(::GetCurrentProcessId());
+  hadesmem::Allocator const allocator(process_alloc, page_size * 3);
+  auto const base = static_cast<std::uint8_t*>(allocator.GetBase());
+
+  hadesmem::Read<std::uint8_t>(process, base);
+  hadesmem::Read<std::uint8_t>(process, base + page_size);
+  hadesmem::Read<std::uint8_t>(process, base);
+  hadesmem::Read<std::uint8_t>(process, base + page_size * 2);
+  BOOST_TEST_EQ(process.GetCachedPageCount(), 2UL);
+  BOOST_TEST_EQ(process.GetMisses(), 3ULL);
+
+  // The second page was least recently used, so it should have been evicted.
+  hadesmem::Read<std::uint8_t>(process, base);
+  BOOST_TEST_EQ(process.GetMisses(), 3ULL);
+  hadesmem::Read<std::uint8_t>(process, base + page_size);
+  BOOST_TEST_EQ(process.GetMisses(), 4ULL);
+
+  // Frozen caches grow past their capacity, and shrink back when thawed.
+  process.Freeze();
+  hadesmem::Read<std::uint8_t>(process, base + page_size * 2);
+  hadesmem::Read<std::uint8_t>(process, base);
+  BOOST_TEST_EQ(process.GetCachedPageCount(), 3UL);
+  process.Thaw();
+  BOOST_TEST_EQ(process.GetCachedPageCount(), 2UL);
+
+  hadesmem::CachedProcess process_moved(std::move(process));
+  BOOST_TEST_EQ(process_moved.GetCachedPageCount(), 2UL);
+  hadesmem::Read<std::uint8_t>(process_moved, base);
+  BOOST_TEST_EQ(process_moved.GetMisses(), 5ULL);
+
+  // Copying out to a plain process drops the cache.
+  hadesmem::Process const process_plain(process_moved);
+  BOOST_TEST(process_plain.GetReadCache() == nullptr);
+  BOOST_TEST_EQ(process_plain, process_moved);
+}
+
+int main()
+{
+  TestCachedProcess();
+  TestCachedProcessEviction();
+  return boost::report_errors();
+}
@@ -4,6 +4,13 @@
 #include <hadesmem/find_pattern.hpp>
 #include <hadesmem/find_pattern.hpp>
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
 #include <hadesmem/detail/warning_disable_prefix.hpp>
 #include <boost/detail/lightweight_test.hpp>
 #include <hadesmem/detail/warning_disable_suffix.hpp>
@@ -26,6 +33,20 @@
 
 // TODO: LoadFile test.
 
+namespace
+{
+struct RelocatedData
+{
+  std::uintptr_t magic_1;
+  void* ptr;
+  std::uintptr_t magic_2;
+};
+
+// Initialized with its own address, so the pointer is covered by a base
+// relocation.
+RelocatedData g_relocated_data = {0x48414445, &g_relocated_data, 0x534D454D};
+}
+
 void TestFindPattern()
 {
   hadesmem::Process const process{::GetCurrentProcessId()};
@@ -272,8 +293,64 @@ void TestFindPattern()
     hadesmem::Error);
 }
 
+void TestFindPatternIgnoreRelocations()
+{
+  hadesmem::Process const process{::GetCurrentProcessId()};
+
+  // Pattern for g_relocated_data, except with the wrong pointer. It should
+  // only match if the relocated bytes are ignored.
+  RelocatedData data = g_relocated_data;
+  data.ptr = reinterpret_cast<void*>(
+    ~reinterpret_cast<std::uintptr_t>(g_relocated_data.ptr));
+  std::uint8_t bytes[sizeof(data)];
+  std::memcpy(bytes, &data, sizeof(data));
+  std::wostringstream pattern;
+  pattern << std::hex << std::setfill(L'0');
+  for (std::size_t i = 0; i < sizeof(bytes); ++i)
+  {
+    pattern << std::setw(2) << static_cast<unsigned int>(bytes[i]) << L' ';
+  }
+
+  BOOST_TEST_EQ(hadesmem::Find(process,
+                               L"",
+                               pattern.str(),
+                               hadesmem::PatternFlags::kScanData,
+                               0U),
+                static_cast<void*>(nullptr));
+  BOOST_TEST_EQ(
+    hadesmem::Find(process,
+                   L"",
+                   pattern.str(),
+                   hadesmem::PatternFlags::kScanData |
+                     hadesmem::PatternFlags::kIgnoreRelocations,
+                   0U),
+    static_cast<void*>(&g_relocated_data));
+
+  hadesmem::RelocationMaskCache relocation_masks{process};
+  auto const mask = relocation_masks.GetMask(::GetModuleHandleW(nullptr));
+  BOOST_TEST_EQ(relocation_masks.GetMask(::GetModuleHandleW(nullptr)), mask);
+  std::size_t const ptr_rva =
+    reinterpret_cast<std::uintptr_t>(&g_relocated_data.ptr) -
+    reinterpret_cast<std::uintptr_t>(::GetModuleHandleW(nullptr));
+  BOOST_TEST(mask->Test(ptr_rva));
+  BOOST_TEST(mask->Test(ptr_rva + sizeof(void*) - 1));
+  BOOST_TEST(!mask->Test(ptr_rva - 1));
+  BOOST_TEST(!mask->Test(ptr_rva + sizeof(void*)));
+
+  // Ignoring relocations still matches patterns which don't cover any.
+  BOOST_TEST_NE(hadesmem::Find(process,
+                               L"",
+                               L"90",
+                               hadesmem::PatternFlags::kIgnoreRelocations,
+                               0U,
+                               nullptr,
+                               &relocation_masks),
+                static_cast<void*>(nullptr));
+}
+
 int main()
 {
   TestFindPattern();
+  TestFindPatternIgnoreRelocations();
   return boost::report_errors();
 }
@@ -0,0 +1,310 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/view/pe_view.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#if defined(HADESMEM_FUZZ_WRITE_SEEDS)
+#include <fstream>
+#include <iostream>
+#endif // #if defined(HADESMEM_FUZZ_WRITE_SEEDS)
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/sha.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/base_relocation_table.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/image_mapper.hpp>
+#include <hadesmem/pelib/view/load_config_dir.hpp>
+#include <hadesmem/pelib/view/module_identity.hpp>
+#include <hadesmem/pelib/view/pe_builder.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_hash.hpp>
+#include <hadesmem/pelib/view/pe_result.hpp>
+#include <hadesmem/pelib/view/pe_summary.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+
+// libFuzzer target for parsing data files (PeFileType::kData) via the views.
+// Not part of the solution, as libFuzzer needs Clang. On Linux:
+//
+//   clang++ -std=c++14 -g -O1 -fsanitize=fuzzer,address,undefined
+//     -I include/memory tests/fuzz/pe_view.cpp -o fuzz_pe_view
+//   ./fuzz_pe_view corpus
+//
+// Random data almost never gets past the DOS header, so the corpus should be
+// seeded with synthetic files covering each of the tricky layouts:
+//
+//   clang++ -std=c++14 -DHADESMEM_FUZZ_WRITE_SEEDS -I include/memory
+//     tests/fuzz/pe_view.cpp -o fuzz_pe_view_seeds
+//   mkdir corpus && ./fuzz_pe_view_seeds corpus
+//
+// Malformed files may only ever cause a PeError, or a hadesmem::Error from the
+// throwing types (BaseRelocationTable, LoadConfigDir, MapImage and
+// PeBuilder). Anything else (a crash, a sanitizer report, another exception
+// type, or a timeout) is a bug.
+
+namespace
+{
+// Bounds the allocations made by MapImage and RelocationMask. Malformed files
+// can claim images far larger than the fuzzer's default memory limit.
+std::uint32_t const kMaxFuzzImageSize = 0x4000000;
+
+template <typename Thunk>
+void FuzzImports(hadesmem::pelib::PeView const& view, Thunk ordinal_flag)
+{
+  auto const dir_data = view.GetDataDir(hadesmem::PeDataDir::Import);
+  for (std::uint32_t rva = dir_data.VirtualAddress; rva;
+       rva += sizeof(hadesmem::pelib::ImageImportDescriptor))
+  {
+    auto const desc =
+      view.TryReadRva<hadesmem::pelib::ImageImportDescriptor>(rva);
+    if (!desc || !desc->FirstThunk)
+    {
+      break;
+    }
+
+    view.TryReadStringRva<char>(desc->Name);
+    std::uint32_t const thunks_rva =
+      desc->OriginalFirstThunk ? desc->OriginalFirstThunk : desc->FirstThunk;
+    for (std::uint32_t thunk_rva = thunks_rva; thunk_rva;
+         thunk_rva += sizeof(Thunk))
+    {
+      auto const thunk = view.TryReadRva<Thunk>(thunk_rva);
+      if (!thunk || !*thunk)
+      {
+        break;
+      }
+
+      if (!(*thunk & ordinal_flag))
+      {
+        view.TryReadStringRva<char>(static_cast<std::uint32_t>(*thunk) +
+                                    sizeof(std::uint16_t));
+      }
+    }
+  }
+}
+
+void FuzzExports(hadesmem::pelib::PeView const& view)
+{
+  auto const dir_data = view.GetDataDir(hadesmem::PeDataDir::Export);
+  auto const dir = view.TryReadRva<hadesmem::pelib::ImageExportDirectory>(
+    dir_data.VirtualAddress);
+  if (!dir)
+  {
+    return;
+  }
+
+  view.TryReadStringRva<char>(dir->Name);
+  auto const names = view.TryReadVectorRva<std::uint32_t>(
+    dir->AddressOfNames, dir->NumberOfNames);
+  if (names)
+  {
+    for (std::uint32_t name_rva : *names)
+    {
+      view.TryReadStringRva<char>(name_rva);
+    }
+  }
+}
+
+void FuzzPeView(hadesmem::pelib::PeView const& view)
+{
+  std::vector<std::uint32_t> rvas;
+  for (auto const& section : view.GetSections())
+  {
+    rvas.push_back(section.VirtualAddress);
+    rvas.push_back(section.VirtualAddress + section.SizeOfRawData);
+    view.FileOffsetToRva(section.PointerToRawData);
+    view.GetSectionIndex().FindRvaRange(
+      section.VirtualAddress, section.VirtualAddress + section.VirtualSize);
+  }
+
+  // The batch conversion must always agree with the single one.
+  std::vector<std::size_t> offsets(rvas.size());
+  view.RvasToOffsets(rvas.data(), rvas.size(), offsets.data());
+  for (std::size_t i = 0; i < rvas.size(); ++i)
+  {
+    if (offsets[i] != view.RvaToOffset(rvas[i]))
+    {
+      std::abort();
+    }
+  }
+
+  bool virtual_va = false;
+  view.RvaToOffset(view.GetAddressOfEntryPoint(), &virtual_va);
+  for (std::uint32_t i = 0; i < view.GetNumberOfRvaAndSizesClamped(); ++i)
+  {
+    view.RvaToPtr(
+      view.GetDataDir(static_cast<hadesmem::PeDataDir>(i)).VirtualAddress);
+  }
+
+  FuzzExports(view);
+  if (view.Is64())
+  {
+    FuzzImports(view, hadesmem::pelib::kImageOrdinalFlag64);
+  }
+  else
+  {
+    FuzzImports(view, hadesmem::pelib::kImageOrdinalFlag32);
+  }
+
+  hadesmem::pelib::ComputePeChecksum(view);
+  hadesmem::pelib::ComputePeImageHash<hadesmem::detail::Sha256>(view);
+
+  // Whatever the file, the summary must load again and be safe to iterate.
+  hadesmem::pelib::PeSummary const summary{
+    hadesmem::pelib::BufferSource{hadesmem::pelib::BuildPeSummary(view)}};
+  for (auto const& e : hadesmem::pelib::PeSummaryExportList{summary})
+  {
+    e.GetName();
+    e.GetForwarder();
+  }
+  for (auto const& dir : hadesmem::pelib::PeSummaryImportDirList{summary})
+  {
+    for (auto const& thunk : dir.GetThunks())
+    {
+      thunk.GetName();
+    }
+  }
+
+  // Malformed debug data is ignored rather than thrown.
+  hadesmem::pelib::GetModuleIdentity(view).ToString();
+
+  try
+  {
+    hadesmem::pelib::LoadConfigDir const load_config{view};
+    load_config.GetGuardCFFunctions();
+  }
+  catch (hadesmem::Error const&)
+  {
+  }
+
+  // The mask and the mapped image are both proportional to SizeOfImage (the
+  // latter after rounding up to SectionAlignment, which may be huge too).
+  if (hadesmem::pelib::detail::AlignUp(view.GetSizeOfImage(),
+                                       view.GetSectionAlignment()) >
+      kMaxFuzzImageSize)
+  {
+    return;
+  }
+
+  try
+  {
+    hadesmem::pelib::BaseRelocationTable const relocs{view};
+    hadesmem::pelib::RelocationMask const mask{relocs, view.GetSizeOfImage()};
+    mask.TestRange(0, view.GetSizeOfImage());
+  }
+  catch (hadesmem::Error const&)
+  {
+  }
+
+  try
+  {
+    // Rebased, so the relocations are applied too.
+    std::vector<std::uint8_t> image =
+      hadesmem::pelib::MapImage(view, view.GetImageBase() + 0x10000);
+    hadesmem::pelib::PeView const image_view{
+      hadesmem::pelib::BufferSource{std::move(image)},
+      hadesmem::PeFileType::kImage};
+    image_view.RvaToOffset(image_view.GetAddressOfEntryPoint());
+  }
+  catch (hadesmem::Error const&)
+  {
+  }
+
+  try
+  {
+    // Planned first, as the claimed section sizes may be huge too.
+    hadesmem::pelib::PeBuilder builder{view};
+    if (builder.CanAddSection())
+    {
+      builder.AddSection(".fuzz",
+                         hadesmem::pelib::detail::kSyntheticRData,
+                         std::vector<std::uint8_t>(0x10));
+    }
+    if (builder.Plan().file_size <= kMaxFuzzImageSize)
+    {
+      hadesmem::pelib::PeView::TryParse(
+        hadesmem::pelib::BufferSource{builder.Build()},
+        hadesmem::PeFileType::kData);
+    }
+  }
+  catch (hadesmem::Error const&)
+  {
+  }
+}
+}
+
+extern "C" int LLVMFuzzerTestOneInput(std::uint8_t const* data,
+                                      std::size_t size)
+{
+  hadesmem::pelib::BufferSource const source{data, size};
+  auto const view =
+    hadesmem::pelib::PeView::TryParse(source, hadesmem::PeFileType::kData);
+  if (view)
+  {
+    FuzzPeView(*view);
+  }
+
+  return 0;
+}
+
+#if defined(HADESMEM_FUZZ_WRITE_SEEDS)
+int main(int argc, char* argv[])
+{
+  if (argc != 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " <corpus dir>\n";
+    return 1;
+  }
+
+  std::uint32_t const flags[] = {
+    hadesmem::pelib::SyntheticPeFlags::kNone,
+    hadesmem::pelib::SyntheticPeFlags::kNoSections,
+    hadesmem::pelib::SyntheticPeFlags::kVirtualSectionTable,
+    hadesmem::pelib::SyntheticPeFlags::kEofTerminatedString,
+    hadesmem::pelib::SyntheticPeFlags::kNoSections |
+      hadesmem::pelib::SyntheticPeFlags::kEofTerminatedString};
+  std::size_t num_files = 0;
+  for (bool is_64 : {false, true})
+  {
+    for (std::uint32_t f : flags)
+    {
+      // Kept small, as libFuzzer mutates small inputs far more effectively.
+      hadesmem::pelib::SyntheticPeOptions options;
+      options.is_64 = is_64;
+      options.num_extra_sections = 1;
+      options.num_exports = 4;
+      options.num_import_modules = 2;
+      options.num_imports_per_module = 3;
+      options.num_relocations = 8;
+      options.num_tls_callbacks = 1;
+      options.flags = f;
+      std::vector<std::uint8_t> const file =
+        hadesmem::pelib::BuildSyntheticPe(options);
+
+      std::string const path = std::string{argv[1]} + "/synthetic_" +
+                               (is_64 ? "x64_" : "x86_") + std::to_string(f);
+      std::ofstream out{path, std::ios::binary};
+      out.write(reinterpret_cast<char const*>(file.data()),
+                static_cast<std::streamsize>(file.size()));
+      if (!out)
+      {
+        std::cerr << "Failed to write " << path << ".\n";
+        return 1;
+      }
+
+      ++num_files;
+    }
+  }
+
+  std::cout << "Wrote " << num_files << " files.\n";
+  return 0;
+}
+#endif // #if defined(HADESMEM_FUZZ_WRITE_SEEDS)
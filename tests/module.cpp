@@ -53,6 +53,14 @@ void TestModule()
   // Use an API that's unlikely to be hooked.
   BOOST_TEST_EQ(FindProcedure(process, ntdll_mod, "RtlRandom"),
                 GetProcAddress(ntdll_mod.GetHandle(), "RtlRandom"));
+  hadesmem::detail::ExportCache export_cache{process};
+  BOOST_TEST_EQ(FindProcedure(export_cache, ntdll_mod, "RtlRandom"),
+                GetProcAddress(ntdll_mod.GetHandle(), "RtlRandom"));
+  BOOST_TEST_EQ(FindProcedure(export_cache, ntdll_mod, "RtlRandomEx"),
+                GetProcAddress(ntdll_mod.GetHandle(), "RtlRandomEx"));
+  BOOST_TEST_THROWS(
+    FindProcedure(export_cache, this_mod, "non_existant_export"),
+    hadesmem::Error);
   hadesmem::Module const ntdll_mod_other{process, L"ntdll.dll"};
   BOOST_TEST_EQ(ntdll_mod, ntdll_mod_other);
   hadesmem::Module const ntdll_mod_from_handle{
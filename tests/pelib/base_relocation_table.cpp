@@ -0,0 +1,212 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/view/base_relocation_table.hpp>
+#include <hadesmem/pelib/view/base_relocation_table.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+
+namespace
+{
+std::uint16_t RelocEntry(std::uint16_t type, std::uint16_t offset)
+{
+  return static_cast<std::uint16_t>((type << 12) | offset);
+}
+
+void AppendBlock(std::vector<std::uint8_t>& dir,
+                 std::uint32_t rva,
+                 std::vector<std::uint16_t> const& entries)
+{
+  hadesmem::pelib::ImageBaseRelocation block{};
+  block.VirtualAddress = rva;
+  block.SizeOfBlock = static_cast<std::uint32_t>(
+    sizeof(block) + entries.size() * sizeof(std::uint16_t));
+  std::size_t const pos = dir.size();
+  dir.resize(pos + block.SizeOfBlock);
+  std::memcpy(&dir[pos], &block, sizeof(block));
+  if (!entries.empty())
+  {
+    std::memcpy(&dir[pos + sizeof(block)],
+                entries.data(),
+                entries.size() * sizeof(std::uint16_t));
+  }
+}
+}
+
+void TestBaseRelocationTable()
+{
+  // Long runs of a single type (decoded eight at a time where possible), with
+  // padding in the middle and at the end of a block to force the slow path.
+  std::vector<std::uint8_t> dir;
+  std::vector<std::uint16_t> entries;
+  for (std::uint16_t i = 0; i < 100; ++i)
+  {
+    entries.push_back(RelocEntry(hadesmem::pelib::kImageRelBasedDir64,
+                                 static_cast<std::uint16_t>(i * 8)));
+    if (i == 37)
+    {
+      entries.push_back(RelocEntry(hadesmem::pelib::kImageRelBasedAbsolute, 0));
+    }
+  }
+  entries.push_back(RelocEntry(hadesmem::pelib::kImageRelBasedAbsolute, 0));
+  AppendBlock(dir, 0x1000, entries);
+  AppendBlock(dir, 0x3000, {});
+  AppendBlock(
+    dir, 0x2000, {RelocEntry(hadesmem::pelib::kImageRelBasedDir64, 0xFF8)});
+
+  hadesmem::pelib::BaseRelocationTable const relocs{dir.data(), dir.size()};
+  BOOST_TEST_EQ(relocs.size(), 101UL);
+  for (std::size_t i = 0; i < 100; ++i)
+  {
+    BOOST_TEST_EQ(relocs.GetRvas()[i], 0x1000 + i * 8);
+    BOOST_TEST_EQ(relocs.GetTypes()[i], hadesmem::pelib::kImageRelBasedDir64);
+  }
+  BOOST_TEST_EQ(relocs.GetRvas()[100], 0x2FF8UL);
+  BOOST_TEST_EQ(relocs.GetTypesSeen(),
+                1U << hadesmem::pelib::kImageRelBasedDir64);
+  BOOST_TEST_EQ(relocs.GetEnd(), 0x3000ULL);
+
+  std::vector<std::uint8_t> image(0x3000);
+  std::uint64_t const value = 0x140001000ULL;
+  for (auto const rva : relocs.GetRvas())
+  {
+    std::memcpy(&image[rva], &value, sizeof(value));
+  }
+  relocs.Apply(image.data(), image.size(), 0x10000);
+  for (auto const rva : relocs.GetRvas())
+  {
+    std::uint64_t relocated;
+    std::memcpy(&relocated, &image[rva], sizeof(relocated));
+    BOOST_TEST_EQ(relocated, value + 0x10000);
+  }
+  BOOST_TEST_THROWS(relocs.Apply(image.data(), image.size() - 1, 1),
+                    hadesmem::Error);
+
+  hadesmem::pelib::RelocationMask const mask{relocs, image.size()};
+  BOOST_TEST_EQ(mask.GetSize(), image.size());
+  BOOST_TEST(!mask.Test(0xFFF));
+  BOOST_TEST(mask.Test(0x1000));
+  BOOST_TEST(mask.Test(0x131F));
+  BOOST_TEST(!mask.Test(0x1320));
+  BOOST_TEST(mask.Test(0x2FFF));
+  BOOST_TEST(!mask.Test(0x3000));
+  BOOST_TEST(!mask.TestRange(0x1320, 0x1CD8));
+  BOOST_TEST(mask.TestRange(0x1320, 0x1CD9));
+  BOOST_TEST(mask.TestRange(0x0, 0x1001));
+  BOOST_TEST(!mask.TestRange(0x0, 0x1000));
+  BOOST_TEST(!mask.TestRange(0x3000, 0x10));
+}
+
+void TestBaseRelocationTableMixed()
+{
+  // A mix of types, including a HIGHADJ (which takes two entries). The
+  // HIGHLOW relocations straddle a word of the mask.
+  std::vector<std::uint8_t> dir;
+  std::vector<std::uint16_t> entries;
+  for (std::uint16_t i = 0; i < 6; ++i)
+  {
+    entries.push_back(RelocEntry(hadesmem::pelib::kImageRelBasedHighLow,
+                                 static_cast<std::uint16_t>(0x13C + i * 4)));
+  }
+  entries.push_back(RelocEntry(hadesmem::pelib::kImageRelBasedHigh, 0x200));
+  entries.push_back(RelocEntry(hadesmem::pelib::kImageRelBasedHighAdj, 0x204));
+  entries.push_back(0xF000);
+  entries.push_back(RelocEntry(hadesmem::pelib::kImageRelBasedLow, 0x208));
+  AppendBlock(dir, 0, entries);
+
+  hadesmem::pelib::BaseRelocationTable const relocs{dir.data(), dir.size()};
+  BOOST_TEST_EQ(relocs.size(), 9UL);
+  BOOST_TEST_EQ(relocs.GetHighAdjParams().size(), 1UL);
+  BOOST_TEST_EQ(relocs.GetHighAdjParams()[0], 0xF000);
+  BOOST_TEST_EQ(relocs.GetTypes()[7], hadesmem::pelib::kImageRelBasedHighAdj);
+  BOOST_TEST_EQ(relocs.GetRvas()[8], 0x208UL);
+
+  std::vector<std::uint8_t> image(0x1000);
+  std::uint32_t const value = 0x0040F000;
+  for (std::size_t i = 0; i < 6; ++i)
+  {
+    std::memcpy(&image[0x13C + i * 4], &value, sizeof(value));
+  }
+  std::uint16_t const high = 0x0040;
+  std::uint16_t const high_adj = 0x0041;
+  std::uint16_t const low = 0xF000;
+  std::memcpy(&image[0x200], &high, sizeof(high));
+  std::memcpy(&image[0x204], &high_adj, sizeof(high_adj));
+  std::memcpy(&image[0x208], &low, sizeof(low));
+
+  relocs.Apply(image.data(), image.size(), 0x0FC00000);
+  for (std::size_t i = 0; i < 6; ++i)
+  {
+    std::uint32_t relocated;
+    std::memcpy(&relocated, &image[0x13C + i * 4], sizeof(relocated));
+    BOOST_TEST_EQ(relocated, 0x1000F000UL);
+  }
+  std::uint16_t relocated_16;
+  std::memcpy(&relocated_16, &image[0x200], sizeof(relocated_16));
+  BOOST_TEST_EQ(relocated_16, 0x1000);
+  std::memcpy(&relocated_16, &image[0x204], sizeof(relocated_16));
+  BOOST_TEST_EQ(relocated_16, 0x1001);
+  std::memcpy(&relocated_16, &image[0x208], sizeof(relocated_16));
+  BOOST_TEST_EQ(relocated_16, 0xF000);
+
+  hadesmem::pelib::RelocationMask const mask{relocs, image.size()};
+  BOOST_TEST(!mask.Test(0x13B));
+  BOOST_TEST(mask.Test(0x13C));
+  BOOST_TEST(mask.Test(0x140));
+  BOOST_TEST(mask.Test(0x153));
+  BOOST_TEST(!mask.Test(0x154));
+  BOOST_TEST(mask.TestRange(0x130, 0x10));
+  BOOST_TEST(!mask.TestRange(0x154, 0xAC));
+  BOOST_TEST(mask.Test(0x209));
+  BOOST_TEST(!mask.Test(0x20A));
+  BOOST_TEST(!mask.Test(0x202));
+}
+
+void TestBaseRelocationTableMalformed()
+{
+  std::vector<std::uint8_t> dir;
+  AppendBlock(dir, 0, {RelocEntry(7, 0)});
+  BOOST_TEST_THROWS(
+    hadesmem::pelib::BaseRelocationTable(dir.data(), dir.size()),
+    hadesmem::Error);
+
+  // HIGHADJ missing its parameter.
+  dir.clear();
+  AppendBlock(dir, 0, {RelocEntry(hadesmem::pelib::kImageRelBasedHighAdj, 0)});
+  BOOST_TEST_THROWS(
+    hadesmem::pelib::BaseRelocationTable(dir.data(), dir.size()),
+    hadesmem::Error);
+
+  // Block larger than the directory.
+  dir.clear();
+  AppendBlock(dir, 0, {RelocEntry(hadesmem::pelib::kImageRelBasedHighLow, 0)});
+  BOOST_TEST_THROWS(
+    hadesmem::pelib::BaseRelocationTable(dir.data(), dir.size() - 1),
+    hadesmem::Error);
+
+  // A trailing partial block header is ignored, the same as the loader.
+  BOOST_TEST_EQ(
+    hadesmem::pelib::BaseRelocationTable(dir.data(), dir.size()).size(), 1UL);
+  dir.resize(dir.size() + 4);
+  BOOST_TEST_EQ(
+    hadesmem::pelib::BaseRelocationTable(dir.data(), dir.size()).size(), 1UL);
+}
+
+int main()
+{
+  TestBaseRelocationTable();
+  TestBaseRelocationTableMixed();
+  TestBaseRelocationTableMalformed();
+  return boost::report_errors();
+}
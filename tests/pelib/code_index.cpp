@@ -0,0 +1,250 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/view/code_index.hpp>
+#include <hadesmem/pelib/view/code_index.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/image_mapper.hpp>
+#include <hadesmem/pelib/view/pe_builder.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+
+namespace
+{
+std::uint32_t const kInvalidIndex = hadesmem::pelib::CodeIndex::kInvalidIndex;
+
+// Four functions, valid in both 32 and 64-bit mode. The entry point (f0)
+// calls f1 and f2, f1 calls f3, and f3 tail calls f2. Offsets are relative
+// to the start of the section.
+std::uint8_t const kTestCode[] = {
+  // f0 (0x00)
+  0x55,                         // 00: push ebp
+  0x85, 0xC0,                   // 01: test eax, eax
+  0x74, 0x0B,                   // 03: jz 0x10
+  0xE8, 0x16, 0x00, 0x00, 0x00, // 05: call f1
+  0xE8, 0x31, 0x00, 0x00, 0x00, // 0A: call f2
+  0xC3,                         // 0F: ret
+  0xEB, 0xFD,                   // 10: jmp 0x0F
+  0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+  0xCC, 0xCC,
+  // f1 (0x20)
+  0x31, 0xC0,                         // 20: xor eax, eax
+  0xEB, 0x01,                         // 22: jmp 0x25
+  0xCC,                               // 24: (unreachable)
+  0xE8, 0x26, 0x00, 0x00, 0x00,       // 25: call f3
+  0xFF, 0x25, 0x00, 0x00, 0x00, 0x00, // 2A: jmp [...]
+  0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+  0xCC, 0xCC, 0xCC, 0xCC,
+  // f2 (0x40)
+  0xC3, // 40: ret
+  0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+  0xCC, 0xCC, 0xCC,
+  // f3 (0x50)
+  0x90,                         // 50: nop
+  0xE9, 0xEA, 0xFF, 0xFF, 0xFF, // 51: jmp f2
+  0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC};
+
+// The synthetic PE plus a section holding the test code (and the entry point
+// moved to f0). For 64-bit files, there is also an exception directory with
+// an entry for f0, and a chained entry for the block at 0x10.
+std::vector<std::uint8_t> BuildTestPe(bool is_64, std::uint32_t& code_rva)
+{
+  hadesmem::pelib::SyntheticPeOptions options;
+  options.is_64 = is_64;
+  auto const file = hadesmem::pelib::BuildSyntheticPe(options);
+  hadesmem::pelib::PeView const view{
+    hadesmem::pelib::BufferSource{file.data(), file.size()},
+    hadesmem::PeFileType::kData};
+
+  hadesmem::pelib::PeBuilder builder{view};
+  std::size_t const code_index = builder.AddSection(
+    ".code",
+    hadesmem::pelib::detail::kSyntheticCode,
+    std::vector<std::uint8_t>(std::begin(kTestCode), std::end(kTestCode)));
+  std::size_t const pdata_index =
+    builder.AddSection(".pdata",
+                       hadesmem::pelib::detail::kSyntheticRData,
+                       std::vector<std::uint8_t>(0x40));
+  auto const layout = builder.Plan();
+  code_rva = layout.sections[code_index].virtual_address;
+  std::uint32_t const pdata_rva = layout.sections[pdata_index].virtual_address;
+  builder.SetAddressOfEntryPoint(code_rva);
+
+  // Referenced rather than copied by the builder.
+  std::vector<std::uint8_t> pdata(0x40);
+  if (is_64)
+  {
+    // Two runtime functions, then the unwind info of each.
+    hadesmem::pelib::ImageRuntimeFunctionEntry entries[2] = {};
+    entries[0].BeginAddress = code_rva;
+    entries[0].EndAddress = code_rva + 0x12;
+    entries[0].UnwindInfoAddress = pdata_rva + 0x20;
+    entries[1].BeginAddress = code_rva + 0x10;
+    entries[1].EndAddress = code_rva + 0x12;
+    entries[1].UnwindInfoAddress = pdata_rva + 0x30;
+    hadesmem::pelib::ImageUnwindInfoHeader unwind_info[2] = {};
+    unwind_info[0].VersionAndFlags = 1;
+    unwind_info[1].VersionAndFlags = static_cast<std::uint8_t>(
+      1 | (hadesmem::pelib::kUnwFlagChainInfo << 3));
+
+    std::memcpy(pdata.data(), entries, sizeof(entries));
+    std::memcpy(&pdata[0x20], &unwind_info[0], sizeof(unwind_info[0]));
+    std::memcpy(&pdata[0x30], &unwind_info[1], sizeof(unwind_info[1]));
+    builder.SetSectionData(pdata_index, pdata.data(), pdata.size());
+
+    hadesmem::pelib::ImageDataDirectory exception_dir{};
+    exception_dir.VirtualAddress = pdata_rva;
+    exception_dir.Size = sizeof(entries);
+    builder.SetDataDir(hadesmem::PeDataDir::Exception, exception_dir);
+  }
+
+  return builder.Build();
+}
+
+hadesmem::pelib::PeView MakeView(std::vector<std::uint8_t> const& buf,
+                                 hadesmem::PeFileType type)
+{
+  return hadesmem::pelib::PeView{
+    hadesmem::pelib::BufferSource{buf.data(), buf.size()}, type};
+}
+
+std::vector<std::uint32_t> Offset(std::vector<std::uint32_t> rvas,
+                                  std::uint32_t base)
+{
+  for (auto& rva : rvas)
+  {
+    rva += base;
+  }
+  return rvas;
+}
+
+hadesmem::pelib::CodeIndexOptions MakeOptions(std::uint32_t flags,
+                                              std::uint32_t num_threads)
+{
+  hadesmem::pelib::CodeIndexOptions options;
+  options.flags = flags;
+  options.num_threads = num_threads;
+  return options;
+}
+
+void TestCodeIndex(bool is_64)
+{
+  std::uint32_t code_rva = 0;
+  auto const file = BuildTestPe(is_64, code_rva);
+  auto const file_view = MakeView(file, hadesmem::PeFileType::kData);
+  auto const image = hadesmem::pelib::MapImage(file_view);
+
+  for (auto const type :
+       {hadesmem::PeFileType::kData, hadesmem::PeFileType::kImage})
+  {
+    for (std::uint32_t const num_threads : {1U, 3U})
+    {
+      auto const view =
+        MakeView(type == hadesmem::PeFileType::kData ? file : image, type);
+      hadesmem::pelib::CodeIndex const index{
+        view, MakeOptions(hadesmem::pelib::CodeIndexFlags::kAll, num_threads)};
+
+      BOOST_TEST(index.GetFunctions() ==
+                 Offset({0x00, 0x20, 0x40, 0x50}, code_rva));
+      BOOST_TEST(index.GetFunctionEnds() ==
+                 Offset({0x12, 0x30, 0x41, 0x56}, code_rva));
+      BOOST_TEST(index.GetBlocks() ==
+                 Offset({0x00, 0x05, 0x0F, 0x10, 0x20, 0x25, 0x40, 0x50},
+                        code_rva));
+      BOOST_TEST(index.GetBlockEnds() ==
+                 Offset({0x05, 0x0F, 0x10, 0x12, 0x24, 0x30, 0x41, 0x56},
+                        code_rva));
+
+      BOOST_TEST(index.IsFunctionStart(code_rva + 0x20));
+      BOOST_TEST(!index.IsFunctionStart(code_rva + 0x22));
+      BOOST_TEST_EQ(index.FindFunction(code_rva + 0x24), 1UL);
+      BOOST_TEST_EQ(index.FindFunction(code_rva + 0x30), kInvalidIndex);
+      BOOST_TEST_EQ(index.FindBlock(code_rva + 0x24), kInvalidIndex);
+      BOOST_TEST_EQ(index.FindBlock(code_rva + 0x0E), 1UL);
+      BOOST_TEST_EQ(index.GetSafePatchSize(code_rva), 5UL);
+      BOOST_TEST_EQ(index.GetSafePatchSize(code_rva + 0x05), 0x0AUL);
+      BOOST_TEST_EQ(index.GetSafePatchSize(code_rva + 0x40), 1UL);
+      BOOST_TEST_EQ(index.GetSafePatchSize(code_rva + 0x42), 0UL);
+    }
+  }
+
+  // Without following calls only the seeds are analyzed. The chained entry
+  // in the exception directory still seeds a block, but not a function.
+  hadesmem::pelib::CodeIndex const seeds_only{
+    file_view,
+    MakeOptions(hadesmem::pelib::CodeIndexFlags::kAll &
+                  ~hadesmem::pelib::CodeIndexFlags::kFollowCalls,
+                1)};
+  BOOST_TEST(seeds_only.GetFunctions() == Offset({0x00}, code_rva));
+  BOOST_TEST(seeds_only.GetBlocks() ==
+             Offset({0x00, 0x05, 0x0F, 0x10}, code_rva));
+
+  if (is_64)
+  {
+    hadesmem::pelib::CodeIndex const chunk_only{
+      file_view,
+      MakeOptions(hadesmem::pelib::CodeIndexFlags::kSeedExceptionData, 1)};
+    BOOST_TEST(chunk_only.GetFunctions() == Offset({0x00}, code_rva));
+    BOOST_TEST(chunk_only.GetBlocks() ==
+               Offset({0x00, 0x05, 0x0F, 0x10}, code_rva));
+  }
+
+  hadesmem::pelib::CodeIndex const none{
+    file_view, MakeOptions(hadesmem::pelib::CodeIndexFlags::kNone, 1)};
+  BOOST_TEST(none.GetFunctions().empty());
+  BOOST_TEST(none.GetBlocks().empty());
+  BOOST_TEST_EQ(none.FindBlock(code_rva), kInvalidIndex);
+
+  // The file and the image have the same identity, so share an index.
+  hadesmem::pelib::CodeIndexCache cache;
+  auto const file_index = cache.GetIndex(file_view);
+  BOOST_TEST(file_index == cache.GetIndex(
+                             MakeView(image, hadesmem::PeFileType::kImage)));
+  BOOST_TEST_EQ(file_index->GetFunctions().size(), 4UL);
+  cache.Clear();
+  BOOST_TEST(file_index != cache.GetIndex(file_view));
+}
+
+void TestCodeIndexExports(bool is_64)
+{
+  // Every export (and the entry point) is a single ret.
+  hadesmem::pelib::SyntheticPeOptions options;
+  options.is_64 = is_64;
+  options.num_exports = 300;
+  auto const file = hadesmem::pelib::BuildSyntheticPe(options);
+  auto const view = MakeView(file, hadesmem::PeFileType::kData);
+
+  hadesmem::pelib::CodeIndex const index{
+    view, MakeOptions(hadesmem::pelib::CodeIndexFlags::kAll, 4)};
+  BOOST_TEST_EQ(index.GetFunctions().size(), 301UL);
+  BOOST_TEST(index.GetFunctions() == index.GetBlocks());
+  for (std::size_t i = 0; i < index.GetFunctions().size(); ++i)
+  {
+    BOOST_TEST_EQ(index.GetFunctionEnds()[i], index.GetFunctions()[i] + 1);
+    BOOST_TEST_EQ(index.GetBlockEnds()[i], index.GetBlocks()[i] + 1);
+  }
+  BOOST_TEST(index.IsFunctionStart(view.GetAddressOfEntryPoint()));
+}
+}
+
+int main()
+{
+  TestCodeIndex(false);
+  TestCodeIndex(true);
+  TestCodeIndexExports(false);
+  TestCodeIndexExports(true);
+  return boost::report_errors();
+}
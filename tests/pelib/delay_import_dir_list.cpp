@@ -0,0 +1,313 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/delay_import_dir_list.hpp>
+#include <hadesmem/pelib/delay_import_dir_list.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/pelib/delay_import_dir.hpp>
+#include <hadesmem/pelib/delay_import_thunk_list.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+#include <hadesmem/process.hpp>
+
+namespace
+{
+DWORD const kImageBase = 0x400000;
+DWORD const kDelayImportSize = 0x2000;
+std::size_t const kNumOrdinalImports = 100;
+
+// A delay import directory filling the extra section of a synthetic file.
+// Offsets are from the start of the section, which holds the descriptors.
+//
+// The first module imports a short name, an ordinal and a name too long for
+// the batched read. The second imports a name outside the file. The third
+// imports enough ordinals to need more than one read of its thunk arrays.
+class DelayImportTestFile
+{
+public:
+  DelayImportTestFile(bool is64, bool rva_based)
+    : builder_{MakeOptions(is64), kDelayImportSize},
+      is64_{is64},
+      rva_based_{rva_based}
+  {
+    builder_.GetBuilder().SetImageBase(kImageBase);
+    // The size is deliberately too small, as the loader ignores it.
+    builder_.SetDataDir(hadesmem::PeDataDir::DelayImport,
+                        GetRva(0),
+                        sizeof(hadesmem::pelib::ImageDelayLoadDescriptor));
+
+    WriteString(0x100, "kernel32.dll");
+    WriteString(0x120, "user32.dll");
+    WriteString(0x140, "ws2_32.dll");
+
+    WriteDescriptor(0, 0x100, 0x200, 0x300);
+    WriteDescriptor(1, 0x120, 0x280, 0x380);
+    WriteDescriptor(2, 0x140, 0x800, 0x1000);
+
+    WriteWord(0x500, 1);
+    WriteString(0x502, "Sleep");
+    WriteWord(0x600, 7);
+    WriteString(0x602, GetLongName());
+
+    WriteThunk(0x200, 0, Address(GetRva(0x500)));
+    WriteThunk(0x200, 1, GetOrdinalFlag() | 42);
+    WriteThunk(0x200, 2, Address(GetRva(0x600)));
+    for (std::size_t i = 0; i < 3; ++i)
+    {
+      WriteThunk(0x300, i, kImageBase + 0x2F00 + i * 0x10);
+    }
+
+    WriteThunk(0x280, 0, Address(0x90000));
+    WriteThunk(0x380, 0, kImageBase + 0x2F80);
+
+    for (std::size_t i = 0; i < kNumOrdinalImports; ++i)
+    {
+      WriteThunk(0x800, i, GetOrdinalFlag() | (i + 1));
+      WriteThunk(0x1000, i, kImageBase + 0x2F90);
+    }
+  }
+
+  DWORD GetRva(DWORD offset) const
+  {
+    return builder_.GetRva() + offset;
+  }
+
+  std::vector<std::uint8_t> Build() const
+  {
+    return builder_.Build();
+  }
+
+  // File offset of the section in the output of Build.
+  DWORD GetOffset() const
+  {
+    return builder_.RvaToOffset(GetRva(0));
+  }
+
+  void RemoveDataDir()
+  {
+    builder_.SetDataDir(hadesmem::PeDataDir::DelayImport, 0, 0);
+  }
+
+  ULONGLONG GetOrdinalFlag() const
+  {
+    return is64_ ? IMAGE_ORDINAL_FLAG64 : IMAGE_ORDINAL_FLAG32;
+  }
+
+  DWORD GetThunkSize() const
+  {
+    return is64_ ? 8 : 4;
+  }
+
+  static std::string GetLongName()
+  {
+    return std::string(300, 'x');
+  }
+
+private:
+  static hadesmem::pelib::SyntheticPeOptions MakeOptions(bool is64)
+  {
+    hadesmem::pelib::SyntheticPeOptions options;
+    options.is_64 = is64;
+    return options;
+  }
+
+  DWORD Address(DWORD rva) const
+  {
+    return rva_based_ ? rva : kImageBase + rva;
+  }
+
+  void WriteDescriptor(std::size_t index,
+                       DWORD name_offset,
+                       DWORD int_offset,
+                       DWORD iat_offset)
+  {
+    hadesmem::pelib::ImageDelayLoadDescriptor desc{};
+    desc.Attributes = rva_based_ ? hadesmem::pelib::kDelayLoadRvaBased : 0;
+    desc.DllNameRVA = Address(GetRva(name_offset));
+    desc.ModuleHandleRVA =
+      Address(GetRva(0x400 + static_cast<DWORD>(index) * 8));
+    desc.ImportAddressTableRVA = Address(GetRva(iat_offset));
+    desc.ImportNameTableRVA = Address(GetRva(int_offset));
+    desc.TimeDateStamp = 0x12345678;
+    builder_.Write(GetRva(static_cast<DWORD>(index * sizeof(desc))), desc);
+  }
+
+  void WriteThunk(DWORD offset, std::size_t index, ULONGLONG value)
+  {
+    auto const rva =
+      GetRva(offset + static_cast<DWORD>(index * GetThunkSize()));
+    if (is64_)
+    {
+      builder_.Write(rva, value);
+    }
+    else
+    {
+      builder_.Write(rva, static_cast<DWORD>(value));
+    }
+  }
+
+  void WriteWord(DWORD offset, WORD value)
+  {
+    builder_.Write(GetRva(offset), value);
+  }
+
+  void WriteString(DWORD offset, std::string const& s)
+  {
+    builder_.WriteString(GetRva(offset), s);
+  }
+
+  hadesmem::pelib::SyntheticPeBuilder builder_;
+  bool is64_;
+  bool rva_based_;
+};
+}
+
+void TestDelayImportDirList()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  for (bool const is64 : {false, true})
+  {
+    for (bool const rva_based : {false, true})
+    {
+      DelayImportTestFile const test_file(is64, rva_based);
+      std::vector<std::uint8_t> buf = test_file.Build();
+      hadesmem::PeFile const pe_file(process,
+                                     buf.data(),
+                                     hadesmem::PeFileType::kData,
+                                     static_cast<DWORD>(buf.size()));
+
+      hadesmem::DelayImportDirList const dirs(process, pe_file);
+      BOOST_TEST_EQ(dirs.size(), 3U);
+      std::vector<hadesmem::DelayImportDir> const dirs_vec(std::begin(dirs),
+                                                           std::end(dirs));
+
+      hadesmem::DelayImportDir const& kernel32 = dirs_vec[0];
+      BOOST_TEST_EQ(kernel32.IsRvaBased(), rva_based);
+      BOOST_TEST_EQ(kernel32.GetName(), "kernel32.dll");
+      BOOST_TEST_EQ(kernel32.GetDllNameRva(), test_file.GetRva(0x100));
+      BOOST_TEST_EQ(kernel32.GetModuleHandleRva(), test_file.GetRva(0x400));
+      BOOST_TEST_EQ(kernel32.GetImportNameTableRva(),
+                    test_file.GetRva(0x200));
+      BOOST_TEST_EQ(kernel32.GetImportAddressTableRva(),
+                    test_file.GetRva(0x300));
+      BOOST_TEST_EQ(kernel32.GetBoundImportAddressTableRva(), 0U);
+      BOOST_TEST_EQ(kernel32.GetTimeDateStamp(), 0x12345678U);
+      BOOST_TEST(kernel32 == hadesmem::DelayImportDir(
+                               process, pe_file, kernel32.GetBase()));
+      BOOST_TEST(kernel32 != dirs_vec[1]);
+      BOOST_TEST_EQ(dirs_vec[1].GetName(), "user32.dll");
+      BOOST_TEST_EQ(dirs_vec[2].GetName(), "ws2_32.dll");
+
+      hadesmem::DelayImportThunkList const kernel32_thunks(
+        process, pe_file, kernel32);
+      BOOST_TEST_EQ(kernel32_thunks.size(), 3U);
+      std::vector<hadesmem::DelayImportThunk> const thunks(
+        std::begin(kernel32_thunks), std::end(kernel32_thunks));
+      BOOST_TEST(!thunks[0].ByOrdinal());
+      BOOST_TEST(thunks[0].IsNameValid());
+      BOOST_TEST_EQ(thunks[0].GetHint(), 1);
+      BOOST_TEST_EQ(thunks[0].GetName(), "Sleep");
+      BOOST_TEST_EQ(thunks[0].GetIatRva(), test_file.GetRva(0x300));
+      BOOST_TEST_EQ(thunks[0].GetFunction(), kImageBase + 0x2F00U);
+      BOOST_TEST(thunks[1].ByOrdinal());
+      BOOST_TEST_EQ(thunks[1].GetOrdinal(), 42);
+      BOOST_TEST_EQ(thunks[1].GetIatRva(),
+                    test_file.GetRva(0x300) + test_file.GetThunkSize());
+      BOOST_TEST_EQ(thunks[1].GetFunction(), kImageBase + 0x2F10U);
+      BOOST_TEST(thunks[2].IsNameValid());
+      BOOST_TEST_EQ(thunks[2].GetHint(), 7);
+      BOOST_TEST_EQ(thunks[2].GetName(), DelayImportTestFile::GetLongName());
+
+      hadesmem::DelayImportThunkList const user32_thunks(
+        process, pe_file, dirs_vec[1]);
+      BOOST_TEST_EQ(user32_thunks.size(), 1U);
+      BOOST_TEST(!user32_thunks.begin()->ByOrdinal());
+      BOOST_TEST(!user32_thunks.begin()->IsNameValid());
+
+      hadesmem::DelayImportThunkList const ws2_32_thunks(
+        process, pe_file, dirs_vec[2]);
+      BOOST_TEST_EQ(ws2_32_thunks.size(), kNumOrdinalImports);
+      WORD ordinal = 1;
+      for (auto const& thunk : ws2_32_thunks)
+      {
+        BOOST_TEST(thunk.ByOrdinal());
+        BOOST_TEST_EQ(thunk.GetOrdinal(), ordinal++);
+        BOOST_TEST_EQ(thunk.GetFunction(), kImageBase + 0x2F90U);
+      }
+    }
+  }
+}
+
+void TestDelayImportDirListMalformed()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  DelayImportTestFile test_file(false, true);
+  std::vector<std::uint8_t> buf = test_file.Build();
+  auto const desc =
+    reinterpret_cast<hadesmem::pelib::ImageDelayLoadDescriptor*>(
+      buf.data() + test_file.GetOffset());
+
+  // A name table outside the file gives an empty thunk list, as does a
+  // missing one.
+  desc[0].ImportNameTableRVA = 0x90000;
+  desc[1].ImportNameTableRVA = 0;
+  {
+    hadesmem::PeFile const pe_file(process,
+                                   buf.data(),
+                                   hadesmem::PeFileType::kData,
+                                   static_cast<DWORD>(buf.size()));
+    hadesmem::DelayImportDirList const dirs(process, pe_file);
+    BOOST_TEST_EQ(dirs.size(), 3U);
+    BOOST_TEST(
+      hadesmem::DelayImportThunkList(process, pe_file, *dirs.begin()).empty());
+    BOOST_TEST(hadesmem::DelayImportThunkList(
+                 process, pe_file, *std::next(dirs.begin()))
+                 .empty());
+  }
+
+  // A descriptor array with no terminator stops at the end of the file.
+  BOOST_TEST_EQ(buf.size(), test_file.GetOffset() + kDelayImportSize);
+  std::memset(buf.data() + test_file.GetOffset(), 0xFF, kDelayImportSize);
+  {
+    hadesmem::PeFile const pe_file(process,
+                                   buf.data(),
+                                   hadesmem::PeFileType::kData,
+                                   static_cast<DWORD>(buf.size()));
+    hadesmem::DelayImportDirList const dirs(process, pe_file);
+    BOOST_TEST_EQ(dirs.size(),
+                  kDelayImportSize /
+                    sizeof(hadesmem::pelib::ImageDelayLoadDescriptor));
+    BOOST_TEST_THROWS(dirs.begin()->GetName(), hadesmem::Error);
+  }
+
+  test_file.RemoveDataDir();
+  buf = test_file.Build();
+  {
+    hadesmem::PeFile const pe_file(process,
+                                   buf.data(),
+                                   hadesmem::PeFileType::kData,
+                                   static_cast<DWORD>(buf.size()));
+    BOOST_TEST(hadesmem::DelayImportDirList(process, pe_file).empty());
+  }
+}
+
+int main()
+{
+  TestDelayImportDirList();
+  TestDelayImportDirListMalformed();
+  return boost::report_errors();
+}
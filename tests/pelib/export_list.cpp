@@ -4,20 +4,30 @@
 #include <hadesmem/pelib/export_list.hpp>
 #include <hadesmem/pelib/export_list.hpp>
 
+#include <cstdint>
+#include <cstring>
 #include <sstream>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include <hadesmem/detail/warning_disable_prefix.hpp>
 #include <boost/detail/lightweight_test.hpp>
 #include <hadesmem/detail/warning_disable_suffix.hpp>
 
 #include <hadesmem/config.hpp>
+#include <hadesmem/detail/alias_cast.hpp>
+#include <hadesmem/detail/find_procedure.hpp>
 #include <hadesmem/error.hpp>
 #include <hadesmem/module.hpp>
 #include <hadesmem/module_list.hpp>
 #include <hadesmem/pelib/export.hpp>
 #include <hadesmem/pelib/export_dir.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/image_mapper.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
 #include <hadesmem/process.hpp>
 #include <hadesmem/read.hpp>
 
@@ -27,6 +37,58 @@ extern "C" __declspec(dllexport) void Dummy()
 {
 }
 
+namespace
+{
+DWORD const kExportSectionSize = 0x200;
+
+// Ordinal base 5, with an unused slot (procedure number 6), an export by
+// ordinal only (7), a forwarder (8) and an export with two names (9). The
+// export directory is at the start of the section, and the other tables and
+// the exports themselves are at fixed offsets from it.
+struct ExportTestFile
+{
+  std::vector<std::uint8_t> buf;
+  DWORD rva;
+  DWORD offset;
+};
+
+ExportTestFile BuildExportTestFile()
+{
+  hadesmem::pelib::SyntheticPeOptions options;
+  options.is_64 = true;
+  hadesmem::pelib::SyntheticPeBuilder builder{options, kExportSectionSize};
+  DWORD const rva = builder.GetRva();
+
+  IMAGE_EXPORT_DIRECTORY export_dir{};
+  export_dir.Base = 5;
+  export_dir.NumberOfFunctions = 5;
+  export_dir.NumberOfNames = 4;
+  export_dir.AddressOfFunctions = rva + 0x40;
+  export_dir.AddressOfNames = rva + 0x60;
+  export_dir.AddressOfNameOrdinals = rva + 0x70;
+  builder.Write(rva, export_dir);
+
+  DWORD const functions[] = {
+    rva + 0x100, 0, rva + 0x104, rva + 0x90, rva + 0x108};
+  builder.Write(rva + 0x40, functions);
+
+  char const* const names[] = {"a", "b", "c", "d"};
+  WORD const name_ordinals[] = {3, 0, 4, 4};
+  for (DWORD i = 0; i < 4; ++i)
+  {
+    builder.Write(rva + 0x60 + i * 4, rva + 0x80 + i * 2);
+    builder.Write(rva + 0x70 + i * 2, name_ordinals[i]);
+    builder.WriteString(rva + 0x80 + i * 2, names[i]);
+  }
+
+  builder.WriteString(rva + 0x90, "kernel32.Sleep");
+
+  builder.SetDataDir(hadesmem::PeDataDir::Export, rva, 0x100);
+
+  return ExportTestFile{builder.Build(), rva, builder.RvaToOffset(rva)};
+}
+}
+
 void TestExportList()
 {
   hadesmem::Process const process(::GetCurrentProcessId());
@@ -93,8 +155,190 @@ void TestExportList()
   BOOST_TEST(processed_one_export_list);
 }
 
+void TestExportListData()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  ExportTestFile file = BuildExportTestFile();
+  std::vector<std::uint8_t>& buf = file.buf;
+  hadesmem::PeFile const pe_file(process,
+                                 buf.data(),
+                                 hadesmem::PeFileType::kData,
+                                 static_cast<DWORD>(buf.size()));
+
+  std::vector<hadesmem::Export> exports;
+  hadesmem::ExportList const export_list(process, pe_file);
+  for (auto const& e : export_list)
+  {
+    exports.push_back(e);
+  }
+  BOOST_TEST_EQ(exports.size(), 4UL);
+  if (exports.size() != 4UL)
+  {
+    return;
+  }
+
+  BOOST_TEST_EQ(exports[0].GetProcedureNumber(), 5);
+  BOOST_TEST(exports[0].ByName());
+  BOOST_TEST_EQ(exports[0].GetName(), "b");
+  BOOST_TEST_EQ(exports[0].GetRva(), file.rva + 0x100);
+  BOOST_TEST_EQ(exports[0].GetVa(),
+                static_cast<void*>(&buf[file.offset + 0x100]));
+  BOOST_TEST_EQ(exports[0].GetRvaPtr(),
+                reinterpret_cast<DWORD*>(&buf[file.offset + 0x40]));
+
+  BOOST_TEST_EQ(exports[1].GetProcedureNumber(), 7);
+  BOOST_TEST_EQ(exports[1].GetOrdinalNumber(), 2);
+  BOOST_TEST(exports[1].ByOrdinal());
+  BOOST_TEST_EQ(exports[1].GetRva(), file.rva + 0x104);
+
+  BOOST_TEST_EQ(exports[2].GetProcedureNumber(), 8);
+  BOOST_TEST_EQ(exports[2].GetName(), "a");
+  BOOST_TEST(exports[2].IsForwarded());
+  BOOST_TEST_EQ(exports[2].GetForwarderModule(), "kernel32");
+  BOOST_TEST_EQ(exports[2].GetForwarderFunction(), "Sleep");
+
+  // The first name wins when an ordinal has more than one.
+  BOOST_TEST_EQ(exports[3].GetProcedureNumber(), 9);
+  BOOST_TEST_EQ(exports[3].GetName(), "c");
+
+  hadesmem::Export const standalone(process, pe_file, 9);
+  BOOST_TEST_EQ(standalone.GetName(), exports[3].GetName());
+  BOOST_TEST_EQ(standalone.GetRva(), exports[3].GetRva());
+  BOOST_TEST_THROWS(hadesmem::Export(process, pe_file, 10), hadesmem::Error);
+}
+
+void TestExportListTruncated()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  // Move the name table to the very end of the file, so only the first two of
+  // its four entries ("a" and "b") are present.
+  // The section is the last thing in the file.
+  ExportTestFile file = BuildExportTestFile();
+  std::vector<std::uint8_t>& buf = file.buf;
+  BOOST_TEST_EQ(buf.size(), file.offset + kExportSectionSize);
+  DWORD const end_rva = file.rva + kExportSectionSize;
+  DWORD const names_rva = end_rva - 2 * sizeof(DWORD);
+  std::memcpy(&buf[buf.size() - 2 * sizeof(DWORD)],
+              &buf[file.offset + 0x60],
+              2 * sizeof(DWORD));
+  auto const export_dir =
+    reinterpret_cast<IMAGE_EXPORT_DIRECTORY*>(&buf[file.offset]);
+  export_dir->AddressOfNames = names_rva;
+
+  hadesmem::PeFile const pe_file(process,
+                                 buf.data(),
+                                 hadesmem::PeFileType::kData,
+                                 static_cast<DWORD>(buf.size()));
+
+  // The exports themselves are all still there, but the ones whose names were
+  // lost are now exported by ordinal only.
+  std::vector<hadesmem::Export> exports;
+  hadesmem::ExportList const export_list(process, pe_file);
+  for (auto const& e : export_list)
+  {
+    exports.push_back(e);
+  }
+  BOOST_TEST_EQ(exports.size(), 4UL);
+  if (exports.size() != 4UL)
+  {
+    return;
+  }
+
+  BOOST_TEST_EQ(exports[0].GetProcedureNumber(), 5);
+  BOOST_TEST_EQ(exports[0].GetName(), "b");
+  BOOST_TEST(exports[1].ByOrdinal());
+  BOOST_TEST_EQ(exports[2].GetProcedureNumber(), 8);
+  BOOST_TEST_EQ(exports[2].GetName(), "a");
+  BOOST_TEST_EQ(exports[3].GetProcedureNumber(), 9);
+  BOOST_TEST(exports[3].ByOrdinal());
+  BOOST_TEST_EQ(exports[3].GetRva(), file.rva + 0x108);
+
+  // Likewise for a function table which runs off the end of the file. It
+  // overlaps the name table, so drop that.
+  DWORD const functions[] = {
+    file.rva + 0x100, 0, file.rva + 0x104, file.rva + 0x108};
+  std::memcpy(&buf[buf.size() - 0x10], functions, sizeof(functions));
+  export_dir->AddressOfFunctions = end_rva - 0x10;
+  export_dir->NumberOfFunctions = 0x100;
+  export_dir->NumberOfNames = 0;
+
+  exports.clear();
+  hadesmem::ExportList const truncated_funcs(process, pe_file);
+  for (auto const& e : truncated_funcs)
+  {
+    exports.push_back(e);
+  }
+  BOOST_TEST_EQ(exports.size(), 3UL);
+  if (exports.size() == 3UL)
+  {
+    BOOST_TEST_EQ(exports[2].GetProcedureNumber(), 8);
+    BOOST_TEST_EQ(exports[2].GetRva(), file.rva + 0x108);
+  }
+  BOOST_TEST_THROWS(hadesmem::Export(process, pe_file, 9), hadesmem::Error);
+}
+
+void TestExportCache()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  ExportTestFile const file = BuildExportTestFile();
+  std::vector<std::uint8_t> image =
+    hadesmem::pelib::MapImage(hadesmem::pelib::PeView{
+      hadesmem::pelib::BufferSource{file.buf.data(), file.buf.size()},
+      hadesmem::PeFileType::kData});
+  auto const module = reinterpret_cast<HMODULE>(image.data());
+  auto const find = [&](hadesmem::detail::ExportCache& cache,
+                        std::string const& name)
+  {
+    return hadesmem::detail::AliasCast<void*>(
+      cache.FindProcedure(module, name));
+  };
+  auto const find_ordinal = [&](hadesmem::detail::ExportCache& cache,
+                                WORD ordinal)
+  {
+    return hadesmem::detail::AliasCast<void*>(
+      cache.FindProcedure(module, ordinal));
+  };
+  auto const va = [&](DWORD offset)
+  {
+    return static_cast<void*>(&image[file.rva + offset]);
+  };
+
+  hadesmem::detail::ExportCache cache{process};
+  BOOST_TEST_EQ(find(cache, "b"), va(0x100));
+  BOOST_TEST_EQ(find(cache, "c"), va(0x108));
+  // Names other than the first for an export are also found.
+  BOOST_TEST_EQ(find(cache, "d"), va(0x108));
+  BOOST_TEST_EQ(find(cache, "e"), static_cast<void*>(nullptr));
+  BOOST_TEST_EQ(find(cache, ""), static_cast<void*>(nullptr));
+
+  // Only unnamed exports are found by ordinal.
+  BOOST_TEST_EQ(find_ordinal(cache, 7), va(0x104));
+  BOOST_TEST_EQ(find_ordinal(cache, 5), static_cast<void*>(nullptr));
+  BOOST_TEST_EQ(find_ordinal(cache, 6), static_cast<void*>(nullptr));
+  BOOST_TEST_EQ(find_ordinal(cache, 10), static_cast<void*>(nullptr));
+
+  // Swap the second and last entries of the name tables so the binary search
+  // misses "b", which must then be found via the hashed fallback.
+  DWORD* const names = reinterpret_cast<DWORD*>(va(0x60));
+  WORD* const name_ordinals = reinterpret_cast<WORD*>(va(0x70));
+  std::swap(names[1], names[3]);
+  std::swap(name_ordinals[1], name_ordinals[3]);
+
+  hadesmem::detail::ExportCache unsorted_cache{process};
+  BOOST_TEST_EQ(find(unsorted_cache, "b"), va(0x100));
+  BOOST_TEST_EQ(find(unsorted_cache, "d"), va(0x108));
+  BOOST_TEST_EQ(find(unsorted_cache, "c"), va(0x108));
+  BOOST_TEST_EQ(find(unsorted_cache, "e"), static_cast<void*>(nullptr));
+}
+
 int main()
 {
   TestExportList();
+  TestExportListData();
+  TestExportListTruncated();
+  TestExportCache();
   return boost::report_errors();
 }
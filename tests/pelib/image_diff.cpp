@@ -0,0 +1,123 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/view/image_diff.hpp>
+#include <hadesmem/pelib/view/image_diff.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/pelib/view/base_relocation_table.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+
+namespace
+{
+std::size_t const kImageSize = 0x400;
+
+// HIGHLOW relocations at 0x10, 0x3E (straddling a word of the mask) and every
+// fourth byte from 0x100 to 0x180.
+hadesmem::pelib::RelocationMask GetTestMask()
+{
+  std::vector<std::uint16_t> entries;
+  entries.push_back(static_cast<std::uint16_t>(
+    (hadesmem::pelib::kImageRelBasedHighLow << 12) | 0x10));
+  entries.push_back(static_cast<std::uint16_t>(
+    (hadesmem::pelib::kImageRelBasedHighLow << 12) | 0x3E));
+  for (std::uint16_t offset = 0x100; offset < 0x180; offset += 4)
+  {
+    entries.push_back(static_cast<std::uint16_t>(
+      (hadesmem::pelib::kImageRelBasedHighLow << 12) | offset));
+  }
+
+  hadesmem::pelib::ImageBaseRelocation block{};
+  block.SizeOfBlock = static_cast<std::uint32_t>(
+    sizeof(block) + entries.size() * sizeof(std::uint16_t));
+  std::vector<std::uint8_t> dir(block.SizeOfBlock);
+  std::memcpy(dir.data(), &block, sizeof(block));
+  std::memcpy(&dir[sizeof(block)],
+              entries.data(),
+              entries.size() * sizeof(std::uint16_t));
+
+  hadesmem::pelib::BaseRelocationTable const relocs{dir.data(), dir.size()};
+  return hadesmem::pelib::RelocationMask{relocs, kImageSize};
+}
+}
+
+void TestRelocationMaskBits()
+{
+  hadesmem::pelib::RelocationMask const mask = GetTestMask();
+  BOOST_TEST_EQ(mask.GetBits(0), 0xFULL << 0x10 | 0x3ULL << 0x3E);
+  BOOST_TEST_EQ(mask.GetBits(0x10), 0xFULL | 0xFULL << 0x2E);
+  BOOST_TEST_EQ(mask.GetBits(0x3F), 0x7ULL);
+  BOOST_TEST_EQ(mask.GetBits(0x100), ~0ULL);
+  BOOST_TEST_EQ(mask.GetBits(0x150), 0xFFFFFFFFFFFFULL);
+  BOOST_TEST_EQ(mask.GetBits(0x3FF), 0ULL);
+  BOOST_TEST_EQ(mask.GetBits(kImageSize), 0ULL);
+  BOOST_TEST_EQ(hadesmem::pelib::RelocationMask{}.GetBits(0), 0ULL);
+}
+
+void TestImageDiff()
+{
+  hadesmem::pelib::RelocationMask const mask = GetTestMask();
+  std::vector<std::uint8_t> lhs(kImageSize);
+  for (std::size_t i = 0; i < lhs.size(); ++i)
+  {
+    lhs[i] = static_cast<std::uint8_t>(i);
+  }
+
+  // Relocated bytes only (as if loaded at a different base).
+  std::vector<std::uint8_t> rhs = lhs;
+  rhs[0x10] ^= 0xFF;
+  rhs[0x13] ^= 0xFF;
+  rhs[0x40] ^= 0xFF;
+  for (std::size_t i = 0x100; i < 0x180; ++i)
+  {
+    rhs[i] ^= 0xFF;
+  }
+  BOOST_TEST(hadesmem::pelib::DiffImages(
+               lhs.data(), rhs.data(), lhs.size(), mask).empty());
+
+  // Plus some real changes, one next to a relocation and one in the tail
+  // which isn't a multiple of the vector size.
+  rhs[0x14] ^= 0xFF;
+  rhs[0x200] ^= 0xFF;
+  rhs[0x203] ^= 0xFF;
+  rhs[0x3FF] ^= 0xFF;
+  std::vector<hadesmem::pelib::ImageDiffRun> const runs =
+    hadesmem::pelib::DiffImages(lhs.data(), rhs.data(), lhs.size(), mask);
+  BOOST_TEST_EQ(runs.size(), 4UL);
+  BOOST_TEST_EQ(runs[0].rva, 0x14UL);
+  BOOST_TEST_EQ(runs[0].len, 1UL);
+  BOOST_TEST_EQ(runs[1].rva, 0x200UL);
+  BOOST_TEST_EQ(runs[2].rva, 0x203UL);
+  BOOST_TEST_EQ(runs[3].rva, 0x3FFUL);
+  BOOST_TEST_EQ(runs[3].len, 1UL);
+
+  std::vector<hadesmem::pelib::ImageDiffRun> const merged_runs =
+    hadesmem::pelib::DiffImages(lhs.data(), rhs.data(), lhs.size(), mask, 2);
+  BOOST_TEST_EQ(merged_runs.size(), 3UL);
+  BOOST_TEST_EQ(merged_runs[1].rva, 0x200UL);
+  BOOST_TEST_EQ(merged_runs[1].len, 4UL);
+
+  // Without a mask every difference is reported.
+  BOOST_TEST_EQ(hadesmem::pelib::DiffImages(lhs.data(),
+                                            rhs.data(),
+                                            lhs.size(),
+                                            hadesmem::pelib::RelocationMask{})
+                  .size(),
+                7UL);
+}
+
+int main()
+{
+  TestRelocationMaskBits();
+  TestImageDiff();
+  return boost::report_errors();
+}
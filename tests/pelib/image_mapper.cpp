@@ -0,0 +1,281 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/view/image_mapper.hpp>
+#include <hadesmem/pelib/view/image_mapper.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+
+namespace
+{
+std::uint32_t const kImageBase32 = 0x400000;
+std::uint64_t const kImageBase64 = 0x140000000ULL;
+
+template <typename T>
+T Get(std::vector<std::uint8_t> const& buf, std::size_t offset)
+{
+  T data;
+  std::memcpy(&data, &buf[offset], sizeof(data));
+  return data;
+}
+
+std::uint16_t RelocEntry(std::uint16_t type, std::uint16_t offset)
+{
+  return static_cast<std::uint16_t>((type << 12) | offset);
+}
+
+// Offsets into the extra section.
+std::uint32_t const kPtrOffset = 0x10;
+std::uint32_t const kSplitOffset = 0x20;
+std::uint32_t const kRelocOffset = 0x40;
+std::uint32_t const kRelocSize = 0x14;
+
+struct TestFile
+{
+  std::vector<std::uint8_t> buf;
+  std::uint32_t rva;
+  std::uint32_t offset;
+};
+
+// A synthetic file with relocations, plus an extra section with a virtual
+// size of half its raw size. Section data past VirtualSize (rounded up to the
+// section alignment) is still mapped, the same as the loader. The file
+// alignment is smaller than the section alignment, so the two layouts differ.
+//
+// The extra section contains a pointer-sized absolute address (HIGHLOW or
+// DIR64), for PE32 a split address (HIGH, LOW and HIGHADJ), and the block
+// relocating them. The relocation directory is pointed at that block rather
+// than at .reloc.
+TestFile BuildTestFile(bool is64)
+{
+  hadesmem::pelib::SyntheticPeOptions options;
+  options.is_64 = is64;
+  options.num_relocations = 1;
+  hadesmem::pelib::SyntheticPeBuilder builder{options, 0x200, 0x100};
+  builder.GetBuilder().SetImageBase(is64 ? kImageBase64 : kImageBase32);
+  std::uint32_t const rva = builder.GetRva();
+
+  builder.WriteString(rva, "text");
+  builder.WriteString(rva + 0x1F0, "tail");
+
+  hadesmem::pelib::ImageBaseRelocation block{};
+  block.VirtualAddress = rva;
+  block.SizeOfBlock = kRelocSize;
+  builder.Write(rva + kRelocOffset, block);
+  std::uint32_t const entries = rva + kRelocOffset + sizeof(block);
+  if (is64)
+  {
+    builder.Write(rva + kPtrOffset, kImageBase64 + rva);
+    builder.Write(
+      entries,
+      RelocEntry(hadesmem::pelib::kImageRelBasedDir64, kPtrOffset));
+  }
+  else
+  {
+    builder.Write(rva + kPtrOffset, kImageBase32 + rva);
+    // 0x0040F000 split into halves for HIGH/LOW, and again for HIGHADJ
+    // where the low half needs rounding.
+    std::uint16_t const split[] = {0x0040, 0xF000, 0x0041};
+    builder.Write(rva + kSplitOffset, split);
+    std::uint16_t const split_entries[] = {
+      RelocEntry(hadesmem::pelib::kImageRelBasedHighLow, kPtrOffset),
+      RelocEntry(hadesmem::pelib::kImageRelBasedHigh, kSplitOffset),
+      RelocEntry(hadesmem::pelib::kImageRelBasedLow, kSplitOffset + 2),
+      RelocEntry(hadesmem::pelib::kImageRelBasedHighAdj, kSplitOffset + 4),
+      0xF000};
+    builder.Write(entries, split_entries);
+  }
+  // Padding entries.
+  builder.Write(entries + 0xA,
+                RelocEntry(hadesmem::pelib::kImageRelBasedAbsolute, 0));
+  builder.SetDataDir(
+    hadesmem::PeDataDir::BaseReloc, rva + kRelocOffset, kRelocSize);
+
+  return TestFile{builder.Build(), rva, builder.RvaToOffset(rva)};
+}
+
+template <typename T>
+void Put(TestFile& file, std::size_t offset, T const& data)
+{
+  std::memcpy(&file.buf[offset], &data, sizeof(data));
+}
+}
+
+void TestMapImage()
+{
+  for (bool const is64 : {false, true})
+  {
+    TestFile const test_file = BuildTestFile(is64);
+    std::uint32_t const rva = test_file.rva;
+    hadesmem::pelib::BufferSource const source{test_file.buf.data(),
+                                               test_file.buf.size()};
+    hadesmem::pelib::PeView const file{source, hadesmem::PeFileType::kData};
+    std::uint64_t const image_base = is64 ? kImageBase64 : kImageBase32;
+
+    // At the preferred base nothing is relocated.
+    std::vector<std::uint8_t> const image = hadesmem::pelib::MapImage(file);
+    BOOST_TEST_EQ(image.size(), rva + 0x1000UL);
+    BOOST_TEST_EQ(std::memcmp(&image[0], source.GetData(), 0x200), 0);
+    BOOST_TEST_EQ(std::memcmp(&image[rva], "text", 5), 0);
+    BOOST_TEST_EQ(std::memcmp(&image[rva + 0x1F0], "tail", 5), 0);
+    BOOST_TEST_EQ(image[rva + 0x200], 0);
+    BOOST_TEST_EQ(image[rva + 0xFFF], 0);
+
+    // Both layouts give the same result for an RVA.
+    hadesmem::pelib::PeView const image_view{
+      hadesmem::pelib::BufferSource{image.data(), image.size()},
+      hadesmem::PeFileType::kImage};
+    BOOST_TEST_EQ(image_view.GetImageBase(), image_base);
+    BOOST_TEST_EQ(image_view.GetSections().size(),
+                  file.GetSections().size());
+    BOOST_TEST_EQ(image_view.ReadRva<std::uint32_t>(rva + kPtrOffset),
+                  file.ReadRva<std::uint32_t>(rva + kPtrOffset));
+    BOOST_TEST_EQ(image_view.ReadStringRva<char>(rva),
+                  file.ReadStringRva<char>(rva));
+
+    // Relocated.
+    std::uint64_t const new_base = is64 ? 0x7FF600000000ULL : 0x10000000;
+    std::vector<std::uint8_t> const rebased =
+      hadesmem::pelib::MapImage(file, new_base);
+    hadesmem::pelib::PeView const rebased_view{
+      hadesmem::pelib::BufferSource{rebased.data(), rebased.size()},
+      hadesmem::PeFileType::kImage};
+    BOOST_TEST_EQ(rebased_view.GetImageBase(), new_base);
+    if (is64)
+    {
+      BOOST_TEST_EQ(Get<std::uint64_t>(rebased, rva + kPtrOffset),
+                    new_base + rva);
+    }
+    else
+    {
+      BOOST_TEST_EQ(Get<std::uint32_t>(rebased, rva + kPtrOffset),
+                    new_base + rva);
+      BOOST_TEST_EQ(Get<std::uint16_t>(rebased, rva + kSplitOffset), 0x1000);
+      BOOST_TEST_EQ(Get<std::uint16_t>(rebased, rva + kSplitOffset + 2),
+                    0xF000);
+      // 0x0040F000 - 0x400000 + 0x10000000 = 0x1000F000, rounded.
+      BOOST_TEST_EQ(Get<std::uint16_t>(rebased, rva + kSplitOffset + 4),
+                    0x1001);
+    }
+
+    // Rebasing an image back to where it started gives the original.
+    std::vector<std::uint8_t> const restored =
+      hadesmem::pelib::MapImage(rebased_view, image_base);
+    BOOST_TEST(restored == image);
+  }
+}
+
+void TestMapImageMalformed()
+{
+  TestFile test_file = BuildTestFile(false);
+  std::size_t const reloc_offset = test_file.offset + kRelocOffset;
+  std::size_t nt_headers_offset = 0;
+  {
+    hadesmem::pelib::PeView const file{
+      hadesmem::pelib::BufferSource{test_file.buf.data(),
+                                    test_file.buf.size()},
+      hadesmem::PeFileType::kData};
+    nt_headers_offset = file.GetNtHeadersOffset();
+    BOOST_TEST_THROWS(hadesmem::pelib::MapImage(file, 0x100000000ULL),
+                      hadesmem::Error);
+  }
+  std::size_t const file_header_offset =
+    nt_headers_offset + sizeof(std::uint32_t);
+  std::size_t const optional_header_offset =
+    file_header_offset + sizeof(hadesmem::pelib::ImageFileHeader);
+  std::size_t const reloc_dir_offset =
+    optional_header_offset +
+    offsetof(hadesmem::pelib::ImageOptionalHeader32, DataDirectory) +
+    sizeof(hadesmem::pelib::ImageDataDirectory) *
+      static_cast<std::size_t>(hadesmem::PeDataDir::BaseReloc);
+
+  // A block size larger than the directory.
+  Put(test_file, reloc_offset + 4, static_cast<std::uint32_t>(0x100));
+  {
+    hadesmem::pelib::PeView const file{
+      hadesmem::pelib::BufferSource{test_file.buf.data(),
+                                    test_file.buf.size()},
+      hadesmem::PeFileType::kData};
+    BOOST_TEST_THROWS(hadesmem::pelib::MapImage(file, 0x10000000),
+                      hadesmem::Error);
+    // Relocations aren't touched if the image isn't moved.
+    BOOST_TEST_EQ(hadesmem::pelib::MapImage(file).size(),
+                  test_file.rva + 0x1000UL);
+  }
+  Put(test_file, reloc_offset + 4, kRelocSize);
+
+  // A relocation type which isn't valid for x86 or x64.
+  Put(test_file, reloc_offset + 0x12, RelocEntry(7, 0));
+  {
+    hadesmem::pelib::PeView const file{
+      hadesmem::pelib::BufferSource{test_file.buf.data(),
+                                    test_file.buf.size()},
+      hadesmem::PeFileType::kData};
+    BOOST_TEST_THROWS(hadesmem::pelib::MapImage(file, 0x10000000),
+                      hadesmem::Error);
+  }
+
+  // No relocations is only an error if they were stripped.
+  Put(test_file, reloc_dir_offset, hadesmem::pelib::ImageDataDirectory{});
+  {
+    hadesmem::pelib::PeView const file{
+      hadesmem::pelib::BufferSource{test_file.buf.data(),
+                                    test_file.buf.size()},
+      hadesmem::PeFileType::kData};
+    std::vector<std::uint8_t> const image =
+      hadesmem::pelib::MapImage(file, 0x10000000);
+    BOOST_TEST_EQ(Get<std::uint32_t>(image, test_file.rva + kPtrOffset),
+                  kImageBase32 + test_file.rva);
+  }
+  std::size_t const characteristics_offset =
+    file_header_offset +
+    offsetof(hadesmem::pelib::ImageFileHeader, Characteristics);
+  Put(test_file,
+      characteristics_offset,
+      static_cast<std::uint16_t>(
+        Get<std::uint16_t>(test_file.buf, characteristics_offset) |
+        hadesmem::pelib::kImageFileRelocsStripped));
+  {
+    hadesmem::pelib::PeView const file{
+      hadesmem::pelib::BufferSource{test_file.buf.data(),
+                                    test_file.buf.size()},
+      hadesmem::PeFileType::kData};
+    BOOST_TEST_THROWS(hadesmem::pelib::MapImage(file, 0x10000000),
+                      hadesmem::Error);
+  }
+
+  // An absurd SizeOfImage.
+  Put(test_file,
+      optional_header_offset +
+        offsetof(hadesmem::pelib::ImageOptionalHeader32, SizeOfImage),
+      static_cast<std::uint32_t>(0xFFFFF000));
+  {
+    hadesmem::pelib::PeView const file{
+      hadesmem::pelib::BufferSource{test_file.buf.data(),
+                                    test_file.buf.size()},
+      hadesmem::PeFileType::kData};
+    BOOST_TEST_THROWS(hadesmem::pelib::MapImage(file), hadesmem::Error);
+  }
+}
+
+int main()
+{
+  TestMapImage();
+  TestMapImageMalformed();
+  return boost::report_errors();
+}
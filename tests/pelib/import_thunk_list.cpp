@@ -0,0 +1,259 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/import_thunk_list.hpp>
+#include <hadesmem/pelib/import_thunk_list.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/pelib/import_thunk.hpp>
+#include <hadesmem/pelib/import_thunk_pair_list.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+#include <hadesmem/process.hpp>
+
+namespace
+{
+DWORD const kSectionSize = 0x2000;
+DWORD const kIltOffset = 0;
+DWORD const kIatOffset = 0x800;
+std::size_t const kNumOrdinalImports = 100;
+
+// An ILT and IAT in the extra section of a synthetic file. Offsets are from
+// the start of the section.
+//
+// The thunks are a short name, an ordinal, a name too long for the batched
+// read, a name outside the file, then enough ordinals to need more than one
+// read of the thunk arrays. The IAT is a copy of the ILT, as in a file on disk,
+// except for the first entry, which is bound.
+class ImportTestFile
+{
+public:
+  explicit ImportTestFile(bool is64)
+    : builder_{MakeOptions(is64), kSectionSize}, is64_{is64}
+  {
+    buf_ = builder_.Build();
+
+    WriteWord(0x1000, 1);
+    WriteString(0x1002, "Sleep");
+    WriteWord(0x1100, 7);
+    WriteString(0x1102, GetLongName());
+
+    std::vector<ULONGLONG> thunks;
+    thunks.push_back(GetRva(0x1000));
+    thunks.push_back(GetOrdinalFlag() | 42);
+    thunks.push_back(GetRva(0x1100));
+    thunks.push_back(0x90000);
+    for (std::size_t i = 0; i < kNumOrdinalImports; ++i)
+    {
+      thunks.push_back(GetOrdinalFlag() | (i + 1));
+    }
+
+    for (std::size_t i = 0; i < thunks.size(); ++i)
+    {
+      WriteThunk(kIltOffset, i, thunks[i]);
+      WriteThunk(kIatOffset, i, i ? thunks[i] : 0x12345678);
+    }
+  }
+
+  std::vector<std::uint8_t>& GetBuffer()
+  {
+    return buf_;
+  }
+
+  DWORD GetRva(DWORD offset) const
+  {
+    return builder_.GetRva() + offset;
+  }
+
+  std::uint8_t* GetPtr(DWORD offset)
+  {
+    return &buf_[builder_.RvaToOffset(GetRva(offset))];
+  }
+
+  static std::size_t GetNumThunks()
+  {
+    return 4 + kNumOrdinalImports;
+  }
+
+  ULONGLONG GetOrdinalFlag() const
+  {
+    return is64_ ? IMAGE_ORDINAL_FLAG64 : IMAGE_ORDINAL_FLAG32;
+  }
+
+  DWORD GetThunkSize() const
+  {
+    return is64_ ? 8 : 4;
+  }
+
+  static std::string GetLongName()
+  {
+    return std::string(300, 'x');
+  }
+
+  void WriteThunk(DWORD offset, std::size_t index, ULONGLONG value)
+  {
+    offset += static_cast<DWORD>(index * GetThunkSize());
+    if (is64_)
+    {
+      Write(offset, &value, sizeof(value));
+    }
+    else
+    {
+      auto const value_32 = static_cast<DWORD>(value);
+      Write(offset, &value_32, sizeof(value_32));
+    }
+  }
+
+private:
+  static hadesmem::pelib::SyntheticPeOptions MakeOptions(bool is64)
+  {
+    hadesmem::pelib::SyntheticPeOptions options;
+    options.is_64 = is64;
+    return options;
+  }
+
+  void WriteWord(DWORD offset, WORD value)
+  {
+    Write(offset, &value, sizeof(value));
+  }
+
+  void WriteString(DWORD offset, std::string const& s)
+  {
+    Write(offset, s.c_str(), s.size() + 1);
+  }
+
+  void Write(DWORD offset, void const* data, std::size_t len)
+  {
+    std::memcpy(GetPtr(offset), data, len);
+  }
+
+  hadesmem::pelib::SyntheticPeBuilder builder_;
+  std::vector<std::uint8_t> buf_;
+  bool is64_;
+};
+}
+
+void TestImportThunkList()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  for (bool const is64 : {false, true})
+  {
+    ImportTestFile test_file(is64);
+    std::vector<std::uint8_t>& buf = test_file.GetBuffer();
+    DWORD const ilt_rva = test_file.GetRva(kIltOffset);
+    DWORD const iat_rva = test_file.GetRva(kIatOffset);
+    hadesmem::PeFile const pe_file(process,
+                                   buf.data(),
+                                   hadesmem::PeFileType::kData,
+                                   static_cast<DWORD>(buf.size()));
+
+    hadesmem::ImportThunkList const ilt(process, pe_file, ilt_rva);
+    BOOST_TEST_EQ(ilt.size(), ImportTestFile::GetNumThunks());
+    BOOST_TEST_EQ(static_cast<std::size_t>(
+                    std::distance(std::begin(ilt), std::end(ilt))),
+                  ImportTestFile::GetNumThunks());
+    std::vector<hadesmem::ImportThunk> const thunks(std::begin(ilt),
+                                                    std::end(ilt));
+
+    BOOST_TEST(!thunks[0].ByOrdinal());
+    BOOST_TEST_EQ(thunks[0].GetHint(), 1);
+    BOOST_TEST_EQ(thunks[0].GetName(), "Sleep");
+    BOOST_TEST_EQ(thunks[0].GetBase(),
+                  static_cast<void*>(test_file.GetPtr(kIltOffset)));
+    BOOST_TEST(thunks[1].ByOrdinal());
+    BOOST_TEST_EQ(thunks[1].GetOrdinal(), 42);
+    BOOST_TEST_EQ(thunks[1].GetBase(),
+                  static_cast<void*>(test_file.GetPtr(
+                    kIltOffset + test_file.GetThunkSize())));
+    BOOST_TEST_EQ(thunks[2].GetHint(), 7);
+    BOOST_TEST_EQ(thunks[2].GetName(), ImportTestFile::GetLongName());
+    BOOST_TEST_THROWS(thunks[3].GetName(), hadesmem::Error);
+    WORD ordinal = 1;
+    for (std::size_t i = 4; i < thunks.size(); ++i)
+    {
+      BOOST_TEST(thunks[i].ByOrdinal());
+      BOOST_TEST_EQ(thunks[i].GetOrdinal(), ordinal++);
+    }
+
+    // The cached name must not outlive a change to the thunk.
+    hadesmem::ImportThunk thunk = thunks[0];
+    thunk.SetAddressOfData(test_file.GetRva(0x1100));
+    BOOST_TEST_EQ(thunk.GetName(), ImportTestFile::GetLongName());
+
+    hadesmem::ImportThunkPairList pairs(process, pe_file, ilt_rva, iat_rva);
+    BOOST_TEST_EQ(pairs.size(), ImportTestFile::GetNumThunks());
+    BOOST_TEST(pairs.IsIatTerminated());
+    BOOST_TEST(pairs.begin()->IsBound());
+    BOOST_TEST_EQ(pairs.begin()->GetIat().GetFunction(), 0x12345678U);
+    BOOST_TEST_EQ(pairs.begin()->GetIlt().GetName(), "Sleep");
+    BOOST_TEST_EQ(pairs.begin()->GetIat().GetBase(),
+                  static_cast<void*>(test_file.GetPtr(kIatOffset)));
+    std::size_t num_bound = 0;
+    for (auto const& pair : pairs)
+    {
+      num_bound += pair.IsBound() ? 1 : 0;
+    }
+    BOOST_TEST_EQ(num_bound, 1U);
+    BOOST_TEST_EQ(std::next(pairs.begin())->GetIat().GetOrdinal(), 42);
+
+    // An IAT which isn't terminated where the ILT is.
+    test_file.WriteThunk(kIatOffset, ImportTestFile::GetNumThunks(), 1);
+    hadesmem::ImportThunkPairList const long_iat(
+      process, pe_file, ilt_rva, iat_rva);
+    BOOST_TEST_EQ(long_iat.size(), ImportTestFile::GetNumThunks());
+    BOOST_TEST(!long_iat.IsIatTerminated());
+  }
+}
+
+void TestImportThunkListMalformed()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  ImportTestFile test_file(false);
+  std::vector<std::uint8_t>& buf = test_file.GetBuffer();
+  DWORD const ilt_rva = test_file.GetRva(kIltOffset);
+  hadesmem::PeFile const pe_file(process,
+                                 buf.data(),
+                                 hadesmem::PeFileType::kData,
+                                 static_cast<DWORD>(buf.size()));
+
+  // Thunks outside the file give an empty list.
+  BOOST_TEST(hadesmem::ImportThunkList(process, pe_file, 0x90000).empty());
+  BOOST_TEST(hadesmem::ImportThunkPairList(
+               process, pe_file, 0x90000, test_file.GetRva(kIatOffset))
+               .empty());
+
+  // An IAT which runs off the end of the file (which is the end of the
+  // section) cuts the pairs short.
+  std::size_t const iat_thunks = 8;
+  DWORD const iat_rva =
+    test_file.GetRva(kSectionSize - static_cast<DWORD>(iat_thunks * 4));
+  hadesmem::ImportThunkPairList const pairs(
+    process, pe_file, ilt_rva, iat_rva);
+  BOOST_TEST_EQ(pairs.size(), iat_thunks);
+  BOOST_TEST(!pairs.IsIatTerminated());
+
+  // An ILT with no terminator stops at the end of the file.
+  std::memset(test_file.GetPtr(kIltOffset), 0x7F, kSectionSize - kIltOffset);
+  hadesmem::ImportThunkList const ilt(process, pe_file, ilt_rva);
+  BOOST_TEST_EQ(ilt.size(), (kSectionSize - kIltOffset) / 4);
+}
+
+int main()
+{
+  TestImportThunkList();
+  TestImportThunkListMalformed();
+  return boost::report_errors();
+}
@@ -0,0 +1,474 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/view/module_identity.hpp>
+#include <hadesmem/pelib/view/module_identity.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/assert.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/debug_dir.hpp>
+#include <hadesmem/pelib/view/image_mapper.hpp>
+#include <hadesmem/pelib/view/load_config_dir.hpp>
+#include <hadesmem/pelib/view/pe_builder.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+
+namespace
+{
+std::uint8_t const kPdbGuid[16] = {0x78, 0x56, 0x34, 0x12, 0xBC, 0x9A,
+                                   0xF0, 0xDE, 0x01, 0x23, 0x45, 0x67,
+                                   0x89, 0xAB, 0xCD, 0xEF};
+std::uint32_t const kPdbAge = 0x1A;
+char const kPdbPath[] = "C:\\build\\test.pdb";
+
+// Deliberately unsorted, as nothing guarantees the order.
+std::uint32_t const kGuardCfFunctions[] = {0x1010, 0x1000, 0x1030, 0x1020};
+std::uint32_t const kSafeSehHandlers[] = {0x1000, 0x1004};
+
+struct TestPeOptions
+{
+  bool is_64;
+  bool add_code_view;
+  // Leave the debug data out of the image, so it can only be found via
+  // PointerToRawData.
+  bool unmapped_debug_data;
+  // Size field of the load config directory. Zero for no directory.
+  std::uint32_t load_config_size;
+};
+
+TestPeOptions MakeOptions(bool is_64,
+                          bool add_code_view,
+                          bool unmapped_debug_data,
+                          std::uint32_t load_config_size)
+{
+  TestPeOptions options;
+  options.is_64 = is_64;
+  options.add_code_view = add_code_view;
+  options.unmapped_debug_data = unmapped_debug_data;
+  options.load_config_size = load_config_size;
+  return options;
+}
+
+template <typename T>
+void Append(std::vector<std::uint8_t>& buf, T const& t)
+{
+  auto const p = reinterpret_cast<std::uint8_t const*>(&t);
+  buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+void AppendBytes(std::vector<std::uint8_t>& buf,
+                 void const* data,
+                 std::size_t n)
+{
+  auto const p = static_cast<std::uint8_t const*>(data);
+  buf.insert(buf.end(), p, p + n);
+}
+
+void Align(std::vector<std::uint8_t>& buf, std::size_t alignment)
+{
+  buf.resize((buf.size() + alignment - 1) & ~(alignment - 1));
+}
+
+template <typename LoadConfigT>
+LoadConfigT MakeLoadConfig(std::uint32_t size,
+                           std::uint64_t image_base,
+                           std::uint32_t seh_rva,
+                           std::uint32_t cf_rva)
+{
+  LoadConfigT load_config;
+  std::memset(&load_config, 0, sizeof(load_config));
+  load_config.Size = size;
+  load_config.TimeDateStamp = 0x11223344;
+  load_config.SecurityCookie = image_base + 0x2000;
+  if (seh_rva)
+  {
+    load_config.SEHandlerTable = image_base + seh_rva;
+    load_config.SEHandlerCount = 2;
+  }
+  load_config.GuardCFCheckFunctionPointer = image_base + 0x2008;
+  load_config.GuardCFDispatchFunctionPointer = image_base + 0x2010;
+  load_config.GuardCFFunctionTable = image_base + cf_rva;
+  load_config.GuardCFFunctionCount = 4;
+  // CF_INSTRUMENTED | CF_FUNCTION_TABLE_PRESENT, with one byte of flags per
+  // function.
+  load_config.GuardFlags =
+    0x00000500 | (1UL << hadesmem::pelib::kImageGuardCfFunctionTableSizeShift);
+  return load_config;
+}
+
+// The synthetic PE plus a section holding a debug directory (CodeView,
+// POGO and repro entries) and a load config directory with SafeSEH and CFG
+// tables.
+std::vector<std::uint8_t> BuildTestPe(TestPeOptions const& options)
+{
+  hadesmem::pelib::SyntheticPeOptions synthetic_options;
+  synthetic_options.is_64 = options.is_64;
+  auto const file = hadesmem::pelib::BuildSyntheticPe(synthetic_options);
+  hadesmem::pelib::PeView const view{
+    hadesmem::pelib::BufferSource{file.data(), file.size()},
+    hadesmem::PeFileType::kData};
+  std::uint64_t const image_base = view.GetImageBase();
+
+  // Sized up front (generously), so the layout doesn't change once the real
+  // data is set.
+  std::uint32_t const kSectionSize = 0x400;
+  std::uint32_t const kUnmappedSize = 0x200;
+  hadesmem::pelib::PeBuilder builder{view};
+  std::size_t const index = builder.AddSection(
+    ".test", 0x40000040, std::vector<std::uint8_t>(kSectionSize));
+  auto const layout = builder.Plan();
+  std::uint32_t const rva = layout.sections[index].virtual_address;
+  std::uint32_t const raw = layout.sections[index].pointer_to_raw_data;
+
+  // Debug directory and data, then the load config and its tables.
+  std::vector<std::uint8_t> data;
+  std::uint32_t const num_debug_entries = options.add_code_view ? 3 : 2;
+  data.resize(num_debug_entries * sizeof(hadesmem::pelib::ImageDebugDirectory));
+  std::vector<hadesmem::pelib::ImageDebugDirectory> entries;
+  auto const add_entry = [&](std::uint32_t type,
+                             std::vector<std::uint8_t> const& entry_data) {
+    Align(data, 4);
+    hadesmem::pelib::ImageDebugDirectory entry{};
+    entry.Type = type;
+    entry.SizeOfData = static_cast<std::uint32_t>(entry_data.size());
+    entry.PointerToRawData = raw + static_cast<std::uint32_t>(data.size());
+    if (!options.unmapped_debug_data)
+    {
+      entry.AddressOfRawData = rva + static_cast<std::uint32_t>(data.size());
+    }
+    AppendBytes(data, entry_data.data(), entry_data.size());
+    entries.push_back(entry);
+  };
+
+  if (options.add_code_view)
+  {
+    std::vector<std::uint8_t> cv;
+    Append(cv, hadesmem::pelib::kCodeViewSignatureRsds);
+    AppendBytes(cv, kPdbGuid, sizeof(kPdbGuid));
+    Append(cv, kPdbAge);
+    AppendBytes(cv, kPdbPath, sizeof(kPdbPath));
+    add_entry(hadesmem::pelib::kImageDebugTypeCodeView, cv);
+  }
+
+  std::vector<std::uint8_t> pogo;
+  Append(pogo, std::uint32_t{0x4C544347});
+  for (auto const& name : {".text$mn", ".rdata", ".idata$5"})
+  {
+    Append(pogo, std::uint32_t{0x1000});
+    Append(pogo, std::uint32_t{0x20});
+    AppendBytes(pogo, name, std::strlen(name) + 1);
+    Align(pogo, 4);
+  }
+  add_entry(hadesmem::pelib::kImageDebugTypePogo, pogo);
+
+  std::vector<std::uint8_t> repro;
+  Append(repro, std::uint32_t{8});
+  for (std::uint8_t i = 0; i < 8; ++i)
+  {
+    repro.push_back(i);
+  }
+  add_entry(hadesmem::pelib::kImageDebugTypeRepro, repro);
+
+  std::memcpy(data.data(),
+              entries.data(),
+              entries.size() * sizeof(hadesmem::pelib::ImageDebugDirectory));
+
+  Align(data, 8);
+  std::uint32_t const cf_rva = rva + static_cast<std::uint32_t>(data.size());
+  for (std::uint32_t const function : kGuardCfFunctions)
+  {
+    Append(data, function);
+    data.push_back(1);
+  }
+  std::uint32_t seh_rva = 0;
+  if (!options.is_64)
+  {
+    Align(data, 4);
+    seh_rva = rva + static_cast<std::uint32_t>(data.size());
+    for (std::uint32_t const handler : kSafeSehHandlers)
+    {
+      Append(data, handler);
+    }
+  }
+
+  Align(data, 8);
+  std::uint32_t const load_config_rva =
+    rva + static_cast<std::uint32_t>(data.size());
+  if (options.is_64)
+  {
+    Append(data,
+           MakeLoadConfig<hadesmem::pelib::ImageLoadConfigDirectory64>(
+             options.load_config_size, image_base, seh_rva, cf_rva));
+  }
+  else
+  {
+    Append(data,
+           MakeLoadConfig<hadesmem::pelib::ImageLoadConfigDirectory32>(
+             options.load_config_size, image_base, seh_rva, cf_rva));
+  }
+
+  HADESMEM_DETAIL_ASSERT(data.size() <= kSectionSize - kUnmappedSize);
+  data.resize(kSectionSize);
+  builder.SetSectionData(index, data.data(), data.size());
+  if (options.unmapped_debug_data)
+  {
+    // Only the directory itself is left in the image (as the data starts
+    // after it), so the data is in the overlay of the section.
+    builder.ResizeSection(index, kSectionSize, 0x60);
+  }
+
+  hadesmem::pelib::ImageDataDirectory debug_dir{};
+  debug_dir.VirtualAddress = rva;
+  debug_dir.Size =
+    num_debug_entries * sizeof(hadesmem::pelib::ImageDebugDirectory);
+  builder.SetDataDir(hadesmem::PeDataDir::Debug, debug_dir);
+
+  if (options.load_config_size)
+  {
+    hadesmem::pelib::ImageDataDirectory load_config_dir{};
+    load_config_dir.VirtualAddress = load_config_rva;
+    load_config_dir.Size = options.load_config_size;
+    builder.SetDataDir(hadesmem::PeDataDir::LoadConfig, load_config_dir);
+  }
+
+  return builder.Build();
+}
+
+hadesmem::pelib::PeView MakeView(std::vector<std::uint8_t> const& file,
+                                 hadesmem::PeFileType type)
+{
+  return hadesmem::pelib::PeView{
+    hadesmem::pelib::BufferSource{file.data(), file.size()}, type};
+}
+
+std::vector<std::uint8_t> MapTestImage(std::vector<std::uint8_t> const& file)
+{
+  return hadesmem::pelib::MapImage(
+    MakeView(file, hadesmem::PeFileType::kData));
+}
+
+void TestDebugDir(bool is_64)
+{
+  auto const file = BuildTestPe(MakeOptions(is_64, true, false, 0));
+  auto const image = MapTestImage(file);
+
+  for (auto const type : {hadesmem::PeFileType::kData,
+                          hadesmem::PeFileType::kImage})
+  {
+    auto const& buf = type == hadesmem::PeFileType::kData ? file : image;
+    auto const view = MakeView(buf, type);
+    hadesmem::pelib::DebugDir const debug_dir{view};
+    BOOST_TEST_EQ(debug_dir.GetEntries().size(), 3UL);
+    BOOST_TEST(debug_dir.HasPdbInfo());
+    BOOST_TEST(std::memcmp(debug_dir.GetPdbGuid().data(),
+                           kPdbGuid,
+                           sizeof(kPdbGuid)) == 0);
+    BOOST_TEST_EQ(debug_dir.GetPdbAge(), kPdbAge);
+    BOOST_TEST_EQ(debug_dir.GetPdbPath(), std::string{kPdbPath});
+
+    auto const& pogo = debug_dir.GetPogoEntries();
+    BOOST_TEST_EQ(pogo.size(), 3UL);
+    if (pogo.size() == 3)
+    {
+      BOOST_TEST_EQ(pogo[0].name, ".text$mn");
+      BOOST_TEST_EQ(pogo[1].name, ".rdata");
+      BOOST_TEST_EQ(pogo[2].name, ".idata$5");
+      BOOST_TEST_EQ(pogo[2].rva, 0x1000UL);
+      BOOST_TEST_EQ(pogo[2].size, 0x20UL);
+    }
+
+    BOOST_TEST(debug_dir.GetReproHash() ==
+               (std::vector<std::uint8_t>{0, 1, 2, 3, 4, 5, 6, 7}));
+  }
+
+  // Data outside the image can only be found in the file.
+  auto const unmapped = BuildTestPe(MakeOptions(is_64, true, true, 0));
+  hadesmem::pelib::DebugDir const file_debug_dir{
+    MakeView(unmapped, hadesmem::PeFileType::kData)};
+  BOOST_TEST(file_debug_dir.HasPdbInfo());
+  BOOST_TEST_EQ(file_debug_dir.GetPdbPath(), std::string{kPdbPath});
+
+  auto const unmapped_image = MapTestImage(unmapped);
+  hadesmem::pelib::DebugDir const image_debug_dir{
+    MakeView(unmapped_image, hadesmem::PeFileType::kImage)};
+  BOOST_TEST_EQ(image_debug_dir.GetEntries().size(), 3UL);
+  BOOST_TEST(!image_debug_dir.HasPdbInfo());
+  BOOST_TEST(image_debug_dir.GetPogoEntries().empty());
+
+  // Truncated data is ignored rather than being an error.
+  auto truncated = file;
+  auto const truncated_view = MakeView(file, hadesmem::PeFileType::kData);
+  std::size_t const dir_offset = truncated_view.RvaToOffset(
+    truncated_view.GetDataDir(hadesmem::PeDataDir::Debug).VirtualAddress);
+  for (std::size_t i = 0; i < 3; ++i)
+  {
+    std::size_t const size_offset =
+      dir_offset + i * sizeof(hadesmem::pelib::ImageDebugDirectory) +
+      offsetof(hadesmem::pelib::ImageDebugDirectory, SizeOfData);
+    std::uint32_t size;
+    std::memcpy(&size, &truncated[size_offset], sizeof(size));
+    size -= 4;
+    std::memcpy(&truncated[size_offset], &size, sizeof(size));
+  }
+  hadesmem::pelib::DebugDir const truncated_debug_dir{
+    MakeView(truncated, hadesmem::PeFileType::kData)};
+  BOOST_TEST(truncated_debug_dir.HasPdbInfo());
+  BOOST_TEST_EQ(truncated_debug_dir.GetPdbPath(),
+                std::string(kPdbPath, sizeof(kPdbPath) - 4));
+  BOOST_TEST_EQ(truncated_debug_dir.GetPogoEntries().size(), 2UL);
+  BOOST_TEST(truncated_debug_dir.GetReproHash().empty());
+
+  auto const empty = hadesmem::pelib::BuildSyntheticPe(
+    hadesmem::pelib::SyntheticPeOptions{});
+  hadesmem::pelib::DebugDir const empty_debug_dir{
+    MakeView(empty, hadesmem::PeFileType::kData)};
+  BOOST_TEST(empty_debug_dir.GetEntries().empty());
+  BOOST_TEST(!empty_debug_dir.HasPdbInfo());
+}
+
+void TestLoadConfigDir(bool is_64)
+{
+  std::uint32_t const full_size = is_64 ? 148 : 92;
+  auto const file = BuildTestPe(MakeOptions(is_64, true, false, full_size));
+  auto const image = MapTestImage(file);
+
+  for (auto const type : {hadesmem::PeFileType::kData,
+                          hadesmem::PeFileType::kImage})
+  {
+    auto const& buf = type == hadesmem::PeFileType::kData ? file : image;
+    auto const view = MakeView(buf, type);
+    std::uint64_t const image_base = view.GetImageBase();
+    hadesmem::pelib::LoadConfigDir const load_config{view};
+    BOOST_TEST(load_config.IsValid());
+    BOOST_TEST_EQ(load_config.GetSize(), full_size);
+    BOOST_TEST_EQ(load_config.GetTimeDateStamp(), 0x11223344UL);
+    BOOST_TEST_EQ(load_config.GetSecurityCookie(), image_base + 0x2000);
+    BOOST_TEST_EQ(load_config.GetGuardCFCheckFunctionPointer(),
+                  image_base + 0x2008);
+    BOOST_TEST_EQ(load_config.GetGuardCFDispatchFunctionPointer(),
+                  image_base + 0x2010);
+    BOOST_TEST_EQ(load_config.GetGuardCFFunctionCount(), 4ULL);
+    BOOST_TEST(load_config.GetGuardCFFunctions() ==
+               (std::vector<std::uint32_t>{0x1000, 0x1010, 0x1020, 0x1030}));
+    if (is_64)
+    {
+      BOOST_TEST(load_config.GetSafeSehHandlers().empty());
+    }
+    else
+    {
+      BOOST_TEST(load_config.GetSafeSehHandlers() ==
+                 (std::vector<std::uint32_t>{0x1000, 0x1004}));
+    }
+  }
+
+  // A directory from before CFG, so the fields after SEHandlerCount are
+  // ignored (even though they're set).
+  std::uint32_t const pre_cfg_size = is_64 ? 112 : 72;
+  auto const pre_cfg =
+    BuildTestPe(MakeOptions(is_64, true, false, pre_cfg_size));
+  hadesmem::pelib::LoadConfigDir const pre_cfg_load_config{
+    MakeView(pre_cfg, hadesmem::PeFileType::kData)};
+  BOOST_TEST(pre_cfg_load_config.IsValid());
+  BOOST_TEST_EQ(pre_cfg_load_config.GetGuardFlags(), 0UL);
+  BOOST_TEST_EQ(pre_cfg_load_config.GetGuardCFFunctionTable(), 0ULL);
+  BOOST_TEST(pre_cfg_load_config.GetGuardCFFunctions().empty());
+  BOOST_TEST_EQ(pre_cfg_load_config.GetSafeSehHandlers().size(),
+                is_64 ? 0UL : 2UL);
+
+  hadesmem::pelib::LoadConfigDir const no_load_config{
+    MakeView(BuildTestPe(MakeOptions(is_64, true, false, 0)),
+             hadesmem::PeFileType::kData)};
+  BOOST_TEST(!no_load_config.IsValid());
+  BOOST_TEST(no_load_config.GetGuardCFFunctions().empty());
+
+  // A CFG table which runs off the end of the file.
+  auto corrupt = file;
+  auto const corrupt_view = MakeView(file, hadesmem::PeFileType::kData);
+  std::size_t const count_offset =
+    corrupt_view.RvaToOffset(
+      corrupt_view.GetDataDir(hadesmem::PeDataDir::LoadConfig)
+        .VirtualAddress) +
+    (is_64 ? offsetof(hadesmem::pelib::ImageLoadConfigDirectory64,
+                      GuardCFFunctionCount)
+           : offsetof(hadesmem::pelib::ImageLoadConfigDirectory32,
+                      GuardCFFunctionCount));
+  std::uint32_t const bad_count = 0x10000000;
+  std::memcpy(&corrupt[count_offset], &bad_count, sizeof(bad_count));
+  BOOST_TEST_THROWS(hadesmem::pelib::LoadConfigDir(
+                      MakeView(corrupt, hadesmem::PeFileType::kData)),
+                    hadesmem::Error);
+}
+
+void TestModuleIdentity(bool is_64)
+{
+  auto const file = BuildTestPe(MakeOptions(is_64, true, false, 0));
+  auto const image = MapTestImage(file);
+
+  // Same identity for the file and the image.
+  auto const pdb_identity = hadesmem::pelib::GetModuleIdentity(
+    MakeView(file, hadesmem::PeFileType::kData));
+  BOOST_TEST(pdb_identity.GetKind() ==
+             hadesmem::pelib::ModuleIdentityKind::kPdb);
+  BOOST_TEST_EQ(pdb_identity.ToString(), "123456789ABCDEF00123456789ABCDEF1a");
+  BOOST_TEST(pdb_identity == hadesmem::pelib::GetModuleIdentity(MakeView(
+                               image, hadesmem::PeFileType::kImage)));
+
+  auto no_pdb = BuildTestPe(MakeOptions(is_64, false, false, 0));
+  auto const no_pdb_view = MakeView(no_pdb, hadesmem::PeFileType::kData);
+  auto const tds_identity = hadesmem::pelib::GetModuleIdentity(no_pdb_view);
+  BOOST_TEST(tds_identity.GetKind() ==
+             hadesmem::pelib::ModuleIdentityKind::kTimeDateStamp);
+  BOOST_TEST(tds_identity != pdb_identity);
+  BOOST_TEST(pdb_identity < tds_identity);
+  char expected[32];
+  std::snprintf(expected,
+                sizeof(expected),
+                "%08X%x",
+                no_pdb_view.GetFileHeader().TimeDateStamp,
+                no_pdb_view.GetSizeOfImage());
+  BOOST_TEST_EQ(tds_identity.ToString(), std::string{expected});
+
+  // Clear the TimeDateStamp, leaving only the contents.
+  std::uint32_t const zero = 0;
+  std::memcpy(&no_pdb[no_pdb_view.GetDosHeader().e_lfanew + 8],
+              &zero,
+              sizeof(zero));
+  auto const hash_view = MakeView(no_pdb, hadesmem::PeFileType::kData);
+  auto const hash_identity = hadesmem::pelib::GetModuleIdentity(hash_view);
+  BOOST_TEST(hash_identity.GetKind() ==
+             hadesmem::pelib::ModuleIdentityKind::kContentHash);
+  BOOST_TEST_EQ(hash_identity.GetKey().size(), 32UL);
+  BOOST_TEST_EQ(hash_identity.ToString().size(), 64UL);
+  BOOST_TEST(hash_identity == hadesmem::pelib::GetModuleIdentity(hash_view));
+  no_pdb.back() ^= 1;
+  BOOST_TEST(hash_identity !=
+             hadesmem::pelib::GetModuleIdentity(
+               MakeView(no_pdb, hadesmem::PeFileType::kData)));
+}
+}
+
+int main()
+{
+  TestDebugDir(false);
+  TestDebugDir(true);
+  TestLoadConfigDir(false);
+  TestLoadConfigDir(true);
+  TestModuleIdentity(false);
+  TestModuleIdentity(true);
+  return boost::report_errors();
+}
@@ -0,0 +1,399 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/view/pe_builder.hpp>
+#include <hadesmem/pelib/view/pe_builder.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/base_relocation_table.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/image_mapper.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+
+namespace
+{
+hadesmem::pelib::SyntheticPeOptions GetTestOptions(bool is_64)
+{
+  hadesmem::pelib::SyntheticPeOptions options;
+  options.is_64 = is_64;
+  options.num_extra_sections = 2;
+  options.num_exports = 20;
+  options.num_import_modules = 3;
+  options.num_imports_per_module = 5;
+  options.num_relocations = 50;
+  options.num_tls_callbacks = 2;
+  return options;
+}
+
+// Module name, then "name:hint" or "#ordinal" for each import.
+using ImportSummary = std::vector<std::vector<std::string>>;
+
+ImportSummary GetImports(hadesmem::pelib::PeView const& view)
+{
+  ImportSummary imports;
+  auto const import_dir = view.GetDataDir(hadesmem::PeDataDir::Import);
+  std::uint32_t const ptr_size = view.Is64() ? 8 : 4;
+  for (std::uint32_t rva = import_dir.VirtualAddress; rva;
+       rva += sizeof(hadesmem::pelib::ImageImportDescriptor))
+  {
+    auto const desc =
+      view.ReadRva<hadesmem::pelib::ImageImportDescriptor>(rva);
+    if (!desc.FirstThunk)
+    {
+      break;
+    }
+
+    std::vector<std::string> module{view.ReadStringRva<char>(desc.Name)};
+    for (std::uint32_t thunk_rva = desc.OriginalFirstThunk;;
+         thunk_rva += ptr_size)
+    {
+      std::uint64_t const thunk =
+        view.Is64() ? view.ReadRva<std::uint64_t>(thunk_rva)
+                    : view.ReadRva<std::uint32_t>(thunk_rva);
+      if (!thunk)
+      {
+        break;
+      }
+
+      std::uint64_t const ordinal_flag =
+        view.Is64() ? hadesmem::pelib::kImageOrdinalFlag64
+                    : hadesmem::pelib::kImageOrdinalFlag32;
+      if (thunk & ordinal_flag)
+      {
+        module.push_back("#" + std::to_string(thunk & 0xFFFF));
+      }
+      else
+      {
+        auto const name_rva = static_cast<std::uint32_t>(thunk);
+        module.push_back(
+          view.ReadStringRva<char>(name_rva + sizeof(std::uint16_t)) + ":" +
+          std::to_string(view.ReadRva<std::uint16_t>(name_rva)));
+      }
+    }
+    imports.push_back(module);
+  }
+
+  return imports;
+}
+
+// Everything the loader would see, other than the headers.
+void CheckSameSections(hadesmem::pelib::PeView const& lhs,
+                       hadesmem::pelib::PeView const& rhs)
+{
+  std::vector<std::uint8_t> const lhs_image = hadesmem::pelib::MapImage(lhs);
+  std::vector<std::uint8_t> const rhs_image = hadesmem::pelib::MapImage(rhs);
+  for (auto const& section : lhs.GetSections())
+  {
+    std::uint32_t const begin = section.VirtualAddress;
+    std::uint32_t const end = begin + section.VirtualSize;
+    BOOST_TEST(end <= rhs_image.size());
+    if (end <= rhs_image.size())
+    {
+      BOOST_TEST(std::equal(&lhs_image[begin],
+                            &lhs_image[0] + end,
+                            &rhs_image[begin]));
+    }
+  }
+}
+
+void CheckRebuilt(hadesmem::pelib::PeView const& original,
+                  hadesmem::pelib::PeView const& rebuilt)
+{
+  BOOST_TEST_EQ(rebuilt.GetAnomalies(), 0UL);
+  BOOST_TEST_EQ(rebuilt.GetAddressOfEntryPoint(),
+                original.GetAddressOfEntryPoint());
+  BOOST_TEST(GetImports(rebuilt) == GetImports(original));
+
+  hadesmem::pelib::BaseRelocationTable const relocs{original};
+  hadesmem::pelib::BaseRelocationTable const rebuilt_relocs{rebuilt};
+  BOOST_TEST(relocs.GetRvas() == rebuilt_relocs.GetRvas());
+
+  CheckSameSections(original, rebuilt);
+}
+
+hadesmem::pelib::PeBuilderImport MakeImport(std::string const& name,
+                                           std::uint16_t hint,
+                                           std::uint16_t ordinal)
+{
+  hadesmem::pelib::PeBuilderImport import;
+  import.name = name;
+  import.hint = hint;
+  import.ordinal = ordinal;
+  return import;
+}
+
+hadesmem::pelib::PeView ParseData(std::vector<std::uint8_t> const& file)
+{
+  return hadesmem::pelib::PeView{
+    hadesmem::pelib::BufferSource{file.data(), file.size()},
+    hadesmem::PeFileType::kData};
+}
+}
+
+void TestPeBuilderRoundTrip()
+{
+  for (bool is_64 : {false, true})
+  {
+    std::vector<std::uint8_t> const file =
+      hadesmem::pelib::BuildSyntheticPe(GetTestOptions(is_64));
+    hadesmem::pelib::PeView const view = ParseData(file);
+
+    hadesmem::pelib::PeBuilder const builder{view};
+    hadesmem::pelib::PeLayout const layout = builder.Plan();
+    BOOST_TEST_EQ(layout.sections.size(), view.GetSections().size());
+    BOOST_TEST_EQ(layout.size_of_image, view.GetSizeOfImage());
+
+    // Already laid out the same way, so nothing moves.
+    std::vector<std::uint8_t> const rebuilt = builder.Build();
+    BOOST_TEST_EQ(rebuilt.size(), layout.file_size);
+    BOOST_TEST(rebuilt == file);
+    CheckRebuilt(view, ParseData(rebuilt));
+
+    // The same again from the image, which gives the same sections.
+    std::vector<std::uint8_t> const image = hadesmem::pelib::MapImage(view);
+    hadesmem::pelib::PeView const image_view{
+      hadesmem::pelib::BufferSource{image.data(), image.size()},
+      hadesmem::PeFileType::kImage};
+    std::vector<std::uint8_t> const from_image =
+      hadesmem::pelib::PeBuilder{image_view}.Build();
+    CheckRebuilt(view, ParseData(from_image));
+  }
+}
+
+void TestPeBuilderImports()
+{
+  for (bool is_64 : {false, true})
+  {
+    std::vector<std::uint8_t> const file =
+      hadesmem::pelib::BuildSyntheticPe(GetTestOptions(is_64));
+    hadesmem::pelib::PeView const view = ParseData(file);
+    ImportSummary expected = GetImports(view);
+
+    // The existing descriptors are kept as is, followed by one with a new
+    // IAT and one using an existing IAT (the first module's).
+    std::vector<hadesmem::pelib::PeBuilderImportDir> dirs;
+    auto const import_dir = view.GetDataDir(hadesmem::PeDataDir::Import);
+    for (std::size_t i = 0; i < expected.size(); ++i)
+    {
+      hadesmem::pelib::PeBuilderImportDir dir;
+      dir.descriptor = view.ReadRva<hadesmem::pelib::ImageImportDescriptor>(
+        static_cast<std::uint32_t>(
+          import_dir.VirtualAddress +
+          i * sizeof(hadesmem::pelib::ImageImportDescriptor)));
+      dirs.push_back(dir);
+    }
+
+    hadesmem::pelib::PeBuilderImportDir new_dir;
+    new_dir.name = "new.dll";
+    new_dir.imports.push_back(MakeImport("Foo", 3, 0));
+    new_dir.imports.push_back(MakeImport("", 0, 42));
+    // Shared with an existing import, but a separate copy as the existing
+    // one is outside the new directory.
+    new_dir.imports.push_back(
+      MakeImport(hadesmem::pelib::GetSyntheticImportName(0), 7, 0));
+    dirs.push_back(new_dir);
+    expected.push_back(std::vector<std::string>{
+      "new.dll",
+      "Foo:3",
+      "#42",
+      hadesmem::pelib::GetSyntheticImportName(0) + ":7"});
+
+    hadesmem::pelib::PeBuilderImportDir existing_iat_dir;
+    existing_iat_dir.name = "new.dll";
+    existing_iat_dir.imports.push_back(MakeImport("Foo", 3, 0));
+    existing_iat_dir.first_thunk = dirs[0].descriptor.FirstThunk;
+    dirs.push_back(existing_iat_dir);
+    expected.push_back(std::vector<std::string>{"new.dll", "Foo:3"});
+
+    for (bool new_section : {false, true})
+    {
+      hadesmem::pelib::PeBuilder builder{view};
+      std::size_t section_index = builder.GetNumberOfSections() - 1;
+      if (new_section)
+      {
+        BOOST_TEST(builder.CanAddSection());
+        section_index =
+          builder.AddSection(".hmem",
+                             hadesmem::pelib::detail::kSyntheticRData,
+                             std::vector<std::uint8_t>(0x10, 0xCC));
+      }
+      builder.SetImportDirs(dirs, section_index);
+
+      hadesmem::pelib::PeLayout const layout = builder.Plan();
+      std::vector<std::uint8_t> const rebuilt = builder.Build();
+      hadesmem::pelib::PeView const rebuilt_view = ParseData(rebuilt);
+      BOOST_TEST_EQ(rebuilt_view.GetNumberOfSections(),
+                    view.GetNumberOfSections() + (new_section ? 1 : 0));
+      BOOST_TEST_EQ(rebuilt_view.GetAnomalies(), 0UL);
+      BOOST_TEST(GetImports(rebuilt_view) == expected);
+      BOOST_TEST_EQ(rebuilt_view.GetSizeOfImage(), layout.size_of_image);
+      CheckSameSections(view, rebuilt_view);
+
+      auto const& section = rebuilt_view.GetSections()[section_index];
+      auto const new_import_dir =
+        rebuilt_view.GetDataDir(hadesmem::PeDataDir::Import);
+      BOOST_TEST_EQ(new_import_dir.VirtualAddress,
+                    section.VirtualAddress + layout.import_offset);
+      BOOST_TEST_EQ(new_import_dir.Size,
+                    (dirs.size() + 1) *
+                      sizeof(hadesmem::pelib::ImageImportDescriptor));
+      BOOST_TEST(section.VirtualAddress + section.VirtualSize <=
+                 rebuilt_view.GetSizeOfImage());
+
+      // Only the new directory has a new IAT, which holds the same thunks
+      // as its ILT.
+      auto const iat_dir = rebuilt_view.GetDataDir(hadesmem::PeDataDir::IAT);
+      BOOST_TEST_EQ(iat_dir.Size, (is_64 ? 8UL : 4UL) * 4);
+      auto const new_desc =
+        rebuilt_view.ReadRva<hadesmem::pelib::ImageImportDescriptor>(
+          static_cast<std::uint32_t>(
+            new_import_dir.VirtualAddress +
+            expected.size() * sizeof(hadesmem::pelib::ImageImportDescriptor) -
+            2 * sizeof(hadesmem::pelib::ImageImportDescriptor)));
+      BOOST_TEST_EQ(new_desc.FirstThunk, iat_dir.VirtualAddress);
+      BOOST_TEST(rebuilt_view.ReadVectorRva<std::uint8_t>(
+                   new_desc.FirstThunk, iat_dir.Size) ==
+                 rebuilt_view.ReadVectorRva<std::uint8_t>(
+                   new_desc.OriginalFirstThunk, iat_dir.Size));
+
+      // The added section's own data comes first.
+      if (new_section)
+      {
+        BOOST_TEST_EQ(rebuilt[section.PointerToRawData], 0xCC);
+        BOOST_TEST(section.VirtualAddress >=
+                   view.GetSections().back().VirtualAddress +
+                     view.GetSections().back().VirtualSize);
+      }
+
+      // The result can be mapped (and rebased) like any other file.
+      std::vector<std::uint8_t> const image = hadesmem::pelib::MapImage(
+        rebuilt_view, rebuilt_view.GetImageBase() + 0x10000);
+      BOOST_TEST_EQ(image.size(), rebuilt_view.GetSizeOfImage());
+    }
+  }
+}
+
+void TestPeBuilderEdits()
+{
+  std::vector<std::uint8_t> const file =
+    hadesmem::pelib::BuildSyntheticPe(GetTestOptions(true));
+  hadesmem::pelib::PeView const view = ParseData(file);
+
+  hadesmem::pelib::PeBuilder builder{view};
+  builder.StripDosStub();
+  builder.SetImageBase(0x140000000ULL);
+  builder.SetAddressOfEntryPoint(view.GetAddressOfEntryPoint() + 1);
+  builder.SetDataDir(hadesmem::PeDataDir::Debug,
+                     hadesmem::pelib::ImageDataDirectory{0x1234, 0x1C});
+
+  // Zero extended to a few pages, and truncated to nothing.
+  std::size_t const last = builder.GetNumberOfSections() - 1;
+  std::uint32_t const extended_size = 0x2345;
+  builder.ResizeSection(last, extended_size, extended_size);
+  std::vector<std::uint8_t> const data(0x100, 0x5A);
+  std::size_t const extra = builder.AddSection(
+    ".extra", hadesmem::pelib::detail::kSyntheticRData, data, 0x3000);
+  builder.ResizeSection(extra, 0, 0x1000);
+
+  std::vector<std::uint8_t> const rebuilt = builder.Build();
+  hadesmem::pelib::PeView const rebuilt_view = ParseData(rebuilt);
+  BOOST_TEST_EQ(rebuilt_view.GetNtHeadersOffset(),
+                sizeof(hadesmem::pelib::ImageDosHeader));
+  BOOST_TEST_EQ(rebuilt_view.GetImageBase(), 0x140000000ULL);
+  BOOST_TEST_EQ(rebuilt_view.GetAddressOfEntryPoint(),
+                view.GetAddressOfEntryPoint() + 1);
+  BOOST_TEST_EQ(
+    rebuilt_view.GetDataDir(hadesmem::PeDataDir::Debug).VirtualAddress,
+    0x1234UL);
+  BOOST_TEST(rebuilt.size() < file.size() + extended_size + 0x1000);
+
+  auto const& sections = rebuilt_view.GetSections();
+  BOOST_TEST_EQ(sections.size(), view.GetSections().size() + 1);
+  BOOST_TEST_EQ(sections[last].VirtualSize, extended_size);
+  BOOST_TEST_EQ(sections[last].SizeOfRawData,
+                hadesmem::pelib::detail::AlignUp(extended_size, 0x200));
+  BOOST_TEST_EQ(sections.back().SizeOfRawData, 0UL);
+  BOOST_TEST_EQ(sections.back().PointerToRawData, 0UL);
+  BOOST_TEST_EQ(sections.back().VirtualSize, 0x1000UL);
+  BOOST_TEST_EQ(rebuilt_view.GetSizeOfImage(),
+                sections.back().VirtualAddress + 0x1000);
+
+  CheckSameSections(view, rebuilt_view);
+  std::vector<std::uint8_t> const image = hadesmem::pelib::MapImage(
+    rebuilt_view, rebuilt_view.GetImageBase());
+  for (std::uint32_t i = view.GetSections().back().VirtualSize;
+       i < extended_size;
+       ++i)
+  {
+    BOOST_TEST_EQ(image[sections[last].VirtualAddress + i], 0);
+  }
+}
+
+void TestPeBuilderInvalid()
+{
+  std::vector<std::uint8_t> const file =
+    hadesmem::pelib::BuildSyntheticPe(GetTestOptions(false));
+  hadesmem::pelib::PeView const view = ParseData(file);
+
+  // Runs out of space for section headers before the first section.
+  {
+    hadesmem::pelib::PeBuilder builder{view};
+    std::size_t num_added = 0;
+    while (builder.CanAddSection())
+    {
+      builder.AddSection(".x", 0, std::vector<std::uint8_t>(1));
+      ++num_added;
+    }
+    BOOST_TEST(num_added > 0);
+    BOOST_TEST_THROWS(
+      builder.AddSection(".x", 0, std::vector<std::uint8_t>(1)),
+      hadesmem::Error);
+    std::vector<std::uint8_t> const rebuilt = builder.Build();
+    hadesmem::pelib::PeView const rebuilt_view = ParseData(rebuilt);
+    BOOST_TEST_EQ(rebuilt_view.GetNumberOfSections(),
+                  view.GetNumberOfSections() + num_added);
+    BOOST_TEST_EQ(rebuilt_view.GetSizeOfHeaders(),
+                  view.GetSections()[0].VirtualAddress);
+  }
+
+  // Growing a section into the next one.
+  {
+    hadesmem::pelib::PeBuilder builder{view};
+    builder.ResizeSection(0, 0x100, 0x10000);
+    BOOST_TEST_THROWS(builder.Plan(), hadesmem::Error);
+  }
+
+  {
+    hadesmem::pelib::PeBuilder builder{view};
+    BOOST_TEST_THROWS(builder.ResizeSection(100, 0, 0), hadesmem::Error);
+    BOOST_TEST_THROWS(
+      builder.SetImportDirs(
+        std::vector<hadesmem::pelib::PeBuilderImportDir>(1), 0),
+      hadesmem::Error);
+  }
+}
+
+int main()
+{
+  TestPeBuilderRoundTrip();
+  TestPeBuilderImports();
+  TestPeBuilderEdits();
+  TestPeBuilderInvalid();
+  return boost::report_errors();
+}
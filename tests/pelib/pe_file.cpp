@@ -4,16 +4,28 @@
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
 
+#include <cstddef>
+#include <cstdint>
 #include <sstream>
 #include <utility>
+#include <vector>
 
 #include <hadesmem/detail/warning_disable_prefix.hpp>
 #include <boost/detail/lightweight_test.hpp>
 #include <hadesmem/detail/warning_disable_suffix.hpp>
 
 #include <hadesmem/config.hpp>
+#include <hadesmem/detail/filesystem.hpp>
+#include <hadesmem/detail/self_path.hpp>
 #include <hadesmem/error.hpp>
 #include <hadesmem/module.hpp>
+#include <hadesmem/pelib/dos_header.hpp>
+#include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/section.hpp>
+#include <hadesmem/pelib/section_list.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/pe_headers.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
 #include <hadesmem/process.hpp>
 
 // TODO: More comprehensive PE file testing.
@@ -84,8 +96,131 @@ void TestPeFile()
   BOOST_TEST_NE(test_str_1.str(), test_str_3.str());
 }
 
+void TestPeFileData()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  std::vector<char> buf =
+    hadesmem::detail::PeFileToBuffer(hadesmem::detail::GetSelfPath());
+  hadesmem::PeFile const pe_file(process,
+                                 buf.data(),
+                                 hadesmem::PeFileType::kData,
+                                 static_cast<DWORD>(buf.size()));
+  hadesmem::pelib::PeHeaders const* const headers = pe_file.GetHeaders();
+  BOOST_TEST(headers != nullptr);
+  if (!headers)
+  {
+    return;
+  }
+
+  BOOST_TEST_EQ(headers->GetFileSize(), buf.size());
+  BOOST_TEST_EQ(headers->Is64(), pe_file.Is64());
+  BOOST_TEST(!headers->GetSections().empty());
+
+  for (auto const& section : headers->GetSections())
+  {
+    if (!section.SizeOfRawData || section.PointerToRawData < 0x200)
+    {
+      continue;
+    }
+
+    auto const va =
+      hadesmem::RvaToVa(process, pe_file, section.VirtualAddress + 1);
+    BOOST_TEST_EQ(static_cast<void*>(va),
+                  static_cast<void*>(buf.data() + section.PointerToRawData +
+                                     1));
+    BOOST_TEST_EQ(hadesmem::FileOffsetToRva(
+                    process, pe_file, section.PointerToRawData + 1),
+                  section.VirtualAddress + 1);
+  }
+
+  BOOST_TEST_EQ(hadesmem::RvaToVa(process, pe_file, 0),
+                static_cast<void*>(nullptr));
+  BOOST_TEST_EQ(hadesmem::RvaToVa(process,
+                                  pe_file,
+                                  static_cast<DWORD>(buf.size()) +
+                                    headers->GetSizeOfImage()),
+                static_cast<void*>(nullptr));
+
+  std::vector<char> bad_buf(buf);
+  bad_buf[0] = 0;
+  hadesmem::PeFile const pe_file_bad(process,
+                                     bad_buf.data(),
+                                     hadesmem::PeFileType::kData,
+                                     static_cast<DWORD>(bad_buf.size()));
+  BOOST_TEST(pe_file_bad.GetHeaders() == nullptr);
+  BOOST_TEST_THROWS(hadesmem::RvaToVa(process, pe_file_bad, 0x1000),
+                    hadesmem::Error);
+}
+
+void TestPeFileSource()
+{
+  hadesmem::pelib::SyntheticPeOptions options;
+  options.is_64 = true;
+  options.num_extra_sections = 2;
+  hadesmem::pelib::BufferSource const source{
+    hadesmem::pelib::BuildSyntheticPe(options)};
+  hadesmem::PeFile const pe_file(source, hadesmem::PeFileType::kData);
+  BOOST_TEST(pe_file.GetProcess() == nullptr);
+  BOOST_TEST(pe_file.GetSource() != nullptr);
+  BOOST_TEST_EQ(pe_file.GetBase(), static_cast<void const*>(source.GetData()));
+  BOOST_TEST_EQ(pe_file.GetSize(), source.GetSize());
+  BOOST_TEST(pe_file.Is64());
+
+  hadesmem::pelib::PeHeaders const* const headers = pe_file.GetHeaders();
+  BOOST_TEST(headers != nullptr);
+  if (!headers)
+  {
+    return;
+  }
+
+  hadesmem::DosHeader const dos_header(pe_file);
+  BOOST_TEST_EQ(static_cast<std::uint32_t>(dos_header.GetNewHeaderOffset()),
+                headers->GetNtHeadersOffset());
+
+  hadesmem::NtHeaders const nt_headers(pe_file);
+  BOOST_TEST_EQ(nt_headers.GetNumberOfSections(),
+                headers->GetNumberOfSections());
+  BOOST_TEST_EQ(nt_headers.GetImageBase(), headers->GetImageBase());
+
+  std::size_t num_sections = 0;
+  for (auto const& section : hadesmem::SectionList(pe_file))
+  {
+    auto const& expected = headers->GetSections()[num_sections++];
+    BOOST_TEST_EQ(section.GetVirtualAddress(), expected.VirtualAddress);
+    BOOST_TEST_EQ(section.GetPointerToRawData(), expected.PointerToRawData);
+    if (!expected.SizeOfRawData)
+    {
+      continue;
+    }
+
+    auto const base = static_cast<std::uint8_t*>(pe_file.GetBase());
+    BOOST_TEST_EQ(hadesmem::RvaToVa(pe_file, expected.VirtualAddress),
+                  static_cast<void*>(base + expected.PointerToRawData));
+    BOOST_TEST_EQ(hadesmem::FileOffsetToRva(pe_file, expected.PointerToRawData),
+                  expected.VirtualAddress);
+  }
+  BOOST_TEST_EQ(num_sections, headers->GetSections().size());
+
+  hadesmem::Section section(pe_file, static_cast<WORD>(0));
+  section.SetVirtualAddress(0);
+  BOOST_TEST_THROWS(section.UpdateWrite(), hadesmem::Error);
+
+  std::vector<std::uint8_t> bad_buf(source.GetData(),
+                                    source.GetData() + source.GetSize());
+  bad_buf[0] = 0;
+  hadesmem::PeFile const pe_file_bad(
+    hadesmem::pelib::BufferSource{std::move(bad_buf)},
+    hadesmem::PeFileType::kData);
+  BOOST_TEST(pe_file_bad.GetHeaders() == nullptr);
+  BOOST_TEST_THROWS(hadesmem::RvaToVa(pe_file_bad, 0x1000), hadesmem::Error);
+  BOOST_TEST_THROWS(hadesmem::DosHeader{pe_file_bad}, hadesmem::Error);
+}
+
 int main()
 {
   TestPeFile();
+  TestPeFileData();
+  TestPeFileSource();
   return boost::report_errors();
 }
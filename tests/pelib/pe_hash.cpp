@@ -0,0 +1,252 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/view/pe_hash.hpp>
+#include <hadesmem/pelib/view/pe_hash.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/sha.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+
+namespace
+{
+std::vector<std::uint8_t> GetTestFile(bool is_64)
+{
+  hadesmem::pelib::SyntheticPeOptions options;
+  options.is_64 = is_64;
+  options.num_extra_sections = 2;
+  options.num_exports = 100;
+  options.num_import_modules = 4;
+  options.num_imports_per_module = 10;
+  options.num_relocations = 500;
+  std::vector<std::uint8_t> file = hadesmem::pelib::BuildSyntheticPe(options);
+
+  // Something other than zeros to sum.
+  for (std::size_t i = 0x400; i < file.size(); ++i)
+  {
+    file[i] = static_cast<std::uint8_t>(file[i] ^ (i * 13 + (i >> 9)));
+  }
+
+  return file;
+}
+
+std::uint32_t ReadChecksumField(std::vector<std::uint8_t> const& file)
+{
+  hadesmem::pelib::BufferSource const source{file.data(), file.size()};
+  hadesmem::pelib::PeView const view{source, hadesmem::PeFileType::kData};
+  return source.Read<std::uint32_t>(static_cast<std::size_t>(
+    hadesmem::pelib::GetPeChecksumOffset(view)));
+}
+
+// Straight from the description of CheckSumMappedFile, folding after every
+// word.
+std::uint32_t GetChecksumReference(std::vector<std::uint8_t> file)
+{
+  std::size_t checksum_offset = 0;
+  {
+    hadesmem::pelib::BufferSource const source{file.data(), file.size()};
+    hadesmem::pelib::PeView const view{source, hadesmem::PeFileType::kData};
+    checksum_offset =
+      static_cast<std::size_t>(hadesmem::pelib::GetPeChecksumOffset(view));
+  }
+
+  auto const file_size = static_cast<std::uint32_t>(file.size());
+  std::memset(&file[checksum_offset], 0, sizeof(std::uint32_t));
+  if (file.size() % 2)
+  {
+    file.push_back(0);
+  }
+
+  std::uint32_t sum = 0;
+  for (std::size_t i = 0; i < file.size(); i += 2)
+  {
+    sum += static_cast<std::uint32_t>(file[i] | (file[i + 1] << 8));
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  }
+  sum = (sum & 0xFFFF) + (sum >> 16);
+
+  return sum + file_size;
+}
+
+std::size_t GetSecurityDirOffset(hadesmem::pelib::PeView const& view)
+{
+  return view.GetNtHeadersOffset() +
+         hadesmem::pelib::kImageOptionalHeaderOffset +
+         (view.Is64()
+            ? offsetof(hadesmem::pelib::ImageOptionalHeader64, DataDirectory)
+            : offsetof(hadesmem::pelib::ImageOptionalHeader32, DataDirectory)) +
+         static_cast<std::size_t>(hadesmem::PeDataDir::Security) *
+           sizeof(hadesmem::pelib::ImageDataDirectory);
+}
+
+template <typename Hasher>
+void UpdateChunked(Hasher& hasher,
+                   std::vector<std::uint8_t> const& file,
+                   std::size_t chunk_size)
+{
+  for (std::size_t i = 0; i < file.size(); i += chunk_size)
+  {
+    hasher.Update(file.data() + i, (std::min)(chunk_size, file.size() - i));
+  }
+}
+
+// Points the security data directory at a fake certificate table appended to
+// the end of the file (where signtool puts it).
+void AddCertificateTable(std::vector<std::uint8_t>& file)
+{
+  hadesmem::pelib::BufferSource const source{file.data(), file.size()};
+  hadesmem::pelib::PeView const view{source, hadesmem::PeFileType::kData};
+  hadesmem::pelib::ImageDataDirectory const security_dir = {
+    static_cast<std::uint32_t>(file.size()), 0x40};
+  std::memcpy(
+    &file[GetSecurityDirOffset(view)], &security_dir, sizeof(security_dir));
+  file.resize(file.size() + security_dir.Size, 0xCC);
+}
+}
+
+void TestPeChecksum()
+{
+  for (bool is_64 : {false, true})
+  {
+    std::vector<std::uint8_t> file = GetTestFile(is_64);
+
+    // An odd size, so the trailing byte is zero extended.
+    for (std::size_t extra : {0, 1})
+    {
+      file.resize(file.size() + extra, 0x5A);
+
+      std::uint32_t const expected = GetChecksumReference(file);
+      hadesmem::pelib::PeView const view{
+        hadesmem::pelib::BufferSource{file.data(), file.size()},
+        hadesmem::PeFileType::kData};
+      BOOST_TEST_EQ(hadesmem::pelib::ComputePeChecksum(view), expected);
+
+      // Chunks which split the words and the CheckSum field.
+      for (std::size_t chunk_size : {1, 3, 7, 0x55, 0x1001})
+      {
+        hadesmem::pelib::PeChecksum checksum{view};
+        UpdateChunked(checksum, file, chunk_size);
+        BOOST_TEST_EQ(checksum.GetChecksum(), expected);
+      }
+
+      // The CheckSum field itself is ignored, so updating it is idempotent.
+      BOOST_TEST_EQ(hadesmem::pelib::UpdatePeChecksum(file.data(), file.size()),
+                    expected);
+      BOOST_TEST_EQ(ReadChecksumField(file), expected);
+      BOOST_TEST_EQ(GetChecksumReference(file), expected);
+    }
+  }
+}
+
+void TestPeChecksumLarge()
+{
+  // Enough data for the SSE2 path to fold its lanes part way through, with
+  // every word as large as possible.
+  std::vector<std::uint8_t> file = GetTestFile(false);
+  std::size_t const old_size = file.size();
+  file.resize(
+    old_size + 16 * hadesmem::pelib::detail::kPeChecksumMaxBlocks * 3, 0xFF);
+
+  hadesmem::pelib::PeView const view{
+    hadesmem::pelib::BufferSource{file.data(), file.size()},
+    hadesmem::PeFileType::kData};
+  BOOST_TEST_EQ(hadesmem::pelib::ComputePeChecksum(view),
+                GetChecksumReference(file));
+}
+
+template <typename Hasher> void TestPeImageHashImpl(bool is_64)
+{
+  std::vector<std::uint8_t> file = GetTestFile(is_64);
+  AddCertificateTable(file);
+
+  hadesmem::pelib::PeView const view{
+    hadesmem::pelib::BufferSource{file.data(), file.size()},
+    hadesmem::PeFileType::kData};
+  auto const checksum_offset =
+    static_cast<std::size_t>(hadesmem::pelib::GetPeChecksumOffset(view));
+  auto const security_dir = view.GetDataDir(hadesmem::PeDataDir::Security);
+  std::size_t const security_dir_offset = GetSecurityDirOffset(view);
+
+  // Hash everything but the excluded ranges by hand.
+  Hasher expected_hasher;
+  expected_hasher.Update(file.data(), checksum_offset);
+  expected_hasher.Update(file.data() + checksum_offset + 4,
+                         security_dir_offset - (checksum_offset + 4));
+  expected_hasher.Update(file.data() + security_dir_offset + 8,
+                         security_dir.VirtualAddress -
+                           (security_dir_offset + 8));
+  auto const expected = expected_hasher.Finalize();
+
+  BOOST_TEST(hadesmem::pelib::ComputePeImageHash<Hasher>(view) == expected);
+
+  for (std::size_t chunk_size : {1, 5, 0x200, 0x10001})
+  {
+    hadesmem::pelib::PeImageHasher<Hasher> hasher{view};
+    UpdateChunked(hasher, file, chunk_size);
+    BOOST_TEST(hasher.Finalize() == expected);
+  }
+
+  // Changing the excluded data doesn't change the hash, but changing anything
+  // else does.
+  std::vector<std::uint8_t> modified = file;
+  hadesmem::pelib::UpdatePeChecksum(modified.data(), modified.size());
+  modified.back() = 0;
+  hadesmem::pelib::PeImageHasher<Hasher> modified_hasher{view};
+  modified_hasher.Update(modified.data(), modified.size());
+  BOOST_TEST(modified_hasher.Finalize() == expected);
+
+  modified[security_dir_offset + 8] ^= 1;
+  modified_hasher.Update(modified.data(), modified.size());
+  BOOST_TEST(modified_hasher.Finalize() != expected);
+}
+
+void TestPeImageHash()
+{
+  for (bool is_64 : {false, true})
+  {
+    TestPeImageHashImpl<hadesmem::detail::Sha1>(is_64);
+    TestPeImageHashImpl<hadesmem::detail::Sha256>(is_64);
+  }
+}
+
+void TestPeHashInvalid()
+{
+  std::vector<std::uint8_t> const file = GetTestFile(false);
+  hadesmem::pelib::PeView const image_view{
+    hadesmem::pelib::BufferSource{file.data(), file.size()},
+    hadesmem::PeFileType::kImage};
+  BOOST_TEST_THROWS(hadesmem::pelib::ComputePeChecksum(image_view),
+                    hadesmem::Error);
+  BOOST_TEST_THROWS(
+    hadesmem::pelib::ComputePeImageHash<hadesmem::detail::Sha256>(image_view),
+    hadesmem::Error);
+
+  std::vector<std::uint8_t> not_pe(0x1000);
+  BOOST_TEST_THROWS(
+    hadesmem::pelib::UpdatePeChecksum(not_pe.data(), not_pe.size()),
+    hadesmem::Error);
+}
+
+int main()
+{
+  TestPeChecksum();
+  TestPeChecksumLarge();
+  TestPeImageHash();
+  TestPeHashInvalid();
+  return boost::report_errors();
+}
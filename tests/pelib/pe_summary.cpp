@@ -0,0 +1,366 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/view/pe_summary.hpp>
+#include <hadesmem/pelib/view/pe_summary.hpp>
+#include <hadesmem/pelib/view/pe_summary_cache.hpp>
+#include <hadesmem/pelib/view/pe_summary_cache.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/base_relocation_table.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_result.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+
+namespace
+{
+hadesmem::pelib::SyntheticPeOptions GetTestOptions(bool is_64)
+{
+  hadesmem::pelib::SyntheticPeOptions options;
+  options.is_64 = is_64;
+  options.num_extra_sections = 2;
+  options.num_exports = 300;
+  options.num_import_modules = 5;
+  options.num_imports_per_module = 20;
+  options.num_relocations = 100;
+  return options;
+}
+
+void CheckSummary(hadesmem::pelib::SyntheticPeOptions const& options,
+                  hadesmem::pelib::PeView const& view,
+                  hadesmem::pelib::PeSummary const& summary)
+{
+  BOOST_TEST_EQ(summary.Is64(), options.is_64);
+  BOOST_TEST(summary.GetType() == hadesmem::PeFileType::kData);
+  BOOST_TEST_EQ(summary.GetFileSize(), view.GetSize());
+  BOOST_TEST(summary.GetContentHash() ==
+             hadesmem::detail::Sha256::Hash(view.GetSource().GetData(),
+                                            view.GetSize()));
+  BOOST_TEST_EQ(summary.GetAnomalies(), view.GetAnomalies());
+  BOOST_TEST_EQ(summary.GetImageBase(), view.GetImageBase());
+  BOOST_TEST_EQ(summary.GetAddressOfEntryPoint(),
+                view.GetAddressOfEntryPoint());
+  BOOST_TEST_EQ(summary.GetFileHeader().TimeDateStamp,
+                view.GetFileHeader().TimeDateStamp);
+  BOOST_TEST_EQ(
+    summary.GetDataDir(hadesmem::PeDataDir::Import).VirtualAddress,
+    view.GetDataDir(hadesmem::PeDataDir::Import).VirtualAddress);
+
+  BOOST_TEST_EQ(summary.GetNumberOfSections(), view.GetNumberOfSections());
+  for (std::uint32_t i = 0; i < summary.GetNumberOfSections(); ++i)
+  {
+    auto const section = summary.GetSection(i);
+    BOOST_TEST(std::memcmp(&section,
+                           &view.GetSections()[i],
+                           sizeof(section)) == 0);
+  }
+
+  BOOST_TEST_EQ(summary.GetExportModuleName(),
+                hadesmem::pelib::GetSyntheticModuleName());
+  hadesmem::pelib::PeSummaryExportList const exports{summary};
+  BOOST_TEST_EQ(exports.size(), options.num_exports);
+  std::uint32_t num_exports = 0;
+  for (auto const& e : exports)
+  {
+    BOOST_TEST(e.ByName());
+    BOOST_TEST(!e.IsForwarded());
+    BOOST_TEST_EQ(e.GetName(),
+                  hadesmem::pelib::GetSyntheticExportName(num_exports));
+    BOOST_TEST_EQ(e.GetOrdinalNumber(), num_exports);
+    BOOST_TEST_EQ(view.ReadRva<std::uint8_t>(e.GetRva()), 0xC3);
+    ++num_exports;
+  }
+  BOOST_TEST_EQ(num_exports, options.num_exports);
+
+  hadesmem::pelib::PeSummaryImportDirList const import_dirs{summary};
+  BOOST_TEST_EQ(import_dirs.size(), options.num_import_modules);
+  std::uint32_t num_modules = 0;
+  for (auto const& dir : import_dirs)
+  {
+    BOOST_TEST_EQ(dir.GetName(),
+                  hadesmem::pelib::GetSyntheticImportModuleName(num_modules));
+    BOOST_TEST(dir.GetOriginalFirstThunk() != 0);
+    BOOST_TEST(dir.GetFirstThunk() != 0);
+    auto const thunks = dir.GetThunks();
+    BOOST_TEST_EQ(thunks.size(), options.num_imports_per_module);
+    std::uint16_t num_imports = 0;
+    for (auto const& thunk : thunks)
+    {
+      BOOST_TEST(!thunk.ByOrdinal());
+      BOOST_TEST_EQ(thunk.GetHint(), num_imports);
+      BOOST_TEST_EQ(thunk.GetName(),
+                    hadesmem::pelib::GetSyntheticImportName(num_imports));
+      ++num_imports;
+    }
+    ++num_modules;
+  }
+
+  hadesmem::pelib::BaseRelocationTable const relocs{view};
+  BOOST_TEST(!(summary.GetFlags() &
+               hadesmem::pelib::PeSummaryFlags::kInvalidRelocations));
+  BOOST_TEST_EQ(summary.GetNumberOfRelocations(), relocs.size());
+  BOOST_TEST_EQ(summary.GetRelocationTypesSeen(), relocs.GetTypesSeen());
+  BOOST_TEST_EQ(summary.GetRelocationEnd(), relocs.GetEnd());
+}
+
+std::string GetTempDir()
+{
+#if defined(_WIN32)
+  return ".";
+#else  // #if defined(_WIN32)
+  char const* const tmp = std::getenv("TMPDIR");
+  return tmp && *tmp ? tmp : "/tmp";
+#endif // #if defined(_WIN32)
+}
+
+hadesmem::pelib::PeSummaryCache::PathT ToPath(std::string const& str)
+{
+  return hadesmem::pelib::PeSummaryCache::PathT(str.begin(), str.end());
+}
+
+void RemoveFile(hadesmem::pelib::PeSummaryCache::PathT const& path)
+{
+#if defined(_WIN32)
+  ::DeleteFileW(path.c_str());
+#else  // #if defined(_WIN32)
+  std::remove(path.c_str());
+#endif // #if defined(_WIN32)
+}
+}
+
+void TestPeSummary()
+{
+  for (bool is_64 : {false, true})
+  {
+    auto const options = GetTestOptions(is_64);
+    std::vector<std::uint8_t> const file =
+      hadesmem::pelib::BuildSyntheticPe(options);
+    hadesmem::pelib::PeView const view{
+      hadesmem::pelib::BufferSource{file.data(), file.size()},
+      hadesmem::PeFileType::kData};
+
+    std::vector<std::uint8_t> buf = hadesmem::pelib::BuildPeSummary(view);
+    hadesmem::pelib::PeSummary const summary{
+      hadesmem::pelib::BufferSource{std::move(buf)}};
+    CheckSummary(options, view, summary);
+  }
+}
+
+void TestPeSummaryFind()
+{
+  auto const options = GetTestOptions(false);
+  std::vector<std::uint8_t> file = hadesmem::pelib::BuildSyntheticPe(options);
+
+  // Turn the first export into a forwarder, by pointing it at a string
+  // inside the export directory (the module name).
+  {
+    hadesmem::pelib::PeView const view{
+      hadesmem::pelib::BufferSource{file.data(), file.size()},
+      hadesmem::PeFileType::kData};
+    auto const dir_data = view.GetDataDir(hadesmem::PeDataDir::Export);
+    auto const dir = view.ReadRva<hadesmem::pelib::ImageExportDirectory>(
+      dir_data.VirtualAddress);
+    BOOST_TEST(dir.Name >= dir_data.VirtualAddress &&
+               dir.Name < dir_data.VirtualAddress + dir_data.Size);
+    std::memcpy(&file[static_cast<std::size_t>(
+                  view.RvaToOffset(dir.AddressOfFunctions))],
+                &dir.Name,
+                sizeof(dir.Name));
+  }
+
+  hadesmem::pelib::PeView const view{
+    hadesmem::pelib::BufferSource{file.data(), file.size()},
+    hadesmem::PeFileType::kData};
+  hadesmem::pelib::PeSummary const summary{hadesmem::pelib::BufferSource{
+    hadesmem::pelib::BuildPeSummary(view)}};
+  hadesmem::pelib::PeSummaryExportList const exports{summary};
+
+  auto const forwarded =
+    exports.Find(hadesmem::pelib::GetSyntheticExportName(0).c_str());
+  BOOST_TEST(!!forwarded);
+  if (forwarded)
+  {
+    BOOST_TEST(forwarded->IsForwarded());
+    BOOST_TEST_EQ(forwarded->GetRva(), 0UL);
+    BOOST_TEST_EQ(forwarded->GetForwarder(),
+                  hadesmem::pelib::GetSyntheticModuleName());
+  }
+
+  for (std::uint32_t i = 1; i < options.num_exports; i += 7)
+  {
+    std::string const name = hadesmem::pelib::GetSyntheticExportName(i);
+    auto const by_name = exports.Find(name.c_str());
+    BOOST_TEST(!!by_name);
+    auto const by_number = exports.Find(
+      static_cast<std::uint16_t>(i + summary.GetExportOrdinalBase()));
+    BOOST_TEST(!!by_number);
+    if (by_name && by_number)
+    {
+      BOOST_TEST_EQ(by_name->GetName(), name);
+      BOOST_TEST_EQ(by_number->GetName(), name);
+      BOOST_TEST_EQ(by_name->GetRva(), by_number->GetRva());
+      BOOST_TEST(!by_name->IsForwarded());
+    }
+  }
+
+  BOOST_TEST(!exports.Find("NotAnExport"));
+  BOOST_TEST(!exports.Find(""));
+  BOOST_TEST(!exports.Find(static_cast<std::uint16_t>(
+    options.num_exports + summary.GetExportOrdinalBase())));
+}
+
+void TestPeSummaryInvalid()
+{
+  std::vector<std::uint8_t> const file =
+    hadesmem::pelib::BuildSyntheticPe(GetTestOptions(true));
+  hadesmem::pelib::PeView const view{
+    hadesmem::pelib::BufferSource{file.data(), file.size()},
+    hadesmem::PeFileType::kData};
+  std::vector<std::uint8_t> const buf = hadesmem::pelib::BuildPeSummary(view);
+
+  // Truncated anywhere.
+  for (std::size_t size : {std::size_t{0},
+                           std::size_t{4},
+                           sizeof(hadesmem::pelib::PeSummaryHeader) - 1,
+                           buf.size() / 2,
+                           buf.size() - 1})
+  {
+    auto const summary = hadesmem::pelib::PeSummary::TryParse(
+      hadesmem::pelib::BufferSource{buf.data(), size});
+    BOOST_TEST(!summary);
+    BOOST_TEST(summary.GetError() ==
+               hadesmem::pelib::PeError::kInvalidSummary);
+  }
+
+  BOOST_TEST_THROWS(hadesmem::pelib::PeSummary(hadesmem::pelib::BufferSource(
+                      buf.data(), buf.size() - 1)),
+                    hadesmem::Error);
+
+  // Every header field which is checked.
+  auto const corrupt = [&](std::size_t offset) {
+    std::vector<std::uint8_t> bad = buf;
+    bad[offset] ^= 0x80;
+    return !hadesmem::pelib::PeSummary::TryParse(
+      hadesmem::pelib::BufferSource{bad.data(), bad.size()});
+  };
+  BOOST_TEST(corrupt(offsetof(hadesmem::pelib::PeSummaryHeader, magic)));
+  BOOST_TEST(corrupt(offsetof(hadesmem::pelib::PeSummaryHeader, version)));
+  BOOST_TEST(corrupt(offsetof(hadesmem::pelib::PeSummaryHeader, flags)));
+  BOOST_TEST(
+    corrupt(offsetof(hadesmem::pelib::PeSummaryHeader, exports) + 3));
+  BOOST_TEST(corrupt(offsetof(hadesmem::pelib::PeSummaryHeader, strings) +
+                     sizeof(std::uint32_t) + 3));
+  BOOST_TEST(corrupt(buf.size() - 1));
+
+  // A tampered thunk range reads as empty rather than out of bounds.
+  std::vector<std::uint8_t> bad = buf;
+  hadesmem::pelib::PeSummaryHeader header;
+  std::memcpy(&header, bad.data(), sizeof(header));
+  hadesmem::pelib::PeSummaryImportDirEntry entry;
+  std::memcpy(&entry, &bad[header.import_dirs.offset], sizeof(entry));
+  entry.thunk_index = header.import_thunks.count - 1;
+  std::memcpy(&bad[header.import_dirs.offset], &entry, sizeof(entry));
+  hadesmem::pelib::PeSummary const summary{
+    hadesmem::pelib::BufferSource{bad.data(), bad.size()}};
+  BOOST_TEST(
+    (*hadesmem::pelib::PeSummaryImportDirList{summary}.begin())
+      .GetThunks()
+      .empty());
+  BOOST_TEST(!*summary.GetString(hadesmem::pelib::kPeSummaryNoString));
+}
+
+void TestPeSummaryCache()
+{
+  std::vector<std::uint8_t> const file =
+    hadesmem::pelib::BuildSyntheticPe(GetTestOptions(true));
+  hadesmem::pelib::PeView const view{
+    hadesmem::pelib::BufferSource{file.data(), file.size()},
+    hadesmem::PeFileType::kData};
+  auto const key =
+    hadesmem::detail::Sha256::Hash(file.data(), file.size());
+
+  hadesmem::pelib::PeSummaryCache cache{ToPath(GetTempDir())};
+  auto const path = cache.GetPath(key);
+  RemoveFile(path);
+  BOOST_TEST(!cache.Find(key));
+
+  // Miss, then hit.
+  CheckSummary(GetTestOptions(true), view, cache.Get(view));
+  auto const found = cache.Find(key);
+  BOOST_TEST(!!found);
+  if (found)
+  {
+    CheckSummary(GetTestOptions(true), view, *found);
+  }
+  CheckSummary(GetTestOptions(true), view, cache.Get(view));
+
+  // A corrupt (or stale) file is a miss, and is replaced.
+  {
+    std::ofstream out{path, std::ios::binary | std::ios::trunc};
+    out << "garbage";
+  }
+  BOOST_TEST(!cache.Find(key));
+  CheckSummary(GetTestOptions(true), view, cache.Get(view));
+  BOOST_TEST(!!cache.Find(key));
+
+  // Concurrent misses for the same key each store their own temporary file,
+  // and whichever rename comes last wins.
+  RemoveFile(path);
+  std::size_t const kNumThreads = 4;
+  std::vector<std::uint32_t> num_relocs(kNumThreads);
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < kNumThreads; ++i)
+  {
+    threads.emplace_back([&, i]() {
+      num_relocs[i] = cache.Get(view).GetNumberOfRelocations();
+    });
+  }
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+  hadesmem::pelib::BaseRelocationTable const relocs{view};
+  for (std::uint32_t n : num_relocs)
+  {
+    BOOST_TEST_EQ(n, relocs.size());
+  }
+  BOOST_TEST(!!cache.Find(key));
+
+  RemoveFile(path);
+
+  // Failing to store the summary only fails Store, not Get.
+  hadesmem::pelib::PeSummaryCache bad_cache{
+    ToPath(GetTempDir() + "/hadesmem_no_such_dir")};
+  CheckSummary(GetTestOptions(true), view, bad_cache.Get(view));
+  BOOST_TEST(!bad_cache.Find(key));
+  BOOST_TEST_THROWS(
+    bad_cache.Store(key, hadesmem::pelib::BuildPeSummary(view)),
+    hadesmem::Error);
+}
+
+int main()
+{
+  TestPeSummary();
+  TestPeSummaryFind();
+  TestPeSummaryInvalid();
+  TestPeSummaryCache();
+  return boost::report_errors();
+}
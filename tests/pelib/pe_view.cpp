@@ -0,0 +1,417 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/view/pe_view.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/mapped_file.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_headers.hpp>
+#include <hadesmem/pelib/view/pe_result.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+
+namespace
+{
+// A synthetic PE32+ file with an extra section that has a larger virtual size
+// than raw size, so the end of it is zero fill. The header offsets and the
+// section headers are read straight from the buffer rather than through the
+// views being tested.
+struct TestFile
+{
+  std::vector<std::uint8_t> buf;
+  std::uint32_t rva;
+  std::uint32_t offset;
+  std::size_t nt_headers_offset;
+  std::size_t optional_header_offset;
+  std::size_t section_table_offset;
+  hadesmem::pelib::ImageSectionHeader sections[2];
+};
+
+TestFile BuildTestFile()
+{
+  hadesmem::pelib::SyntheticPeOptions options;
+  options.is_64 = true;
+  hadesmem::pelib::SyntheticPeBuilder builder{options, 0x200, 0x800};
+  builder.GetBuilder().SetImageBase(0x140000000ULL);
+  builder.WriteString(builder.GetRva(), "hello");
+  builder.SetDataDir(
+    hadesmem::PeDataDir::Import, builder.GetRva() + 0x10, 0x28);
+
+  TestFile file{};
+  file.buf = builder.Build();
+  file.rva = builder.GetRva();
+  file.offset = builder.RvaToOffset(file.rva);
+
+  hadesmem::pelib::ImageDosHeader dos_header{};
+  std::memcpy(&dos_header, &file.buf[0], sizeof(dos_header));
+  file.nt_headers_offset = static_cast<std::size_t>(dos_header.e_lfanew);
+  file.optional_header_offset = file.nt_headers_offset + sizeof(std::uint32_t) +
+                                sizeof(hadesmem::pelib::ImageFileHeader);
+  hadesmem::pelib::ImageFileHeader file_header{};
+  std::memcpy(&file_header,
+              &file.buf[file.nt_headers_offset + sizeof(std::uint32_t)],
+              sizeof(file_header));
+  file.section_table_offset =
+    file.optional_header_offset + file_header.SizeOfOptionalHeader;
+
+  // Only room for the export and import dirs, so the rest are missing rather
+  // than empty.
+  hadesmem::pelib::ImageOptionalHeader64 optional_header{};
+  std::memcpy(&optional_header,
+              &file.buf[file.optional_header_offset],
+              sizeof(optional_header));
+  optional_header.NumberOfRvaAndSizes = 2;
+  std::memcpy(&file.buf[file.optional_header_offset],
+              &optional_header,
+              sizeof(optional_header));
+
+  std::memcpy(file.sections,
+              &file.buf[file.section_table_offset],
+              sizeof(file.sections));
+
+  return file;
+}
+
+void WriteSections(TestFile& file)
+{
+  std::memcpy(&file.buf[file.section_table_offset],
+              file.sections,
+              sizeof(file.sections));
+}
+
+void WriteMachine(TestFile& file, std::uint16_t machine)
+{
+  std::memcpy(&file.buf[file.nt_headers_offset + sizeof(std::uint32_t)],
+              &machine,
+              sizeof(machine));
+}
+}
+
+void TestBufferSource()
+{
+  std::vector<std::uint8_t> buf{1, 2, 3, 4, 'a', 'b'};
+  hadesmem::pelib::BufferSource const source{buf.data(), buf.size()};
+  BOOST_TEST_EQ(source.GetSize(), 6UL);
+  BOOST_TEST(source.Contains(0, 6));
+  BOOST_TEST(source.Contains(6, 0));
+  BOOST_TEST(!source.Contains(5, 2));
+  BOOST_TEST(!source.Contains(7, 0));
+  BOOST_TEST_EQ(source.Read<std::uint16_t>(1), 0x0302);
+  BOOST_TEST_THROWS(source.Read<std::uint32_t>(3), hadesmem::Error);
+  BOOST_TEST_EQ(source.ReadVector<std::uint8_t>(2, 2).size(), 2UL);
+  BOOST_TEST_THROWS(source.ReadVector<std::uint32_t>(4, 1), hadesmem::Error);
+
+  // Terminated by the end of the buffer rather than a null.
+  BOOST_TEST_EQ(source.ReadString<char>(4), "ab");
+  BOOST_TEST_THROWS(source.ReadString<char>(6), hadesmem::Error);
+
+  auto const try_read = source.TryRead<std::uint16_t>(1);
+  BOOST_TEST(try_read.HasValue());
+  BOOST_TEST_EQ(*try_read, 0x0302);
+  auto try_read_fail = source.TryRead<std::uint32_t>(3);
+  BOOST_TEST(!try_read_fail);
+  BOOST_TEST(try_read_fail.GetError() ==
+             hadesmem::pelib::PeError::kOutOfBounds);
+  BOOST_TEST_THROWS(try_read_fail.GetValueOrThrow(), hadesmem::Error);
+  BOOST_TEST(!source.TryReadVector<std::uint16_t>(5, 1));
+  BOOST_TEST(!source.TryReadVector<std::uint8_t>(1, ~std::size_t{}));
+  BOOST_TEST_EQ(source.TryReadString<char>(4).GetValue(), "ab");
+  BOOST_TEST(!source.TryReadString<char>(6));
+
+  std::uint32_t truncated = 0xFFFFFFFF;
+  BOOST_TEST_EQ(source.ReadTruncated(4, truncated), 2UL);
+  BOOST_TEST_EQ(truncated, 0x6261UL);
+
+  auto const sub_source = source.SubSource(2, 2);
+  BOOST_TEST_EQ(sub_source.Read<std::uint8_t>(0), 3);
+  BOOST_TEST_THROWS(sub_source.Read<std::uint8_t>(2), hadesmem::Error);
+  BOOST_TEST_THROWS(source.SubSource(5, 2), hadesmem::Error);
+
+  // Owning source keeps the buffer alive.
+  hadesmem::pelib::BufferSource owning{std::vector<char>(0x10, 'x')};
+  BOOST_TEST_EQ(owning.GetSize(), 0x10UL);
+  BOOST_TEST_EQ(owning.Read<char>(0xF), 'x');
+}
+
+void TestPeView()
+{
+  TestFile const file = BuildTestFile();
+  std::uint32_t const rva = file.rva;
+  std::uint32_t const offset = file.offset;
+  auto const& text = file.sections[0];
+  hadesmem::pelib::BufferSource const source{file.buf.data(), file.buf.size()};
+  hadesmem::pelib::PeView const pe_view{source, hadesmem::PeFileType::kData};
+  std::size_t const invalid = hadesmem::pelib::PeView::kInvalidOffset;
+
+  BOOST_TEST(pe_view.Is64());
+  BOOST_TEST(pe_view.GetType() == hadesmem::PeFileType::kData);
+  BOOST_TEST_EQ(pe_view.GetNtHeadersOffset(), file.nt_headers_offset);
+  BOOST_TEST_EQ(pe_view.GetImageBase(), 0x140000000ULL);
+  BOOST_TEST_EQ(pe_view.GetSizeOfImage(), rva + 0x1000UL);
+  BOOST_TEST_EQ(pe_view.GetNumberOfSections(), 2);
+  BOOST_TEST_EQ(pe_view.GetSections().size(), 2UL);
+  BOOST_TEST(!pe_view.HasVirtualSectionTable());
+  BOOST_TEST_EQ(pe_view.GetSectionTableOffset(), file.section_table_offset);
+
+  BOOST_TEST(pe_view.HasDataDir(hadesmem::PeDataDir::Import));
+  BOOST_TEST_EQ(
+    pe_view.GetDataDir(hadesmem::PeDataDir::Import).VirtualAddress,
+    rva + 0x10UL);
+  BOOST_TEST(!pe_view.HasDataDir(hadesmem::PeDataDir::TLS));
+  BOOST_TEST_EQ(pe_view.GetDataDir(hadesmem::PeDataDir::TLS).Size, 0UL);
+
+  BOOST_TEST_EQ(pe_view.RvaToOffset(0), invalid);
+  BOOST_TEST_EQ(pe_view.RvaToOffset(0x10), 0x10UL);
+  BOOST_TEST_EQ(pe_view.RvaToOffset(text.VirtualAddress),
+                text.PointerToRawData);
+  BOOST_TEST_EQ(pe_view.RvaToOffset(rva + 0x10), offset + 0x10UL);
+  BOOST_TEST_EQ(pe_view.RvaToOffset(rva + 0x2000), invalid);
+  bool virtual_va = false;
+  BOOST_TEST_EQ(pe_view.RvaToOffset(rva + 0x300, &virtual_va), invalid);
+  BOOST_TEST(virtual_va);
+  BOOST_TEST(pe_view.RvaToPtr(rva) == source.GetData() + offset);
+
+  BOOST_TEST_EQ(pe_view.FileOffsetToRva(offset + 0x10), rva + 0x10UL);
+  BOOST_TEST_EQ(pe_view.FileOffsetToRva(0x10), 0UL);
+
+  BOOST_TEST_EQ(pe_view.ReadStringRva<char>(rva), "hello");
+  BOOST_TEST_EQ(pe_view.ReadRva<std::uint8_t>(rva + 1), 'e');
+  BOOST_TEST_THROWS(pe_view.ReadRva<std::uint8_t>(rva + 0x300),
+                    hadesmem::Error);
+
+  // Image layout is a direct mapping.
+  hadesmem::pelib::PeView const pe_view_image{source,
+                                              hadesmem::PeFileType::kImage};
+  BOOST_TEST_EQ(pe_view_image.RvaToOffset(offset + 0x10), offset + 0x10UL);
+  BOOST_TEST_EQ(pe_view_image.RvaToOffset(file.buf.size() + 1), invalid);
+
+  // Truncating the file in the middle of the section table makes the second
+  // section header virtual.
+  auto const truncated_source = source.SubSource(
+    0,
+    file.section_table_offset + sizeof(hadesmem::pelib::ImageSectionHeader) +
+      0x10);
+  hadesmem::pelib::PeView const pe_view_truncated{truncated_source,
+                                                  hadesmem::PeFileType::kData};
+  BOOST_TEST_EQ(pe_view_truncated.GetNumberOfSections(), 2);
+  BOOST_TEST_EQ(pe_view_truncated.GetSections().size(), 1UL);
+  BOOST_TEST_EQ(pe_view_truncated.RvaToOffset(rva), invalid);
+
+  TestFile bad_dos = BuildTestFile();
+  bad_dos.buf[0] = 0;
+  BOOST_TEST_THROWS(hadesmem::pelib::PeView(
+                      hadesmem::pelib::BufferSource{std::move(bad_dos.buf)},
+                      hadesmem::PeFileType::kData),
+                    hadesmem::Error);
+
+  TestFile bad_machine = BuildTestFile();
+  WriteMachine(bad_machine, hadesmem::pelib::kImageFileMachineI386);
+  BOOST_TEST_THROWS(hadesmem::pelib::PeView(
+                      hadesmem::pelib::BufferSource{std::move(bad_machine.buf)},
+                      hadesmem::PeFileType::kData),
+                    hadesmem::Error);
+
+  BOOST_TEST_THROWS(
+    hadesmem::pelib::PeView(source.SubSource(0, file.nt_headers_offset),
+                            hadesmem::PeFileType::kData),
+    hadesmem::Error);
+}
+
+void TestPeHeadersOverlap()
+{
+  // Overlapping sections resolve to the first in header order, the same as a
+  // linear scan, and zero-sized ones are skipped.
+  TestFile file = BuildTestFile();
+  auto& sections = file.sections;
+  std::uint32_t const text_rva = sections[0].VirtualAddress;
+  std::uint32_t const text_offset = sections[0].PointerToRawData;
+  sections[0].VirtualSize = 0x1800;
+  sections[1].VirtualAddress = text_rva + 0x800;
+  sections[1].VirtualSize = 0;
+  sections[1].SizeOfRawData = 0;
+  WriteSections(file);
+
+  // Only the headers are in the source.
+  hadesmem::pelib::PeHeaders const headers{
+    hadesmem::pelib::BufferSource{file.buf.data(), text_offset},
+    file.buf.size(),
+    hadesmem::PeFileType::kData};
+  std::size_t const invalid = hadesmem::pelib::PeHeaders::kInvalidOffset;
+  BOOST_TEST_EQ(headers.GetFileSize(), file.buf.size());
+  BOOST_TEST_EQ(headers.RvaToOffset(text_rva + 0x10), text_offset + 0x10UL);
+  bool virtual_va = false;
+  BOOST_TEST_EQ(headers.RvaToOffset(text_rva + 0x1000, &virtual_va), invalid);
+  BOOST_TEST(virtual_va);
+  BOOST_TEST_EQ(headers.RvaToOffset(text_rva + 0x1800), invalid);
+  BOOST_TEST_EQ(headers.FileOffsetToRva(text_offset + 0x10),
+                text_rva + 0x10UL);
+  BOOST_TEST_EQ(headers.FileOffsetToRva(file.offset), 0UL);
+
+  sections[1].VirtualAddress = text_rva;
+  sections[1].VirtualSize = 0x3000;
+  sections[1].PointerToRawData = 0x1000;
+  WriteSections(file);
+  hadesmem::pelib::PeHeaders const headers_2{
+    hadesmem::pelib::BufferSource{file.buf.data(), file.buf.size()},
+    file.buf.size(),
+    hadesmem::PeFileType::kData};
+  BOOST_TEST_EQ(headers_2.RvaToOffset(text_rva + 0x10), text_offset + 0x10UL);
+  BOOST_TEST_EQ(headers_2.RvaToOffset(text_rva + 0x1900), invalid);
+}
+
+void TestPeViewTryParse()
+{
+  using hadesmem::pelib::PeAnomalies;
+  using hadesmem::pelib::PeError;
+
+  TestFile const file = BuildTestFile();
+  std::uint32_t const rva = file.rva;
+  hadesmem::pelib::BufferSource const source{file.buf.data(), file.buf.size()};
+  auto const pe_view =
+    hadesmem::pelib::PeView::TryParse(source, hadesmem::PeFileType::kData);
+  BOOST_TEST(pe_view.HasValue());
+  BOOST_TEST_EQ(pe_view->GetAnomalies(),
+                static_cast<std::uint32_t>(PeAnomalies::kNone));
+  BOOST_TEST_EQ(pe_view->TryReadRva<std::uint8_t>(rva + 1).GetValue(), 'e');
+  BOOST_TEST(pe_view->TryReadRva<std::uint8_t>(rva + 0x300).GetError() ==
+             PeError::kInvalidRva);
+  BOOST_TEST_EQ(pe_view->TryReadStringRva<char>(rva).GetValue(), "hello");
+  BOOST_TEST(pe_view->TryReadVectorRva<std::uint8_t>(rva, 0x300).GetError() ==
+             PeError::kOutOfBounds);
+
+  // Each of the errors thrown by the constructor.
+  TestFile bad_dos = BuildTestFile();
+  bad_dos.buf[0] = 0;
+  BOOST_TEST(
+    hadesmem::pelib::PeView::TryParse(
+      hadesmem::pelib::BufferSource{bad_dos.buf.data(), bad_dos.buf.size()},
+      hadesmem::PeFileType::kData).GetError() == PeError::kInvalidDosHeader);
+  BOOST_TEST(hadesmem::pelib::PeView::TryParse(
+               source.SubSource(0, file.nt_headers_offset),
+               hadesmem::PeFileType::kData).GetError() ==
+             PeError::kOutOfBounds);
+  BOOST_TEST(hadesmem::pelib::PeHeaders::TryParse(
+               source, 0, hadesmem::PeFileType::kData).GetError() ==
+             PeError::kInvalidFileSize);
+
+  // PeHeaders accepts a bad machine, but flags it, and PeView rejects it.
+  TestFile bad_machine = BuildTestFile();
+  WriteMachine(bad_machine, hadesmem::pelib::kImageFileMachineI386);
+  hadesmem::pelib::BufferSource const bad_machine_source{
+    bad_machine.buf.data(), bad_machine.buf.size()};
+  auto const bad_machine_headers =
+    hadesmem::pelib::PeHeaders::TryParse(bad_machine_source,
+                                         bad_machine.buf.size(),
+                                         hadesmem::PeFileType::kData);
+  BOOST_TEST(bad_machine_headers.HasValue());
+  BOOST_TEST(bad_machine_headers->HasAnomaly(
+    PeAnomalies::kInvalidOptionalHeaderMagic));
+  BOOST_TEST(hadesmem::pelib::PeView::TryParse(bad_machine_source,
+                                               hadesmem::PeFileType::kData)
+               .GetError() == PeError::kInvalidNtHeaders);
+
+  auto const truncated = hadesmem::pelib::PeView::TryParse(
+    source.SubSource(0,
+                     file.section_table_offset +
+                       sizeof(hadesmem::pelib::ImageSectionHeader) + 0x10),
+    hadesmem::PeFileType::kData);
+  BOOST_TEST(truncated.HasValue());
+  BOOST_TEST_EQ(truncated->GetAnomalies(),
+                static_cast<std::uint32_t>(PeAnomalies::kTruncatedSectionTable |
+                                           PeAnomalies::kSectionOutsideFile));
+
+  TestFile anomalous = BuildTestFile();
+  hadesmem::pelib::ImageOptionalHeader64 optional_header{};
+  std::memcpy(&optional_header,
+              &anomalous.buf[anomalous.optional_header_offset],
+              sizeof(optional_header));
+  optional_header.SectionAlignment = 0x200;
+  optional_header.AddressOfEntryPoint = optional_header.SizeOfImage;
+  optional_header.NumberOfRvaAndSizes = 0x20;
+  std::memcpy(&anomalous.buf[anomalous.optional_header_offset],
+              &optional_header,
+              sizeof(optional_header));
+  anomalous.sections[0].VirtualSize = 0x1800;
+  WriteSections(anomalous);
+  auto const anomalous_view = hadesmem::pelib::PeView::TryParse(
+    hadesmem::pelib::BufferSource{anomalous.buf.data(), anomalous.buf.size()},
+    hadesmem::PeFileType::kData);
+  BOOST_TEST(anomalous_view.HasValue());
+  BOOST_TEST_EQ(
+    anomalous_view->GetAnomalies(),
+    static_cast<std::uint32_t>(
+      PeAnomalies::kLowAlignment | PeAnomalies::kEntryPointOutsideImage |
+      PeAnomalies::kExtraDataDirs | PeAnomalies::kOverlappingSections));
+}
+
+void TestMappedFile()
+{
+  TestFile const test_file = BuildTestFile();
+  std::vector<std::uint8_t> const& buf = test_file.buf;
+
+  std::string const path_narrow = "hadesmem_pe_view_mapped_file.bin";
+  hadesmem::pelib::MappedFile::PathT const path(std::begin(path_narrow),
+                                                std::end(path_narrow));
+  {
+    std::ofstream file(path_narrow.c_str(), std::ios::binary);
+    file.write(reinterpret_cast<char const*>(buf.data()),
+               static_cast<std::streamsize>(buf.size()));
+    BOOST_TEST(file.good());
+  }
+
+  {
+    auto const source = hadesmem::pelib::MapFileSource(
+      path, hadesmem::pelib::MappedFileAccess::kRandom);
+    BOOST_TEST_EQ(source.GetSize(), buf.size());
+    BOOST_TEST_EQ(std::memcmp(source.GetData(), buf.data(), buf.size()), 0);
+
+    hadesmem::pelib::PeView const pe_view{source,
+                                          hadesmem::PeFileType::kData};
+    BOOST_TEST_EQ(pe_view.GetSections().size(), 2UL);
+    BOOST_TEST_EQ(pe_view.ReadStringRva<char>(test_file.rva), "hello");
+
+    hadesmem::pelib::MappedFile const mapped_file{path};
+    BOOST_TEST_EQ(mapped_file.GetSize(), buf.size());
+    // Only a hint, so there's nothing to check other than that it's safe to
+    // call with any range.
+    mapped_file.Advise(
+      hadesmem::pelib::MappedFileAccess::kSequential, 0x10, 0x1000);
+    mapped_file.Advise(
+      hadesmem::pelib::MappedFileAccess::kNormal, buf.size(), 0x1000);
+  }
+
+  // The mappings need to be gone before the file can be removed on Windows.
+  BOOST_TEST_EQ(std::remove(path_narrow.c_str()), 0);
+  BOOST_TEST_THROWS(hadesmem::pelib::MappedFile{path}, hadesmem::Error);
+
+  {
+    std::ofstream file(path_narrow.c_str(), std::ios::binary);
+  }
+  BOOST_TEST_THROWS(hadesmem::pelib::MappedFile{path}, hadesmem::Error);
+  BOOST_TEST_EQ(std::remove(path_narrow.c_str()), 0);
+}
+
+int main()
+{
+  TestBufferSource();
+  TestPeView();
+  TestPeHeadersOverlap();
+  TestPeViewTryParse();
+  TestMappedFile();
+  return boost::report_errors();
+}
@@ -0,0 +1,346 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/resource_dir.hpp>
+#include <hadesmem/pelib/resource_dir.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/resource_dir_table.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+#include <hadesmem/process.hpp>
+
+namespace
+{
+DWORD const kRsrcSize = 0x1000;
+DWORD const kDataOffset = 0x800;
+
+// A resource directory filling the extra section of a synthetic file.
+class ResourceTestFile
+{
+public:
+  ResourceTestFile()
+    : builder_{hadesmem::pelib::SyntheticPeOptions{}, kRsrcSize}
+  {
+    builder_.SetDataDir(hadesmem::PeDataDir::Resource, GetRva(), kRsrcSize);
+  }
+
+  DWORD GetRva() const
+  {
+    return builder_.GetRva();
+  }
+
+  DWORD GetDataRva() const
+  {
+    return GetRva() + kDataOffset;
+  }
+
+  // Writes a table at the given offset from the start of the resource
+  // directory. Entries are (name, offset) pairs as stored in the file.
+  void WriteTable(DWORD offset,
+                  WORD num_named,
+                  std::initializer_list<std::pair<DWORD, DWORD>> entries)
+  {
+    hadesmem::pelib::ImageResourceDirectory table{};
+    table.NumberOfNamedEntries = num_named;
+    table.NumberOfIdEntries = static_cast<WORD>(entries.size() - num_named);
+    Write(offset, &table, sizeof(table));
+    DWORD entry_offset = offset + sizeof(table);
+    for (auto const& e : entries)
+    {
+      hadesmem::pelib::ImageResourceDirectoryEntry const entry = {e.first,
+                                                                  e.second};
+      Write(entry_offset, &entry, sizeof(entry));
+      entry_offset += sizeof(entry);
+    }
+  }
+
+  // Writes a data entry and 4 bytes of data (the index repeated).
+  void WriteData(DWORD offset, BYTE index)
+  {
+    DWORD const data_offset = kDataOffset + index * 4;
+    hadesmem::pelib::ImageResourceDataEntry const entry = {
+      GetRva() + data_offset, 4, 1252, 0};
+    Write(offset, &entry, sizeof(entry));
+    BYTE const data[] = {index, index, index, index};
+    Write(data_offset, data, sizeof(data));
+  }
+
+  void WriteName(DWORD offset, std::wstring const& name)
+  {
+    auto const len = static_cast<WORD>(name.size());
+    Write(offset, &len, sizeof(len));
+    for (std::size_t i = 0; i < name.size(); ++i)
+    {
+      auto const c = static_cast<WORD>(name[i]);
+      Write(static_cast<DWORD>(offset + (i + 1) * sizeof(WORD)),
+            &c,
+            sizeof(c));
+    }
+  }
+
+  // Offsets are from the start of the resource directory.
+  void Write(DWORD offset, void const* data, std::size_t len)
+  {
+    builder_.Write(GetRva() + offset, data, len);
+  }
+
+  void RemoveDataDir()
+  {
+    builder_.SetDataDir(hadesmem::PeDataDir::Resource, 0, 0);
+  }
+
+  std::vector<std::uint8_t> Build() const
+  {
+    return builder_.Build();
+  }
+
+private:
+  hadesmem::pelib::SyntheticPeBuilder builder_;
+};
+
+DWORD const kDir = hadesmem::pelib::kImageResourceDataIsDirectory;
+DWORD const kName = hadesmem::pelib::kImageResourceNameIsString;
+
+// Standard three level tree:
+//   "CUSTOM"/#1/1033, #3/#1/1033, #3/#2/1033, #3/#7/1033, #16/#1/1033,
+//   #16/#1/2052.
+ResourceTestFile BuildResourceTestFile()
+{
+  ResourceTestFile file;
+  file.WriteTable(0x000,
+                  1,
+                  {{kName | 0x700, kDir | 0x100},
+                   {3, kDir | 0x200},
+                   {16, kDir | 0x300}});
+  file.WriteTable(0x100, 0, {{1, kDir | 0x400}});
+  file.WriteTable(
+    0x200, 0, {{1, kDir | 0x440}, {2, kDir | 0x480}, {7, kDir | 0x4C0}});
+  file.WriteTable(0x300, 0, {{1, kDir | 0x500}});
+  file.WriteTable(0x400, 0, {{1033, 0x600}});
+  file.WriteTable(0x440, 0, {{1033, 0x610}});
+  file.WriteTable(0x480, 0, {{1033, 0x620}});
+  file.WriteTable(0x4C0, 0, {{1033, 0x630}});
+  file.WriteTable(0x500, 0, {{1033, 0x640}, {2052, 0x650}});
+  for (BYTE i = 0; i < 6; ++i)
+  {
+    file.WriteData(0x600 + i * 0x10, i);
+  }
+  file.WriteName(0x700, L"CUSTOM");
+  return file;
+}
+
+std::unique_ptr<hadesmem::PeFile> MakePeFile(hadesmem::Process const& process,
+                                             std::vector<std::uint8_t>& buf)
+{
+  return std::make_unique<hadesmem::PeFile>(process,
+                                            buf.data(),
+                                            hadesmem::PeFileType::kData,
+                                            static_cast<DWORD>(buf.size()));
+}
+
+BYTE FindDataIndex(hadesmem::ResourceDir const& resource_dir,
+                   hadesmem::ResourceId const& type,
+                   hadesmem::ResourceId const& name,
+                   hadesmem::ResourceId const& language)
+{
+  auto const data_entry = resource_dir.Find(type, name, language);
+  if (!data_entry)
+  {
+    return 0xFF;
+  }
+
+  auto const data = resource_dir.ReadData(*data_entry);
+  BOOST_TEST_EQ(data.size(), 4U);
+  return data.empty() ? 0xFE : data[0];
+}
+}
+
+void TestResourceDir()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+  ResourceTestFile const file = BuildResourceTestFile();
+  std::vector<std::uint8_t> buf = file.Build();
+  auto const pe_file = MakePeFile(process, buf);
+
+  hadesmem::ResourceDir const resource_dir(process, *pe_file);
+  BOOST_TEST_EQ(resource_dir.GetRva(), file.GetRva());
+  BOOST_TEST_EQ(resource_dir.GetSize(), kRsrcSize);
+
+  hadesmem::ResourceDirTable const root = resource_dir.GetRoot();
+  BOOST_TEST_EQ(root.GetDepth(), 0U);
+  BOOST_TEST_EQ(root.size(), 3U);
+  BOOST_TEST_EQ(root.GetNumberOfNamedEntries(), 1);
+  BOOST_TEST_EQ(root.GetNumberOfIdEntries(), 2);
+  BOOST_TEST(root.begin()->IsNamed());
+  BOOST_TEST(root.GetName(*root.begin()) == L"CUSTOM");
+  BOOST_TEST(root.Find(3) == &*(root.begin() + 1));
+  BOOST_TEST(root.Find(16) == &*(root.begin() + 2));
+  BOOST_TEST(root.Find(4) == nullptr);
+  BOOST_TEST(root.Find(L"custom") == &*root.begin());
+  BOOST_TEST(root.Find(L"OTHER") == nullptr);
+
+  hadesmem::ResourceDirTable const icons =
+    root.GetSubdirectory(*root.Find(3));
+  BOOST_TEST_EQ(icons.GetDepth(), 1U);
+  BOOST_TEST_EQ(icons.size(), 3U);
+  BOOST_TEST(icons.Find(7) != nullptr);
+  BOOST_TEST(icons.Find(3) == nullptr);
+  BOOST_TEST_THROWS(icons.GetDataEntry(*icons.Find(7)), hadesmem::Error);
+
+  using hadesmem::ResourceId;
+  BOOST_TEST_EQ(FindDataIndex(resource_dir,
+                              ResourceId{L"CUSTOM"},
+                              ResourceId{1},
+                              ResourceId{1033}),
+                0);
+  BOOST_TEST_EQ(FindDataIndex(resource_dir,
+                              ResourceId{3},
+                              ResourceId{7},
+                              ResourceId{1033}),
+                3);
+  BOOST_TEST_EQ(FindDataIndex(resource_dir,
+                              ResourceId{L"#16"},
+                              ResourceId{L"#1"},
+                              ResourceId{2052}),
+                5);
+  BOOST_TEST_EQ(FindDataIndex(resource_dir,
+                              ResourceId{16},
+                              ResourceId{1},
+                              ResourceId{1031}),
+                0xFF);
+  BOOST_TEST_EQ(FindDataIndex(resource_dir,
+                              ResourceId{3},
+                              ResourceId{5},
+                              ResourceId{1033}),
+                0xFF);
+  BOOST_TEST_EQ(FindDataIndex(resource_dir,
+                              ResourceId{L"OTHER"},
+                              ResourceId{1},
+                              ResourceId{1033}),
+                0xFF);
+
+  auto const first_language =
+    resource_dir.Find(ResourceId{16}, ResourceId{1});
+  BOOST_TEST(first_language != nullptr);
+  BOOST_TEST_EQ(first_language->GetOffsetToData(), file.GetDataRva() + 4 * 4);
+  BOOST_TEST_EQ(first_language->GetCodePage(), 1252U);
+
+  auto const resources = resource_dir.GetResources();
+  BOOST_TEST_EQ(resources.size(), 6U);
+  for (std::size_t i = 0; i < resources.size(); ++i)
+  {
+    BOOST_TEST_EQ(resources[i].data.GetOffsetToData(),
+                  file.GetDataRva() + static_cast<DWORD>(i) * 4);
+  }
+  BOOST_TEST(resources[0].type == ResourceId{L"CUSTOM"});
+  BOOST_TEST(resources[2].type == ResourceId{3});
+  BOOST_TEST(resources[2].name == ResourceId{2});
+  BOOST_TEST(resources[5].language == ResourceId{2052});
+
+  BOOST_TEST(ResourceId{L"#123"} == ResourceId{123});
+  BOOST_TEST(ResourceId{L"#"}.IsNamed());
+  BOOST_TEST(ResourceId{L"#1x"}.IsNamed());
+  BOOST_TEST(ResourceId{L"#70000"}.IsNamed());
+}
+
+void TestResourceDirMalformed()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  // Unsorted IDs (falls back to a linear search), a subdirectory shared by
+  // two types (only walked once), a cycle back to the root, a subdirectory
+  // pointing outside the file, and a table whose entry count runs past the
+  // end of the file.
+  ResourceTestFile file = BuildResourceTestFile();
+  file.WriteTable(0x000,
+                  0,
+                  {{16, kDir | 0x300},
+                   {3, kDir | 0x200},
+                   {5, kDir | 0x200},
+                   {6, kDir | 0x000},
+                   {7, kDir | 0x7FFFFFF0},
+                   {8, kDir | 0xFF0}});
+  file.WriteTable(0x4C0, 0, {{1033, kDir | 0x200}});
+  file.WriteTable(0xFF0, 0, {});
+  hadesmem::pelib::ImageResourceDirectory truncated{};
+  truncated.NumberOfIdEntries = 0xFFFF;
+  file.Write(0xFF0, &truncated, sizeof(truncated));
+
+  std::vector<std::uint8_t> buf = file.Build();
+  auto const pe_file = MakePeFile(process, buf);
+  hadesmem::ResourceDir const resource_dir(process, *pe_file);
+  hadesmem::ResourceDirTable const root = resource_dir.GetRoot();
+
+  BOOST_TEST(root.Find(3) != nullptr);
+  BOOST_TEST(root.Find(16) != nullptr);
+  BOOST_TEST(root.Find(4) == nullptr);
+  BOOST_TEST_THROWS(root.GetSubdirectory(*root.Find(6)), hadesmem::Error);
+  BOOST_TEST_THROWS(root.GetSubdirectory(*root.Find(7)), hadesmem::Error);
+  BOOST_TEST_EQ(root.GetSubdirectory(*root.Find(8)).size(), 0U);
+
+  // #3/#7/1033 points back to #3.
+  hadesmem::ResourceDirTable const icons =
+    root.GetSubdirectory(*root.Find(3));
+  hadesmem::ResourceDirTable const icon =
+    icons.GetSubdirectory(*icons.Find(7));
+  BOOST_TEST_THROWS(icon.GetSubdirectory(*icon.Find(1033)), hadesmem::Error);
+
+  using hadesmem::ResourceId;
+  BOOST_TEST(
+    resource_dir.Find(ResourceId{5}, ResourceId{2}, ResourceId{1033}) !=
+    nullptr);
+  BOOST_TEST(
+    resource_dir.Find(ResourceId{16}, ResourceId{1}, ResourceId{2052}) !=
+    nullptr);
+
+  // #16/#1 (2 languages), then #3/#1 and #3/#2. #3/#7 is a directory, and #5
+  // is the same table as #3 so is skipped.
+  BOOST_TEST_EQ(resource_dir.GetResources().size(), 4U);
+
+  // Nesting deeper than the limit is rejected, even without a cycle.
+  ResourceTestFile deep;
+  for (DWORD i = 0; i < 12; ++i)
+  {
+    deep.WriteTable(i * 0x20, 0, {{1, kDir | ((i + 1) * 0x20)}});
+  }
+  std::vector<std::uint8_t> deep_buf = deep.Build();
+  auto const deep_pe_file = MakePeFile(process, deep_buf);
+  hadesmem::ResourceDir const deep_resource_dir(process, *deep_pe_file);
+  std::unique_ptr<hadesmem::ResourceDirTable> table =
+    std::make_unique<hadesmem::ResourceDirTable>(deep_resource_dir.GetRoot());
+  for (std::size_t i = 0; i < hadesmem::ResourceDirTable::kMaxDepth; ++i)
+  {
+    table = std::make_unique<hadesmem::ResourceDirTable>(
+      table->GetSubdirectory(*table->begin()));
+  }
+  BOOST_TEST_THROWS(table->GetSubdirectory(*table->begin()), hadesmem::Error);
+
+  // No resource directory.
+  ResourceTestFile empty;
+  empty.RemoveDataDir();
+  std::vector<std::uint8_t> empty_buf = empty.Build();
+  auto const empty_pe_file = MakePeFile(process, empty_buf);
+  BOOST_TEST_THROWS(hadesmem::ResourceDir(process, *empty_pe_file),
+                    hadesmem::Error);
+}
+
+int main()
+{
+  TestResourceDir();
+  TestResourceDirMalformed();
+  return boost::report_errors();
+}
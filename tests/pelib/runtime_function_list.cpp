@@ -0,0 +1,303 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/runtime_function_list.hpp>
+#include <hadesmem/pelib/runtime_function_list.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/exception_dir.hpp>
+#include <hadesmem/pelib/pe_file.hpp>
+#include <hadesmem/pelib/runtime_function.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+#include <hadesmem/process.hpp>
+
+namespace
+{
+DWORD const kExceptionSectionSize = 0x1000;
+DWORD const kUnwindOffset = 0x800;
+
+// The unwind info addresses are offsets from the start of the unwind info.
+struct TestFunction
+{
+  DWORD begin;
+  DWORD end;
+  DWORD unwind;
+};
+
+// Functions are in order of BeginAddress. The last one crosses a page
+// boundary, a long way from the others.
+TestFunction const kTestFunctions[] = {
+  {0x2000, 0x2010, 0x00},     // Handler.
+  {0x2010, 0x2040, 0x20},     // Frame register.
+  {0x2040, 0x2050, 0x40},     // Chained to 0x2010.
+  {0x2050, 0x2060, 0x80 | 1}, // Indirect, shares 0x2000.
+  {0x2060, 0x2070, 0x60},     // Chained to itself.
+  {0x23FF0, 0x24010, 0x20},
+};
+
+std::size_t const kNumTestFunctions =
+  sizeof(kTestFunctions) / sizeof(kTestFunctions[0]);
+
+// PE32+ file with the exception directory at the start of the extra section
+// and the unwind info at kUnwindOffset into it. The code of the functions is
+// never read, so it doesn't matter what is at their RVAs.
+hadesmem::pelib::SyntheticPeBuilder BuildExceptionTestFile(bool reverse)
+{
+  hadesmem::pelib::SyntheticPeOptions options;
+  options.is_64 = true;
+  hadesmem::pelib::SyntheticPeBuilder builder{options, kExceptionSectionSize};
+  DWORD const pdata_rva = builder.GetRva();
+  DWORD const unwind_rva = pdata_rva + kUnwindOffset;
+
+  auto const make_entry = [&](TestFunction const& f)
+  {
+    hadesmem::pelib::ImageRuntimeFunctionEntry const entry = {
+      f.begin, f.end, unwind_rva + f.unwind};
+    return entry;
+  };
+
+  DWORD const entry_size =
+    sizeof(hadesmem::pelib::ImageRuntimeFunctionEntry);
+  for (std::size_t i = 0; i < kNumTestFunctions; ++i)
+  {
+    builder.Write(
+      static_cast<DWORD>(pdata_rva + i * entry_size),
+      make_entry(kTestFunctions[reverse ? kNumTestFunctions - i - 1 : i]));
+  }
+  builder.SetDataDir(
+    hadesmem::PeDataDir::Exception,
+    pdata_rva,
+    static_cast<DWORD>(kNumTestFunctions * entry_size));
+
+  // Version 1, UNW_FLAG_EHANDLER, 2 codes, handler RVA and 4 bytes of handler
+  // data.
+  BYTE const unwind_handler[] = {0x09, 0x04, 0x02, 0x00, 0x04, 0x32,
+                                 0x00, 0x00, 0x00, 0x2F, 0x00, 0x00,
+                                 0xEF, 0xBE, 0xAD, 0xDE};
+  builder.Write(unwind_rva + 0x00, unwind_handler);
+
+  // Version 1, no flags, 1 code (plus a padding slot), frame register 5 with
+  // offset 2.
+  BYTE const unwind_frame[] = {
+    0x01, 0x08, 0x01, 0x25, 0x08, 0x03, 0x00, 0x00};
+  builder.Write(unwind_rva + 0x20, unwind_frame);
+
+  // Version 1, UNW_FLAG_CHAININFO, no codes, chained to the second function.
+  BYTE const unwind_chained[] = {0x21, 0x00, 0x00, 0x00};
+  builder.Write(unwind_rva + 0x40, unwind_chained);
+  builder.Write(unwind_rva + 0x44, make_entry(kTestFunctions[1]));
+
+  // Chained to a function whose unwind info is itself.
+  builder.Write(unwind_rva + 0x60, unwind_chained);
+  builder.Write(unwind_rva + 0x64, make_entry(kTestFunctions[4]));
+
+  // Shared by the indirect function.
+  builder.Write(unwind_rva + 0x80, make_entry(kTestFunctions[0]));
+
+  return builder;
+}
+
+std::size_t FindIndex(hadesmem::RuntimeFunctionList const& list, DWORD rva)
+{
+  hadesmem::RuntimeFunction const* const f = list.Find(rva);
+  return f ? static_cast<std::size_t>(f - &*list.begin()) : kNumTestFunctions;
+}
+}
+
+void TestRuntimeFunctionList()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  for (bool const reverse : {false, true})
+  {
+    hadesmem::pelib::SyntheticPeBuilder const test_file =
+      BuildExceptionTestFile(reverse);
+    DWORD const unwind_rva = test_file.GetRva() + kUnwindOffset;
+    std::vector<std::uint8_t> buf = test_file.Build();
+    hadesmem::PeFile const pe_file(process,
+                                   buf.data(),
+                                   hadesmem::PeFileType::kData,
+                                   static_cast<DWORD>(buf.size()));
+
+    hadesmem::ExceptionDir const exception_dir(process, pe_file);
+    BOOST_TEST_EQ(exception_dir.GetRva(), test_file.GetRva());
+    BOOST_TEST_EQ(exception_dir.GetNumberOfEntries(), kNumTestFunctions);
+
+    hadesmem::RuntimeFunctionList const list(process, pe_file);
+    BOOST_TEST_EQ(list.IsSorted(), !reverse);
+    BOOST_TEST_EQ(list.size(), kNumTestFunctions);
+    std::size_t i = 0;
+    for (auto const& f : list)
+    {
+      BOOST_TEST_EQ(f.GetBeginAddress(), kTestFunctions[i].begin);
+      BOOST_TEST_EQ(f.GetEndAddress(), kTestFunctions[i].end);
+      BOOST_TEST_EQ(f.GetUnwindInfoAddress(),
+                    unwind_rva + kTestFunctions[i].unwind);
+      ++i;
+    }
+
+    BOOST_TEST_EQ(FindIndex(list, 0x2000), 0U);
+    BOOST_TEST_EQ(FindIndex(list, 0x200F), 0U);
+    BOOST_TEST_EQ(FindIndex(list, 0x2010), 1U);
+    BOOST_TEST_EQ(FindIndex(list, 0x206F), 4U);
+    BOOST_TEST_EQ(FindIndex(list, 0x24005), 5U);
+    BOOST_TEST_EQ(FindIndex(list, 0), kNumTestFunctions);
+    BOOST_TEST_EQ(FindIndex(list, 0x1FFF), kNumTestFunctions);
+    BOOST_TEST_EQ(FindIndex(list, 0x2070), kNumTestFunctions);
+    BOOST_TEST_EQ(FindIndex(list, 0x10000), kNumTestFunctions);
+    BOOST_TEST_EQ(FindIndex(list, 0x24010), kNumTestFunctions);
+    BOOST_TEST_EQ(FindIndex(list, 0xFFFFFFFF), kNumTestFunctions);
+
+    // Check the page index against a linear search.
+    for (DWORD rva = 0x1F00; rva < 0x24100; ++rva)
+    {
+      std::size_t expected = kNumTestFunctions;
+      for (std::size_t j = 0; j < kNumTestFunctions; ++j)
+      {
+        if (rva >= kTestFunctions[j].begin && rva < kTestFunctions[j].end)
+        {
+          expected = j;
+        }
+      }
+      BOOST_TEST_EQ(FindIndex(list, rva), expected);
+    }
+
+    hadesmem::UnwindInfo const unwind_handler(
+      process, pe_file, *list.Find(0x2000));
+    BOOST_TEST_EQ(unwind_handler.GetVersion(), 1);
+    BOOST_TEST_EQ(unwind_handler.GetFlags(),
+                  hadesmem::pelib::kUnwFlagEHandler);
+    BOOST_TEST_EQ(unwind_handler.GetSizeOfProlog(), 4);
+    BOOST_TEST_EQ(unwind_handler.GetCountOfCodes(), 2);
+    BOOST_TEST_EQ(unwind_handler.GetUnwindCodes().size(), 2U);
+    BOOST_TEST_EQ(unwind_handler.GetUnwindCodes()[0], 0x3204);
+    BOOST_TEST(unwind_handler.HasExceptionHandler());
+    BOOST_TEST(!unwind_handler.IsChained());
+    BOOST_TEST_EQ(unwind_handler.GetExceptionHandler(), 0x2F00U);
+    BOOST_TEST_EQ(unwind_handler.GetExceptionData(), unwind_rva + 0xCU);
+
+    hadesmem::UnwindInfo const unwind_frame(
+      process, pe_file, *list.Find(0x2010));
+    BOOST_TEST_EQ(unwind_frame.GetFrameRegister(), 5);
+    BOOST_TEST_EQ(unwind_frame.GetFrameOffset(), 2);
+    BOOST_TEST_EQ(unwind_frame.GetUnwindCodes().size(), 1U);
+    BOOST_TEST(!unwind_frame.HasExceptionHandler());
+
+    hadesmem::RuntimeFunction const& chained = *list.Find(0x2048);
+    hadesmem::UnwindInfo const unwind_chained(process, pe_file, chained);
+    BOOST_TEST(unwind_chained.IsChained());
+    BOOST_TEST_EQ(unwind_chained.GetChainedFunction().GetBeginAddress(),
+                  0x2010U);
+    BOOST_TEST_EQ(
+      hadesmem::GetPrimaryRuntimeFunction(process, pe_file, chained)
+        .GetBeginAddress(),
+      0x2010U);
+    BOOST_TEST_EQ(
+      hadesmem::GetPrimaryRuntimeFunction(process, pe_file, *list.Find(0x2000))
+        .GetBeginAddress(),
+      0x2000U);
+
+    hadesmem::RuntimeFunction const& indirect = *list.Find(0x2050);
+    BOOST_TEST(indirect.IsIndirect());
+    hadesmem::UnwindInfo const unwind_indirect(process, pe_file, indirect);
+    BOOST_TEST_EQ(unwind_indirect.GetRva(), unwind_rva);
+    BOOST_TEST(unwind_indirect.HasExceptionHandler());
+
+    BOOST_TEST_THROWS(hadesmem::GetPrimaryRuntimeFunction(
+                        process, pe_file, *list.Find(0x2060)),
+                      hadesmem::Error);
+    BOOST_TEST_THROWS(hadesmem::UnwindInfo(process, pe_file, 0x1FFE),
+                      hadesmem::Error);
+  }
+}
+
+void TestRuntimeFunctionListMalformed()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  hadesmem::pelib::SyntheticPeBuilder test_file =
+    BuildExceptionTestFile(false);
+
+  // A size running past the end of the file (which is the end of the
+  // section) is clamped to the file.
+  test_file.SetDataDir(
+    hadesmem::PeDataDir::Exception, test_file.GetRva(), 0xFFFFFFF0);
+  {
+    std::vector<std::uint8_t> buf = test_file.Build();
+    hadesmem::PeFile const pe_file(process,
+                                   buf.data(),
+                                   hadesmem::PeFileType::kData,
+                                   static_cast<DWORD>(buf.size()));
+    hadesmem::ExceptionDir const exception_dir(process, pe_file);
+    BOOST_TEST_EQ(exception_dir.GetNumberOfEntries(),
+                  kExceptionSectionSize /
+                    sizeof(hadesmem::pelib::ImageRuntimeFunctionEntry));
+    hadesmem::RuntimeFunctionList const list(process, pe_file);
+    BOOST_TEST(!list.IsSorted());
+    BOOST_TEST_EQ(list.Find(0x24005)->GetBeginAddress(), 0x23FF0U);
+  }
+
+  test_file.SetDataDir(hadesmem::PeDataDir::Exception, 0, 0xFFFFFFF0);
+  {
+    std::vector<std::uint8_t> buf = test_file.Build();
+    hadesmem::PeFile const pe_file(process,
+                                   buf.data(),
+                                   hadesmem::PeFileType::kData,
+                                   static_cast<DWORD>(buf.size()));
+    BOOST_TEST_THROWS(hadesmem::ExceptionDir(process, pe_file),
+                      hadesmem::Error);
+  }
+}
+
+#if defined(HADESMEM_DETAIL_ARCH_X64)
+void TestRuntimeFunctionListNative()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+  auto const base = ::GetModuleHandleW(nullptr);
+  hadesmem::PeFile const pe_file(
+    process, base, hadesmem::PeFileType::kImage, 0);
+  hadesmem::RuntimeFunctionList const list(process, pe_file);
+  BOOST_TEST(!list.empty());
+  BOOST_TEST(list.IsSorted());
+
+  for (auto const& f : list)
+  {
+    for (DWORD const rva : {f.GetBeginAddress(), f.GetEndAddress() - 1})
+    {
+      DWORD64 image_base = 0;
+      PRUNTIME_FUNCTION const expected = ::RtlLookupFunctionEntry(
+        reinterpret_cast<DWORD64>(base) + rva, &image_base, nullptr);
+      hadesmem::RuntimeFunction const* const actual = list.Find(rva);
+      BOOST_TEST(expected != nullptr);
+      BOOST_TEST(actual != nullptr);
+      if (expected && actual)
+      {
+        BOOST_TEST_EQ(actual->GetBeginAddress(), expected->BeginAddress);
+      }
+    }
+
+    hadesmem::UnwindInfo const unwind_info(process, pe_file, f);
+    BOOST_TEST(unwind_info.GetVersion() == 1 || unwind_info.GetVersion() == 2);
+  }
+}
+#endif // #if defined(HADESMEM_DETAIL_ARCH_X64)
+
+int main()
+{
+  TestRuntimeFunctionList();
+  TestRuntimeFunctionListMalformed();
+#if defined(HADESMEM_DETAIL_ARCH_X64)
+  TestRuntimeFunctionListNative();
+#endif // #if defined(HADESMEM_DETAIL_ARCH_X64)
+  return boost::report_errors();
+}
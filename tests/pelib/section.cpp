@@ -4,8 +4,10 @@
 #include <hadesmem/pelib/section.hpp>
 #include <hadesmem/pelib/section.hpp>
 
+#include <cstdint>
 #include <sstream>
 #include <utility>
+#include <vector>
 
 #include <hadesmem/detail/warning_disable_prefix.hpp>
 #include <boost/detail/lightweight_test.hpp>
@@ -17,6 +19,7 @@
 #include <hadesmem/module_list.hpp>
 #include <hadesmem/pelib/pe_file.hpp>
 #include <hadesmem/pelib/nt_headers.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
 #include <hadesmem/process.hpp>
 #include <hadesmem/read.hpp>
 
@@ -100,8 +103,38 @@ void TestSection()
   }
 }
 
+void TestSectionUpdateWrite()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  hadesmem::pelib::SyntheticPeOptions options;
+  std::vector<std::uint8_t> buf = hadesmem::pelib::BuildSyntheticPe(options);
+  hadesmem::PeFile const pe_file(process,
+                                 buf.data(),
+                                 hadesmem::PeFileType::kData,
+                                 static_cast<DWORD>(buf.size()));
+
+  hadesmem::Section section(process, pe_file, nullptr);
+  DWORD const rva = section.GetVirtualAddress();
+  void* const va = hadesmem::RvaToVa(process, pe_file, rva);
+  BOOST_TEST_EQ(va,
+                static_cast<void*>(&buf[section.GetPointerToRawData()]));
+
+  // RvaToVa must see the new section table, not the one cached when the
+  // PeFile was created.
+  section.SetVirtualAddress(rva + 0x1000);
+  section.UpdateWrite();
+  BOOST_TEST_EQ(hadesmem::RvaToVa(process, pe_file, rva),
+                static_cast<void*>(nullptr));
+  BOOST_TEST_EQ(hadesmem::RvaToVa(process, pe_file, rva + 0x1000), va);
+  BOOST_TEST_EQ(hadesmem::FileOffsetToRva(
+                  process, pe_file, section.GetPointerToRawData()),
+                rva + 0x1000);
+}
+
 int main()
 {
   TestSection();
+  TestSectionUpdateWrite();
   return boost::report_errors();
 }
@@ -0,0 +1,267 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/view/section_index.hpp>
+#include <hadesmem/pelib/view/section_index.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+
+namespace
+{
+std::uint32_t const kInvalidIndex =
+  hadesmem::pelib::SectionIndex::kInvalidIndex;
+
+hadesmem::pelib::ImageSectionHeader MakeSection(std::uint32_t virtual_address,
+                                                std::uint32_t virtual_size,
+                                                std::uint32_t raw_ptr,
+                                                std::uint32_t raw_size)
+{
+  hadesmem::pelib::ImageSectionHeader section{};
+  section.VirtualAddress = virtual_address;
+  section.VirtualSize = virtual_size;
+  section.PointerToRawData = raw_ptr;
+  section.SizeOfRawData = raw_size;
+  section.Characteristics = virtual_address;
+  return section;
+}
+
+// Overlapping (in both layouts), zero VirtualSize, empty and wrapping
+// sections, which a linear scan handles by taking the first match.
+std::vector<hadesmem::pelib::ImageSectionHeader> GetTestSections()
+{
+  return std::vector<hadesmem::pelib::ImageSectionHeader>{
+    MakeSection(0x1000, 0x800, 0x400, 0x800),
+    MakeSection(0x1400, 0x1000, 0xA00, 0x200),
+    MakeSection(0x3000, 0, 0x1000, 0x300),
+    MakeSection(0x3100, 0x100, 0x1000, 0x100),
+    MakeSection(0x4000, 0, 0x2000, 0),
+    MakeSection(0xFFFFF000, 0x2000, 0xFFFFFF00, 0x200),
+    MakeSection(0x5000, 0x1000, 0x1200, 0x400)};
+}
+
+std::uint32_t FindLinear(
+  std::vector<hadesmem::pelib::ImageSectionHeader> const& sections,
+  std::uint32_t pos,
+  bool raw)
+{
+  for (std::uint32_t i = 0; i < sections.size(); ++i)
+  {
+    auto const& s = sections[i];
+    std::uint32_t const beg = raw ? s.PointerToRawData : s.VirtualAddress;
+    std::uint32_t const size =
+      raw ? s.SizeOfRawData
+          : (s.VirtualSize ? s.VirtualSize : s.SizeOfRawData);
+    std::uint32_t const end = beg + size;
+    if (beg < end && pos >= beg && pos < end)
+    {
+      return i;
+    }
+  }
+
+  return kInvalidIndex;
+}
+
+std::vector<std::uint32_t> FindRangeLinear(
+  std::vector<hadesmem::pelib::ImageSectionHeader> const& sections,
+  std::uint32_t beg,
+  std::uint32_t end,
+  bool raw)
+{
+  std::set<std::uint32_t> indices;
+  for (std::uint32_t pos = beg; pos < end; ++pos)
+  {
+    std::uint32_t const index = FindLinear(sections, pos, raw);
+    if (index != kInvalidIndex)
+    {
+      indices.insert(index);
+    }
+  }
+
+  return std::vector<std::uint32_t>(std::begin(indices), std::end(indices));
+}
+
+// Every section boundary, plus either side of it.
+std::vector<std::uint32_t> GetTestPositions(
+  std::vector<hadesmem::pelib::ImageSectionHeader> const& sections)
+{
+  std::vector<std::uint32_t> positions{0, 1, 0xFFFFFFFF};
+  for (auto const& s : sections)
+  {
+    for (std::uint32_t const p : {s.VirtualAddress,
+                                  s.VirtualAddress + s.VirtualSize,
+                                  s.VirtualAddress + s.SizeOfRawData,
+                                  s.PointerToRawData,
+                                  s.PointerToRawData + s.SizeOfRawData})
+    {
+      positions.push_back(p - 1);
+      positions.push_back(p);
+      positions.push_back(p + 1);
+    }
+  }
+
+  return positions;
+}
+
+void TestSectionIndexPoint()
+{
+  auto const sections = GetTestSections();
+  hadesmem::pelib::SectionIndex const index{sections};
+  BOOST_TEST_EQ(index.GetNumberOfSections(), sections.size());
+  BOOST_TEST(index.HasVirtualOverlaps());
+  BOOST_TEST(index.HasRawOverlaps());
+
+  for (std::uint32_t i = 0; i < sections.size(); ++i)
+  {
+    auto const& entry = index.GetEntry(i);
+    BOOST_TEST_EQ(entry.virtual_address, sections[i].VirtualAddress);
+    BOOST_TEST_EQ(entry.pointer_to_raw_data, sections[i].PointerToRawData);
+    BOOST_TEST_EQ(entry.size_of_raw_data, sections[i].SizeOfRawData);
+    BOOST_TEST_EQ(entry.characteristics, sections[i].Characteristics);
+  }
+  BOOST_TEST_EQ(index.GetEntry(2).virtual_size, 0x300UL);
+  BOOST_TEST_EQ(index.GetEntry(2).GetVirtualEnd(), 0x3300UL);
+
+  for (std::uint32_t const pos : GetTestPositions(sections))
+  {
+    BOOST_TEST_EQ(index.FindRva(pos), FindLinear(sections, pos, false));
+    BOOST_TEST_EQ(index.FindFileOffset(pos), FindLinear(sections, pos, true));
+  }
+
+  BOOST_TEST_EQ(index.FindRva(0x1500), 0UL);
+  BOOST_TEST_EQ(index.FindRva(0x1900), 1UL);
+  BOOST_TEST_EQ(index.FindRva(0x3150), 2UL);
+  BOOST_TEST_EQ(index.FindRva(0x3350), kInvalidIndex);
+  BOOST_TEST_EQ(index.FindRva(0xFFFFF800), kInvalidIndex);
+  BOOST_TEST_EQ(index.FindFileOffset(0x1050), 2UL);
+
+  hadesmem::pelib::SectionIndex const empty;
+  BOOST_TEST_EQ(empty.GetNumberOfSections(), 0UL);
+  BOOST_TEST_EQ(empty.FindRva(0x1000), kInvalidIndex);
+  BOOST_TEST(empty.FindRvaRange(0, 0xFFFFFFFF).empty());
+  BOOST_TEST(!empty.HasVirtualOverlaps());
+}
+
+void TestSectionIndexRange()
+{
+  auto const sections = GetTestSections();
+  hadesmem::pelib::SectionIndex const index{sections};
+
+  auto const positions = GetTestPositions(sections);
+  for (std::uint32_t const beg : positions)
+  {
+    for (std::uint32_t const end : positions)
+    {
+      // Brute force is linear in the size of the range.
+      if (end > beg && end - beg > 0x2000)
+      {
+        continue;
+      }
+
+      BOOST_TEST(index.FindRvaRange(beg, end) ==
+                 FindRangeLinear(sections, beg, end, false));
+      BOOST_TEST(index.FindFileOffsetRange(beg, end) ==
+                 FindRangeLinear(sections, beg, end, true));
+    }
+  }
+
+  BOOST_TEST(index.FindRvaRange(0, 0xFFFFFFFF) ==
+             (std::vector<std::uint32_t>{0, 1, 2, 6}));
+  BOOST_TEST(index.FindRvaRange(0x1800, 0x3100) ==
+             (std::vector<std::uint32_t>{1, 2}));
+  BOOST_TEST(index.FindRvaRange(0x3000, 0x3000).empty());
+  BOOST_TEST(index.FindRvaRange(0x3100, 0x3000).empty());
+}
+
+void TestSectionIndexBatch()
+{
+  auto const sections = GetTestSections();
+  hadesmem::pelib::SectionIndex const index{sections};
+
+  // Both in order (so most lookups hit the previous section) and not.
+  auto positions = GetTestPositions(sections);
+  auto sorted = positions;
+  std::sort(std::begin(sorted), std::end(sorted));
+  positions.insert(std::end(positions), std::begin(sorted), std::end(sorted));
+
+  std::vector<std::uint32_t> indices(positions.size());
+  index.FindRvas(positions.data(), positions.size(), indices.data());
+  for (std::size_t i = 0; i < positions.size(); ++i)
+  {
+    BOOST_TEST_EQ(indices[i], index.FindRva(positions[i]));
+  }
+
+  index.FindFileOffsets(positions.data(), positions.size(), indices.data());
+  for (std::size_t i = 0; i < positions.size(); ++i)
+  {
+    BOOST_TEST_EQ(indices[i], index.FindFileOffset(positions[i]));
+  }
+}
+
+void TestSectionIndexView(bool is_64)
+{
+  hadesmem::pelib::SyntheticPeOptions options;
+  options.is_64 = is_64;
+  options.num_extra_sections = 4;
+  options.num_exports = 10;
+  options.num_import_modules = 2;
+  options.num_imports_per_module = 3;
+  auto const file = hadesmem::pelib::BuildSyntheticPe(options);
+  hadesmem::pelib::PeView const view{
+    hadesmem::pelib::BufferSource{file.data(), file.size()},
+    hadesmem::PeFileType::kData};
+
+  auto const& index = view.GetSectionIndex();
+  BOOST_TEST_EQ(index.GetNumberOfSections(), view.GetSections().size());
+  BOOST_TEST(!index.HasVirtualOverlaps());
+
+  std::vector<std::uint32_t> rvas;
+  for (std::uint32_t rva = 0; rva < view.GetSizeOfImage() + 0x1000;
+       rva += 0x10)
+  {
+    rvas.push_back(rva);
+  }
+
+  std::vector<std::size_t> offsets(rvas.size());
+  view.RvasToOffsets(rvas.data(), rvas.size(), offsets.data());
+  std::size_t const invalid = hadesmem::pelib::PeHeaders::kInvalidOffset;
+  std::size_t num_valid = 0;
+  for (std::size_t i = 0; i < rvas.size(); ++i)
+  {
+    BOOST_TEST_EQ(offsets[i], view.RvaToOffset(rvas[i]));
+    num_valid += offsets[i] != invalid;
+  }
+  BOOST_TEST(num_valid > 0);
+
+  for (std::uint32_t i = 0; i < view.GetSections().size(); ++i)
+  {
+    auto const& section = view.GetSections()[i];
+    BOOST_TEST_EQ(index.FindRva(section.VirtualAddress), i);
+    BOOST_TEST_EQ(index.FindFileOffset(section.PointerToRawData), i);
+  }
+}
+}
+
+int main()
+{
+  TestSectionIndexPoint();
+  TestSectionIndexRange();
+  TestSectionIndexBatch();
+  TestSectionIndexView(false);
+  TestSectionIndexView(true);
+  return boost::report_errors();
+}
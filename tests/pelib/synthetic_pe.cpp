@@ -0,0 +1,292 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+#include <hadesmem/pelib/view/synthetic_pe.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/pelib/pe_types.hpp>
+#include <hadesmem/pelib/view/base_relocation_table.hpp>
+#include <hadesmem/pelib/view/buffer_source.hpp>
+#include <hadesmem/pelib/view/image_mapper.hpp>
+#include <hadesmem/pelib/view/pe_format.hpp>
+#include <hadesmem/pelib/view/pe_headers.hpp>
+#include <hadesmem/pelib/view/pe_view.hpp>
+
+namespace
+{
+std::uint64_t ReadPtr(hadesmem::pelib::PeView const& view, std::uint32_t rva)
+{
+  return view.Is64() ? view.ReadRva<std::uint64_t>(rva)
+                     : view.ReadRva<std::uint32_t>(rva);
+}
+
+// Parses a generated file and checks that everything the options asked for
+// is there.
+void CheckSyntheticPe(hadesmem::pelib::SyntheticPeOptions const& options,
+                      std::uint32_t expected_anomalies)
+{
+  std::vector<std::uint8_t> const file =
+    hadesmem::pelib::BuildSyntheticPe(options);
+  hadesmem::pelib::BufferSource const source{file.data(), file.size()};
+  auto const parsed =
+    hadesmem::pelib::PeView::TryParse(source, hadesmem::PeFileType::kData);
+  BOOST_TEST(parsed.HasValue());
+  if (!parsed)
+  {
+    return;
+  }
+
+  hadesmem::pelib::PeView const& view = *parsed;
+  std::uint32_t const ptr_size = options.is_64 ? 8 : 4;
+  BOOST_TEST_EQ(view.Is64(), options.is_64);
+  BOOST_TEST_EQ(view.GetAnomalies(), expected_anomalies);
+
+  std::uint32_t const entry_point = view.GetAddressOfEntryPoint();
+  BOOST_TEST_EQ(view.ReadRva<std::uint8_t>(entry_point), 0xC3);
+
+  bool const eof_string =
+    !!(options.flags &
+       hadesmem::pelib::SyntheticPeFlags::kEofTerminatedString);
+  auto const export_dir = view.GetDataDir(hadesmem::PeDataDir::Export);
+  BOOST_TEST_EQ(!!export_dir.VirtualAddress,
+                options.num_exports || eof_string);
+  if (export_dir.VirtualAddress)
+  {
+    auto const dir = view.ReadRva<hadesmem::pelib::ImageExportDirectory>(
+      export_dir.VirtualAddress);
+    BOOST_TEST_EQ(view.ReadStringRva<char>(dir.Name),
+                  hadesmem::pelib::GetSyntheticModuleName());
+    if (eof_string)
+    {
+      BOOST_TEST_EQ(view.RvaToOffset(dir.Name) +
+                      hadesmem::pelib::GetSyntheticModuleName().size(),
+                    file.size());
+      BOOST_TEST(file.back() != 0);
+    }
+
+    BOOST_TEST_EQ(dir.NumberOfNames, options.num_exports);
+
+    // The (empty) tables are at the end of the directory if there are no
+    // exports, so they can't be read.
+    if (dir.NumberOfNames)
+    {
+      auto const functions = view.ReadVectorRva<std::uint32_t>(
+        dir.AddressOfFunctions, dir.NumberOfFunctions);
+      auto const names = view.ReadVectorRva<std::uint32_t>(
+        dir.AddressOfNames, dir.NumberOfNames);
+      auto const ordinals = view.ReadVectorRva<std::uint16_t>(
+        dir.AddressOfNameOrdinals, dir.NumberOfNames);
+      for (std::uint32_t i = 0; i < dir.NumberOfNames; ++i)
+      {
+        BOOST_TEST_EQ(view.ReadStringRva<char>(names[i]),
+                      hadesmem::pelib::GetSyntheticExportName(i));
+        BOOST_TEST_EQ(ordinals[i], i);
+        BOOST_TEST_EQ(view.ReadRva<std::uint8_t>(functions[ordinals[i]]),
+                      0xC3);
+      }
+    }
+  }
+
+  auto const import_dir = view.GetDataDir(hadesmem::PeDataDir::Import);
+  std::uint32_t num_modules = 0;
+  for (std::uint32_t rva = import_dir.VirtualAddress; rva;
+       rva += sizeof(hadesmem::pelib::ImageImportDescriptor))
+  {
+    auto const desc =
+      view.ReadRva<hadesmem::pelib::ImageImportDescriptor>(rva);
+    if (!desc.FirstThunk)
+    {
+      break;
+    }
+
+    BOOST_TEST_EQ(view.ReadStringRva<char>(desc.Name),
+                  hadesmem::pelib::GetSyntheticImportModuleName(num_modules));
+    std::uint32_t num_imports = 0;
+    for (std::uint64_t thunk = ReadPtr(view, desc.OriginalFirstThunk); thunk;
+         thunk = ReadPtr(view,
+                         desc.OriginalFirstThunk + ++num_imports * ptr_size))
+    {
+      BOOST_TEST_EQ(ReadPtr(view, desc.FirstThunk + num_imports * ptr_size),
+                    thunk);
+      auto const thunk_rva = static_cast<std::uint32_t>(thunk);
+      BOOST_TEST_EQ(view.ReadRva<std::uint16_t>(thunk_rva), num_imports);
+      BOOST_TEST_EQ(
+        view.ReadStringRva<char>(thunk_rva + sizeof(std::uint16_t)),
+        hadesmem::pelib::GetSyntheticImportName(num_imports));
+    }
+    BOOST_TEST_EQ(num_imports, options.num_imports_per_module);
+    ++num_modules;
+  }
+  BOOST_TEST_EQ(num_modules, options.num_import_modules);
+
+  auto const tls_dir = view.GetDataDir(hadesmem::PeDataDir::TLS);
+  BOOST_TEST_EQ(!!tls_dir.VirtualAddress, !!options.num_tls_callbacks);
+  if (tls_dir.VirtualAddress)
+  {
+    std::uint64_t const callbacks_va =
+      options.is_64
+        ? view.ReadRva<hadesmem::pelib::ImageTlsDirectory64>(
+                tls_dir.VirtualAddress)
+            .AddressOfCallBacks
+        : view.ReadRva<hadesmem::pelib::ImageTlsDirectory32>(
+                tls_dir.VirtualAddress)
+            .AddressOfCallBacks;
+    auto const callbacks_rva =
+      static_cast<std::uint32_t>(callbacks_va - view.GetImageBase());
+    std::uint32_t num_callbacks = 0;
+    for (std::uint64_t callback = ReadPtr(view, callbacks_rva); callback;
+         callback =
+           ReadPtr(view, callbacks_rva + ++num_callbacks * ptr_size))
+    {
+      BOOST_TEST_EQ(view.ReadRva<std::uint8_t>(static_cast<std::uint32_t>(
+                      callback - view.GetImageBase())),
+                    0xC3);
+    }
+    BOOST_TEST_EQ(num_callbacks, options.num_tls_callbacks);
+  }
+
+  hadesmem::pelib::BaseRelocationTable const relocs{view};
+  BOOST_TEST_EQ(relocs.size(), options.num_relocations);
+
+  // Every relocated pointer points at the entry point, wherever the image is
+  // mapped.
+  if (options.num_relocations)
+  {
+    std::uint64_t const base = view.GetImageBase() + 0x10000000;
+    std::vector<std::uint8_t> const image =
+      hadesmem::pelib::MapImage(view, base);
+    for (std::uint32_t rva : relocs.GetRvas())
+    {
+      std::uint64_t ptr = 0;
+      std::memcpy(&ptr, &image[rva], ptr_size);
+      BOOST_TEST_EQ(ptr, base + entry_point);
+    }
+  }
+}
+}
+
+void TestSyntheticPeDefault()
+{
+  hadesmem::pelib::SyntheticPeOptions options;
+  CheckSyntheticPe(options, hadesmem::pelib::PeAnomalies::kNone);
+  options.is_64 = true;
+  CheckSyntheticPe(options, hadesmem::pelib::PeAnomalies::kNone);
+
+  hadesmem::pelib::PeView const view{
+    hadesmem::pelib::BufferSource{hadesmem::pelib::BuildSyntheticPe(options)},
+    hadesmem::PeFileType::kData};
+  BOOST_TEST_EQ(view.GetNumberOfSections(), 1);
+  BOOST_TEST(view.GetFileHeader().Characteristics &
+             hadesmem::pelib::kImageFileRelocsStripped);
+}
+
+void TestSyntheticPeFull()
+{
+  hadesmem::pelib::SyntheticPeOptions options;
+  options.num_extra_sections = 3;
+  options.num_exports = 300;
+  options.num_import_modules = 4;
+  options.num_imports_per_module = 25;
+  // Enough to span several pages.
+  options.num_relocations = 2000;
+  options.num_tls_callbacks = 3;
+  for (bool is_64 : {false, true})
+  {
+    options.is_64 = is_64;
+    CheckSyntheticPe(options, hadesmem::pelib::PeAnomalies::kNone);
+
+    hadesmem::pelib::PeView const view{
+      hadesmem::pelib::BufferSource{hadesmem::pelib::BuildSyntheticPe(options)},
+      hadesmem::PeFileType::kData};
+    BOOST_TEST_EQ(view.GetNumberOfSections(), 7);
+    BOOST_TEST_EQ(view.GetSectionAlignment(), 0x1000UL);
+    BOOST_TEST_EQ(view.GetFileAlignment(), 0x200UL);
+  }
+}
+
+void TestSyntheticPeTricky()
+{
+  hadesmem::pelib::SyntheticPeOptions options;
+  options.num_extra_sections = 2;
+  options.num_exports = 50;
+  options.num_import_modules = 2;
+  options.num_imports_per_module = 10;
+  options.num_relocations = 100;
+  options.num_tls_callbacks = 2;
+  for (bool is_64 : {false, true})
+  {
+    options.is_64 = is_64;
+
+    options.flags = hadesmem::pelib::SyntheticPeFlags::kNoSections;
+    CheckSyntheticPe(options,
+                     hadesmem::pelib::PeAnomalies::kNoSections |
+                       hadesmem::pelib::PeAnomalies::kLowAlignment);
+
+    options.flags = hadesmem::pelib::SyntheticPeFlags::kVirtualSectionTable;
+    CheckSyntheticPe(
+      options,
+      hadesmem::pelib::PeAnomalies::kNonStandardOptionalHeaderSize |
+        hadesmem::pelib::PeAnomalies::kVirtualSectionTable |
+        hadesmem::pelib::PeAnomalies::kLowAlignment);
+    hadesmem::pelib::PeView const view{
+      hadesmem::pelib::BufferSource{hadesmem::pelib::BuildSyntheticPe(options)},
+      hadesmem::PeFileType::kData};
+    BOOST_TEST(view.HasVirtualSectionTable());
+    BOOST_TEST_EQ(view.GetNumberOfSections(), 6);
+    BOOST_TEST(view.GetSections().empty());
+
+    options.flags = hadesmem::pelib::SyntheticPeFlags::kEofTerminatedString;
+    CheckSyntheticPe(options, hadesmem::pelib::PeAnomalies::kNone);
+
+    options.flags = hadesmem::pelib::SyntheticPeFlags::kNoSections |
+                    hadesmem::pelib::SyntheticPeFlags::kEofTerminatedString;
+    CheckSyntheticPe(options,
+                     hadesmem::pelib::PeAnomalies::kNoSections |
+                       hadesmem::pelib::PeAnomalies::kLowAlignment);
+  }
+
+  // An export directory with no exports, just the unterminated name.
+  options = hadesmem::pelib::SyntheticPeOptions{};
+  options.flags = hadesmem::pelib::SyntheticPeFlags::kEofTerminatedString;
+  CheckSyntheticPe(options, hadesmem::pelib::PeAnomalies::kNone);
+}
+
+void TestSyntheticPeInvalid()
+{
+  hadesmem::pelib::SyntheticPeOptions options;
+  options.num_exports = 0x10000;
+  BOOST_TEST_THROWS(hadesmem::pelib::BuildSyntheticPe(options),
+                    hadesmem::Error);
+
+  // SizeOfOptionalHeader can't reach past 64K.
+  options.num_exports = 0x8000;
+  options.flags = hadesmem::pelib::SyntheticPeFlags::kVirtualSectionTable;
+  BOOST_TEST_THROWS(hadesmem::pelib::BuildSyntheticPe(options),
+                    hadesmem::Error);
+
+  options = hadesmem::pelib::SyntheticPeOptions{};
+  options.flags = hadesmem::pelib::SyntheticPeFlags::kInvalidFlagMaxValue;
+  BOOST_TEST_THROWS(hadesmem::pelib::BuildSyntheticPe(options),
+                    hadesmem::Error);
+}
+
+int main()
+{
+  TestSyntheticPeDefault();
+  TestSyntheticPeFull();
+  TestSyntheticPeTricky();
+  TestSyntheticPeInvalid();
+  return boost::report_errors();
+}
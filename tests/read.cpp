@@ -4,7 +4,9 @@
 #include <hadesmem/read.hpp>
 #include <hadesmem/read.hpp>
 
+#include <algorithm>
 #include <array>
+#include <cstdint>
 #include <cstring>
 #include <string>
 #include <vector>
@@ -14,10 +16,14 @@
 #include <hadesmem/detail/warning_disable_suffix.hpp>
 
 #include <hadesmem/alloc.hpp>
+#include <hadesmem/cached_process.hpp>
 #include <hadesmem/config.hpp>
 #include <hadesmem/detail/winapi.hpp>
 #include <hadesmem/error.hpp>
 #include <hadesmem/process.hpp>
+#include <hadesmem/read_batch.hpp>
+#include <hadesmem/read_view.hpp>
+#include <hadesmem/write.hpp>
 
 // TODO: Run tests against known data (e.g. Read tests should be done against
 // a memory mapped file with known values).
@@ -157,11 +163,124 @@ void TestReadCrossRegion()
   BOOST_TEST(buf == zero_buf);
 }
 
+void TestReadBatch()
+{
+  SYSTEM_INFO const sys_info = hadesmem::detail::GetSystemInfo();
+  DWORD const page_size = sys_info.dwPageSize;
+
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  std::vector<int> int_list(page_size);
+  for (std::size_t i = 0; i < int_list.size(); ++i)
+  {
+    int_list[i] = static_cast<int>(i);
+  }
+
+  PVOID const reserved_page =
+    VirtualAlloc(nullptr, page_size, MEM_RESERVE, PAGE_READWRITE);
+  BOOST_TEST(reserved_page != nullptr);
+
+  std::vector<int> int_list_read(int_list.size() / 3);
+  int reserved_read = 0;
+  std::vector<hadesmem::ReadBatchRequest> requests;
+  for (std::size_t i = int_list_read.size(); i--;)
+  {
+    requests.push_back(
+      hadesmem::MakeReadBatchRequest(&int_list[i * 3], int_list_read[i]));
+  }
+  requests.push_back(
+    hadesmem::MakeReadBatchRequest(reserved_page, reserved_read));
+  requests.push_back(hadesmem::ReadBatchRequest{nullptr, nullptr, 0, false});
+
+  BOOST_TEST_EQ(hadesmem::ReadBatch(process, requests), std::size_t{1});
+  for (std::size_t i = 0; i < int_list_read.size(); ++i)
+  {
+    BOOST_TEST_EQ(int_list_read[i], int_list[i * 3]);
+  }
+  BOOST_TEST(!requests[requests.size() - 2].succeeded);
+  BOOST_TEST(requests.back().succeeded);
+}
+
+void TestReadView()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  std::vector<std::uint32_t> data(0x400);
+  for (std::size_t i = 0; i < data.size(); ++i)
+  {
+    data[i] = static_cast<std::uint32_t>(i * 3);
+  }
+  std::size_t const data_len = data.size() * sizeof(std::uint32_t);
+
+  // Local reads are direct, and carry their bounds.
+  hadesmem::ReadView const view =
+    hadesmem::MakeReadView(process, data.data(), data_len);
+  BOOST_TEST(view.IsDirect());
+  BOOST_TEST_EQ(view.GetData(), static_cast<void const*>(data.data()));
+  BOOST_TEST_EQ(view.GetSize(), data_len);
+  BOOST_TEST_EQ(view.Get<std::uint32_t>(sizeof(std::uint32_t) * 5), 15UL);
+  BOOST_TEST_EQ(*view.As<std::uint32_t>(sizeof(std::uint32_t) * 7), 21UL);
+  BOOST_TEST_THROWS(view.As<std::uint32_t>(data_len - 2), hadesmem::Error);
+  BOOST_TEST_THROWS(view.SubView(data_len, 1), hadesmem::Error);
+  hadesmem::ReadView const sub_view = view.SubView(sizeof(std::uint32_t), 8);
+  BOOST_TEST_EQ(sub_view.GetSize(), 8UL);
+  BOOST_TEST_EQ(sub_view.Get<std::uint32_t>(), 3UL);
+  BOOST_TEST_EQ(sub_view.GetAddress(),
+                static_cast<void*>(data.data() + 1));
+
+  hadesmem::ReadView const view_assume = hadesmem::MakeReadView(
+    process, data.data(), data_len, hadesmem::ReadViewFlags::kAssumeReadable);
+  BOOST_TEST(view_assume.IsDirect());
+  BOOST_TEST(std::equal(view_assume.begin(),
+                        view_assume.end(),
+                        reinterpret_cast<std::uint8_t const*>(data.data())));
+
+  hadesmem::ReadView const view_empty =
+    hadesmem::MakeReadView(process, data.data(), 0);
+  BOOST_TEST(view_empty.IsEmpty());
+  BOOST_TEST(view_empty.begin() == view_empty.end());
+
+  // Local memory which isn't directly readable falls back to a copy.
+  hadesmem::Allocator const allocator(process, 0x1000);
+  auto const alloc_base = static_cast<std::uint32_t*>(allocator.GetBase());
+  *alloc_base = 0xDEADBEEF;
+  DWORD old_protect = 0;
+  BOOST_TEST(
+    ::VirtualProtect(alloc_base, 0x1000, PAGE_NOACCESS, &old_protect) != 0);
+  hadesmem::ReadView const view_noaccess =
+    hadesmem::MakeReadView(process, alloc_base, sizeof(std::uint32_t));
+  BOOST_TEST(!view_noaccess.IsDirect());
+  BOOST_TEST_EQ(view_noaccess.Get<std::uint32_t>(), 0xDEADBEEFUL);
+  hadesmem::ReadView view_copy{view_noaccess};
+  BOOST_TEST(view_copy.GetData() != view_noaccess.GetData());
+  BOOST_TEST_EQ(view_copy.Get<std::uint32_t>(), 0xDEADBEEFUL);
+  BOOST_TEST(
+    ::VirtualProtect(alloc_base, 0x1000, old_protect, &old_protect) != 0);
+
+  // Cached processes hand out pinned pages, which stay valid (and unchanged)
+  // after invalidation.
+  hadesmem::CachedProcess cached_process(::GetCurrentProcessId());
+  hadesmem::ReadView const view_cached =
+    hadesmem::MakeReadView(cached_process, alloc_base, sizeof(std::uint32_t));
+  BOOST_TEST(view_cached.IsDirect());
+  BOOST_TEST(view_cached.GetData() != static_cast<void const*>(alloc_base));
+  BOOST_TEST_EQ(view_cached.Get<std::uint32_t>(), 0xDEADBEEFUL);
+  hadesmem::Write<std::uint32_t>(cached_process, alloc_base, 0xCAFEBABE);
+  BOOST_TEST_EQ(cached_process.GetCachedPageCount(), 0UL);
+  BOOST_TEST_EQ(view_cached.Get<std::uint32_t>(), 0xDEADBEEFUL);
+  BOOST_TEST_EQ(hadesmem::MakeReadView(
+                  cached_process, alloc_base, sizeof(std::uint32_t))
+                  .Get<std::uint32_t>(),
+                0xCAFEBABEUL);
+}
+
 int main()
 {
   TestReadPod();
   TestReadString();
   TestReadVector();
   TestReadCrossRegion();
+  TestReadBatch();
+  TestReadView();
   return boost::report_errors();
 }
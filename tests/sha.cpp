@@ -0,0 +1,140 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/detail/sha.hpp>
+#include <hadesmem/detail/sha.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/crypto.hpp>
+
+namespace
+{
+struct ShaTestVector
+{
+  std::string input;
+  wchar_t const* sha1;
+  wchar_t const* sha256;
+};
+
+// FIPS 180-4 examples, plus lengths either side of the padding boundary.
+std::vector<ShaTestVector> GetShaTestVectors()
+{
+  return std::vector<ShaTestVector>{
+    {"",
+     L"da39a3ee5e6b4b0d3255bfef95601890afd80709",
+     L"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+    {"abc",
+     L"a9993e364706816aba3e25717850c26c9cd0d89d",
+     L"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+     L"84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+     L"248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+    {std::string(1000000, 'a'),
+     L"34aa973cd4c4daa4f61eeb2bdbad27316534016f",
+     L"cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"}};
+}
+
+template <typename Hasher>
+typename Hasher::Digest HashChunked(std::string const& input,
+                                    std::size_t chunk_size)
+{
+  Hasher hasher;
+  for (std::size_t i = 0; i < input.size(); i += chunk_size)
+  {
+    hasher.Update(input.data() + i, (std::min)(chunk_size, input.size() - i));
+  }
+  return hasher.Finalize();
+}
+
+template <typename Hasher>
+void TestShaVector(std::string const& input, wchar_t const* expected)
+{
+  BOOST_TEST(hadesmem::detail::ByteArrayToString(
+               Hasher::Hash(input.data(), input.size())) == expected);
+
+  // Chunk sizes which never line up with the block size, to exercise the
+  // buffering of partial blocks.
+  for (std::size_t chunk_size : {1, 3, 63, 64, 65, 1000})
+  {
+    if (input.size() / chunk_size < 100000)
+    {
+      BOOST_TEST(hadesmem::detail::ByteArrayToString(
+                   HashChunked<Hasher>(input, chunk_size)) == expected);
+    }
+  }
+}
+
+// The hardware path is only used if supported, so make sure it gives the
+// same result as the scalar one (which the vectors above cover otherwise).
+template <typename Traits> void TestShaCompress()
+{
+  std::vector<std::uint8_t> blocks(64 * 17);
+  for (std::size_t i = 0; i < blocks.size(); ++i)
+  {
+    blocks[i] = static_cast<std::uint8_t>(i * 7 + (i >> 8));
+  }
+
+  auto state_scalar = Traits::GetInitialState();
+  Traits::CompressScalar(state_scalar, blocks.data(), 17);
+
+#if defined(HADESMEM_DETAIL_SHA_NI)
+  if (hadesmem::detail::IsShaNiSupported())
+  {
+    auto state_sha_ni = Traits::GetInitialState();
+    Traits::CompressShaNi(state_sha_ni, blocks.data(), 1);
+    Traits::CompressShaNi(state_sha_ni, blocks.data() + 64, 16);
+    BOOST_TEST(state_scalar == state_sha_ni);
+  }
+#endif // #if defined(HADESMEM_DETAIL_SHA_NI)
+}
+}
+
+void TestSha1()
+{
+  for (auto const& v : GetShaTestVectors())
+  {
+    TestShaVector<hadesmem::detail::Sha1>(v.input, v.sha1);
+  }
+
+  TestShaCompress<hadesmem::detail::Sha1Traits>();
+
+  std::string abc{"abc"};
+  BOOST_TEST(hadesmem::detail::ByteArrayToString(hadesmem::detail::GetSha1Hash(
+               &abc[0], static_cast<std::uint32_t>(abc.size()))) ==
+             L"a9993e364706816aba3e25717850c26c9cd0d89d");
+}
+
+void TestSha256()
+{
+  for (auto const& v : GetShaTestVectors())
+  {
+    TestShaVector<hadesmem::detail::Sha256>(v.input, v.sha256);
+  }
+
+  TestShaCompress<hadesmem::detail::Sha256Traits>();
+
+  // Finalize resets the hasher, so it can be reused.
+  hadesmem::detail::Sha256 hasher;
+  hasher.Update("xyz", 3);
+  hasher.Finalize();
+  hasher.Update("abc", 3);
+  BOOST_TEST(
+    hadesmem::detail::ByteArrayToString(hasher.Finalize()) ==
+    L"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+}
+
+int main()
+{
+  TestSha1();
+  TestSha256();
+  return boost::report_errors();
+}
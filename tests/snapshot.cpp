@@ -0,0 +1,143 @@
+// Copyright (C) 2010-2015 Joshua Boyce
+// See the file COPYING for copying permission.
+
+#include <hadesmem/snapshot.hpp>
+#include <hadesmem/snapshot.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <hadesmem/detail/warning_disable_prefix.hpp>
+#include <boost/detail/lightweight_test.hpp>
+#include <hadesmem/detail/warning_disable_suffix.hpp>
+
+#include <hadesmem/alloc.hpp>
+#include <hadesmem/config.hpp>
+#include <hadesmem/detail/xxhash.hpp>
+#include <hadesmem/error.hpp>
+#include <hadesmem/process.hpp>
+
+void TestXxHash64()
+{
+  // Reference values from the xxHash test suite.
+  BOOST_TEST_EQ(hadesmem::detail::XxHash64("", 0), 0xEF46DB3751D8E999ULL);
+  BOOST_TEST_EQ(hadesmem::detail::XxHash64("abc", 3), 0x44BC2CF5AD770999ULL);
+}
+
+std::vector<hadesmem::SnapshotDiffRun>
+  FilterRuns(std::vector<hadesmem::SnapshotDiffRun> const& runs,
+             void const* base,
+             std::size_t len)
+{
+  auto const beg = reinterpret_cast<std::uintptr_t>(base);
+  std::vector<hadesmem::SnapshotDiffRun> filtered;
+  std::copy_if(std::begin(runs),
+               std::end(runs),
+               std::back_inserter(filtered),
+               [&](hadesmem::SnapshotDiffRun const& run) {
+                 return run.address >= beg && run.address < beg + len;
+               });
+  return filtered;
+}
+
+void TestSnapshot()
+{
+  hadesmem::Process const process(::GetCurrentProcessId());
+
+  std::size_t const alloc_len = 0x3000;
+  hadesmem::Allocator const allocator(process, alloc_len);
+  auto const base = static_cast<std::uint8_t*>(allocator.GetBase());
+  std::memset(base, 0x11, alloc_len);
+
+  hadesmem::Snapshot const snapshot_1(process,
+                                      hadesmem::SnapshotFlags::kPrivateOnly);
+  BOOST_TEST_EQ(snapshot_1.GetProcessId(), process.GetId());
+  BOOST_TEST(snapshot_1.GetRegionCount() != 0);
+  BOOST_TEST(snapshot_1.GetPageCount() != 0);
+
+  hadesmem::SnapshotPage const* const page = snapshot_1.FindPage(base + 1);
+  BOOST_TEST(page != nullptr);
+  BOOST_TEST_EQ(page->address, reinterpret_cast<std::uintptr_t>(base));
+  std::uint8_t const* const page_data = snapshot_1.GetPageData(*page);
+  BOOST_TEST(page_data != nullptr);
+  BOOST_TEST(page_data != base);
+  BOOST_TEST_EQ(page_data[0], 0x11);
+  BOOST_TEST_EQ(page->hash,
+                hadesmem::detail::XxHash64(page_data, 0x1000));
+
+  // Two runs in the first page (close enough to merge with a large enough
+  // gap), and one in the third.
+  base[0x10] = 0x22;
+  base[0x11] = 0x23;
+  base[0x14] = 0x24;
+  base[0x2FFF] = 0x25;
+
+  hadesmem::Snapshot const snapshot_2(process,
+                                      hadesmem::SnapshotFlags::kPrivateOnly);
+
+  auto const runs = FilterRuns(
+    hadesmem::DiffSnapshots(snapshot_1, snapshot_2), base, alloc_len);
+  BOOST_TEST_EQ(runs.size(), 3UL);
+  if (runs.size() == 3)
+  {
+    BOOST_TEST_EQ(runs[0].address,
+                  reinterpret_cast<std::uintptr_t>(base + 0x10));
+    BOOST_TEST_EQ(runs[0].len, 2UL);
+    BOOST_TEST_EQ(runs[0].old_data[0], 0x11);
+    BOOST_TEST_EQ(runs[0].new_data[0], 0x22);
+    BOOST_TEST_EQ(runs[0].new_data[1], 0x23);
+    BOOST_TEST_EQ(runs[1].address,
+                  reinterpret_cast<std::uintptr_t>(base + 0x14));
+    BOOST_TEST_EQ(runs[1].len, 1UL);
+    BOOST_TEST_EQ(runs[2].address,
+                  reinterpret_cast<std::uintptr_t>(base + 0x2FFF));
+    BOOST_TEST_EQ(runs[2].new_data[0], 0x25);
+  }
+
+  auto const runs_merged = FilterRuns(
+    hadesmem::DiffSnapshots(snapshot_1, snapshot_2, 2), base, alloc_len);
+  BOOST_TEST_EQ(runs_merged.size(), 2UL);
+  if (runs_merged.size() == 2)
+  {
+    BOOST_TEST_EQ(runs_merged[0].len, 5UL);
+    BOOST_TEST_EQ(runs_merged[0].old_data[3], 0x11);
+    BOOST_TEST_EQ(runs_merged[0].new_data[4], 0x24);
+  }
+
+  // Round trip through a memory mapped file.
+  std::wstring const path = L"hadesmem_test_snapshot.bin";
+  snapshot_1.Save(path);
+  {
+    hadesmem::Snapshot const snapshot_file(path);
+    BOOST_TEST_EQ(snapshot_file.GetStorageSize(), snapshot_1.GetStorageSize());
+    BOOST_TEST_EQ(snapshot_file.GetPageCount(), snapshot_1.GetPageCount());
+    BOOST_TEST(hadesmem::DiffSnapshots(snapshot_1, snapshot_file).empty());
+    auto const runs_file = FilterRuns(
+      hadesmem::DiffSnapshots(snapshot_file, snapshot_2), base, alloc_len);
+    BOOST_TEST_EQ(runs_file.size(), 3UL);
+  }
+
+  // Capture straight to disk.
+  {
+    hadesmem::Snapshot const snapshot_disk(
+      process, path, hadesmem::SnapshotFlags::kPrivateOnly);
+    hadesmem::SnapshotPage const* const page_disk =
+      snapshot_disk.FindPage(base);
+    BOOST_TEST(page_disk != nullptr);
+    BOOST_TEST_EQ(snapshot_disk.GetPageData(*page_disk)[0x10], 0x22);
+  }
+
+  BOOST_TEST(::DeleteFileW(path.c_str()) != 0);
+  BOOST_TEST_THROWS(hadesmem::Snapshot{path}, hadesmem::Error);
+}
+
+int main()
+{
+  TestXxHash64();
+  TestSnapshot();
+  return boost::report_errors();
+}
@@ -4,7 +4,9 @@
 #include <hadesmem/write.hpp>
 #include <hadesmem/write.hpp>
 
+#include <algorithm>
 #include <array>
+#include <cstdint>
 #include <cstring>
 #include <string>
 #include <vector>
@@ -17,6 +19,7 @@
 #include <hadesmem/detail/winapi.hpp>
 #include <hadesmem/error.hpp>
 #include <hadesmem/process.hpp>
+#include <hadesmem/write_batch.hpp>
 
 // TODO: Test reads against all page protection combination (including
 // PAGE_NOCACHE and PAGE_WRITECOMBINE).
@@ -191,11 +194,114 @@ void TestWriteCrossRegion()
   BOOST_TEST(buf == check);
 }
 
+void TestWriteBatch()
+{
+  SYSTEM_INFO const sys_info = hadesmem::detail::GetSystemInfo();
+  DWORD const page_size = sys_info.dwPageSize;
+
+  // First page is read-only, second is read-write, third is reserved only.
+  auto const address = static_cast<std::uint8_t*>(
+    VirtualAlloc(nullptr, page_size * 3, MEM_RESERVE, PAGE_NOACCESS));
+  BOOST_TEST(address != nullptr);
+  BOOST_TEST(VirtualAlloc(address,
+                          page_size * 2,
+                          MEM_COMMIT,
+                          PAGE_READWRITE) != nullptr);
+  std::memset(address, 'a', page_size * 2);
+  DWORD old_protect = 0;
+#pragma warning(suppress : 6387)
+  BOOST_TEST(VirtualProtect(address, page_size, PAGE_READONLY, &old_protect) !=
+             0);
+
+  hadesmem::Process const process(::GetCurrentProcessId());
+  hadesmem::WriteBatch batch(process);
+  BOOST_TEST(batch.IsEmpty());
+  batch.Add(address + 4, std::uint32_t{0x11111111});
+  batch.Add(address, std::uint32_t{0x22222222});
+  // Overlapping writes are applied in the order they were added.
+  batch.Add(address + 6, std::uint16_t{0x3333});
+  // Crosses from the read-only page into the read-write page.
+  std::vector<char> const buf(8, 'b');
+  batch.Add(address + page_size - 4, buf);
+  BOOST_TEST_EQ(batch.GetSize(), 4UL);
+  batch.Commit();
+  BOOST_TEST(batch.IsEmpty());
+
+  BOOST_TEST_EQ(*reinterpret_cast<std::uint32_t*>(address), 0x22222222UL);
+  BOOST_TEST_EQ(*reinterpret_cast<std::uint16_t*>(address + 4), 0x1111);
+  BOOST_TEST_EQ(*reinterpret_cast<std::uint16_t*>(address + 6), 0x3333);
+  BOOST_TEST(std::equal(
+    std::begin(buf), std::end(buf), address + page_size - 4));
+  BOOST_TEST_EQ(address[page_size + 4], 'a');
+
+  MEMORY_BASIC_INFORMATION mbi{};
+  BOOST_TEST(VirtualQuery(address, &mbi, sizeof(mbi)) == sizeof(mbi));
+  BOOST_TEST_EQ(mbi.Protect, static_cast<DWORD>(PAGE_READONLY));
+  BOOST_TEST(VirtualQuery(address + page_size, &mbi, sizeof(mbi)) ==
+             sizeof(mbi));
+  BOOST_TEST_EQ(mbi.Protect, static_cast<DWORD>(PAGE_READWRITE));
+
+  // A batch which touches uncommitted memory fails and leaves everything
+  // untouched.
+  batch.Add(address + page_size, std::uint32_t{0x44444444});
+  batch.Add(address + page_size * 2, std::uint32_t{0x55555555});
+  BOOST_TEST_THROWS(batch.Commit(), hadesmem::Error);
+  BOOST_TEST_EQ(batch.GetSize(), 2UL);
+  BOOST_TEST_EQ(address[page_size], 'b');
+  batch.Clear();
+  BOOST_TEST(batch.IsEmpty());
+
+  // A write which fails after earlier runs were written rolls them back and
+  // restores the protection of every page, including the read-only one.
+  std::uint32_t const original = 0x61616161;
+  batch.Add(address + 0x10, std::uint32_t{0x66666666});
+  batch.Add(address + page_size + 0x10, std::uint32_t{0x77777777});
+  batch.Add(address + page_size + 0x20, std::uint32_t{0x88888888});
+  bool hook_failed = false;
+  batch.SetApplyHook([&](std::size_t run) {
+    if (run == 2)
+    {
+      BOOST_TEST_EQ(*reinterpret_cast<std::uint32_t*>(address + 0x10),
+                    0x66666666UL);
+      BOOST_TEST_EQ(
+        *reinterpret_cast<std::uint32_t*>(address + page_size + 0x10),
+        0x77777777UL);
+      hook_failed = true;
+      throw hadesmem::Error{};
+    }
+  });
+  BOOST_TEST_THROWS(batch.Commit(), hadesmem::Error);
+  BOOST_TEST(hook_failed);
+  BOOST_TEST_EQ(batch.GetSize(), 3UL);
+  BOOST_TEST_EQ(*reinterpret_cast<std::uint32_t*>(address + 0x10), original);
+  BOOST_TEST_EQ(
+    *reinterpret_cast<std::uint32_t*>(address + page_size + 0x10), original);
+  BOOST_TEST_EQ(
+    *reinterpret_cast<std::uint32_t*>(address + page_size + 0x20), original);
+  BOOST_TEST(VirtualQuery(address, &mbi, sizeof(mbi)) == sizeof(mbi));
+  BOOST_TEST_EQ(mbi.Protect, static_cast<DWORD>(PAGE_READONLY));
+  BOOST_TEST(VirtualQuery(address + page_size, &mbi, sizeof(mbi)) ==
+             sizeof(mbi));
+  BOOST_TEST_EQ(mbi.Protect, static_cast<DWORD>(PAGE_READWRITE));
+
+  // The same batch commits once the hook is removed.
+  batch.SetApplyHook(nullptr);
+  batch.Commit();
+  BOOST_TEST(batch.IsEmpty());
+  BOOST_TEST_EQ(*reinterpret_cast<std::uint32_t*>(address + page_size + 0x20),
+                0x88888888UL);
+  BOOST_TEST(VirtualQuery(address, &mbi, sizeof(mbi)) == sizeof(mbi));
+  BOOST_TEST_EQ(mbi.Protect, static_cast<DWORD>(PAGE_READONLY));
+
+  BOOST_TEST(VirtualFree(address, 0, MEM_RELEASE) != 0);
+}
+
 int main()
 {
   TestWritePod();
   TestWriteString();
   TestWriteVector();
   TestWriteCrossRegion();
+  TestWriteBatch();
   return boost::report_errors();
 }